@@ -0,0 +1,86 @@
+#ifndef FLATSQL_AGGREGATE_H
+#define FLATSQL_AGGREGATE_H
+
+#include "flatsql/types.h"
+#include "flatsql/sketch.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+// One aggregate of FlatSQLDatabase::aggregate()
+struct AggregateSpec {
+    // The approximate ones keep a sketch per group (see HyperLogLog and
+    // TDigest) rather than the values
+    enum class Op : uint8_t { Count, Sum, Min, Max, Avg, ApproxCountDistinct, ApproxPercentile };
+
+    Op op = Op::Count;
+    std::string column;  // Empty for COUNT(*)
+    double fraction = 0.5;  // ApproxPercentile: 0.5 is the median
+
+    // Result column name, e.g. "SUM(score)", "COUNT(*)" or
+    // "APPROX_PERCENTILE(score, 0.9)"
+    std::string label() const;
+};
+
+/**
+ * Running values of a list of aggregates over one group of rows.
+ *
+ * Results follow SQLite: COUNT skips NULLs (COUNT(*) does not), SUM stays
+ * an integer until it meets a real, AVG is a double, and every aggregate
+ * but COUNT is NULL when it saw no non-NULL value. APPROX_COUNT_DISTINCT
+ * is an integer like COUNT, APPROX_PERCENTILE a double over the numeric
+ * values. Partial states of disjoint row ranges combine with merge(), in
+ * any order, sketches included.
+ */
+class AggregateState {
+public:
+    explicit AggregateState(const std::vector<AggregateSpec>* specs);
+
+    // Feed one row: values[i] is aggregate i's column (ignored for COUNT(*))
+    void add(const Value* values);
+
+    void merge(const AggregateState& other);
+
+    // Aggregate i's result
+    Value result(size_t i) const;
+
+private:
+    struct Slot {
+        uint64_t count = 0;  // Non-NULL values seen (rows for COUNT(*))
+        int64_t intSum = 0;
+        double realSum = 0.0;
+        bool real = false;   // A real was summed: the sum is intSum + realSum
+        Value min;
+        Value max;
+        HyperLogLog distinct;
+        TDigest digest;
+    };
+
+    const std::vector<AggregateSpec>* specs_;
+    std::vector<Slot> slots_;
+};
+
+// Value as a query returns it: integers and bools widened to int64, floats to double
+Value toSqlValue(const Value& value);
+
+// Order for group keys: compareValues(), NULL first
+struct ValueLess {
+    bool operator()(const Value& a, const Value& b) const { return compareValues(a, b) < 0; }
+};
+
+// Group key -> running aggregates
+using AggregateGroups = std::map<Value, AggregateState, ValueLess>;
+
+// Fold other's groups into groups (states of the same aggregate list)
+void mergeAggregateGroups(AggregateGroups& groups, AggregateGroups&& other);
+
+// The rows of FlatSQLDatabase::aggregate() for groups; an ungrouped
+// aggregate of no rows is still one row
+QueryResult aggregateResult(AggregateGroups& groups, const std::vector<AggregateSpec>& aggregates,
+                            const std::string& groupBy);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_AGGREGATE_H
@@ -0,0 +1,101 @@
+#ifndef FLATSQL_ARENA_RESULT_H
+#define FLATSQL_ARENA_RESULT_H
+
+#include "flatsql/types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Query result in one arena instead of a vector per row and a heap
+ * string per cell: the cells are a flat row-major array of ValueViews and
+ * text and blob bytes are copied into a bump allocator of a few large
+ * blocks. Filling a million rows takes a handful of allocations, and
+ * clear() or destruction releases them all at once.
+ *
+ * Cells stay valid until clear() or destruction. clear() keeps the
+ * largest block, so a result reused for each execution of a statement
+ * stops allocating once it has grown to fit.
+ */
+class ArenaQueryResult {
+public:
+    // The cells of one row
+    class Row {
+    public:
+        Row(const ValueView* cells, size_t size) : cells_(cells), size_(size) {}
+
+        const ValueView& operator[](size_t column) const { return cells_[column]; }
+        size_t size() const { return size_; }
+        const ValueView* begin() const { return cells_; }
+        const ValueView* end() const { return cells_ + size_; }
+
+    private:
+        const ValueView* cells_;
+        size_t size_;
+    };
+
+    std::vector<std::string> columns;
+
+    ArenaQueryResult() = default;
+    ArenaQueryResult(ArenaQueryResult&&) = default;
+    ArenaQueryResult& operator=(ArenaQueryResult&&) = default;
+    ArenaQueryResult(const ArenaQueryResult&) = delete;
+    ArenaQueryResult& operator=(const ArenaQueryResult&) = delete;
+
+    size_t rowCount() const { return rows_; }
+    size_t columnCount() const { return columns.size(); }
+
+    Row operator[](size_t row) const { return Row(cells_.data() + row * columns.size(), columns.size()); }
+    const ValueView& at(size_t row, size_t column) const { return cells_[row * columns.size() + column]; }
+
+    // Owning copy of one cell
+    Value value(size_t row, size_t column) const { return toValue(at(row, column)); }
+
+    // Drop the rows and columns, keeping the largest arena block
+    void clear();
+
+    // Append a row of columnCount() null cells and return them, valid
+    // until the next addRow()
+    ValueView* addRow();
+
+    // Copy text or bytes into the arena
+    std::string_view copyText(const char* text, size_t length);
+    BytesView copyBytes(const uint8_t* data, size_t length);
+
+    // Copy of a cell's contents into the arena
+    ValueView copyValue(const Value& value);
+
+    // Replace the contents with a copy of result
+    void assign(const QueryResult& result);
+
+    // Owning QueryResult of the same rows
+    QueryResult toQueryResult() const;
+
+    // Bytes held by the arena's blocks (cells not included)
+    size_t arenaBytes() const;
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    static constexpr size_t FIRST_BLOCK = 4096;
+    static constexpr size_t MAX_BLOCK = size_t(1) << 20;
+
+    uint8_t* allocate(size_t length);
+
+    std::vector<ValueView> cells_;
+    size_t rows_ = 0;
+    std::vector<Block> blocks_;  // The last one is being filled
+    size_t used_ = 0;            // Bytes used in the last block
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_ARENA_RESULT_H
@@ -0,0 +1,27 @@
+#ifndef FLATSQL_BLOCK_CODEC_H
+#define FLATSQL_BLOCK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Byte-oriented LZ77 block compression in the LZ4 block format: sequences
+ * of a token, literals and a 16-bit back-reference, with the format's end
+ * rules (the last five bytes are literals). A greedy single-probe matcher
+ * keeps compression fast; FlatBuffer streams repeat vtables, file IDs and
+ * field patterns closely enough that it still pays.
+ */
+
+// Compress src[0, length) into out (replacing its contents)
+void compressBlock(const uint8_t* src, size_t length, std::vector<uint8_t>& out);
+
+// Decompress src into exactly rawLength bytes at dst; false when the input
+// is malformed or does not decode to rawLength bytes
+bool decompressBlock(const uint8_t* src, size_t length, uint8_t* dst, size_t rawLength);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_BLOCK_CODEC_H
@@ -2,72 +2,142 @@
 #define FLATSQL_BTREE_H
 
 #include "flatsql/types.h"
-#include <unordered_map>
+#include "flatsql/index.h"
+#include <shared_mutex>
+#include <vector>
 
 namespace flatsql {
 
 /**
- * In-memory B-tree for indexing FlatBuffer records.
+ * Native in-memory B+tree index for FlatBuffer records.
  * Keys point to offsets in the stacked FlatBuffer storage.
+ *
+ * Nodes live in two contiguous pools (leaves and inner nodes) and refer to
+ * each other by pool position. Keys are fixed-width: integers and floats
+ * are stored as order-preserving 64-bit words, strings and blobs as an
+ * 8-byte big-endian prefix plus a slice of a shared byte arena, so most
+ * comparisons are a single integer compare. Leaves are chained for scans.
+ *
+ * Key matching follows SqliteIndex for the common cases: integer columns
+ * accept any numeric key (non-integral doubles never match exactly, range
+ * bounds round inward), real columns accept any numeric key, text and blob
+ * columns only match keys of the same kind.
+ *
+ * A reader/writer lock guards the tree, so lookups from ReadSession threads
+ * can run while the ingesting thread inserts.
  */
-class BTree {
+class BTreeIndex : public Index {
 public:
-    explicit BTree(ValueType keyType, int order = 128);
+    BTreeIndex(const std::string& tableName, const std::string& columnName, ValueType keyType);
+
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+
+    // Builds the tree bottom-up when empty and the input is sorted,
+    // otherwise falls back to individual inserts
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
+
+    std::vector<IndexEntry> search(const Value& key) const override;
+    bool searchFirst(const Value& key, IndexEntry& result) const override;
+    // Walks the leaf chain forward between sorted keys, descending from the
+    // root only when the next key lies beyond the current leaf
+    std::vector<IndexEntry> searchMany(std::vector<Value> keys) const override;
+    bool searchFirstString(const std::string& key, uint64_t& outOffset,
+                           uint32_t& outLength, uint64_t& outSequence) const override;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                          uint32_t& outLength, uint64_t& outSequence) const override;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
+    std::vector<IndexEntry> all() const override;
+    // Walks the leaf chain a page at a time, descending from the root again
+    // to resume after the last entry of the previous page
+    std::unique_ptr<IndexCursor> openRange(const Value& minKey, const Value& maxKey,
+                                           bool reverse) const override;
+    void clear() override;
 
-    // Insert an entry
-    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+    // Statistics
+    int getHeight() const { return root_ == NONE ? 0 : height_ + 1; }
+    size_t getNodeCount() const { return leaves_.size() + inners_.size(); }
 
-    // Search for entries with exact key match
-    std::vector<IndexEntry> search(const Value& key) const;
+    // Node and key arena capacity
+    size_t memoryBytes() const override;
 
-    // Search for first entry with exact key match (optimized for unique keys)
-    // Returns true if found, false otherwise
-    bool searchFirst(const Value& key, IndexEntry& result) const;
+private:
+    class RangeCursor;
 
-    // Range query: minKey <= key <= maxKey
-    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const;
+    static constexpr uint32_t FANOUT = 64;
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
 
-    // Get all entries (full scan)
-    std::vector<IndexEntry> all() const;
+    enum class KeyDomain : uint8_t { Integer, Real, Text, Blob };
 
-    // Statistics
-    uint64_t getEntryCount() const { return entryCount_; }
-    int getHeight() const;
-    size_t getNodeCount() const { return nodes_.size(); }
+    // How a search Value maps onto the key domain
+    enum class ProbeMode : uint8_t { Exact, Lower, Upper };
 
-    // Clear all entries
-    void clear();
+    // Stored key: fixed width, variable-length bytes live in arena_
+    struct Key {
+        uint64_t prefix;
+        uint32_t arenaOffset;
+        uint32_t length;
+    };
 
-private:
-    struct BTreeNode {
-        uint64_t nodeId;
-        bool isLeaf;
-        std::vector<IndexEntry> entries;
-        std::vector<uint64_t> children;  // child node IDs
-        uint64_t parentId;
+    // Key being compared: bytes point into arena_ or into a caller's Value
+    struct Probe {
+        uint64_t prefix;
+        const uint8_t* bytes;
+        uint32_t length;
+    };
+
+    struct LeafNode {
+        uint32_t count = 0;
+        uint32_t next = NONE;  // Right sibling for in-order scans
+        Key keys[FANOUT];
+        uint64_t sequences[FANOUT];
+        uint64_t offsets[FANOUT];
+        uint32_t lengths[FANOUT];
+    };
+
+    // children[i] holds entries below separator i, children[i + 1] those at or above it
+    struct InnerNode {
+        uint32_t count = 0;  // Separators in use (children = count + 1)
+        Key keys[FANOUT];
+        uint64_t sequences[FANOUT];
+        uint32_t children[FANOUT + 1];
     };
 
-    uint64_t createNode(bool isLeaf, uint64_t parentId);
-    BTreeNode& getNode(uint64_t nodeId);
-    const BTreeNode& getNode(uint64_t nodeId) const;
-
-    void insertNonFull(uint64_t nodeId, const IndexEntry& entry);
-    void splitChild(uint64_t parentId, int childIndex);
-
-    void searchNode(uint64_t nodeId, const Value& key, std::vector<IndexEntry>& results) const;
-    bool searchNodeFirst(uint64_t nodeId, const Value& key, IndexEntry& result) const;
-    bool searchNodeFirstInt(uint64_t nodeId, int64_t keyInt, IndexEntry& result) const;
-    void rangeSearch(uint64_t nodeId, const Value& minKey, const Value& maxKey,
-                     std::vector<IndexEntry>& results) const;
-    void collectAll(uint64_t nodeId, std::vector<IndexEntry>& results) const;
-    int getHeightFrom(uint64_t nodeId) const;
-
-    ValueType keyType_;
-    int order_;
-    std::unordered_map<uint64_t, BTreeNode> nodes_;
-    uint64_t rootId_ = 0;
-    uint64_t nextNodeId_ = 1;
-    uint64_t entryCount_ = 0;
+    // Value -> probe in this index's key domain, false if it can never match
+    bool makeProbe(const Value& value, ProbeMode mode, Probe& out) const;
+    Probe probeOf(const Key& key) const {
+        return {key.prefix, arena_.data() + key.arenaOffset, key.length};
+    }
+    int compareProbe(const Probe& a, const Probe& b) const;
+    int compareEntry(const Probe& a, uint64_t aSeq, const Key& b, uint64_t bSeq) const;
+
+    // Copy a key into arena_ (text/blob) and return its stored form
+    bool storeKey(const Value& value, Key& out);
+
+    // First leaf slot whose key is >= probe (leaf == NONE when past the end)
+    void lowerBound(const Probe& probe, uint32_t& leaf, uint32_t& pos) const;
+    uint32_t leftmostLeaf() const;
+
+    // First slot whose entry sorts after (probe, sequence)
+    void upperBound(const Probe& probe, uint64_t sequence, uint32_t& leaf, uint32_t& pos) const;
+
+    // Last slot whose entry sorts before (probe, *sequence), or whose key is
+    // <= probe when sequence is null (leaf == NONE when there is none)
+    void lastBefore(const Probe& probe, const uint64_t* sequence, uint32_t& leaf, uint32_t& pos) const;
+
+    // insert() without taking the lock
+    void insertKey(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+    void insertStored(const Key& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+    IndexEntry entryAt(const LeafNode& leaf, uint32_t pos) const;
+    Value keyToValue(const Key& key) const;
+
+    KeyDomain domain_;
+    std::vector<LeafNode> leaves_;
+    std::vector<InnerNode> inners_;
+    std::vector<uint8_t> arena_;
+    uint32_t root_ = NONE;
+    int height_ = 0;  // Inner levels above the leaves
+
+    mutable std::shared_mutex mutex_;
 };
 
 }  // namespace flatsql
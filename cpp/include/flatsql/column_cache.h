@@ -0,0 +1,106 @@
+#ifndef FLATSQL_COLUMN_CACHE_H
+#define FLATSQL_COLUMN_CACHE_H
+
+#include "flatsql/types.h"
+#include "flatsql/stable_vector.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Materialized copy of one numeric column, in table row order.
+ *
+ * Row i holds the column value of the table's i-th record (the order of
+ * TableStore::getRecordInfos()), so full scans can read a fixed-width
+ * array instead of walking each FlatBuffer's vtable. Integer and bool
+ * columns are stored as int64, float and double columns as double, with a
+ * null bitmap alongside.
+ *
+ * Appends follow StableVector rules: one writer, lock-free readers of the
+ * rows below a size() they have observed.
+ */
+class ColumnCache {
+public:
+    enum class CompareOp : uint8_t { Eq, Lt, Le, Gt, Ge };
+
+    /**
+     * "value op operand" in the cache's storage type, as built by
+     * makeComparison(). matchesNone is set when no non-null row can match
+     * (e.g. int_col = 2.5 or a NULL operand).
+     */
+    struct Comparison {
+        CompareOp op = CompareOp::Eq;
+        int64_t intOperand = 0;
+        double realOperand = 0.0;
+        bool matchesNone = false;
+    };
+
+    explicit ColumnCache(ValueType type);
+
+    // Whether a column of this type can be cached
+    static bool supports(ValueType type);
+
+    // Append the next row (writer only); non-numeric values count as null
+    void append(const Value& value);
+
+    size_t size() const { return real_ ? reals_.size() : ints_.size(); }
+    bool isReal() const { return real_; }
+    size_t getNullCount() const { return nullCount_.load(std::memory_order_relaxed); }
+
+    // Bytes of the value and null chunks allocated so far
+    size_t memoryBytes() const { return ints_.capacityBytes() + reals_.capacityBytes() + nullBits_.capacityBytes(); }
+
+    bool isNull(size_t row) const {
+        const uint64_t* word = &nullBits_[row >> 6];
+        return (__atomic_load_n(word, __ATOMIC_RELAXED) >> (row & 63)) & 1;
+    }
+    int64_t getInt64(size_t row) const { return real_ ? static_cast<int64_t>(reals_[row]) : ints_[row]; }
+    double getDouble(size_t row) const { return real_ ? reals_[row] : static_cast<double>(ints_[row]); }
+
+    // Row as a Value (monostate when null)
+    Value getValue(size_t row) const;
+
+    /**
+     * Translate a comparison against a SQL operand into this column's
+     * storage type with SQLite's numeric semantics. Returns false when the
+     * operand is not numeric (text affinity rules apply) or cannot be
+     * represented exactly, in which case the caller must not filter on it.
+     */
+    bool makeComparison(CompareOp op, const Value& operand, Comparison& out) const {
+        return makeComparison(real_, op, operand, out);
+    }
+
+    // Same for any column summarized as doubles (real) or int64 values
+    static bool makeComparison(bool real, CompareOp op, const Value& operand, Comparison& out);
+
+    /**
+     * Evaluate a comparison over rows [block * 64, block * 64 + 64): bit i
+     * is set when row block * 64 + i is non-null and matches. Rows at or
+     * past size() are not materialized yet and always report a match, so
+     * callers only ever drop rows that are known to fail.
+     */
+    uint64_t matchBlock(size_t block, const Comparison& cmp) const;
+
+    /**
+     * Copy rows [block * 64, block * 64 + 64) into out as doubles, stopping
+     * at size(); bit i of nulls is set when row block * 64 + i is null.
+     * Returns the number of rows copied.
+     */
+    size_t readBlock(size_t block, double* out, uint64_t& nulls) const;
+
+private:
+    bool real_;
+    StableVector<int64_t> ints_;
+    StableVector<double> reals_;
+    StableVector<uint64_t> nullBits_;  // Bit (row % 64) of word (row / 64)
+    std::atomic<size_t> nullCount_{0};
+};
+
+// One slot per table column, nullptr where the column is not cached
+using ColumnCacheSlots = std::vector<std::unique_ptr<ColumnCache>>;
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_COLUMN_CACHE_H
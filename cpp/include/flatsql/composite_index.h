@@ -0,0 +1,121 @@
+#ifndef FLATSQL_COMPOSITE_INDEX_H
+#define FLATSQL_COMPOSITE_INDEX_H
+
+#include "flatsql/types.h"
+#include "flatsql/index.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+// Key of a composite index in a table's indexes and a virtual table's
+// index map
+inline std::string compositeIndexKey(const std::string& name) {
+    return "_cmp_" + name;
+}
+
+/**
+ * Index over several columns (TableStore::addCompositeIndex), such as
+ * (ORIGINATOR, EPOCH), optionally carrying more columns in its entries.
+ *
+ * Each record has one key: its key columns and then its included columns,
+ * encoded so that comparing the bytes compares the values column by
+ * column. A NULL sorts first; integers, reals and strings keep their SQL
+ * order. The key is held by an ordinary index of the table's engine with
+ * BLOB keys, which does the storing, paging, persisting and erasing, so
+ * every record is indexed (NULL columns included).
+ *
+ * Equalities on leading key columns and a range on the next one map to
+ * one key range (see bounds()). Scans reading only columns the index
+ * holds decode them from the keys (decode()) and never touch the record.
+ */
+class CompositeIndex : public Index {
+public:
+    struct Column {
+        std::string name;
+        int ordinal;      // TableDef ordinal
+        ValueType type;
+    };
+
+    CompositeIndex(const std::string& tableName, const std::string& name, std::vector<Column> keyColumns,
+                   std::vector<Column> includedColumns, std::unique_ptr<Index> entries);
+
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+    void insertBatch(std::vector<IndexEntry>& entries) override;
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
+    std::vector<IndexEntry> search(const Value& key) const override;
+    bool searchFirst(const Value& key, IndexEntry& result) const override;
+    std::vector<IndexEntry> searchMany(std::vector<Value> keys) const override;
+    bool searchFirstString(const std::string& key, uint64_t& outOffset,
+                           uint32_t& outLength, uint64_t& outSequence) const override;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                          uint32_t& outLength, uint64_t& outSequence) const override;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
+    std::vector<IndexEntry> all() const override;
+    std::unique_ptr<IndexCursor> openRange(const Value& minKey, const Value& maxKey,
+                                           bool reverse) const override;
+    void clear() override;
+    void eraseThrough(uint64_t sequence) override;
+    void saveTo(sqlite3* db, const std::string& schemaName) const override;
+    void loadFrom(sqlite3* db, const std::string& schemaName) override;
+    size_t memoryBytes() const override { return entries_->memoryBytes(); }
+    size_t pageBytes() const override { return entries_->pageBytes(); }
+
+    // openRange() with the keys filled in, for scans that decode them. The
+    // range is read up front: the wrapped cursors leave keys empty.
+    std::unique_ptr<IndexCursor> openKeyedRange(const Value& minKey, const Value& maxKey, bool reverse) const;
+
+    const std::string& getIndexName() const { return indexName_; }
+    const std::vector<Column>& getKeyColumns() const { return keyColumns_; }
+    const std::vector<Column>& getIncludedColumns() const { return includedColumns_; }
+
+    // Ordinals of the columns a key is encoded from: key columns, then
+    // included ones
+    const std::vector<int>& getOrdinals() const { return ordinals_; }
+
+    // Whether the entries hold column ordinal
+    bool covers(int ordinal) const;
+
+    // Statistics of key column i on its own (for the planner)
+    IndexStats getColumnStats(size_t keyColumn) const { return columnStats_[keyColumn].snapshot(); }
+
+    // Key of the record whose getOrdinals() columns hold values (reusing
+    // the bytes key already holds)
+    void encode(const Value* values, Value& key) const;
+
+    // Store each column of key into values[ordinal]; values must have a
+    // slot for every column of the table. False for a malformed key.
+    bool decode(const Value& key, std::vector<Value>& values) const;
+
+    /**
+     * Key range holding every entry whose first equal.size() key columns
+     * equal equal and whose next key column lies within [lo, hi] (nullptr
+     * leaves a side open, and both nullptr leaves that column out). Values
+     * are compared as SQLite would compare them with the column. The range
+     * may hold more than that, never less: an equality that can't be
+     * encoded in the column's type ends the prefix, and an unencodable
+     * bound is left open, so callers must check the entries again. False
+     * when no entry can match.
+     */
+    bool bounds(const std::vector<Value>& equal, const Value* lo, const Value* hi,
+                Value& minKey, Value& maxKey) const;
+
+private:
+    // Add an entry's key to the statistics
+    void count(const Value& key);
+
+    // Recount the statistics from the wrapped index
+    void recount();
+
+    std::string indexName_;
+    std::vector<Column> keyColumns_;
+    std::vector<Column> includedColumns_;
+    std::vector<int> ordinals_;
+    std::unique_ptr<Index> entries_;
+    std::vector<IndexStatistics> columnStats_;  // Per key column
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_COMPOSITE_INDEX_H
@@ -3,28 +3,57 @@
 
 #include "flatsql/types.h"
 #include "flatsql/storage.h"
+#include "flatsql/memory_usage.h"
 #include "flatsql/sqlite_index.h"
+#include "flatsql/btree.h"
+#include "flatsql/dictionary_index.h"
+#include "flatsql/full_text_index.h"
+#include "flatsql/trigram_index.h"
+#include "flatsql/composite_index.h"
 #include "flatsql/schema_parser.h"
 #include "flatsql/sqlite_engine.h"
+#include "flatsql/worker_pool.h"
+#include "flatsql/aggregate.h"
+#include "flatsql/column_cache.h"
+#include "flatsql/zone_map.h"
+#include "flatsql/schema_extractor.h"
+#include "flatsql/record_verification.h"
+#include "flatsql/hmac.h"
+#include "flatsql/subscription.h"
+#include "flatsql/materialized_aggregate.h"
+#include "flatsql/replication.h"
 #include "flatbuffers/encryption.h"
 #include <set>
+#include <unordered_map>
 
 namespace flatsql {
 
 /**
  * Table store: manages records and indexes for a single table.
  * Works with streaming ingest - indexes are built as records arrive.
- * Uses SQLite's optimized B-tree for indexes (via SqliteIndex).
+ * Indexes use SQLite's optimized B-tree (SqliteIndex) or the native
+ * in-memory B+tree (BTreeIndex), selected by IndexEngine.
  */
 class TableStore {
 public:
-    TableStore(const TableDef& tableDef, StreamingFlatBufferStore& storage, sqlite3* indexDb);
+    TableStore(const TableDef& tableDef, StreamingFlatBufferStore& storage, sqlite3* indexDb,
+               IndexEngine indexEngine = IndexEngine::Sqlite);
 
     // Called during streaming ingest to index a record
     // This is the streaming index builder - called for each FlatBuffer as it arrives
     void onIngest(const uint8_t* data, size_t length, uint64_t sequence, uint64_t offset);
 
-    // Find by indexed column
+    // Buffer index writes from onIngest until flushIndexBatch(), which
+    // sorts them and writes each index with multi-row inserts
+    void beginIndexBatch() { batching_ = true; }
+    void flushIndexBatch();
+
+    // Extract batched index keys on this pool (not owned, nullptr = inline).
+    // The field extractor must then be safe to call from several threads.
+    void setWorkerPool(WorkerPool* pool) { workerPool_ = pool; }
+
+    // Find by indexed column (for a full-text column, value is a MATCH
+    // query; see FullTextIndex)
     std::vector<StoredRecord> findByIndex(const std::string& column, const Value& value);
 
     // Find by range on indexed column
@@ -34,6 +63,13 @@ public:
     // Full table scan (by file_id)
     std::vector<StoredRecord> scanAll();
 
+    // Zero-copy forms of the three above (see RecordRange). viewByIndex
+    // returns every match, not just the first; without an index on the
+    // column the matches are found by a scan.
+    RecordRange viewByIndex(const std::string& column, const Value& value) const;
+    RecordRange viewByRange(const std::string& column, const Value& minValue, const Value& maxValue) const;
+    RecordRange viewAll() const;
+
     // Get table definition
     const TableDef& getTableDef() const { return tableDef_; }
 
@@ -49,22 +85,67 @@ public:
     // Get index names
     std::vector<std::string> getIndexNames() const;
 
+    // Bytes held for this table (see TableMemory), with tombstones those
+    // of its source; pages = false skips measuring SQLite index pages
+    TableMemory getMemoryUsage(const DeletionBitmap* tombstones, bool pages = true) const;
+
     // Field extractor function type - extracts field values from raw FlatBuffer
     using FieldExtractor = std::function<Value(const uint8_t* data, size_t length, const std::string& fieldName)>;
     using FastFieldExtractor = flatsql::FastFieldExtractor;
     using BatchExtractor = flatsql::BatchExtractor;
 
-    // Set field extractor (required for indexing and queries)
-    void setFieldExtractor(FieldExtractor extractor) { fieldExtractor_ = extractor; }
+    // Field extractor returning views into the record (see ValueView)
+    using FieldViewExtractor =
+        std::function<ValueView(const uint8_t* data, size_t length, const std::string& fieldName)>;
+
+    // Index key extractor: fills keys[i] with column columns[i] (TableDef
+    // ordinal) of one record. keys is reused across records, so strings and
+    // byte vectors already in it can be assigned in place. Called from
+    // worker threads when a worker pool is set.
+    using KeyExtractor = void(*)(const uint8_t* data, size_t length, const int* columns,
+                                 size_t count, Value* keys);
+
+    // Set field extractor (required for indexing and queries); replaces
+    // a schema extractor
+    void setFieldExtractor(FieldExtractor extractor) {
+        fieldExtractor_ = extractor;
+        useSchemaExtractor_ = false;
+    }
+
+    /**
+     * Read fields with a reader generated from the schema (see
+     * SchemaExtractor), as both the field extractor and the virtual
+     * table's direct column writer. The extractor is kept alive for the
+     * life of the store, since registered virtual tables point at it.
+     */
+    void setSchemaExtractor(std::shared_ptr<const SchemaExtractor> extractor);
+
+    // Schema extractor in use (nullptr if none or replaced by setFieldExtractor)
+    std::shared_ptr<const SchemaExtractor> getSchemaExtractor() const {
+        return useSchemaExtractor_ ? schemaExtractor_ : nullptr;
+    }
+
+    // Checks of this table's records (see FlatSQLDatabase::setVerificationMode)
+    RecordVerification& getVerification() { return verification_; }
+    const RecordVerification& getVerification() const { return verification_; }
 
     // Set fast field extractor (optional, for bypassing Value construction)
     void setFastFieldExtractor(FastFieldExtractor extractor) { fastFieldExtractor_ = extractor; }
 
+    // Set view extractor (optional): index keys and the unindexed scans of
+    // the lookups then read strings and bytes without allocating. A schema
+    // extractor provides views itself.
+    void setFieldViewExtractor(FieldViewExtractor extractor) { fieldViewExtractor_ = std::move(extractor); }
+
     // Set batch extractor (optional, for efficient batch extraction)
     void setBatchExtractor(BatchExtractor extractor) { batchExtractor_ = extractor; }
 
+    // Set key extractor (optional, replaces per-column extraction when indexing)
+    void setKeyExtractor(KeyExtractor extractor) { keyExtractor_ = extractor; }
+    KeyExtractor getKeyExtractor() const { return keyExtractor_; }
+
     // Get field extractor
-    FieldExtractor getFieldExtractor() const { return fieldExtractor_; }
+    const FieldExtractor& getFieldExtractor() const { return fieldExtractor_; }
 
     // Get fast field extractor
     FastFieldExtractor getFastFieldExtractor() const { return fastFieldExtractor_; }
@@ -72,30 +153,335 @@ public:
     // Get batch extractor
     BatchExtractor getBatchExtractor() const { return batchExtractor_; }
 
-    // Get index for a column (returns nullptr if not indexed)
-    SqliteIndex* getIndex(const std::string& columnName) {
+    // Get index for a column (returns nullptr if not indexed, or while
+    // backfill() is still filling it)
+    Index* getIndex(const std::string& columnName) {
         auto it = indexes_.find(columnName);
-        return it != indexes_.end() ? it->second.get() : nullptr;
+        return it != indexes_.end() && !backfilling(columnName) ? it->second.get() : nullptr;
     }
 
+    /**
+     * Index a column the schema left unindexed, filled from existing
+     * records now and maintained by onIngest afterwards (an ordinary index
+     * of the table's engine). Returns the column's index, which may be one
+     * it already had. Not safe inside an ingest batch or while queries
+     * read the table.
+     *
+     * @throws std::runtime_error for an unknown or encrypted column, or
+     *         without an extractor
+     */
+    Index* addIndex(const std::string& columnName);
+
+    /**
+     * Index keyColumns together, carrying includeColumns in the entries
+     * as well (see CompositeIndex), filled from existing records now and
+     * maintained by onIngest afterwards. Stored under
+     * compositeIndexKey(name). Not safe inside an ingest batch or while
+     * queries read the table.
+     *
+     * @throws std::runtime_error for a name in use, no key columns, an
+     *         unknown, repeated or encrypted column, or without an extractor
+     */
+    CompositeIndex* addCompositeIndex(const std::string& name, const std::vector<std::string>& keyColumns,
+                                      const std::vector<std::string>& includeColumns);
+
+    // Composite indexes, in the order they were added
+    const std::vector<CompositeIndex*>& getCompositeIndexes() const { return composites_; }
+
+    /**
+     * Take on a newer version of the table's schema (see
+     * FlatSQLDatabase::evolveSchema): evolved keeps the current columns in
+     * order and may add columns after them or mark current ones indexed.
+     * Indexes on those columns take records ingested from now on at once
+     * and are left to backfill() for the records already stored; until it
+     * is done, lookups and getIndex() do without them. A schema extractor
+     * in use is replaced by extractor, or without one by an extractor of
+     * the evolved columns. Not safe inside an ingest batch or while
+     * queries read the table.
+     */
+    void evolve(const TableDef& evolved, std::shared_ptr<const SchemaExtractor> extractor);
+
+    /**
+     * Index up to maxRecords already stored records for the indexes
+     * evolve() added, appending the columns whose index is now complete to
+     * completed. Returns the records read.
+     */
+    size_t backfill(size_t maxRecords, std::vector<std::string>& completed);
+    bool isBackfilling() const { return !backfills_.empty(); }
+
+    /**
+     * Keep a materialized copy of a numeric column (see ColumnCache), filled
+     * from existing records now and maintained by onIngest afterwards.
+     * Full scans read cached columns from it instead of the FlatBuffers.
+     * Configure before opening read sessions.
+     */
+    void enableColumnCache(const std::string& columnName);
+
+    // Cached column for columnName (nullptr if not enabled)
+    const ColumnCache* getColumnCache(const std::string& columnName) const;
+
+    // One slot per column, for the virtual table
+    const ColumnCacheSlots& getColumnCaches() const { return columnCaches_; }
+
+    /**
+     * Keep per-zone min/max summaries of a numeric column (see ZoneMap),
+     * built from existing records now and maintained by onIngest
+     * afterwards. Full scans skip zones a comparison on the column rules
+     * out. Configure before opening read sessions.
+     */
+    void enableZoneMap(const std::string& columnName);
+
+    // Zone map for columnName (nullptr if not enabled)
+    const ZoneMap* getZoneMap(const std::string& columnName) const;
+
+    // One slot per column, for the virtual table
+    const ZoneMapSlots& getZoneMaps() const { return zoneMaps_; }
+
+    /**
+     * Keep a Bloom filter per zone of a string column (see ZoneBloomFilter),
+     * built like a zone map. Full scans with an equality on the column
+     * skip zones whose filter rules the value out.
+     */
+    void enableBloomFilter(const std::string& columnName);
+
+    // One slot per column, for the virtual table
+    const ZoneBloomSlots& getBloomFilters() const { return bloomFilters_; }
+
+    // Re-attach records whose index entries were restored from a sidecar
+    // (only records below endOffset are taken)
+    void restoreRecords(const StreamingFlatBufferStore::RecordInfoList& infos, uint64_t endOffset);
+
+    /**
+     * Follow a compacted stream: storage now holds the rewritten records,
+     * and sequenceMap[old] is each old sequence's new one (0 = dropped).
+     * Renumbers this table's records, drops the removed ones and rebuilds
+     * indexes and column caches to match.
+     */
+    void remapSequences(const std::vector<uint64_t>& sequenceMap);
+
     // Get record infos for this specific table (for source-specific iteration)
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>& getRecordInfos() const {
+    const StreamingFlatBufferStore::RecordInfoList& getRecordInfos() const {
         return recordInfos_;
     }
 
+    // Subscriptions matched against this table's new records (nullptr
+    // until the first one is added through subscriptions())
+    SubscriptionSet* getSubscriptions() { return subscriptions_.get(); }
+    SubscriptionSet& subscriptions();
+
+    /**
+     * Maintain a materialized aggregate of this table (see
+     * MaterializedAggregate), counting the existing records not in
+     * tombstones now and updated by onIngest afterwards.
+     * @throws std::runtime_error without a field extractor or for a bad
+     *         declaration
+     */
+    MaterializedAggregate& addMaterializedAggregate(const std::string& name, const MaterializedAggregateDef& def,
+                                                    const DeletionBitmap* tombstones);
+
+    bool hasMaterializedAggregates() const { return !aggregates_.empty(); }
+
+    // Take a newly deleted record out of the materialized aggregates
+    void onDelete(uint64_t sequence);
+
+    // Bring stale groups of aggregate up to date from the live records
+    void refreshAggregate(MaterializedAggregate& aggregate, const DeletionBitmap* tombstones);
+
+    // Count every materialized aggregate again from the live records
+    void recountAggregates(const DeletionBitmap* tombstones);
+
+    /**
+     * Retention is about to evict every record through sequence: take the
+     * ones not yet deleted out of the materialized aggregates and erase
+     * their index entries. Not inside an ingest batch.
+     */
+    void expireThrough(uint64_t sequence, const DeletionBitmap* tombstones);
+
+    /**
+     * Latest-wins ingest by the primary key (see
+     * FlatSQLDatabase::setUpsertMode): track each key's current version.
+     * The stored records not in tombstones are taken in sequence order
+     * now, and superseded receives the older versions they replace, for
+     * the caller to delete. With keepHistory each version also remembers
+     * the one it replaced.
+     *
+     * @throws std::runtime_error without a single unencrypted primary key
+     *         column or an extractor
+     */
+    void enableUpsert(bool keepHistory, const DeletionBitmap* tombstones, std::vector<uint64_t>& superseded);
+    void disableUpsert();
+    bool isUpsert() const { return !upsertColumn_.empty(); }
+    const std::string& getUpsertColumn() const { return upsertColumn_; }
+
+    // Make a new record its key's current version; returns the sequence
+    // of the version it replaces (0 if none, or for a NULL key)
+    uint64_t supersede(const uint8_t* data, size_t length, uint64_t sequence, uint64_t offset);
+
+    // Current version of key, false if there is none (or no upsert mode)
+    bool findCurrent(const Value& key, IndexEntry& entry) const;
+
+    // Sequences of key's versions, newest first: the current one and,
+    // with keepHistory, those it replaced that are still stored
+    std::vector<uint64_t> getVersions(const Value& key) const;
+
 private:
     TableDef tableDef_;
     std::string fileId_;  // 4-byte file identifier for routing
     StreamingFlatBufferStore& storage_;
     sqlite3* indexDb_;    // SQLite database for indexes (not owned)
-    std::map<std::string, std::unique_ptr<SqliteIndex>> indexes_;
+    IndexEngine indexEngine_;
+    std::map<std::string, std::unique_ptr<Index>> indexes_;
+    std::map<std::string, std::vector<IndexEntry>> pendingEntries_;  // Buffered while batching_
+    // Records awaiting key extraction on workerPool_ while batching_
+    std::vector<StreamingFlatBufferStore::FileRecordInfo> pendingRecords_;
+    WorkerPool* workerPool_ = nullptr;
+    bool batching_ = false;
     uint64_t recordCount_ = 0;
     FieldExtractor fieldExtractor_;
-    FastFieldExtractor fastFieldExtractor_;
+    FieldViewExtractor fieldViewExtractor_;
+    FastFieldExtractor fastFieldExtractor_ = nullptr;
     BatchExtractor batchExtractor_ = nullptr;
+    KeyExtractor keyExtractor_ = nullptr;
+    std::shared_ptr<const SchemaExtractor> schemaExtractor_;
+    bool useSchemaExtractor_ = false;
+    RecordVerification verification_;
+
+    // Indexed columns, in the order keys are extracted
+    struct IndexColumn {
+        const std::string* name;
+        Index* index;
+        std::vector<IndexEntry>* pending;  // This column's pendingEntries_ slot
+    };
+    std::vector<IndexColumn> indexColumns_;
+    std::vector<int> indexOrdinals_;  // TableDef ordinal per column entry of indexColumns_
+    bool geoIndexed_ = false;         // indexColumns_ entry after the columns is the spatial index
+    std::vector<Value> keyBuffer_;    // Reused by onIngest
+
+    // Composite indexes, the last indexColumns_ entries, and the columns
+    // their keys are encoded from (getOrdinals() of each in turn)
+    std::vector<CompositeIndex*> composites_;
+    std::vector<int> compositeOrdinals_;
+
+    // Columns ordinals[0..count) of one record into values
+    void extractColumns(const uint8_t* data, size_t length, const int* ordinals, size_t count,
+                        Value* values) const;
+
+    // Field of a record as a view: from the view or schema extractor, else
+    // extracted through the field extractor into scratch
+    ValueView fieldView(const uint8_t* data, size_t length, const std::string& column, Value& scratch) const;
+
+    // Whether column has a full-text index (which answers no ranges)
+    bool fullTextColumn(const std::string& column) const;
+
+    // Index of the kind the column's attributes ask for
+    std::unique_ptr<Index> createColumnIndex(const ColumnDef& col) const;
+
+    // Add rows [beginRow, endRow) of recordInfos_ to index, keyed by column col
+    void fillIndex(Index* index, int col, size_t beginRow, size_t endRow);
+
+    // Stored records an index evolve() added has yet to take: rows
+    // [nextRow, endRow) of recordInfos_, endRow being the row count then
+    struct Backfill {
+        std::string column;
+        int ordinal;
+        size_t nextRow;
+        size_t endRow;
+    };
+    std::vector<Backfill> backfills_;
+    bool backfilling(const std::string& column) const;
+
+    // Schema extractors evolve() replaced; the fields of functions handed
+    // out before still read through them
+    std::vector<std::shared_ptr<const SchemaExtractor>> retiredExtractors_;
+
+    // Index keys of one record into keys (indexColumns_ order; keys may
+    // hold column values past them)
+    void extractKeys(const uint8_t* data, size_t length, std::vector<Value>& keys) const;
+
+    // Extract keys for pendingRecords_ in parallel into pendingEntries_
+    void extractPendingRecords();
+
+    // Append rows for records not yet in the column caches or zone maps
+    void fillColumnCaches();
+
+    // Materialized columns, indexed like tableDef_.columns (grown only by evolve())
+    ColumnCacheSlots columnCaches_;
+    bool hasColumnCaches_ = false;
+
+    // Zone maps and Bloom filters, indexed like tableDef_.columns (grown
+    // only by evolve()); hasZoneMaps_ is set once either kind is enabled
+    ZoneMapSlots zoneMaps_;
+    ZoneBloomSlots bloomFilters_;
+    bool hasZoneMaps_ = false;
 
     // Per-table record tracking (for source-specific tables)
-    std::vector<StreamingFlatBufferStore::FileRecordInfo> recordInfos_;
+    StreamingFlatBufferStore::RecordInfoList recordInfos_;
+
+    std::unique_ptr<SubscriptionSet> subscriptions_;
+
+    // Calls visit for each record not in tombstones (may be nullptr)
+    void scanLive(const DeletionBitmap* tombstones, const MaterializedAggregate::RecordVisitor& visit) const;
+
+    std::vector<std::unique_ptr<MaterializedAggregate>> aggregates_;
+
+    // Upsert mode: key column (empty when off), each key's current
+    // version by its encoded bytes, and with keepHistory the version each
+    // sequence replaced
+    struct UpsertVersion {
+        uint64_t sequence;
+        uint64_t offset;
+        uint32_t length;
+    };
+    std::string upsertColumn_;
+    int upsertOrdinal_ = -1;
+    bool keepHistory_ = false;
+    std::unordered_map<std::string, UpsertVersion> upsertCurrent_;
+    std::unordered_map<uint64_t, uint64_t> upsertPrevious_;
+    std::string upsertKeyScratch_;
+    UpsertVersion* upsertSlot(const uint8_t* data, size_t length);
+};
+
+class FlatSQLDatabase;
+
+/**
+ * How long a table keeps its records (FlatSQLDatabase::setRetentionPolicy).
+ * A record expires once its timestampColumn value is more than maxAge
+ * before the time given to applyRetention(), or once it is no longer among
+ * the table's newest records that fit in maxBytes (counting size
+ * prefixes). 0 disables either limit; a NULL timestamp never ages out.
+ */
+struct RetentionPolicy {
+    std::string timestampColumn;
+    double maxAge = 0;
+    uint64_t maxBytes = 0;
+};
+
+/**
+ * Read-only query connection over a FlatSQLDatabase, for use on a thread
+ * other than the one ingesting. Each statement sees the records published
+ * when it started; ingest on the owning database continues meanwhile.
+ *
+ * The session shares storage and indexes with its database, which must
+ * outlive it. Deletes, compaction and schema changes on the database are
+ * not safe while sessions are running queries.
+ */
+class ReadSession {
+public:
+    QueryResult query(const std::string& sql);
+    QueryResult query(const std::string& sql, const std::vector<Value>& params);
+    std::unique_ptr<QueryCursor> openCursor(const std::string& sql,
+                                            const std::vector<Value>& params = {});
+
+    // Read as of sequence (0 = latest), so several queries report on the
+    // same records; see SQLiteEngine::setAsOfSequence
+    void setAsOfSequence(uint64_t sequence) { engine_->setAsOfSequence(sequence); }
+    uint64_t getAsOfSequence() const { return engine_->getAsOfSequence(); }
+
+private:
+    friend class FlatSQLDatabase;
+    ReadSession() : engine_(std::make_unique<SQLiteEngine>()) {}
+
+    std::unique_ptr<SQLiteEngine> engine_;
 };
 
 /**
@@ -114,10 +500,29 @@ private:
 class FlatSQLDatabase {
 public:
     // Create from schema
-    explicit FlatSQLDatabase(const DatabaseSchema& schema);
-
-    // Create from schema source (IDL or JSON)
-    static FlatSQLDatabase fromSchema(const std::string& source, const std::string& dbName = "default");
+    explicit FlatSQLDatabase(const DatabaseSchema& schema,
+                             const StorageOptions& storageOptions = StorageOptions(),
+                             IndexEngine indexEngine = IndexEngine::Sqlite);
+
+    // Create from schema source (IDL or JSON). Tables of an IDL schema read
+    // their fields with generated extractors (see useSchemaExtractors) until
+    // setFieldExtractor replaces them.
+    static FlatSQLDatabase fromSchema(const std::string& source, const std::string& dbName = "default",
+                                      const StorageOptions& storageOptions = StorageOptions(),
+                                      IndexEngine indexEngine = IndexEngine::Sqlite);
+
+    // Same, from a schema compiled ahead of time (SchemaParser::compile), so
+    // no schema text is parsed at start-up
+    static FlatSQLDatabase fromCompiledSchema(const uint8_t* compiled, size_t length,
+                                              const StorageOptions& storageOptions = StorageOptions(),
+                                              IndexEngine indexEngine = IndexEngine::Sqlite);
+
+    // Syncs file-backed storage so the next open can skip re-indexing
+    ~FlatSQLDatabase();
+
+    // Install a SchemaExtractor on every table whose columns carry a known
+    // FlatBuffer layout (IDL-parsed schemas). Call before ingesting.
+    void useSchemaExtractors();
 
     // Register a file identifier -> table mapping
     // Call this before ingesting to enable routing
@@ -133,9 +538,37 @@ public:
     // File identifier is read from bytes 4-7
     uint64_t ingestOne(const uint8_t* flatbuffer, size_t length);
 
+    /**
+     * Stream ingest without a staging copy: write up to bytes of the
+     * size-prefixed stream at the pointer reserveIngest() returns (the
+     * storage tail itself), then call commitIngest() with the bytes
+     * written. Returns the records committed; a trailing partial record
+     * waits there for the next chunk. See StreamingFlatBufferStore::reserveIngest.
+     */
+    uint8_t* reserveIngest(size_t bytes);
+    size_t commitIngest(size_t bytes);
+
     // Load existing stream data and rebuild indexes
     void loadAndRebuild(const uint8_t* data, size_t length);
 
+    /**
+     * Bring tables up to date with records already present in file-backed
+     * (StorageMode::MappedFile) storage. Call once after registerFileId()
+     * and the extractor setters.
+     *
+     * Index tables are copied back from the sidecar written by sync(); only
+     * records appended after that sync go through the field extractors.
+     * Source routing from ingestWithSource() is not persisted.
+     *
+     * @return true if indexes were restored from the sidecar, false if every
+     *         stored record had to be re-indexed
+     */
+    bool reopen();
+
+    // Flush file-backed storage and write the storage and index sidecars
+    // (no-op for in-memory storage)
+    void sync();
+
     // Execute SQL query (uses SQLite virtual tables)
     QueryResult query(const std::string& sql);
 
@@ -145,6 +578,145 @@ public:
     // Execute SQL query with a single integer parameter (most optimized for int key lookups)
     QueryResult query(const std::string& sql, int64_t param);
 
+    // Execute SQL query into an arena-backed result (see ArenaQueryResult),
+    // for large results; reuse out across queries to reuse its arena
+    void query(const std::string& sql, const std::vector<Value>& params, ArenaQueryResult& out);
+
+    /**
+     * Reuse results of repeated query() calls (same SQL and parameters)
+     * while the tables they read are unchanged, keeping up to about
+     * capacityBytes of results (0 turns the cache off, the default). See
+     * SQLiteEngine::setResultCacheSize for what is cached.
+     */
+    void setResultCacheSize(size_t capacityBytes) { sqliteEngine_->setResultCacheSize(capacityBytes); }
+
+    // Hits, misses, invalidations and size of the result cache
+    ResultCacheStats getResultCacheStats() const { return sqliteEngine_->getResultCacheStats(); }
+
+    /**
+     * Point-in-time reads: query(), cursors, prepared lookups and
+     * aggregate() see only records up to sequence until it is reset to 0
+     * (see SQLiteEngine::setAsOfSequence). Ingest continues meanwhile, so
+     * a report taken at getVisibleSequence() can be rerun unchanged.
+     */
+    void setAsOfSequence(uint64_t sequence) { sqliteEngine_->setAsOfSequence(sequence); }
+    uint64_t getAsOfSequence() const { return sqliteEngine_->getAsOfSequence(); }
+
+    // Latest published sequence, the watermark of an AS-OF query now
+    uint64_t getVisibleSequence() const { return storage_.getVisibleSequence(); }
+
+    // Entry limits and counters of the statement, parse and name caches
+    // (see SQLiteEngine::setCacheLimits)
+    void setCacheLimits(const EngineCacheLimits& limits) { sqliteEngine_->setCacheLimits(limits); }
+    EngineCacheStats getCacheStats() const { return sqliteEngine_->getCacheStats(); }
+
+    // Per-query counters and timings of query() calls, also readable as
+    // SELECT * FROM flatsql_stats (see SQLiteEngine::setQueryStatsEnabled)
+    void setQueryStatsEnabled(bool enabled) { sqliteEngine_->setQueryStatsEnabled(enabled); }
+    std::vector<QueryStats> getQueryStats() const { return sqliteEngine_->getQueryStats(); }
+    QueryStats getLastQueryStats() const { return sqliteEngine_->getLastQueryStats(); }
+
+    /**
+     * Track unindexed columns that full scans filter on (see IndexAdvisor;
+     * off by default). A column is due for an index once the scans
+     * filtering on it have walked rowThreshold rows in all.
+     */
+    void setIndexAdvisorEnabled(bool enabled, uint64_t rowThreshold = IndexAdvisor::DEFAULT_ROW_THRESHOLD);
+
+    // Columns full scans filtered on, most rows scanned first
+    std::vector<IndexRecommendation> getIndexRecommendations() const {
+        return sqliteEngine_->getIndexAdvisor().recommendations();
+    }
+
+    /**
+     * Build indexes for up to maxIndexes columns the advisor has found due,
+     * most rows scanned first (see TableStore::addIndex). Each is filled
+     * from the table's records in this call, so the writer can run it
+     * between ingests, like compactStep(); later statements plan with it.
+     * Not safe while read sessions or cursors are open, or inside an ingest
+     * batch.
+     *
+     * @return indexes built
+     * @throws std::runtime_error during compaction
+     */
+    size_t buildAdvisedIndexes(size_t maxIndexes = 1);
+
+    /**
+     * Index keyColumns of a table together, with includeColumns carried
+     * in the entries (see TableStore::addCompositeIndex). Queries with
+     * equalities on leading key columns and at most a range on the next
+     * one scan it, and those reading only its columns are answered from
+     * the index without fetching records. Filled in this call; same
+     * restrictions as buildAdvisedIndexes().
+     *
+     * @throws std::runtime_error if the table does not exist, during
+     *         compaction, or for a bad declaration
+     */
+    void addCompositeIndex(const std::string& tableName, const std::string& name,
+                           const std::vector<std::string>& keyColumns,
+                           const std::vector<std::string>& includeColumns = {});
+
+    /**
+     * Move to a newer version of the schema without re-ingesting. Each
+     * table of schema must keep the columns it has, in order and with the
+     * same types and field IDs, and may add columns after them or mark
+     * current ones indexed, as FlatBuffers' own evolution rules allow; new
+     * tables are added. Records written before lack the added fields,
+     * which read as their defaults or NULL. Indexes are never dropped.
+     *
+     * Indexes on added or newly indexed columns take records ingested from
+     * now on at once; the records already stored are indexed by
+     * backfillStep(), and queries plan with an index once it is complete.
+     * Source tables evolve with their base table and unified views are
+     * re-created. Not safe while read sessions or cursors are open, or
+     * inside an ingest batch.
+     *
+     * @return the schema version now in use (the first schema is version
+     *         1; a schema that changes nothing keeps the version)
+     * @throws std::runtime_error for an incompatible change, or during
+     *         compaction
+     */
+    uint32_t evolveSchema(const DatabaseSchema& schema);
+    uint32_t evolveSchema(const std::string& source);
+    uint32_t getSchemaVersion() const { return schemaVersion_; }
+
+    /**
+     * Index up to maxRecords stored records for the indexes evolveSchema()
+     * added, oldest first, so the writer can spread the work between
+     * ingests like compactStep(). Later statements plan with each index
+     * once it is complete. Not safe while read sessions or cursors are
+     * open, or inside an ingest batch.
+     *
+     * @return true once no index is left to fill
+     * @throws std::runtime_error during compaction
+     */
+    bool backfillStep(size_t maxRecords = 64 * 1024);
+
+    /**
+     * Resolve a point lookup on an indexed column once, for callers that
+     * probe it repeatedly (see PreparedLookup). Must not outlive this
+     * database.
+     *
+     * @throws std::runtime_error if the table or its index does not exist
+     */
+    PreparedLookup prepareLookup(const std::string& tableName, const std::string& columnName);
+
+    /**
+     * Prepare a query for row-at-a-time reading, so memory stays bounded
+     * by one row (or one fetch() batch) however large the result is.
+     * The cursor must be destroyed before this database.
+     */
+    std::unique_ptr<QueryCursor> openCursor(const std::string& sql,
+                                            const std::vector<Value>& params = {});
+
+    /**
+     * Open a read-only connection that can query from another thread while
+     * this database keeps ingesting. Call from the ingesting thread, after
+     * file IDs, extractors and views are set up. Requires non-relocating
+     * storage (StorageMode::Segmented or StorageMode::MappedFile).
+     */
+    std::unique_ptr<ReadSession> openReadSession();
+
     // Execute and count without building QueryResult (for benchmarking)
     size_t queryCount(const std::string& sql, const std::vector<Value>& params = {});
 
@@ -154,6 +726,13 @@ public:
                                           const std::string& column,
                                           const Value& value);
 
+    // Zero-copy lookups and scan (see TableStore::viewByIndex); an unknown
+    // table gives an empty range
+    RecordRange viewByIndex(const std::string& tableName, const std::string& column, const Value& value) const;
+    RecordRange viewByRange(const std::string& tableName, const std::string& column,
+                            const Value& minValue, const Value& maxValue) const;
+    RecordRange viewAll(const std::string& tableName) const;
+
     // Direct point lookup for unique keys - returns true if found
     // Most efficient for primary key lookups
     bool findOneByIndex(const std::string& tableName,
@@ -170,6 +749,16 @@ public:
                                   uint32_t* outLength,
                                   uint64_t* outSequence = nullptr);
 
+    // Planner statistics of a column index (throws if there is none)
+    IndexStats getIndexStats(const std::string& tableName, const std::string& column) const;
+
+    // Batched point lookup - resolves all keys in one index pass (sorted,
+    // duplicates and NULLs dropped). Entries come back grouped by key in
+    // ascending key order; read records via getStorage().getDataAtOffset.
+    std::vector<IndexEntry> findManyByIndex(const std::string& tableName,
+                                            const std::string& column,
+                                            std::vector<Value> keys);
+
     // Direct iteration over all records - bypasses SQLite completely
     // Callback receives raw FlatBuffer data for zero-copy access
     // Returns count of records iterated
@@ -202,9 +791,190 @@ public:
     // Set batch extractor for a table (optional, for efficient batch extraction)
     void setBatchExtractor(const std::string& tableName, TableStore::BatchExtractor extractor);
 
+    // Set view extractor for a table (optional, see TableStore::setFieldViewExtractor)
+    void setFieldViewExtractor(const std::string& tableName, TableStore::FieldViewExtractor extractor);
+
+    // Set index key extractor for a table (optional, one call per record
+    // for all indexed columns instead of one per column)
+    void setKeyExtractor(const std::string& tableName, TableStore::KeyExtractor extractor);
+
+    /**
+     * Materialize a numeric column of a table into a fixed-width array with
+     * a null bitmap, kept current on ingest. Full scans, SUM/AVG and other
+     * aggregates read the array instead of decoding each FlatBuffer.
+     * Requires the table's field extractor; call before openReadSession().
+     */
+    void enableColumnCache(const std::string& tableName, const std::string& columnName);
+
+    /**
+     * Summarize a numeric column of a table by min/max per zone of 4096
+     * records, kept current on ingest. Full scans with a comparison on the
+     * column skip zones that cannot match, which pays off when the column
+     * follows arrival order (timestamps, sequence numbers). Requires the
+     * table's field extractor; call before openReadSession().
+     */
+    void enableZoneMap(const std::string& tableName, const std::string& columnName);
+
+    /**
+     * Keep a Bloom filter per zone of 4096 records for a string column, at
+     * about a byte per record. A full scan looking for one value of the
+     * column (col = 'text') skips zones that cannot hold it, which suits
+     * rarely queried high-cardinality identifiers that don't warrant an
+     * index. Requires the table's field extractor; call before
+     * openReadSession().
+     */
+    void enableBloomFilter(const std::string& tableName, const std::string& columnName);
+
+    /**
+     * Spread index key extraction during ingest over a worker pool.
+     * Framing and copying stay on the calling thread, so sequences and
+     * offsets are unchanged; each chunk's keys are then extracted in
+     * parallel and written to every index in stream order.
+     *
+     * @param threads Threads per chunk including the caller
+     *                (0 = hardware concurrency, 1 = extract inline)
+     *
+     * Field extractors must be safe to call from several threads at once.
+     */
+    void setIngestThreads(size_t threads);
+
+    /**
+     * Compute aggregates over every live record of a table or unified view
+     * (one GROUP BY column optional) on the scan pool, outside SQLite.
+     * Each source table is cut into row ranges that workers aggregate
+     * independently; the partial results are then merged. Column caches
+     * are read where enabled, other columns through the field extractor.
+     *
+     * The result has the group column (if any) followed by one column per
+     * aggregate (see AggregateSpec::label), one row per group in key order
+     * with NULL first, like SELECT groupBy, ... GROUP BY groupBy.
+     *
+     * @throws std::runtime_error for an unknown table or column, or SUM/AVG
+     *         of a non-numeric column
+     */
+    QueryResult aggregate(const std::string& tableName, const std::vector<AggregateSpec>& aggregates,
+                          const std::string& groupBy = "");
+
+    // The same as partial states, for merging with other databases' (see
+    // ShardedDatabase); the states point at aggregates, which must outlive them
+    AggregateGroups aggregateGroups(const std::string& tableName, const std::vector<AggregateSpec>& aggregates,
+                                    const std::string& groupBy = "");
+
+    /**
+     * Threads used by aggregate() including the caller (0 = hardware
+     * concurrency, 1 = scan inline). Field extractors must then be safe to
+     * call from several threads at once.
+     */
+    void setScanThreads(size_t threads);
+
+    /**
+     * Keep GROUP BY aggregates of a table up to date as records are
+     * ingested and deleted (see MaterializedAggregate), queryable as the
+     * read-only table name, e.g. for SELECT COUNT(*), MAX(epoch) ... GROUP
+     * BY originator:
+     *
+     *   db.createMaterializedAggregate("by_originator", "MPE",
+     *       {"ORIGINATOR", {{Op::Count, ""}, {Op::Max, "EPOCH"}}, {}});
+     *   db.query("SELECT ORIGINATOR, \"MAX(EPOCH)\" FROM by_originator");
+     *
+     * Columns are the group column, the aggregate labels and LAST(column)
+     * for each last column; there is one row per group with records (one
+     * row in all without groupBy). Existing records are counted now.
+     * Reads cost one row per group. The table is queried through this
+     * database only, not through read sessions.
+     *
+     * @throws std::runtime_error for an unknown table or column, a name
+     *         already in use, or a table without a field extractor
+     */
+    void createMaterializedAggregate(const std::string& name, const std::string& tableName,
+                                     const MaterializedAggregateDef& def);
+
+    /**
+     * Expose junction, one of junctions', as the read-only table junction.name,
+     * with the columns of its child table when that is one of this
+     * database's tables (see JunctionManager::registerTables).
+     *
+     * @throws std::runtime_error for a name already in use
+     */
+    void createJunctionTable(JunctionManager& junctions, const JunctionTable& junction);
+
+    // Managers whose junction rows hold this database's sequences, so
+    // compaction renumbers them (JunctionManager attaches and detaches itself)
+    void attachJunctions(JunctionManager* junctions) { junctionManagers_.push_back(junctions); }
+    void detachJunctions(JunctionManager* junctions);
+
     // Get raw storage data (for export)
     std::vector<uint8_t> exportData() const { return storage_.exportData(); }
 
+    // Records ingested after a sequence watermark, e.g. the last sequence
+    // a client or backup has (see StreamingFlatBufferStore::exportSince)
+    std::vector<uint8_t> exportSince(uint64_t sequence) const { return storage_.exportSince(sequence); }
+
+    // Export in spans that point into storage, without building a copy;
+    // returns the last sequence exported (see StreamingFlatBufferStore::beginExport)
+    uint64_t exportChunks(const StreamingFlatBufferStore::ExportCallback& callback,
+                          uint64_t afterSequence = 0) const {
+        return storage_.exportChunks(callback, afterSequence);
+    }
+    StreamingFlatBufferStore::ExportCursor beginExport(uint64_t afterSequence = 0) const {
+        return storage_.beginExport(afterSequence);
+    }
+    bool nextExportChunk(StreamingFlatBufferStore::ExportCursor& cursor, const uint8_t** data,
+                         size_t* length) const {
+        return storage_.nextExportChunk(cursor, data, length);
+    }
+
+    // ==================== Replication ====================
+
+    /**
+     * Make this database a replication leader: from now on markDeleted()
+     * and clearTombstones() are logged, so followers can tail the stream
+     * and its deletes with pullReplication(). Records ingested before
+     * (and tombstones set before) reach followers through the snapshot a
+     * new follower starts with.
+     */
+    void enableReplicationLog();
+    bool isReplicationLogEnabled() const { return replicationLog_ != nullptr; }
+
+    /**
+     * The next replication frame for a follower at position: records
+     * after position.sequence, up to about maxBytes (at least one record),
+     * then the logged deletes after position.deletes whose records the
+     * follower will then have. Records are copied out of storage but not
+     * re-extracted or verified, and a follower applies them with
+     * applyReplication() without verifying them again.
+     *
+     * A default position starts the follower with a snapshot of the whole
+     * stream, whose last frame carries the current tombstones. Compacting
+     * the leader starts a new epoch: followers from an older one (or one
+     * whose deletes were trimmed) must start over from an empty database.
+     *
+     * @throws std::runtime_error without enableReplicationLog(), or when
+     *         the follower cannot continue from position
+     */
+    std::vector<uint8_t> pullReplication(const ReplicationPosition& position,
+                                         size_t maxBytes = 4 * 1024 * 1024) const;
+
+    // Where a follower would start now to be current (the stream's end)
+    ReplicationPosition getReplicationHead() const;
+
+    // Drop logged deletes every follower has applied (positions they report)
+    void trimReplicationLog(const ReplicationPosition& applied);
+
+    /**
+     * Apply a frame from the leader's pullReplication() as a follower:
+     * ingest its records in order (they get the leader's sequences) and
+     * then its deletes. Frames must be applied in order: one continues
+     * from getReplicaPosition(), where the previous one ended. A follower
+     * must not ingest or delete on its own, or its sequences diverge.
+     * Source routing from ingestWithSource() is not replicated.
+     *
+     * @return the new position, to pull the next frame from
+     * @throws std::runtime_error for a malformed or out-of-order frame
+     */
+    ReplicationPosition applyReplication(const uint8_t* frame, size_t length);
+    const ReplicationPosition& getReplicaPosition() const { return replicaPosition_; }
+
     // Get schema
     const DatabaseSchema& getSchema() const { return schema_; }
 
@@ -220,9 +990,31 @@ public:
         std::string fileId;
         uint64_t recordCount;
         std::vector<std::string> indexes;
+        uint64_t memoryBytes = 0;  // TableMemory::total(), SQLite index pages aside
     };
     std::vector<TableStats> getStats() const;
 
+    /**
+     * Bytes held by the stream and its record tables, by each table's
+     * record list, indexes, caches and tombstones, and by the SQLite
+     * connection and result cache. Measuring index pages walks SQLite's
+     * dbstat table, so this is for monitoring, not every ingest.
+     */
+    MemoryUsage getMemoryUsage() const;
+
+    /**
+     * Bound the footprint (see MemoryLimits; default none). The limits
+     * watch MemoryUsage::total() without dbstat, measured again after
+     * every MEMORY_CHECK_BYTES of stream growth; between measurements
+     * ingested bytes are added to the last one. Compaction by the soft
+     * limit, like compact(), is not safe while read sessions run queries.
+     */
+    void setMemoryLimits(const MemoryLimits& limits);
+    MemoryLimits getMemoryLimits() const { return memoryLimits_; }
+    MemoryLimitStats getMemoryLimitStats() const { return memoryLimitStats_; }
+
+    static constexpr uint64_t MEMORY_CHECK_BYTES = 1024 * 1024;
+
     // ==================== Multi-Source API ====================
 
     /**
@@ -243,7 +1035,8 @@ public:
     /**
      * Create unified views for cross-source queries.
      *
-     * Creates views like "User" that UNION ALL User@siteA, User@siteB, etc.
+     * Creates views like "User" over User@siteA, User@siteB, etc. (see
+     * SQLiteEngine::createUnifiedView).
      * Call this after registering all sources and before querying.
      */
     void createUnifiedViews();
@@ -300,6 +1093,29 @@ public:
      */
     void markDeleted(const std::string& tableName, uint64_t sequence);
 
+    // Mark a batch of records as deleted, looking the table up once
+    void markDeleted(const std::string& tableName, const std::vector<uint64_t>& sequences);
+
+    /**
+     * Latest-wins ingest for tableName, keyed by its primary key (one
+     * column, unencrypted): a record whose key was already ingested
+     * becomes the key's version, and the one it replaces is tombstoned as
+     * markDeleted() would, so queries and findOneByIndex() see only the
+     * newest. Existing records are resolved the same way, in sequence
+     * order, when the mode is enabled. Records with a NULL key are kept
+     * as they are. With keepHistory, getVersions() also lists the
+     * versions each key replaced until compaction drops them. Like
+     * markDeleted(), not safe while read sessions run queries.
+     *
+     * @throws std::runtime_error for an unknown table, one without a
+     *         single primary key column, or during compaction
+     */
+    void setUpsertMode(const std::string& tableName, bool enabled, bool keepHistory = false);
+
+    // Sequences of key's versions in an upsert table, newest first (empty
+    // if the key has none); older ones only with keepHistory
+    std::vector<uint64_t> getVersions(const std::string& tableName, const Value& key) const;
+
     /**
      * Get count of deleted records for a table.
      */
@@ -310,6 +1126,86 @@ public:
      */
     void clearTombstones(const std::string& tableName);
 
+    /**
+     * Rewrite storage without deleted records, one slice per call, so the
+     * writer can interleave compaction with ingest. Each step copies live
+     * records in stream order into a new stream; records ingested between
+     * steps are picked up by later ones. The step that catches up swaps the
+     * new stream in, renumbers sequences (rowids) densely, rebuilds indexes
+     * and column caches and drops the tombstones of the removed records.
+     * Records deleted after they were copied stay tombstoned.
+     *
+     * Rowids held from before compaction are stale once it finishes. Not
+     * safe while read sessions or cursors are open, or inside an ingest
+     * batch.
+     *
+     * @param maxBytes  Record bytes to copy in this step (at least one record)
+     * @return true when compaction finished, false if more steps are needed
+     * @throws std::runtime_error for file-backed (MappedFile) storage
+     */
+    bool compactStep(size_t maxBytes = 4 * 1024 * 1024);
+
+    // Run compaction to completion
+    void compact();
+
+    /**
+     * Cluster tableName's records by column in later compactions: instead
+     * of keeping stream order, the step that finishes a compaction writes
+     * the table's live records as one run sorted by the column's value
+     * (NULLs first, ties in stream order) after every other record, so
+     * rowids follow the key. Range scans through the column's index then
+     * read contiguous memory and zone maps on it tighten to narrow ranges.
+     * That step copies every record of the table whatever its maxBytes.
+     * An empty column turns clustering off.
+     *
+     * @throws std::runtime_error for an unknown table or column, or while
+     *         a compaction is in progress
+     */
+    void setClusterKey(const std::string& tableName, const std::string& column);
+
+    /**
+     * Compress sealed storage chunks other than the keepHot newest (see
+     * StreamingFlatBufferStore::compressColdSegments). Queries decompress
+     * cold chunks on demand into a cache of StorageOptions::coldCacheSegments
+     * chunks, while recent records keep raw access. Call it from the writer
+     * as records age out, like compactStep(); not safe while read sessions
+     * or cursors are open, or inside an ingest batch.
+     *
+     * @return bytes of memory released
+     * @throws std::runtime_error unless storage is Segmented
+     */
+    size_t compressColdSegments(size_t keepHot = 1);
+
+    /**
+     * Expire tableName's records by age, size or both (see RetentionPolicy)
+     * when applyRetention() runs; a default policy removes it.
+     * @throws std::runtime_error for an unknown table or timestamp column
+     */
+    void setRetentionPolicy(const std::string& tableName, const RetentionPolicy& policy);
+
+    /**
+     * Drop whole sealed storage segments from the front of the stream once
+     * every record in them has expired, like a ring buffer: the segment's
+     * memory is freed, its index entries are range-deleted and its records
+     * count as deleted through one floor per tombstone bitmap rather than a
+     * bit each. Expiry stops at the first segment holding a live record or
+     * one of a table without a policy, so tables sharing a stream age out
+     * together. now is in the timestamp columns' units (ignored by size
+     * limits).
+     *
+     * Evicted sequences are never reused, and their rows in the record
+     * lists are reclaimed by compact(). Followers cannot start from before
+     * the first kept record and apply retention themselves. Writer-only,
+     * like compressColdSegments().
+     *
+     * @return bytes of memory released
+     * @throws std::runtime_error unless storage is Segmented
+     */
+    size_t applyRetention(double now = 0);
+
+    // Whether a compaction has started and not yet finished
+    bool isCompacting() const { return compaction_ != nullptr; }
+
     // ==================== Encryption API ====================
 
     /**
@@ -343,7 +1239,9 @@ public:
 
     /**
      * Enable HMAC verification on ingest.
-     * When enabled, ingestOne() will reject buffers that fail HMAC verification.
+     * When enabled, records are only accepted through ingestVerified() and
+     * ingestOneVerified(), which reject buffers that fail HMAC verification;
+     * the unauthenticated ingest calls throw.
      * Requires an encryption key to be set first.
      *
      * @param enabled  true to enable, false to disable
@@ -373,14 +1271,166 @@ public:
      */
     bool verifyHMAC(const uint8_t* buffer, size_t length, const uint8_t* mac) const;
 
+    /**
+     * Ingest size-prefixed FlatBuffers with their HMACs: macs holds
+     * macCount MACs of 32 bytes (computeHMAC() of each FlatBuffer without
+     * its size prefix) in stream order. Records past the last MAC are left
+     * unconsumed like an incomplete tail.
+     *
+     * Every record is verified before any is stored, spread over the ingest
+     * pool when there is one (setIngestThreads), so a batch is committed
+     * whole or not at all.
+     *
+     * @return bytes consumed
+     * @throws std::runtime_error naming the first record that fails, or
+     *         when no key is set or HMAC is unavailable in this build
+     */
+    size_t ingestVerified(const uint8_t* data, size_t length, const uint8_t* macs, size_t macCount,
+                          size_t* recordsIngested = nullptr);
+
+    // ingestOne() of a FlatBuffer checked against its 32-byte HMAC first
+    uint64_t ingestOneVerified(const uint8_t* flatbuffer, size_t length, const uint8_t* mac);
+
+    // ==================== Record Verification ====================
+
+    /**
+     * Check records against their table's schema (SchemaExtractor::verify)
+     * before queries read them; tables added later for a source take their
+     * base table's mode. Trusted, the default, checks nothing.
+     *
+     * Strict verifies every record of an ingest call bound for the table,
+     * spread over the ingest pool (setIngestThreads), before any record of
+     * the call is stored, and throws naming the first malformed one. The
+     * zero-copy reserveIngest() has no way to reject a record, so it throws
+     * while a table is Strict.
+     *
+     * Lazy stores records unchecked and verifies each the first time a
+     * query reads it, failing that statement if it is malformed; the
+     * outcome is kept per sequence. Index keys are still read at ingest, so
+     * Lazy suits tables read through schema extractors, which bounds-check
+     * every field.
+     *
+     * @throws std::runtime_error if the table does not exist
+     */
+    void setVerificationMode(VerificationMode mode);
+    void setVerificationMode(const std::string& tableName, VerificationMode mode);
+    VerificationMode getVerificationMode(const std::string& tableName) const;
+
+    // Records of tableName found malformed, by queries (Lazy) or by
+    // rejected ingest calls (Strict)
+    uint64_t getVerificationFailures(const std::string& tableName) const;
+
+    /**
+     * Call callback with each record ingested from now on into tableName
+     * (a table or "table@source") that passes every filter, instead of
+     * polling with SELECT ... WHERE. Records are matched as they are
+     * ingested, looking equality filters up by value; callbacks run once
+     * the batch is published, so they may query (and see the record).
+     *
+     * @return Subscription ID for unsubscribe()
+     * @throws std::runtime_error for an unknown table or column
+     */
+    uint64_t subscribe(const std::string& tableName, const std::vector<SubscriptionFilter>& filters,
+                       SubscriptionCallback callback);
+
+    // false if the subscription does not exist (any more)
+    bool unsubscribe(uint64_t subscriptionId);
+
 private:
+    FlatSQLDatabase(const DatabaseSchema& schema, const StorageOptions& storageOptions,
+                    IndexEngine indexEngine, bool schemaExtractors);
+
+    // Throws while setHMACVerification(true) requires MACs
+    void requireUnauthenticatedIngest() const;
+    const HmacSha256& hmacKey() const;
+
+    size_t ingestStream(const uint8_t* data, size_t length, size_t* recordsIngested);
+    uint64_t ingestSingle(const uint8_t* flatbuffer, size_t length);
+
+    // Memory limits: the footprint measured at memoryCheckedAt_ stream
+    // bytes, and whether it was over the soft limit
+    MemoryLimits memoryLimits_;
+    MemoryLimitStats memoryLimitStats_;
+    uint64_t memoryCheckedAt_ = 0;
+    bool memoryOverSoft_ = false;
+    uint64_t measureFootprint();
+    // Throws over the hard limit, counting bytes about to be ingested
+    void admitIngest(size_t bytes);
+    // After an ingest call: release caches (and compact) over the soft limit
+    void enforceMemoryLimits();
+
     // Callback for streaming ingest - routes to correct table and builds indexes
     void onIngest(std::string_view fileId, const uint8_t* data, size_t length,
                   uint64_t sequence, uint64_t offset);
 
-    // Callback for source-aware ingest - routes to source-specific table
+    // Packed file ID (StreamingFlatBufferStore::packFileId) -> table. A
+    // schema has a handful of file IDs, so a scan beats hashing a string.
+    using FileIdRoutes = std::vector<std::pair<uint32_t, TableStore*>>;
+    static void setFileIdRoute(FileIdRoutes& routes, const std::string& fileId, TableStore* table);
+    static TableStore* routeFileId(const FileIdRoutes& routes, std::string_view fileId);
+
+    // Callback for source-aware ingest - routes to the source's tables
+    // (routes resolved once per call by the caller, nullptr if none)
     void onIngestWithSource(std::string_view fileId, const uint8_t* data, size_t length,
-                            uint64_t sequence, uint64_t offset, const std::string& source);
+                            uint64_t sequence, uint64_t offset, const FileIdRoutes* routes);
+    const FileIdRoutes* sourceRoutes(const std::string& source) const;
+
+    // Throws unless every record of an ingest call bound for a Strict
+    // table verifies; data is one FlatBuffer, or a size-prefixed stream
+    // whose trailing partial record is left out
+    void verifyIngest(const uint8_t* data, size_t length, bool sizePrefixed, const FileIdRoutes* routes);
+    bool strictVerification() const;
+
+    // Subscription matches of ingested records, delivered after publish
+    struct PendingMatch {
+        TableStore* table;
+        uint64_t subscription;
+        uint64_t sequence;
+        uint64_t offset;
+    };
+    // Tombstone the version a record ingested into an upsert table replaces
+    void supersedeRecord(TableStore* table, const uint8_t* data, size_t length,
+                         uint64_t sequence, uint64_t offset);
+    void matchSubscriptions(TableStore* table, const uint8_t* data, size_t length,
+                            uint64_t sequence, uint64_t offset);
+    void deliverMatches();
+    std::vector<PendingMatch> pendingMatches_;
+    SubscriptionSet::Matches matchScratch_;
+    std::unordered_map<uint64_t, TableStore*> subscriptionTables_;
+    uint64_t nextSubscriptionId_ = 1;
+    bool deliveringMatches_ = false;
+
+    // Restore index tables from the sidecar, returns the stream length they cover (0 if unusable)
+    uint64_t loadIndexSidecar();
+
+    // Buffers index writes for its scope and flushes them in one transaction
+    class IndexBatchScope;
+    void beginIndexBatch();
+    void finishIndexBatch();
+    bool indexBatchOwnsTxn_ = false;
+
+    // Compaction in progress (see compactStep)
+    struct Compaction;
+    std::unique_ptr<Compaction> compaction_;
+    void finishCompaction();
+    std::vector<JunctionManager*> junctionManagers_;
+
+    // Delete log when this database is a replication leader, and the
+    // follower's position in its leader's stream
+    std::unique_ptr<ReplicationLog> replicationLog_;
+    ReplicationPosition replicaPosition_;
+
+    // Retention policies by table, with the stream bytes of the table's
+    // records not yet evicted (counted through countedRows of its list)
+    struct Retention {
+        RetentionPolicy policy;
+        uint64_t retainedBytes = 0;
+        size_t countedRows = 0;
+    };
+    std::map<std::string, Retention> retention_;
+
+    // Column each clustered table's records are sorted by in compaction
+    std::map<std::string, std::string> clusterKeys_;
 
     // Initialize SQLite engine with registered tables
     void initializeSQLiteEngine();
@@ -388,6 +1438,10 @@ private:
     // Re-register a table with SQLite after extractor is set
     void updateSQLiteTable(const std::string& tableName);
 
+    // Let the registered virtual table of tableName plan with the index
+    // of column, under the keys updateSQLiteTable() gives it
+    void addSQLiteColumnIndex(const std::string& tableName, const std::string& column);
+
     // Create a source-specific table (e.g., User@siteA)
     void createSourceTable(const std::string& baseTableName, const std::string& source);
 
@@ -403,13 +1457,22 @@ private:
     }
 
     DatabaseSchema schema_;
+    StorageOptions storageOptions_;
     StreamingFlatBufferStore storage_;
+    IndexEngine indexEngine_;
     std::map<std::string, std::unique_ptr<TableStore>> tables_;
     std::map<std::string, std::string> fileIdToTable_;  // file_id -> table name
+    FileIdRoutes fileIdRoutes_;                         // Same, for the ingest path
 
     // Source tracking
     std::vector<std::string> registeredSources_;        // List of registered source names
-    std::map<std::string, std::string> sourceFileIdToTable_;  // "source:fileId" -> "table@source"
+    std::map<std::string, FileIdRoutes> sourceFileIdRoutes_;  // source -> its "table@source" routes
+
+    // Parallel key extraction for batched ingest (nullptr = inline)
+    std::unique_ptr<WorkerPool> ingestPool_;
+
+    // Workers for aggregate() scans (nullptr = inline)
+    std::unique_ptr<WorkerPool> scanPool_;
 
     // SQLite engine for query execution
     std::unique_ptr<SQLiteEngine> sqliteEngine_;
@@ -418,11 +1481,15 @@ private:
     // Track which tables have been registered with SQLite
     std::set<std::string> sqliteRegisteredTables_;
 
+    // Bumped by each evolveSchema() that changes the schema
+    uint32_t schemaVersion_ = 1;
+
     // Encryption
     std::unique_ptr<flatbuffers::EncryptionContext> encryptionCtx_;
 
-    // HMAC verification
+    // HMAC verification, with the key's pads precomputed (set with encryptionCtx_)
     bool hmacEnabled_ = false;
+    std::unique_ptr<HmacSha256> hmacKey_;
 };
 
 }  // namespace flatsql
@@ -0,0 +1,114 @@
+#ifndef FLATSQL_DELETION_BITMAP_H
+#define FLATSQL_DELETION_BITMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Set of deleted sequences, one bit per sequence.
+ *
+ * Sequences are dense per store, so a bitmap costs one bit per stored
+ * record and a membership test is a shift and a mask instead of a hash
+ * probe. Scans can also test a whole 64-sequence word at once (word())
+ * and skip runs with no deletes.
+ *
+ * Retention expires a whole prefix of the stream at once
+ * (expireThrough()): every sequence up to a floor counts as deleted
+ * without a bit each, and clear() leaves the floor in place.
+ *
+ * Writer-only like the rest of the delete path: marking must not race
+ * with queries.
+ */
+class DeletionBitmap {
+public:
+    // Mark sequence deleted; returns false if it already was
+    bool insert(uint64_t sequence) {
+        size_t index = static_cast<size_t>(sequence >> 6);
+        if (index >= words_.size()) {
+            words_.resize(index + 1, 0);
+        }
+        uint64_t bit = uint64_t(1) << (sequence & 63);
+        if (words_[index] & bit) return false;
+        words_[index] |= bit;
+        size_++;
+        version_++;
+        return true;
+    }
+
+    bool contains(uint64_t sequence) const {
+        if (sequence <= floor_) return true;
+        size_t index = static_cast<size_t>(sequence >> 6);
+        return index < words_.size() && ((words_[index] >> (sequence & 63)) & 1);
+    }
+
+    // Bits for sequences [index * 64, index * 64 + 64)
+    uint64_t word(size_t index) const {
+        uint64_t bits = index < words_.size() ? words_[index] : 0;
+        uint64_t first = uint64_t(index) << 6;
+        if (floor_ >= first + 63) return ~uint64_t(0);
+        if (floor_ >= first) bits |= (uint64_t(2) << (floor_ - first)) - 1;
+        return bits;
+    }
+    size_t wordCount() const { return words_.size(); }
+    size_t memoryBytes() const { return words_.capacity() * sizeof(uint64_t); }
+
+    // No sequence is deleted (none marked, none expired)
+    bool empty() const { return size_ == 0 && floor_ == 0; }
+
+    // Sequences marked deleted above the floor (expired ones are not counted)
+    size_t size() const { return size_; }
+
+    /**
+     * Treat every sequence up to sequence as deleted from now on; marks at
+     * or below it are dropped. The floor only rises.
+     */
+    void expireThrough(uint64_t sequence) {
+        if (sequence <= floor_) return;
+        size_t end = std::min(words_.size(), static_cast<size_t>((sequence >> 6) + 1));
+        for (size_t i = static_cast<size_t>(floor_ >> 6); i < end; i++) {
+            uint64_t first = uint64_t(i) << 6;
+            uint64_t mask = sequence >= first + 63 ? ~uint64_t(0) : (uint64_t(2) << (sequence - first)) - 1;
+            size_ -= static_cast<size_t>(__builtin_popcountll(words_[i] & mask));
+            words_[i] &= ~mask;
+        }
+        floor_ = sequence;
+        version_++;
+    }
+
+    // Highest expired sequence (0 = none)
+    uint64_t expiredThrough() const { return floor_; }
+
+    // Changes whenever the set does, for caches of what it filters
+    uint64_t version() const { return version_; }
+
+    // Drop every mark; expired sequences stay deleted
+    void clear() {
+        words_.clear();
+        size_ = 0;
+        version_++;
+    }
+
+    // Call fn(sequence) for each marked sequence, ascending (not the expired ones)
+    template <typename F>
+    void forEach(F&& fn) const {
+        for (size_t i = 0; i < words_.size(); i++) {
+            for (uint64_t bits = words_[i]; bits; bits &= bits - 1) {
+                fn((uint64_t(i) << 6) | static_cast<uint64_t>(__builtin_ctzll(bits)));
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+    uint64_t floor_ = 0;
+    uint64_t version_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_DELETION_BITMAP_H
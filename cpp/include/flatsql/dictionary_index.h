@@ -0,0 +1,121 @@
+#ifndef FLATSQL_DICTIONARY_INDEX_H
+#define FLATSQL_DICTIONARY_INDEX_H
+
+#include "flatsql/types.h"
+#include "flatsql/index.h"
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Set of ascending 32-bit ordinals in roaring-style containers: each run of
+ * 65536 ordinals is a sorted uint16 array while it holds up to
+ * ARRAY_LIMIT members and a 65536-bit bitmap after that, so sparse and
+ * dense postings both stay small. Ordinals must be added in ascending
+ * order.
+ */
+class PostingList {
+public:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+
+    void add(uint32_t ordinal);
+
+    // Call f(ordinal) for every member, ascending
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const Container& c : containers_) {
+            uint32_t base = c.high << 16;
+            if (c.bitmap.empty()) {
+                for (uint16_t low : c.array) f(base | low);
+                continue;
+            }
+            for (size_t w = 0; w < c.bitmap.size(); w++) {
+                for (uint64_t bits = c.bitmap[w]; bits; bits &= bits - 1) {
+                    f(base | static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits)));
+                }
+            }
+        }
+    }
+
+    size_t size() const { return size_; }
+    size_t memoryBytes() const;
+
+private:
+    struct Container {
+        uint32_t high = 0;             // ordinal >> 16
+        uint32_t count = 0;
+        std::vector<uint16_t> array;   // Sorted low halves, until ARRAY_LIMIT
+        std::vector<uint64_t> bitmap;  // 1024 words once converted
+    };
+
+    std::vector<Container> containers_;
+    size_t size_ = 0;
+};
+
+/**
+ * Index over a low-cardinality string column (IDL attribute (dictionary)).
+ * Each distinct string gets a dense integer code once, and each code keeps
+ * a PostingList of row ordinals into one shared (offset, length, sequence)
+ * table, so a row costs a fixed-size entry plus a few bits of posting
+ * instead of a copy of its key. Equality reads one posting list and IN
+ * lists one per code; ranges walk the dictionary in key order.
+ *
+ * Keys compare as bytes, like BTreeIndex text keys, and only string keys
+ * match. A reader/writer lock guards the index, so lookups from
+ * ReadSession threads can run while the ingesting thread inserts.
+ */
+class DictionaryIndex : public Index {
+public:
+    DictionaryIndex(const std::string& tableName, const std::string& columnName);
+
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
+
+    std::vector<IndexEntry> search(const Value& key) const override;
+    bool searchFirst(const Value& key, IndexEntry& result) const override;
+    std::vector<IndexEntry> searchMany(std::vector<Value> keys) const override;
+    bool searchFirstString(const std::string& key, uint64_t& outOffset,
+                           uint32_t& outLength, uint64_t& outSequence) const override;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                          uint32_t& outLength, uint64_t& outSequence) const override;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
+    std::vector<IndexEntry> all() const override;
+    void clear() override;
+
+    // Distinct keys, and the bytes held by the dictionary, rows and postings
+    size_t getCodeCount() const;
+    size_t memoryBytes() const override;
+
+private:
+    struct Row {
+        uint64_t offset;
+        uint64_t sequence;
+        uint32_t length;
+    };
+
+    struct Code {
+        const std::string* key;    // Node of dictionary_
+        PostingList postings;
+        uint64_t lastSequence = 0;
+        bool ordered = true;       // Postings already ascend by sequence
+    };
+
+    // insert() without taking the lock
+    void insertKey(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+
+    // Append a code's entries in sequence order
+    void appendPostings(const Code& code, std::vector<IndexEntry>& results) const;
+
+    std::map<std::string, uint32_t> dictionary_;  // Key -> code, in key order
+    std::vector<Code> codes_;
+    std::vector<Row> rows_;                       // By ordinal (insertion order)
+
+    mutable std::shared_mutex mutex_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_DICTIONARY_INDEX_H
@@ -0,0 +1,60 @@
+#ifndef FLATSQL_FIELD_CIPHER_H
+#define FLATSQL_FIELD_CIPHER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flatsql {
+
+/**
+ * AES-256-CTR over the stored bytes of encrypted FlatBuffer fields, the
+ * scheme of flatbuffers' field-level encryption (EncryptBytes /
+ * DecryptBytes). In CTR mode encrypting and decrypting are one operation.
+ *
+ * The backend is picked on first use: AES-NI when the CPU has it, then
+ * OpenSSL's EVP (itself dispatching to AES-NI/VAES or the ARMv8 crypto
+ * extensions) when built with FLATSQL_HAVE_OPENSSL, else flatbuffers'
+ * portable code. A backend is only picked if it reproduces the portable
+ * keystream on a known input, so data stays readable either way.
+ */
+
+// Key and IV of one encrypted field (DeriveFieldKey / DeriveFieldIV),
+// derived once per table instead of on every decryption
+struct FieldCipher {
+    uint8_t key[32];
+    uint8_t iv[16];
+
+    // Key schedule for the AES-NI backend: call prepare() once key is set
+    alignas(16) uint8_t roundKeys[15 * 16];
+    void prepare();
+};
+
+enum class CipherBackend : uint8_t { Portable, AesNi, OpenSsl };
+
+// Backend in use (chosen on the first call)
+CipherBackend cipherBackend();
+const char* cipherBackendName(CipherBackend backend);
+
+// One field's bytes, transformed in place
+struct FieldSpan {
+    uint8_t* bytes;
+    size_t size;
+    const FieldCipher* cipher;
+};
+
+// En/decrypt one field in place
+void cryptField(uint8_t* bytes, size_t size, const FieldCipher& cipher);
+
+/**
+ * En/decrypt many fields (of any records and keys) in one call. Counter
+ * blocks of consecutive spans share the AES pipeline, so fields shorter
+ * than a block cost a fraction of a block each instead of a full call.
+ */
+void cryptFields(const FieldSpan* spans, size_t count);
+
+// cryptFields() on a given backend; false if it is not available here
+bool cryptFieldsWith(CipherBackend backend, const FieldSpan* spans, size_t count);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_FIELD_CIPHER_H
@@ -0,0 +1,130 @@
+#ifndef FLATSQL_FULL_TEXT_INDEX_H
+#define FLATSQL_FULL_TEXT_INDEX_H
+
+#include "flatsql/types.h"
+#include "flatsql/index.h"
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flatsql {
+
+// Hidden column with the BM25 score of a row found by MATCH (NULL otherwise)
+constexpr const char* RANK_COLUMN = "_rank";
+
+// Key of a column's full-text index in a virtual table's index map: apart
+// from the column's name, so equality and range plans never pick it
+inline std::string fullTextIndexKey(const std::string& column) {
+    return "_fts_" + column;
+}
+
+/**
+ * Inverted index over a string column (IDL attribute (fulltext)), for
+ * WHERE column MATCH 'query'. Text is split into lowercase terms: runs of
+ * ASCII letters and digits, and of bytes >= 0x80 so UTF-8 words stay
+ * whole. Each term keeps (row ordinal, occurrences) postings and each row
+ * its (offset, length, sequence) and term count; the text itself is not
+ * kept, so the records stay its only copy.
+ *
+ * search() takes a query instead of a key and returns the matching rows
+ * in sequence order, each with its BM25 score as the key. Queries:
+ *   alpha beta      rows with both terms
+ *   alpha OR beta   rows with either (OR binds tighter than the implicit
+ *                   AND, as in FTS5: "a b OR c" is a AND (b OR c))
+ *   -alpha          rows without the term (also NOT alpha)
+ *   alph*           any term starting with alph
+ * Query words are split like the text, so punctuation is ignored, and a
+ * query without a positive term matches nothing.
+ *
+ * all() returns one entry per row whose key is the row's terms (repeated
+ * per occurrence), so rebuilds after compaction, retention or a reload
+ * insert back the same postings. Ranges match nothing. A reader/writer
+ * lock guards the index, as in DictionaryIndex.
+ */
+class FullTextIndex : public Index {
+public:
+    FullTextIndex(const std::string& tableName, const std::string& columnName);
+
+    // Index the terms of a string key (other keys are skipped)
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+    void insertBatch(std::vector<IndexEntry>& entries) override;
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
+
+    std::vector<IndexEntry> search(const Value& query) const override;
+    bool searchFirst(const Value& query, IndexEntry& result) const override;
+    bool searchFirstString(const std::string& query, uint64_t& outOffset,
+                           uint32_t& outLength, uint64_t& outSequence) const override;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                          uint32_t& outLength, uint64_t& outSequence) const override;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
+    std::vector<IndexEntry> all() const override;
+    void clear() override;
+
+    // Rows the query's rarest positive term (or OR group) occurs in, an
+    // upper bound on its matches for the planner
+    size_t estimateMatches(std::string_view query) const;
+
+    // Distinct terms, and the bytes held by the terms, postings and rows
+    size_t getTermCount() const;
+    size_t memoryBytes() const override;
+
+    // The terms of text, in order
+    static std::vector<std::string> tokenize(std::string_view text);
+
+    // Whether text matches query (the MATCH operator without an index)
+    static bool matches(std::string_view query, std::string_view text);
+
+private:
+    struct Posting {
+        uint32_t row;
+        uint32_t occurrences;
+    };
+
+    struct Term {
+        std::vector<Posting> postings;  // Ascending rows
+    };
+
+    struct Row {
+        uint64_t offset;
+        uint64_t sequence;
+        uint32_t length;
+        uint32_t terms;
+    };
+
+    // One word of a query: a term, or with prefix set every term it starts
+    struct QueryWord {
+        std::string text;
+        bool prefix = false;
+    };
+
+    // Words joined by OR; a row matches with any of them, or with none
+    // when negated
+    struct Clause {
+        std::vector<QueryWord> words;
+        bool negated = false;
+    };
+
+    static std::vector<Clause> parseQuery(std::string_view query);
+
+    // Call f(term) for every indexed term a word stands for
+    template <typename F>
+    void forEachTerm(const QueryWord& word, F&& f) const;
+
+    // Ascending rows matching any word of the clause
+    std::vector<uint32_t> clauseRows(const Clause& clause) const;
+
+    // insert() without taking the lock
+    void insertText(std::string_view text, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+
+    std::map<std::string, Term, std::less<>> terms_;  // In term order, for prefixes
+    std::vector<Row> rows_;                            // By ordinal (insertion order)
+    uint64_t totalTerms_ = 0;
+
+    mutable std::shared_mutex mutex_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_FULL_TEXT_INDEX_H
@@ -2,6 +2,10 @@
 #define FLATSQL_GEO_FUNCTIONS_H
 
 #include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace flatsql {
 
@@ -12,9 +16,68 @@ namespace flatsql {
  *   geo_distance(lat1, lon1, lat2, lon2)        -> km (Haversine)
  *   geo_bbox_contains(minLat, maxLat, minLon, maxLon, lat, lon) -> 0/1
  *   geo_within_radius(centerLat, centerLon, lat, lon, radiusKm)  -> 0/1
+ *
+ * Region predicates, answered from a spatial index when point is the
+ * hidden _geo column of a table that has one (see TableDef::geoLatColumn):
+ *   geo_radius(centerLat, centerLon, radiusKm)  -> region
+ *   geo_box(minLat, maxLat, minLon, maxLon)     -> region
+ *   geo_within(point, region)                   -> 0/1
  */
 void registerGeoFunctions(sqlite3* db);
 
+// geo_within(point, region), also installed by tables through xFindFunction
+void geoWithinFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv);
+
+// Hidden column holding each row's point, and the name of its index
+constexpr const char* GEO_COLUMN = "_geo";
+
+// _geo value of a row: lat and lon as two native-endian doubles
+constexpr int GEO_POINT_BYTES = 16;
+bool decodeGeoPoint(const void* blob, int length, double& lat, double& lon);
+
+/**
+ * Spatial index key of a point. Latitude and longitude are quantized to a
+ * 2^24 x 2^24 grid and the two cell coordinates bit-interleaved (Z-order),
+ * so any aligned square block of cells is one contiguous key range.
+ */
+int64_t geoCellKey(double lat, double lon);
+
+// A geo_radius() or geo_box() value
+struct GeoRegion {
+    bool radius = false;  // Circle around the center, else the box alone
+    double centerLat = 0.0;
+    double centerLon = 0.0;
+    double radiusKm = 0.0;
+
+    // The box, or for a circle the range of lat/lon it can reach; a circle
+    // across the antimeridian has minLon > maxLon (wrapping around)
+    double minLat = 0.0;
+    double maxLat = 0.0;
+    double minLon = 0.0;
+    double maxLon = 0.0;
+
+    // Parse a region value; false if the blob is not one
+    static bool decode(const void* blob, int length, GeoRegion& out);
+
+    bool contains(double lat, double lon) const;
+
+    // Share of the lat/lon plane covered by the bounding box
+    double boxFraction() const;
+
+    /**
+     * contains() over count <= 64 points of columnar lat / lon arrays: bit i
+     * is set when point i may lie in the region (a superset of contains(),
+     * by rounding only). A bounding-box pass written to vectorize rejects
+     * most points before any trigonometry, and circles then compare the
+     * haversine term against a precomputed bound instead of a distance.
+     */
+    uint64_t matchBatch(const double* lat, const double* lon, size_t count) const;
+
+    // Sorted, disjoint key ranges [first, second] holding every indexed
+    // point the region may contain (at most maxCells grid blocks per box)
+    std::vector<std::pair<int64_t, int64_t>> coveringKeyRanges(size_t maxCells = 32) const;
+};
+
 }  // namespace flatsql
 
 #endif  // FLATSQL_GEO_FUNCTIONS_H
@@ -0,0 +1,55 @@
+#ifndef FLATSQL_HMAC_H
+#define FLATSQL_HMAC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace flatsql {
+
+class WorkerPool;
+
+/**
+ * HMAC-SHA256 under one key, with the key's inner and outer pads absorbed
+ * once at construction: a MAC then costs two SHA-256 runs over the data
+ * and the inner digest, with no per-call key setup. compute() and
+ * verify() are safe to call from several threads at once.
+ *
+ * Needs OpenSSL (FLATSQL_HAVE_OPENSSL); without it available() is false
+ * and no MAC can be computed.
+ */
+class HmacSha256 {
+public:
+    static constexpr size_t MAC_SIZE = 32;
+
+    HmacSha256(const uint8_t* key, size_t keySize);
+    ~HmacSha256();
+
+    HmacSha256(const HmacSha256&) = delete;
+    HmacSha256& operator=(const HmacSha256&) = delete;
+
+    bool available() const;
+
+    // MAC of data into mac[0, MAC_SIZE); false when unavailable
+    bool compute(const uint8_t* data, size_t length, uint8_t* mac) const;
+
+    // Whether mac matches data (constant-time comparison)
+    bool verify(const uint8_t* data, size_t length, const uint8_t* mac) const;
+
+    /**
+     * Verify count buffers at once: buffer i is data + offsets[i] of
+     * lengths[i] bytes, its MAC macs + i * MAC_SIZE. Buffers are spread
+     * over pool when given. Returns the index of the first buffer that
+     * fails, or count when all pass.
+     */
+    size_t verifyBatch(const uint8_t* data, const uint64_t* offsets, const uint32_t* lengths,
+                       const uint8_t* macs, size_t count, WorkerPool* pool = nullptr) const;
+
+private:
+    struct Pads;
+    std::unique_ptr<Pads> pads_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_HMAC_H
@@ -0,0 +1,208 @@
+#ifndef FLATSQL_INDEX_H
+#define FLATSQL_INDEX_H
+
+#include "flatsql/types.h"
+#include <sqlite3.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+// Backing implementation for column indexes
+enum class IndexEngine {
+    Sqlite,   // WITHOUT ROWID table in the shared SQLite database (SqliteIndex)
+    BTree     // Native typed B+tree in process memory (BTreeIndex)
+};
+
+/**
+ * Planner statistics for an index (see Index::getStats). Deletes are not
+ * tracked: tombstoned records stay indexed until the index is rebuilt.
+ */
+struct IndexStats {
+    uint64_t entries = 0;
+    uint64_t distinctKeys = 0;  // HyperLogLog estimate, at most entries
+    bool hasRange = false;      // minKey/maxKey hold the range of numeric keys
+    double minKey = 0.0;
+    double maxKey = 0.0;
+
+    // Expected entries per key (entries / distinctKeys, at least 1)
+    double equalityRows() const;
+
+    // Expected fraction of entries with lo <= key <= hi; a null bound is
+    // open. Without a numeric range each bound is assumed to keep a third.
+    double rangeFraction(const double* lo, const double* hi) const;
+};
+
+/**
+ * Accumulator behind Index::getStats. Updated by the thread that inserts
+ * into the index and readable from planners on any connection, so every
+ * field is a relaxed atomic.
+ */
+class IndexStatistics {
+public:
+    IndexStatistics() = default;
+    IndexStatistics(const IndexStatistics& other) { *this = other; }
+    IndexStatistics& operator=(const IndexStatistics& other);
+
+    // Count one more entry with this key
+    void add(const Value& key);
+    void clear();
+
+    // Forget entries removed in bulk (the key sketch keeps them, so the
+    // distinct estimate can only run high until the next clear())
+    void remove(uint64_t entries);
+
+    uint64_t entries() const { return entries_.load(std::memory_order_relaxed); }
+    IndexStats snapshot() const;
+
+private:
+    static constexpr size_t REGISTERS = 128;  // ~9% standard error
+
+    std::atomic<uint64_t> entries_{0};
+    std::atomic<uint8_t> registers_[REGISTERS] = {};
+    std::atomic<bool> hasRange_{false};
+    std::atomic<double> minKey_{0.0};
+    std::atomic<double> maxKey_{0.0};
+};
+
+/**
+ * Incremental walk over an index key range (see Index::openRange).
+ * Entries are produced a page at a time, each page read under the index's
+ * own lock and resumed after the last (key, sequence) returned, so a scan
+ * holds no lock between pages and entries inserted meanwhile may or may
+ * not be seen. Not thread-safe; the index must outlive the cursor.
+ */
+class IndexCursor {
+public:
+    static constexpr size_t PAGE_ENTRIES = 256;
+
+    virtual ~IndexCursor() = default;
+
+    // Next entry in scan order (key left empty), false once exhausted
+    bool next(IndexEntry& entry) {
+        if (position_ == page_.size()) {
+            if (exhausted_) return false;
+            page_.clear();
+            position_ = 0;
+            exhausted_ = !fetch(page_);
+            if (page_.empty()) return false;
+        }
+        entry = page_[position_++];
+        return true;
+    }
+
+protected:
+    // Append up to PAGE_ENTRIES following entries; false when none remain after them
+    virtual bool fetch(std::vector<IndexEntry>& page) = 0;
+
+private:
+    std::vector<IndexEntry> page_;
+    size_t position_ = 0;
+    bool exhausted_ = false;
+};
+
+/**
+ * Ordered secondary index over FlatBuffer records.
+ * Keys map to (offset, length, sequence) in the stacked FlatBuffer storage.
+ * Entries are ordered by (key, sequence), so duplicate keys are allowed.
+ *
+ * TableStore, FlatBufferVTab and SQLiteEngine only go through this
+ * interface; see SqliteIndex and BTreeIndex for the implementations.
+ */
+class Index {
+public:
+    virtual ~Index() = default;
+
+    // Insert an entry (throws on a NULL key)
+    virtual void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) = 0;
+
+    // Insert many entries; sorts entries by (key, sequence) and calls bulkLoad
+    virtual void insertBatch(std::vector<IndexEntry>& entries);
+
+    // Bulk-load entries already sorted by (key, sequence)
+    virtual void bulkLoad(const std::vector<IndexEntry>& sortedEntries) = 0;
+
+    // Search for entries with exact key match
+    virtual std::vector<IndexEntry> search(const Value& key) const = 0;
+
+    // Search for first entry with exact key match (optimized for unique keys)
+    // Returns true if found, false otherwise
+    virtual bool searchFirst(const Value& key, IndexEntry& result) const = 0;
+
+    // Entries matching any of keys, grouped by key in ascending key order.
+    // Keys are sorted and deduplicated first (NULLs dropped) so the index
+    // is walked once; defaults to one search() per distinct key.
+    virtual std::vector<IndexEntry> searchMany(std::vector<Value> keys) const;
+
+    // Fast path for string key lookups (avoids Value/variant overhead)
+    virtual bool searchFirstString(const std::string& key, uint64_t& outOffset,
+                                   uint32_t& outLength, uint64_t& outSequence) const = 0;
+
+    // Fast path for int64 key lookups (avoids Value/variant overhead)
+    virtual bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                                  uint32_t& outLength, uint64_t& outSequence) const = 0;
+
+    // Range query: minKey <= key <= maxKey. A NULL (monostate) bound
+    // leaves that side open.
+    virtual std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const = 0;
+
+    // Get all entries in key order (full scan)
+    virtual std::vector<IndexEntry> all() const = 0;
+
+    // Cursor over the entries range(minKey, maxKey) would return, in
+    // (key, sequence) order or its reverse. Defaults to materializing range().
+    virtual std::unique_ptr<IndexCursor> openRange(const Value& minKey, const Value& maxKey,
+                                                   bool reverse) const;
+
+    // Clear all entries
+    virtual void clear() = 0;
+
+    // Remove every entry with sequence <= sequence (retention expiring a
+    // stream prefix). Defaults to rebuilding from the entries kept.
+    virtual void eraseThrough(uint64_t sequence);
+
+    // Copy all entries into / out of a table named getName() in an attached
+    // SQLite schema (used to persist indexes next to file-backed storage)
+    virtual void saveTo(sqlite3* db, const std::string& schemaName) const;
+    virtual void loadFrom(sqlite3* db, const std::string& schemaName);
+
+    // Heap bytes the index holds outside SQLite (0 for SqliteIndex)
+    virtual size_t memoryBytes() const { return 0; }
+
+    // Bytes of SQLite pages holding the index (0 for in-memory indexes)
+    virtual size_t pageBytes() const { return 0; }
+
+    // Statistics
+    uint64_t getEntryCount() const { return stats_.entries(); }
+    IndexStats getStats() const { return stats_.snapshot(); }
+    ValueType getKeyType() const { return keyType_; }
+
+    // Index name: _idx_{table}_{column}
+    const std::string& getName() const { return name_; }
+
+protected:
+    // Sort keys and drop duplicates and NULLs (for searchMany)
+    static void sortKeys(std::vector<Value>& keys);
+
+    Index(const std::string& tableName, const std::string& columnName, ValueType keyType)
+        : name_("_idx_" + tableName + "_" + columnName), keyType_(keyType) {}
+
+    std::string name_;
+    ValueType keyType_;
+    IndexStatistics stats_;  // Implementations add() every inserted key
+};
+
+// Bind a key Value to a statement parameter
+void bindIndexKey(sqlite3_stmt* stmt, int index, const Value& key);
+
+// Read a key column back as a Value of the index key type
+Value readIndexKey(sqlite3_stmt* stmt, int column, ValueType keyType);
+
+// SQLite column affinity for an index key type
+const char* sqliteTypeForKey(ValueType keyType);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_INDEX_H
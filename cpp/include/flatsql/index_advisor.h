@@ -0,0 +1,69 @@
+#ifndef FLATSQL_INDEX_ADVISOR_H
+#define FLATSQL_INDEX_ADVISOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flatsql {
+
+// An unindexed column that full scans filtered on
+struct IndexRecommendation {
+    std::string table;
+    std::string column;
+    uint64_t scans = 0;        // Full scans with a comparison on the column
+    uint64_t rowsScanned = 0;  // Rows those scans walked
+    bool built = false;        // Index since built (FlatSQLDatabase::buildAdvisedIndexes)
+};
+
+/**
+ * Unindexed columns that queries filter on, for building indexes where
+ * full scans pay for their absence. While enabled, the planner lists
+ * =, <, <=, > and >= comparisons on unindexed columns of a full scan, and
+ * each xFilter running that scan records the rows it walks against every
+ * listed column. A column is due for an index once its rows scanned reach
+ * the threshold; FlatSQLDatabase::buildAdvisedIndexes() builds those.
+ *
+ * Off by default, when the cursors only pay one branch per full scan.
+ * Owned by SQLiteEngine and used from its thread, like QueryStatsLog.
+ */
+class IndexAdvisor {
+public:
+    // Rows scanned on a column before it is due for an index
+    static constexpr uint64_t DEFAULT_ROW_THRESHOLD = 1000000;
+
+    bool enabled() const { return enabled_; }
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    uint64_t threshold() const { return threshold_; }
+    void setThreshold(uint64_t rows) { threshold_ = rows; }
+
+    // One full scan of rows rows filtering on table.column
+    void record(const std::string& table, const std::string& column, uint64_t rows);
+
+    // Every recorded column, most rows scanned first
+    std::vector<IndexRecommendation> recommendations() const;
+
+    // Columns at or over the threshold without an index yet, most rows
+    // scanned first
+    std::vector<IndexRecommendation> due() const;
+
+    // table.column has an index now; later scans no longer list it
+    void markBuilt(const std::string& table, const std::string& column);
+
+    void clear() { columns_.clear(); }
+
+private:
+    static std::vector<IndexRecommendation> sorted(std::vector<IndexRecommendation> list);
+
+    bool enabled_ = false;
+    uint64_t threshold_ = DEFAULT_ROW_THRESHOLD;
+    std::map<std::pair<std::string, std::string>, IndexRecommendation> columns_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_INDEX_ADVISOR_H
@@ -0,0 +1,106 @@
+#ifndef FLATSQL_INGEST_SERVER_H
+#define FLATSQL_INGEST_SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace flatsql {
+
+class FlatSQLDatabase;
+
+struct IngestServerOptions {
+    std::string unixPath;                 // Unix socket to listen on (empty = none)
+    std::string tcpHost = "127.0.0.1";    // TCP address to bind
+    int tcpPort = -1;                     // -1 = no TCP listener, 0 = any free port
+    std::string source;                   // Ingest through ingestWithSource() when set
+
+    size_t maxConnections = 256;          // Further producers are refused
+    size_t receiveBufferSize = 256 * 1024;        // Per connection, grown for larger frames
+    size_t maxFrameSize = 64 * 1024 * 1024;       // Larger frames disconnect the producer
+    size_t maxGrowthBytes = 256 * 1024 * 1024;    // Growth beyond receiveBufferSize, all connections
+    size_t readBudget = 1024 * 1024;      // Bytes read per connection per wakeup
+};
+
+struct IngestServerStats {
+    uint64_t connectionsAccepted = 0;
+    uint64_t connectionsRefused = 0;   // Over maxConnections
+    uint64_t connectionsDropped = 0;   // Oversized frame or failed ingest
+    uint64_t activeConnections = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t recordsIngested = 0;
+    uint64_t readPauses = 0;           // Times a connection waited for buffer space
+};
+
+/**
+ * Ingest endpoint for producers streaming size-prefixed FlatBuffers over
+ * Unix domain sockets and/or TCP, multiplexed with epoll (poll() outside
+ * Linux) on one thread.
+ *
+ * Each connection reads straight into its own StreamIngestor buffer
+ * (reserve / commit), and complete frames are ingested from where they
+ * were received, so the store's copy is the only one.
+ *
+ * Backpressure: a connection stops being read while growing its buffer
+ * would take the growth of all buffers past maxGrowthBytes (one grown
+ * buffer is always allowed, so some producer makes progress). Its producer
+ * then blocks on the full socket window instead of the server buffering
+ * without bound. readBudget keeps one fast producer from starving others.
+ *
+ * The database is only touched from the thread running the loop: either
+ * call pollOnce() from the ingesting thread between queries, or start() a
+ * loop thread and query through a ReadSession opened beforehand.
+ *
+ * Not available in WASM builds (the constructor throws).
+ */
+class IngestServer {
+public:
+    // Bind and listen; throws std::runtime_error if a listener cannot be set up
+    IngestServer(FlatSQLDatabase& db, const IngestServerOptions& options);
+    ~IngestServer();
+
+    IngestServer(const IngestServer&) = delete;
+    IngestServer& operator=(const IngestServer&) = delete;
+
+    // Bound TCP port (resolves tcpPort = 0), -1 without a TCP listener
+    int tcpPort() const { return boundPort_; }
+
+    /**
+     * Wait up to timeoutMs (-1 = indefinitely) for socket activity, accept
+     * and read what is ready and ingest the complete frames.
+     * @return records ingested
+     */
+    size_t pollOnce(int timeoutMs);
+
+    // Run the loop on a background thread until stop() (or destruction)
+    void start();
+    void stop();
+    bool running() const { return thread_ != nullptr; }
+
+    IngestServerStats getStats() const;
+
+    // Reason the most recent connection was dropped (empty if none)
+    std::string getLastError() const;
+
+private:
+    struct Loop;
+
+    FlatSQLDatabase& db_;
+    IngestServerOptions options_;
+    std::unique_ptr<Loop> loop_;
+    std::unique_ptr<std::thread> thread_;
+    std::atomic<bool> stopping_{false};
+    int boundPort_ = -1;
+
+    mutable std::mutex statsMutex_;
+    IngestServerStats stats_;
+    std::string lastError_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_INGEST_SERVER_H
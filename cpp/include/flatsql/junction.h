@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -27,7 +29,8 @@ struct TableReference {
     std::string referencedType;      // Table or union name
     RelationType relationType;
     std::vector<std::string> unionTypes;  // For unions: list of possible types
-    int fieldId;                     // FlatBuffer field ID
+    int fieldId = -1;                // FlatBuffer field ID (-1 = unknown); for unions
+                                     // the _type field's, the value is fieldId + 1
 };
 
 // Information about a parsed table
@@ -87,6 +90,26 @@ struct JunctionRow {
     uint64_t childRowId;
     std::optional<int32_t> vectorIndex;   // For vector fields
     std::optional<std::string> unionType;  // For union fields
+    uint32_t childOffset = 0;              // Child's bytes in the parent record (see
+    uint32_t childLength = 0;              // JunctionManager::getChildData)
+};
+
+// Run of rowids inside a junction's adjacency arrays (no copy); valid
+// until the junction next changes
+struct RowIdSlice {
+    const uint64_t* data = nullptr;
+    size_t size = 0;
+
+    const uint64_t* begin() const { return data; }
+    const uint64_t* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+    uint64_t operator[](size_t i) const { return data[i]; }
+};
+
+// Size of a junction, for planning: live rows and parents with rows
+struct JunctionStats {
+    size_t rows = 0;
+    size_t parents = 0;
 };
 
 /**
@@ -115,6 +138,9 @@ private:
 
 /**
  * Manages junction tables and cascade operations for a FlatSQL database.
+ * Each junction is held in memory as compressed sparse rows in both
+ * directions (parent -> children, child -> parents), appended to as
+ * rows are inserted, so traversals are binary searches into array slices.
  */
 class JunctionManager {
 public:
@@ -124,16 +150,50 @@ public:
     // Initialize junction tables from schema analysis
     void initialize(const SchemaAnalysis& analysis);
 
-    // Insert a FlatBuffer with automatic child extraction and junction creation
-    // Returns the parent rowid
+    /**
+     * Insert a FlatBuffer with automatic child extraction and junction creation.
+     * Only the parent is stored: each child row refers to its bytes inside
+     * the parent's stored record, so the insert costs one copy in total.
+     * Child rowids number those rows (from 1) in this manager.
+     * Returns the parent rowid.
+     */
     uint64_t insertWithRelations(
         const std::string& tableName,
         const std::vector<uint8_t>& flatbufferData
     );
+    uint64_t insertWithRelations(const std::string& tableName, const uint8_t* data, size_t length);
+
+    /**
+     * A child row inserted by insertWithRelations, as a FlatBuffer (root
+     * offset first, no file identifier) readable by the child table's
+     * extractors. Points into the parent's stored record, so in Contiguous
+     * storage it is only valid until the next ingest. nullptr if unknown.
+     */
+    const uint8_t* getChildData(uint64_t childRowId, size_t* outLength) const;
 
     // Delete a row with cascade to junction tables and orphan cleanup
     void deleteWithCascade(const std::string& tableName, uint64_t rowId);
 
+    /**
+     * Delete a batch of rows of tableName with their cascade: the rows are
+     * tombstoned in the database in one call, their junction rows dropped
+     * junction by junction, and the children left without a parent are
+     * released (getChildData then returns nullptr). Returns the number of
+     * children released.
+     *
+     * @throws std::runtime_error if tableName has no records in the
+     *         database (nothing is changed then)
+     */
+    size_t deleteWithCascade(const std::string& tableName, const std::vector<uint64_t>& rowIds);
+
+    /**
+     * Renumber parents after the database compacted its storage (called by
+     * FlatSQLDatabase; sequenceMap maps old sequences to new ones, 0 for
+     * records dropped). Junction rows of dropped parents are removed and
+     * their children released, as by deleteWithCascade.
+     */
+    void remapParents(const std::vector<uint64_t>& sequenceMap);
+
     // Get all child rows for a parent
     std::vector<JunctionRow> getChildren(
         const std::string& parentTable,
@@ -141,13 +201,50 @@ public:
         uint64_t parentRowId
     );
 
+    // Child rowids of a parent in insertion (vector) order, straight from
+    // the junction's arrays; empty once the parent is deleted
+    RowIdSlice getChildRowIds(
+        const std::string& parentTable,
+        const std::string& fieldName,
+        uint64_t parentRowId
+    );
+
+    /**
+     * Rows of a junction for a batch of parents, appended to out in the
+     * order of parentRowIds (ascending, no duplicates, for rows in parent
+     * order), each parent's in vector order. nullptr reads every parent's,
+     * by parent rowid. Used by the junction virtual tables.
+     */
+    void collectChildren(
+        const std::string& junctionName,
+        const std::vector<uint64_t>* parentRowIds,
+        std::vector<JunctionRow>& out
+    );
+
+    JunctionStats getJunctionStats(const std::string& junctionName);
+
+    /**
+     * Make each junction queryable through the database as a read-only
+     * table of its name (see JunctionVTab), with the child table's columns
+     * read from the children in place:
+     *
+     *   SELECT m.name, i.damage FROM Monster m
+     *   JOIN Monster__inventory i ON i.parent_rowid = m.rowid
+     *
+     * This manager must outlive queries on them.
+     *
+     * @throws std::runtime_error if a junction's name is already in use
+     */
+    void registerTables();
+
     // Get all parent rows that reference a child
     std::vector<JunctionRow> getParents(
         const std::string& childTable,
         uint64_t childRowId
     );
 
-    // Clean up orphaned rows in a child table
+    // Children of tableName released by deleteWithCascade since the last
+    // call (they are released as they are orphaned; nothing is scanned)
     size_t cleanupOrphans(const std::string& tableName);
 
     // Get junction table info
@@ -167,21 +264,42 @@ private:
  */
 class FlatBufferExtractor {
 public:
+    /**
+     * A nested table, located rather than copied: parent bytes
+     * [offset, offset + length) are a FlatBuffer whose root offset (the
+     * parent's reference to the child) leads to the child table. Children
+     * whose vtable lies before that reference (not the case in buffers
+     * built by flatc) are not self-contained there and get a rebased copy
+     * in data instead.
+     */
     struct ExtractedChild {
         std::string fieldName;
         std::string tableName;
-        std::vector<uint8_t> data;
+        size_t offset = 0;
+        size_t length = 0;
+        std::vector<uint8_t> data;  // Empty unless the child had to be copied
         std::optional<int32_t> vectorIndex;
         std::optional<std::string> unionType;
+
+        bool isView() const { return data.empty(); }
+        const uint8_t* bytes(const uint8_t* parent) const { return data.empty() ? parent + offset : data.data(); }
+        size_t size() const { return data.empty() ? length : data.size(); }
     };
 
-    // Extract all child FlatBuffers from a parent
-    // Requires schema info to know which fields are table references
+    // Extract all child FlatBuffers from a parent (root offset first)
+    // Requires schema info to know which fields are table references;
+    // references without a known fieldId, absent fields and malformed
+    // offsets are skipped
     static std::vector<ExtractedChild> extractChildren(
         const std::vector<uint8_t>& parentData,
         const TableInfo& tableInfo,
         const std::map<std::string, TableInfo>& allTables
     );
+    static std::vector<ExtractedChild> extractChildren(
+        const uint8_t* parentData, size_t length,
+        const TableInfo& tableInfo,
+        const std::map<std::string, TableInfo>& allTables
+    );
 };
 
 } // namespace flatsql
@@ -0,0 +1,127 @@
+#ifndef FLATSQL_LRU_CACHE_H
+#define FLATSQL_LRU_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace flatsql {
+
+// Counters of one cache since it was created
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;  // Entries dropped to stay within capacity
+    size_t entries = 0;
+    size_t capacity = 0;
+
+    double hitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+/**
+ * String-keyed cache holding at most capacity entries, evicting the least
+ * recently used. Values never move while cached, so a pointer from
+ * find() or insert() stays valid until that entry is evicted or cleared.
+ *
+ * onRelease runs on every value that leaves the cache (eviction,
+ * replacement or clear), e.g. to finalize a prepared statement.
+ */
+template <typename V>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity, std::function<void(V&)> onRelease = nullptr)
+        : capacity_(capacity > 0 ? capacity : 1), onRelease_(std::move(onRelease)) {}
+
+    ~LruCache() { clear(); }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    // Cached value (now most recently used), or nullptr
+    V* find(const std::string& key) {
+        auto it = byKey_.find(key);
+        if (it == byKey_.end()) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    // Cache value under key, replacing any entry there
+    V& insert(const std::string& key, V value) {
+        auto it = byKey_.find(key);
+        if (it != byKey_.end()) {
+            release(it->second->second);
+            it->second->second = std::move(value);
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+        evictTo(capacity_ - 1);
+        entries_.emplace_front(key, std::move(value));
+        byKey_[key] = entries_.begin();
+        return entries_.front().second;
+    }
+
+    void clear() {
+        for (auto& entry : entries_) release(entry.second);
+        entries_.clear();
+        byKey_.clear();
+    }
+
+    // At least 1; evicts down to the new capacity
+    void setCapacity(size_t capacity) {
+        capacity_ = capacity > 0 ? capacity : 1;
+        evictTo(capacity_);
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return byKey_.size(); }
+
+    CacheStats getStats() const {
+        CacheStats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.evictions = evictions_;
+        stats.entries = byKey_.size();
+        stats.capacity = capacity_;
+        return stats;
+    }
+
+private:
+    using Entries = std::list<std::pair<std::string, V>>;
+
+    void release(V& value) {
+        if (onRelease_) onRelease_(value);
+    }
+
+    void evictTo(size_t entries) {
+        while (byKey_.size() > entries) {
+            auto& last = entries_.back();
+            release(last.second);
+            byKey_.erase(last.first);
+            entries_.pop_back();
+            evictions_++;
+        }
+    }
+
+    size_t capacity_;
+    std::function<void(V&)> onRelease_;
+    Entries entries_;  // Most recently used first
+    std::unordered_map<std::string, typename Entries::iterator> byKey_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_LRU_CACHE_H
@@ -0,0 +1,125 @@
+#ifndef FLATSQL_MATERIALIZED_AGGREGATE_H
+#define FLATSQL_MATERIALIZED_AGGREGATE_H
+
+#include "flatsql/aggregate.h"
+#include "flatsql/types.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+// Declaration of FlatSQLDatabase::createMaterializedAggregate()
+struct MaterializedAggregateDef {
+    std::string groupBy;                    // Empty for one group over the whole table
+    std::vector<AggregateSpec> aggregates;
+    std::vector<std::string> last;          // Columns read from each group's newest record
+};
+
+/**
+ * GROUP BY aggregates of one table, kept up to date as records are
+ * ingested and deleted instead of recomputed by a scan, so reading them
+ * costs one row per group.
+ *
+ * Results follow AggregateState, except that a SUM leaving the int64
+ * range continues as a double rather than failing the ingest. LAST(column)
+ * is the column of the group's record with the highest sequence.
+ *
+ * COUNT, SUM and AVG follow deletes exactly. MIN, MAX and LAST cannot be
+ * taken back, so a delete of the record holding a group's current value
+ * marks the group stale, and refresh() recomputes every stale group with
+ * one scan of the table before the next read. The approximate aggregates
+ * are not supported: their sketches cannot take a record back at all.
+ */
+class MaterializedAggregate {
+public:
+    using FieldExtractor = std::function<Value(const uint8_t* data, size_t length, const std::string& fieldName)>;
+    using RecordVisitor = std::function<void(const uint8_t* data, size_t length, uint64_t sequence)>;
+
+    // Calls the visitor with every live (not deleted) record of the table
+    using LiveScan = std::function<void(const RecordVisitor& visit)>;
+
+    struct Slot {
+        uint64_t count = 0;  // Non-NULL values (rows for COUNT(*))
+        int64_t intSum = 0;
+        double realSum = 0.0;
+        bool real = false;   // The sum is intSum + realSum
+        Value min;
+        Value max;
+    };
+
+    struct Group {
+        uint64_t rows = 0;
+        std::vector<Slot> slots;        // One per aggregate
+        uint64_t lastSequence = 0;      // Newest record, 0 when none
+        std::vector<Value> lastValues;  // One per last column, from that record
+        bool stale = false;             // Waiting for refresh()
+    };
+
+    // Group key -> state. Keys are as queries return them (see toSqlValue);
+    // groups stay once created and are empty when rows == 0.
+    using Groups = std::map<Value, Group, ValueLess>;
+
+    /**
+     * @throws std::runtime_error for an unknown or encrypted column, SUM or
+     *         AVG of a non-numeric column, or a column-less aggregate other
+     *         than COUNT
+     */
+    MaterializedAggregate(const std::string& name, const TableDef& table, const MaterializedAggregateDef& def);
+
+    const std::string& getName() const { return name_; }
+    const MaterializedAggregateDef& getDef() const { return def_; }
+
+    // Result columns: the group column when grouped, the aggregate labels,
+    // then LAST(column) for each last column
+    const std::vector<std::string>& getColumnNames() const { return columnNames_; }
+
+    bool isGrouped() const { return !def_.groupBy.empty(); }
+
+    // Count a newly ingested record
+    void add(const uint8_t* data, size_t length, uint64_t sequence, const FieldExtractor& extractor);
+
+    // Take back a record counted by add(), now deleted
+    void remove(const uint8_t* data, size_t length, uint64_t sequence, const FieldExtractor& extractor);
+
+    // Follow a compaction (sequenceMap as for TableStore::remapSequences)
+    void remapSequences(const std::vector<uint64_t>& sequenceMap);
+
+    // Forget every record, e.g. before counting the table again
+    void clear();
+
+    bool needsRefresh() const { return staleGroups_ > 0; }
+
+    // Recompute the stale groups from the table's live records
+    void refresh(const LiveScan& scan, const FieldExtractor& extractor);
+
+    const Groups& getGroups() const { return groups_; }
+
+    // Result column c of a group (see getColumnNames)
+    Value result(const Groups::value_type& group, size_t column) const;
+
+private:
+    Value groupKey(const uint8_t* data, size_t length, const FieldExtractor& extractor) const;
+    void accumulate(Group& group, const uint8_t* data, size_t length, uint64_t sequence,
+                    const FieldExtractor& extractor);
+    void resetGroup(Group& group) const;
+
+    std::string name_;
+    MaterializedAggregateDef def_;
+    std::vector<std::string> columnNames_;
+
+    // Distinct columns read per record, and where each aggregate and last
+    // column finds its value among them (-1 for COUNT(*))
+    std::vector<std::string> readColumns_;
+    std::vector<int> aggregateColumns_;
+    std::vector<int> lastColumns_;
+    std::vector<Value> values_;  // Reused per record, readColumns_ order
+
+    Groups groups_;
+    size_t staleGroups_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_MATERIALIZED_AGGREGATE_H
@@ -0,0 +1,97 @@
+#ifndef FLATSQL_MEMORY_USAGE_H
+#define FLATSQL_MEMORY_USAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Bytes held by a StreamingFlatBufferStore. Capacity is counted, not
+ * use: a Contiguous buffer reports its whole allocation. Mapped bytes are
+ * file pages the OS can drop, so they stay out of total().
+ */
+struct StorageMemory {
+    uint64_t streamBytes = 0;       // Raw stream in memory (Contiguous buffer or raw Segmented chunks)
+    uint64_t mappedBytes = 0;       // MappedFile: bytes of the file mapped
+    uint64_t coldBytes = 0;         // Compressed Segmented chunks
+    uint64_t coldCacheBytes = 0;    // Decompressed cold chunks in the cache
+    uint64_t sequenceMapBytes = 0;  // Sequence -> offset table (also searched offset -> sequence)
+    uint64_t chunkTableBytes = 0;   // Segmented per-chunk bases and ends
+    uint64_t recordListBytes = 0;   // Per-file-ID record lists
+
+    uint64_t total() const {
+        return streamBytes + coldBytes + coldCacheBytes + sequenceMapBytes + chunkTableBytes + recordListBytes;
+    }
+};
+
+// Bytes held for one table beyond the shared stream
+struct TableMemory {
+    std::string tableName;
+    uint64_t recordInfoBytes = 0;   // The table's own record list
+    uint64_t indexBytes = 0;        // Heap-resident indexes (B-tree, dictionary, full-text, trigram)
+    uint64_t indexPageBytes = 0;    // SQLite pages of its SqliteIndex tables
+    uint64_t columnCacheBytes = 0;  // Materialized columns
+    uint64_t zoneMapBytes = 0;      // Zone maps and zone Bloom filters
+    uint64_t tombstoneBytes = 0;    // Deletion bitmap of the table's source
+    uint64_t verificationBytes = 0; // Lazy verification outcomes
+
+    // SQLite pages are also in EngineMemory::pageCacheBytes
+    uint64_t total() const {
+        return recordInfoBytes + indexBytes + columnCacheBytes + zoneMapBytes + tombstoneBytes +
+               verificationBytes;
+    }
+};
+
+// Bytes held by the query engine's SQLite connection and caches
+struct EngineMemory {
+    uint64_t pageCacheBytes = 0;    // SQLite page cache, including every index table
+    uint64_t statementBytes = 0;    // Prepared statements, cached or not
+    uint64_t schemaBytes = 0;       // Parsed schema
+    uint64_t resultCacheBytes = 0;  // Estimated size of cached results
+
+    uint64_t total() const { return pageCacheBytes + statementBytes + schemaBytes + resultCacheBytes; }
+};
+
+// FlatSQLDatabase::getMemoryUsage()
+struct MemoryUsage {
+    StorageMemory storage;
+    std::vector<TableMemory> tables;  // Base and source tables, by name
+    EngineMemory engine;
+
+    uint64_t total() const {
+        uint64_t bytes = storage.total() + engine.total();
+        for (const TableMemory& table : tables) bytes += table.total();
+        return bytes;
+    }
+};
+
+/**
+ * Memory limits for FlatSQLDatabase::setMemoryLimits (0 disables either).
+ *
+ * Past softBytes after an ingest call, the database drops what it can
+ * rebuild on demand: cached results and statements, decompressed cold
+ * chunks and unused SQLite pages, then compacts deleted records away if
+ * compactOverSoft is set and that was not enough. While the footprint is
+ * past hardBytes, ingest calls throw before storing anything, so a
+ * producer backs off instead of the process running out of memory.
+ */
+struct MemoryLimits {
+    uint64_t softBytes = 0;
+    uint64_t hardBytes = 0;
+    bool compactOverSoft = false;
+};
+
+// What the limits have done since they were set
+struct MemoryLimitStats {
+    uint64_t footprint = 0;    // Last measured total
+    uint64_t reliefs = 0;      // Times the soft limit released caches
+    uint64_t compactions = 0;  // Compactions the soft limit ran
+    uint64_t rejections = 0;   // Ingest calls refused over the hard limit
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_MEMORY_USAGE_H
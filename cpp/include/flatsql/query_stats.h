@@ -0,0 +1,124 @@
+#ifndef FLATSQL_QUERY_STATS_H
+#define FLATSQL_QUERY_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace flatsql {
+
+// Counters and timings of one statement run by SQLiteEngine::execute()
+struct QueryStats {
+    uint64_t id = 0;                    // 1 for the first statement recorded
+    std::string sql;
+    bool fastPath = false;              // Answered without SQLite (tryFastPath)
+    bool resultCacheHit = false;        // Served from the result cache
+    uint64_t rowsScanned = 0;           // Records a vtab cursor stopped on
+    uint64_t rowsReturned = 0;          // Rows in the result
+    uint64_t indexProbes = 0;           // xFilter calls answered from an index
+    uint64_t filterCalls = 0;
+    uint64_t nextCalls = 0;
+    uint64_t columnCalls = 0;
+    uint64_t fastExtractorCalls = 0;    // xColumn via the FastFieldExtractor
+    uint64_t schemaExtractorCalls = 0;  // ... via the generated SchemaExtractor
+    uint64_t slowExtractorCalls = 0;    // Rows read through the FieldExtractor
+    uint64_t batchExtractorCalls = 0;   // ... decoded whole by the BatchExtractor
+    uint64_t columnCacheReads = 0;      // ... from a materialized column
+    uint64_t coveredReads = 0;          // ... decoded from a covering index key
+    uint64_t decryptions = 0;           // Encrypted fields decrypted
+    uint64_t bytesTouched = 0;          // FlatBuffer bytes of the records scanned
+    uint64_t filterNanos = 0;           // Time inside xFilter, xNext and xColumn
+    uint64_t nextNanos = 0;
+    uint64_t columnNanos = 0;
+    uint64_t totalNanos = 0;            // Whole execute() call
+};
+
+// Numeric QueryStats field and its column name in flatsql_stats
+struct QueryStatsCounter {
+    const char* column;
+    uint64_t QueryStats::*field;
+};
+
+// Every counter and timing of QueryStats, in flatsql_stats column order
+extern const QueryStatsCounter QUERY_STATS_COUNTERS[];
+extern const size_t QUERY_STATS_COUNTER_COUNT;
+
+// Counter of stats named column (e.g. "rows_scanned"), or nullptr
+const uint64_t* findQueryStatsCounter(const QueryStats& stats, const std::string& column);
+
+/**
+ * Recent QueryStats of an engine. While enabled, execute() points current
+ * at a fresh QueryStats and the FlatBuffer vtab cursors it opens add to
+ * it; when off, cursors see nullptr and only pay one branch per callback.
+ * Statement rows land in a ring of the last capacity statements.
+ */
+class QueryStatsLog {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Statement being recorded, nullptr while none is
+    QueryStats* current = nullptr;
+
+    bool enabled() const { return enabled_; }
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    // Statements kept (at least 1); drops the oldest past it
+    void setCapacity(size_t capacity);
+    size_t capacity() const { return capacity_; }
+
+    // Start recording sql; false (nothing recorded) while disabled or
+    // when another statement is being recorded
+    bool begin(const std::string& sql);
+
+    // Stop recording and keep the statement's stats
+    void end();
+
+    // Oldest first
+    const std::deque<QueryStats>& recent() const { return recent_; }
+
+    // Last statement recorded, or nullptr
+    const QueryStats* last() const { return recent_.empty() ? nullptr : &recent_.back(); }
+
+    void clear() { recent_.clear(); }
+
+    static uint64_t nanosSince(Clock::time_point start) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+private:
+    bool enabled_ = false;
+    size_t capacity_ = 64;
+    uint64_t nextId_ = 1;
+    QueryStats active_;  // What current points at (stable for cursors to cache)
+    Clock::time_point started_;
+    std::deque<QueryStats> recent_;
+};
+
+/**
+ * Adds the time until it goes out of scope to a QueryStats field, when
+ * there is one. Used around vtab callbacks.
+ */
+class QueryStatsTimer {
+public:
+    QueryStatsTimer(QueryStats* stats, uint64_t QueryStats::*field) : stats_(stats), field_(field) {
+        if (stats_) start_ = QueryStatsLog::Clock::now();
+    }
+    ~QueryStatsTimer() {
+        if (stats_) stats_->*field_ += QueryStatsLog::nanosSince(start_);
+    }
+
+    QueryStatsTimer(const QueryStatsTimer&) = delete;
+    QueryStatsTimer& operator=(const QueryStatsTimer&) = delete;
+
+private:
+    QueryStats* stats_;
+    uint64_t QueryStats::*field_;
+    QueryStatsLog::Clock::time_point start_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_QUERY_STATS_H
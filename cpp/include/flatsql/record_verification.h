@@ -0,0 +1,71 @@
+#ifndef FLATSQL_RECORD_VERIFICATION_H
+#define FLATSQL_RECORD_VERIFICATION_H
+
+#include "flatsql/schema_extractor.h"
+#include "flatsql/stable_vector.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace flatsql {
+
+// How a table's records are checked (FlatSQLDatabase::setVerificationMode)
+enum class VerificationMode {
+    Trusted,  // Never: the feed is trusted
+    Strict,   // At ingest, every record of a call before any is stored
+    Lazy      // By the first query that reads the record
+};
+
+/**
+ * Verification of one table's records against its schema
+ * (SchemaExtractor::verify) and, in Lazy mode, the outcome per sequence.
+ *
+ * Outcomes take two bits per sequence of the store (checked, passed) in
+ * words a reader sets atomically, so queries on several threads may check
+ * records at once and each record is verified once. reserve(), setMode()
+ * and clearOutcomes() are writer-only.
+ */
+class RecordVerification {
+public:
+    explicit RecordVerification(const TableDef& tableDef) : layout_(tableDef) {}
+
+    VerificationMode getMode() const { return mode_.load(std::memory_order_acquire); }
+    void setMode(VerificationMode mode) { mode_.store(mode, std::memory_order_release); }
+
+    // Check against a newer version of the table (writer-only)
+    void setLayout(const TableDef& tableDef) { layout_ = SchemaExtractor(tableDef); }
+
+    // Whether one record (no size prefix) is well formed
+    bool verify(const uint8_t* data, size_t length) const { return layout_.verify(data, length); }
+
+    // verify() through the outcome kept for sequence, verifying and keeping
+    // it on the first call (sequences past reserve() are verified each time)
+    bool check(uint64_t sequence, const uint8_t* data, size_t length);
+
+    // Make room for the outcome of every sequence up to sequence
+    void reserve(uint64_t sequence);
+
+    // Forget every outcome, e.g. once compaction renumbers the records
+    void clearOutcomes() { outcomes_.clear(); }
+
+    // Records found malformed (each counted once by check()), and those a
+    // Strict ingest rejected
+    uint64_t getFailures() const { return failures_.load(std::memory_order_relaxed); }
+    void countFailure() { failures_.fetch_add(1, std::memory_order_relaxed); }
+
+    size_t memoryBytes() const { return outcomes_.capacityBytes(); }
+
+private:
+    static constexpr uint64_t SEQUENCES_PER_WORD = 32;
+    static constexpr uint64_t CHECKED = 1;
+    static constexpr uint64_t PASSED = 2;
+
+    SchemaExtractor layout_;
+    std::atomic<VerificationMode> mode_{VerificationMode::Trusted};
+    StableVector<uint64_t> outcomes_;
+    std::atomic<uint64_t> failures_{0};
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_RECORD_VERIFICATION_H
@@ -0,0 +1,106 @@
+#ifndef FLATSQL_REPLICATION_H
+#define FLATSQL_REPLICATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Where a follower is in its leader's replication stream: the last record
+ * sequence applied and the number of delete-log entries applied, in the
+ * leader's epoch. The epoch changes when the leader compacts (sequences are
+ * renumbered), so positions from an older epoch cannot continue.
+ *
+ * A default position is an empty follower; its first frames copy the
+ * leader as a snapshot. While one is being copied, snapshot is set and the
+ * leader's current tombstones arrive with its last frame.
+ */
+struct ReplicationPosition {
+    uint64_t epoch = 0;
+    uint64_t sequence = 0;
+    uint64_t deletes = 0;
+    bool snapshot = false;
+
+    bool operator==(const ReplicationPosition& other) const {
+        return epoch == other.epoch && sequence == other.sequence &&
+               deletes == other.deletes && snapshot == other.snapshot;
+    }
+    bool operator!=(const ReplicationPosition& other) const { return !(*this == other); }
+};
+
+// A tombstone (or, with sequence 0, clearTombstones() of the table)
+struct ReplicationDelete {
+    std::string table;
+    uint64_t sequence;
+};
+
+/**
+ * The leader's delete log: markDeleted() and clearTombstones() calls in
+ * the order they were made, numbered from the start of the epoch. Records
+ * need no log of their own, the storage stream already is one.
+ */
+class ReplicationLog {
+public:
+    uint64_t epoch() const { return epoch_; }
+    uint64_t firstDelete() const { return firstDelete_; }
+    uint64_t endDelete() const { return firstDelete_ + deletes_.size(); }
+
+    void append(const std::string& table, uint64_t sequence) { deletes_.push_back({table, sequence}); }
+    const ReplicationDelete& at(uint64_t position) const {
+        return deletes_[static_cast<size_t>(position - firstDelete_)];
+    }
+
+    // Drop entries before position, once every follower has applied them
+    void trim(uint64_t position);
+
+    // Compaction renumbered sequences: start a new epoch with an empty log
+    void newEpoch();
+
+private:
+    uint64_t epoch_ = 1;  // Never 0, the epoch of an empty follower
+    uint64_t firstDelete_ = 0;
+    std::vector<ReplicationDelete> deletes_;
+};
+
+/**
+ * A unit of replication from FlatSQLDatabase::pullReplication(): the
+ * position it continues from and the one it reaches, the records in
+ * between as a size-prefixed stream and the deletes to apply after them.
+ *
+ * Wire layout (little-endian): "FSQR", u32 version, the from position
+ * (u64 epoch, u64 sequence, u64 deletes, u8 snapshot), u64 record bytes
+ * and the records, the to position, u32 delete count and per delete a
+ * u16 table name length, the name and a u64 sequence.
+ */
+struct ReplicationFrame {
+    ReplicationPosition from;
+    ReplicationPosition to;
+    const uint8_t* records = nullptr;  // Into the decoded buffer
+    size_t recordBytes = 0;
+    std::vector<ReplicationDelete> deletes;
+};
+
+// Builds a frame from record spans that need not outlive the call
+class ReplicationFrameWriter {
+public:
+    explicit ReplicationFrameWriter(const ReplicationPosition& from);
+
+    void addRecords(const uint8_t* data, size_t length);
+    size_t recordBytes() const { return out_.size() - recordsStart_; }
+
+    std::vector<uint8_t> finish(const ReplicationPosition& to, const std::vector<ReplicationDelete>& deletes);
+
+private:
+    std::vector<uint8_t> out_;
+    size_t recordsStart_;
+};
+
+// @throws std::runtime_error for a malformed or truncated frame
+ReplicationFrame decodeReplicationFrame(const uint8_t* data, size_t length);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_REPLICATION_H
@@ -0,0 +1,66 @@
+#ifndef FLATSQL_RESULT_BUFFER_H
+#define FLATSQL_RESULT_BUFFER_H
+
+#include "flatsql/types.h"
+#include <cstdint>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Columnar encoding of a QueryResult in one contiguous buffer, so a host
+ * (the JS side of the WASM build) can read a whole result through typed
+ * array views instead of one C call per cell.
+ *
+ * All integers are little-endian and every section starts on an 8-byte
+ * boundary.
+ *
+ *   Header (16 bytes):  u32 magic "FSQR", u32 version, u32 columnCount, u32 rowCount
+ *   Directory:          ResultBufferColumn per column (8 x u32)
+ *   Sections:           column names (UTF-8) and per-column data
+ *
+ * Per column type:
+ *   Null     no data
+ *   Bool     values = u8 per row
+ *   Int64    values = i64 per row
+ *   Float64  values = f64 per row
+ *   String   offsets = u32[rowCount + 1] into data (UTF-8)
+ *   Bytes    offsets = u32[rowCount + 1] into data
+ *   Mixed    values = u8 cell type per row (ResultCellType), offsets into
+ *            data as for String; numbers are stored there as 8-byte i64/f64
+ *
+ * validity, when nullCount > 0, is a bitmap with bit (row % 8) of byte
+ * (row / 8) set for non-null rows. Null rows hold zero / empty values.
+ */
+enum class ResultCellType : uint32_t {
+    Null = 0,
+    Bool = 1,
+    Int64 = 3,
+    Float64 = 4,
+    String = 5,
+    Bytes = 6,
+    Mixed = 7   // Column only: rows differ in type
+};
+
+struct ResultBufferColumn {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t type;            // ResultCellType
+    uint32_t nullCount;
+    uint32_t validityOffset;  // 0 when nullCount == 0
+    uint32_t valuesOffset;    // 0 when unused
+    uint32_t offsetsOffset;   // 0 when unused
+    uint32_t dataOffset;      // 0 when unused
+};
+
+constexpr uint32_t RESULT_BUFFER_MAGIC = 0x52515346;  // "FSQR"
+constexpr uint32_t RESULT_BUFFER_VERSION = 1;
+constexpr size_t RESULT_BUFFER_HEADER_SIZE = 16;
+
+// Encode result into out (replacing its contents). Throws if the encoding
+// would exceed the 4 GiB addressable by u32 offsets.
+void encodeResultBuffer(const QueryResult& result, std::vector<uint8_t>& out);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_RESULT_BUFFER_H
@@ -0,0 +1,101 @@
+#ifndef FLATSQL_RESULT_CACHE_H
+#define FLATSQL_RESULT_CACHE_H
+
+#include "flatsql/types.h"
+#include "flatsql/storage.h"
+#include "flatsql/deletion_bitmap.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatsql {
+
+// Counters of a ResultCache since it was enabled
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;         // Including stale entries
+    uint64_t invalidations = 0;  // Entries found stale and dropped
+    uint64_t evictions = 0;      // Entries dropped to stay under capacity
+    size_t entries = 0;
+    size_t bytes = 0;            // Estimated size of the entries held
+    size_t capacity = 0;
+
+    double hitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+/**
+ * Query results keyed by SQL text and bound parameters, for repeated
+ * identical queries (dashboards polling the same statement).
+ *
+ * Each entry keeps a watermark per table it read: how many of the table's
+ * records were visible and the version of its tombstones. A lookup
+ * compares these with the tables' current values, so an entry is reused
+ * exactly until one of its tables gains a record or a delete, without
+ * tracking which entries a write touches. Entries past the byte capacity
+ * are evicted least recently used first.
+ */
+class ResultCache {
+public:
+    // State of one table a result was computed from
+    struct Watermark {
+        const StreamingFlatBufferStore* store;
+        const StreamingFlatBufferStore::RecordInfoList* records;  // nullptr: store's records of fileId
+        std::string fileId;
+        const DeletionBitmap* tombstones;                         // May be nullptr
+        uint64_t visible = 0;
+        uint64_t version = 0;
+
+        // Records of the table visible now
+        uint64_t visibleRecords() const;
+
+        // Take the table's current state
+        void capture();
+
+        // Whether the table is unchanged since capture()
+        bool current() const;
+    };
+
+    explicit ResultCache(size_t capacityBytes) : capacity_(capacityBytes) {}
+
+    // Cache key of a statement and its parameters
+    static std::string key(const std::string& sql, const std::vector<Value>& params);
+
+    // Result cached under key if its tables are unchanged (stale entries
+    // are dropped), else nullptr. Valid until the next insert or clear.
+    const QueryResult* find(const std::string& key);
+
+    // Cache result, computed from tables now at watermarks (captured)
+    void insert(const std::string& key, const QueryResult& result, std::vector<Watermark> watermarks);
+
+    void clear();
+
+    // Evicts down to the new capacity
+    void setCapacity(size_t bytes);
+
+    ResultCacheStats getStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        QueryResult result;
+        std::vector<Watermark> watermarks;
+        size_t bytes;
+    };
+    using Entries = std::list<Entry>;
+
+    void erase(Entries::iterator it);
+    void evictTo(size_t bytes);
+
+    size_t capacity_;
+    Entries entries_;  // Most recently used first
+    std::unordered_map<std::string, Entries::iterator> byKey_;
+    ResultCacheStats stats_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_RESULT_CACHE_H
@@ -0,0 +1,97 @@
+#ifndef FLATSQL_SCHEMA_EXTRACTOR_H
+#define FLATSQL_SCHEMA_EXTRACTOR_H
+
+#include "flatsql/types.h"
+#include <sqlite3.h>
+#include <unordered_map>
+
+namespace flatsql {
+
+/**
+ * Field extractor generated from a parsed TableDef, for tables that have
+ * no hand-written (flatc-based) extractor.
+ *
+ * Each column's vtable slot, reader and absent-field default are resolved
+ * once at construction, so extracting a field is a bounds-checked vtable
+ * lookup plus a switch on the column's reader. Only columns whose layout
+ * the schema parser knows (ColumnDef::layoutKnown) are read; the rest,
+ * and fields of malformed records, come back NULL.
+ *
+ * Records are the FlatBuffers handed to extractors (root offset first,
+ * no size prefix). Immutable after construction, so safe to share across
+ * threads.
+ */
+class SchemaExtractor {
+public:
+    explicit SchemaExtractor(const TableDef& tableDef);
+
+    // Whether any column can be read
+    bool empty() const { return readableColumns_ == 0; }
+
+    // Field value by column index / name (monostate when unreadable)
+    Value extract(const uint8_t* data, size_t length, int column) const;
+    Value extract(const uint8_t* data, size_t length, const std::string& fieldName) const;
+
+    // Same without a copy: strings and bytes point into data (defaults into
+    // the extractor), so the view lives as long as both
+    ValueView extractView(const uint8_t* data, size_t length, int column) const;
+    ValueView extractView(const uint8_t* data, size_t length, const std::string& fieldName) const;
+
+    // Fields columns[0..count) into keys[0..count) from one vtable walk,
+    // reusing the string/byte storage already held by keys (KeyExtractor)
+    void extractKeys(const uint8_t* data, size_t length, const int* columns,
+                     size_t count, Value* keys) const;
+
+    // FastFieldExtractor contract: write column into ctx, false if the
+    // column is not readable here
+    bool extractTo(const uint8_t* data, size_t length, int column, sqlite3_context* ctx) const;
+
+    /**
+     * Whether data is a well-formed record as far as the schema describes
+     * it: the root table and its vtable lie inside the record and are
+     * aligned, every vtable entry points inside the table, and each
+     * readable column's field (and the string or vector it references) lies
+     * inside the record, strings NUL-terminated. Fields of columns without
+     * a known layout are only checked to start inside the table.
+     */
+    bool verify(const uint8_t* data, size_t length) const;
+
+    // Decrypts size bytes of a field in place with the key material in cipher
+    using FieldDecryptor = void (*)(uint8_t* bytes, size_t size, const void* cipher);
+
+    /**
+     * extractTo() for an encrypted column: the field's bytes (the scalar, or
+     * the string/vector contents) are copied into scratch and decrypted
+     * there, so neither the record nor a Value copy is touched. Absent
+     * fields give their schema default, which is stored unencrypted.
+     */
+    bool extractDecryptedTo(const uint8_t* data, size_t length, int column, sqlite3_context* ctx,
+                            FieldDecryptor decrypt, const void* cipher,
+                            std::vector<uint8_t>& scratch) const;
+
+private:
+    enum class Reader : uint8_t {
+        None, Bool, Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32, UInt64,
+        Float32, Float64, String, Bytes
+    };
+
+    struct Column {
+        Reader reader = Reader::None;
+        uint16_t slot = 0;       // Byte offset of the field's entry in the vtable
+        Value absent;            // Value of a field missing from the vtable
+    };
+
+    // Value of column c whose field is at pos (as from fieldPosition)
+    ValueView readView(const uint8_t* data, size_t length, int64_t pos, const Column& c) const;
+    void read(const uint8_t* data, size_t length, int64_t pos, const Column& c, Value& out) const {
+        assignValue(out, readView(data, length, pos, c));
+    }
+
+    std::vector<Column> columns_;
+    std::unordered_map<std::string, int> columnsByName_;
+    size_t readableColumns_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SCHEMA_EXTRACTOR_H
@@ -22,8 +22,21 @@ public:
     // Auto-detect format and parse
     static DatabaseSchema parse(const std::string& source, const std::string& dbName = "default");
 
+    /**
+     * Compiled schema: the parsed DatabaseSchema in a small versioned
+     * binary form (little-endian, "FSQS" magic) that load() reads back
+     * without any parsing. Compile once at build time and ship the bytes
+     * so start-up skips the IDL/JSON parser (see
+     * FlatSQLDatabase::fromCompiledSchema).
+     *
+     * @throws std::runtime_error from load() for a truncated or foreign buffer
+     */
+    static std::vector<uint8_t> compile(const DatabaseSchema& schema);
+    static DatabaseSchema load(const uint8_t* data, size_t length);
+
 private:
-    static ValueType idlTypeToValueType(const std::string& idlType);
+    // recognized (optional) is cleared for types that default to String
+    static ValueType idlTypeToValueType(const std::string& idlType, bool* recognized = nullptr);
     static ValueType jsonTypeToValueType(const std::string& jsonType, const std::string& format = "");
 };
 
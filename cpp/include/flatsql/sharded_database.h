@@ -0,0 +1,112 @@
+#ifndef FLATSQL_SHARDED_DATABASE_H
+#define FLATSQL_SHARDED_DATABASE_H
+
+#include "flatsql/database.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatsql {
+
+// A column the shards' results are sorted by, for ShardedDatabase::query
+struct ShardOrder {
+    std::string column;
+    bool descending = false;
+};
+
+/**
+ * N FlatSQLDatabases behind one facade, each with its own storage and
+ * SQLite connection, so data and work go past what one instance holds.
+ *
+ * Records of a table with a partition key (setPartitionKey) go to the
+ * shard of their key's hash, so every record with one key value is on one
+ * shard; other tables are dealt out round robin. The hash is computed from
+ * the key's value alone (7 and 7.0 are one key), the same on every
+ * platform, so a process can own one shard and route with shardFor().
+ *
+ * Point lookups and queryShard() on a partition key go to that key's shard.
+ * Everything else fans out to every shard, on a pool of threads when
+ * setThreads() asks for one: query() concatenates rows, merging them in
+ * order when the SQL sorts them, and aggregate() merges partial aggregates
+ * (AVG included) before computing results.
+ *
+ * Sequences (rowids) are per shard: delete through shard(i). Field
+ * extractors must be safe to call from several threads at once when
+ * threads are used.
+ */
+class ShardedDatabase {
+public:
+    ShardedDatabase(const DatabaseSchema& schema, size_t shards,
+                    const StorageOptions& storageOptions = StorageOptions(),
+                    IndexEngine indexEngine = IndexEngine::Sqlite);
+
+    size_t shardCount() const { return shards_.size(); }
+    FlatSQLDatabase& shard(size_t index) { return *shards_[index]; }
+
+    // Set up every shard (see the FlatSQLDatabase calls of the same name)
+    void registerFileId(const std::string& fileId, const std::string& tableName);
+    void setFieldExtractor(const std::string& tableName, TableStore::FieldExtractor extractor);
+
+    /**
+     * Partition tableName by column. Set before ingesting into the table.
+     * @throws std::runtime_error for an unknown table or column
+     */
+    void setPartitionKey(const std::string& tableName, const std::string& column);
+
+    // Shard that holds the key's records
+    size_t shardFor(const Value& key) const;
+
+    // Threads that fan out ingest and queries, including the caller (1 = none)
+    void setThreads(size_t threads);
+
+    /**
+     * Ingest size-prefixed FlatBuffers, each into its shard. Like
+     * FlatSQLDatabase::ingest, a trailing partial record is left.
+     * @return bytes consumed
+     * @throws std::runtime_error if a partition key cannot be read
+     */
+    size_t ingest(const uint8_t* data, size_t length, size_t* recordsIngested = nullptr);
+
+    /**
+     * Run sql on every shard and concatenate the rows. With orderBy (the
+     * order the SQL's ORDER BY gives, by result column), the shards'
+     * sorted rows are merged in that order instead; limit caps the
+     * merged rows (the SQL's own LIMIT only caps each shard's).
+     *
+     * @throws std::runtime_error for an orderBy column not in the result
+     */
+    QueryResult query(const std::string& sql, const std::vector<Value>& params = {},
+                      const std::vector<ShardOrder>& orderBy = {}, size_t limit = SIZE_MAX);
+
+    // Run sql only on the shard of key, for queries about one partition key
+    QueryResult queryShard(const Value& key, const std::string& sql, const std::vector<Value>& params = {});
+
+    // Point lookup, on one shard when column is tableName's partition key
+    std::vector<StoredRecord> findByIndex(const std::string& tableName, const std::string& column,
+                                          const Value& value);
+
+    // FlatSQLDatabase::aggregate over every shard, partial states merged
+    QueryResult aggregate(const std::string& tableName, const std::vector<AggregateSpec>& aggregates,
+                          const std::string& groupBy = "");
+
+private:
+    struct Route {
+        std::string column;  // Partition key (empty = round robin)
+        TableStore::FieldExtractor extractor;
+    };
+
+    // fn(shard) for every shard, on the pool when there is one
+    void forEachShard(const std::function<void(size_t)>& fn);
+
+    DatabaseSchema schema_;
+    std::vector<std::unique_ptr<FlatSQLDatabase>> shards_;
+    std::unordered_map<std::string, std::string> fileIdTables_;
+    std::unordered_map<std::string, Route> routes_;  // By table
+    size_t nextShard_ = 0;  // Round robin position
+    std::unique_ptr<WorkerPool> pool_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SHARDED_DATABASE_H
@@ -0,0 +1,106 @@
+#ifndef FLATSQL_SKETCH_H
+#define FLATSQL_SKETCH_H
+
+#include "flatsql/types.h"
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * HyperLogLog distinct-count sketch: 2^12 one-byte registers (~1.6%
+ * standard error), allocated on the first add() so an unused sketch is
+ * empty. Values equal as SQL values count once (7, int8_t(7) and 7.0).
+ *
+ * Sketches of disjoint or overlapping row sets merge() into the sketch of
+ * their union, in any order, so scan partitions and shards combine without
+ * seeing each other's values. serialize() ships one between processes.
+ */
+class HyperLogLog {
+public:
+    static constexpr uint32_t PRECISION = 12;
+    static constexpr size_t REGISTERS = size_t(1) << PRECISION;
+
+    void add(const Value& value);
+    void addHash(uint64_t hash);
+    void merge(const HyperLogLog& other);
+
+    // Estimated distinct values added (0 when none)
+    uint64_t estimate() const;
+
+    bool empty() const { return registers_.empty(); }
+
+    // "FSHL", u8 precision and the registers (empty sketches too)
+    std::vector<uint8_t> serialize() const;
+    // @throws std::runtime_error for bytes that are not a sketch
+    static HyperLogLog deserialize(const uint8_t* data, size_t length);
+
+    // The sketch's 64-bit hash of a value
+    static uint64_t hash(const Value& value);
+
+private:
+    std::vector<uint8_t> registers_;
+};
+
+/**
+ * t-digest quantile sketch (merging variant, k1 scale): values are kept
+ * as at most about compression weighted centroids, finer toward the tails,
+ * so extreme percentiles stay accurate and memory stays bounded however
+ * many values are added. Adds are buffered and folded in batches.
+ *
+ * Like HyperLogLog, digests merge() in any order and serialize().
+ */
+class TDigest {
+public:
+    explicit TDigest(double compression = 100.0);
+
+    void add(double value, double weight = 1.0);
+    void merge(const TDigest& other);
+
+    // Value at fraction q of the way through the values (q in [0, 1],
+    // clamped), interpolated between centroids; NaN when empty
+    double quantile(double q) const;
+
+    double count() const { return total_ + buffered_; }
+    bool empty() const { return count() == 0; }
+
+    // "FSTD", f64 compression, min, max, u32 centroids and per centroid
+    // f64 mean and weight
+    std::vector<uint8_t> serialize() const;
+    // @throws std::runtime_error for bytes that are not a digest
+    static TDigest deserialize(const uint8_t* data, size_t length);
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // Fold the buffer into the centroids
+    void compress() const;
+
+    double compression_;
+    mutable std::vector<Centroid> centroids_;  // Sorted by mean
+    mutable std::vector<Centroid> buffer_;     // Unsorted adds
+    mutable double total_ = 0.0;               // Weight in centroids_
+    mutable double buffered_ = 0.0;            // Weight in buffer_
+    double min_ = 0.0;
+    double max_ = 0.0;
+};
+
+/**
+ * Register sketch aggregates on a SQLite database, with memory bounded by
+ * the sketch rather than the rows (unlike sqlean's stats functions, which
+ * keep every value):
+ *   approx_count_distinct(x)        -> integer (HyperLogLog)
+ *   approx_percentile(x, fraction)  -> real, fraction in [0, 1] (t-digest)
+ * NULLs are skipped; approx_percentile skips non-numeric values and is
+ * NULL without any.
+ */
+void registerSketchFunctions(sqlite3* db);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SKETCH_H
@@ -0,0 +1,66 @@
+#ifndef FLATSQL_SQLITE_AGGREGATE_VTAB_H
+#define FLATSQL_SQLITE_AGGREGATE_VTAB_H
+
+#include "flatsql/materialized_aggregate.h"
+#include <sqlite3.h>
+#include <functional>
+#include <string>
+
+namespace flatsql {
+
+/**
+ * Auxiliary data passed to the aggregate module's xCreate/xConnect: the
+ * aggregate to read and how to bring its stale groups up to date.
+ */
+struct AggregateVTabInfo {
+    MaterializedAggregate* aggregate;  // Not owned
+    std::function<void()> refresh;     // Called before a scan when the aggregate needsRefresh()
+    std::string tableName;             // Source it aggregates
+};
+
+/**
+ * Read-only virtual table over a MaterializedAggregate: one row per group
+ * with records, columns as the aggregate's getColumnNames(). An equality
+ * on the group column looks its group up instead of scanning.
+ */
+struct AggregateVTab : public sqlite3_vtab {
+    AggregateVTabInfo* info;
+};
+
+struct AggregateCursor : public sqlite3_vtab_cursor {
+    AggregateVTab* vtab;
+    MaterializedAggregate::Groups::const_iterator current;
+    MaterializedAggregate::Groups::const_iterator end;
+    sqlite3_int64 rowid;
+};
+
+class AggregateVTabModule {
+public:
+    static sqlite3_module* getModule();
+
+    static int xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                       sqlite3_vtab** ppVTab, char** pzErr);
+    static int xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                        sqlite3_vtab** ppVTab, char** pzErr);
+    static int xDisconnect(sqlite3_vtab* pVTab);
+    static int xDestroy(sqlite3_vtab* pVTab);
+    static int xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo);
+    static int xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor);
+    static int xClose(sqlite3_vtab_cursor* pCursor);
+    static int xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                       int argc, sqlite3_value** argv);
+    static int xNext(sqlite3_vtab_cursor* pCursor);
+    static int xEof(sqlite3_vtab_cursor* pCursor);
+    static int xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N);
+    static int xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid);
+
+private:
+    static sqlite3_module module_;
+
+    // Step past empty groups of a grouped aggregate
+    static void skipEmpty(AggregateCursor* cursor);
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SQLITE_AGGREGATE_VTAB_H
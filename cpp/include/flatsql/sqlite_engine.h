@@ -3,11 +3,20 @@
 
 #include "flatsql/types.h"
 #include "flatsql/storage.h"
-#include "flatsql/sqlite_index.h"
+#include "flatsql/index.h"
 #include "flatsql/sqlite_vtab.h"
+#include "flatsql/sqlite_union_vtab.h"
+#include "flatsql/sqlite_aggregate_vtab.h"
+#include "flatsql/sqlite_junction_vtab.h"
+#include "flatsql/result_cache.h"
+#include "flatsql/lru_cache.h"
+#include "flatsql/query_stats.h"
+#include "flatsql/arena_result.h"
+#include "flatsql/memory_usage.h"
 #include <sqlite3.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
-#include <unordered_set>
 
 namespace flatsql {
 
@@ -23,15 +32,144 @@ struct SourceInfo {
     FieldExtractor extractor;
     FastFieldExtractor fastExtractor;
     BatchExtractor batchExtractor = nullptr;      // Optional batch extractor
-    std::unordered_map<std::string, SqliteIndex*> indexes;  // Not owned
-    std::unordered_set<uint64_t> tombstones;      // Owned - deleted sequences
+    std::unordered_map<std::string, Index*> indexes;  // Not owned
+    DeletionBitmap tombstones;                    // Owned - deleted sequences
     VTabCreateInfo vtabInfo;                      // Info passed to xCreate
     // Source-specific record infos pointer (for multi-source routing)
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>* sourceRecordInfos = nullptr;
+    const StreamingFlatBufferStore::RecordInfoList* sourceRecordInfos = nullptr;
     // Encryption context (not owned)
     const flatbuffers::EncryptionContext* encryptionCtx = nullptr;
 };
 
+// Entry limits of SQLiteEngine's internal caches (see setCacheLimits)
+struct EngineCacheLimits {
+    size_t statements = 100;     // Prepared statements
+    size_t parsedQueries = 1024; // Fast-path parses of SQL text
+    size_t sourceNames = 256;    // Table name lookups
+    size_t columnNames = 256;    // Result column lists per source
+};
+
+// Counters of SQLiteEngine's internal caches
+struct EngineCacheStats {
+    CacheStats statements;
+    CacheStats parsedQueries;
+    CacheStats sourceNames;
+    CacheStats columnNames;
+};
+
+/**
+ * Row-at-a-time statement over an engine's connection, for results too
+ * large to materialize. Column accessors read the current row in place;
+ * text and blob pointers stay valid until the next step().
+ *
+ * A cursor owns its statement (it is not in the engine's cache), so
+ * several can be open at once and queries can run on the engine in
+ * between steps. Each cursor keeps its own visibility pins, so the whole
+ * statement reads the snapshot taken by its first step(). Destroy cursors
+ * before their engine.
+ *
+ * fetchFor() returns after a time budget, so a caller can run ingest and
+ * point lookups between slices of a long query. cancel() may be called
+ * from any thread: a step running at the time is interrupted through the
+ * connection's progress handler, and later steps throw.
+ */
+class QueryCursor {
+public:
+    ~QueryCursor();
+
+    QueryCursor(const QueryCursor&) = delete;
+    QueryCursor& operator=(const QueryCursor&) = delete;
+
+    // Advance to the next row; false when done. Throws std::runtime_error on SQL error.
+    bool step();
+
+    // Append up to maxRows further rows to result (columns are set when empty).
+    // Returns the number of rows added; fewer than maxRows means done.
+    size_t fetch(size_t maxRows, QueryResult& result);
+
+    // fetch() that also stops once budget has elapsed, checked between
+    // rows (a single long step still runs to its end unless cancelled).
+    // done() tells a finished statement from a spent budget.
+    size_t fetchFor(size_t maxRows, std::chrono::microseconds budget, QueryResult& result);
+
+    // Stop the statement; step() throws "Query cancelled" from then on
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+    int columnCount() const { return columnCount_; }
+    const char* columnName(int col) const;
+
+    // Current row accessors; type is SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT,
+    // SQLITE_BLOB or SQLITE_NULL
+    int columnType(int col) const { return sqlite3_column_type(stmt_, col); }
+    int64_t getInt64(int col) const { return sqlite3_column_int64(stmt_, col); }
+    double getDouble(int col) const { return sqlite3_column_double(stmt_, col); }
+    const char* getText(int col) const;
+    const uint8_t* getBlob(int col) const;
+    int getBytes(int col) const { return sqlite3_column_bytes(stmt_, col); }
+    Value getValue(int col) const;
+
+    bool done() const { return done_; }
+
+private:
+    friend class SQLiteEngine;
+    QueryCursor(sqlite3* db, sqlite3_stmt* stmt, ReadSnapshot* engineSnapshot);
+
+    // Progress handler installed for each step: non-zero interrupts it
+    static int progress(void* cursor);
+
+    // Column names of result when empty; the current row appended to it
+    void setColumns(QueryResult& result) const;
+    void appendRow(QueryResult& result) const;
+
+    sqlite3* db_;
+    sqlite3_stmt* stmt_;
+    ReadSnapshot* engineSnapshot_;  // Shared with the vtabs (not owned)
+    ReadSnapshot pins_;             // This statement's pins between steps
+    int columnCount_;
+    bool done_ = false;
+    std::atomic<bool> cancelled_{false};
+};
+
+/**
+ * Point lookup on one indexed column of a source, with the source, index
+ * and tombstone set resolved once by SQLiteEngine::prepareLookup. find()
+ * probes the index directly: no SQL text is built, parsed or matched.
+ *
+ * Sees records published at the time of each call. Cheap to copy; valid
+ * while its engine and source are registered, and used from the engine's
+ * thread.
+ */
+class PreparedLookup {
+public:
+    /**
+     * First record whose key equals key, skipping deleted ones. Sets
+     * outData/outLen to the FlatBuffer in storage (no copy).
+     * @return false if there is no visible match
+     */
+    bool find(const Value& key, const uint8_t** outData, uint32_t* outLen,
+              uint64_t* outSequence = nullptr) const;
+
+    /**
+     * Visible records matching any of keys, resolved in one index pass
+     * (Index::searchMany): grouped by key in ascending key order, missing
+     * keys contribute nothing.
+     */
+    std::vector<IndexEntry> findMany(std::vector<Value> keys) const;
+
+    const std::string& sourceName() const { return source_->name; }
+
+private:
+    friend class SQLiteEngine;
+    PreparedLookup(const SourceInfo* source, Index* index) : source_(source), index_(index) {}
+
+    // The store's published sequence, capped by the engine's AS-OF watermark
+    uint64_t visibleSequence() const;
+
+    const SourceInfo* source_;
+    Index* index_;
+};
+
 /**
  * High-level SQLite wrapper for FlatBuffer queries.
  *
@@ -40,6 +178,11 @@ struct SourceInfo {
  * - Multiple sources with same or different schemas
  * - Unified views for cross-source queries
  * - Tombstone-based deletes with compaction
+ *
+ * Every statement reads a snapshot: the first cursor over a store pins its
+ * published record count and the rest of the statement sees exactly that,
+ * even while another thread ingests into the store. One engine (connection)
+ * must only be used from one thread at a time.
  */
 class SQLiteEngine {
 public:
@@ -66,6 +209,12 @@ public:
      * @param fastExtractor Optional fast field extractor
      * @param batchExtractor Optional batch extractor
      * @param sourceRecordInfos Optional source-specific record infos (for multi-source routing)
+     * @param columnCaches Optional materialized columns, in sourceRecordInfos order
+     * @param schemaExtractor Optional generated reader for columns without fastExtractor
+     * @param zoneMaps    Optional per-zone min/max summaries, in sourceRecordInfos order
+     * @param bloomFilters Optional per-zone Bloom filters, in sourceRecordInfos order
+     * @param encryptionCtx Optional context for decrypting encrypted columns
+     * @param verification Optional checker of records read in Lazy mode
      */
     void registerSource(
         const std::string& sourceName,
@@ -73,15 +222,31 @@ public:
         const TableDef* tableDef,
         const std::string& fileId,
         FieldExtractor extractor,
-        const std::unordered_map<std::string, SqliteIndex*>& indexes = {},
+        const std::unordered_map<std::string, Index*>& indexes = {},
         FastFieldExtractor fastExtractor = nullptr,
         BatchExtractor batchExtractor = nullptr,
-        const std::vector<StreamingFlatBufferStore::FileRecordInfo>* sourceRecordInfos = nullptr
+        const StreamingFlatBufferStore::RecordInfoList* sourceRecordInfos = nullptr,
+        const ColumnCacheSlots* columnCaches = nullptr,
+        const SchemaExtractor* schemaExtractor = nullptr,
+        const ZoneMapSlots* zoneMaps = nullptr,
+        const ZoneBloomSlots* bloomFilters = nullptr,
+        const flatbuffers::EncryptionContext* encryptionCtx = nullptr,
+        RecordVerification* verification = nullptr
     );
 
+    /**
+     * Register a source owned by another engine, typically so a second
+     * connection can read it from another thread. Store, indexes, extractors
+     * and tombstones are shared (not copied); the owning engine must outlive
+     * this one.
+     */
+    void registerSharedSource(const SourceInfo& shared);
+
     /**
      * Create a unified view that combines multiple sources with the same schema.
-     * Generates a UNION ALL view with _source column.
+     * The view is a fan-out virtual table (see UnionVTab) that plans once
+     * for all sources, skips sources excluded by _source constraints and
+     * merges index-ordered scans. Replaces any table or view of that name.
      *
      * @param viewName     Name for the unified view
      * @param sourceNames  List of registered source names to include
@@ -91,6 +256,29 @@ public:
         const std::vector<std::string>& sourceNames
     );
 
+    // Unified views created so far: view name -> source names
+    std::map<std::string, std::vector<std::string>> getUnifiedViews() const;
+
+    /**
+     * Expose a materialized aggregate as a read-only virtual table (see
+     * AggregateVTab). The aggregate must outlive the engine.
+     *
+     * @param tableName  Name of the virtual table
+     * @param info       Aggregate and its refresh, kept by the engine
+     * @throws std::runtime_error if the table cannot be created
+     */
+    void createAggregateTable(const std::string& tableName, const AggregateVTabInfo& info);
+
+    /**
+     * Expose a junction as a read-only virtual table (see JunctionVTab).
+     * Its JunctionManager must outlive queries on it.
+     *
+     * @param tableName  Name of the virtual table
+     * @param info       Junction and child columns, kept by the engine
+     * @throws std::runtime_error if the table cannot be created
+     */
+    void createJunctionTable(const std::string& tableName, const JunctionVTabInfo& info);
+
     /**
      * Execute a SQL query and return results.
      *
@@ -111,6 +299,125 @@ public:
      */
     QueryResult execute(const std::string& sql, const std::vector<Value>& params);
 
+    /**
+     * execute() into an arena-backed result, replacing out's contents.
+     * Passing the same out for each execution reuses its arena. Results
+     * are served from the result cache but not added to it.
+     *
+     * @throws std::runtime_error on SQL error
+     */
+    void execute(const std::string& sql, const std::vector<Value>& params, ArenaQueryResult& out);
+
+    /**
+     * Keep results of execute() for repeated statements, up to about
+     * capacityBytes (0, the default, turns the cache off and drops it).
+     * A result is reused until a table it read gains a visible record or
+     * a delete (see ResultCache). Only read-only statements over
+     * registered sources, unified views and materialized aggregates are
+     * kept, and none calling random(), changes() or date and time
+     * functions.
+     */
+    void setResultCacheSize(size_t capacityBytes);
+
+    // Counters of the result cache (all zero while off)
+    ResultCacheStats getResultCacheStats() const;
+
+    void clearResultCache();
+
+    /**
+     * Read every source as of sequence: statements, fast paths and
+     * prepared lookups see only records up to it, as if later ones were
+     * not yet ingested (0, the default, reads the latest). Watermarks
+     * from getVisibleSequence() rerun a report over the same records.
+     * Deletes are not versioned, so records deleted since stay hidden,
+     * and materialized aggregates keep only their current state.
+     */
+    void setAsOfSequence(uint64_t sequence);
+    uint64_t getAsOfSequence() const;
+
+    /**
+     * Resize the per-SQL caches (prepared statements, fast-path parses)
+     * and the name lookup caches. Each evicts its least recently used
+     * entries past its limit, so clients sending many distinct SQL
+     * strings keep a bounded footprint.
+     */
+    void setCacheLimits(const EngineCacheLimits& limits);
+    EngineCacheLimits getCacheLimits() const;
+
+    // Hits, misses and evictions of each cache
+    EngineCacheStats getCacheStats() const;
+
+    // SQLite's page cache, statement and schema memory on this connection
+    // and the result cache's estimated size
+    EngineMemory getMemoryUsage() const;
+
+    /**
+     * Drop what is rebuilt on demand: cached results, prepared statements
+     * and fast-path parses, and the page cache memory SQLite can free.
+     * Not while a statement of this engine is running.
+     */
+    void releaseMemory();
+
+    /**
+     * Record counters and timings of each execute() call (off by default):
+     * fast path or result cache use, rows scanned and returned, index
+     * probes, extractor and decryption calls, bytes read and time in each
+     * vtab callback. The last setQueryStatsCapacity() statements (64 by
+     * default) are kept and can also be read as SELECT * FROM
+     * flatsql_stats. Cursors from openCursor() are not recorded.
+     */
+    void setQueryStatsEnabled(bool enabled);
+    bool queryStatsEnabled() const;
+    void setQueryStatsCapacity(size_t statements);
+
+    // Recorded statements, oldest first
+    std::vector<QueryStats> getQueryStats() const;
+
+    // Most recent recorded statement (id 0 if there is none)
+    QueryStats getLastQueryStats() const;
+
+    void clearQueryStats();
+
+    // Unindexed columns full scans filter on (see IndexAdvisor; off by
+    // default). Switching it drops cached statements, whose plans were
+    // made with it the other way.
+    void setIndexAdvisorEnabled(bool enabled);
+    IndexAdvisor& getIndexAdvisor() { return *indexAdvisor_; }
+    const IndexAdvisor& getIndexAdvisor() const { return *indexAdvisor_; }
+
+    /**
+     * Give a registered source an index built after registration, under
+     * key in its index map (the column name for an ordinary index). The
+     * connected table plans with it from the next statement prepared;
+     * cached statements are dropped. Tables of unified views and engines
+     * sharing the source keep their index maps.
+     *
+     * @throws std::runtime_error if the source is not registered
+     */
+    void addSourceIndex(const std::string& sourceName, const std::string& key, Index* index);
+
+    /**
+     * Declare a source's columns again after its TableDef grew (see
+     * FlatSQLDatabase::evolveSchema), reading fields through extractor and
+     * schemaExtractor from now on. The connected table is dropped and
+     * cached statements with it, so the next statement connects a table
+     * with every column. Unified views over the source must be created
+     * again; engines sharing it keep the old columns.
+     *
+     * @throws std::runtime_error if the source is not registered
+     */
+    void refreshSource(const std::string& sourceName, FieldExtractor extractor,
+                       const SchemaExtractor* schemaExtractor);
+
+    /**
+     * Prepare a statement for row-at-a-time reading (see QueryCursor).
+     * Fast paths are not used; every row comes from SQLite.
+     *
+     * @throws std::runtime_error on SQL error
+     */
+    std::unique_ptr<QueryCursor> openCursor(const std::string& sql,
+                                            const std::vector<Value>& params = {});
+
     /**
      * Mark a record as deleted in a source.
      * The record will be skipped in future queries.
@@ -119,6 +426,7 @@ public:
      * @param sequence    Sequence number (rowid) of record to delete
      */
     void markDeleted(const std::string& sourceName, uint64_t sequence);
+    void markDeleted(const std::string& sourceName, const std::vector<uint64_t>& sequences);
 
     /**
      * Get count of deleted records for a source.
@@ -130,6 +438,12 @@ public:
      */
     void clearTombstones(const std::string& sourceName);
 
+    /**
+     * Deleted sequences of a source (nullptr if not registered), for
+     * compaction to read and renumber.
+     */
+    DeletionBitmap* getTombstones(const std::string& sourceName);
+
     /**
      * Get list of registered source names.
      */
@@ -146,6 +460,12 @@ public:
      */
     sqlite3* getDb() const { return db_; }
 
+    /**
+     * Reset statements left mid-step on the connection (cached statements
+     * are otherwise only reset on their next use). Needed before DETACH.
+     */
+    void resetActiveStatements();
+
     /**
      * Execute a query and just step through results without building QueryResult.
      * For performance testing to isolate virtual table overhead.
@@ -164,6 +484,14 @@ public:
     SourceInfo* getSource(const std::string& sourceName);
     const SourceInfo* getSource(const std::string& sourceName) const;
 
+    /**
+     * Resolve a point lookup on an indexed column (see PreparedLookup).
+     *
+     * @throws std::runtime_error if the source is not registered or the
+     *         column has no index
+     */
+    PreparedLookup prepareLookup(const std::string& sourceName, const std::string& columnName) const;
+
     /**
      * Optimized query that returns raw FlatBuffer data for point lookups.
      * Bypasses Value construction entirely.
@@ -184,12 +512,97 @@ private:
     // Helper to find source with case-insensitive matching
     SourceInfo* findSourceCaseInsensitive(const std::string& lowerTableName);
 
+    // Column names of a source's rows, cached
+    const std::vector<std::string>& getCachedColumnNames(const SourceInfo* source);
+
+    // Aggregates answered from record counts and indexes (see tryAggregatePushdown)
+    enum class PushedAggregate {
+        None,
+        Count,         // COUNT(*) FROM t
+        CountEqual,    // COUNT(*) FROM t WHERE col = ?
+        CountBetween,  // COUNT(*) FROM t WHERE col BETWEEN ? AND ?
+        Min,           // MIN(col) FROM t
+        Max            // MAX(col) FROM t
+    };
+
+    // Fast-path parse of an SQL string
+    struct ParsedQuery {
+        std::string tableName;
+        std::string columnName;
+        bool isPointQuery;
+        bool isFullScan;
+        PushedAggregate aggregate = PushedAggregate::None;
+        std::string resultColumn;  // An aggregate's result column name, as SQLite names it
+    };
+
+    // Parse sql for the fast paths, or return its cached parse
+    const ParsedQuery& parseFastPathQuery(const std::string& sql);
+
+    // Fill pq from one of the PushedAggregate forms; false for any other
+    // statement (normalized is sql after normalizeSQL)
+    static bool parseAggregate(const std::string& sql, const std::string& normalized, ParsedQuery& pq);
+
+    /**
+     * Answer a parsed aggregate without a scan: COUNT(*) from the record
+     * list and the deletion marks, filtered counts by walking the index
+     * entries (never the records), MIN and MAX from the first live entry
+     * at either end of the column's index. False, to run the statement in
+     * SQLite, when the table, index, column type or parameters don't fit.
+     */
+    bool tryAggregatePushdown(const ParsedQuery& parsed, const std::vector<Value>& params, QueryResult& result);
+
+    // Adds the source and creates its module and virtual table
+    void createVirtualTable(std::unique_ptr<SourceInfo> sourceInfo);
+
+    // Unique-key probe that ignores deleted entries and those newer than the
+    // statement snapshot
+    bool searchVisible(const SourceInfo* source, Index* index, const Value& key, IndexEntry& entry);
+
     sqlite3* db_;
     std::map<std::string, std::unique_ptr<SourceInfo>> sources_;
 
+    // Unified view name -> its union module's info (pointers stable)
+    std::map<std::string, std::unique_ptr<UnionVTabInfo>> unions_;
+
+    // Materialized aggregate table name -> its module's info (pointers stable)
+    std::map<std::string, std::unique_ptr<AggregateVTabInfo>> aggregates_;
+
+    // Junction table name -> its module's info (pointers stable)
+    std::map<std::string, std::unique_ptr<JunctionVTabInfo>> junctions_;
+
+    // Case-insensitive lookup cache (lowered table name -> source)
+    LruCache<SourceInfo*> sourceNameCache_{EngineCacheLimits().sourceNames};
+
+    // Parsed fast-path queries by SQL text, and column names by source
+    LruCache<ParsedQuery> parsedQueryCache_{EngineCacheLimits().parsedQueries};
+    LruCache<std::vector<std::string>> columnNamesCache_{EngineCacheLimits().columnNames};
+
+    // Visibility pins for the current statement (heap-held so the vtab
+    // pointers survive a move of the engine)
+    std::unique_ptr<ReadSnapshot> snapshot_;
+
+    // Results of repeated statements (nullptr while off)
+    std::unique_ptr<ResultCache> resultCache_;
+
+    // Per-statement stats, shared with the vtabs (heap-held like snapshot_)
+    std::unique_ptr<QueryStatsLog> queryStats_;
+
+    // Unindexed column usage, shared with the vtabs (heap-held like snapshot_)
+    std::unique_ptr<IndexAdvisor> indexAdvisor_;
+
+    // execute() without the result cache
+    QueryResult executeStatement(const std::string& sql, const std::vector<Value>& params);
+
+    // Cached statement for sql with params bound and its column names
+    sqlite3_stmt* prepareBound(const std::string& sql, const std::vector<Value>& params,
+                               std::vector<std::string>& columns);
+
+    // Watermarks of the tables sql reads; false if its result must not be cached
+    bool resultWatermarks(const std::string& sql, std::vector<ResultCache::Watermark>& watermarks);
+
     // Statement cache for frequently executed queries
-    mutable std::unordered_map<std::string, sqlite3_stmt*> stmtCache_;
-    static constexpr size_t MAX_STMT_CACHE_SIZE = 100;
+    mutable LruCache<sqlite3_stmt*> stmtCache_{EngineCacheLimits().statements,
+                                               [](sqlite3_stmt*& stmt) { sqlite3_finalize(stmt); }};
 
     // Get or create a prepared statement (cached)
     sqlite3_stmt* getOrPrepareStmt(const std::string& sql) const;
@@ -199,9 +612,6 @@ private:
 
     // Clear statement cache
     void clearStmtCache();
-
-    // Helper to build column list for CREATE VIEW
-    std::string buildColumnList(const TableDef* tableDef) const;
 };
 
 }  // namespace flatsql
@@ -2,6 +2,7 @@
 #define FLATSQL_SQLITE_INDEX_H
 
 #include "flatsql/types.h"
+#include "flatsql/index.h"
 #include <sqlite3.h>
 #include <string>
 #include <vector>
@@ -13,21 +14,33 @@ namespace flatsql {
  * SQLite-backed index for FlatBuffer records.
  * Uses SQLite's highly optimized B-tree for fast lookups.
  * Keys point to offsets in the stacked FlatBuffer storage.
+ *
+ * Each index is a WITHOUT ROWID table clustered on (key, sequence), so
+ * interior pages hold only those two columns. Keys are bound and read
+ * through functions specialized for the index's key type (see KeyCodec):
+ * a key of that type is bound without visiting the variant, and anything
+ * else (a REAL bound on an INTEGER index, NULL) takes the generic
+ * bindIndexKey. TEXT keys compare with SQLite's BINARY collation, which is
+ * already memcmp order.
+ *
+ * Lookups hold the connection's mutex while they use the shared prepared
+ * statements, so ReadSession threads can search while the ingesting thread
+ * inserts (requires SQLite built with SQLITE_THREADSAFE >= 1).
  */
-class SqliteIndex {
+class SqliteIndex : public Index {
 public:
     /**
      * Create an index backed by the given SQLite database.
      *
      * @param db        SQLite database connection (must remain valid for index lifetime)
-     * @param tableName Base table name (used to create unique index table)
+     * @param tableName Base table name (names the index table, created on first write)
      * @param columnName Column being indexed
      * @param keyType   Type of the key (determines SQLite column affinity)
      */
     SqliteIndex(sqlite3* db, const std::string& tableName,
                 const std::string& columnName, ValueType keyType);
 
-    ~SqliteIndex();
+    ~SqliteIndex() override;
 
     // Disable copy (SQLite statements can't be copied)
     SqliteIndex(const SqliteIndex&) = delete;
@@ -38,56 +51,95 @@ public:
     SqliteIndex& operator=(SqliteIndex&& other) noexcept;
 
     // Insert an entry
-    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+
+    // Bulk-load entries sorted by (key, sequence) using multi-row INSERT statements.
+    // Wrap in a transaction (see FlatSQLDatabase::ingest) for best throughput.
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
 
     // Search for entries with exact key match
-    std::vector<IndexEntry> search(const Value& key) const;
+    std::vector<IndexEntry> search(const Value& key) const override;
 
     // Search for first entry with exact key match (optimized for unique keys)
     // Returns true if found, false otherwise
-    bool searchFirst(const Value& key, IndexEntry& result) const;
+    bool searchFirst(const Value& key, IndexEntry& result) const override;
+
+    // Probes up to SEARCH_MANY_KEYS keys per statement with key IN (...)
+    std::vector<IndexEntry> searchMany(std::vector<Value> keys) const override;
 
     // Fast path for string key lookups (avoids Value/variant overhead)
     // Returns true if found, sets outOffset and outLength
-    bool searchFirstString(const std::string& key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const;
+    bool searchFirstString(const std::string& key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const override;
 
     // Fast path for int64 key lookups (avoids Value/variant overhead)
-    bool searchFirstInt64(int64_t key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const override;
 
     // Range query: minKey <= key <= maxKey
-    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
 
     // Get all entries (full scan)
-    std::vector<IndexEntry> all() const;
+    std::vector<IndexEntry> all() const override;
 
-    // Statistics
-    uint64_t getEntryCount() const { return entryCount_; }
+    // Pages through the table with keyset queries, LIMIT PAGE_ENTRIES each
+    std::unique_ptr<IndexCursor> openRange(const Value& minKey, const Value& maxKey,
+                                           bool reverse) const override;
 
     // Clear all entries
-    void clear();
+    void clear() override;
+
+    // One DELETE ... WHERE sequence <= ? on the index table
+    void eraseThrough(uint64_t sequence) override;
+
+    // Copy via INSERT ... SELECT on the shared connection (db is ignored)
+    void saveTo(sqlite3* db, const std::string& schemaName) const override;
+    void loadFrom(sqlite3* db, const std::string& schemaName) override;
+
+    // Page bytes of the index table (dbstat), estimated from the entry
+    // count when SQLite is built without SQLITE_ENABLE_DBSTAT_VTAB
+    size_t pageBytes() const override;
 
     // Get the index table name
-    const std::string& getIndexTableName() const { return indexTableName_; }
+    const std::string& getIndexTableName() const { return name_; }
 
 private:
-    void bindKey(sqlite3_stmt* stmt, int index, const Value& key) const;
-    Value extractKey(sqlite3_stmt* stmt, int column) const;
+    class RangeCursor;
+
+    // Key binding and reading for one key type, chosen at construction
+    struct KeyCodec {
+        void (*bind)(sqlite3_stmt* stmt, int param, const Value& key);
+        Value (*read)(sqlite3_stmt* stmt, int column);
+    };
+    static KeyCodec codecFor(ValueType keyType);
+
     IndexEntry extractEntry(sqlite3_stmt* stmt) const;
-    std::string getSqliteType() const;
+
+    // Create the index table and prepare the core statements. Deferred to
+    // the first write (or save/load), so a schema with many indexed
+    // columns opens without DDL; until then lookups find nothing.
+    void open() const;
+
+    // openRange page query for a direction, start (PageStart) and whether
+    // the far end is bounded; prepared on first use
+    sqlite3_stmt* pageStatement(bool reverse, int start, bool bounded) const;
 
     sqlite3* db_;
-    std::string indexTableName_;
-    ValueType keyType_;
-    uint64_t entryCount_ = 0;
+    KeyCodec codec_;
 
     // Prepared statements for performance
     mutable sqlite3_stmt* insertStmt_ = nullptr;
     mutable sqlite3_stmt* searchStmt_ = nullptr;
     mutable sqlite3_stmt* searchFirstStmt_ = nullptr;
+    mutable sqlite3_stmt* lookupStmt_ = nullptr;  // Location only, for searchFirstInt64/String
     mutable sqlite3_stmt* rangeStmt_ = nullptr;
     mutable sqlite3_stmt* allStmt_ = nullptr;
     mutable sqlite3_stmt* countStmt_ = nullptr;
     mutable sqlite3_stmt* clearStmt_ = nullptr;
+    sqlite3_stmt* batchInsertStmt_ = nullptr;  // Prepared on first bulkLoad
+    mutable sqlite3_stmt* searchManyStmt_ = nullptr;  // Prepared on first searchMany
+    mutable sqlite3_stmt* rangeFromStmt_ = nullptr;   // key >= ?, first open-ended range()
+    mutable sqlite3_stmt* rangeToStmt_ = nullptr;     // key <= ?
+    static constexpr int PAGE_STATEMENTS = 12;
+    mutable sqlite3_stmt* pageStmts_[PAGE_STATEMENTS] = {};  // openRange pages
 };
 
 }  // namespace flatsql
@@ -0,0 +1,77 @@
+#ifndef FLATSQL_SQLITE_JUNCTION_VTAB_H
+#define FLATSQL_SQLITE_JUNCTION_VTAB_H
+
+#include "flatsql/junction.h"
+#include "flatsql/sqlite_vtab.h"
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Auxiliary data passed to the junction module's xCreate/xConnect: the
+ * junction to read and, for a single child table, how to read its columns.
+ */
+struct JunctionVTabInfo {
+    JunctionManager* junctions;         // Not owned
+    std::string junctionName;           // e.g. "Monster__inventory"
+    const TableDef* childDef = nullptr; // Child columns served (nullptr: none, e.g. unions)
+    FieldExtractor extractor;           // Reads childDef's columns from child bytes
+};
+
+/**
+ * Read-only virtual table over a junction: one row per parent/child link,
+ * columns parent_rowid (the parent's sequence), child_rowid, vec_index,
+ * union_type, the child table's columns and _data (the child's bytes).
+ *
+ * Children live inside their parents' records rather than in the child
+ * table, so the child columns are read here and a parent/child join is
+ * two tables, joined on parent_rowid = parent.rowid (the parent's
+ * sequence lookup). An equality on parent_rowid is a slice of the
+ * junction's adjacency arrays; an IN list, such as parent_rowid IN
+ * (SELECT rowid FROM Monster WHERE ...), is looked up whole in one xFilter
+ * call in parent order. Rows always come out by parent_rowid, so an ORDER
+ * BY parent_rowid is free and the parent side is read in sequence order.
+ */
+struct JunctionVTab : public sqlite3_vtab {
+    JunctionVTabInfo* info;
+    int childColumns;
+};
+
+struct JunctionCursor : public sqlite3_vtab_cursor {
+    JunctionVTab* vtab;
+    std::vector<JunctionRow> rows;
+    size_t position;
+    const uint8_t* childData;  // Current child's bytes (looked up on first read)
+    size_t childLength;
+    bool childLoaded;
+};
+
+class JunctionVTabModule {
+public:
+    static sqlite3_module* getModule();
+
+    static int xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                       sqlite3_vtab** ppVTab, char** pzErr);
+    static int xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                        sqlite3_vtab** ppVTab, char** pzErr);
+    static int xDisconnect(sqlite3_vtab* pVTab);
+    static int xDestroy(sqlite3_vtab* pVTab);
+    static int xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo);
+    static int xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor);
+    static int xClose(sqlite3_vtab_cursor* pCursor);
+    static int xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                       int argc, sqlite3_value** argv);
+    static int xNext(sqlite3_vtab_cursor* pCursor);
+    static int xEof(sqlite3_vtab_cursor* pCursor);
+    static int xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N);
+    static int xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid);
+
+private:
+    static sqlite3_module module_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SQLITE_JUNCTION_VTAB_H
@@ -0,0 +1,50 @@
+#ifndef FLATSQL_SQLITE_STATS_VTAB_H
+#define FLATSQL_SQLITE_STATS_VTAB_H
+
+#include "flatsql/query_stats.h"
+#include <sqlite3.h>
+
+namespace flatsql {
+
+/**
+ * Read-only eponymous virtual table over a QueryStatsLog (the module's
+ * pAux): SELECT * FROM flatsql_stats lists the recent statements, oldest
+ * first, one column per QueryStats field.
+ */
+struct StatsVTab : public sqlite3_vtab {
+    const QueryStatsLog* log;
+};
+
+struct StatsCursor : public sqlite3_vtab_cursor {
+    StatsVTab* vtab;
+    size_t position;
+    size_t count;  // Statements in the log when xFilter ran
+};
+
+class StatsVTabModule {
+public:
+    // Name the module and its table are registered under
+    static constexpr const char* TABLE_NAME = "flatsql_stats";
+
+    static sqlite3_module* getModule();
+
+    static int xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                        sqlite3_vtab** ppVTab, char** pzErr);
+    static int xDisconnect(sqlite3_vtab* pVTab);
+    static int xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo);
+    static int xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor);
+    static int xClose(sqlite3_vtab_cursor* pCursor);
+    static int xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                       int argc, sqlite3_value** argv);
+    static int xNext(sqlite3_vtab_cursor* pCursor);
+    static int xEof(sqlite3_vtab_cursor* pCursor);
+    static int xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N);
+    static int xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid);
+
+private:
+    static sqlite3_module module_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SQLITE_STATS_VTAB_H
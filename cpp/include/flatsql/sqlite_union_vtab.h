@@ -0,0 +1,92 @@
+#ifndef FLATSQL_SQLITE_UNION_VTAB_H
+#define FLATSQL_SQLITE_UNION_VTAB_H
+
+#include "flatsql/sqlite_vtab.h"
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Auxiliary data passed to the union module's xCreate/xConnect: the
+ * sources to fan out over, all with the same schema.
+ */
+struct UnionVTabInfo {
+    std::vector<std::string> sourceNames;
+    std::vector<const VTabCreateInfo*> members;  // Not owned, parallel to sourceNames
+};
+
+/**
+ * Virtual table over several FlatBuffer sources with one schema, used for
+ * unified views (SQLiteEngine::createUnifiedView) instead of UNION ALL.
+ *
+ * A query gets one plan, made by the planner of the member with the most
+ * records, and every member runs it. _source constraints pick members
+ * before any is scanned. When the plan returns rows in ORDER BY order the
+ * member streams are merged in that order, so neither the sort nor a
+ * pushed-down LIMIT has to wait for every source.
+ *
+ * Rowids are record sequences, unique when the sources share a store.
+ */
+struct UnionVTab : public sqlite3_vtab {
+    std::vector<FlatBufferVTab*> members;  // Owned
+    size_t planner;                        // Member whose statistics plan queries
+};
+
+struct UnionCursor : public sqlite3_vtab_cursor {
+    UnionVTab* vtab;
+    std::vector<FlatBufferCursor*> cursors;  // One per member, owned
+
+    // Members with rows left: a heap on the merge key when merging,
+    // otherwise in member order starting at livePosition
+    std::vector<size_t> live;
+    size_t livePosition;
+    size_t current;  // Member holding the current row
+
+    // Merge key: a column, -1 for rowid, or NO_MERGE to read members in turn
+    int mergeColumn;
+    bool descending;
+    std::vector<Value> heads;  // Merge key of each member's current row
+
+    // Rows still allowed by a pushed-down LIMIT (UINT64_MAX when none)
+    uint64_t rowsLeft;
+    bool atEof;
+};
+
+class UnionVTabModule {
+public:
+    static constexpr int NO_MERGE = -2;
+
+    static sqlite3_module* getModule();
+
+    static int xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                       sqlite3_vtab** ppVTab, char** pzErr);
+    static int xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                        sqlite3_vtab** ppVTab, char** pzErr);
+    static int xDisconnect(sqlite3_vtab* pVTab);
+    static int xDestroy(sqlite3_vtab* pVTab);
+    static int xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo);
+    static int xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor);
+    static int xClose(sqlite3_vtab_cursor* pCursor);
+    static int xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                       int argc, sqlite3_value** argv);
+    static int xNext(sqlite3_vtab_cursor* pCursor);
+    static int xEof(sqlite3_vtab_cursor* pCursor);
+    static int xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N);
+    static int xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid);
+    static int xFindFunction(sqlite3_vtab* pVTab, int nArg, const char* zName,
+                             void (**pxFunc)(sqlite3_context*, int, sqlite3_value**), void** ppArg);
+
+private:
+    static sqlite3_module module_;
+
+    // Merge key of a member cursor's current row
+    static Value mergeKey(const UnionCursor* cursor, size_t member);
+
+    // Whether member a's current row comes before member b's
+    static bool mergesBefore(const UnionCursor* cursor, size_t a, size_t b);
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SQLITE_UNION_VTAB_H
@@ -3,10 +3,21 @@
 
 #include "flatsql/types.h"
 #include "flatsql/storage.h"
-#include "flatsql/sqlite_index.h"
+#include "flatsql/index.h"
+#include "flatsql/column_cache.h"
+#include "flatsql/zone_map.h"
+#include "flatsql/deletion_bitmap.h"
+#include "flatsql/schema_extractor.h"
+#include "flatsql/record_verification.h"
+#include "flatsql/field_cipher.h"
+#include "flatsql/geo_functions.h"
+#include "flatsql/full_text_index.h"
+#include "flatsql/trigram_index.h"
+#include "flatsql/composite_index.h"
+#include "flatsql/index_advisor.h"
+#include "flatsql/query_stats.h"
 #include <sqlite3.h>
 #include <functional>
-#include <unordered_set>
 
 namespace flatbuffers { class EncryptionContext; }
 
@@ -15,6 +26,7 @@ namespace flatsql {
 // Forward declarations
 class FlatBufferVTab;
 class FlatBufferCursor;
+struct VTabCreateInfo;
 
 // Field extractor function type - extracts field values from raw FlatBuffer
 using FieldExtractor = std::function<Value(const uint8_t* data, size_t length, const std::string& fieldName)>;
@@ -37,10 +49,42 @@ enum class ScanType {
     RowidLookup         // Lookup by rowid (sequence)
 };
 
+/**
+ * Visibility pins for the statement being executed.
+ * The first cursor over a store pins its published sequence; later cursors
+ * in the same statement reuse the pin, so every table in a query (including
+ * self-joins) sees one consistent record count while ingest continues.
+ * Owned by SQLiteEngine, which resets it at the start of each statement.
+ */
+struct ReadSnapshot {
+    uint64_t pin(const StreamingFlatBufferStore* store) {
+        for (const auto& [pinned, sequence] : pins) {
+            if (pinned == store) return sequence;
+        }
+        uint64_t sequence = cap(store->getVisibleSequence());
+        pins.emplace_back(store, sequence);
+        return sequence;
+    }
+    void reset() { pins.clear(); }
+
+    // visible, or asOf if that is earlier
+    uint64_t cap(uint64_t visible) const { return asOf != 0 && asOf < visible ? asOf : visible; }
+
+    std::vector<std::pair<const StreamingFlatBufferStore*, uint64_t>> pins;
+    uint64_t asOf = 0;  // Sequence watermark of AS-OF queries (0 = latest); kept across statements
+};
+
+// A decrypted column value kept by a cursor (sequence 0 = empty slot)
+struct DecryptedValue {
+    uint64_t sequence = 0;
+    int column = -1;
+    Value value;
+};
+
 // Index info for optimization
 struct VTabIndexInfo {
     std::string columnName;
-    SqliteIndex* index;
+    Index* index;
 };
 
 /**
@@ -54,18 +98,84 @@ struct FlatBufferVTab : public sqlite3_vtab {
     std::string fileId;                     // File identifier for routing
     FieldExtractor extractor;               // Extracts values from FlatBuffers
     FastFieldExtractor fastExtractor;       // Optional fast path that writes directly to SQLite
-    std::unordered_map<std::string, SqliteIndex*> indexes;  // Column name -> SQLite index (not owned)
-    std::unordered_set<uint64_t>* tombstones; // Deleted sequences (not owned, may be nullptr)
+    BatchExtractor batchExtractor;          // Optional whole-row decoder for wide projections
+    std::unordered_map<std::string, Index*> indexes;  // Column name -> index (not owned)
+    std::vector<const CompositeIndex*> composites;    // Composite entries of indexes, by name
+    DeletionBitmap* tombstones;             // Deleted sequences (not owned, may be nullptr)
 
     // Column index for virtual _source column (-1 if not enabled)
     int sourceColumnIndex;
 
+    // Column index of the hidden _rank column (-1 without a full-text index)
+    int rankColumnIndex;
+
     // Source-specific record infos (for multi-source routing)
     // When set, uses these instead of store->getRecordInfoVector(fileId)
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>* sourceRecordInfos;
+    const StreamingFlatBufferStore::RecordInfoList* sourceRecordInfos;
 
     // Encryption context for field-level decryption (not owned, may be nullptr)
     const flatbuffers::EncryptionContext* encryptionCtx;
+
+    // Per column, filled in for encrypted columns when encryptionCtx is set
+    std::vector<FieldCipher> fieldCiphers;
+
+    // Per-statement visibility pins (not owned, nullptr = latest published)
+    ReadSnapshot* snapshot;
+
+    // Materialized columns in sourceRecordInfos order (not owned, may be nullptr)
+    const ColumnCacheSlots* columnCaches;
+
+    // Per-zone min/max of columns in sourceRecordInfos order (not owned, may be nullptr)
+    const ZoneMapSlots* zoneMaps;
+
+    // Per-zone Bloom filters of columns, likewise (not owned, may be nullptr)
+    const ZoneBloomSlots* bloomFilters;
+
+    // Schema-generated reader used when there is no fastExtractor (not owned, may be nullptr)
+    const SchemaExtractor* schemaExtractor;
+
+    // Checks records the first time they are read in Lazy mode (not owned, may be nullptr)
+    RecordVerification* verification;
+
+    // Per-statement counters of the owning engine (not owned, may be nullptr)
+    QueryStatsLog* queryStats;
+
+    // Unindexed columns full scans filter on (not owned, may be nullptr)
+    IndexAdvisor* indexAdvisor;
+
+    // Create info this table was connected from, which forgets it on
+    // xDisconnect (not owned)
+    VTabCreateInfo* createInfo;
+};
+
+/**
+ * Comparison pushed into a full scan (see xBestIndex) and evaluated over a
+ * column cache before rows are handed to SQLite.
+ */
+struct ScanPredicate {
+    const ColumnCache* cache;
+    ColumnCache::Comparison comparison;
+
+    // geo_within(_geo, region) instead: cache holds latitude, lonCache longitude
+    const ColumnCache* lonCache = nullptr;
+    GeoRegion region;
+
+    // Bit i is set when row block * 64 + i may pass (see ColumnCache::matchBlock)
+    uint64_t matchBlock(size_t block) const;
+};
+
+// Comparison pushed into a full scan and checked per zone of a ZoneMap,
+// or an equality checked against a ZoneBloomFilter
+struct ZonePredicate {
+    const ZoneMap* zones;
+    ColumnCache::Comparison comparison;
+    const ZoneBloomFilter* bloom = nullptr;  // Set instead of zones
+    uint64_t hash = 0;                       // ZoneBloomFilter::hash of the value
+
+    bool mayMatch(size_t zone) const {
+        return bloom ? bloom->mayContain(zone, hash) : zones->mayMatch(zone, comparison);
+    }
+    size_t zoneCount() const { return bloom ? bloom->zones() : zones->zones(); }
 };
 
 /**
@@ -90,15 +200,20 @@ struct FlatBufferCursor : public sqlite3_vtab_cursor {
     uint64_t currentSequence;       // rowid
     const uint8_t* currentData;
     uint32_t currentLength;
+    SegmentPin segmentPin;          // Keeps currentData alive when it is in a cold chunk
+    uint64_t verifiedSequence;      // Record Lazy verification last passed (0 = none)
     bool atEof;
 
     // Scan configuration
     ScanType scanType;
 
-    // For index-based scans (multi-result)
+    // For index scans that need every entry up front (IN lists, intersections)
     std::vector<IndexEntry> indexResults;
     size_t indexPosition;
 
+    // For equality and range scans, stepped from xNext (nullptr otherwise)
+    std::unique_ptr<IndexCursor> indexCursor;
+
     // For single lookup - no allocation
     IndexEntry singleResult;
     bool singleResultReturned;
@@ -111,8 +226,8 @@ struct FlatBufferCursor : public sqlite3_vtab_cursor {
     // For indexed full scan iteration (O(1) per record)
     size_t scanFileIndex;
     size_t scanFileCount;
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>* scanRecordInfos;
-    const uint8_t* scanDataBuffer;  // Cached data buffer pointer for inline access
+    const StreamingFlatBufferStore::RecordInfoList* scanRecordInfos;
+    const StreamingFlatBufferStore* scanStore;  // Cached store pointer for inline record access
 
     // For lazy full scan iteration (legacy)
     bool useLazyScan;
@@ -126,14 +241,65 @@ struct FlatBufferCursor : public sqlite3_vtab_cursor {
     std::vector<Value> columnCache;
     bool cacheValid;
 
+    // Decrypted values of encrypted columns, direct-mapped on (sequence,
+    // column) so records revisited by a join or re-filter skip decryption;
+    // empty when the table has no encryption context
+    std::vector<DecryptedValue> decryptedValues;
+    std::vector<uint8_t> decryptScratch;
+
     // Cached column count to avoid size() calls
     int numRealColumns;
 
     // Cached fast extractor to avoid vtab pointer chase
     FastFieldExtractor cachedFastExtractor;
 
+    // Whole-row decoder when the plan reads enough columns to use it (set
+    // in xFilter, nullptr otherwise); xColumn then fills columnCache once
+    // per row instead of walking the vtable per column
+    BatchExtractor rowExtractor;
+
     // Cached tombstone flag - true if there are tombstones to check
     bool hasTombstones;
+
+    // Full scan whose plan reads no record bytes (colUsed is only _rowid,
+    // _offset, _source or materialized columns): rows are stepped by their
+    // record info alone and currentData stays nullptr until loadRecord()
+    bool deferRecord;
+
+    // indexResults come from a full-text index, keyed by score (for _rank)
+    bool ranked;
+
+    // Composite index whose keys answer every column this scan reads
+    // (nullptr otherwise): rows are decoded from the keys into
+    // coveredValues (by column) and currentData stays nullptr
+    const CompositeIndex* coveringIndex;
+    std::vector<Value> coveredValues;
+
+    // Highest sequence this scan may return (pinned in xFilter)
+    uint64_t visibleSequence;
+
+    // Column caches and zone maps usable for this scan (row = scanFileIndex),
+    // nullptr if none
+    const ColumnCacheSlots* scanColumnCaches;
+    const ZoneMapSlots* scanZoneMaps;
+    const ZoneBloomSlots* scanBloomFilters;
+
+    // Pushed-down comparisons on cached columns, evaluated 64 rows at a time;
+    // predicateMask has a bit per row of block predicateBlock that passed
+    std::vector<ScanPredicate> scanPredicates;
+    size_t predicateBlock;
+    uint64_t predicateMask;
+
+    // Pushed-down comparisons on zone-mapped columns; whole zones of
+    // ZoneMap::ZONE_ROWS rows that fail one are skipped
+    std::vector<ZonePredicate> zonePredicates;
+    size_t predicateZone;  // Last zone that passed them
+
+    // Rows still allowed by a pushed-down LIMIT (UINT64_MAX when none)
+    uint64_t rowsLeft;
+
+    // Statement being recorded when xFilter ran (nullptr when none)
+    QueryStats* stats;
 };
 
 /**
@@ -146,8 +312,6 @@ public:
     static sqlite3_module* getModule();
 
     // Module callbacks
-    static int xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
-                       sqlite3_vtab** ppVTab, char** pzErr);
     static int xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
                         sqlite3_vtab** ppVTab, char** pzErr);
     static int xDisconnect(sqlite3_vtab* pVTab);
@@ -161,19 +325,56 @@ public:
     static int xEof(sqlite3_vtab_cursor* pCursor);
     static int xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N);
     static int xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid);
+    static int xFindFunction(sqlite3_vtab* pVTab, int nArg, const char* zName,
+                             void (**pxFunc)(sqlite3_context*, int, sqlite3_value**), void** ppArg);
 
-private:
-    static sqlite3_module module_;
+    // Schema declared for a table (its columns plus the virtual ones)
+    static std::string buildTableDecl(const TableDef& tableDef);
 
-    // Helper to build column declaration for sqlite3_declare_vtab
-    static std::string buildColumnDecl(const ColumnDef& col);
-    static std::string valueTypeToSQLite(ValueType type);
+    // Column index of the hidden _rank column, -1 unless a column has a
+    // full-text index
+    static int rankColumnIndex(const TableDef& tableDef);
+
+    // Table state for info, without registering it (caller deletes)
+    static FlatBufferVTab* createVTab(const VTabCreateInfo& info);
+
+    // Whether a plan's index results come back in reverse (ORDER BY ... DESC)
+    static bool isDescending(int idxNum);
+
+    // Rows a LIMIT / OFFSET listed in idxStr lets a scan return
+    // (LIMIT + OFFSET, 0 for LIMIT 0, UINT64_MAX when there is none)
+    static uint64_t pushedRowLimit(const char* idxStr, int argc, sqlite3_value** argv);
+
+    // Whether vtab's source passes the _source constraints xBestIndex
+    // listed in idxStr
+    static bool matchesSource(const FlatBufferVTab* vtab, const char* idxStr,
+                              int argc, sqlite3_value** argv);
+
+    // Point currentData at the row of a deferRecord scan (no-op when it is
+    // already set); false at EOF
+    static bool loadRecord(FlatBufferCursor* cursor);
+
+    // Refill vtab->composites from vtab->indexes (after indexes change)
+    static void collectComposites(FlatBufferVTab* vtab);
 
     // Helper to set SQLite result from Value
     static void setResultFromValue(sqlite3_context* ctx, const Value& value);
 
     // Helper to get Value from sqlite3_value
     static Value valueFromSqlite(sqlite3_value* val);
+
+    // Column type for sqlite3_declare_vtab
+    static std::string valueTypeToSQLite(ValueType type);
+
+private:
+    static sqlite3_module module_;
+
+    // Helper to build column declaration for sqlite3_declare_vtab
+    static std::string buildColumnDecl(const ColumnDef& col);
+
+    // Helper to load the full-scan predicates xBestIndex encoded in idxStr
+    static void parseScanPredicates(FlatBufferCursor* cursor, const char* idxStr,
+                                    int argc, sqlite3_value** argv);
 };
 
 /**
@@ -187,13 +388,32 @@ struct VTabCreateInfo {
     std::string fileId;
     FieldExtractor extractor;
     FastFieldExtractor fastExtractor;
-    std::unordered_map<std::string, SqliteIndex*> indexes;
-    std::unordered_set<uint64_t>* tombstones;
+    BatchExtractor batchExtractor = nullptr;
+    std::unordered_map<std::string, Index*> indexes;
+    DeletionBitmap* tombstones;
     // Source-specific record infos (for multi-source routing)
     // When set, uses these instead of store->getRecordInfoVector(fileId)
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>* sourceRecordInfos = nullptr;
+    const StreamingFlatBufferStore::RecordInfoList* sourceRecordInfos = nullptr;
     // Encryption context for field-level decryption (not owned)
     const flatbuffers::EncryptionContext* encryptionCtx = nullptr;
+    // Per-statement visibility pins (not owned)
+    ReadSnapshot* snapshot = nullptr;
+    // Materialized columns (not owned)
+    const ColumnCacheSlots* columnCaches = nullptr;
+    // Zone maps and Bloom filters (not owned)
+    const ZoneMapSlots* zoneMaps = nullptr;
+    const ZoneBloomSlots* bloomFilters = nullptr;
+    // Schema-generated field reader (not owned)
+    const SchemaExtractor* schemaExtractor = nullptr;
+    // Lazy record verification (not owned)
+    RecordVerification* verification = nullptr;
+    // Per-statement counters (not owned)
+    QueryStatsLog* queryStats = nullptr;
+    // Unindexed column usage (not owned)
+    IndexAdvisor* indexAdvisor = nullptr;
+    // Table connected from this info, if any, so indexes added later
+    // reach it (set by xConnect)
+    FlatBufferVTab* connected = nullptr;
 };
 
 }  // namespace flatsql
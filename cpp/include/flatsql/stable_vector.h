@@ -0,0 +1,143 @@
+#ifndef FLATSQL_STABLE_VECTOR_H
+#define FLATSQL_STABLE_VECTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace flatsql {
+
+/**
+ * Append-only array whose elements never move.
+ *
+ * Storage is a fixed table of geometrically growing chunks (chunk k holds
+ * BASE << k elements), so push_back never relocates existing elements and
+ * the size is published with release semantics after the element is
+ * written. One writer may append while any number of readers index
+ * elements below a size() they have observed, without locking.
+ *
+ * clear() and writes to existing elements are writer-only and must not
+ * race with readers.
+ */
+template <typename T>
+class StableVector {
+    static_assert(std::is_trivially_copyable<T>::value, "StableVector holds trivially copyable types");
+
+public:
+    StableVector() = default;
+    StableVector(const StableVector&) = delete;
+    StableVector& operator=(const StableVector&) = delete;
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](size_t i) const {
+        size_t chunk, pos;
+        locate(i, chunk, pos);
+        return chunks_[chunk][pos];
+    }
+
+    T& operator[](size_t i) {
+        size_t chunk, pos;
+        locate(i, chunk, pos);
+        return chunks_[chunk][pos];
+    }
+
+    const T& back() const { return (*this)[size() - 1]; }
+
+    // Bytes of the chunks allocated so far
+    size_t capacityBytes() const {
+        size_t bytes = 0;
+        for (size_t chunk = 0; chunk < MAX_CHUNKS; chunk++) {
+            if (chunks_[chunk]) bytes += (BASE << chunk) * sizeof(T);
+        }
+        return bytes;
+    }
+
+    void push_back(const T& value) {
+        size_t n = size_.load(std::memory_order_relaxed);
+        size_t chunk, pos;
+        locate(n, chunk, pos);
+        if (!chunks_[chunk]) {
+            chunks_[chunk].reset(new T[BASE << chunk]);
+        }
+        chunks_[chunk][pos] = value;
+        size_.store(n + 1, std::memory_order_release);
+    }
+
+    // Append count copies of value
+    void assign(size_t count, const T& value) {
+        clear();
+        for (size_t i = 0; i < count; i++) {
+            push_back(value);
+        }
+    }
+
+    // Drops all elements and chunks (writer-only, no concurrent readers)
+    void clear() {
+        size_.store(0, std::memory_order_release);
+        for (auto& chunk : chunks_) {
+            chunk.reset();
+        }
+    }
+
+    // Exchange contents with other (writer-only, no concurrent readers of either)
+    void swap(StableVector& other) {
+        for (size_t chunk = 0; chunk < MAX_CHUNKS; chunk++) {
+            chunks_[chunk].swap(other.chunks_[chunk]);
+        }
+        size_t n = size_.load(std::memory_order_relaxed);
+        size_.store(other.size_.load(std::memory_order_relaxed), std::memory_order_release);
+        other.size_.store(n, std::memory_order_release);
+    }
+
+    // Visit elements [0, size()) as contiguous runs: fn(const T* data, size_t count)
+    template <typename F>
+    void forEachRun(F&& fn) const {
+        size_t remaining = size();
+        for (size_t chunk = 0; remaining > 0 && chunk < MAX_CHUNKS; chunk++) {
+            size_t count = BASE << chunk;
+            if (count > remaining) count = remaining;
+            fn(chunks_[chunk].get(), count);
+            remaining -= count;
+        }
+    }
+
+    class const_iterator {
+    public:
+        const_iterator(const StableVector* vec, size_t index) : vec_(vec), index_(index) {}
+        const T& operator*() const { return (*vec_)[index_]; }
+        const T* operator->() const { return &(*vec_)[index_]; }
+        const_iterator& operator++() { ++index_; return *this; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const StableVector* vec_;
+        size_t index_;
+    };
+
+    // Iteration covers the elements published when begin()/end() were called
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+private:
+    static constexpr size_t BASE_SHIFT = 10;
+    static constexpr size_t BASE = size_t(1) << BASE_SHIFT;
+    static constexpr size_t MAX_CHUNKS = sizeof(size_t) * 8 - BASE_SHIFT;
+
+    // Element i lives in chunk floor(log2(i / BASE + 1))
+    static void locate(size_t i, size_t& chunk, size_t& pos) {
+        size_t j = (i >> BASE_SHIFT) + 1;
+        chunk = sizeof(unsigned long long) * 8 - 1 - static_cast<size_t>(__builtin_clzll(j));
+        pos = i - ((size_t(1) << chunk) - 1) * BASE;
+    }
+
+    std::unique_ptr<T[]> chunks_[MAX_CHUNKS];
+    std::atomic<size_t> size_{0};
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_STABLE_VECTOR_H
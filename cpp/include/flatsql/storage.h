@@ -2,13 +2,50 @@
 #define FLATSQL_STORAGE_H
 
 #include "flatsql/types.h"
+#include "flatsql/memory_usage.h"
+#include "flatsql/stable_vector.h"
+#include <atomic>
+#include <cstring>
 #include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <optional>
+#include <shared_mutex>
 #include <string_view>
 
 namespace flatsql {
 
+// Backing layout for the raw FlatBuffer stream
+enum class StorageMode {
+    Contiguous,   // Single growable buffer (doubles and relocates on growth)
+    Segmented,    // Fixed-size chunks that never move once allocated
+    MappedFile    // Stream appended to a file and memory-mapped (POSIX only)
+};
+
+// Options for constructing a StreamingFlatBufferStore
+struct StorageOptions {
+    StorageMode mode = StorageMode::Contiguous;
+    size_t initialCapacity = 1024 * 1024;      // Contiguous: initial buffer size
+    size_t segmentSize = 64 * 1024 * 1024;     // Segmented: chunk size (rounded up to power of two)
+    std::string path;                          // MappedFile: stream file (sidecar is path + ".meta")
+    uint64_t mapReserve = 0;                   // MappedFile: max stream size, 0 = platform default
+    size_t coldCacheSegments = 4;              // Segmented: decompressed cold chunks kept in memory
+};
+
+/**
+ * Keeps the decompressed copy of a cold chunk alive while held, so a
+ * pointer recordAt() returned into it stays valid after the store's cache
+ * evicts the chunk. Reusing one pin for consecutive records of a chunk
+ * also skips the cache lookup.
+ */
+struct SegmentPin {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    uint64_t store = 0;  // Pinning store's layout ID (0 = empty)
+    size_t slot = 0;
+};
+
 /**
  * Streaming FlatBuffer storage.
  *
@@ -23,6 +60,31 @@ namespace flatsql {
  *
  * This is a pure streaming format - no custom headers, no conversion.
  * Indexes are built during streaming ingest.
+ *
+ * In Segmented mode the stream lives in fixed-size chunks. Offsets stay
+ * logical (chunk index in the high bits, position in the low bits) and a
+ * record never straddles two chunks, so growth is O(1) and every pointer
+ * handed out remains valid while ingest continues. Records larger than a
+ * chunk get a dedicated run of consecutive chunks.
+ *
+ * Sealed chunks can be compressed (compressColdSegments()). A cold chunk
+ * is decompressed on first access into a small LRU cache; recordAt() and
+ * getDataAtOffset() stay transparent, though a pointer into a cold chunk
+ * only lives as long as its SegmentPin (by default a per-thread pin that
+ * moves on when the thread reads another cold chunk).
+ *
+ * In MappedFile mode the stream is the file itself. Address space for the
+ * whole file is reserved up front and the file is mapped into it as it
+ * grows, so pointers stay valid. sync() writes a metadata sidecar holding
+ * the sequence and file ID indexes; reopening the same path restores them
+ * from the sidecar and only scans records appended after the last sync.
+ *
+ * Concurrency: one writer thread ingests while reader threads query. The
+ * record tables are StableVectors, so they never relocate, and each ingest
+ * call ends by publishing its highest sequence (publish()). Readers only
+ * look at records at or below getVisibleSequence() and use
+ * getVisibleDataAtOffset(). Readers need a storage mode whose records do
+ * not move (Segmented or MappedFile); Contiguous mode relocates on growth.
  */
 class StreamingFlatBufferStore {
 public:
@@ -37,6 +99,11 @@ public:
     )>;
 
     explicit StreamingFlatBufferStore(size_t initialCapacity = 1024 * 1024);
+    explicit StreamingFlatBufferStore(const StorageOptions& options);
+    ~StreamingFlatBufferStore();
+
+    StreamingFlatBufferStore(const StreamingFlatBufferStore&) = delete;
+    StreamingFlatBufferStore& operator=(const StreamingFlatBufferStore&) = delete;
 
     // Stream raw size-prefixed FlatBuffers
     // Calls callback for each complete FlatBuffer ingested
@@ -50,26 +117,135 @@ public:
     // Ingest a single FlatBuffer (without size prefix), returns sequence
     uint64_t ingestFlatBuffer(const uint8_t* data, size_t length, IngestCallback callback);
 
+    /**
+     * Zero-copy streaming: reserveIngest(bytes) returns space for the next
+     * bytes of a size-prefixed stream at the store's own tail, right after
+     * any partial record the last commit left there. The caller writes up
+     * to bytes into it and commitIngest(written) indexes the records they
+     * complete in place; a trailing partial record stays pending for the
+     * next reservation. Returns the records committed.
+     *
+     * The pointer is valid until the next call on the store (Contiguous
+     * mode relocates on growth). While a partial record is pending the
+     * other ingest calls throw, since they would write over it.
+     *
+     * @throws std::runtime_error if commitIngest() exceeds the reservation
+     */
+    uint8_t* reserveIngest(size_t bytes);
+    size_t commitIngest(size_t bytes, IngestCallback callback);
+
+    // Bytes of a partial record waiting for the next commitIngest()
+    size_t getPendingIngestBytes() const { return pendingIngest_; }
+
     // Load existing stream data and rebuild via callback
     void loadAndRebuild(const uint8_t* data, size_t length, IngestCallback callback);
 
+    // Make every stored record visible to readers. Ingest calls publish on
+    // return unless deferred (FlatSQLDatabase defers until indexes are flushed).
+    void publish();
+    void setPublishDeferred(bool deferred) { publishDeferred_ = deferred; }
+
+    /**
+     * Exchange stored records with other, an in-memory store of the same
+     * mode (compaction swaps in a rewritten stream this way). File ID
+     * record lists stay at their addresses here; only their contents move.
+     * Writer-only: no reader may be using either store.
+     *
+     * @throws std::runtime_error for MappedFile storage or mismatched modes
+     */
+    void swapContents(StreamingFlatBufferStore& other);
+
+    /**
+     * Compress sealed Segmented chunks that hold whole records, except the
+     * keepHot most recent ones, so recent records keep raw access for
+     * ingest and point lookups. Chunks that shrink by less than an eighth
+     * stay raw. Writer-only: no reader may be using the store.
+     *
+     * @return bytes of memory released
+     * @throws std::runtime_error unless the store is Segmented
+     */
+    size_t compressColdSegments(size_t keepHot = 1);
+
+    // Chunks currently compressed, and their compressed size
+    size_t getColdSegmentCount() const;
+    uint64_t getColdBytes() const;
+
+    // Drop the decompressed cold chunks (chunks pinned by readers stay
+    // alive with their pins); they are decompressed again on next access
+    void clearColdCache();
+
+    /**
+     * Retention: free the sealed Segmented allocations at the front of the
+     * stream whose records all have sequences up to sequence. Evicted
+     * records are gone, as if never stored: hasRecord() is false for them,
+     * iteration and export start after them and reading their offsets
+     * throws. Their sequences stay taken, and their file ID list entries
+     * stay until compaction. Writer-only: no reader may be using the store.
+     *
+     * @return bytes of memory released
+     * @throws std::runtime_error unless the store is Segmented
+     */
+    size_t evictThrough(uint64_t sequence);
+
+    /**
+     * The sequences of the index-th sealed allocation not yet evicted,
+     * oldest first (an oversized record's allocation covers several
+     * chunks). Returns false past the last sealed one.
+     */
+    bool getSealedSegment(size_t index, uint64_t* firstSequence, uint64_t* lastSequence) const;
+
+    // Last evicted sequence, and the stream bytes before the first kept record
+    uint64_t getEvictedSequence() const { return evictedSequence_; }
+    uint64_t getEvictedLength() const { return evictedEnd_; }
+
+    // Highest sequence readers may see, and the stream length it covers
+    uint64_t getVisibleSequence() const { return visibleSequence_.load(std::memory_order_acquire); }
+    uint64_t getVisibleLength() const { return visibleLength_.load(std::memory_order_acquire); }
+
+    // Replay records stored at or after fromOffset through callback (no copy)
+    // fromOffset must be a record start or the write offset
+    void replayFrom(uint64_t fromOffset, IngestCallback callback) const;
+
+    // MappedFile mode: flush the mapping and write the metadata sidecar.
+    // No-op for in-memory modes.
+    void sync();
+
+    // MappedFile mode: stream length covered by the sidecar loaded on open
+    // (records below this offset were restored without scanning)
+    uint64_t getRestoredLength() const { return restoredLength_; }
+
+    // MappedFile mode: path of the stream file (empty for in-memory modes)
+    const std::string& getMappedPath() const { return mapPath_; }
+
     // Read raw FlatBuffer at offset (returns pointer into storage, no copy)
     const uint8_t* getDataAtOffset(uint64_t offset, uint32_t* outLength) const;
 
+    // Same, bounded by the published stream length (safe on reader threads);
+    // a cold record is kept alive by pin when given (see SegmentPin)
+    const uint8_t* getVisibleDataAtOffset(uint64_t offset, uint32_t* outLength,
+                                          SegmentPin* pin = nullptr) const;
+
     // Read a record by offset (copies data)
     StoredRecord readRecordAtOffset(uint64_t offset) const;
 
-    // Get sequence number for offset (O(1) lookup)
+    // Get sequence number for offset (binary search, 0 if not a record start)
     uint64_t getSequenceForOffset(uint64_t offset) const;
 
     // Read a record by sequence
     StoredRecord readRecord(uint64_t sequence) const;
 
     // Check if sequence exists
-    bool hasRecord(uint64_t sequence) const;
+    bool hasRecord(uint64_t sequence) const {
+        return sequence > evictedSequence_ && sequence <= sequenceOffsets_.size();
+    }
 
-    // Get offset for sequence
-    std::optional<uint64_t> getOffsetForSequence(uint64_t sequence) const;
+    // Get offset for sequence (single array load)
+    std::optional<uint64_t> getOffsetForSequence(uint64_t sequence) const {
+        if (!hasRecord(sequence)) {
+            return std::nullopt;
+        }
+        return sequenceOffsets_[sequence - 1];
+    }
 
     // Iterate all records
     void iterateRecords(std::function<bool(const StoredRecord&)> callback) const;
@@ -94,6 +270,12 @@ public:
         uint64_t sequence;
     };
 
+    // Per-file-ID (and per-table) record list, ascending by sequence
+    using RecordInfoList = StableVector<FileRecordInfo>;
+
+    // Number of leading entries with sequence <= visibleSequence
+    static size_t visibleCount(const RecordInfoList& infos, uint64_t visibleSequence);
+
     // Get next record after the given offset, returns false if no more records
     // For lazy iteration without building a vector of all records
     bool getNextRecord(uint64_t afterOffset, std::string_view fileId,
@@ -106,18 +288,67 @@ public:
                         const uint8_t** outData, uint32_t* outLength) const;
 
     // Export raw stream data
+    // getData() exposes the in-memory contiguous buffer (empty in other modes)
     const std::vector<uint8_t>& getData() const { return data_; }
-    std::vector<uint8_t> exportData() const {
-        return std::vector<uint8_t>(data_.begin(), data_.begin() + writeOffset_);
-    }
+    std::vector<uint8_t> exportData() const { return exportSince(0); }
+
+    // The records after sequence watermark, as one plain stream
+    std::vector<uint8_t> exportSince(uint64_t sequence) const;
+
+    /**
+     * Export without copying: the stream (or the records after a sequence
+     * watermark) comes out as spans of whole size-prefixed records that
+     * point into storage. Contiguous and MappedFile storage is a single
+     * span; Segmented storage gives one per run of adjacent chunk memory,
+     * with chunk tails left out, and a cold chunk is decompressed only
+     * while its span is out. Records deleted by tombstone are included,
+     * as in exportData().
+     *
+     * A span stays valid until the next nextExportChunk() call on its
+     * cursor or the next ingest. cursor.sequence is the last sequence
+     * exported so far, the watermark for the next incremental export.
+     */
+    struct ExportCursor {
+        uint64_t offset = 0;       // Next record
+        uint64_t end = 0;          // Stream end when the export began
+        uint64_t sequence = 0;     // Last sequence exported
+        uint64_t endSequence = 0;  // Last sequence when the export began
+        SegmentPin pin;
+    };
+    ExportCursor beginExport(uint64_t afterSequence = 0) const;
+    bool nextExportChunk(ExportCursor& cursor, const uint8_t** data, size_t* length) const;
+
+    // Same, as a callback per span (return false to stop); returns the
+    // last sequence exported
+    using ExportCallback = std::function<bool(const uint8_t* data, size_t length)>;
+    uint64_t exportChunks(const ExportCallback& callback, uint64_t afterSequence = 0) const;
 
     // Statistics
     uint64_t getRecordCount() const { return recordCount_; }
     uint64_t getDataSize() const { return writeOffset_; }
 
+    // Bytes held by the stream and its record tables (writer thread)
+    StorageMemory getMemoryUsage() const;
+
     // Extract file identifier from a FlatBuffer (bytes 4-7)
     static std::string extractFileId(const uint8_t* flatbuffer, size_t length);
 
+    // Same, as a view of the buffer's own bytes (empty when too small)
+    static std::string_view fileIdView(const uint8_t* flatbuffer, size_t length) {
+        if (length < FILE_IDENTIFIER_OFFSET + FILE_IDENTIFIER_LENGTH) return {};
+        return std::string_view(reinterpret_cast<const char*>(flatbuffer + FILE_IDENTIFIER_OFFSET),
+                                FILE_IDENTIFIER_LENGTH);
+    }
+
+    // A 4-byte file identifier as one integer (little-endian), for routing
+    // tables that compare keys instead of strings; 0 for any other length
+    static uint32_t packFileId(std::string_view fileId) {
+        if (fileId.size() != FILE_IDENTIFIER_LENGTH) return 0;
+        uint32_t key;
+        std::memcpy(&key, fileId.data(), sizeof(key));
+        return key;
+    }
+
     // Get record by index within file ID (O(1) random access)
     // Returns false if index out of bounds
     bool getRecordByFileIndex(std::string_view fileId, size_t index,
@@ -127,35 +358,229 @@ public:
     // Get count of records for a file ID
     size_t getRecordCountByFileId(std::string_view fileId) const;
 
-    // Get direct pointer to record info vector (avoids map lookup per iteration)
-    const std::vector<FileRecordInfo>* getRecordInfoVector(std::string_view fileId) const;
+    // Get direct pointer to record info list (avoids map lookup per iteration)
+    // The list stays valid and at the same address for the store's lifetime
+    const RecordInfoList* getRecordInfoVector(std::string_view fileId) const;
 
     // Get direct access to underlying storage buffer (for inline iteration)
-    const uint8_t* getDataBuffer() const { return data_.data(); }
+    // Returns nullptr in Segmented mode, use recordAt() instead
+    const uint8_t* getDataBuffer() const { return segmentShift_ ? nullptr : flatBase_; }
     uint64_t getWriteOffset() const { return writeOffset_; }
 
+    // Pointer to the size prefix of the record stored at offset (no bounds
+    // check); records in cold chunks go through the calling thread's pin
+    const uint8_t* recordAt(uint64_t offset) const {
+        if (segmentShift_ == 0) {
+            return flatBase_ + offset;
+        }
+        const uint8_t* base = segmentBases_[offset >> segmentShift_];
+        if (__builtin_expect(base != nullptr, 1)) {
+            return base + (offset & segmentMask_);
+        }
+        return coldRecordAt(offset);
+    }
+
+    // Same, with pin keeping a cold record alive (cursors hold one each)
+    const uint8_t* recordAt(uint64_t offset, SegmentPin& pin) const {
+        if (segmentShift_ == 0) {
+            return flatBase_ + offset;
+        }
+        const uint8_t* base = segmentBases_[offset >> segmentShift_];
+        if (__builtin_expect(base != nullptr, 1)) {
+            return base + (offset & segmentMask_);
+        }
+        return coldRecordAt(offset, pin);
+    }
+
+    // Same, but nullptr for a record in a cold chunk instead of loading it
+    // (for prefetching, which must not page chunks in)
+    const uint8_t* residentRecordAt(uint64_t offset) const {
+        if (segmentShift_ == 0) {
+            return flatBase_ + offset;
+        }
+        const uint8_t* base = segmentBases_[offset >> segmentShift_];
+        return base ? base + (offset & segmentMask_) : nullptr;
+    }
+
+    StorageMode getStorageMode() const { return mode_; }
+
 private:
     void ensureCapacity(size_t needed);
-    void indexRecord(const std::string& fileId, uint64_t offset);
 
+    // MappedFile helpers
+    void openMapped(const StorageOptions& options);
+    void growMapping(uint64_t needed);
+    bool loadSidecar(uint64_t fileSize);
+    void scanMapped(uint64_t fromOffset, uint64_t fileSize);
+    void closeMapped();
+    // Append a record to its file ID's list, returns the file ID (a view of flatbuffer)
+    std::string_view indexRecord(const uint8_t* flatbuffer, size_t length,
+                                 uint64_t offset, uint64_t sequence);
+    RecordInfoList& recordListFor(std::string_view fileId);
+
+    // Reserve space for one size-prefixed record, returns write pointer
+    uint8_t* reserveRecord(size_t bytes, uint64_t* outOffset);
+
+    // Segmented mode: move the tail to a fresh allocation of whole chunks
+    // holding at least bytes, carrying the first keep bytes along
+    void startSegmentRun(size_t bytes, size_t keep);
+
+    // Offset of the record following the one at offset (skips chunk tails)
+    uint64_t nextRecordOffset(uint64_t offset, uint32_t fbSize) const;
+
+    // Cold chunk access through the cache
+    const uint8_t* coldRecordAt(uint64_t offset) const;
+    const uint8_t* coldRecordAt(uint64_t offset, SegmentPin& pin) const;
+    std::shared_ptr<const std::vector<uint8_t>> loadColdSegment(size_t slot) const;
+
+    // Records stored before offset (the index of the first at or after it)
+    size_t recordsBefore(uint64_t offset) const;
+
+    StorageMode mode_ = StorageMode::Contiguous;
     std::vector<uint8_t> data_;
+    uint8_t* flatBase_ = nullptr;  // data_.data() or the mapping base (non-segmented modes)
+
+    // MappedFile mode state
+    std::string mapPath_;
+    int mapFd_ = -1;
+    uint64_t mapReserved_ = 0;     // Reserved address space
+    uint64_t mapLength_ = 0;       // Bytes of the file currently mapped
+    uint64_t restoredLength_ = 0;
+
+    // Segmented mode state (segmentShift_ == 0 means Contiguous)
+    uint32_t segmentShift_ = 0;
+    uint64_t segmentMask_ = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> segmentStorage_;  // Owned allocations (null once cold)
+    std::vector<size_t> segmentRuns_;                         // Chunks each allocation covers
+    StableVector<uint8_t*> segmentBases_;                     // Per-chunk base pointer (null when cold)
+    std::vector<uint64_t> segmentEnd_;                        // Per-chunk logical end of data
+
+    // Compressed chunks by slot (empty while raw); only compressColdSegments()
+    // changes them, so readers index it without locking
+    struct ColdSegment {
+        std::vector<uint8_t> bytes;
+        size_t rawLength = 0;
+    };
+    std::vector<ColdSegment> coldSegments_;
+
+    // Retention: allocations and chunk slots freed from the front, the
+    // stream offset they end at and the last sequence they held
+    size_t evictedRuns_ = 0;
+    size_t evictedSlots_ = 0;
+    uint64_t evictedEnd_ = 0;
+    uint64_t evictedSequence_ = 0;
+
+    // Decompressed cold chunks, most recently used first
+    struct ColdCacheEntry {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        std::list<size_t>::iterator position;
+    };
+    size_t coldCacheCapacity_ = 4;
+    mutable std::mutex coldCacheMutex_;
+    mutable std::list<size_t> coldCacheOrder_;
+    mutable std::unordered_map<size_t, ColdCacheEntry> coldCache_;
+
+    // Identifies this store's chunk layout to pins; renewed by swapContents()
+    uint64_t layoutId_;
+
     uint64_t writeOffset_ = 0;
     uint64_t recordCount_ = 0;
+    size_t pendingIngest_ = 0;   // Partial record bytes at writeOffset_ (reserveIngest())
+    size_t reservedIngest_ = 0;  // Bytes granted past them by the last reserveIngest()
     uint64_t nextSequence_ = 1;
 
-    // sequence → offset for O(1) lookups
-    std::unordered_map<uint64_t, uint64_t> sequenceToOffset_;
-
-    // offset → sequence for reverse lookups (O(1) instead of O(n))
-    std::unordered_map<uint64_t, uint64_t> offsetToSequence_;
-
-    // fileId → list of record info for O(1) iteration by file type
-    std::unordered_map<std::string, std::vector<FileRecordInfo>> fileIdToRecords_;
+    // sequence - 1 → offset. Sequences are dense and offsets ascend with
+    // them, so this doubles as the (binary searched) offset → sequence map.
+    StableVector<uint64_t> sequenceOffsets_;
+
+    // fileId → list of record info for O(1) iteration by file type.
+    // Readers look lists up under the shared lock; the writer only takes it
+    // exclusively when a new file ID first appears.
+    std::unordered_map<std::string, RecordInfoList> fileIdToRecords_;
+    mutable std::shared_mutex fileIdMutex_;
+
+    // Writer-side packed file ID -> list shortcut, so indexing a record
+    // compares one integer instead of hashing a fresh string. Streams carry
+    // a handful of file IDs, scanned in order; map nodes never move.
+    std::vector<std::pair<uint32_t, RecordInfoList*>> fileIdRoutes_;
+
+    // Reader visibility (see publish())
+    std::atomic<uint64_t> visibleSequence_{0};
+    std::atomic<uint64_t> visibleLength_{0};
+    bool publishDeferred_ = false;
 };
 
 // Backwards compatibility alias
 using StackedFlatBufferStore = StreamingFlatBufferStore;
 
+/**
+ * Records of a lookup or scan, read in place as the range is iterated:
+ * each step yields a RecordRef pointing into storage, so consuming a
+ * result allocates nothing per record. The range holds the matches'
+ * offsets and sequences only (or, for a scan, a slice of a record list).
+ *
+ * Records stay readable while ingest continues, as with recordAt(); a ref
+ * into a cold chunk lives until its iterator advances (each iterator holds
+ * its own SegmentPin). Compaction and retention invalidate a range.
+ */
+class RecordRange {
+public:
+    using RecordRef = StreamingFlatBufferStore::RecordRef;
+    using RecordInfo = StreamingFlatBufferStore::FileRecordInfo;
+
+    class Iterator {
+    public:
+        RecordRef operator*() const {
+            const RecordInfo& info = range_->at(position_);
+            const uint8_t* ptr = range_->store_->recordAt(info.offset, pin_);
+            uint32_t length = static_cast<uint32_t>(ptr[0]) | (static_cast<uint32_t>(ptr[1]) << 8) |
+                              (static_cast<uint32_t>(ptr[2]) << 16) | (static_cast<uint32_t>(ptr[3]) << 24);
+            return {info.offset, info.sequence, ptr + SIZE_PREFIX_LENGTH, length};
+        }
+        Iterator& operator++() {
+            position_++;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return position_ == other.position_; }
+        bool operator!=(const Iterator& other) const { return position_ != other.position_; }
+
+    private:
+        friend class RecordRange;
+        Iterator(const RecordRange* range, size_t position) : range_(range), position_(position) {}
+
+        const RecordRange* range_;
+        size_t position_;
+        mutable SegmentPin pin_;
+    };
+
+    RecordRange() = default;
+
+    // Records at these offsets, in this order
+    RecordRange(const StreamingFlatBufferStore* store, std::vector<RecordInfo> hits)
+        : store_(store), hits_(std::move(hits)), count_(hits_.size()) {}
+
+    // Rows [first, last) of a record list that outlives the range
+    RecordRange(const StreamingFlatBufferStore* store, const StreamingFlatBufferStore::RecordInfoList* list,
+                size_t first, size_t last)
+        : store_(store), list_(list), first_(first), count_(last > first ? last - first : 0) {}
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, count_); }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    const RecordInfo& at(size_t position) const {
+        return list_ ? (*list_)[first_ + position] : hits_[position];
+    }
+
+    const StreamingFlatBufferStore* store_ = nullptr;
+    std::vector<RecordInfo> hits_;
+    const StreamingFlatBufferStore::RecordInfoList* list_ = nullptr;
+    size_t first_ = 0;
+    size_t count_ = 0;
+};
+
 }  // namespace flatsql
 
 #endif  // FLATSQL_STORAGE_H
@@ -0,0 +1,99 @@
+#ifndef FLATSQL_STREAM_INGESTOR_H
+#define FLATSQL_STREAM_INGESTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatsql {
+
+class FlatSQLDatabase;
+
+/**
+ * Stateful front end to FlatSQLDatabase::ingest() for size-prefixed
+ * streams cut at arbitrary points (socket reads, WebSocket messages).
+ * Frames split across chunks are kept here until complete, so callers
+ * never track consumed bytes or re-submit leftovers.
+ *
+ * Two ways to feed it:
+ *  - reserve() / commit(): read straight into the ingestor's buffer, e.g.
+ *      size_t room;
+ *      uint8_t* p = ingestor.reserve(1, &room);
+ *      ssize_t n = recv(fd, p, room, 0);
+ *      if (n > 0) ingestor.commit(n);
+ *    Complete frames are ingested from where they were received.
+ *  - write(): hand over a chunk you already hold. Complete frames are
+ *    ingested in place from the chunk; only a partial frame at either end
+ *    is copied.
+ *
+ * The buffer works as a ring over one contiguous allocation: consumed
+ * space is reclaimed by moving the held partial frame (less than one
+ * frame) to the front, only when the free tail runs out. It grows when a
+ * frame is larger than the buffer, and shrink() gives the growth back.
+ */
+class StreamIngestor {
+public:
+    // Ingests through ingestWithSource() when source is not empty
+    explicit StreamIngestor(FlatSQLDatabase& db, size_t capacity = 256 * 1024,
+                            const std::string& source = "");
+
+    // Frames declaring more than this many bytes throw (default 1 GiB)
+    void setMaxFrameSize(size_t bytes) { maxFrameSize_ = bytes; }
+
+    /**
+     * Writable region of at least minBytes after the buffered bytes, sized
+     * so the frame in progress can complete without moving again.
+     * *writable receives the region's size. Valid until the next call.
+     * @throws std::runtime_error if the frame in progress exceeds the
+     *         maximum frame size
+     */
+    uint8_t* reserve(size_t minBytes, size_t* writable);
+
+    /**
+     * Mark bytes of the last reserve() region as written and ingest every
+     * frame they complete.
+     * @return records ingested
+     */
+    size_t commit(size_t bytes);
+
+    // Feed a chunk of any length; returns records ingested
+    size_t write(const uint8_t* data, size_t length);
+
+    // Bytes of the incomplete frame held
+    size_t pending() const { return end_ - begin_; }
+
+    // Size of the frame in progress including its prefix (0 until known)
+    size_t frameBytes() const;
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // Capacity reserve(1) would add (0 if the buffer is big enough)
+    size_t growthNeeded() const;
+
+    // Return to the initial capacity when the held bytes fit in it
+    void shrink();
+
+    // Drop the held partial frame
+    void reset() { begin_ = end_ = 0; }
+
+    uint64_t getRecordsIngested() const { return recordsIngested_; }
+
+private:
+    // Ingest the complete frames of a span; returns bytes consumed
+    size_t ingestSpan(const uint8_t* data, size_t length, size_t* records);
+    void checkFrame(const uint8_t* prefix, size_t available) const;
+
+    FlatSQLDatabase& db_;
+    std::string source_;
+    std::vector<uint8_t> buffer_;
+    size_t baseCapacity_;
+    size_t begin_ = 0;  // First unconsumed byte
+    size_t end_ = 0;    // End of received bytes
+    size_t maxFrameSize_ = size_t(1) << 30;
+    uint64_t recordsIngested_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_STREAM_INGESTOR_H
@@ -0,0 +1,118 @@
+#ifndef FLATSQL_SUBSCRIPTION_H
+#define FLATSQL_SUBSCRIPTION_H
+
+#include "flatsql/types.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatsql {
+
+// One conjunct of a subscription: column <op> value. Like SQL, a record
+// whose column is NULL matches no filter on it.
+struct SubscriptionFilter {
+    enum class Op : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+
+    std::string column;
+    Op op = Op::Eq;
+    Value value;
+};
+
+// A newly ingested record that matched a subscription. data points into
+// storage (no copy) and is only valid during the callback.
+struct MatchedRecord {
+    uint64_t subscription;
+    uint64_t sequence;
+    const uint8_t* data;
+    size_t length;
+};
+
+using SubscriptionCallback = std::function<void(const MatchedRecord&)>;
+
+// Value normalized for equality matching: integers widened to int64,
+// floats to double, and integral doubles to int64, so 7, int8_t(7) and
+// 7.0 are one key
+Value subscriptionKey(const Value& value);
+
+struct SubscriptionKeyHash {
+    size_t operator()(const Value& key) const;
+};
+
+struct SubscriptionKeyEqual {
+    bool operator()(const Value& a, const Value& b) const { return compareValues(a, b) == 0; }
+};
+
+/**
+ * Subscriptions on one table, matched against each record as it is
+ * ingested. A subscription with an equality filter is filed under that
+ * column and value, so a record only probes one hash table per such
+ * column instead of testing every subscription; the rest of its filters
+ * are then checked. Subscriptions without an equality are tested in turn.
+ * Each column is extracted at most once per record.
+ */
+class SubscriptionSet {
+public:
+    using FieldExtractor = std::function<Value(const uint8_t* data, size_t length, const std::string& fieldName)>;
+
+    // Matches of one record: subscription ids, appended in no set order
+    using Matches = std::vector<uint64_t>;
+
+    /**
+     * Add subscription id.
+     * @throws std::runtime_error for a column not in table
+     */
+    void add(uint64_t id, const TableDef& table, const std::vector<SubscriptionFilter>& filters,
+             SubscriptionCallback callback);
+
+    // false if id is not here
+    bool remove(uint64_t id);
+
+    bool empty() const { return subscriptions_.empty(); }
+    size_t size() const { return subscriptions_.size(); }
+
+    // Callback of subscription id (nullptr once removed)
+    const SubscriptionCallback* callback(uint64_t id) const;
+
+    // Append the ids of subscriptions the record matches to out
+    void match(const uint8_t* data, size_t length, const FieldExtractor& extractor, Matches& out);
+
+private:
+    struct Filter {
+        int column;  // TableDef ordinal
+        SubscriptionFilter::Op op;
+        Value key;   // subscriptionKey() of the filter value
+    };
+
+    struct Subscription {
+        uint64_t id;
+        std::vector<Filter> filters;
+        int probe = -1;  // Equality filter it is filed under, -1 when scanned
+        SubscriptionCallback callback;
+    };
+
+    // Subscriptions filed by the value of one equality column
+    struct Probe {
+        int column;
+        std::unordered_map<Value, std::vector<Subscription*>, SubscriptionKeyHash, SubscriptionKeyEqual> byKey;
+    };
+
+    bool matchesFilters(const Subscription& subscription, const uint8_t* data, size_t length,
+                        const FieldExtractor& extractor);
+    const Value& columnKey(int column, const uint8_t* data, size_t length, const FieldExtractor& extractor);
+
+    std::vector<std::string> columnNames_;
+    std::unordered_map<uint64_t, std::unique_ptr<Subscription>> subscriptions_;
+    std::vector<Probe> probes_;
+    std::vector<Subscription*> scanned_;
+
+    // Keys of the record being matched, extracted on first use
+    std::vector<Value> recordKeys_;
+    std::vector<uint64_t> recordKeyStamp_;  // == recordStamp_ when recordKeys_[c] is current
+    uint64_t recordStamp_ = 0;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_SUBSCRIPTION_H
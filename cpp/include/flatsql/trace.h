@@ -0,0 +1,79 @@
+#ifndef FLATSQL_TRACE_H
+#define FLATSQL_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Tracepoints for seeing where ingest and query time goes, including in
+ * WASM builds where native profilers can't look. FLATSQL_TRACE_SCOPE(name)
+ * records the time until the end of the enclosing block as one event named
+ * name (a string literal). The scopes are compiled out, and cost nothing,
+ * unless FLATSQL_TRACING is defined to 1 (CMake option
+ * FLATSQL_ENABLE_TRACING).
+ *
+ * Events go to a fixed ring per thread that only its thread writes, so
+ * recording takes no lock; once a ring is full the oldest events are
+ * overwritten. traceExportChromeJson() writes every ring as Chrome trace
+ * JSON, which chrome://tracing and ui.perfetto.dev open. Export and clear
+ * from a point where traced threads are idle: events being written
+ * meanwhile may be missed.
+ */
+
+#define FLATSQL_TRACE_CONCAT_(a, b) a##b
+#define FLATSQL_TRACE_CONCAT(a, b) FLATSQL_TRACE_CONCAT_(a, b)
+
+#if FLATSQL_TRACING
+#define FLATSQL_TRACE_SCOPE(name) ::flatsql::TraceScope FLATSQL_TRACE_CONCAT(flatsqlTrace_, __LINE__)(name)
+#else
+#define FLATSQL_TRACE_SCOPE(name) do {} while (0)
+#endif
+
+namespace flatsql {
+
+// Whether FLATSQL_TRACE_SCOPE records anything in this build
+#if FLATSQL_TRACING
+constexpr bool TRACING_COMPILED_IN = true;
+#else
+constexpr bool TRACING_COMPILED_IN = false;
+#endif
+
+// Events kept per thread before the oldest are overwritten (a power of two)
+constexpr size_t TRACE_RING_EVENTS = 1 << 16;
+
+// Nanoseconds since the first traced event of the process
+uint64_t traceNow();
+
+// Append a complete event to the calling thread's ring
+void traceRecord(const char* name, uint64_t start, uint64_t duration);
+
+// Events in the rings (at most TRACE_RING_EVENTS per thread)
+size_t traceEventCount();
+
+// Drop the recorded events
+void traceClear();
+
+// {"traceEvents": [...]} with one "X" (complete) event per recorded
+// event, tid numbering threads in the order they first traced
+std::string traceExportChromeJson();
+
+#if FLATSQL_TRACING
+// Records its lifetime; see FLATSQL_TRACE_SCOPE
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), start_(traceNow()) {}
+    ~TraceScope() { traceRecord(name_, start_, traceNow() - start_); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+#endif
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_TRACE_H
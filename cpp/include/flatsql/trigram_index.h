@@ -0,0 +1,122 @@
+#ifndef FLATSQL_TRIGRAM_INDEX_H
+#define FLATSQL_TRIGRAM_INDEX_H
+
+#include "flatsql/types.h"
+#include "flatsql/index.h"
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace flatsql {
+
+// Key of a column's trigram index in a virtual table's index map (the
+// same index also serves the column's name, for equality and ranges)
+inline std::string trigramIndexKey(const std::string& column) {
+    return "_trgm_" + column;
+}
+
+/**
+ * Trigram postings over a string column (IDL attribute (trigram)), for
+ * WHERE fuzzy_within(column, 'target~k'): rows within Levenshtein
+ * distance k of target, with the edit-distance kernel run only on the
+ * rows the trigrams leave.
+ *
+ * Text is padded with two NUL bytes on each side, so n bytes give n + 2
+ * byte trigrams, and one edit changes at most three of them. A row within
+ * distance k of a target of n bytes therefore shares at least n + 2 - 3k
+ * trigrams (as multisets) with it and is at most k bytes longer or
+ * shorter; candidates() returns the rows passing both tests, a superset
+ * of the matches. When n + 2 - 3k <= 0 only the length test is left.
+ *
+ * Wraps the column's ordinary index, which answers every other lookup and
+ * supplies the keys to rebuild the postings from after eraseThrough() or
+ * loadFrom(): the text itself is not kept here.
+ */
+class TrigramIndex : public Index {
+public:
+    TrigramIndex(const std::string& tableName, const std::string& columnName, std::unique_ptr<Index> exact);
+
+    void insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) override;
+    void insertBatch(std::vector<IndexEntry>& entries) override;
+    void bulkLoad(const std::vector<IndexEntry>& sortedEntries) override;
+
+    // Exact lookups, from the wrapped index
+    std::vector<IndexEntry> search(const Value& key) const override;
+    bool searchFirst(const Value& key, IndexEntry& result) const override;
+    std::vector<IndexEntry> searchMany(std::vector<Value> keys) const override;
+    bool searchFirstString(const std::string& key, uint64_t& outOffset,
+                           uint32_t& outLength, uint64_t& outSequence) const override;
+    bool searchFirstInt64(int64_t key, uint64_t& outOffset,
+                          uint32_t& outLength, uint64_t& outSequence) const override;
+    std::vector<IndexEntry> range(const Value& minKey, const Value& maxKey) const override;
+    std::vector<IndexEntry> all() const override;
+    std::unique_ptr<IndexCursor> openRange(const Value& minKey, const Value& maxKey,
+                                           bool reverse) const override;
+    void clear() override;
+    void eraseThrough(uint64_t sequence) override;
+    void saveTo(sqlite3* db, const std::string& schemaName) const override;
+    void loadFrom(sqlite3* db, const std::string& schemaName) override;
+
+    // Rows that may be within maxDistance edits of target, in sequence
+    // order (keys left empty)
+    std::vector<IndexEntry> candidates(std::string_view target, uint32_t maxDistance) const;
+
+    // Upper bound on candidates(target, maxDistance).size() for the
+    // planner: a candidate holds one of the rarest trigrams it may miss
+    size_t estimateCandidates(std::string_view target, uint32_t maxDistance) const;
+
+    // Distinct trigrams, and the bytes held by the postings and rows
+    size_t getTrigramCount() const;
+    size_t memoryBytes() const override;
+    size_t pageBytes() const override { return exact_->pageBytes(); }
+
+    // Split 'target~k' into target and k; without a ~k suffix the
+    // distance is DEFAULT_DISTANCE
+    static constexpr uint32_t DEFAULT_DISTANCE = 2;
+    static void parsePattern(std::string_view pattern, std::string_view& target, uint32_t& maxDistance);
+
+    // Whether text is within the pattern's distance of its target
+    // (fuzzy_within() without an index)
+    static bool within(std::string_view text, std::string_view pattern);
+
+private:
+    struct Posting {
+        uint32_t row;
+        uint32_t occurrences;
+    };
+
+    struct Row {
+        uint64_t offset;
+        uint64_t sequence;
+        uint32_t length;
+        uint32_t textLength;
+    };
+
+    // Padded trigrams of text with their counts, ascending
+    static std::vector<std::pair<uint32_t, uint32_t>> trigrams(std::string_view text);
+
+    // Postings for one entry / all of the wrapped index's entries, without
+    // taking the lock
+    void addText(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence);
+    void rebuild();
+
+    std::unique_ptr<Index> exact_;
+    std::unordered_map<uint32_t, std::vector<Posting>> postings_;  // Ascending rows
+    std::vector<Row> rows_;                                        // By ordinal (insertion order)
+
+    mutable std::shared_mutex mutex_;
+};
+
+// fuzzy_within(text, 'target~k'), also installed by tables with a trigram
+// index through xFindFunction
+void fuzzyWithinFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv);
+
+// Register fuzzy_within() with a SQLite connection
+void registerTrigramFunctions(sqlite3* db);
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_TRIGRAM_INDEX_H
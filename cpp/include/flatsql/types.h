@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <optional>
@@ -62,6 +63,50 @@ inline ValueType getValueType(const Value& v) {
 // Compare two values (returns -1, 0, 1)
 int compareValues(const Value& a, const Value& b);
 
+// Bytes of a blob ValueView (not owned)
+struct BytesView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * A Value that does not own its string or bytes: the same alternatives in
+ * the same order (so ValueType indexes both), with strings and byte
+ * vectors pointing into the record or Value they were read from. Lets
+ * extraction and comparison run without allocating; it is valid only as
+ * long as what it points into, so convert with toValue() where a result
+ * needs to outlive the record.
+ */
+using ValueView = std::variant<
+    std::monostate,
+    bool,
+    int8_t,
+    int16_t,
+    int32_t,
+    int64_t,
+    uint8_t,
+    uint16_t,
+    uint32_t,
+    uint64_t,
+    float,
+    double,
+    std::string_view,
+    BytesView
+>;
+
+// View of value's contents (as long as value lives and is unchanged)
+ValueView viewOf(const Value& value);
+
+// Owning copy of a view
+Value toValue(const ValueView& view);
+
+// Set out to a copy of view, reusing the string or byte storage out
+// already holds (for buffers recycled across records)
+void assignValue(Value& out, const ValueView& view);
+
+// compareValues() for views, with the same order
+int compareValueViews(const ValueView& a, const ValueView& b);
+
 // Column definition
 struct ColumnDef {
     std::string name;
@@ -70,7 +115,11 @@ struct ColumnDef {
     bool indexed = false;
     bool primaryKey = false;
     bool encrypted = false;         // Field uses FlatBuffer field-level encryption
+    bool dictionary = false;        // Indexed through a string dictionary (DictionaryIndex)
+    bool fullText = false;          // Indexed by term for MATCH queries (FullTextIndex)
+    bool trigram = false;           // Also indexed by trigram for fuzzy_within() (TrigramIndex)
     uint16_t fieldId = 0;           // FlatBuffer field ID (for encryption key derivation)
+    bool layoutKnown = false;       // fieldId/type locate a scalar, string or byte vector field
     std::optional<Value> defaultValue;
 };
 
@@ -80,6 +129,12 @@ struct TableDef {
     std::vector<ColumnDef> columns;
     std::vector<std::string> primaryKeyColumns;
 
+    // Spatial index over a latitude/longitude column pair (IDL attribute
+    // (geo: "lonColumn") on the latitude column); empty when there is none.
+    // Such tables get a hidden _geo column for geo_within().
+    std::string geoLatColumn;
+    std::string geoLonColumn;
+
     int getColumnIndex(const std::string& name) const {
         for (size_t i = 0; i < columns.size(); i++) {
             if (columns[i].name == name) return static_cast<int>(i);
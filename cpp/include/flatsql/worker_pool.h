@@ -0,0 +1,68 @@
+#ifndef FLATSQL_WORKER_POOL_H
+#define FLATSQL_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Fixed set of worker threads for data-parallel loops.
+ *
+ * parallelFor() splits [0, count) into contiguous ranges and runs them on
+ * the workers and the calling thread, returning once every range is done.
+ * Ranges never overlap, so writing results by index keeps the output order
+ * independent of scheduling. One parallelFor() runs at a time.
+ *
+ * Builds without thread support (WASM without pthreads) run every loop on
+ * the calling thread.
+ */
+class WorkerPool {
+public:
+    // threads = total participants including the caller (0 = hardware concurrency)
+    explicit WorkerPool(size_t threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Number of threads that share a loop (workers + caller)
+    size_t size() const { return workers_.size() + 1; }
+
+    /**
+     * Run fn(begin, end) over [0, count) in ranges of at least minGrain.
+     * Small loops run inline. The first exception thrown by fn is rethrown
+     * here after all ranges have stopped.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn,
+                     size_t minGrain = 256);
+
+private:
+    void workerLoop();
+    void runRanges();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    bool stopping_ = false;
+
+    // Current loop (guarded by mutex_)
+    const std::function<void(size_t, size_t)>* fn_ = nullptr;
+    size_t count_ = 0;
+    size_t grain_ = 0;
+    size_t next_ = 0;
+    size_t active_ = 0;
+    uint64_t generation_ = 0;
+    std::exception_ptr error_;
+};
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_WORKER_POOL_H
@@ -0,0 +1,112 @@
+#ifndef FLATSQL_ZONE_MAP_H
+#define FLATSQL_ZONE_MAP_H
+
+#include "flatsql/column_cache.h"
+#include "flatsql/stable_vector.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace flatsql {
+
+/**
+ * Minimum and maximum of one numeric column per zone of ZONE_ROWS table
+ * rows (the order of TableStore::getRecordInfos()), so full scans skip
+ * zones no row of which can satisfy a range or equality predicate.
+ *
+ * Values are summarized in the storage type a ColumnCache would use for
+ * the column (int64 or double), and comparisons come from
+ * ColumnCache::makeComparison with the same semantics. Nulls and NaNs
+ * match no comparison and are left out of the bounds.
+ *
+ * Only complete zones are published, through a StableVector: one writer,
+ * lock-free readers. Rows of the zone still being filled always report a
+ * possible match.
+ */
+class ZoneMap {
+public:
+    static constexpr size_t ZONE_SHIFT = 12;
+    static constexpr size_t ZONE_ROWS = size_t(1) << ZONE_SHIFT;
+
+    explicit ZoneMap(ValueType type);
+
+    // Append the next row (writer only); non-numeric values count as null
+    void append(const Value& value);
+
+    // Rows appended so far (writer only; readers use zones())
+    size_t rows() const { return rows_; }
+
+    // Complete zones readers may consult
+    size_t zones() const { return zones_.size(); }
+
+    bool isReal() const { return real_; }
+
+    size_t memoryBytes() const { return sizeof(*this) + zones_.capacityBytes(); }
+
+    // Whether some row of zone may satisfy cmp (true past zones())
+    bool mayMatch(size_t zone, const ColumnCache::Comparison& cmp) const;
+
+private:
+    struct Zone {
+        bool any = false;  // Some row was non-null
+        int64_t intMin = 0;
+        int64_t intMax = 0;
+        double realMin = 0.0;
+        double realMax = 0.0;
+    };
+
+    bool real_;
+    size_t rows_ = 0;
+    Zone open_;                // Zone being filled (writer only)
+    StableVector<Zone> zones_;
+};
+
+// One slot per table column, nullptr where the column has no zone map
+using ZoneMapSlots = std::vector<std::unique_ptr<ZoneMap>>;
+
+/**
+ * Bloom filter of one string column per zone of ZoneMap::ZONE_ROWS rows,
+ * so an equality on a column without an index skips the zones that cannot
+ * hold the value. About BITS_PER_ROW bits per row and HASHES probes give
+ * roughly a 2% false-positive rate per zone.
+ *
+ * Publication follows ZoneMap: complete zones only, one writer and
+ * lock-free readers; the zone being filled always may contain the value.
+ */
+class ZoneBloomFilter {
+public:
+    static constexpr size_t BITS_PER_ROW = 8;
+    static constexpr int HASHES = 6;
+    static constexpr size_t ZONE_WORDS = ZoneMap::ZONE_ROWS * BITS_PER_ROW / 64;
+
+    // Hash of a value as the filter sees it, computed once per lookup
+    static uint64_t hash(const void* data, size_t length);
+
+    // Append the next row (writer only); null and non-string values are
+    // left out, since they never equal a string
+    void append(const Value& value);
+
+    // Rows appended so far (writer only; readers use zones())
+    size_t rows() const { return rows_; }
+
+    // Complete zones readers may consult
+    size_t zones() const { return words_.size() / ZONE_WORDS; }
+
+    size_t memoryBytes() const { return sizeof(*this) + words_.capacityBytes(); }
+
+    // Whether zone may hold a value with this hash (true past zones())
+    bool mayContain(size_t zone, uint64_t hash) const;
+
+private:
+    size_t rows_ = 0;
+    uint64_t open_[ZONE_WORDS] = {};  // Zone being filled (writer only)
+    StableVector<uint64_t> words_;    // ZONE_WORDS per complete zone
+};
+
+// One slot per table column, nullptr where the column has no Bloom filter
+using ZoneBloomSlots = std::vector<std::unique_ptr<ZoneBloomFilter>>;
+
+}  // namespace flatsql
+
+#endif  // FLATSQL_ZONE_MAP_H
@@ -0,0 +1,184 @@
+#include "flatsql/aggregate.h"
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace flatsql {
+
+std::string AggregateSpec::label() const {
+    const char* name = "COUNT";
+    switch (op) {
+        case Op::Count: name = "COUNT"; break;
+        case Op::Sum: name = "SUM"; break;
+        case Op::Min: name = "MIN"; break;
+        case Op::Max: name = "MAX"; break;
+        case Op::Avg: name = "AVG"; break;
+        case Op::ApproxCountDistinct: name = "APPROX_COUNT_DISTINCT"; break;
+        case Op::ApproxPercentile: {
+            std::ostringstream out;
+            out << "APPROX_PERCENTILE(" << column << ", " << fraction << ")";
+            return out.str();
+        }
+    }
+    return std::string(name) + "(" + (column.empty() ? "*" : column) + ")";
+}
+
+Value toSqlValue(const Value& value) {
+    return std::visit([&value](const auto& v) -> Value {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, float>) {
+            return static_cast<double>(v);
+        } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, int64_t>) {
+            return static_cast<int64_t>(v);
+        } else {
+            return value;
+        }
+    }, value);
+}
+
+AggregateState::AggregateState(const std::vector<AggregateSpec>* specs)
+    : specs_(specs), slots_(specs->size()) {}
+
+static void addInt(int64_t& sum, int64_t value) {
+    if (__builtin_add_overflow(sum, value, &sum)) {
+        throw std::runtime_error("integer overflow");
+    }
+}
+
+void AggregateState::add(const Value* values) {
+    for (size_t i = 0; i < slots_.size(); i++) {
+        const AggregateSpec& spec = (*specs_)[i];
+        Slot& slot = slots_[i];
+        if (spec.column.empty()) {
+            slot.count++;
+            continue;
+        }
+        const Value& value = values[i];
+        if (std::holds_alternative<std::monostate>(value)) continue;
+        slot.count++;
+
+        switch (spec.op) {
+            case AggregateSpec::Op::Count:
+                break;
+            case AggregateSpec::Op::Sum:
+            case AggregateSpec::Op::Avg:
+                std::visit([&slot](const auto& v) {
+                    using T = std::decay_t<decltype(v)>;
+                    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+                        slot.realSum += static_cast<double>(v);
+                        slot.real = true;
+                    } else if constexpr (std::is_integral_v<T>) {
+                        addInt(slot.intSum, static_cast<int64_t>(v));
+                    }
+                }, value);
+                break;
+            case AggregateSpec::Op::Min:
+                if (slot.count == 1 || compareValues(value, slot.min) < 0) slot.min = value;
+                break;
+            case AggregateSpec::Op::Max:
+                if (slot.count == 1 || compareValues(value, slot.max) > 0) slot.max = value;
+                break;
+            case AggregateSpec::Op::ApproxCountDistinct:
+                slot.distinct.add(value);
+                break;
+            case AggregateSpec::Op::ApproxPercentile:
+                std::visit([&slot](const auto& v) {
+                    using T = std::decay_t<decltype(v)>;
+                    if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+                        slot.digest.add(static_cast<double>(v));
+                    }
+                }, value);
+                break;
+        }
+    }
+}
+
+void AggregateState::merge(const AggregateState& other) {
+    for (size_t i = 0; i < slots_.size(); i++) {
+        Slot& slot = slots_[i];
+        const Slot& from = other.slots_[i];
+        if (from.count == 0) continue;
+        if (slot.count == 0) {
+            slot = from;
+            continue;
+        }
+        slot.count += from.count;
+        addInt(slot.intSum, from.intSum);
+        slot.realSum += from.realSum;
+        slot.real = slot.real || from.real;
+        if (compareValues(from.min, slot.min) < 0) slot.min = from.min;
+        if (compareValues(from.max, slot.max) > 0) slot.max = from.max;
+        slot.distinct.merge(from.distinct);
+        slot.digest.merge(from.digest);
+    }
+}
+
+Value AggregateState::result(size_t i) const {
+    const AggregateSpec& spec = (*specs_)[i];
+    const Slot& slot = slots_[i];
+    if (spec.op == AggregateSpec::Op::Count) {
+        return static_cast<int64_t>(slot.count);
+    }
+    if (spec.op == AggregateSpec::Op::ApproxCountDistinct) {
+        return static_cast<int64_t>(slot.distinct.estimate());
+    }
+    if (slot.count == 0) {
+        return std::monostate{};
+    }
+    switch (spec.op) {
+        case AggregateSpec::Op::Sum:
+            if (slot.real) return static_cast<double>(slot.intSum) + slot.realSum;
+            return slot.intSum;
+        case AggregateSpec::Op::Avg:
+            return (static_cast<double>(slot.intSum) + slot.realSum) / static_cast<double>(slot.count);
+        case AggregateSpec::Op::Min:
+            return toSqlValue(slot.min);
+        case AggregateSpec::Op::Max:
+            return toSqlValue(slot.max);
+        case AggregateSpec::Op::ApproxPercentile:
+            if (slot.digest.empty()) return std::monostate{};
+            return slot.digest.quantile(spec.fraction);
+        default:
+            return std::monostate{};
+    }
+}
+
+void mergeAggregateGroups(AggregateGroups& groups, AggregateGroups&& other) {
+    for (auto& [key, state] : other) {
+        auto it = groups.find(key);
+        if (it == groups.end()) {
+            groups.emplace(key, std::move(state));
+        } else {
+            it->second.merge(state);
+        }
+    }
+}
+
+QueryResult aggregateResult(AggregateGroups& groups, const std::vector<AggregateSpec>& aggregates,
+                            const std::string& groupBy) {
+    // Like SQL, an ungrouped aggregate of no rows is still one row
+    if (groupBy.empty() && groups.empty()) {
+        groups.emplace(Value(), AggregateState(&aggregates));
+    }
+
+    QueryResult result;
+    if (!groupBy.empty()) {
+        result.columns.push_back(groupBy);
+    }
+    for (const auto& spec : aggregates) {
+        result.columns.push_back(spec.label());
+    }
+    for (const auto& [key, state] : groups) {
+        std::vector<Value> row;
+        if (!groupBy.empty()) {
+            row.push_back(toSqlValue(key));
+        }
+        for (size_t i = 0; i < aggregates.size(); i++) {
+            row.push_back(state.result(i));
+        }
+        result.rows.push_back(std::move(row));
+    }
+    return result;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,92 @@
+#include "flatsql/arena_result.h"
+#include <algorithm>
+#include <cstring>
+
+namespace flatsql {
+
+void ArenaQueryResult::clear() {
+    columns.clear();
+    cells_.clear();
+    rows_ = 0;
+    if (blocks_.size() > 1) {
+        auto largest = std::max_element(blocks_.begin(), blocks_.end(),
+                                        [](const Block& a, const Block& b) { return a.size < b.size; });
+        Block kept = std::move(*largest);
+        blocks_.clear();
+        blocks_.push_back(std::move(kept));
+    }
+    used_ = 0;
+}
+
+ValueView* ArenaQueryResult::addRow() {
+    rows_++;
+    cells_.resize(cells_.size() + columns.size());
+    return cells_.data() + cells_.size() - columns.size();
+}
+
+uint8_t* ArenaQueryResult::allocate(size_t length) {
+    if (blocks_.empty() || blocks_.back().size - used_ < length) {
+        // Blocks double up to MAX_BLOCK; a larger value gets its own
+        size_t size = blocks_.empty() ? FIRST_BLOCK : std::min(blocks_.back().size * 2, MAX_BLOCK);
+        size = std::max(size, length);
+        blocks_.push_back({std::make_unique<uint8_t[]>(size), size});
+        used_ = 0;
+    }
+    uint8_t* p = blocks_.back().data.get() + used_;
+    used_ += length;
+    return p;
+}
+
+std::string_view ArenaQueryResult::copyText(const char* text, size_t length) {
+    if (length == 0) return std::string_view("", 0);
+    uint8_t* p = allocate(length);
+    std::memcpy(p, text, length);
+    return std::string_view(reinterpret_cast<const char*>(p), length);
+}
+
+BytesView ArenaQueryResult::copyBytes(const uint8_t* data, size_t length) {
+    if (length == 0) return BytesView();
+    uint8_t* p = allocate(length);
+    std::memcpy(p, data, length);
+    return BytesView{p, length};
+}
+
+ValueView ArenaQueryResult::copyValue(const Value& value) {
+    if (const auto* s = std::get_if<std::string>(&value)) return copyText(s->data(), s->size());
+    if (const auto* b = std::get_if<std::vector<uint8_t>>(&value)) return copyBytes(b->data(), b->size());
+    return viewOf(value);
+}
+
+void ArenaQueryResult::assign(const QueryResult& result) {
+    clear();
+    columns = result.columns;
+    cells_.reserve(result.rows.size() * columns.size());
+    for (const auto& row : result.rows) {
+        ValueView* cells = addRow();
+        for (size_t i = 0; i < columns.size() && i < row.size(); i++) {
+            cells[i] = copyValue(row[i]);
+        }
+    }
+}
+
+QueryResult ArenaQueryResult::toQueryResult() const {
+    QueryResult result;
+    result.columns = columns;
+    result.rows.reserve(rows_);
+    for (size_t r = 0; r < rows_; r++) {
+        Row row = (*this)[r];
+        result.rows.emplace_back(row.size());
+        for (size_t c = 0; c < row.size(); c++) {
+            result.rows.back()[c] = toValue(row[c]);
+        }
+    }
+    return result;
+}
+
+size_t ArenaQueryResult::arenaBytes() const {
+    size_t bytes = 0;
+    for (const auto& block : blocks_) bytes += block.size;
+    return bytes;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,126 @@
+#include "flatsql/block_codec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace flatsql {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;   // Format rule: the block ends in literals
+constexpr size_t MATCH_LIMIT = 12;    // No match may start in the last 12 bytes
+constexpr size_t MAX_DISTANCE = 65535;
+constexpr int HASH_BITS = 16;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hashOf(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Length beyond a token nibble: 255s then the remainder
+void putLength(std::vector<uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void putSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength,
+                 size_t distance, size_t matchLength) {
+    size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+    out.push_back(static_cast<uint8_t>((std::min<size_t>(literalLength, 15) << 4) |
+                                       std::min<size_t>(matchCode, 15)));
+    if (literalLength >= 15) putLength(out, literalLength - 15);
+    out.insert(out.end(), literals, literals + literalLength);
+    if (!matchLength) return;
+    out.push_back(static_cast<uint8_t>(distance));
+    out.push_back(static_cast<uint8_t>(distance >> 8));
+    if (matchCode >= 15) putLength(out, matchCode - 15);
+}
+
+}  // namespace
+
+void compressBlock(const uint8_t* src, size_t length, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(length / 2 + 16);
+
+    size_t anchor = 0;
+    if (length > MATCH_LIMIT) {
+        // Last position seen for each hashed 4-byte sequence, plus one
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        const size_t matchEnd = length - LAST_LITERALS;
+        size_t pos = 0;
+        while (pos + MATCH_LIMIT < length) {
+            uint32_t sequence = read32(src + pos);
+            uint32_t& slot = table[hashOf(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+            if (candidate == 0 || pos + 1 - candidate > MAX_DISTANCE ||
+                read32(src + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+
+            size_t ref = candidate - 1;
+            size_t matchLength = MIN_MATCH;
+            while (pos + matchLength < matchEnd && src[ref + matchLength] == src[pos + matchLength]) {
+                matchLength++;
+            }
+            putSequence(out, src + anchor, pos - anchor, pos - ref, matchLength);
+            pos += matchLength;
+            anchor = pos;
+        }
+    }
+    putSequence(out, src + anchor, length - anchor, 0, 0);
+}
+
+bool decompressBlock(const uint8_t* src, size_t length, uint8_t* dst, size_t rawLength) {
+    size_t in = 0;
+    size_t out = 0;
+
+    auto readLength = [&](size_t& value) {
+        uint8_t byte;
+        do {
+            if (in >= length) return false;
+            byte = src[in++];
+            value += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < length) {
+        uint8_t token = src[in++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength)) return false;
+        if (literalLength > length - in || literalLength > rawLength - out) return false;
+        // An empty block may come with a null dst, and memcpy(nullptr, ..., 0) is undefined
+        if (literalLength) std::memcpy(dst + out, src + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == length) break;  // Last sequence: literals only
+
+        if (length - in < 2) return false;
+        size_t distance = src[in] | (static_cast<size_t>(src[in + 1]) << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength)) return false;
+        matchLength += MIN_MATCH;
+        if (distance == 0 || distance > out || matchLength > rawLength - out) return false;
+
+        // Byte by byte: the source may overlap what is being written
+        const uint8_t* from = dst + out - distance;
+        for (size_t i = 0; i < matchLength; i++) {
+            dst[out + i] = from[i];
+        }
+        out += matchLength;
+    }
+    return out == rawLength;
+}
+
+}  // namespace flatsql
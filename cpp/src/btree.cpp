@@ -1,429 +1,941 @@
 #include "flatsql/btree.h"
-#include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 
 namespace flatsql {
 
-// Helper to convert Value to int64 for comparison (optimized with get_if)
-// Order by frequency: int32_t most common in FlatBuffers, then int64_t
-static bool tryGetInt64(const Value& v, int64_t& out) {
-    // Fast path for common types using get_if (faster than visit)
-    if (auto* p = std::get_if<int32_t>(&v)) { out = *p; return true; }  // Most common
-    if (auto* p = std::get_if<int64_t>(&v)) { out = *p; return true; }
-    if (auto* p = std::get_if<uint32_t>(&v)) { out = *p; return true; }
-    if (auto* p = std::get_if<uint64_t>(&v)) { out = static_cast<int64_t>(*p); return true; }
-    if (auto* p = std::get_if<int16_t>(&v)) { out = *p; return true; }
-    if (auto* p = std::get_if<uint16_t>(&v)) { out = *p; return true; }
-    if (auto* p = std::get_if<int8_t>(&v)) { out = *p; return true; }
-    if (auto* p = std::get_if<uint8_t>(&v)) { out = *p; return true; }
-    return false;
+static constexpr uint64_t SIGN_BIT = 1ull << 63;
+
+// Order-preserving 64-bit encodings: unsigned comparison of the encoded
+// words matches signed / IEEE ordering of the source values
+static inline uint64_t encodeInt(int64_t v) {
+    return static_cast<uint64_t>(v) ^ SIGN_BIT;
 }
 
-// Helper to convert Value to double for comparison
-static bool tryGetDouble(const Value& v, double& out) {
-    return std::visit([&out](const auto& val) -> bool {
+static inline int64_t decodeInt(uint64_t p) {
+    return static_cast<int64_t>(p ^ SIGN_BIT);
+}
+
+static inline uint64_t encodeReal(double d) {
+    if (d == 0.0) d = 0.0;  // Fold -0.0 onto 0.0
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return (bits & SIGN_BIT) ? ~bits : bits | SIGN_BIT;
+}
+
+static inline double decodeReal(uint64_t p) {
+    uint64_t bits = (p & SIGN_BIT) ? p & ~SIGN_BIT : ~p;
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// First 8 bytes big-endian, zero padded
+static inline uint64_t encodePrefix(const uint8_t* data, size_t length) {
+    uint64_t p = 0;
+    for (size_t i = 0; i < 8; i++) {
+        p = (p << 8) | (i < length ? data[i] : 0);
+    }
+    return p;
+}
+
+// Numeric view of a key: 1 = integer (out in i), 2 = real (out in d), 0 = neither
+static int numericKey(const Value& v, int64_t& i, double& d) {
+    return std::visit([&i, &d](const auto& val) -> int {
         using T = std::decay_t<decltype(val)>;
-        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
-            out = static_cast<double>(val);
-            return true;
+        if constexpr (std::is_same_v<T, bool>) {
+            i = val ? 1 : 0;
+            return 1;
         } else if constexpr (std::is_same_v<T, int8_t> || std::is_same_v<T, int16_t> ||
-                            std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t> ||
-                            std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
-                            std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>) {
-            out = static_cast<double>(val);
-            return true;
+                             std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t> ||
+                             std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
+                             std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>) {
+            // uint64 wraps into int64 the same way SqliteIndex binds it
+            i = static_cast<int64_t>(val);
+            return 1;
+        } else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            d = static_cast<double>(val);
+            return 2;
         }
-        return false;
+        return 0;
     }, v);
 }
 
-// Compare two Values with numeric type coercion
-int compareValues(const Value& a, const Value& b) {
-    // Handle null comparisons
-    if (std::holds_alternative<std::monostate>(a)) {
-        return std::holds_alternative<std::monostate>(b) ? 0 : -1;
-    }
-    if (std::holds_alternative<std::monostate>(b)) {
-        return 1;
+BTreeIndex::BTreeIndex(const std::string& tableName, const std::string& columnName, ValueType keyType)
+    : Index(tableName, columnName, keyType) {
+    switch (keyType) {
+        case ValueType::Bool:
+        case ValueType::Int8:
+        case ValueType::Int16:
+        case ValueType::Int32:
+        case ValueType::Int64:
+        case ValueType::UInt8:
+        case ValueType::UInt16:
+        case ValueType::UInt32:
+        case ValueType::UInt64:
+            domain_ = KeyDomain::Integer;
+            break;
+        case ValueType::Float32:
+        case ValueType::Float64:
+            domain_ = KeyDomain::Real;
+            break;
+        case ValueType::String:
+            domain_ = KeyDomain::Text;
+            break;
+        default:
+            domain_ = KeyDomain::Blob;
+            break;
     }
+}
 
-    // Try integer comparison first (handles int32 vs int64 etc.)
-    int64_t aInt, bInt;
-    if (tryGetInt64(a, aInt) && tryGetInt64(b, bInt)) {
-        if (aInt < bInt) return -1;
-        if (aInt > bInt) return 1;
-        return 0;
-    }
+bool BTreeIndex::makeProbe(const Value& value, ProbeMode mode, Probe& out) const {
+    out.bytes = nullptr;
+    out.length = 0;
 
-    // Try floating point comparison
-    double aDouble, bDouble;
-    if (tryGetDouble(a, aDouble) && tryGetDouble(b, bDouble)) {
-        if (aDouble < bDouble) return -1;
-        if (aDouble > bDouble) return 1;
-        return 0;
+    if (domain_ == KeyDomain::Text) {
+        const std::string* s = std::get_if<std::string>(&value);
+        if (!s) return false;
+        out.bytes = reinterpret_cast<const uint8_t*>(s->data());
+        out.length = static_cast<uint32_t>(s->size());
+        out.prefix = encodePrefix(out.bytes, out.length);
+        return true;
+    }
+    if (domain_ == KeyDomain::Blob) {
+        const std::vector<uint8_t>* b = std::get_if<std::vector<uint8_t>>(&value);
+        if (!b) return false;
+        out.bytes = b->data();
+        out.length = static_cast<uint32_t>(b->size());
+        out.prefix = encodePrefix(out.bytes, out.length);
+        return true;
     }
 
-    // String comparison
-    if (std::holds_alternative<std::string>(a) && std::holds_alternative<std::string>(b)) {
-        return std::get<std::string>(a).compare(std::get<std::string>(b));
+    int64_t i = 0;
+    double d = 0.0;
+    int kind = numericKey(value, i, d);
+    if (kind == 0) return false;
+    if (kind == 2 && std::isnan(d)) return false;
+
+    if (domain_ == KeyDomain::Real) {
+        out.prefix = encodeReal(kind == 1 ? static_cast<double>(i) : d);
+        return true;
     }
 
-    // Blob comparison
-    if (std::holds_alternative<std::vector<uint8_t>>(a) && std::holds_alternative<std::vector<uint8_t>>(b)) {
-        const auto& aVec = std::get<std::vector<uint8_t>>(a);
-        const auto& bVec = std::get<std::vector<uint8_t>>(b);
-        size_t minLen = std::min(aVec.size(), bVec.size());
-        for (size_t i = 0; i < minLen; i++) {
-            if (aVec[i] < bVec[i]) return -1;
-            if (aVec[i] > bVec[i]) return 1;
+    if (kind == 2) {
+        // Real key against integer column: exact needs an integral value,
+        // range bounds round inward and clamp to the int64 domain
+        double r = mode == ProbeMode::Lower ? std::ceil(d) : std::floor(d);
+        if (r != d && mode == ProbeMode::Exact) return false;
+        if (r >= 9223372036854775808.0) {
+            if (mode != ProbeMode::Upper) return false;
+            i = std::numeric_limits<int64_t>::max();
+        } else if (r < -9223372036854775808.0) {
+            if (mode != ProbeMode::Lower) return false;
+            i = std::numeric_limits<int64_t>::min();
+        } else {
+            i = static_cast<int64_t>(r);
         }
-        if (aVec.size() < bVec.size()) return -1;
-        if (aVec.size() > bVec.size()) return 1;
-        return 0;
     }
+    out.prefix = encodeInt(i);
+    return true;
+}
 
-    // Bool comparison
-    if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b)) {
-        bool aVal = std::get<bool>(a);
-        bool bVal = std::get<bool>(b);
-        return aVal == bVal ? 0 : (aVal < bVal ? -1 : 1);
-    }
+int BTreeIndex::compareProbe(const Probe& a, const Probe& b) const {
+    if (a.prefix != b.prefix) return a.prefix < b.prefix ? -1 : 1;
+    if (domain_ == KeyDomain::Integer || domain_ == KeyDomain::Real) return 0;
 
-    // Different incompatible types - compare by type index
-    return a.index() < b.index() ? -1 : 1;
+    // Equal prefixes cover the first 8 bytes; compare the rest, then length
+    uint32_t common = std::min(a.length, b.length);
+    if (common > 8) {
+        int cmp = std::memcmp(a.bytes + 8, b.bytes + 8, common - 8);
+        if (cmp != 0) return cmp < 0 ? -1 : 1;
+    }
+    if (a.length != b.length) return a.length < b.length ? -1 : 1;
+    return 0;
 }
 
-BTree::BTree(ValueType keyType, int order)
-    : keyType_(keyType), order_(order) {
-    // Create initial empty root (leaf)
-    rootId_ = createNode(true, 0);
+int BTreeIndex::compareEntry(const Probe& a, uint64_t aSeq, const Key& b, uint64_t bSeq) const {
+    int cmp = compareProbe(a, probeOf(b));
+    if (cmp != 0) return cmp;
+    if (aSeq != bSeq) return aSeq < bSeq ? -1 : 1;
+    return 0;
 }
 
-uint64_t BTree::createNode(bool isLeaf, uint64_t parentId) {
-    uint64_t nodeId = nextNodeId_++;
-    BTreeNode node;
-    node.nodeId = nodeId;
-    node.isLeaf = isLeaf;
-    node.parentId = parentId;
-    nodes_[nodeId] = std::move(node);
-    return nodeId;
-}
+bool BTreeIndex::storeKey(const Value& value, Key& out) {
+    Probe probe;
+    if (!makeProbe(value, ProbeMode::Exact, probe)) return false;
 
-BTree::BTreeNode& BTree::getNode(uint64_t nodeId) {
-    auto it = nodes_.find(nodeId);
-    if (it == nodes_.end()) {
-        throw std::runtime_error("Node not found: " + std::to_string(nodeId));
+    out.prefix = probe.prefix;
+    out.arenaOffset = 0;
+    out.length = probe.length;
+    if (probe.length > 0) {
+        if (arena_.size() + probe.length > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("BTreeIndex key arena exceeds 4GB");
+        }
+        out.arenaOffset = static_cast<uint32_t>(arena_.size());
+        arena_.insert(arena_.end(), probe.bytes, probe.bytes + probe.length);
     }
-    return it->second;
+    return true;
 }
 
-const BTree::BTreeNode& BTree::getNode(uint64_t nodeId) const {
-    auto it = nodes_.find(nodeId);
-    if (it == nodes_.end()) {
-        throw std::runtime_error("Node not found: " + std::to_string(nodeId));
+uint32_t BTreeIndex::leftmostLeaf() const {
+    if (root_ == NONE) return NONE;
+    uint32_t node = root_;
+    for (int level = height_; level > 0; --level) {
+        node = inners_[node].children[0];
     }
-    return it->second;
+    return node;
 }
 
-void BTree::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
-    IndexEntry entry;
-    entry.key = key;
-    entry.dataOffset = dataOffset;
-    entry.dataLength = dataLength;
-    entry.sequence = sequence;
-
-    BTreeNode& root = getNode(rootId_);
-
-    // If root is full, split it first
-    if (static_cast<int>(root.entries.size()) >= order_ - 1) {
-        // Create new root
-        uint64_t newRootId = createNode(false, 0);
-        BTreeNode& newRoot = getNode(newRootId);
-        newRoot.children.push_back(rootId_);
-
-        // Update old root's parent
-        getNode(rootId_).parentId = newRootId;
-
-        // Split the old root
-        splitChild(newRootId, 0);
+void BTreeIndex::lowerBound(const Probe& probe, uint32_t& leaf, uint32_t& pos) const {
+    leaf = NONE;
+    pos = 0;
+    if (root_ == NONE) return;
+
+    // Route by key only: equal keys may sit left of a separator with the same key
+    uint32_t node = root_;
+    for (int level = height_; level > 0; --level) {
+        const InnerNode& inner = inners_[node];
+        uint32_t lo = 0, hi = inner.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (compareProbe(probeOf(inner.keys[mid]), probe) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        node = inner.children[lo];
+    }
 
-        rootId_ = newRootId;
+    const LeafNode& l = leaves_[node];
+    uint32_t lo = 0, hi = l.count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (compareProbe(probeOf(l.keys[mid]), probe) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    insertNonFull(rootId_, entry);
-    entryCount_++;
+    if (lo < l.count) {
+        leaf = node;
+        pos = lo;
+    } else {
+        // Everything here is smaller; the next leaf starts at a separator >= probe
+        leaf = l.next;
+    }
 }
 
-void BTree::insertNonFull(uint64_t nodeId, const IndexEntry& entry) {
-    BTreeNode& node = getNode(nodeId);
-
-    if (node.isLeaf) {
-        // Find position to insert
-        int i = static_cast<int>(node.entries.size()) - 1;
-        while (i >= 0 && compareValues(entry.key, node.entries[i].key) < 0) {
-            i--;
-        }
-        // Insert at position i + 1
-        node.entries.insert(node.entries.begin() + i + 1, entry);
-    } else {
-        // Find child to descend into
-        int i = static_cast<int>(node.entries.size()) - 1;
-        while (i >= 0 && compareValues(entry.key, node.entries[i].key) < 0) {
-            i--;
-        }
-        i++;
-
-        uint64_t childId = node.children[i];
-        BTreeNode& child = getNode(childId);
-
-        // If child is full, split it
-        if (static_cast<int>(child.entries.size()) >= order_ - 1) {
-            splitChild(nodeId, i);
-            // After split, determine which child to use
-            // Need to re-fetch node as it may have been reallocated
-            BTreeNode& nodeAfterSplit = getNode(nodeId);
-            if (compareValues(entry.key, nodeAfterSplit.entries[i].key) > 0) {
-                i++;
+void BTreeIndex::upperBound(const Probe& probe, uint64_t sequence, uint32_t& leaf, uint32_t& pos) const {
+    leaf = NONE;
+    pos = 0;
+    if (root_ == NONE) return;
+
+    uint32_t node = root_;
+    for (int level = height_; level > 0; --level) {
+        const InnerNode& inner = inners_[node];
+        uint32_t lo = 0, hi = inner.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (compareEntry(probe, sequence, inner.keys[mid], inner.sequences[mid]) >= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
             }
-            insertNonFull(nodeAfterSplit.children[i], entry);
-        } else {
-            insertNonFull(childId, entry);
         }
+        node = inner.children[lo];
     }
-}
 
-void BTree::splitChild(uint64_t parentId, int childIndex) {
-    BTreeNode& parent = getNode(parentId);
-    uint64_t childId = parent.children[childIndex];
-    BTreeNode& child = getNode(childId);
-
-    int mid = (order_ - 1) / 2;
-
-    // Create new sibling node
-    uint64_t siblingId = createNode(child.isLeaf, parentId);
-    BTreeNode& sibling = getNode(siblingId);
-
-    // Move second half of entries to sibling
-    for (size_t i = mid + 1; i < child.entries.size(); i++) {
-        sibling.entries.push_back(std::move(child.entries[i]));
+    const LeafNode& l = leaves_[node];
+    uint32_t lo = 0, hi = l.count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (compareEntry(probe, sequence, l.keys[mid], l.sequences[mid]) >= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    IndexEntry midEntry = std::move(child.entries[mid]);
-    child.entries.resize(mid);
+    if (lo < l.count) {
+        leaf = node;
+        pos = lo;
+    } else {
+        leaf = l.next;
+    }
+}
 
-    // If not leaf, move children too
-    if (!child.isLeaf) {
-        for (size_t i = mid + 1; i < child.children.size(); i++) {
-            sibling.children.push_back(child.children[i]);
-            // Update parent references for moved children
-            getNode(child.children[i]).parentId = siblingId;
+void BTreeIndex::lastBefore(const Probe& probe, const uint64_t* sequence,
+                            uint32_t& leaf, uint32_t& pos) const {
+    leaf = NONE;
+    pos = 0;
+    if (root_ == NONE) return;
+
+    auto before = [&](const Key& key, uint64_t keySequence) {
+        return sequence ? compareEntry(probe, *sequence, key, keySequence) > 0
+                        : compareProbe(probeOf(key), probe) <= 0;
+    };
+
+    // A separator is the first entry of the subtree on its right, so the
+    // leaf reached holds the last entry before the probe unless it is the
+    // leftmost leaf and everything sorts after it
+    uint32_t node = root_;
+    for (int level = height_; level > 0; --level) {
+        const InnerNode& inner = inners_[node];
+        uint32_t lo = 0, hi = inner.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (before(inner.keys[mid], inner.sequences[mid])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
         }
-        child.children.resize(mid + 1);
+        node = inner.children[lo];
     }
 
-    // Insert mid entry and sibling into parent
-    // Need to re-fetch parent as map may have reallocated
-    BTreeNode& parentNode = getNode(parentId);
-    parentNode.entries.insert(parentNode.entries.begin() + childIndex, std::move(midEntry));
-    parentNode.children.insert(parentNode.children.begin() + childIndex + 1, siblingId);
+    const LeafNode& l = leaves_[node];
+    uint32_t lo = 0, hi = l.count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (before(l.keys[mid], l.sequences[mid])) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0) {
+        leaf = node;
+        pos = lo - 1;
+    }
 }
 
-std::vector<IndexEntry> BTree::search(const Value& key) const {
-    std::vector<IndexEntry> results;
-    searchNode(rootId_, key, results);
-    return results;
+void BTreeIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    insertKey(key, dataOffset, dataLength, sequence);
 }
 
-bool BTree::searchFirst(const Value& key, IndexEntry& result) const {
-    return searchNodeFirst(rootId_, key, result);
+void BTreeIndex::insertKey(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    Key stored;
+    if (!storeKey(key, stored)) {
+        throw std::runtime_error(std::holds_alternative<std::monostate>(key)
+            ? "Failed to insert index entry: NULL key"
+            : "Failed to insert index entry: key type does not match " + name_);
+    }
+    insertStored(stored, dataOffset, dataLength, sequence);
+    stats_.add(key);
 }
 
-void BTree::searchNode(uint64_t nodeId, const Value& key, std::vector<IndexEntry>& results) const {
-    const BTreeNode& node = getNode(nodeId);
+void BTreeIndex::insertStored(const Key& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    if (root_ == NONE) {
+        leaves_.emplace_back();
+        root_ = 0;
+        height_ = 0;
+    }
 
-    size_t i = 0;
-    while (i < node.entries.size() && compareValues(key, node.entries[i].key) > 0) {
-        i++;
+    Probe probe = probeOf(key);
+
+    // Descend to the leaf, remembering the path for splits
+    uint32_t pathNodes[64];
+    uint32_t pathSlots[64];
+    int depth = 0;
+    uint32_t node = root_;
+    for (int level = height_; level > 0; --level) {
+        const InnerNode& inner = inners_[node];
+        uint32_t lo = 0, hi = inner.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (compareEntry(probe, sequence, inner.keys[mid], inner.sequences[mid]) >= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        pathNodes[depth] = node;
+        pathSlots[depth] = lo;
+        depth++;
+        node = inner.children[lo];
     }
 
-    // Collect all matching entries (handles duplicates)
-    while (i < node.entries.size() && compareValues(key, node.entries[i].key) == 0) {
-        results.push_back(node.entries[i]);
-        i++;
+    uint32_t pos;
+    {
+        const LeafNode& l = leaves_[node];
+        uint32_t lo = 0, hi = l.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (compareEntry(probe, sequence, l.keys[mid], l.sequences[mid]) >= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        pos = lo;
     }
 
-    if (!node.isLeaf) {
-        // Search appropriate child
-        size_t childIdx = 0;
-        while (childIdx < node.entries.size() && compareValues(key, node.entries[childIdx].key) > 0) {
-            childIdx++;
+
+    auto placeInLeaf = [&](LeafNode& l, uint32_t at) {
+        for (uint32_t i = l.count; i > at; --i) {
+            l.keys[i] = l.keys[i - 1];
+            l.sequences[i] = l.sequences[i - 1];
+            l.offsets[i] = l.offsets[i - 1];
+            l.lengths[i] = l.lengths[i - 1];
         }
-        searchNode(node.children[childIdx], key, results);
+        l.keys[at] = key;
+        l.sequences[at] = sequence;
+        l.offsets[at] = dataOffset;
+        l.lengths[at] = dataLength;
+        l.count++;
+    };
+
+    if (leaves_[node].count < FANOUT) {
+        placeInLeaf(leaves_[node], pos);
+        return;
     }
-}
 
-// Fast path for integer key search - avoids repeated variant checks
-bool BTree::searchNodeFirstInt(uint64_t nodeId, int64_t keyInt, IndexEntry& result) const {
-    const BTreeNode& node = getNode(nodeId);
+    // Split the leaf. Appends (the common ingest order) start a fresh right
+    // leaf so sequentially built trees stay fully packed.
+    uint32_t rightIdx = static_cast<uint32_t>(leaves_.size());
+    leaves_.emplace_back();
+    LeafNode& left = leaves_[node];
+    LeafNode& right = leaves_[rightIdx];
+
+    uint32_t keep = (pos == FANOUT) ? FANOUT : FANOUT / 2;
+    right.count = FANOUT - keep;
+    for (uint32_t i = 0; i < right.count; i++) {
+        right.keys[i] = left.keys[keep + i];
+        right.sequences[i] = left.sequences[keep + i];
+        right.offsets[i] = left.offsets[keep + i];
+        right.lengths[i] = left.lengths[keep + i];
+    }
+    left.count = keep;
+    right.next = left.next;
+    left.next = rightIdx;
 
-    // Binary search for the key position - assume all entries are integers
-    size_t lo = 0, hi = node.entries.size();
-    while (lo < hi) {
-        size_t mid = lo + (hi - lo) / 2;
-        // Direct integer extraction - we know entries are int32 for id columns
-        int64_t entryInt;
-        if (auto* p = std::get_if<int32_t>(&node.entries[mid].key)) {
-            entryInt = *p;
-        } else if (auto* p = std::get_if<int64_t>(&node.entries[mid].key)) {
-            entryInt = *p;
-        } else {
-            // Fallback - shouldn't happen for int index
-            tryGetInt64(node.entries[mid].key, entryInt);
+    if (pos <= keep && pos < FANOUT) {
+        placeInLeaf(left, pos);
+    } else {
+        placeInLeaf(right, pos - keep);
+    }
+
+    // Push the separator up, splitting inner nodes as needed
+    Key sepKey = right.keys[0];
+    uint64_t sepSeq = right.sequences[0];
+    uint32_t newChild = rightIdx;
+
+    while (depth > 0) {
+        depth--;
+        uint32_t innerIdx = pathNodes[depth];
+        uint32_t slot = pathSlots[depth];
+
+        if (inners_[innerIdx].count < FANOUT) {
+            InnerNode& inner = inners_[innerIdx];
+            for (uint32_t i = inner.count; i > slot; --i) {
+                inner.keys[i] = inner.keys[i - 1];
+                inner.sequences[i] = inner.sequences[i - 1];
+                inner.children[i + 1] = inner.children[i];
+            }
+            inner.keys[slot] = sepKey;
+            inner.sequences[slot] = sepSeq;
+            inner.children[slot + 1] = newChild;
+            inner.count++;
+            return;
         }
-        if (keyInt <= entryInt) {
-            hi = mid;
-        } else {
-            lo = mid + 1;
+
+        // Gather FANOUT + 1 separators, then split around a promoted one
+        Key keys[FANOUT + 1];
+        uint64_t seqs[FANOUT + 1];
+        uint32_t children[FANOUT + 2];
+        {
+            const InnerNode& inner = inners_[innerIdx];
+            for (uint32_t i = 0, j = 0; i <= FANOUT; i++) {
+                if (i == slot) {
+                    keys[i] = sepKey;
+                    seqs[i] = sepSeq;
+                } else {
+                    keys[i] = inner.keys[j];
+                    seqs[i] = inner.sequences[j];
+                    j++;
+                }
+            }
+            for (uint32_t i = 0, j = 0; i <= FANOUT + 1; i++) {
+                if (i == slot + 1) {
+                    children[i] = newChild;
+                } else {
+                    children[i] = inner.children[j++];
+                }
+            }
         }
-    }
 
-    // Check for match at found position
-    if (lo < node.entries.size()) {
-        int64_t entryInt;
-        if (auto* p = std::get_if<int32_t>(&node.entries[lo].key)) {
-            entryInt = *p;
-        } else if (auto* p = std::get_if<int64_t>(&node.entries[lo].key)) {
-            entryInt = *p;
-        } else {
-            tryGetInt64(node.entries[lo].key, entryInt);
+        uint32_t mid = (slot == FANOUT) ? FANOUT : FANOUT / 2;
+        uint32_t rightInnerIdx = static_cast<uint32_t>(inners_.size());
+        inners_.emplace_back();
+        InnerNode& leftInner = inners_[innerIdx];
+        InnerNode& rightInner = inners_[rightInnerIdx];
+
+        leftInner.count = mid;
+        for (uint32_t i = 0; i < mid; i++) {
+            leftInner.keys[i] = keys[i];
+            leftInner.sequences[i] = seqs[i];
+            leftInner.children[i] = children[i];
         }
-        if (keyInt == entryInt) {
-            result = node.entries[lo];
-            return true;
+        leftInner.children[mid] = children[mid];
+
+        rightInner.count = FANOUT - mid;
+        for (uint32_t i = 0; i < rightInner.count; i++) {
+            rightInner.keys[i] = keys[mid + 1 + i];
+            rightInner.sequences[i] = seqs[mid + 1 + i];
+            rightInner.children[i] = children[mid + 1 + i];
         }
-    }
+        rightInner.children[rightInner.count] = children[FANOUT + 1];
 
-    // If not a leaf, search appropriate child
-    if (!node.isLeaf && lo < node.children.size()) {
-        return searchNodeFirstInt(node.children[lo], keyInt, result);
+        sepKey = keys[mid];
+        sepSeq = seqs[mid];
+        newChild = rightInnerIdx;
     }
 
-    return false;
+    // Root split: grow a level
+    uint32_t newRoot = static_cast<uint32_t>(inners_.size());
+    inners_.emplace_back();
+    InnerNode& rootNode = inners_[newRoot];
+    rootNode.count = 1;
+    rootNode.keys[0] = sepKey;
+    rootNode.sequences[0] = sepSeq;
+    rootNode.children[0] = root_;
+    rootNode.children[1] = newChild;
+    root_ = newRoot;
+    height_++;
 }
 
-bool BTree::searchNodeFirst(uint64_t nodeId, const Value& key, IndexEntry& result) const {
-    // Fast path for integer keys
-    int64_t keyInt;
-    if (tryGetInt64(key, keyInt)) {
-        return searchNodeFirstInt(nodeId, keyInt, result);
+void BTreeIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    if (sortedEntries.empty()) return;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto insertEach = [this, &sortedEntries]() {
+        for (const auto& entry : sortedEntries) {
+            insertKey(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+        }
+    };
+
+    if (root_ != NONE) {
+        insertEach();
+        return;
     }
 
-    const BTreeNode& node = getNode(nodeId);
+    // Encode every key up front; bail out to insertKey() (which reports the
+    // offending key) on a bad key or out-of-order input
+    size_t arenaMark = arena_.size();
+    std::vector<Key> keys(sortedEntries.size());
+    for (size_t i = 0; i < sortedEntries.size(); i++) {
+        const IndexEntry& entry = sortedEntries[i];
+        bool ok = storeKey(entry.key, keys[i]);
+        if (ok && i > 0) {
+            ok = compareEntry(probeOf(keys[i]), entry.sequence,
+                              keys[i - 1], sortedEntries[i - 1].sequence) >= 0;
+        }
+        if (!ok) {
+            arena_.resize(arenaMark);
+            insertEach();
+            return;
+        }
+    }
 
-    // Binary search for the key position
-    size_t lo = 0, hi = node.entries.size();
-    while (lo < hi) {
-        size_t mid = lo + (hi - lo) / 2;
-        int cmp = compareValues(key, node.entries[mid].key);
-        if (cmp <= 0) {
-            hi = mid;
-        } else {
-            lo = mid + 1;
+    // Leaf level, fully packed
+    std::vector<uint32_t> level;
+    std::vector<size_t> firstEntry;
+    for (size_t i = 0; i < sortedEntries.size(); i += FANOUT) {
+        uint32_t idx = static_cast<uint32_t>(leaves_.size());
+        leaves_.emplace_back();
+        LeafNode& leaf = leaves_.back();
+        size_t end = std::min(sortedEntries.size(), i + FANOUT);
+        for (size_t j = i; j < end; j++) {
+            uint32_t at = static_cast<uint32_t>(j - i);
+            leaf.keys[at] = keys[j];
+            leaf.sequences[at] = sortedEntries[j].sequence;
+            leaf.offsets[at] = sortedEntries[j].dataOffset;
+            leaf.lengths[at] = sortedEntries[j].dataLength;
         }
+        leaf.count = static_cast<uint32_t>(end - i);
+        if (!level.empty()) {
+            leaves_[level.back()].next = idx;
+        }
+        level.push_back(idx);
+        firstEntry.push_back(i);
     }
 
-    // Check for match at found position
-    if (lo < node.entries.size() && compareValues(key, node.entries[lo].key) == 0) {
-        result = node.entries[lo];
-        return true;
+    // Inner levels: each node's separators are its children's first entries
+    height_ = 0;
+    while (level.size() > 1) {
+        std::vector<uint32_t> parents;
+        std::vector<size_t> parentFirst;
+        for (size_t g = 0; g < level.size(); g += FANOUT + 1) {
+            uint32_t idx = static_cast<uint32_t>(inners_.size());
+            inners_.emplace_back();
+            InnerNode& inner = inners_.back();
+            size_t end = std::min(level.size(), g + FANOUT + 1);
+            inner.children[0] = level[g];
+            for (size_t c = g + 1; c < end; c++) {
+                uint32_t at = static_cast<uint32_t>(c - g - 1);
+                inner.keys[at] = keys[firstEntry[c]];
+                inner.sequences[at] = sortedEntries[firstEntry[c]].sequence;
+                inner.children[at + 1] = level[c];
+            }
+            inner.count = static_cast<uint32_t>(end - g - 1);
+            parents.push_back(idx);
+            parentFirst.push_back(firstEntry[g]);
+        }
+        level.swap(parents);
+        firstEntry.swap(parentFirst);
+        height_++;
     }
 
-    // If not a leaf, search appropriate child
-    if (!node.isLeaf && lo < node.children.size()) {
-        return searchNodeFirst(node.children[lo], key, result);
+    root_ = level[0];
+    for (const auto& entry : sortedEntries) {
+        stats_.add(entry.key);
     }
+}
 
-    return false;
+Value BTreeIndex::keyToValue(const Key& key) const {
+    switch (domain_) {
+        case KeyDomain::Integer: {
+            int64_t v = decodeInt(key.prefix);
+            switch (keyType_) {
+                case ValueType::Bool: return v != 0;
+                case ValueType::Int8: return static_cast<int8_t>(v);
+                case ValueType::Int16: return static_cast<int16_t>(v);
+                case ValueType::Int32: return static_cast<int32_t>(v);
+                case ValueType::UInt8: return static_cast<uint8_t>(v);
+                case ValueType::UInt16: return static_cast<uint16_t>(v);
+                case ValueType::UInt32: return static_cast<uint32_t>(v);
+                case ValueType::UInt64: return static_cast<uint64_t>(v);
+                default: return v;
+            }
+        }
+        case KeyDomain::Real: {
+            double d = decodeReal(key.prefix);
+            if (keyType_ == ValueType::Float32) return static_cast<float>(d);
+            return d;
+        }
+        case KeyDomain::Text:
+            return std::string(reinterpret_cast<const char*>(arena_.data()) + key.arenaOffset, key.length);
+        case KeyDomain::Blob:
+        default:
+            return std::vector<uint8_t>(arena_.data() + key.arenaOffset,
+                                        arena_.data() + key.arenaOffset + key.length);
+    }
 }
 
-std::vector<IndexEntry> BTree::range(const Value& minKey, const Value& maxKey) const {
+IndexEntry BTreeIndex::entryAt(const LeafNode& leaf, uint32_t pos) const {
+    IndexEntry entry;
+    entry.key = keyToValue(leaf.keys[pos]);
+    entry.dataOffset = leaf.offsets[pos];
+    entry.dataLength = leaf.lengths[pos];
+    entry.sequence = leaf.sequences[pos];
+    return entry;
+}
+
+std::vector<IndexEntry> BTreeIndex::search(const Value& key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     std::vector<IndexEntry> results;
-    rangeSearch(rootId_, minKey, maxKey, results);
+    Probe probe;
+    if (!makeProbe(key, ProbeMode::Exact, probe)) return results;
+
+    uint32_t leaf, pos;
+    lowerBound(probe, leaf, pos);
+    while (leaf != NONE) {
+        const LeafNode& l = leaves_[leaf];
+        for (; pos < l.count; pos++) {
+            if (compareProbe(probeOf(l.keys[pos]), probe) != 0) return results;
+            results.push_back(entryAt(l, pos));
+        }
+        leaf = l.next;
+        pos = 0;
+    }
     return results;
 }
 
-void BTree::rangeSearch(uint64_t nodeId, const Value& minKey, const Value& maxKey,
-                        std::vector<IndexEntry>& results) const {
-    const BTreeNode& node = getNode(nodeId);
-
-    size_t i = 0;
-    while (i < node.entries.size()) {
-        const IndexEntry& entry = node.entries[i];
-        int cmpMin = compareValues(entry.key, minKey);
-        int cmpMax = compareValues(entry.key, maxKey);
+std::vector<IndexEntry> BTreeIndex::searchMany(std::vector<Value> keys) const {
+    sortKeys(keys);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<IndexEntry> results;
 
-        // Visit left child if it might contain entries in range
-        if (!node.isLeaf && cmpMin >= 0 && i < node.children.size()) {
-            rangeSearch(node.children[i], minKey, maxKey, results);
+    // Probes in key-domain order (mixed-type keys may sort differently there)
+    std::vector<Probe> probes;
+    probes.reserve(keys.size());
+    for (const auto& key : keys) {
+        Probe probe;
+        if (makeProbe(key, ProbeMode::Exact, probe)) probes.push_back(probe);
+    }
+    std::sort(probes.begin(), probes.end(), [this](const Probe& a, const Probe& b) {
+        return compareProbe(a, b) < 0;
+    });
+    probes.erase(std::unique(probes.begin(), probes.end(), [this](const Probe& a, const Probe& b) {
+        return compareProbe(a, b) == 0;
+    }), probes.end());
+
+    uint32_t leaf = NONE, pos = 0;
+    for (const auto& probe : probes) {
+        if (leaf != NONE && compareProbe(probeOf(leaves_[leaf].keys[leaves_[leaf].count - 1]), probe) >= 0) {
+            // Still inside the current leaf: search its remaining slots
+            const LeafNode& l = leaves_[leaf];
+            uint32_t lo = pos, hi = l.count;
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                if (compareProbe(probeOf(l.keys[mid]), probe) < 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            pos = lo;
+        } else {
+            lowerBound(probe, leaf, pos);
         }
 
-        // Add entry if in range
-        if (cmpMin >= 0 && cmpMax <= 0) {
-            results.push_back(entry);
+        while (leaf != NONE) {
+            const LeafNode& l = leaves_[leaf];
+            for (; pos < l.count; pos++) {
+                if (compareProbe(probeOf(l.keys[pos]), probe) != 0) break;
+                results.push_back(entryAt(l, pos));
+            }
+            if (pos < l.count) break;
+            leaf = l.next;
+            pos = 0;
         }
+    }
+    return results;
+}
 
-        // Stop if we're past maxKey
-        if (cmpMax > 0) {
-            break;
-        }
+bool BTreeIndex::searchFirst(const Value& key, IndexEntry& result) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    Probe probe;
+    if (!makeProbe(key, ProbeMode::Exact, probe)) return false;
+
+    uint32_t leaf, pos;
+    lowerBound(probe, leaf, pos);
+    if (leaf == NONE) return false;
+    const LeafNode& l = leaves_[leaf];
+    if (compareProbe(probeOf(l.keys[pos]), probe) != 0) return false;
+    result = entryAt(l, pos);
+    return true;
+}
+
+bool BTreeIndex::searchFirstString(const std::string& key, uint64_t& outOffset,
+                                   uint32_t& outLength, uint64_t& outSequence) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (domain_ != KeyDomain::Text) return false;
+
+    Probe probe;
+    probe.bytes = reinterpret_cast<const uint8_t*>(key.data());
+    probe.length = static_cast<uint32_t>(key.size());
+    probe.prefix = encodePrefix(probe.bytes, probe.length);
+
+    uint32_t leaf, pos;
+    lowerBound(probe, leaf, pos);
+    if (leaf == NONE) return false;
+    const LeafNode& l = leaves_[leaf];
+    if (compareProbe(probeOf(l.keys[pos]), probe) != 0) return false;
+    outOffset = l.offsets[pos];
+    outLength = l.lengths[pos];
+    outSequence = l.sequences[pos];
+    return true;
+}
 
-        i++;
+bool BTreeIndex::searchFirstInt64(int64_t key, uint64_t& outOffset,
+                                  uint32_t& outLength, uint64_t& outSequence) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    Probe probe{0, nullptr, 0};
+    if (domain_ == KeyDomain::Integer) {
+        probe.prefix = encodeInt(key);
+    } else if (domain_ == KeyDomain::Real) {
+        probe.prefix = encodeReal(static_cast<double>(key));
+    } else {
+        return false;
     }
 
-    // Visit the rightmost child if we haven't stopped early
-    if (!node.isLeaf && i == node.entries.size() && node.children.size() > i) {
-        rangeSearch(node.children[i], minKey, maxKey, results);
+    uint32_t leaf, pos;
+    lowerBound(probe, leaf, pos);
+    if (leaf == NONE) return false;
+    const LeafNode& l = leaves_[leaf];
+    if (l.keys[pos].prefix != probe.prefix) return false;
+    outOffset = l.offsets[pos];
+    outLength = l.lengths[pos];
+    outSequence = l.sequences[pos];
+    return true;
+}
+
+std::vector<IndexEntry> BTreeIndex::range(const Value& minKey, const Value& maxKey) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<IndexEntry> results;
+    bool openMin = std::holds_alternative<std::monostate>(minKey);
+    bool openMax = std::holds_alternative<std::monostate>(maxKey);
+    Probe lo, hi;
+    if ((!openMin && !makeProbe(minKey, ProbeMode::Lower, lo)) ||
+        (!openMax && !makeProbe(maxKey, ProbeMode::Upper, hi))) {
+        return results;
+    }
+    if (!openMin && !openMax && compareProbe(lo, hi) > 0) return results;
+
+    uint32_t leaf = leftmostLeaf(), pos = 0;
+    if (!openMin) lowerBound(lo, leaf, pos);
+    while (leaf != NONE) {
+        const LeafNode& l = leaves_[leaf];
+        for (; pos < l.count; pos++) {
+            if (!openMax && compareProbe(probeOf(l.keys[pos]), hi) > 0) return results;
+            results.push_back(entryAt(l, pos));
+        }
+        leaf = l.next;
+        pos = 0;
     }
+    return results;
 }
 
-std::vector<IndexEntry> BTree::all() const {
+std::vector<IndexEntry> BTreeIndex::all() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     std::vector<IndexEntry> results;
-    collectAll(rootId_, results);
+    results.reserve(static_cast<size_t>(stats_.entries()));
+    for (uint32_t leaf = leftmostLeaf(); leaf != NONE; leaf = leaves_[leaf].next) {
+        const LeafNode& l = leaves_[leaf];
+        for (uint32_t pos = 0; pos < l.count; pos++) {
+            results.push_back(entryAt(l, pos));
+        }
+    }
     return results;
 }
 
-void BTree::collectAll(uint64_t nodeId, std::vector<IndexEntry>& results) const {
-    const BTreeNode& node = getNode(nodeId);
+class BTreeIndex::RangeCursor : public IndexCursor {
+public:
+    RangeCursor(const BTreeIndex& index, const Value& minKey, const Value& maxKey, bool reverse)
+        : index_(index), reverse_(reverse), minKey_(minKey), maxKey_(maxKey) {
+        // Probes point into the bound copies held here
+        hasMin_ = !std::holds_alternative<std::monostate>(minKey_);
+        hasMax_ = !std::holds_alternative<std::monostate>(maxKey_);
+        if ((hasMin_ && !index_.makeProbe(minKey_, ProbeMode::Lower, min_)) ||
+            (hasMax_ && !index_.makeProbe(maxKey_, ProbeMode::Upper, max_)) ||
+            (hasMin_ && hasMax_ && index_.compareProbe(min_, max_) > 0)) {
+            empty_ = true;
+        }
+    }
 
-    for (size_t i = 0; i < node.entries.size(); i++) {
-        if (!node.isLeaf) {
-            collectAll(node.children[i], results);
+protected:
+    bool fetch(std::vector<IndexEntry>& page) override {
+        if (empty_) return false;
+        std::shared_lock<std::shared_mutex> lock(index_.mutex_);
+        uint32_t leaf, pos;
+        uint32_t lastLeaf = NONE, lastPos = 0;
+
+        if (!reverse_) {
+            if (started_) {
+                index_.upperBound(resumeProbe(), resumeSequence_, leaf, pos);
+            } else if (hasMin_) {
+                index_.lowerBound(min_, leaf, pos);
+            } else {
+                leaf = index_.leftmostLeaf();
+                pos = 0;
+            }
+            while (leaf != NONE && page.size() < PAGE_ENTRIES) {
+                const LeafNode& l = index_.leaves_[leaf];
+                if (pos >= l.count) {
+                    leaf = l.next;
+                    pos = 0;
+                    continue;
+                }
+                if (hasMax_ && index_.compareProbe(index_.probeOf(l.keys[pos]), max_) > 0) break;
+                page.push_back(entryAt(l, pos));
+                lastLeaf = leaf;
+                lastPos = pos++;
+            }
+        } else {
+            if (started_) {
+                index_.lastBefore(resumeProbe(), &resumeSequence_, leaf, pos);
+            } else if (hasMax_) {
+                index_.lastBefore(max_, nullptr, leaf, pos);
+            } else {
+                leaf = index_.root_;
+                for (int level = index_.height_; leaf != NONE && level > 0; --level) {
+                    leaf = index_.inners_[leaf].children[index_.inners_[leaf].count];
+                }
+                pos = leaf != NONE ? index_.leaves_[leaf].count - 1 : 0;
+            }
+            while (leaf != NONE && page.size() < PAGE_ENTRIES) {
+                const LeafNode& l = index_.leaves_[leaf];
+                if (hasMin_ && index_.compareProbe(index_.probeOf(l.keys[pos]), min_) < 0) break;
+                page.push_back(entryAt(l, pos));
+                lastLeaf = leaf;
+                lastPos = pos;
+                if (pos > 0) {
+                    pos--;
+                } else {
+                    // Leaves only link forward: descend again for the previous one
+                    index_.lastBefore(index_.probeOf(l.keys[0]), &l.sequences[0], leaf, pos);
+                }
+            }
         }
-        results.push_back(node.entries[i]);
+        started_ = true;
+
+        if (page.size() < PAGE_ENTRIES) return false;
+        // Copy the last key out of the arena, which may grow before the next page
+        const LeafNode& l = index_.leaves_[lastLeaf];
+        const Key& key = l.keys[lastPos];
+        resumePrefix_ = key.prefix;
+        resumeBytes_.assign(index_.arena_.data() + key.arenaOffset,
+                            index_.arena_.data() + key.arenaOffset + key.length);
+        resumeSequence_ = l.sequences[lastPos];
+        return true;
     }
 
-    if (!node.isLeaf && node.children.size() > node.entries.size()) {
-        collectAll(node.children[node.children.size() - 1], results);
+private:
+    static IndexEntry entryAt(const LeafNode& leaf, uint32_t pos) {
+        IndexEntry entry;
+        entry.dataOffset = leaf.offsets[pos];
+        entry.dataLength = leaf.lengths[pos];
+        entry.sequence = leaf.sequences[pos];
+        return entry;
     }
-}
 
-int BTree::getHeight() const {
-    return getHeightFrom(rootId_);
+    Probe resumeProbe() const {
+        return {resumePrefix_, resumeBytes_.data(), static_cast<uint32_t>(resumeBytes_.size())};
+    }
+
+    const BTreeIndex& index_;
+    bool reverse_;
+    Value minKey_;
+    Value maxKey_;
+    bool hasMin_ = false;
+    bool hasMax_ = false;
+    Probe min_{0, nullptr, 0};
+    Probe max_{0, nullptr, 0};
+    bool empty_ = false;
+    bool started_ = false;
+
+    // Last entry returned; the next page starts just past it
+    uint64_t resumePrefix_ = 0;
+    std::vector<uint8_t> resumeBytes_;
+    uint64_t resumeSequence_ = 0;
+};
+
+std::unique_ptr<IndexCursor> BTreeIndex::openRange(const Value& minKey, const Value& maxKey,
+                                                   bool reverse) const {
+    return std::make_unique<RangeCursor>(*this, minKey, maxKey, reverse);
 }
 
-int BTree::getHeightFrom(uint64_t nodeId) const {
-    const BTreeNode& node = getNode(nodeId);
-    if (node.isLeaf) {
-        return 1;
-    }
-    return 1 + getHeightFrom(node.children[0]);
+void BTreeIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    leaves_.clear();
+    inners_.clear();
+    arena_.clear();
+    root_ = NONE;
+    height_ = 0;
+    stats_.clear();
 }
 
-void BTree::clear() {
-    nodes_.clear();
-    entryCount_ = 0;
-    nextNodeId_ = 1;
-    rootId_ = createNode(true, 0);
+size_t BTreeIndex::memoryBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return leaves_.capacity() * sizeof(LeafNode) + inners_.capacity() * sizeof(InnerNode) + arena_.capacity();
 }
 
 }  // namespace flatsql
@@ -0,0 +1,201 @@
+#include "flatsql/column_cache.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace flatsql {
+
+ColumnCache::ColumnCache(ValueType type)
+    : real_(type == ValueType::Float32 || type == ValueType::Float64) {
+    if (!supports(type)) {
+        throw std::runtime_error("Column cache only supports numeric columns");
+    }
+}
+
+bool ColumnCache::supports(ValueType type) {
+    switch (type) {
+        case ValueType::Bool:
+        case ValueType::Int8:
+        case ValueType::Int16:
+        case ValueType::Int32:
+        case ValueType::Int64:
+        case ValueType::UInt8:
+        case ValueType::UInt16:
+        case ValueType::UInt32:
+        case ValueType::UInt64:
+        case ValueType::Float32:
+        case ValueType::Float64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void ColumnCache::append(const Value& value) {
+    bool isNullValue = false;
+    int64_t i = 0;
+    double d = 0.0;
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            d = static_cast<double>(v);
+            i = std::isfinite(d) && std::fabs(d) < 9.2e18 ? static_cast<int64_t>(d) : 0;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            i = static_cast<int64_t>(v);
+            d = static_cast<double>(v);
+        } else {
+            isNullValue = true;
+        }
+    }, value);
+
+    // Null bit goes in before the value publishes the row
+    size_t row = size();
+    if ((row & 63) == 0) {
+        nullBits_.push_back(0);
+    }
+    if (isNullValue) {
+        __atomic_fetch_or(&nullBits_[row >> 6], uint64_t(1) << (row & 63), __ATOMIC_RELAXED);
+        nullCount_.store(nullCount_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    if (real_) {
+        reals_.push_back(d);
+    } else {
+        ints_.push_back(i);
+    }
+}
+
+namespace {
+
+// Kernels are written as flat loops over a contiguous run (rows of an
+// aligned 64-row block never straddle a StableVector chunk) so the
+// compiler vectorizes them for SSE/AVX2, NEON or WASM SIMD128.
+template <typename T, typename Cmp>
+uint64_t compareRun(const T* values, size_t count, T operand, Cmp cmp) {
+    uint8_t hits[64];
+    for (size_t i = 0; i < count; i++) {
+        hits[i] = cmp(values[i], operand) ? 1 : 0;
+    }
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        mask |= static_cast<uint64_t>(hits[i]) << i;
+    }
+    return mask;
+}
+
+template <typename T>
+uint64_t compareRun(const T* values, size_t count, ColumnCache::CompareOp op, T operand) {
+    switch (op) {
+        case ColumnCache::CompareOp::Eq: return compareRun(values, count, operand, [](T a, T b) { return a == b; });
+        case ColumnCache::CompareOp::Lt: return compareRun(values, count, operand, [](T a, T b) { return a < b; });
+        case ColumnCache::CompareOp::Le: return compareRun(values, count, operand, [](T a, T b) { return a <= b; });
+        case ColumnCache::CompareOp::Gt: return compareRun(values, count, operand, [](T a, T b) { return a > b; });
+        case ColumnCache::CompareOp::Ge: return compareRun(values, count, operand, [](T a, T b) { return a >= b; });
+    }
+    return 0;
+}
+
+// Integers up to 2^53 convert to double and back exactly
+constexpr double EXACT_DOUBLE_LIMIT = 9007199254740992.0;
+
+}  // namespace
+
+bool ColumnCache::makeComparison(bool real, CompareOp op, const Value& operand, Comparison& out) {
+    out = Comparison();
+    out.op = op;
+
+    if (std::holds_alternative<std::monostate>(operand)) {
+        // x op NULL is never true
+        out.matchesNone = true;
+        return true;
+    }
+
+    if (const auto* i = std::get_if<int64_t>(&operand)) {
+        if (!real) {
+            out.intOperand = *i;
+            return true;
+        }
+        if (std::fabs(static_cast<double>(*i)) > EXACT_DOUBLE_LIMIT) return false;
+        out.realOperand = static_cast<double>(*i);
+        return true;
+    }
+
+    const auto* d = std::get_if<double>(&operand);
+    if (!d || std::isnan(*d)) return false;
+    if (real) {
+        out.realOperand = *d;
+        return true;
+    }
+
+    // Integer column against a real operand: round the bound so the
+    // integer comparison is equivalent
+    if (std::fabs(*d) > EXACT_DOUBLE_LIMIT) return false;
+    double lower = std::floor(*d);
+    double upper = std::ceil(*d);
+    switch (op) {
+        case CompareOp::Eq:
+            out.matchesNone = lower != upper;
+            out.intOperand = static_cast<int64_t>(lower);
+            break;
+        case CompareOp::Lt:
+            out.op = CompareOp::Le;
+            out.intOperand = static_cast<int64_t>(upper) - 1;
+            break;
+        case CompareOp::Le:
+            out.intOperand = static_cast<int64_t>(lower);
+            break;
+        case CompareOp::Gt:
+            out.op = CompareOp::Ge;
+            out.intOperand = static_cast<int64_t>(lower) + 1;
+            break;
+        case CompareOp::Ge:
+            out.intOperand = static_cast<int64_t>(upper);
+            break;
+    }
+    return true;
+}
+
+uint64_t ColumnCache::matchBlock(size_t block, const Comparison& cmp) const {
+    size_t begin = block << 6;
+    size_t rows = size();
+    if (begin >= rows) return ~uint64_t(0);
+    size_t count = rows - begin < 64 ? rows - begin : 64;
+
+    uint64_t mask = 0;
+    if (!cmp.matchesNone) {
+        mask = real_ ? compareRun(&reals_[begin], count, cmp.op, cmp.realOperand)
+                     : compareRun(&ints_[begin], count, cmp.op, cmp.intOperand);
+        mask &= ~__atomic_load_n(&nullBits_[block], __ATOMIC_RELAXED);
+    }
+    if (count < 64) {
+        mask |= ~uint64_t(0) << count;
+    }
+    return mask;
+}
+
+size_t ColumnCache::readBlock(size_t block, double* out, uint64_t& nulls) const {
+    size_t begin = block << 6;
+    size_t rows = size();
+    if (begin >= rows) return 0;
+    size_t count = rows - begin < 64 ? rows - begin : 64;
+
+    // A block never straddles a StableVector chunk
+    if (real_) {
+        std::memcpy(out, &reals_[begin], count * sizeof(double));
+    } else {
+        const int64_t* ints = &ints_[begin];
+        for (size_t i = 0; i < count; i++) {
+            out[i] = static_cast<double>(ints[i]);
+        }
+    }
+    nulls = __atomic_load_n(&nullBits_[block], __ATOMIC_RELAXED);
+    return count;
+}
+
+Value ColumnCache::getValue(size_t row) const {
+    if (isNull(row)) return std::monostate{};
+    if (real_) return reals_[row];
+    return ints_[row];
+}
+
+}  // namespace flatsql
@@ -0,0 +1,461 @@
+#include "flatsql/composite_index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace flatsql {
+
+// Each column of a key starts with a tag: NULL sorts before every value
+static constexpr uint8_t NULL_TAG = 0x00;
+static constexpr uint8_t VALUE_TAG = 0x01;
+
+// Bytes sorting after every value of a column (PAST_VALUES in place of
+// the tag) or after everything following a complete column (PAST_COLUMN)
+static constexpr uint8_t PAST_VALUES = 0x02;
+static constexpr uint8_t PAST_COLUMN = 0xFF;
+
+// Strings and blobs escape NUL as NUL 0xFF and end with NUL NUL, so a
+// prefix sorts before its extensions
+static constexpr uint8_t ESCAPE = 0xFF;
+
+static constexpr double INT64_BOUND = 9223372036854775808.0;  // 2^63
+
+namespace {
+
+enum class Kind { Integer, Real, Text, Blob };
+
+Kind kindOf(ValueType type) {
+    switch (type) {
+        case ValueType::Float32:
+        case ValueType::Float64: return Kind::Real;
+        case ValueType::String:  return Kind::Text;
+        case ValueType::Bytes:   return Kind::Blob;
+        default:                 return Kind::Integer;
+    }
+}
+
+// How a constraint value went into a key
+enum class Encoded { Value, NoMatch, Unencodable };
+
+// Which side of a range a bound is (integer columns round reals inward)
+enum class BoundSide { Exact, Lower, Upper };
+
+void appendUInt64(std::vector<uint8_t>& out, uint64_t bits) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(bits >> shift));
+    }
+}
+
+void appendInteger(std::vector<uint8_t>& out, int64_t value) {
+    out.push_back(VALUE_TAG);
+    appendUInt64(out, static_cast<uint64_t>(value) ^ (uint64_t(1) << 63));
+}
+
+// Negative reals have every bit flipped, the rest only the sign bit
+void appendReal(std::vector<uint8_t>& out, double value) {
+    if (value == 0.0) value = 0.0;  // -0.0 equals 0.0
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits = (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+    out.push_back(VALUE_TAG);
+    appendUInt64(out, bits);
+}
+
+void appendBytes(std::vector<uint8_t>& out, const uint8_t* data, size_t size) {
+    out.push_back(VALUE_TAG);
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(data[i]);
+        if (data[i] == 0) out.push_back(ESCAPE);
+    }
+    out.push_back(0);
+    out.push_back(0);
+}
+
+bool integerOf(const Value& value, int64_t& out) {
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_integral_v<T>) {
+            out = static_cast<int64_t>(v);
+            return true;
+        }
+        return false;
+    }, value);
+}
+
+bool realOf(const Value& value, double& out) {
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            out = static_cast<double>(v);
+            return true;
+        }
+        return false;
+    }, value);
+}
+
+// A record's value of a column of type; NaN is NULL, as in SQLite
+void encodeColumn(std::vector<uint8_t>& out, const Value& value, ValueType type) {
+    int64_t integer;
+    double real;
+    switch (kindOf(type)) {
+        case Kind::Integer:
+            if (integerOf(value, integer)) {
+                appendInteger(out, integer);
+                return;
+            }
+            if (realOf(value, real) && std::isfinite(real) && real == std::floor(real) &&
+                real >= -INT64_BOUND && real < INT64_BOUND) {
+                appendInteger(out, static_cast<int64_t>(real));
+                return;
+            }
+            break;
+        case Kind::Real:
+            if (realOf(value, real) && !std::isnan(real)) {
+                appendReal(out, real);
+                return;
+            }
+            break;
+        case Kind::Text:
+            if (const auto* text = std::get_if<std::string>(&value)) {
+                appendBytes(out, reinterpret_cast<const uint8_t*>(text->data()), text->size());
+                return;
+            }
+            break;
+        case Kind::Blob:
+            if (const auto* bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+                appendBytes(out, bytes->data(), bytes->size());
+                return;
+            }
+            break;
+    }
+    out.push_back(NULL_TAG);
+}
+
+// A constraint value compared with a column of type, as one side of a
+// range (or an equality); out is left alone unless it is a Value
+Encoded encodeConstraint(std::vector<uint8_t>& out, const Value& value, ValueType type, BoundSide side) {
+    if (std::holds_alternative<std::monostate>(value)) return Encoded::NoMatch;  // NULL compares false
+    int64_t integer;
+    double real;
+    switch (kindOf(type)) {
+        case Kind::Integer:
+            if (integerOf(value, integer)) {
+                appendInteger(out, integer);
+                return Encoded::Value;
+            }
+            if (!realOf(value, real) || std::isnan(real)) return Encoded::Unencodable;
+            if (side == BoundSide::Exact) {
+                if (real != std::floor(real) || real < -INT64_BOUND || real >= INT64_BOUND) return Encoded::NoMatch;
+            } else if (side == BoundSide::Lower) {
+                real = std::ceil(real);
+                if (real >= INT64_BOUND) return Encoded::NoMatch;
+                if (real < -INT64_BOUND) return Encoded::Unencodable;
+            } else {
+                real = std::floor(real);
+                if (real < -INT64_BOUND) return Encoded::NoMatch;
+                if (real >= INT64_BOUND) return Encoded::Unencodable;
+            }
+            appendInteger(out, static_cast<int64_t>(real));
+            return Encoded::Value;
+        case Kind::Real:
+            if (!realOf(value, real) || std::isnan(real)) return Encoded::Unencodable;
+            appendReal(out, real);
+            return Encoded::Value;
+        case Kind::Text:
+            if (const auto* text = std::get_if<std::string>(&value)) {
+                appendBytes(out, reinterpret_cast<const uint8_t*>(text->data()), text->size());
+                return Encoded::Value;
+            }
+            return Encoded::Unencodable;
+        case Kind::Blob:
+            if (const auto* bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+                appendBytes(out, bytes->data(), bytes->size());
+                return Encoded::Value;
+            }
+            return Encoded::Unencodable;
+    }
+    return Encoded::Unencodable;
+}
+
+bool readUInt64(const uint8_t*& p, const uint8_t* end, uint64_t& bits) {
+    if (end - p < 8) return false;
+    bits = 0;
+    for (int i = 0; i < 8; i++) bits = (bits << 8) | *p++;
+    return true;
+}
+
+// Read one column of type from p, moving past it
+bool decodeColumn(const uint8_t*& p, const uint8_t* end, ValueType type, Value& out) {
+    if (p == end) return false;
+    uint8_t tag = *p++;
+    if (tag == NULL_TAG) {
+        out = std::monostate{};
+        return true;
+    }
+    if (tag != VALUE_TAG) return false;
+
+    uint64_t bits;
+    switch (kindOf(type)) {
+        case Kind::Integer: {
+            if (!readUInt64(p, end, bits)) return false;
+            int64_t v = static_cast<int64_t>(bits ^ (uint64_t(1) << 63));
+            switch (type) {
+                case ValueType::Bool:   out = v != 0; break;
+                case ValueType::Int8:   out = static_cast<int8_t>(v); break;
+                case ValueType::Int16:  out = static_cast<int16_t>(v); break;
+                case ValueType::Int32:  out = static_cast<int32_t>(v); break;
+                case ValueType::UInt8:  out = static_cast<uint8_t>(v); break;
+                case ValueType::UInt16: out = static_cast<uint16_t>(v); break;
+                case ValueType::UInt32: out = static_cast<uint32_t>(v); break;
+                case ValueType::UInt64: out = static_cast<uint64_t>(v); break;
+                default:                out = v; break;
+            }
+            return true;
+        }
+        case Kind::Real: {
+            if (!readUInt64(p, end, bits)) return false;
+            bits = (bits >> 63) ? bits & ~(uint64_t(1) << 63) : ~bits;
+            double v;
+            std::memcpy(&v, &bits, sizeof(v));
+            if (type == ValueType::Float32) {
+                out = static_cast<float>(v);
+            } else {
+                out = v;
+            }
+            return true;
+        }
+        case Kind::Text:
+        case Kind::Blob: {
+            std::vector<uint8_t> bytes;
+            while (true) {
+                if (end - p < 2) return false;
+                if (p[0] == 0) {
+                    if (p[1] == 0) break;
+                    if (p[1] != ESCAPE) return false;
+                    p++;
+                }
+                bytes.push_back(*p++);
+            }
+            p += 2;
+            if (type == ValueType::String) {
+                out = std::string(bytes.begin(), bytes.end());
+            } else {
+                out = std::move(bytes);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+CompositeIndex::CompositeIndex(const std::string& tableName, const std::string& name,
+                               std::vector<Column> keyColumns, std::vector<Column> includedColumns,
+                               std::unique_ptr<Index> entries)
+    : Index(tableName, compositeIndexKey(name), ValueType::Bytes),
+      indexName_(name),
+      keyColumns_(std::move(keyColumns)),
+      includedColumns_(std::move(includedColumns)),
+      entries_(std::move(entries)),
+      columnStats_(keyColumns_.size()) {
+    if (keyColumns_.empty()) {
+        throw std::runtime_error("Composite index needs a key column: " + name);
+    }
+    for (const Column& column : keyColumns_) ordinals_.push_back(column.ordinal);
+    for (const Column& column : includedColumns_) ordinals_.push_back(column.ordinal);
+}
+
+void CompositeIndex::count(const Value& key) {
+    stats_.add(key);
+    const auto* bytes = std::get_if<std::vector<uint8_t>>(&key);
+    if (!bytes) return;
+    const uint8_t* p = bytes->data();
+    const uint8_t* end = p + bytes->size();
+    Value value;
+    for (size_t i = 0; i < keyColumns_.size(); i++) {
+        if (!decodeColumn(p, end, keyColumns_[i].type, value)) return;
+        if (!std::holds_alternative<std::monostate>(value)) columnStats_[i].add(value);
+    }
+}
+
+void CompositeIndex::recount() {
+    stats_.clear();
+    for (auto& stats : columnStats_) stats.clear();
+    for (const auto& entry : entries_->all()) {
+        count(entry.key);
+    }
+}
+
+void CompositeIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    entries_->insert(key, dataOffset, dataLength, sequence);
+    count(key);
+}
+
+void CompositeIndex::insertBatch(std::vector<IndexEntry>& entries) {
+    // Before the wrapped index, which may move the keys out
+    for (const auto& entry : entries) {
+        count(entry.key);
+    }
+    entries_->insertBatch(entries);
+}
+
+void CompositeIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    entries_->bulkLoad(sortedEntries);
+    for (const auto& entry : sortedEntries) {
+        count(entry.key);
+    }
+}
+
+std::vector<IndexEntry> CompositeIndex::search(const Value& key) const {
+    return entries_->search(key);
+}
+
+bool CompositeIndex::searchFirst(const Value& key, IndexEntry& result) const {
+    return entries_->searchFirst(key, result);
+}
+
+std::vector<IndexEntry> CompositeIndex::searchMany(std::vector<Value> keys) const {
+    return entries_->searchMany(std::move(keys));
+}
+
+bool CompositeIndex::searchFirstString(const std::string& key, uint64_t& outOffset,
+                                       uint32_t& outLength, uint64_t& outSequence) const {
+    return entries_->searchFirstString(key, outOffset, outLength, outSequence);
+}
+
+bool CompositeIndex::searchFirstInt64(int64_t key, uint64_t& outOffset,
+                                      uint32_t& outLength, uint64_t& outSequence) const {
+    return entries_->searchFirstInt64(key, outOffset, outLength, outSequence);
+}
+
+std::vector<IndexEntry> CompositeIndex::range(const Value& minKey, const Value& maxKey) const {
+    return entries_->range(minKey, maxKey);
+}
+
+std::vector<IndexEntry> CompositeIndex::all() const {
+    return entries_->all();
+}
+
+std::unique_ptr<IndexCursor> CompositeIndex::openRange(const Value& minKey, const Value& maxKey,
+                                                       bool reverse) const {
+    return entries_->openRange(minKey, maxKey, reverse);
+}
+
+std::unique_ptr<IndexCursor> CompositeIndex::openKeyedRange(const Value& minKey, const Value& maxKey,
+                                                            bool reverse) const {
+    // The base implementation materializes range(), which returns keys
+    return entries_->Index::openRange(minKey, maxKey, reverse);
+}
+
+void CompositeIndex::clear() {
+    entries_->clear();
+    stats_.clear();
+    for (auto& stats : columnStats_) stats.clear();
+}
+
+void CompositeIndex::eraseThrough(uint64_t sequence) {
+    uint64_t before = entries_->getEntryCount();
+    entries_->eraseThrough(sequence);
+    uint64_t removed = before - std::min(before, entries_->getEntryCount());
+    stats_.remove(removed);
+    for (auto& stats : columnStats_) stats.remove(std::min(removed, stats.entries()));
+}
+
+void CompositeIndex::saveTo(sqlite3* db, const std::string& schemaName) const {
+    entries_->saveTo(db, schemaName);
+}
+
+void CompositeIndex::loadFrom(sqlite3* db, const std::string& schemaName) {
+    entries_->loadFrom(db, schemaName);
+    recount();
+}
+
+bool CompositeIndex::covers(int ordinal) const {
+    for (int covered : ordinals_) {
+        if (covered == ordinal) return true;
+    }
+    return false;
+}
+
+void CompositeIndex::encode(const Value* values, Value& key) const {
+    auto* bytes = std::get_if<std::vector<uint8_t>>(&key);
+    if (!bytes) {
+        key = std::vector<uint8_t>();
+        bytes = std::get_if<std::vector<uint8_t>>(&key);
+    }
+    bytes->clear();
+    for (size_t i = 0; i < keyColumns_.size(); i++) {
+        encodeColumn(*bytes, values[i], keyColumns_[i].type);
+    }
+    for (size_t i = 0; i < includedColumns_.size(); i++) {
+        encodeColumn(*bytes, values[keyColumns_.size() + i], includedColumns_[i].type);
+    }
+}
+
+bool CompositeIndex::decode(const Value& key, std::vector<Value>& values) const {
+    const auto* bytes = std::get_if<std::vector<uint8_t>>(&key);
+    if (!bytes) return false;
+    const uint8_t* p = bytes->data();
+    const uint8_t* end = p + bytes->size();
+    for (const auto* columns : {&keyColumns_, &includedColumns_}) {
+        for (const Column& column : *columns) {
+            if (static_cast<size_t>(column.ordinal) >= values.size() ||
+                !decodeColumn(p, end, column.type, values[column.ordinal])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool CompositeIndex::bounds(const std::vector<Value>& equal, const Value* lo, const Value* hi,
+                            Value& minKey, Value& maxKey) const {
+    std::vector<uint8_t> prefix;
+    size_t column = 0;
+    for (; column < equal.size() && column < keyColumns_.size(); column++) {
+        size_t size = prefix.size();
+        Encoded encoded = encodeConstraint(prefix, equal[column], keyColumns_[column].type, BoundSide::Exact);
+        if (encoded == Encoded::NoMatch) return false;
+        if (encoded == Encoded::Unencodable) {
+            prefix.resize(size);
+            break;
+        }
+    }
+
+    std::vector<uint8_t> low = prefix;
+    std::vector<uint8_t> high = std::move(prefix);
+    if (column == equal.size() && column < keyColumns_.size() && (lo || hi)) {
+        // Values of the column start with VALUE_TAG, so NULLs fail both bounds
+        ValueType type = keyColumns_[column].type;
+        size_t size = low.size();
+        Encoded encoded = lo ? encodeConstraint(low, *lo, type, BoundSide::Lower) : Encoded::Unencodable;
+        if (encoded == Encoded::NoMatch) return false;
+        if (encoded == Encoded::Unencodable) {
+            low.resize(size);
+            low.push_back(VALUE_TAG);
+        }
+
+        size = high.size();
+        encoded = hi ? encodeConstraint(high, *hi, type, BoundSide::Upper) : Encoded::Unencodable;
+        if (encoded == Encoded::NoMatch) return false;
+        if (encoded == Encoded::Unencodable) {
+            high.resize(size);
+            high.push_back(PAST_VALUES);
+        } else {
+            high.push_back(PAST_COLUMN);
+        }
+    } else {
+        // Every key starts with a tag, so NULL_TAG is below all of them
+        if (low.empty()) low.push_back(NULL_TAG);
+        high.push_back(PAST_COLUMN);
+    }
+    if (low > high) return false;
+    minKey = std::move(low);
+    maxKey = std::move(high);
+    return true;
+}
+
+}  // namespace flatsql
@@ -1,28 +1,163 @@
 #include "flatsql/database.h"
+#include "flatsql/geo_functions.h"
+#include "flatsql/trace.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
 #include <stdexcept>
-
-#ifdef FLATSQL_HAVE_OPENSSL
-#include <openssl/hmac.h>
-#endif
+#include <type_traits>
 
 namespace flatsql {
 
+// Pending entries per index before an intermediate flush (bounds memory on rebuilds)
+static constexpr size_t MAX_PENDING_INDEX_ENTRIES = 64 * 1024;
+
 // ==================== TableStore ====================
 
-TableStore::TableStore(const TableDef& tableDef, StreamingFlatBufferStore& storage, sqlite3* indexDb)
-    : tableDef_(tableDef), storage_(storage), indexDb_(indexDb) {
+TableStore::TableStore(const TableDef& tableDef, StreamingFlatBufferStore& storage, sqlite3* indexDb,
+                       IndexEngine indexEngine)
+    : tableDef_(tableDef), storage_(storage), indexDb_(indexDb), indexEngine_(indexEngine),
+      verification_(tableDef_) {
+    columnCaches_.resize(tableDef_.columns.size());
+    zoneMaps_.resize(tableDef_.columns.size());
+    bloomFilters_.resize(tableDef_.columns.size());
 
-    // Create indexes for indexed columns using SQLite's optimized B-tree
+    // Create indexes for indexed columns
     for (const auto& col : tableDef_.columns) {
         if (col.indexed || col.primaryKey) {
-            indexes_[col.name] = std::make_unique<SqliteIndex>(
-                indexDb_, tableDef_.name, col.name, col.type);
+            indexes_[col.name] = createColumnIndex(col);
+        }
+    }
+
+    // Map nodes are stable, so the key loop can hold pointers into them
+    for (auto& [colName, index] : indexes_) {
+        indexColumns_.push_back({&colName, index.get(), &pendingEntries_[colName]});
+        indexOrdinals_.push_back(tableDef_.getColumnIndex(colName));
+    }
+
+    // Spatial index: keyed by grid cell, extracted after the column keys
+    if (!tableDef_.geoLatColumn.empty()) {
+        for (const std::string* name : {&tableDef_.geoLatColumn, &tableDef_.geoLonColumn}) {
+            int col = tableDef_.getColumnIndex(*name);
+            if (col < 0) {
+                throw std::runtime_error("Column not found: " + tableDef_.name + "." + *name);
+            }
+            if (!ColumnCache::supports(tableDef_.columns[col].type) || tableDef_.columns[col].encrypted) {
+                throw std::runtime_error("Spatial index requires unencrypted numeric columns: " + *name);
+            }
+        }
+        std::unique_ptr<Index> geo;
+        if (indexEngine == IndexEngine::BTree) {
+            geo = std::make_unique<BTreeIndex>(tableDef_.name, GEO_COLUMN, ValueType::Int64);
+        } else {
+            geo = std::make_unique<SqliteIndex>(indexDb_, tableDef_.name, GEO_COLUMN, ValueType::Int64);
+        }
+        auto it = indexes_.emplace(GEO_COLUMN, std::move(geo)).first;
+        indexColumns_.push_back({&it->first, it->second.get(), &pendingEntries_[GEO_COLUMN]});
+        geoIndexed_ = true;
+    }
+}
+
+std::unique_ptr<Index> TableStore::createColumnIndex(const ColumnDef& col) const {
+    std::unique_ptr<Index> index;
+    if (col.fullText) {
+        if (col.type != ValueType::String || col.encrypted || col.trigram) {
+            throw std::runtime_error("Full-text index requires an unencrypted string column: " + col.name);
+        }
+        index = std::make_unique<FullTextIndex>(tableDef_.name, col.name);
+    } else if (col.dictionary) {
+        if (col.type != ValueType::String || col.encrypted) {
+            throw std::runtime_error("Dictionary index requires an unencrypted string column: " + col.name);
+        }
+        index = std::make_unique<DictionaryIndex>(tableDef_.name, col.name);
+    } else if (indexEngine_ == IndexEngine::BTree) {
+        index = std::make_unique<BTreeIndex>(tableDef_.name, col.name, col.type);
+    } else {
+        index = std::make_unique<SqliteIndex>(indexDb_, tableDef_.name, col.name, col.type);
+    }
+
+    // Trigram postings on top of the column's own index
+    if (col.trigram) {
+        if (col.type != ValueType::String || col.encrypted) {
+            throw std::runtime_error("Trigram index requires an unencrypted string column: " + col.name);
+        }
+        index = std::make_unique<TrigramIndex>(tableDef_.name, col.name, std::move(index));
+    }
+    return index;
+}
+
+// Numeric Value as a double (false for NULL and non-numeric values)
+static bool numericValue(const Value& value, double& out) {
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            out = static_cast<double>(v);
+            return true;
+        }
+        return false;
+    }, value);
+}
+
+ValueView TableStore::fieldView(const uint8_t* data, size_t length, const std::string& column,
+                                Value& scratch) const {
+    if (fieldViewExtractor_) return fieldViewExtractor_(data, length, column);
+    if (useSchemaExtractor_) return schemaExtractor_->extractView(data, length, column);
+    scratch = fieldExtractor_ ? fieldExtractor_(data, length, column) : Value{};
+    return viewOf(scratch);
+}
+
+void TableStore::extractColumns(const uint8_t* data, size_t length, const int* ordinals, size_t count,
+                                Value* values) const {
+    if (keyExtractor_) {
+        keyExtractor_(data, length, ordinals, count, values);
+    } else if (useSchemaExtractor_) {
+        schemaExtractor_->extractKeys(data, length, ordinals, count, values);
+    } else if (fieldViewExtractor_) {
+        for (size_t i = 0; i < count; i++) {
+            assignValue(values[i], fieldViewExtractor_(data, length, tableDef_.columns[ordinals[i]].name));
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = fieldExtractor_(data, length, tableDef_.columns[ordinals[i]].name);
+        }
+    }
+}
+
+void TableStore::extractKeys(const uint8_t* data, size_t length, std::vector<Value>& keys) const {
+    const size_t columnKeys = indexOrdinals_.size();
+    keys.resize(indexColumns_.size() + compositeOrdinals_.size());
+    extractColumns(data, length, indexOrdinals_.data(), columnKeys, keys.data());
+
+    // Records without both coordinates stay out of the spatial index
+    if (geoIndexed_) {
+        double lat, lon;
+        if (fieldExtractor_ &&
+            numericValue(fieldExtractor_(data, length, tableDef_.geoLatColumn), lat) &&
+            numericValue(fieldExtractor_(data, length, tableDef_.geoLonColumn), lon)) {
+            keys[columnKeys] = geoCellKey(lat, lon);
+        } else {
+            keys[columnKeys] = std::monostate{};
+        }
+    }
+
+    // Composite keys are encoded from their columns' values, read into the
+    // slots past the keys
+    if (!composites_.empty()) {
+        Value* values = keys.data() + indexColumns_.size();
+        extractColumns(data, length, compositeOrdinals_.data(), compositeOrdinals_.size(), values);
+        size_t slot = indexColumns_.size() - composites_.size();
+        for (const CompositeIndex* composite : composites_) {
+            composite->encode(values, keys[slot++]);
+            values += composite->getOrdinals().size();
         }
     }
 }
 
 void TableStore::onIngest(const uint8_t* data, size_t length, uint64_t sequence, uint64_t offset) {
+    FLATSQL_TRACE_SCOPE("TableStore::onIngest");
     // This is the streaming index builder
     // Called for each FlatBuffer as it arrives
 
@@ -30,32 +165,591 @@ void TableStore::onIngest(const uint8_t* data, size_t length, uint64_t sequence,
 
     // Track this record for source-specific iteration
     recordInfos_.push_back({offset, sequence});
+    if (verification_.getMode() == VerificationMode::Lazy) {
+        verification_.reserve(sequence);
+    }
 
-    if (!fieldExtractor_) {
+    if (!fieldExtractor_ && !keyExtractor_) {
         return;  // No extractor, can't index
     }
 
-    // Extract and index each indexed column
+    if (!aggregates_.empty() && fieldExtractor_) {
+        for (auto& aggregate : aggregates_) {
+            aggregate->add(data, length, sequence, fieldExtractor_);
+        }
+    }
+
+    // Parallel extraction: keys are pulled from storage at flush time,
+    // once this chunk has been framed and copied
+    if (batching_ && workerPool_ && !indexes_.empty()) {
+        pendingRecords_.push_back({offset, sequence});
+        if (pendingRecords_.size() >= MAX_PENDING_INDEX_ENTRIES) {
+            extractPendingRecords();
+            for (auto& [colName, pending] : pendingEntries_) {
+                indexes_[colName]->insertBatch(pending);
+                pending.clear();
+            }
+        }
+        return;
+    }
+
+    // Extract all keys, then index each column; NULL keys never match a
+    // lookup, so records without the field are left out of that index
+    extractKeys(data, length, keyBuffer_);
+    for (size_t k = 0; k < indexColumns_.size(); k++) {
+        Value& key = keyBuffer_[k];
+        if (std::holds_alternative<std::monostate>(key)) continue;
+        if (batching_) {
+            auto& pending = *indexColumns_[k].pending;
+            pending.push_back({key, offset, static_cast<uint32_t>(length), sequence});
+            if (pending.size() >= MAX_PENDING_INDEX_ENTRIES) {
+                indexColumns_[k].index->insertBatch(pending);
+                pending.clear();
+            }
+        } else {
+            indexColumns_[k].index->insert(key, offset, static_cast<uint32_t>(length), sequence);
+        }
+    }
+
+    if ((hasColumnCaches_ || hasZoneMaps_) && fieldExtractor_) {
+        for (size_t c = 0; c < columnCaches_.size(); c++) {
+            if (!columnCaches_[c] && !zoneMaps_[c] && !bloomFilters_[c]) continue;
+            Value value = fieldExtractor_(data, length, tableDef_.columns[c].name);
+            if (columnCaches_[c]) columnCaches_[c]->append(value);
+            if (zoneMaps_[c]) zoneMaps_[c]->append(value);
+            if (bloomFilters_[c]) bloomFilters_[c]->append(value);
+        }
+    }
+}
+
+void TableStore::extractPendingRecords() {
+    if (pendingRecords_.empty()) return;
+    fillColumnCaches();
+
+    // First slot for pendingRecords_[0], per indexColumns_ entry
+    std::vector<IndexEntry*> out;
+    for (const auto& column : indexColumns_) {
+        size_t base = column.pending->size();
+        column.pending->resize(base + pendingRecords_.size());
+        out.push_back(column.pending->data() + base);
+    }
+
+    // Each worker fills its own slots, so entry order matches stream order
+    workerPool_->parallelFor(pendingRecords_.size(), [&](size_t begin, size_t end) {
+        std::vector<Value> keys;
+        for (size_t i = begin; i < end; i++) {
+            const auto& info = pendingRecords_[i];
+            uint32_t length = 0;
+            const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+            extractKeys(data, length, keys);
+            for (size_t k = 0; k < out.size(); k++) {
+                out[k][i] = {std::move(keys[k]), info.offset, length, info.sequence};
+            }
+        }
+    });
+    pendingRecords_.clear();
+
+    for (const auto& column : indexColumns_) {
+        auto& pending = *column.pending;
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const IndexEntry& entry) {
+            return std::holds_alternative<std::monostate>(entry.key);
+        }), pending.end());
+    }
+}
+
+void TableStore::flushIndexBatch() {
+    FLATSQL_TRACE_SCOPE("TableStore::flushIndexBatch");
+    batching_ = false;
+    extractPendingRecords();
+    for (auto& [colName, pending] : pendingEntries_) {
+        if (pending.empty()) continue;
+        auto it = indexes_.find(colName);
+        std::vector<IndexEntry> entries = std::move(pending);
+        pending.clear();
+        it->second->insertBatch(entries);
+    }
+}
+
+void TableStore::restoreRecords(const StreamingFlatBufferStore::RecordInfoList& infos,
+                                uint64_t endOffset) {
+    for (const auto& info : infos) {
+        if (info.offset >= endOffset) break;  // infos are in stream order
+        recordInfos_.push_back(info);
+        recordCount_++;
+    }
+    if (!recordInfos_.empty() && verification_.getMode() == VerificationMode::Lazy) {
+        verification_.reserve(recordInfos_.back().sequence);
+    }
+    fillColumnCaches();
+}
+
+void TableStore::remapSequences(const std::vector<uint64_t>& sequenceMap) {
+    auto mapped = [&](uint64_t sequence) {
+        return sequence < sequenceMap.size() ? sequenceMap[sequence] : 0;
+    };
+
+    // Surviving rows in their new sequence order, which is the old row
+    // order unless compaction clustered the table
+    std::vector<size_t> keptRows;
+    for (size_t row = 0; row < recordInfos_.size(); row++) {
+        if (mapped(recordInfos_[row].sequence) != 0) keptRows.push_back(row);
+    }
+    auto newer = [&](size_t a, size_t b) {
+        return mapped(recordInfos_[a].sequence) < mapped(recordInfos_[b].sequence);
+    };
+    if (!std::is_sorted(keptRows.begin(), keptRows.end(), newer)) {
+        std::sort(keptRows.begin(), keptRows.end(), newer);
+    }
+    std::vector<StreamingFlatBufferStore::FileRecordInfo> infos;
+    for (size_t row : keptRows) {
+        uint64_t sequence = mapped(recordInfos_[row].sequence);
+        infos.push_back({*storage_.getOffsetForSequence(sequence), sequence});
+    }
+
+    // Caches keep their values, only the row numbers close up
+    for (size_t c = 0; c < columnCaches_.size(); c++) {
+        if (!columnCaches_[c]) continue;
+        auto cache = std::make_unique<ColumnCache>(tableDef_.columns[c].type);
+        for (size_t row : keptRows) {
+            if (row >= columnCaches_[c]->size()) break;
+            cache->append(columnCaches_[c]->getValue(row));
+        }
+        columnCaches_[c] = std::move(cache);
+    }
+
+    // Zones shift with the rows, so zone maps and Bloom filters are rebuilt
+    for (size_t c = 0; c < zoneMaps_.size(); c++) {
+        if (zoneMaps_[c]) {
+            zoneMaps_[c] = std::make_unique<ZoneMap>(tableDef_.columns[c].type);
+        }
+        if (bloomFilters_[c]) {
+            bloomFilters_[c] = std::make_unique<ZoneBloomFilter>();
+        }
+    }
+
+    recordInfos_.clear();
+    for (const auto& info : infos) {
+        recordInfos_.push_back(info);
+    }
+    recordCount_ = recordInfos_.size();
+    fillColumnCaches();
+
+    // Outcomes were kept by old sequence; the records are checked again
+    verification_.clearOutcomes();
+    if (!recordInfos_.empty() && verification_.getMode() == VerificationMode::Lazy) {
+        verification_.reserve(recordInfos_.back().sequence);
+    }
+
+    for (auto& aggregate : aggregates_) {
+        aggregate->remapSequences(sequenceMap);
+    }
+
     for (auto& [colName, index] : indexes_) {
-        Value key = fieldExtractor_(data, length, colName);
-        index->insert(key, offset, static_cast<uint32_t>(length), sequence);
+        std::vector<IndexEntry> entries = index->all();
+        size_t kept = 0;
+        for (auto& entry : entries) {
+            uint64_t sequence = mapped(entry.sequence);
+            if (sequence == 0) continue;
+            entry.sequence = sequence;
+            entry.dataOffset = *storage_.getOffsetForSequence(sequence);
+            if (&entries[kept] != &entry) entries[kept] = std::move(entry);  // A self-move would clear the key
+            kept++;
+        }
+        entries.resize(kept);
+        index->clear();
+        index->insertBatch(entries);
+    }
+
+    // A backfilling index holds only some of the records: refill it
+    for (Backfill& backfill : backfills_) {
+        indexes_.at(backfill.column)->clear();
+        backfill.nextRow = 0;
+        backfill.endRow = recordInfos_.size();
+    }
+
+    for (auto it = upsertCurrent_.begin(); it != upsertCurrent_.end();) {
+        uint64_t sequence = mapped(it->second.sequence);
+        if (sequence == 0) {
+            it = upsertCurrent_.erase(it);
+            continue;
+        }
+        it->second.sequence = sequence;
+        it->second.offset = *storage_.getOffsetForSequence(sequence);
+        ++it;
+    }
+    std::unordered_map<uint64_t, uint64_t> previous;
+    for (const auto& [sequence, old] : upsertPrevious_) {
+        uint64_t newSequence = mapped(sequence), newOld = mapped(old);
+        if (newSequence != 0 && newOld != 0) previous[newSequence] = newOld;
+    }
+    upsertPrevious_ = std::move(previous);
+}
+
+void TableStore::setSchemaExtractor(std::shared_ptr<const SchemaExtractor> extractor) {
+    schemaExtractor_ = std::move(extractor);
+    useSchemaExtractor_ = schemaExtractor_ != nullptr;
+    if (useSchemaExtractor_) {
+        const SchemaExtractor* reader = schemaExtractor_.get();
+        fieldExtractor_ = [reader](const uint8_t* data, size_t length, const std::string& fieldName) {
+            return reader->extract(data, length, fieldName);
+        };
+    }
+}
+
+void TableStore::enableColumnCache(const std::string& columnName) {
+    int col = tableDef_.getColumnIndex(columnName);
+    if (col < 0) {
+        throw std::runtime_error("Column not found: " + tableDef_.name + "." + columnName);
+    }
+    const ColumnDef& def = tableDef_.columns[col];
+    if (!ColumnCache::supports(def.type) || def.encrypted) {
+        throw std::runtime_error("Column cache requires an unencrypted numeric column: " + columnName);
+    }
+    if (!fieldExtractor_) {
+        throw std::runtime_error("Column cache requires a field extractor for table " + tableDef_.name);
+    }
+    if (columnCaches_[col]) return;
+
+    columnCaches_[col] = std::make_unique<ColumnCache>(def.type);
+    hasColumnCaches_ = true;
+    fillColumnCaches();
+}
+
+Index* TableStore::addIndex(const std::string& columnName) {
+    FLATSQL_TRACE_SCOPE("TableStore::addIndex");
+    int col = tableDef_.getColumnIndex(columnName);
+    if (col < 0) {
+        throw std::runtime_error("Column not found: " + tableDef_.name + "." + columnName);
+    }
+    const ColumnDef& def = tableDef_.columns[col];
+    if (def.encrypted) {
+        throw std::runtime_error("Cannot add an index on an encrypted column: " + columnName);
+    }
+    if (Index* existing = getIndex(columnName)) return existing;
+    if (!fieldExtractor_ && !fieldViewExtractor_ && !keyExtractor_) {
+        throw std::runtime_error("Adding an index requires an extractor for table " + tableDef_.name);
+    }
+    if (batching_) {
+        throw std::runtime_error("Cannot add an index inside an ingest batch");
+    }
+    for (auto it = backfills_.begin(); it != backfills_.end(); ++it) {
+        if (it->column == def.name) {
+            // evolve() added it: take the remaining records now
+            Index* index = indexes_.at(def.name).get();
+            fillIndex(index, col, it->nextRow, it->endRow);
+            backfills_.erase(it);
+            return index;
+        }
+    }
+
+    std::unique_ptr<Index> created;
+    if (indexEngine_ == IndexEngine::BTree) {
+        created = std::make_unique<BTreeIndex>(tableDef_.name, def.name, def.type);
+    } else {
+        created = std::make_unique<SqliteIndex>(indexDb_, tableDef_.name, def.name, def.type);
+    }
+    auto it = indexes_.emplace(def.name, std::move(created)).first;
+    Index* index = it->second.get();
+    fillIndex(index, col, 0, recordInfos_.size());
+
+    // Column keys come before the spatial one in extraction order
+    indexColumns_.insert(indexColumns_.begin() + indexOrdinals_.size(),
+                         {&it->first, index, &pendingEntries_[def.name]});
+    indexOrdinals_.push_back(col);
+    return index;
+}
+
+void TableStore::fillIndex(Index* index, int col, size_t beginRow, size_t endRow) {
+    // In windows, as the rebuilds do
+    const std::string& column = tableDef_.columns[col].name;
+    std::vector<IndexEntry> entries;
+    Value key, scratch;
+    for (size_t row = beginRow; row < endRow; row++) {
+        const auto& info = recordInfos_[row];
+        if (info.sequence <= storage_.getEvictedSequence()) continue;
+        uint32_t length = 0;
+        const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+        if (!data) continue;
+        if (keyExtractor_) {
+            keyExtractor_(data, length, &col, 1, &key);
+        } else {
+            assignValue(key, fieldView(data, length, column, scratch));
+        }
+        if (std::holds_alternative<std::monostate>(key)) continue;
+        entries.push_back({std::move(key), info.offset, length, info.sequence});
+        key = std::monostate{};
+        if (entries.size() >= MAX_PENDING_INDEX_ENTRIES) {
+            index->insertBatch(entries);
+            entries.clear();
+        }
+    }
+    index->insertBatch(entries);
+}
+
+void TableStore::evolve(const TableDef& evolved, std::shared_ptr<const SchemaExtractor> extractor) {
+    FLATSQL_TRACE_SCOPE("TableStore::evolve");
+    if (batching_) {
+        throw std::runtime_error("Cannot evolve the schema inside an ingest batch");
+    }
+
+    // Columns to index: added ones and current ones newly marked
+    std::vector<int> indexed;
+    const size_t known = tableDef_.columns.size();
+    for (size_t c = 0; c < evolved.columns.size(); c++) {
+        const ColumnDef& col = evolved.columns[c];
+        if (c >= known) {
+            tableDef_.columns.push_back(col);
+        } else if (!indexes_.count(col.name)) {
+            ColumnDef& current = tableDef_.columns[c];
+            current.indexed = col.indexed;
+            current.fullText = col.fullText;
+            current.dictionary = col.dictionary;
+            current.trigram = col.trigram;
+        }
+        if ((col.indexed || col.primaryKey) && !indexes_.count(col.name)) {
+            indexed.push_back(static_cast<int>(c));
+        }
+    }
+    columnCaches_.resize(tableDef_.columns.size());
+    zoneMaps_.resize(tableDef_.columns.size());
+    bloomFilters_.resize(tableDef_.columns.size());
+    if (useSchemaExtractor_) {
+        retiredExtractors_.push_back(schemaExtractor_);
+        setSchemaExtractor(extractor ? std::move(extractor) : std::make_shared<const SchemaExtractor>(tableDef_));
+    }
+    verification_.setLayout(tableDef_);
+
+    for (int c : indexed) {
+        const ColumnDef& def = tableDef_.columns[c];
+        auto it = indexes_.emplace(def.name, createColumnIndex(def)).first;
+        indexColumns_.insert(indexColumns_.begin() + indexOrdinals_.size(),
+                             {&it->first, it->second.get(), &pendingEntries_[def.name]});
+        indexOrdinals_.push_back(c);
+        if (!recordInfos_.empty()) {
+            backfills_.push_back({def.name, c, 0, recordInfos_.size()});
+        }
+    }
+}
+
+size_t TableStore::backfill(size_t maxRecords, std::vector<std::string>& completed) {
+    FLATSQL_TRACE_SCOPE("TableStore::backfill");
+    if (batching_) {
+        throw std::runtime_error("Cannot backfill indexes inside an ingest batch");
+    }
+    size_t read = 0;
+    while (!backfills_.empty() && read < maxRecords) {
+        Backfill& next = backfills_.front();
+        size_t end = next.nextRow + std::min(next.endRow - next.nextRow, maxRecords - read);
+        fillIndex(indexes_.at(next.column).get(), next.ordinal, next.nextRow, end);
+        read += end - next.nextRow;
+        next.nextRow = end;
+        if (next.nextRow == next.endRow) {
+            completed.push_back(next.column);
+            backfills_.erase(backfills_.begin());
+        }
+    }
+    return read;
+}
+
+bool TableStore::backfilling(const std::string& column) const {
+    for (const Backfill& backfill : backfills_) {
+        if (backfill.column == column) return true;
+    }
+    return false;
+}
+
+CompositeIndex* TableStore::addCompositeIndex(const std::string& name, const std::vector<std::string>& keyColumns,
+                                              const std::vector<std::string>& includeColumns) {
+    FLATSQL_TRACE_SCOPE("TableStore::addCompositeIndex");
+    const std::string key = compositeIndexKey(name);
+    if (name.empty() || indexes_.count(key)) {
+        throw std::runtime_error("Composite index name in use: " + tableDef_.name + "." + name);
+    }
+    if (keyColumns.empty()) {
+        throw std::runtime_error("Composite index needs a key column: " + name);
+    }
+    std::vector<CompositeIndex::Column> keys, included;
+    std::set<int> seen;
+    for (const auto* names : {&keyColumns, &includeColumns}) {
+        for (const std::string& columnName : *names) {
+            int col = tableDef_.getColumnIndex(columnName);
+            if (col < 0) {
+                throw std::runtime_error("Column not found: " + tableDef_.name + "." + columnName);
+            }
+            const ColumnDef& def = tableDef_.columns[col];
+            if (def.encrypted) {
+                throw std::runtime_error("Cannot add an index on an encrypted column: " + columnName);
+            }
+            if (!seen.insert(col).second) {
+                throw std::runtime_error("Column repeated in composite index " + name + ": " + columnName);
+            }
+            (names == &keyColumns ? keys : included).push_back({def.name, col, def.type});
+        }
+    }
+    if (!fieldExtractor_ && !fieldViewExtractor_ && !keyExtractor_) {
+        throw std::runtime_error("Adding an index requires an extractor for table " + tableDef_.name);
+    }
+    if (batching_) {
+        throw std::runtime_error("Cannot add an index inside an ingest batch");
+    }
+
+    std::unique_ptr<Index> entries;
+    if (indexEngine_ == IndexEngine::BTree) {
+        entries = std::make_unique<BTreeIndex>(tableDef_.name, key, ValueType::Bytes);
+    } else {
+        entries = std::make_unique<SqliteIndex>(indexDb_, tableDef_.name, key, ValueType::Bytes);
+    }
+    auto created = std::make_unique<CompositeIndex>(tableDef_.name, name, std::move(keys), std::move(included),
+                                                    std::move(entries));
+    CompositeIndex* index = created.get();
+    auto it = indexes_.emplace(key, std::move(created)).first;
+
+    // Backfill in windows, as addIndex does
+    const std::vector<int>& ordinals = index->getOrdinals();
+    std::vector<Value> values(ordinals.size());
+    std::vector<IndexEntry> pending;
+    Value encoded;
+    for (const auto& info : recordInfos_) {
+        if (info.sequence <= storage_.getEvictedSequence()) continue;
+        uint32_t length = 0;
+        const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+        if (!data) continue;
+        extractColumns(data, length, ordinals.data(), ordinals.size(), values.data());
+        index->encode(values.data(), encoded);
+        pending.push_back({std::move(encoded), info.offset, length, info.sequence});
+        encoded = std::monostate{};
+        if (pending.size() >= MAX_PENDING_INDEX_ENTRIES) {
+            index->insertBatch(pending);
+            pending.clear();
+        }
+    }
+    index->insertBatch(pending);
+
+    indexColumns_.push_back({&it->first, index, &pendingEntries_[key]});
+    composites_.push_back(index);
+    compositeOrdinals_.insert(compositeOrdinals_.end(), ordinals.begin(), ordinals.end());
+    return index;
+}
+
+const ColumnCache* TableStore::getColumnCache(const std::string& columnName) const {
+    int col = tableDef_.getColumnIndex(columnName);
+    return col < 0 ? nullptr : columnCaches_[col].get();
+}
+
+void TableStore::enableZoneMap(const std::string& columnName) {
+    int col = tableDef_.getColumnIndex(columnName);
+    if (col < 0) {
+        throw std::runtime_error("Column not found: " + tableDef_.name + "." + columnName);
+    }
+    const ColumnDef& def = tableDef_.columns[col];
+    if (!ColumnCache::supports(def.type) || def.encrypted) {
+        throw std::runtime_error("Zone map requires an unencrypted numeric column: " + columnName);
+    }
+    if (!fieldExtractor_) {
+        throw std::runtime_error("Zone map requires a field extractor for table " + tableDef_.name);
+    }
+    if (zoneMaps_[col]) return;
+
+    zoneMaps_[col] = std::make_unique<ZoneMap>(def.type);
+    hasZoneMaps_ = true;
+    fillColumnCaches();
+}
+
+const ZoneMap* TableStore::getZoneMap(const std::string& columnName) const {
+    int col = tableDef_.getColumnIndex(columnName);
+    return col < 0 ? nullptr : zoneMaps_[col].get();
+}
+
+void TableStore::enableBloomFilter(const std::string& columnName) {
+    int col = tableDef_.getColumnIndex(columnName);
+    if (col < 0) {
+        throw std::runtime_error("Column not found: " + tableDef_.name + "." + columnName);
+    }
+    const ColumnDef& def = tableDef_.columns[col];
+    if (def.type != ValueType::String || def.encrypted) {
+        throw std::runtime_error("Bloom filter requires an unencrypted string column: " + columnName);
+    }
+    if (!fieldExtractor_) {
+        throw std::runtime_error("Bloom filter requires a field extractor for table " + tableDef_.name);
+    }
+    if (bloomFilters_[col]) return;
+
+    bloomFilters_[col] = std::make_unique<ZoneBloomFilter>();
+    hasZoneMaps_ = true;
+    fillColumnCaches();
+}
+
+void TableStore::fillColumnCaches() {
+    if ((!hasColumnCaches_ && !hasZoneMaps_) || !fieldExtractor_) return;
+
+    std::vector<Value> values;
+    for (size_t c = 0; c < columnCaches_.size(); c++) {
+        ColumnCache* cache = columnCaches_[c].get();
+        ZoneMap* zones = zoneMaps_[c].get();
+        ZoneBloomFilter* bloom = bloomFilters_[c].get();
+        if (!cache && !zones && !bloom) continue;
+        const std::string& name = tableDef_.columns[c].name;
+
+        // They may lag by different amounts (one enabled later); each
+        // record is extracted once for whichever needs it
+        auto filled = [&] {
+            return std::min({cache ? cache->size() : SIZE_MAX, zones ? zones->rows() : SIZE_MAX,
+                             bloom ? bloom->rows() : SIZE_MAX});
+        };
+
+        // Windows bound the staging buffer on large backfills
+        while (filled() < recordInfos_.size()) {
+            size_t begin = filled();
+            size_t cacheRows = cache ? cache->size() : SIZE_MAX;
+            size_t zoneRows = zones ? zones->rows() : SIZE_MAX;
+            size_t bloomRows = bloom ? bloom->rows() : SIZE_MAX;
+            values.resize(std::min(recordInfos_.size() - begin, MAX_PENDING_INDEX_ENTRIES));
+            auto extract = [&](size_t lo, size_t hi) {
+                for (size_t i = lo; i < hi; i++) {
+                    uint32_t length = 0;
+                    const auto& info = recordInfos_[begin + i];
+                    if (info.sequence <= storage_.getEvictedSequence()) {
+                        values[i] = std::monostate{};  // Evicted by retention
+                        continue;
+                    }
+                    const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+                    values[i] = fieldExtractor_(data, length, name);
+                }
+            };
+            if (workerPool_) {
+                workerPool_->parallelFor(values.size(), extract);
+            } else {
+                extract(0, values.size());
+            }
+            for (size_t i = 0; i < values.size(); i++) {
+                if (begin + i >= cacheRows) cache->append(values[i]);
+                if (begin + i >= zoneRows) zones->append(values[i]);
+                if (begin + i >= bloomRows) bloom->append(values[i]);
+            }
+        }
     }
 }
 
 std::vector<StoredRecord> TableStore::findByIndex(const std::string& column, const Value& value) {
     std::vector<StoredRecord> results;
 
+    IndexEntry current;
+    if (isUpsert() && column == upsertColumn_) {
+        if (findCurrent(value, current)) {
+            StoredRecord record;
+            record.offset = current.dataOffset;
+            record.header.sequence = current.sequence;
+            record.header.dataLength = current.dataLength;
+            results.push_back(std::move(record));
+        }
+        return results;
+    }
+
     auto it = indexes_.find(column);
-    if (it == indexes_.end()) {
-        // No index - fall back to scan
-        auto all = scanAll();
-        for (auto& record : all) {
-            if (fieldExtractor_) {
-                Value fieldValue = fieldExtractor_(record.data.data(), record.data.size(), column);
-                if (compareValues(fieldValue, value) == 0) {
-                    results.push_back(std::move(record));
-                }
-            }
+    if (it == indexes_.end() || backfilling(column)) {
+        // No index - fall back to scan, copying only the matches
+        for (const auto& ref : viewByRange(column, value, value)) {
+            results.push_back(storage_.readRecordAtOffset(ref.offset));
         }
         return results;
     }
@@ -79,18 +773,12 @@ std::vector<StoredRecord> TableStore::findByRange(const std::string& column,
                                                    const Value& minValue, const Value& maxValue) {
     std::vector<StoredRecord> results;
 
+    // Full-text indexes hold terms, not values, so ranges scan too
     auto it = indexes_.find(column);
-    if (it == indexes_.end()) {
-        // No index - fall back to scan
-        auto all = scanAll();
-        for (auto& record : all) {
-            if (fieldExtractor_) {
-                Value fieldValue = fieldExtractor_(record.data.data(), record.data.size(), column);
-                if (compareValues(fieldValue, minValue) >= 0 &&
-                    compareValues(fieldValue, maxValue) <= 0) {
-                    results.push_back(std::move(record));
-                }
-            }
+    if (it == indexes_.end() || fullTextColumn(column) || backfilling(column)) {
+        // No index - fall back to scan, copying only the matches
+        for (const auto& ref : viewByRange(column, minValue, maxValue)) {
+            results.push_back(storage_.readRecordAtOffset(ref.offset));
         }
         return results;
     }
@@ -114,18 +802,100 @@ std::vector<StoredRecord> TableStore::scanAll() {
     return results;
 }
 
+// Offsets and sequences of index entries, in index order
+static std::vector<RecordRange::RecordInfo> entryInfos(const std::vector<IndexEntry>& entries) {
+    std::vector<RecordRange::RecordInfo> hits;
+    hits.reserve(entries.size());
+    for (const auto& entry : entries) {
+        hits.push_back({entry.dataOffset, entry.sequence});
+    }
+    return hits;
+}
+
+bool TableStore::fullTextColumn(const std::string& column) const {
+    int c = tableDef_.getColumnIndex(column);
+    return c >= 0 && tableDef_.columns[c].fullText;
+}
+
+RecordRange TableStore::viewByIndex(const std::string& column, const Value& value) const {
+    return viewByRange(column, value, value);
+}
+
+RecordRange TableStore::viewByRange(const std::string& column, const Value& minValue,
+                                    const Value& maxValue) const {
+    auto it = indexes_.find(column);
+    if (it != indexes_.end() && !backfilling(column)) {
+        if (compareValues(minValue, maxValue) == 0) {
+            return RecordRange(&storage_, entryInfos(it->second->search(minValue)));
+        }
+        if (!fullTextColumn(column)) {
+            return RecordRange(&storage_, entryInfos(it->second->range(minValue, maxValue)));
+        }
+    }
+
+    // No index - keep the matches of a scan, compared in place
+    std::vector<RecordRange::RecordInfo> hits;
+    if (fieldExtractor_ || fieldViewExtractor_) {
+        ValueView minView = viewOf(minValue);
+        ValueView maxView = viewOf(maxValue);
+        Value scratch;
+        for (const auto& ref : viewAll()) {
+            ValueView field = fieldView(ref.data, ref.length, column, scratch);
+            if (compareValueViews(field, minView) >= 0 && compareValueViews(field, maxView) <= 0) {
+                hits.push_back({ref.offset, ref.sequence});
+            }
+        }
+    }
+    return RecordRange(&storage_, std::move(hits));
+}
+
+RecordRange TableStore::viewAll() const {
+    const auto* infos = storage_.getRecordInfoVector(fileId_);
+    if (!infos) return RecordRange();
+    // Evicted records are a prefix of the list
+    size_t first = StreamingFlatBufferStore::visibleCount(*infos, storage_.getEvictedSequence());
+    return RecordRange(&storage_, infos, first, infos->size());
+}
+
 std::vector<std::string> TableStore::getIndexNames() const {
     std::vector<std::string> names;
     for (const auto& [name, _] : indexes_) {
-        names.push_back(name);
+        if (!backfilling(name)) names.push_back(name);
     }
     return names;
 }
 
+TableMemory TableStore::getMemoryUsage(const DeletionBitmap* tombstones, bool pages) const {
+    TableMemory usage;
+    usage.tableName = tableDef_.name;
+    usage.recordInfoBytes = recordInfos_.capacityBytes();
+    for (const auto& [name, index] : indexes_) {
+        usage.indexBytes += index->memoryBytes();
+        if (pages) usage.indexPageBytes += index->pageBytes();
+    }
+    for (const auto& cache : columnCaches_) {
+        if (cache) usage.columnCacheBytes += cache->memoryBytes();
+    }
+    for (const auto& zoneMap : zoneMaps_) {
+        if (zoneMap) usage.zoneMapBytes += zoneMap->memoryBytes();
+    }
+    for (const auto& bloom : bloomFilters_) {
+        if (bloom) usage.zoneMapBytes += bloom->memoryBytes();
+    }
+    usage.tombstoneBytes = tombstones ? tombstones->memoryBytes() : 0;
+    usage.verificationBytes = verification_.memoryBytes();
+    return usage;
+}
+
 // ==================== FlatSQLDatabase ====================
 
-FlatSQLDatabase::FlatSQLDatabase(const DatabaseSchema& schema)
-    : schema_(schema) {
+FlatSQLDatabase::FlatSQLDatabase(const DatabaseSchema& schema, const StorageOptions& storageOptions,
+                                 IndexEngine indexEngine)
+    : FlatSQLDatabase(schema, storageOptions, indexEngine, false) {}
+
+FlatSQLDatabase::FlatSQLDatabase(const DatabaseSchema& schema, const StorageOptions& storageOptions,
+                                 IndexEngine indexEngine, bool schemaExtractors)
+    : schema_(schema), storageOptions_(storageOptions), storage_(storageOptions), indexEngine_(indexEngine) {
 
     // Initialize SQLite engine first (we need its db handle for indexes)
     sqliteEngine_ = std::make_unique<SQLiteEngine>();
@@ -133,13 +903,42 @@ FlatSQLDatabase::FlatSQLDatabase(const DatabaseSchema& schema)
     // Initialize table stores with SQLite db handle for indexes
     for (const auto& tableDef : schema_.tables) {
         tables_[tableDef.name] = std::make_unique<TableStore>(
-            tableDef, storage_, sqliteEngine_->getDb());
+            tableDef, storage_, sqliteEngine_->getDb(), indexEngine_);
+    }
+
+    if (schemaExtractors) {
+        useSchemaExtractors();
     }
 }
 
-FlatSQLDatabase FlatSQLDatabase::fromSchema(const std::string& source, const std::string& dbName) {
+FlatSQLDatabase FlatSQLDatabase::fromSchema(const std::string& source, const std::string& dbName,
+                                            const StorageOptions& storageOptions,
+                                            IndexEngine indexEngine) {
     DatabaseSchema schema = SchemaParser::parse(source, dbName);
-    return FlatSQLDatabase(schema);
+    return FlatSQLDatabase(schema, storageOptions, indexEngine, true);
+}
+
+FlatSQLDatabase FlatSQLDatabase::fromCompiledSchema(const uint8_t* compiled, size_t length,
+                                                    const StorageOptions& storageOptions,
+                                                    IndexEngine indexEngine) {
+    return FlatSQLDatabase(SchemaParser::load(compiled, length), storageOptions, indexEngine, true);
+}
+
+void FlatSQLDatabase::useSchemaExtractors() {
+    for (auto& [name, tableStore] : tables_) {
+        auto extractor = std::make_shared<const SchemaExtractor>(tableStore->getTableDef());
+        if (!extractor->empty()) {
+            tableStore->setSchemaExtractor(std::move(extractor));
+        }
+    }
+}
+
+FlatSQLDatabase::~FlatSQLDatabase() {
+    try {
+        sync();
+    } catch (...) {
+        // Best effort: a stale sidecar only costs a re-index on reopen
+    }
 }
 
 void FlatSQLDatabase::registerFileId(const std::string& fileId, const std::string& tableName) {
@@ -149,56 +948,337 @@ void FlatSQLDatabase::registerFileId(const std::string& fileId, const std::strin
     }
 
     fileIdToTable_[fileId] = tableName;
+    setFileIdRoute(fileIdRoutes_, fileId, it->second.get());
     it->second->setFileId(fileId);
 }
 
-void FlatSQLDatabase::onIngest(std::string_view fileId, const uint8_t* data, size_t length,
-                                uint64_t sequence, uint64_t offset) {
-    // Route to the correct table based on file identifier
-    std::string fileIdStr(fileId);
-    auto mapIt = fileIdToTable_.find(fileIdStr);
-    if (mapIt == fileIdToTable_.end()) {
-        // Unknown file identifier - skip (or could throw)
+void FlatSQLDatabase::setFileIdRoute(FileIdRoutes& routes, const std::string& fileId, TableStore* table) {
+    // Only 4-byte identifiers can come out of a record
+    if (fileId.size() != FILE_IDENTIFIER_LENGTH) {
         return;
     }
+    uint32_t key = StreamingFlatBufferStore::packFileId(fileId);
+    for (auto& route : routes) {
+        if (route.first == key) {
+            route.second = table;
+            return;
+        }
+    }
+    routes.emplace_back(key, table);
+}
 
-    auto tableIt = tables_.find(mapIt->second);
-    if (tableIt != tables_.end()) {
-        tableIt->second->onIngest(data, length, sequence, offset);
+TableStore* FlatSQLDatabase::routeFileId(const FileIdRoutes& routes, std::string_view fileId) {
+    if (fileId.size() != FILE_IDENTIFIER_LENGTH) {
+        return nullptr;
+    }
+    uint32_t key = StreamingFlatBufferStore::packFileId(fileId);
+    for (const auto& [routeKey, table] : routes) {
+        if (routeKey == key) {
+            return table;
+        }
     }
+    return nullptr;
 }
 
-size_t FlatSQLDatabase::ingest(const uint8_t* data, size_t length, size_t* recordsIngested) {
-    return storage_.ingest(data, length,
-        [this](std::string_view fileId, const uint8_t* data, size_t len,
-               uint64_t seq, uint64_t offset) {
-            onIngest(fileId, data, len, seq, offset);
-        }, recordsIngested);
+void FlatSQLDatabase::onIngest(std::string_view fileId, const uint8_t* data, size_t length,
+                                uint64_t sequence, uint64_t offset) {
+    // Route to the correct table based on file identifier; unknown
+    // identifiers are skipped
+    if (TableStore* table = routeFileId(fileIdRoutes_, fileId)) {
+        table->onIngest(data, length, sequence, offset);
+        if (table->isUpsert()) {
+            supersedeRecord(table, data, length, sequence, offset);
+        }
+        if (table->getSubscriptions()) {
+            matchSubscriptions(table, data, length, sequence, offset);
+        }
+    }
 }
 
-uint64_t FlatSQLDatabase::ingestOne(const uint8_t* flatbuffer, size_t length) {
-    return storage_.ingestFlatBuffer(flatbuffer, length,
-        [this](std::string_view fileId, const uint8_t* data, size_t len,
-               uint64_t seq, uint64_t offset) {
-            onIngest(fileId, data, len, seq, offset);
-        });
+void FlatSQLDatabase::beginIndexBatch() {
+    // Only open a transaction if the caller has not already done so
+    sqlite3* db = sqliteEngine_->getDb();
+    indexBatchOwnsTxn_ = sqlite3_get_autocommit(db) != 0;
+    if (indexBatchOwnsTxn_) {
+        sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    }
+    for (auto& [name, table] : tables_) {
+        table->beginIndexBatch();
+    }
+    // Readers only see the chunk once its index entries are in
+    storage_.setPublishDeferred(true);
 }
 
-void FlatSQLDatabase::loadAndRebuild(const uint8_t* data, size_t length) {
+void FlatSQLDatabase::finishIndexBatch() {
+    // Records are already in storage, so keep whatever indexed cleanly
+    // even if a flush throws
+    std::exception_ptr error;
+    for (auto& [name, table] : tables_) {
+        try {
+            table->flushIndexBatch();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (indexBatchOwnsTxn_) {
+        sqlite3_exec(sqliteEngine_->getDb(), "COMMIT", nullptr, nullptr, nullptr);
+        indexBatchOwnsTxn_ = false;
+    }
+    storage_.setPublishDeferred(false);
+    storage_.publish();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    deliverMatches();
+}
+
+class FlatSQLDatabase::IndexBatchScope {
+public:
+    explicit IndexBatchScope(FlatSQLDatabase& db) : db_(db) { db_.beginIndexBatch(); }
+
+    ~IndexBatchScope() {
+        if (!committed_) {
+            // Unwinding: still flush what was ingested before the failure
+            try {
+                db_.finishIndexBatch();
+            } catch (...) {
+            }
+        }
+    }
+
+    void commit() {
+        committed_ = true;
+        db_.finishIndexBatch();
+    }
+
+private:
+    FlatSQLDatabase& db_;
+    bool committed_ = false;
+};
+
+size_t FlatSQLDatabase::ingest(const uint8_t* data, size_t length, size_t* recordsIngested) {
+    requireUnauthenticatedIngest();
+    return ingestStream(data, length, recordsIngested);
+}
+
+uint64_t FlatSQLDatabase::ingestOne(const uint8_t* flatbuffer, size_t length) {
+    requireUnauthenticatedIngest();
+    return ingestSingle(flatbuffer, length);
+}
+
+uint8_t* FlatSQLDatabase::reserveIngest(size_t bytes) {
+    requireUnauthenticatedIngest();
+    if (strictVerification()) {
+        throw std::runtime_error("Strict verification is enabled: ingest through ingest()");
+    }
+    admitIngest(bytes);
+    return storage_.reserveIngest(bytes);
+}
+
+size_t FlatSQLDatabase::commitIngest(size_t bytes) {
+    requireUnauthenticatedIngest();
+    if (strictVerification()) {
+        throw std::runtime_error("Strict verification is enabled: ingest through ingest()");
+    }
+    IndexBatchScope batch(*this);
+    size_t records = storage_.commitIngest(bytes,
+        [this](std::string_view fileId, const uint8_t* data, size_t len,
+               uint64_t seq, uint64_t offset) {
+            onIngest(fileId, data, len, seq, offset);
+        });
+    batch.commit();
+    enforceMemoryLimits();
+    return records;
+}
+
+size_t FlatSQLDatabase::ingestStream(const uint8_t* data, size_t length, size_t* recordsIngested) {
+    admitIngest(length);
+    verifyIngest(data, length, true, &fileIdRoutes_);
+    IndexBatchScope batch(*this);
+    size_t consumed = storage_.ingest(data, length,
+        [this](std::string_view fileId, const uint8_t* data, size_t len,
+               uint64_t seq, uint64_t offset) {
+            onIngest(fileId, data, len, seq, offset);
+        }, recordsIngested);
+    batch.commit();
+    enforceMemoryLimits();
+    return consumed;
+}
+
+uint64_t FlatSQLDatabase::ingestSingle(const uint8_t* flatbuffer, size_t length) {
+    admitIngest(length);
+    verifyIngest(flatbuffer, length, false, &fileIdRoutes_);
+    uint64_t sequence = storage_.ingestFlatBuffer(flatbuffer, length,
+        [this](std::string_view fileId, const uint8_t* data, size_t len,
+               uint64_t seq, uint64_t offset) {
+            onIngest(fileId, data, len, seq, offset);
+        });
+    deliverMatches();
+    enforceMemoryLimits();
+    return sequence;
+}
+
+void FlatSQLDatabase::loadAndRebuild(const uint8_t* data, size_t length) {
+    IndexBatchScope batch(*this);
     storage_.loadAndRebuild(data, length,
         [this](std::string_view fileId, const uint8_t* data, size_t len,
                uint64_t seq, uint64_t offset) {
             onIngest(fileId, data, len, seq, offset);
         });
+    batch.commit();
+}
+
+// ==================== File-backed persistence ====================
+
+static void execSidecarSql(sqlite3* db, const std::string& sql) {
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string err = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Index sidecar error: " + err);
+    }
+}
+
+static void attachSidecar(sqlite3* db, const std::string& path) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "ATTACH DATABASE ? AS flatsql_sidecar", -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Index sidecar error: " + std::string(sqlite3_errmsg(db)));
+    }
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to attach index sidecar: " + path);
+    }
+}
+
+void FlatSQLDatabase::sync() {
+    storage_.sync();
+
+    const std::string& path = storage_.getMappedPath();
+    if (path.empty()) return;
+
+    // Write to a temporary file and swap it in so a crash never leaves a
+    // half-written sidecar behind
+    sqlite3* db = sqliteEngine_->getDb();
+    std::string idxPath = path + ".idx";
+    std::string tmpPath = idxPath + ".tmp";
+    std::remove(tmpPath.c_str());
+
+    sqliteEngine_->resetActiveStatements();
+    attachSidecar(db, tmpPath);
+    try {
+        execSidecarSql(db, "BEGIN");
+        execSidecarSql(db, "CREATE TABLE flatsql_sidecar._flatsql_meta (stream_length INTEGER NOT NULL)");
+        execSidecarSql(db, "INSERT INTO flatsql_sidecar._flatsql_meta VALUES (" +
+                           std::to_string(storage_.getWriteOffset()) + ")");
+        for (const auto& [tableName, tableStore] : tables_) {
+            for (const auto& indexName : tableStore->getIndexNames()) {
+                tableStore->getIndex(indexName)->saveTo(db, "flatsql_sidecar");
+            }
+        }
+        execSidecarSql(db, "COMMIT");
+    } catch (...) {
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        sqlite3_exec(db, "DETACH DATABASE flatsql_sidecar", nullptr, nullptr, nullptr);
+        std::remove(tmpPath.c_str());
+        throw;
+    }
+    execSidecarSql(db, "DETACH DATABASE flatsql_sidecar");
+
+    if (std::rename(tmpPath.c_str(), idxPath.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("Failed to write index sidecar: " + idxPath);
+    }
+}
+
+uint64_t FlatSQLDatabase::loadIndexSidecar() {
+    const std::string& path = storage_.getMappedPath();
+    uint64_t restored = storage_.getRestoredLength();
+    if (path.empty() || restored == 0) return 0;
+
+    std::string idxPath = path + ".idx";
+    FILE* probe = std::fopen(idxPath.c_str(), "rb");
+    if (!probe) return 0;
+    std::fclose(probe);
+
+    sqlite3* db = sqliteEngine_->getDb();
+    sqliteEngine_->resetActiveStatements();
+    attachSidecar(db, idxPath);
+
+    // The index sidecar must describe exactly the stream prefix the storage
+    // sidecar restored, otherwise offsets could point at unindexed records
+    bool ok = false;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT stream_length FROM flatsql_sidecar._flatsql_meta",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        ok = sqlite3_step(stmt) == SQLITE_ROW &&
+             static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)) == restored;
+    }
+    sqlite3_finalize(stmt);
+
+    if (ok) {
+        try {
+            execSidecarSql(db, "SAVEPOINT flatsql_reopen");
+            for (const auto& [tableName, tableStore] : tables_) {
+                for (const auto& indexName : tableStore->getIndexNames()) {
+                    tableStore->getIndex(indexName)->loadFrom(db, "flatsql_sidecar");
+                }
+            }
+            execSidecarSql(db, "RELEASE flatsql_reopen");
+        } catch (const std::exception&) {
+            // Schema changed since the sidecar was written - rebuild instead
+            sqlite3_exec(db, "ROLLBACK TO flatsql_reopen", nullptr, nullptr, nullptr);
+            sqlite3_exec(db, "RELEASE flatsql_reopen", nullptr, nullptr, nullptr);
+            for (const auto& [tableName, tableStore] : tables_) {
+                for (const auto& indexName : tableStore->getIndexNames()) {
+                    tableStore->getIndex(indexName)->clear();
+                }
+            }
+            ok = false;
+        }
+    }
+
+    execSidecarSql(db, "DETACH DATABASE flatsql_sidecar");
+    return ok ? restored : 0;
+}
+
+bool FlatSQLDatabase::reopen() {
+    uint64_t indexedLength = loadIndexSidecar();
+
+    // Records covered by the sidecar only need their per-table tracking back
+    if (indexedLength > 0) {
+        for (const auto& [fileId, tableName] : fileIdToTable_) {
+            const auto* infos = storage_.getRecordInfoVector(fileId);
+            auto tableIt = tables_.find(tableName);
+            if (infos && tableIt != tables_.end()) {
+                tableIt->second->restoreRecords(*infos, indexedLength);
+            }
+        }
+    }
+
+    // Everything after the sidecar goes through the normal ingest path
+    IndexBatchScope batch(*this);
+    storage_.replayFrom(indexedLength,
+        [this](std::string_view fileId, const uint8_t* data, size_t len,
+               uint64_t seq, uint64_t offset) {
+            onIngest(fileId, data, len, seq, offset);
+        });
+    batch.commit();
+
+    return indexedLength > 0;
 }
 
 void FlatSQLDatabase::initializeSQLiteEngine() {
     if (sqliteInitialized_) return;
 
     // Register all tables that have file IDs registered
-    // Tables without extractors will return NULL for field values
+    // Tables without extractors will return NULL for field values.
+    // A unified view created before the first query replaces its base table.
+    const auto views = sqliteEngine_->getUnifiedViews();
     for (const auto& [tableName, tableStore] : tables_) {
-        if (!tableStore->getFileId().empty()) {
+        if (!tableStore->getFileId().empty() && !views.count(tableName)) {
             updateSQLiteTable(tableName);
         }
     }
@@ -219,16 +1299,24 @@ void FlatSQLDatabase::updateSQLiteTable(const std::string& tableName) {
         return;
     }
 
-    // Build index map (SqliteIndex* pointers)
-    std::unordered_map<std::string, SqliteIndex*> indexes;
+    // Build index map (Index* pointers)
+    std::unordered_map<std::string, Index*> indexes;
+    // Every column index, including those added since (TableStore::addIndex)
     for (const auto& col : tableStore->getTableDef().columns) {
-        if (col.indexed || col.primaryKey) {
-            SqliteIndex* index = tableStore->getIndex(col.name);
-            if (index) {
-                indexes[col.name] = index;
+        Index* index = tableStore->getIndex(col.name);
+        if (index) {
+            indexes[col.fullText ? fullTextIndexKey(col.name) : col.name] = index;
+            if (col.trigram) {
+                indexes[trigramIndexKey(col.name)] = index;
             }
         }
     }
+    if (Index* geo = tableStore->getIndex(GEO_COLUMN)) {
+        indexes[GEO_COLUMN] = geo;
+    }
+    for (CompositeIndex* composite : tableStore->getCompositeIndexes()) {
+        indexes[compositeIndexKey(composite->getIndexName())] = composite;
+    }
 
     // Register with SQLite engine
     // Pass source-specific record infos for multi-source routing
@@ -241,18 +1329,17 @@ void FlatSQLDatabase::updateSQLiteTable(const std::string& tableName) {
         indexes,
         tableStore->getFastFieldExtractor(),
         tableStore->getBatchExtractor(),
-        &tableStore->getRecordInfos()
+        &tableStore->getRecordInfos(),
+        // Cache slots are fixed per table, so columns enabled later show up too
+        &tableStore->getColumnCaches(),
+        tableStore->getSchemaExtractor().get(),
+        &tableStore->getZoneMaps(),
+        &tableStore->getBloomFilters(),
+        // Before the virtual table is created, which derives its field keys
+        encryptionCtx_.get(),
+        &tableStore->getVerification()
     );
 
-    // Propagate encryption context to the registered source
-    if (encryptionCtx_) {
-        auto* sourceInfo = sqliteEngine_->getSource(tableName);
-        if (sourceInfo) {
-            sourceInfo->encryptionCtx = encryptionCtx_.get();
-            sourceInfo->vtabInfo.encryptionCtx = encryptionCtx_.get();
-        }
-    }
-
     sqliteRegisteredTables_.insert(tableName);
 }
 
@@ -284,6 +1371,61 @@ QueryResult FlatSQLDatabase::query(const std::string& sql, int64_t param) {
     return sqliteEngine_->execute(sql, singleParam);
 }
 
+void FlatSQLDatabase::query(const std::string& sql, const std::vector<Value>& params, ArenaQueryResult& out) {
+    initializeSQLiteEngine();
+    sqliteEngine_->execute(sql, params, out);
+}
+
+std::unique_ptr<ReadSession> FlatSQLDatabase::openReadSession() {
+    if (storage_.getStorageMode() == StorageMode::Contiguous) {
+        throw std::runtime_error("Read sessions require Segmented or MappedFile storage");
+    }
+    initializeSQLiteEngine();
+
+    std::unique_ptr<ReadSession> session(new ReadSession());
+    SQLiteEngine& reader = *session->engine_;
+    for (const auto& name : sqliteEngine_->listSources()) {
+        reader.registerSharedSource(*sqliteEngine_->getSource(name));
+    }
+
+    // Unified views are virtual tables over the shared sources; any SQL
+    // views may sit on top of them, so recreate those afterwards
+    for (const auto& [viewName, sourceNames] : sqliteEngine_->getUnifiedViews()) {
+        reader.createUnifiedView(viewName, sourceNames);
+    }
+    QueryResult views = sqliteEngine_->execute(
+        "SELECT sql FROM sqlite_master WHERE type = 'view' AND sql IS NOT NULL");
+    for (const auto& row : views.rows) {
+        reader.execute(std::get<std::string>(row[0]));
+    }
+    return session;
+}
+
+QueryResult ReadSession::query(const std::string& sql) {
+    return engine_->execute(sql);
+}
+
+QueryResult ReadSession::query(const std::string& sql, const std::vector<Value>& params) {
+    return engine_->execute(sql, params);
+}
+
+std::unique_ptr<QueryCursor> ReadSession::openCursor(const std::string& sql,
+                                                    const std::vector<Value>& params) {
+    return engine_->openCursor(sql, params);
+}
+
+std::unique_ptr<QueryCursor> FlatSQLDatabase::openCursor(const std::string& sql,
+                                                        const std::vector<Value>& params) {
+    initializeSQLiteEngine();
+    return sqliteEngine_->openCursor(sql, params);
+}
+
+PreparedLookup FlatSQLDatabase::prepareLookup(const std::string& tableName,
+                                              const std::string& columnName) {
+    initializeSQLiteEngine();
+    return sqliteEngine_->prepareLookup(tableName, columnName);
+}
+
 size_t FlatSQLDatabase::queryCount(const std::string& sql, const std::vector<Value>& params) {
     // Ensure SQLite engine is initialized
     initializeSQLiteEngine();
@@ -302,6 +1444,23 @@ std::vector<StoredRecord> FlatSQLDatabase::findByIndex(const std::string& tableN
     return it->second->findByIndex(column, value);
 }
 
+RecordRange FlatSQLDatabase::viewByIndex(const std::string& tableName, const std::string& column,
+                                         const Value& value) const {
+    auto it = tables_.find(tableName);
+    return it != tables_.end() ? it->second->viewByIndex(column, value) : RecordRange();
+}
+
+RecordRange FlatSQLDatabase::viewByRange(const std::string& tableName, const std::string& column,
+                                         const Value& minValue, const Value& maxValue) const {
+    auto it = tables_.find(tableName);
+    return it != tables_.end() ? it->second->viewByRange(column, minValue, maxValue) : RecordRange();
+}
+
+RecordRange FlatSQLDatabase::viewAll(const std::string& tableName) const {
+    auto it = tables_.find(tableName);
+    return it != tables_.end() ? it->second->viewAll() : RecordRange();
+}
+
 bool FlatSQLDatabase::findOneByIndex(const std::string& tableName,
                                       const std::string& column,
                                       const Value& value,
@@ -311,13 +1470,17 @@ bool FlatSQLDatabase::findOneByIndex(const std::string& tableName,
         return false;
     }
 
-    SqliteIndex* index = it->second->getIndex(column);
-    if (!index) {
+    // An upsert table's key resolves to its current version, not the
+    // first one the index holds
+    TableStore* table = it->second.get();
+    bool upsertKey = table->isUpsert() && column == table->getUpsertColumn();
+    Index* index = table->getIndex(column);
+    if (!index && !upsertKey) {
         return false;
     }
 
     IndexEntry entry;
-    if (index->searchFirst(value, entry)) {
+    if (upsertKey ? table->findCurrent(value, entry) : index->searchFirst(value, entry)) {
         // Minimal record info - avoid data copy
         result.offset = entry.dataOffset;
         result.header.dataLength = entry.dataLength;
@@ -330,6 +1493,31 @@ bool FlatSQLDatabase::findOneByIndex(const std::string& tableName,
     return false;
 }
 
+IndexStats FlatSQLDatabase::getIndexStats(const std::string& tableName,
+                                          const std::string& column) const {
+    auto it = tables_.find(tableName);
+    Index* index = it != tables_.end() ? it->second->getIndex(column) : nullptr;
+    if (!index) {
+        throw std::runtime_error("No index on " + tableName + "." + column);
+    }
+    return index->getStats();
+}
+
+std::vector<IndexEntry> FlatSQLDatabase::findManyByIndex(const std::string& tableName,
+                                                         const std::string& column,
+                                                         std::vector<Value> keys) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        return {};
+    }
+
+    Index* index = it->second->getIndex(column);
+    if (!index) {
+        return {};
+    }
+    return index->searchMany(std::move(keys));
+}
+
 const uint8_t* FlatSQLDatabase::findRawByIndex(const std::string& tableName,
                                                 const std::string& column,
                                                 const Value& value,
@@ -340,7 +1528,17 @@ const uint8_t* FlatSQLDatabase::findRawByIndex(const std::string& tableName,
         return nullptr;
     }
 
-    SqliteIndex* index = it->second->getIndex(column);
+    TableStore* table = it->second.get();
+    if (table->isUpsert() && column == table->getUpsertColumn()) {
+        IndexEntry entry;
+        if (!table->findCurrent(value, entry)) return nullptr;
+        if (outSequence) {
+            *outSequence = entry.sequence;
+        }
+        return storage_.getDataAtOffset(entry.dataOffset, outLength);
+    }
+
+    Index* index = table->getIndex(column);
     if (!index) {
         return nullptr;
     }
@@ -383,6 +1581,239 @@ const uint8_t* FlatSQLDatabase::findRawByIndex(const std::string& tableName,
     return nullptr;
 }
 
+void FlatSQLDatabase::enableColumnCache(const std::string& tableName, const std::string& columnName) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    it->second->enableColumnCache(columnName);
+}
+
+void FlatSQLDatabase::enableZoneMap(const std::string& tableName, const std::string& columnName) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    it->second->enableZoneMap(columnName);
+}
+
+void FlatSQLDatabase::enableBloomFilter(const std::string& tableName, const std::string& columnName) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    it->second->enableBloomFilter(columnName);
+}
+
+void FlatSQLDatabase::setIngestThreads(size_t threads) {
+    std::unique_ptr<WorkerPool> pool;
+    if (threads != 1) {
+        pool = std::make_unique<WorkerPool>(threads);
+        if (pool->size() == 1) pool.reset();  // No thread support
+    }
+    for (auto& [name, table] : tables_) {
+        table->setWorkerPool(pool.get());
+    }
+    ingestPool_ = std::move(pool);
+}
+
+void FlatSQLDatabase::setScanThreads(size_t threads) {
+    std::unique_ptr<WorkerPool> pool;
+    if (threads != 1) {
+        pool = std::make_unique<WorkerPool>(threads);
+        if (pool->size() == 1) pool.reset();  // No thread support
+    }
+    scanPool_ = std::move(pool);
+}
+
+void FlatSQLDatabase::createMaterializedAggregate(const std::string& name, const std::string& tableName,
+                                                  const MaterializedAggregateDef& def) {
+    initializeSQLiteEngine();
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (tables_.count(name) || sqliteEngine_->hasSource(name) || sqliteEngine_->getUnifiedViews().count(name)) {
+        throw std::runtime_error("Table name already in use: " + name);
+    }
+
+    TableStore* table = it->second.get();
+    MaterializedAggregate& aggregate =
+        table->addMaterializedAggregate(name, def, sqliteEngine_->getTombstones(tableName));
+    sqliteEngine_->createAggregateTable(name, {&aggregate, [this, table, tableName, &aggregate] {
+        table->refreshAggregate(aggregate, sqliteEngine_->getTombstones(tableName));
+    }, tableName});
+}
+
+void FlatSQLDatabase::createJunctionTable(JunctionManager& junctions, const JunctionTable& junction) {
+    initializeSQLiteEngine();
+    const std::string& name = junction.name;
+    if (tables_.count(name) || sqliteEngine_->hasSource(name) || sqliteEngine_->getUnifiedViews().count(name)) {
+        throw std::runtime_error("Table name already in use: " + name);
+    }
+
+    JunctionVTabInfo info{&junctions, name, nullptr, nullptr};
+    bool unionField = junction.relationType == RelationType::UNION ||
+                      junction.relationType == RelationType::VECTOR_UNION;
+    auto child = tables_.find(junction.childTable);
+    if (!unionField && child != tables_.end() && child->second->getFieldExtractor()) {
+        info.childDef = &child->second->getTableDef();
+        info.extractor = child->second->getFieldExtractor();
+    }
+    sqliteEngine_->createJunctionTable(name, info);
+}
+
+void FlatSQLDatabase::detachJunctions(JunctionManager* junctions) {
+    junctionManagers_.erase(std::remove(junctionManagers_.begin(), junctionManagers_.end(), junctions),
+                            junctionManagers_.end());
+}
+
+// Rows per aggregate() task: enough to amortize merging its partial
+// groups, few enough that sources of different sizes balance across workers
+static constexpr size_t AGGREGATE_RANGE_ROWS = 16 * 1024;
+
+QueryResult FlatSQLDatabase::aggregate(const std::string& tableName,
+                                       const std::vector<AggregateSpec>& aggregates,
+                                       const std::string& groupBy) {
+    AggregateGroups groups = aggregateGroups(tableName, aggregates, groupBy);
+    return aggregateResult(groups, aggregates, groupBy);
+}
+
+AggregateGroups FlatSQLDatabase::aggregateGroups(const std::string& tableName,
+                                                 const std::vector<AggregateSpec>& aggregates,
+                                                 const std::string& groupBy) {
+    initializeSQLiteEngine();
+
+    // A unified view scans its member tables, anything else the table itself
+    std::vector<std::string> names{tableName};
+    auto views = sqliteEngine_->getUnifiedViews();
+    auto viewIt = views.find(tableName);
+    if (viewIt != views.end()) {
+        names = viewIt->second;
+    }
+
+    // Where a task reads each column: its cache, else the FlatBuffer
+    struct ColumnSource {
+        const ColumnCache* cache;
+        const std::string* name;  // nullptr for COUNT(*)
+    };
+    struct Member {
+        const TableStore* table;
+        const DeletionBitmap* tombstones;
+        TableStore::FieldExtractor extractor;
+        std::vector<ColumnSource> columns;  // One per aggregate, then the group column
+    };
+    std::vector<Member> members;
+    for (const auto& name : names) {
+        auto it = tables_.find(name);
+        if (it == tables_.end()) {
+            throw std::runtime_error("Table not found: " + name);
+        }
+        const TableStore& table = *it->second;
+        const TableDef& def = table.getTableDef();
+        Member member{&table, sqliteEngine_->getTombstones(name), table.getFieldExtractor(), {}};
+
+        auto addColumn = [&](const std::string& column, bool numeric) {
+            int col = def.getColumnIndex(column);
+            if (col < 0) {
+                throw std::runtime_error("Column not found: " + tableName + "." + column);
+            }
+            const ColumnDef& colDef = def.columns[col];
+            if (colDef.encrypted) {
+                throw std::runtime_error("Cannot aggregate encrypted column: " + column);
+            }
+            if (numeric && !ColumnCache::supports(colDef.type)) {
+                throw std::runtime_error("SUM, AVG and APPROX_PERCENTILE require a numeric column: " + column);
+            }
+            member.columns.push_back({table.getColumnCache(column), &colDef.name});
+        };
+        for (const auto& spec : aggregates) {
+            if (spec.column.empty()) {
+                if (spec.op != AggregateSpec::Op::Count) {
+                    throw std::runtime_error("Only COUNT takes no column");
+                }
+                member.columns.push_back({nullptr, nullptr});
+                continue;
+            }
+            addColumn(spec.column, spec.op == AggregateSpec::Op::Sum || spec.op == AggregateSpec::Op::Avg ||
+                                       spec.op == AggregateSpec::Op::ApproxPercentile);
+        }
+        if (!groupBy.empty()) {
+            addColumn(groupBy, false);
+        }
+        members.push_back(std::move(member));
+    }
+
+    struct Range {
+        size_t member;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Range> ranges;
+    const uint64_t asOf = sqliteEngine_->getAsOfSequence();
+    for (size_t m = 0; m < members.size(); m++) {
+        const auto& infos = members[m].table->getRecordInfos();
+        size_t rows = asOf ? StreamingFlatBufferStore::visibleCount(infos, asOf) : infos.size();
+        for (size_t begin = 0; begin < rows; begin += AGGREGATE_RANGE_ROWS) {
+            ranges.push_back({m, begin, std::min(rows, begin + AGGREGATE_RANGE_ROWS)});
+        }
+    }
+
+    // Each range aggregates into its own groups; no state is shared
+    std::vector<AggregateGroups> partials(ranges.size());
+    auto scan = [&](size_t lo, size_t hi) {
+        std::vector<Value> values(aggregates.size() + 1);
+        for (size_t r = lo; r < hi; r++) {
+            const Range& range = ranges[r];
+            const Member& member = members[range.member];
+            const auto& infos = member.table->getRecordInfos();
+            AggregateGroups& groups = partials[r];
+            AggregateState* state = nullptr;  // Without GROUP BY, the only group
+
+            for (size_t row = range.begin; row < range.end; row++) {
+                const auto& info = infos[row];
+                if (member.tombstones && member.tombstones->contains(info.sequence)) continue;
+
+                const uint8_t* data = nullptr;
+                uint32_t length = 0;
+                for (size_t c = 0; c < member.columns.size(); c++) {
+                    const ColumnSource& column = member.columns[c];
+                    if (!column.name) continue;
+                    if (column.cache && row < column.cache->size()) {
+                        values[c] = column.cache->getValue(row);
+                    } else if (member.extractor) {
+                        if (!data) data = storage_.getDataAtOffset(info.offset, &length);
+                        values[c] = member.extractor(data, length, *column.name);
+                    } else {
+                        values[c] = std::monostate{};
+                    }
+                }
+
+                if (!groupBy.empty() || !state) {
+                    Value key = groupBy.empty() ? Value() : values[aggregates.size()];
+                    auto it = groups.find(key);
+                    if (it == groups.end()) {
+                        it = groups.emplace(std::move(key), AggregateState(&aggregates)).first;
+                    }
+                    state = &it->second;
+                }
+                state->add(values.data());
+            }
+        }
+    };
+    if (scanPool_) {
+        scanPool_->parallelFor(ranges.size(), scan, 1);
+    } else {
+        scan(0, ranges.size());
+    }
+
+    AggregateGroups groups;
+    for (auto& partial : partials) {
+        mergeAggregateGroups(groups, std::move(partial));
+    }
+    return groups;
+}
+
 void FlatSQLDatabase::setFieldExtractor(const std::string& tableName, TableStore::FieldExtractor extractor) {
     auto it = tables_.find(tableName);
     if (it == tables_.end()) {
@@ -425,6 +1856,25 @@ void FlatSQLDatabase::setBatchExtractor(const std::string& tableName, TableStore
     }
 }
 
+void FlatSQLDatabase::setFieldViewExtractor(const std::string& tableName,
+                                            TableStore::FieldViewExtractor extractor) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+
+    it->second->setFieldViewExtractor(std::move(extractor));
+}
+
+void FlatSQLDatabase::setKeyExtractor(const std::string& tableName, TableStore::KeyExtractor extractor) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+
+    it->second->setKeyExtractor(extractor);
+}
+
 std::vector<std::string> FlatSQLDatabase::listTables() const {
     std::vector<std::string> names;
     for (const auto& [name, _] : tables_) {
@@ -449,11 +1899,85 @@ std::vector<FlatSQLDatabase::TableStats> FlatSQLDatabase::getStats() const {
         ts.fileId = store->getFileId();
         ts.recordCount = store->getRecordCount();
         ts.indexes = store->getIndexNames();
+        ts.memoryBytes = store->getMemoryUsage(sqliteEngine_->getTombstones(name), false).total();
         stats.push_back(ts);
     }
     return stats;
 }
 
+MemoryUsage FlatSQLDatabase::getMemoryUsage() const {
+    MemoryUsage usage;
+    usage.storage = storage_.getMemoryUsage();
+    for (const auto& [name, store] : tables_) {
+        usage.tables.push_back(store->getMemoryUsage(sqliteEngine_->getTombstones(name)));
+    }
+    usage.engine = sqliteEngine_->getMemoryUsage();
+    return usage;
+}
+
+void FlatSQLDatabase::setMemoryLimits(const MemoryLimits& limits) {
+    memoryLimits_ = limits;
+    memoryLimitStats_ = MemoryLimitStats();
+    measureFootprint();
+    memoryOverSoft_ = false;  // The next ingest call acts on the soft limit
+}
+
+uint64_t FlatSQLDatabase::measureFootprint() {
+    uint64_t bytes = storage_.getMemoryUsage().total() + sqliteEngine_->getMemoryUsage().total();
+    for (const auto& [name, store] : tables_) {
+        bytes += store->getMemoryUsage(sqliteEngine_->getTombstones(name), false).total();
+    }
+    memoryLimitStats_.footprint = bytes;
+    memoryCheckedAt_ = storage_.getDataSize();
+    memoryOverSoft_ = memoryLimits_.softBytes && bytes > memoryLimits_.softBytes;
+    return bytes;
+}
+
+void FlatSQLDatabase::admitIngest(size_t bytes) {
+    uint64_t hard = memoryLimits_.hardBytes;
+    if (!hard) return;
+    uint64_t size = storage_.getDataSize();
+    uint64_t growth = size > memoryCheckedAt_ ? size - memoryCheckedAt_ : 0;
+    if (memoryLimitStats_.footprint + growth + bytes <= hard) return;
+
+    // Near the limit: measure, and release caches before refusing
+    if (measureFootprint() + bytes > hard) {
+        sqliteEngine_->releaseMemory();
+        storage_.clearColdCache();
+        if (measureFootprint() + bytes > hard) {
+            memoryLimitStats_.rejections++;
+            throw std::runtime_error("Memory limit exceeded: " + std::to_string(memoryLimitStats_.footprint) +
+                                     " bytes in use, " + std::to_string(bytes) + " more would pass the limit of " +
+                                     std::to_string(hard));
+        }
+    }
+}
+
+void FlatSQLDatabase::enforceMemoryLimits() {
+    uint64_t soft = memoryLimits_.softBytes;
+    if (!soft) return;
+    uint64_t size = storage_.getDataSize();
+    uint64_t growth = size > memoryCheckedAt_ ? size - memoryCheckedAt_ : 0;
+    bool crossing = !memoryOverSoft_ && memoryLimitStats_.footprint + growth > soft;
+    if (growth < MEMORY_CHECK_BYTES && !crossing) return;
+    if (measureFootprint() <= soft) return;
+
+    sqliteEngine_->releaseMemory();
+    storage_.clearColdCache();
+    memoryLimitStats_.reliefs++;
+    if (measureFootprint() <= soft || !memoryLimits_.compactOverSoft) return;
+
+    bool deleted = false;
+    for (const auto& [name, store] : tables_) {
+        deleted = deleted || sqliteEngine_->getDeletedCount(name) > 0;
+    }
+    if (deleted) {
+        compact();
+        memoryLimitStats_.compactions++;
+        measureFootprint();
+    }
+}
+
 // ==================== Multi-Source API ====================
 
 void FlatSQLDatabase::registerSource(const std::string& sourceName) {
@@ -481,23 +2005,28 @@ void FlatSQLDatabase::createSourceTable(const std::string& baseTableName, const
         return;
     }
 
-    // Get base table def
-    const TableDef& baseDef = baseIt->second->getTableDef();
+    // Same schema under the source table's name, so its SQLite index tables
+    // don't collide with the base table's or other sources'
+    TableDef sourceDef = baseIt->second->getTableDef();
+    sourceDef.name = sourceTableName;
 
-    // Create source table with same schema (share the same sqlite db for indexes)
+    // Create source table (share the same sqlite db for indexes)
     tables_[sourceTableName] = std::make_unique<TableStore>(
-        baseDef, storage_, sqliteEngine_->getDb());
+        sourceDef, storage_, sqliteEngine_->getDb(), indexEngine_);
+    tables_[sourceTableName]->setWorkerPool(ingestPool_.get());
+    tables_[sourceTableName]->getVerification().setMode(baseIt->second->getVerification().getMode());
 
     // Copy file ID registration for source-specific routing
     std::string fileId = baseIt->second->getFileId();
     if (!fileId.empty()) {
-        std::string sourceKey = source + ":" + fileId;
-        sourceFileIdToTable_[sourceKey] = sourceTableName;
+        setFileIdRoute(sourceFileIdRoutes_[source], fileId, tables_[sourceTableName].get());
         tables_[sourceTableName]->setFileId(fileId);
 
         // Copy field extractor from base table
         auto extractor = baseIt->second->getFieldExtractor();
-        if (extractor) {
+        if (auto schemaExtractor = baseIt->second->getSchemaExtractor()) {
+            tables_[sourceTableName]->setSchemaExtractor(schemaExtractor);
+        } else if (extractor) {
             tables_[sourceTableName]->setFieldExtractor(extractor);
         }
 
@@ -510,6 +2039,11 @@ void FlatSQLDatabase::createSourceTable(const std::string& baseTableName, const
         if (batchExtractor) {
             tables_[sourceTableName]->setBatchExtractor(batchExtractor);
         }
+
+        auto keyExtractor = baseIt->second->getKeyExtractor();
+        if (keyExtractor) {
+            tables_[sourceTableName]->setKeyExtractor(keyExtractor);
+        }
     }
 }
 
@@ -541,43 +2075,341 @@ void FlatSQLDatabase::createUnifiedViews() {
     }
 }
 
+const FlatSQLDatabase::FileIdRoutes* FlatSQLDatabase::sourceRoutes(const std::string& source) const {
+    auto it = sourceFileIdRoutes_.find(source);
+    return it != sourceFileIdRoutes_.end() ? &it->second : nullptr;
+}
+
 void FlatSQLDatabase::onIngestWithSource(std::string_view fileId, const uint8_t* data, size_t length,
-                                          uint64_t sequence, uint64_t offset, const std::string& source) {
-    // Route to source-specific table
-    std::string sourceKey = source + ":" + std::string(fileId);
-    auto mapIt = sourceFileIdToTable_.find(sourceKey);
-    if (mapIt == sourceFileIdToTable_.end()) {
-        // Unknown source:fileId combination - skip
+                                          uint64_t sequence, uint64_t offset, const FileIdRoutes* routes) {
+    // Route to source-specific table; unknown source:fileId combinations are skipped
+    if (!routes) {
         return;
     }
-
-    auto tableIt = tables_.find(mapIt->second);
-    if (tableIt != tables_.end()) {
-        tableIt->second->onIngest(data, length, sequence, offset);
+    if (TableStore* table = routeFileId(*routes, fileId)) {
+        table->onIngest(data, length, sequence, offset);
+        if (table->isUpsert()) {
+            supersedeRecord(table, data, length, sequence, offset);
+        }
+        if (table->getSubscriptions()) {
+            matchSubscriptions(table, data, length, sequence, offset);
+        }
     }
 }
 
 size_t FlatSQLDatabase::ingestWithSource(const uint8_t* data, size_t length,
                                           const std::string& source,
                                           size_t* recordsIngested) {
-    return storage_.ingest(data, length,
-        [this, &source](std::string_view fileId, const uint8_t* data, size_t len,
+    requireUnauthenticatedIngest();
+    admitIngest(length);
+    const FileIdRoutes* routes = sourceRoutes(source);
+    verifyIngest(data, length, true, routes);
+    IndexBatchScope batch(*this);
+    size_t consumed = storage_.ingest(data, length,
+        [this, routes](std::string_view fileId, const uint8_t* data, size_t len,
                uint64_t seq, uint64_t offset) {
-            onIngestWithSource(fileId, data, len, seq, offset, source);
+            onIngestWithSource(fileId, data, len, seq, offset, routes);
         }, recordsIngested);
+    batch.commit();
+    enforceMemoryLimits();
+    return consumed;
 }
 
 uint64_t FlatSQLDatabase::ingestOneWithSource(const uint8_t* flatbuffer, size_t length,
                                                const std::string& source) {
-    return storage_.ingestFlatBuffer(flatbuffer, length,
-        [this, &source](std::string_view fileId, const uint8_t* data, size_t len,
+    requireUnauthenticatedIngest();
+    admitIngest(length);
+    const FileIdRoutes* routes = sourceRoutes(source);
+    verifyIngest(flatbuffer, length, false, routes);
+    uint64_t sequence = storage_.ingestFlatBuffer(flatbuffer, length,
+        [this, routes](std::string_view fileId, const uint8_t* data, size_t len,
                uint64_t seq, uint64_t offset) {
-            onIngestWithSource(fileId, data, len, seq, offset, source);
+            onIngestWithSource(fileId, data, len, seq, offset, routes);
         });
+    deliverMatches();
+    enforceMemoryLimits();
+    return sequence;
 }
 
-// Legacy multi-source API (external storage)
-void FlatSQLDatabase::registerExternalSource(
+// ==================== Subscriptions ====================
+
+SubscriptionSet& TableStore::subscriptions() {
+    if (!subscriptions_) {
+        subscriptions_ = std::make_unique<SubscriptionSet>();
+    }
+    return *subscriptions_;
+}
+
+MaterializedAggregate& TableStore::addMaterializedAggregate(const std::string& name,
+                                                            const MaterializedAggregateDef& def,
+                                                            const DeletionBitmap* tombstones) {
+    if (!fieldExtractor_) {
+        throw std::runtime_error("Materialized aggregate requires a field extractor for table " + tableDef_.name);
+    }
+    auto aggregate = std::make_unique<MaterializedAggregate>(name, tableDef_, def);
+    scanLive(tombstones, [&](const uint8_t* data, size_t length, uint64_t sequence) {
+        aggregate->add(data, length, sequence, fieldExtractor_);
+    });
+    aggregates_.push_back(std::move(aggregate));
+    return *aggregates_.back();
+}
+
+void TableStore::onDelete(uint64_t sequence) {
+    if (aggregates_.empty() || !fieldExtractor_) return;
+
+    // Only this table's records were counted
+    size_t row = StreamingFlatBufferStore::visibleCount(recordInfos_, sequence);
+    if (row == 0 || recordInfos_[row - 1].sequence != sequence) return;
+    uint32_t length = 0;
+    const uint8_t* data = storage_.getDataAtOffset(recordInfos_[row - 1].offset, &length);
+    if (!data) return;
+    for (auto& aggregate : aggregates_) {
+        aggregate->remove(data, length, sequence, fieldExtractor_);
+    }
+}
+
+void TableStore::refreshAggregate(MaterializedAggregate& aggregate, const DeletionBitmap* tombstones) {
+    aggregate.refresh([&](const MaterializedAggregate::RecordVisitor& visit) { scanLive(tombstones, visit); },
+                      fieldExtractor_);
+}
+
+void TableStore::recountAggregates(const DeletionBitmap* tombstones) {
+    for (auto& aggregate : aggregates_) {
+        aggregate->clear();
+    }
+    scanLive(tombstones, [&](const uint8_t* data, size_t length, uint64_t sequence) {
+        for (auto& aggregate : aggregates_) {
+            aggregate->add(data, length, sequence, fieldExtractor_);
+        }
+    });
+}
+
+void TableStore::expireThrough(uint64_t sequence, const DeletionBitmap* tombstones) {
+    if (batching_) {
+        throw std::runtime_error("Cannot expire records inside an ingest batch");
+    }
+    if (!aggregates_.empty() && fieldExtractor_) {
+        uint64_t expired = std::max(tombstones ? tombstones->expiredThrough() : 0, storage_.getEvictedSequence());
+        size_t end = StreamingFlatBufferStore::visibleCount(recordInfos_, sequence);
+        for (size_t row = StreamingFlatBufferStore::visibleCount(recordInfos_, expired); row < end; row++) {
+            uint64_t rowSequence = recordInfos_[row].sequence;
+            if (!tombstones || !tombstones->contains(rowSequence)) onDelete(rowSequence);
+        }
+    }
+    for (auto& [column, index] : indexes_) {
+        index->eraseThrough(sequence);
+    }
+    for (auto it = upsertCurrent_.begin(); it != upsertCurrent_.end();) {
+        it = it->second.sequence <= sequence ? upsertCurrent_.erase(it) : std::next(it);
+    }
+    for (auto it = upsertPrevious_.begin(); it != upsertPrevious_.end();) {
+        it = it->first <= sequence ? upsertPrevious_.erase(it) : std::next(it);
+    }
+}
+
+// Upsert keys by value, so an int32 key matches an int64 lookup and an
+// integral double; false for NULL, which is never upserted
+static bool upsertKeyBytes(const ValueView& key, std::string& out) {
+    out.clear();
+    auto append = [&](char tag, const void* data, size_t size) {
+        out += tag;
+        out.append(static_cast<const char*>(data), size);
+    };
+    if (std::holds_alternative<std::monostate>(key)) return false;
+    if (const auto* text = std::get_if<std::string_view>(&key)) {
+        append('s', text->data(), text->size());
+    } else if (const auto* bytes = std::get_if<BytesView>(&key)) {
+        append('b', bytes->data, bytes->size);
+    } else if (const auto* big = std::get_if<uint64_t>(&key); big && *big > static_cast<uint64_t>(INT64_MAX)) {
+        append('u', big, sizeof(*big));
+    } else if (std::holds_alternative<float>(key) || std::holds_alternative<double>(key)) {
+        double real = std::holds_alternative<float>(key) ? std::get<float>(key) : std::get<double>(key);
+        if (real >= -9.2e18 && real <= 9.2e18 && real == std::trunc(real)) {
+            int64_t integer = static_cast<int64_t>(real);
+            append('i', &integer, sizeof(integer));
+        } else {
+            append('r', &real, sizeof(real));
+        }
+    } else {
+        int64_t integer = std::visit([](auto v) -> int64_t {
+            if constexpr (std::is_arithmetic_v<decltype(v)>) return static_cast<int64_t>(v);
+            else return 0;
+        }, key);
+        append('i', &integer, sizeof(integer));
+    }
+    return true;
+}
+
+void TableStore::enableUpsert(bool keepHistory, const DeletionBitmap* tombstones,
+                              std::vector<uint64_t>& superseded) {
+    std::string column;
+    if (tableDef_.primaryKeyColumns.size() == 1) {
+        column = tableDef_.primaryKeyColumns[0];
+    } else if (tableDef_.primaryKeyColumns.empty()) {
+        for (const auto& def : tableDef_.columns) {
+            if (!def.primaryKey) continue;
+            if (!column.empty()) {
+                column.clear();
+                break;
+            }
+            column = def.name;
+        }
+    }
+    int col = column.empty() ? -1 : tableDef_.getColumnIndex(column);
+    if (col < 0) {
+        throw std::runtime_error("Upsert mode requires a single primary key column in table " + tableDef_.name);
+    }
+    if (tableDef_.columns[col].encrypted) {
+        throw std::runtime_error("Upsert mode requires an unencrypted primary key: " + column);
+    }
+    if (!fieldExtractor_ && !fieldViewExtractor_ && !keyExtractor_) {
+        throw std::runtime_error("Upsert mode requires an extractor for table " + tableDef_.name);
+    }
+    if (batching_) {
+        throw std::runtime_error("Cannot change upsert mode inside an ingest batch");
+    }
+    if (isUpsert() && upsertColumn_ == tableDef_.columns[col].name && keepHistory_ == keepHistory) return;
+
+    disableUpsert();
+    upsertColumn_ = tableDef_.columns[col].name;
+    upsertOrdinal_ = col;
+    keepHistory_ = keepHistory;
+    for (const auto& info : recordInfos_) {
+        if (info.sequence <= storage_.getEvictedSequence()) continue;
+        if (tombstones && tombstones->contains(info.sequence)) continue;
+        uint32_t length = 0;
+        const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+        if (!data) continue;
+        if (uint64_t old = supersede(data, length, info.sequence, info.offset)) superseded.push_back(old);
+    }
+}
+
+void TableStore::disableUpsert() {
+    upsertColumn_.clear();
+    upsertOrdinal_ = -1;
+    keepHistory_ = false;
+    upsertCurrent_.clear();
+    upsertPrevious_.clear();
+}
+
+TableStore::UpsertVersion* TableStore::upsertSlot(const uint8_t* data, size_t length) {
+    Value scratch;
+    ValueView key;
+    if (keyExtractor_) {
+        keyExtractor_(data, length, &upsertOrdinal_, 1, &scratch);
+        key = viewOf(scratch);
+    } else {
+        key = fieldView(data, length, upsertColumn_, scratch);
+    }
+    if (!upsertKeyBytes(key, upsertKeyScratch_)) return nullptr;
+    return &upsertCurrent_.try_emplace(upsertKeyScratch_, UpsertVersion{0, 0, 0}).first->second;
+}
+
+uint64_t TableStore::supersede(const uint8_t* data, size_t length, uint64_t sequence, uint64_t offset) {
+    if (!isUpsert()) return 0;
+    UpsertVersion* slot = upsertSlot(data, length);
+    if (!slot) return 0;
+    uint64_t old = slot->sequence;
+    *slot = {sequence, offset, static_cast<uint32_t>(length)};
+    if (old == 0 || !storage_.hasRecord(old)) return 0;
+    if (keepHistory_) upsertPrevious_[sequence] = old;
+    return old;
+}
+
+bool TableStore::findCurrent(const Value& key, IndexEntry& entry) const {
+    std::string bytes;
+    if (!isUpsert() || !upsertKeyBytes(viewOf(key), bytes)) return false;
+    auto it = upsertCurrent_.find(bytes);
+    if (it == upsertCurrent_.end() || !storage_.hasRecord(it->second.sequence)) return false;
+    entry.key = key;
+    entry.dataOffset = it->second.offset;
+    entry.dataLength = it->second.length;
+    entry.sequence = it->second.sequence;
+    return true;
+}
+
+std::vector<uint64_t> TableStore::getVersions(const Value& key) const {
+    std::vector<uint64_t> versions;
+    IndexEntry current;
+    if (!findCurrent(key, current)) return versions;
+    for (uint64_t sequence = current.sequence; sequence != 0 && storage_.hasRecord(sequence);) {
+        versions.push_back(sequence);
+        auto it = upsertPrevious_.find(sequence);
+        sequence = it == upsertPrevious_.end() ? 0 : it->second;
+    }
+    return versions;
+}
+
+void TableStore::scanLive(const DeletionBitmap* tombstones,
+                          const MaterializedAggregate::RecordVisitor& visit) const {
+    bool checkTombstones = tombstones && !tombstones->empty();
+    for (const auto& info : recordInfos_) {
+        if (checkTombstones && tombstones->contains(info.sequence)) continue;
+        uint32_t length = 0;
+        const uint8_t* data = storage_.getDataAtOffset(info.offset, &length);
+        if (data) visit(data, length, info.sequence);
+    }
+}
+
+uint64_t FlatSQLDatabase::subscribe(const std::string& tableName, const std::vector<SubscriptionFilter>& filters,
+                                    SubscriptionCallback callback) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Unknown table: " + tableName);
+    }
+    uint64_t id = nextSubscriptionId_++;
+    it->second->subscriptions().add(id, it->second->getTableDef(), filters, std::move(callback));
+    subscriptionTables_[id] = it->second.get();
+    return id;
+}
+
+bool FlatSQLDatabase::unsubscribe(uint64_t subscriptionId) {
+    auto it = subscriptionTables_.find(subscriptionId);
+    if (it == subscriptionTables_.end()) return false;
+    it->second->subscriptions().remove(subscriptionId);
+    subscriptionTables_.erase(it);
+    return true;
+}
+
+void FlatSQLDatabase::matchSubscriptions(TableStore* table, const uint8_t* data, size_t length,
+                                         uint64_t sequence, uint64_t offset) {
+    matchScratch_.clear();
+    table->getSubscriptions()->match(data, length, table->getFieldExtractor(), matchScratch_);
+    for (uint64_t id : matchScratch_) {
+        pendingMatches_.push_back({table, id, sequence, offset});
+    }
+}
+
+void FlatSQLDatabase::deliverMatches() {
+    // Callbacks that ingest queue more matches, delivered by this loop
+    if (deliveringMatches_) return;
+    deliveringMatches_ = true;
+    std::exception_ptr error;
+    std::vector<PendingMatch> batch;
+    while (!pendingMatches_.empty()) {
+        batch.clear();
+        batch.swap(pendingMatches_);
+        for (const PendingMatch& match : batch) {
+            // Unsubscribed by an earlier callback
+            const SubscriptionCallback* callback = match.table->subscriptions().callback(match.subscription);
+            if (!callback) continue;
+            uint32_t length = 0;
+            const uint8_t* data = storage_.getDataAtOffset(match.offset, &length);
+            try {
+                (*callback)({match.subscription, match.sequence, data, length});
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+    }
+    deliveringMatches_ = false;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Legacy multi-source API (external storage)
+void FlatSQLDatabase::registerExternalSource(
     const std::string& sourceName,
     StreamingFlatBufferStore* store,
     const TableDef& schema,
@@ -585,7 +2417,7 @@ void FlatSQLDatabase::registerExternalSource(
     TableStore::FieldExtractor extractor
 ) {
     // Build index map (empty for external sources)
-    std::unordered_map<std::string, SqliteIndex*> indexes;
+    std::unordered_map<std::string, Index*> indexes;
 
     sqliteEngine_->registerSource(
         sourceName,
@@ -607,7 +2439,77 @@ void FlatSQLDatabase::createUnifiedView(
 // ==================== Delete Support ====================
 
 void FlatSQLDatabase::markDeleted(const std::string& tableName, uint64_t sequence) {
+    // Materialized aggregates take a record back the first time it is deleted
+    auto it = tables_.find(tableName);
+    TableStore* table = it != tables_.end() && it->second->hasMaterializedAggregates() ? it->second.get() : nullptr;
+    const DeletionBitmap* tombstones = table ? sqliteEngine_->getTombstones(tableName) : nullptr;
+    bool counted = tombstones && !tombstones->contains(sequence);
+
     sqliteEngine_->markDeleted(tableName, sequence);
+    if (counted) {
+        table->onDelete(sequence);
+    }
+    if (replicationLog_ && sequence != 0) {
+        replicationLog_->append(tableName, sequence);
+    }
+}
+
+void FlatSQLDatabase::markDeleted(const std::string& tableName, const std::vector<uint64_t>& sequences) {
+    initializeSQLiteEngine();
+    auto it = tables_.find(tableName);
+    TableStore* table = it != tables_.end() && it->second->hasMaterializedAggregates() ? it->second.get() : nullptr;
+    const DeletionBitmap* tombstones = table ? sqliteEngine_->getTombstones(tableName) : nullptr;
+    std::vector<uint64_t> counted;
+    if (tombstones) {
+        for (uint64_t sequence : sequences) {
+            if (!tombstones->contains(sequence)) counted.push_back(sequence);
+        }
+        std::sort(counted.begin(), counted.end());
+        counted.erase(std::unique(counted.begin(), counted.end()), counted.end());
+    }
+
+    sqliteEngine_->markDeleted(tableName, sequences);
+    for (uint64_t sequence : counted) {
+        table->onDelete(sequence);
+    }
+    if (replicationLog_) {
+        for (uint64_t sequence : sequences) {
+            if (sequence != 0) replicationLog_->append(tableName, sequence);
+        }
+    }
+}
+
+void FlatSQLDatabase::setUpsertMode(const std::string& tableName, bool enabled, bool keepHistory) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (compaction_) {
+        throw std::runtime_error("Cannot change upsert mode during compaction");
+    }
+    TableStore* table = it->second.get();
+    if (!enabled) {
+        table->disableUpsert();
+        return;
+    }
+    initializeSQLiteEngine();
+    std::vector<uint64_t> superseded;
+    table->enableUpsert(keepHistory, sqliteEngine_->getTombstones(tableName), superseded);
+    if (!superseded.empty()) markDeleted(tableName, superseded);
+}
+
+std::vector<uint64_t> FlatSQLDatabase::getVersions(const std::string& tableName, const Value& key) const {
+    auto it = tables_.find(tableName);
+    return it == tables_.end() ? std::vector<uint64_t>{} : it->second->getVersions(key);
+}
+
+void FlatSQLDatabase::supersedeRecord(TableStore* table, const uint8_t* data, size_t length,
+                                      uint64_t sequence, uint64_t offset) {
+    uint64_t old = table->supersede(data, length, sequence, offset);
+    if (old != 0) {
+        initializeSQLiteEngine();
+        markDeleted(table->getTableDef().name, old);
+    }
 }
 
 size_t FlatSQLDatabase::getDeletedCount(const std::string& tableName) const {
@@ -616,12 +2518,673 @@ size_t FlatSQLDatabase::getDeletedCount(const std::string& tableName) const {
 
 void FlatSQLDatabase::clearTombstones(const std::string& tableName) {
     sqliteEngine_->clearTombstones(tableName);
+    if (replicationLog_) {
+        replicationLog_->append(tableName, 0);
+    }
+
+    // Records still stored are live again
+    auto it = tables_.find(tableName);
+    if (it != tables_.end() && it->second->hasMaterializedAggregates()) {
+        it->second->recountAggregates(sqliteEngine_->getTombstones(tableName));
+    }
+}
+
+struct FlatSQLDatabase::Compaction {
+    std::unique_ptr<StreamingFlatBufferStore> target;
+    std::vector<uint64_t> sequenceMap{0};  // Old sequence -> new sequence (0 = dropped)
+
+    // Each table's next unvisited record, to find who owns a sequence
+    struct Owner {
+        const StreamingFlatBufferStore::RecordInfoList* infos;
+        const DeletionBitmap* tombstones;  // nullptr if not registered with SQLite
+        size_t position;
+    };
+    std::vector<Owner> owners;
+
+    // A clustered table: its records are set aside while copying and
+    // written sorted by key once the copy catches up
+    struct Cluster {
+        const StreamingFlatBufferStore::RecordInfoList* infos;
+        const DeletionBitmap* tombstones;
+        const TableStore::FieldExtractor* extractor;
+        std::string column;
+        size_t position;
+        std::vector<uint64_t> sequences;  // Set aside, in stream order
+    };
+    std::vector<Cluster> clusters;
+
+    // The cluster holding the record at sequence, nullptr if none
+    Cluster* clusterOf(uint64_t sequence) {
+        for (auto& cluster : clusters) {
+            const auto& infos = *cluster.infos;
+            while (cluster.position < infos.size() && infos[cluster.position].sequence < sequence) {
+                cluster.position++;
+            }
+            if (cluster.position < infos.size() && infos[cluster.position].sequence == sequence) {
+                return &cluster;
+            }
+        }
+        return nullptr;
+    }
+
+    // Whether the record at sequence is tombstoned by the table holding it
+    bool isDeleted(uint64_t sequence) {
+        for (auto& owner : owners) {
+            const auto& infos = *owner.infos;
+            while (owner.position < infos.size() && infos[owner.position].sequence < sequence) {
+                owner.position++;
+            }
+            if (owner.position < infos.size() && infos[owner.position].sequence == sequence) {
+                return owner.tombstones && owner.tombstones->contains(sequence);
+            }
+        }
+        return false;  // Unrouted records are kept
+    }
+};
+
+size_t FlatSQLDatabase::compressColdSegments(size_t keepHot) {
+    return storage_.compressColdSegments(keepHot);
+}
+
+bool FlatSQLDatabase::compactStep(size_t maxBytes) {
+    if (!compaction_) {
+        if (storage_.getStorageMode() == StorageMode::MappedFile) {
+            throw std::runtime_error("Compaction requires in-memory storage");
+        }
+        StorageOptions options = storageOptions_;
+        options.initialCapacity = std::max<size_t>(options.initialCapacity, storage_.getDataSize());
+        auto compaction = std::make_unique<Compaction>();
+        compaction->target = std::make_unique<StreamingFlatBufferStore>(options);
+        for (const auto& [name, table] : tables_) {
+            compaction->owners.push_back({&table->getRecordInfos(), sqliteEngine_->getTombstones(name), 0});
+        }
+        for (const auto& [name, column] : clusterKeys_) {
+            const TableStore& table = *tables_.at(name);
+            if (!table.getFieldExtractor()) {
+                throw std::runtime_error("Clustering needs a field extractor: " + name);
+            }
+            compaction->clusters.push_back({&table.getRecordInfos(), sqliteEngine_->getTombstones(name),
+                                            &table.getFieldExtractor(), column, 0, {}});
+        }
+        compaction_ = std::move(compaction);
+    }
+
+    // Copy live records in stream order, sequenceMap is indexed by old sequence
+    Compaction& state = *compaction_;
+    size_t copied = 0;
+    while (state.sequenceMap.size() <= storage_.getRecordCount()) {
+        if (copied > 0 && copied >= maxBytes) {
+            return false;
+        }
+        uint64_t sequence = state.sequenceMap.size();
+        if (sequence <= storage_.getEvictedSequence() || state.isDeleted(sequence)) {
+            state.sequenceMap.push_back(0);
+            continue;
+        }
+        if (Compaction::Cluster* cluster = state.clusterOf(sequence)) {
+            cluster->sequences.push_back(sequence);
+            state.sequenceMap.push_back(0);
+            continue;
+        }
+        uint32_t length = 0;
+        const uint8_t* data = storage_.getDataAtOffset(*storage_.getOffsetForSequence(sequence), &length);
+        state.sequenceMap.push_back(state.target->ingestFlatBuffer(data, length, nullptr));
+        copied += length;
+    }
+
+    // Clustered tables go last, each as one run in key order; records
+    // deleted while set aside are dropped here
+    for (auto& cluster : state.clusters) {
+        std::vector<std::pair<Value, uint64_t>> keyed;
+        keyed.reserve(cluster.sequences.size());
+        for (uint64_t sequence : cluster.sequences) {
+            if (cluster.tombstones && cluster.tombstones->contains(sequence)) continue;
+            uint32_t length = 0;
+            const uint8_t* data = storage_.getDataAtOffset(*storage_.getOffsetForSequence(sequence), &length);
+            keyed.emplace_back((*cluster.extractor)(data, length, cluster.column), sequence);
+        }
+        std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) {
+            return compareValues(a.first, b.first) < 0;
+        });
+        for (const auto& [key, sequence] : keyed) {
+            uint32_t length = 0;
+            const uint8_t* data = storage_.getDataAtOffset(*storage_.getOffsetForSequence(sequence), &length);
+            state.sequenceMap[sequence] = state.target->ingestFlatBuffer(data, length, nullptr);
+        }
+    }
+
+    finishCompaction();
+    return true;
+}
+
+void FlatSQLDatabase::compact() {
+    while (!compactStep(SIZE_MAX)) {
+    }
+}
+
+void FlatSQLDatabase::setIndexAdvisorEnabled(bool enabled, uint64_t rowThreshold) {
+    sqliteEngine_->setIndexAdvisorEnabled(enabled);
+    sqliteEngine_->getIndexAdvisor().setThreshold(rowThreshold);
+}
+
+size_t FlatSQLDatabase::buildAdvisedIndexes(size_t maxIndexes) {
+    if (compaction_) {
+        throw std::runtime_error("Cannot build indexes during compaction");
+    }
+    IndexAdvisor& advisor = sqliteEngine_->getIndexAdvisor();
+    size_t built = 0;
+    for (const IndexRecommendation& due : advisor.due()) {
+        if (built >= maxIndexes) break;
+        auto it = tables_.find(due.table);
+        if (it == tables_.end()) continue;  // External source: not ours to index
+        Index* index = it->second->addIndex(due.column);
+        if (sqliteRegisteredTables_.count(due.table)) {
+            sqliteEngine_->addSourceIndex(due.table, due.column, index);
+        }
+        advisor.markBuilt(due.table, due.column);
+        built++;
+    }
+    return built;
+}
+
+void FlatSQLDatabase::addCompositeIndex(const std::string& tableName, const std::string& name,
+                                        const std::vector<std::string>& keyColumns,
+                                        const std::vector<std::string>& includeColumns) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (compaction_) {
+        throw std::runtime_error("Cannot build indexes during compaction");
+    }
+    CompositeIndex* index = it->second->addCompositeIndex(name, keyColumns, includeColumns);
+    if (sqliteRegisteredTables_.count(tableName)) {
+        sqliteEngine_->addSourceIndex(tableName, compositeIndexKey(name), index);
+    }
+}
+
+// ==================== Schema Evolution ====================
+
+// Whether evolved adds to current (columns, or indexes on its columns);
+// throws for a change records written with current could not be read through
+static bool addsToTable(const TableDef& current, const TableDef& evolved) {
+    auto refuse = [&](const std::string& column, const char* reason) {
+        throw std::runtime_error("Cannot evolve " + current.name + "." + column + ": " + reason);
+    };
+    if (evolved.columns.size() < current.columns.size()) {
+        throw std::runtime_error("Cannot evolve " + current.name + ": columns cannot be removed");
+    }
+    if (evolved.geoLatColumn != current.geoLatColumn || evolved.geoLonColumn != current.geoLonColumn) {
+        throw std::runtime_error("Cannot evolve " + current.name + ": the spatial columns cannot change");
+    }
+    bool adds = evolved.columns.size() > current.columns.size();
+    for (size_t c = 0; c < evolved.columns.size(); c++) {
+        const ColumnDef& col = evolved.columns[c];
+        if (c >= current.columns.size()) {
+            if (current.getColumnIndex(col.name) >= 0) refuse(col.name, "the column already exists");
+            if (col.primaryKey) refuse(col.name, "a primary key cannot be added");
+            continue;
+        }
+        const ColumnDef& was = current.columns[c];
+        if (col.name != was.name) refuse(was.name, "columns cannot be renamed or reordered");
+        if (col.type != was.type || col.fieldId != was.fieldId || col.layoutKnown != was.layoutKnown) {
+            refuse(col.name, "the type and field ID cannot change");
+        }
+        if (col.encrypted != was.encrypted || col.primaryKey != was.primaryKey) {
+            refuse(col.name, "encryption and the primary key cannot change");
+        }
+        if (!col.indexed || was.primaryKey) continue;
+        if (!was.indexed) {
+            adds = true;
+        } else if (col.fullText != was.fullText || col.dictionary != was.dictionary || col.trigram != was.trigram) {
+            refuse(col.name, "an index cannot change kind");
+        }
+    }
+    return adds;
+}
+
+uint32_t FlatSQLDatabase::evolveSchema(const std::string& source) {
+    return evolveSchema(SchemaParser::parse(source, schema_.name));
+}
+
+uint32_t FlatSQLDatabase::evolveSchema(const DatabaseSchema& schema) {
+    FLATSQL_TRACE_SCOPE("FlatSQLDatabase::evolveSchema");
+    if (compaction_) {
+        throw std::runtime_error("Cannot evolve the schema during compaction");
+    }
+
+    // Check every table before changing any
+    bool changes = false;
+    for (const TableDef& evolved : schema.tables) {
+        auto it = tables_.find(evolved.name);
+        if (it == tables_.end() || addsToTable(it->second->getTableDef(), evolved)) changes = true;
+    }
+    if (!changes) {
+        return schemaVersion_;
+    }
+
+    bool schemaExtractors = false;
+    for (const auto& [name, table] : tables_) {
+        if (table->getSchemaExtractor()) schemaExtractors = true;
+    }
+    std::set<std::string> evolvedTables;
+    for (const TableDef& evolved : schema.tables) {
+        auto it = tables_.find(evolved.name);
+        if (it == tables_.end()) {
+            auto& table = tables_[evolved.name] =
+                std::make_unique<TableStore>(evolved, storage_, sqliteEngine_->getDb(), indexEngine_);
+            table->setWorkerPool(ingestPool_.get());
+            auto extractor = std::make_shared<const SchemaExtractor>(evolved);
+            if (schemaExtractors && !extractor->empty()) {
+                table->setSchemaExtractor(std::move(extractor));
+            }
+            schema_.tables.push_back(evolved);
+            sqliteInitialized_ = false;  // Registered by the next query once it has a file ID
+            continue;
+        }
+
+        TableStore& base = *it->second;
+        if (!addsToTable(base.getTableDef(), evolved)) continue;
+        base.evolve(evolved, nullptr);
+        for (TableDef& def : schema_.tables) {
+            if (def.name == evolved.name) def = base.getTableDef();
+        }
+        evolvedTables.insert(evolved.name);
+        for (const std::string& source : registeredSources_) {
+            auto sourceIt = tables_.find(getSourceTableName(evolved.name, source));
+            if (sourceIt == tables_.end()) continue;
+            sourceIt->second->evolve(evolved, base.getSchemaExtractor());
+            evolvedTables.insert(sourceIt->first);
+        }
+    }
+
+    // Registered virtual tables declare the new columns on their next use;
+    // indexes with nothing to backfill can be planned with at once
+    for (const std::string& name : evolvedTables) {
+        if (!sqliteRegisteredTables_.count(name)) continue;
+        TableStore& table = *tables_.at(name);
+        sqliteEngine_->refreshSource(name, table.getFieldExtractor(), table.getSchemaExtractor().get());
+        for (const ColumnDef& col : table.getTableDef().columns) {
+            if (table.getIndex(col.name)) addSQLiteColumnIndex(name, col.name);
+        }
+    }
+    for (const auto& [view, sources] : sqliteEngine_->getUnifiedViews()) {
+        for (const std::string& source : sources) {
+            if (evolvedTables.count(source)) {
+                sqliteEngine_->createUnifiedView(view, sources);
+                break;
+            }
+        }
+    }
+    return ++schemaVersion_;
+}
+
+bool FlatSQLDatabase::backfillStep(size_t maxRecords) {
+    FLATSQL_TRACE_SCOPE("FlatSQLDatabase::backfillStep");
+    if (compaction_) {
+        throw std::runtime_error("Cannot build indexes during compaction");
+    }
+    size_t budget = maxRecords;
+    bool finished = true;
+    for (auto& [name, table] : tables_) {
+        if (!table->isBackfilling()) continue;
+        std::vector<std::string> completed;
+        budget -= table->backfill(budget, completed);
+        for (const std::string& column : completed) {
+            addSQLiteColumnIndex(name, column);
+        }
+        if (table->isBackfilling()) finished = false;
+    }
+    return finished;
+}
+
+void FlatSQLDatabase::addSQLiteColumnIndex(const std::string& tableName, const std::string& column) {
+    if (!sqliteRegisteredTables_.count(tableName)) {
+        return;  // Registration picks up every index
+    }
+    TableStore& table = *tables_.at(tableName);
+    const ColumnDef& col = table.getTableDef().columns[table.getTableDef().getColumnIndex(column)];
+    Index* index = table.getIndex(column);
+    sqliteEngine_->addSourceIndex(tableName, col.fullText ? fullTextIndexKey(col.name) : col.name, index);
+    if (col.trigram) {
+        sqliteEngine_->addSourceIndex(tableName, trigramIndexKey(col.name), index);
+    }
+}
+
+void FlatSQLDatabase::setClusterKey(const std::string& tableName, const std::string& column) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (compaction_) {
+        throw std::runtime_error("Cannot change clustering during compaction");
+    }
+    if (column.empty()) {
+        clusterKeys_.erase(tableName);
+        return;
+    }
+    if (it->second->getTableDef().getColumnIndex(column) < 0) {
+        throw std::runtime_error("Column not found: " + tableName + "." + column);
+    }
+    clusterKeys_[tableName] = column;
+}
+
+void FlatSQLDatabase::finishCompaction() {
+    std::unique_ptr<Compaction> compaction = std::move(compaction_);
+    storage_.swapContents(*compaction->target);
+    compaction->target.reset();
+    const std::vector<uint64_t>& sequenceMap = compaction->sequenceMap;
+
+    // Rebuild every index in one transaction
+    sqlite3* db = sqliteEngine_->getDb();
+    bool ownsTxn = sqlite3_get_autocommit(db) != 0;
+    if (ownsTxn) {
+        sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    }
+    try {
+        for (auto& [name, table] : tables_) {
+            table->remapSequences(sequenceMap);
+        }
+    } catch (...) {
+        if (ownsTxn) sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        throw;
+    }
+    if (ownsTxn) {
+        sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    }
+
+    // Dropped records take their tombstones with them; later deletes move
+    for (const auto& [name, table] : tables_) {
+        DeletionBitmap* tombstones = sqliteEngine_->getTombstones(name);
+        if (!tombstones || tombstones->empty()) continue;
+        DeletionBitmap renumbered;
+        tombstones->forEach([&](uint64_t sequence) {
+            if (sequence < sequenceMap.size() && sequenceMap[sequence] != 0) {
+                renumbered.insert(sequenceMap[sequence]);
+            }
+        });
+        *tombstones = std::move(renumbered);
+    }
+
+    // Junction rows name parents by sequence
+    for (JunctionManager* junctions : junctionManagers_) {
+        junctions->remapParents(sequenceMap);
+    }
+
+    // Cached results hold old rowids, and a table without deletes of its
+    // own keeps the record count and tombstone version they are checked by
+    sqliteEngine_->clearResultCache();
+
+    // Followers hold the old sequences
+    if (replicationLog_) {
+        replicationLog_->newEpoch();
+    }
+
+    // Retained bytes are counted again over the renumbered lists
+    for (auto& [name, retention] : retention_) {
+        retention.retainedBytes = 0;
+        retention.countedRows = 0;
+    }
+}
+
+// ==================== Retention ====================
+
+// Size prefix of the record at p
+static uint32_t storedRecordSize(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void FlatSQLDatabase::setRetentionPolicy(const std::string& tableName, const RetentionPolicy& policy) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (policy.maxAge <= 0 && policy.maxBytes == 0) {
+        retention_.erase(tableName);
+        return;
+    }
+    if (policy.maxAge > 0 && it->second->getTableDef().getColumnIndex(policy.timestampColumn) < 0) {
+        throw std::runtime_error("Column not found: " + tableName + "." + policy.timestampColumn);
+    }
+    Retention& retention = retention_[tableName];
+    retention.policy = policy;
+}
+
+size_t FlatSQLDatabase::applyRetention(double now) {
+    if (storage_.getStorageMode() != StorageMode::Segmented) {
+        throw std::runtime_error("Retention requires Segmented storage");
+    }
+    if (retention_.empty()) return 0;
+    initializeSQLiteEngine();
+    uint64_t evicted = storage_.getEvictedSequence();
+
+    // Each policy's table, walked in step with the stream to find which
+    // one holds a sequence, as compaction does
+    struct Owner {
+        TableStore* table;
+        Retention* retention;
+        const StreamingFlatBufferStore::RecordInfoList* infos;
+        size_t position;
+        uint64_t retainedBytes;
+    };
+    std::vector<Owner> owners;
+    for (auto& [name, retention] : retention_) {
+        TableStore* table = tables_.at(name).get();
+        const auto& infos = table->getRecordInfos();
+        for (; retention.countedRows < infos.size(); retention.countedRows++) {
+            const auto& info = infos[retention.countedRows];
+            if (info.sequence <= evicted) continue;
+            retention.retainedBytes += SIZE_PREFIX_LENGTH + storedRecordSize(storage_.recordAt(info.offset));
+        }
+        owners.push_back({table, &retention, &infos, StreamingFlatBufferStore::visibleCount(infos, evicted),
+                          retention.retainedBytes});
+    }
+
+    // Oldest sealed segments first, while every record in one has expired
+    uint64_t through = evicted;
+    std::vector<Owner> trial;
+    uint64_t first, last;
+    for (size_t segment = 0; storage_.getSealedSegment(segment, &first, &last); segment++) {
+        trial = owners;
+        bool expired = true;
+        for (uint64_t sequence = first; sequence <= last && expired; sequence++) {
+            Owner* owner = nullptr;
+            for (Owner& candidate : trial) {
+                const auto& infos = *candidate.infos;
+                while (candidate.position < infos.size() && infos[candidate.position].sequence < sequence) {
+                    candidate.position++;
+                }
+                if (candidate.position < infos.size() && infos[candidate.position].sequence == sequence) {
+                    owner = &candidate;
+                    break;
+                }
+            }
+            if (!owner) {
+                expired = false;  // No policy covers this record
+                break;
+            }
+            const RetentionPolicy& policy = owner->retention->policy;
+            const uint8_t* record = storage_.recordAt((*owner->infos)[owner->position].offset);
+            uint32_t length = storedRecordSize(record);
+            bool old = false;
+            if (policy.maxAge > 0 && owner->table->getFieldExtractor()) {
+                Value timestamp = owner->table->getFieldExtractor()(record + SIZE_PREFIX_LENGTH, length,
+                                                                    policy.timestampColumn);
+                old = !std::holds_alternative<std::monostate>(timestamp) &&
+                      compareValues(timestamp, Value(now - policy.maxAge)) < 0;
+            }
+            bool over = policy.maxBytes > 0 && owner->retainedBytes > policy.maxBytes;
+            expired = old || over;
+            owner->retainedBytes -= SIZE_PREFIX_LENGTH + length;
+        }
+        if (!expired) break;
+        owners.swap(trial);
+        through = std::max(through, last);
+    }
+    if (through == evicted) return 0;
+
+    // Aggregates and indexes let go while the records are still readable
+    for (auto& [name, table] : tables_) {
+        table->expireThrough(through, sqliteEngine_->getTombstones(name));
+    }
+    for (const std::string& source : sqliteEngine_->listSources()) {
+        if (DeletionBitmap* tombstones = sqliteEngine_->getTombstones(source)) {
+            tombstones->expireThrough(through);
+        }
+    }
+    for (const Owner& owner : owners) {
+        owner.retention->retainedBytes = owner.retainedBytes;
+    }
+    return storage_.evictThrough(through);
+}
+
+// ==================== Replication ====================
+
+void FlatSQLDatabase::enableReplicationLog() {
+    if (!replicationLog_) {
+        replicationLog_ = std::make_unique<ReplicationLog>();
+    }
+}
+
+std::vector<uint8_t> FlatSQLDatabase::pullReplication(const ReplicationPosition& position,
+                                                      size_t maxBytes) const {
+    if (!replicationLog_) {
+        throw std::runtime_error("Replication log is not enabled");
+    }
+    const ReplicationLog& log = *replicationLog_;
+    bool snapshot;
+    if (position.epoch == log.epoch()) {
+        snapshot = position.snapshot;
+        if (!snapshot && (position.deletes < log.firstDelete() || position.deletes > log.endDelete())) {
+            throw std::runtime_error("Replication log no longer covers this position; start the follower over");
+        }
+    } else if (position == ReplicationPosition()) {
+        snapshot = true;
+    } else {
+        throw std::runtime_error("Leader compacted since this replication position; start the follower over");
+    }
+    uint64_t last = storage_.getRecordCount();
+    if (position.sequence > last) {
+        throw std::runtime_error("Replication position is ahead of the leader");
+    }
+    if (position.sequence < storage_.getEvictedSequence()) {
+        throw std::runtime_error("Retention evicted records this replication position has not applied");
+    }
+
+    // Whole records after the follower's, cut after maxBytes; spans are
+    // copied as they come since a cold chunk's only lasts until the next
+    ReplicationFrameWriter writer(position);
+    uint64_t sequence = position.sequence;
+    auto cursor = storage_.beginExport(position.sequence);
+    const uint8_t* data;
+    size_t length;
+    bool full = false;
+    while (!full && storage_.nextExportChunk(cursor, &data, &length)) {
+        size_t used = 0;
+        while (used < length) {
+            size_t record = SIZE_PREFIX_LENGTH + storedRecordSize(data + used);
+            if (writer.recordBytes() + used > 0 && writer.recordBytes() + used + record > maxBytes) {
+                full = true;
+                break;
+            }
+            used += record;
+            sequence++;
+        }
+        writer.addRecords(data, used);
+    }
+
+    ReplicationPosition to{log.epoch(), sequence, position.deletes, snapshot};
+    std::vector<ReplicationDelete> deletes;
+    if (snapshot) {
+        // The snapshot's last frame brings the tombstones as they are now,
+        // which covers the log so far
+        if (sequence == last) {
+            for (const std::string& source : sqliteEngine_->listSources()) {
+                const DeletionBitmap* tombstones = sqliteEngine_->getTombstones(source);
+                if (!tombstones) continue;
+                tombstones->forEach([&](uint64_t deleted) { deletes.push_back({source, deleted}); });
+            }
+            to.deletes = log.endDelete();
+            to.snapshot = false;
+        }
+    } else {
+        // Logged deletes in order, up to the first of a record not sent yet
+        while (to.deletes < log.endDelete() && log.at(to.deletes).sequence <= sequence) {
+            deletes.push_back(log.at(to.deletes));
+            to.deletes++;
+        }
+    }
+    return writer.finish(to, deletes);
+}
+
+ReplicationPosition FlatSQLDatabase::getReplicationHead() const {
+    if (!replicationLog_) {
+        throw std::runtime_error("Replication log is not enabled");
+    }
+    return {replicationLog_->epoch(), storage_.getRecordCount(), replicationLog_->endDelete(), false};
+}
+
+void FlatSQLDatabase::trimReplicationLog(const ReplicationPosition& applied) {
+    if (replicationLog_ && applied.epoch == replicationLog_->epoch() && !applied.snapshot) {
+        replicationLog_->trim(applied.deletes);
+    }
+}
+
+ReplicationPosition FlatSQLDatabase::applyReplication(const uint8_t* data, size_t length) {
+    ReplicationFrame frame = decodeReplicationFrame(data, length);
+    if (frame.from != replicaPosition_) {
+        throw std::runtime_error("Replication frame does not continue from this follower's position");
+    }
+    if (storage_.getRecordCount() != frame.from.sequence) {
+        throw std::runtime_error("Follower storage does not match its replication position");
+    }
+
+    // Check the records frame whole before any is stored
+    uint64_t records = 0;
+    size_t end = 0;
+    while (end + SIZE_PREFIX_LENGTH <= frame.recordBytes) {
+        end += SIZE_PREFIX_LENGTH + storedRecordSize(frame.records + end);
+        records++;
+    }
+    if (end != frame.recordBytes || frame.to.sequence < frame.from.sequence ||
+        records != frame.to.sequence - frame.from.sequence) {
+        throw std::runtime_error("Replication frame records do not match its positions");
+    }
+
+    ingestStream(frame.records, frame.recordBytes, nullptr);
+
+    // Deletes in log order, a table's consecutive ones as one batch
+    std::vector<uint64_t> batch;
+    for (size_t i = 0; i < frame.deletes.size(); i++) {
+        const ReplicationDelete& entry = frame.deletes[i];
+        if (entry.sequence == 0) {
+            clearTombstones(entry.table);
+            continue;
+        }
+        batch.push_back(entry.sequence);
+        if (i + 1 == frame.deletes.size() || frame.deletes[i + 1].table != entry.table ||
+            frame.deletes[i + 1].sequence == 0) {
+            markDeleted(entry.table, batch);
+            batch.clear();
+        }
+    }
+
+    replicaPosition_ = frame.to;
+    return replicaPosition_;
 }
 
 // ==================== Encryption ====================
 
 void FlatSQLDatabase::setEncryptionKey(const uint8_t* key, size_t keySize) {
     encryptionCtx_ = std::make_unique<flatbuffers::EncryptionContext>(key, keySize);
+    // From the context's own 32-byte copy: key may be shorter. A key the
+    // context rejects leaves HMACs unavailable.
+    if (encryptionCtx_->IsValid()) {
+        hmacKey_ = std::make_unique<HmacSha256>(encryptionCtx_->GetKey(), flatbuffers::kEncryptionKeySize);
+    } else {
+        hmacKey_.reset();
+    }
 }
 
 bool FlatSQLDatabase::hasEncryptedFields() const {
@@ -633,6 +3196,114 @@ bool FlatSQLDatabase::hasEncryptedFields() const {
     return false;
 }
 
+// ==================== Record Verification ====================
+
+// Records per verifyIngest() task: each is a walk over a few fields
+static constexpr size_t RECORD_VERIFY_GRAIN = 64;
+
+void FlatSQLDatabase::setVerificationMode(VerificationMode mode) {
+    for (auto& [name, table] : tables_) {
+        setVerificationMode(name, mode);
+    }
+}
+
+void FlatSQLDatabase::setVerificationMode(const std::string& tableName, VerificationMode mode) {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    RecordVerification& verification = it->second->getVerification();
+    verification.clearOutcomes();
+    if (mode == VerificationMode::Lazy) {
+        verification.reserve(storage_.getVisibleSequence());
+    }
+    verification.setMode(mode);
+    sqliteEngine_->clearResultCache();
+}
+
+VerificationMode FlatSQLDatabase::getVerificationMode(const std::string& tableName) const {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    return it->second->getVerification().getMode();
+}
+
+uint64_t FlatSQLDatabase::getVerificationFailures(const std::string& tableName) const {
+    auto it = tables_.find(tableName);
+    if (it == tables_.end()) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    return it->second->getVerification().getFailures();
+}
+
+bool FlatSQLDatabase::strictVerification() const {
+    for (const auto& [name, table] : tables_) {
+        if (table->getVerification().getMode() == VerificationMode::Strict) return true;
+    }
+    return false;
+}
+
+void FlatSQLDatabase::verifyIngest(const uint8_t* data, size_t length, bool sizePrefixed,
+                                   const FileIdRoutes* routes) {
+    if (!routes || !strictVerification()) {
+        return;
+    }
+
+    // Frame the records bound for Strict tables
+    struct Pending {
+        const uint8_t* data;
+        uint32_t length;
+        size_t record;  // Index in the call
+        RecordVerification* verification;
+    };
+    std::vector<Pending> pending;
+    size_t records = 0;
+    auto route = [&](const uint8_t* record, uint32_t recordLength) {
+        TableStore* table = routeFileId(*routes, StreamingFlatBufferStore::fileIdView(record, recordLength));
+        if (table && table->getVerification().getMode() == VerificationMode::Strict) {
+            pending.push_back({record, recordLength, records, &table->getVerification()});
+        }
+        records++;
+    };
+    if (!sizePrefixed) {
+        route(data, static_cast<uint32_t>(length));
+    } else {
+        size_t end = 0;
+        while (end + SIZE_PREFIX_LENGTH <= length) {
+            uint32_t fbSize = static_cast<uint32_t>(data[end]) |
+                              (static_cast<uint32_t>(data[end + 1]) << 8) |
+                              (static_cast<uint32_t>(data[end + 2]) << 16) |
+                              (static_cast<uint32_t>(data[end + 3]) << 24);
+            if (end + SIZE_PREFIX_LENGTH + fbSize > length) break;
+            route(data + end + SIZE_PREFIX_LENGTH, fbSize);
+            end += SIZE_PREFIX_LENGTH + fbSize;
+        }
+    }
+
+    std::atomic<size_t> firstFailure{pending.size()};
+    auto verifyRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (pending[i].verification->verify(pending[i].data, pending[i].length)) continue;
+            size_t seen = firstFailure.load(std::memory_order_relaxed);
+            while (i < seen && !firstFailure.compare_exchange_weak(seen, i, std::memory_order_relaxed)) {
+            }
+            return;  // Later records of this range can't fail first
+        }
+    };
+    if (ingestPool_) {
+        ingestPool_->parallelFor(pending.size(), verifyRange, RECORD_VERIFY_GRAIN);
+    } else {
+        verifyRange(0, pending.size());
+    }
+    size_t failed = firstFailure.load();
+    if (failed < pending.size()) {
+        pending[failed].verification->countFailure();
+        throw std::runtime_error("FlatBuffer verification failed for record " +
+                                 std::to_string(pending[failed].record));
+    }
+}
+
 // ==================== HMAC Authentication ====================
 
 void FlatSQLDatabase::setHMACVerification(bool enabled) {
@@ -643,33 +3314,61 @@ void FlatSQLDatabase::setHMACVerification(bool enabled) {
 }
 
 bool FlatSQLDatabase::computeHMAC(const uint8_t* buffer, size_t length, uint8_t* outMAC) const {
-    if (!encryptionCtx_) return false;
-#ifdef FLATSQL_HAVE_OPENSSL
-    const uint8_t* key = encryptionCtx_->GetKey();
-    unsigned int macLen = 32;
-    HMAC(EVP_sha256(), key, 32, buffer, length, outMAC, &macLen);
-    return true;
-#else
-    (void)buffer; (void)length; (void)outMAC;
-    return false;
-#endif
+    return hmacKey_ && hmacKey_->compute(buffer, length, outMAC);
 }
 
 bool FlatSQLDatabase::verifyHMAC(const uint8_t* buffer, size_t length, const uint8_t* mac) const {
-    if (!encryptionCtx_) return false;
-#ifdef FLATSQL_HAVE_OPENSSL
-    uint8_t computed[32];
-    computeHMAC(buffer, length, computed);
-    // Constant-time comparison to prevent timing attacks
-    uint8_t diff = 0;
-    for (int i = 0; i < 32; i++) {
-        diff |= computed[i] ^ mac[i];
-    }
-    return diff == 0;
-#else
-    (void)buffer; (void)length; (void)mac;
-    return false;
-#endif
+    return hmacKey_ && hmacKey_->verify(buffer, length, mac);
+}
+
+void FlatSQLDatabase::requireUnauthenticatedIngest() const {
+    if (hmacEnabled_) {
+        throw std::runtime_error("HMAC verification is enabled: ingest through ingestVerified()");
+    }
+}
+
+const HmacSha256& FlatSQLDatabase::hmacKey() const {
+    if (!hmacKey_) {
+        throw std::runtime_error("Cannot verify HMACs without an encryption key");
+    }
+    if (!hmacKey_->available()) {
+        throw std::runtime_error("HMAC verification is not available in this build");
+    }
+    return *hmacKey_;
+}
+
+size_t FlatSQLDatabase::ingestVerified(const uint8_t* data, size_t length, const uint8_t* macs,
+                                       size_t macCount, size_t* recordsIngested) {
+    const HmacSha256& key = hmacKey();
+
+    // Frame the complete records that have a MAC
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+    size_t end = 0;
+    while (offsets.size() < macCount && end + SIZE_PREFIX_LENGTH <= length) {
+        uint32_t fbSize = static_cast<uint32_t>(data[end]) |
+                          (static_cast<uint32_t>(data[end + 1]) << 8) |
+                          (static_cast<uint32_t>(data[end + 2]) << 16) |
+                          (static_cast<uint32_t>(data[end + 3]) << 24);
+        if (end + SIZE_PREFIX_LENGTH + fbSize > length) break;
+        offsets.push_back(end + SIZE_PREFIX_LENGTH);
+        lengths.push_back(fbSize);
+        end += SIZE_PREFIX_LENGTH + fbSize;
+    }
+
+    size_t failed = key.verifyBatch(data, offsets.data(), lengths.data(), macs, offsets.size(),
+                                    ingestPool_.get());
+    if (failed < offsets.size()) {
+        throw std::runtime_error("HMAC verification failed for record " + std::to_string(failed));
+    }
+    return ingestStream(data, end, recordsIngested);
+}
+
+uint64_t FlatSQLDatabase::ingestOneVerified(const uint8_t* flatbuffer, size_t length, const uint8_t* mac) {
+    if (!hmacKey().verify(flatbuffer, length, mac)) {
+        throw std::runtime_error("HMAC verification failed");
+    }
+    return ingestSingle(flatbuffer, length);
 }
 
 }  // namespace flatsql
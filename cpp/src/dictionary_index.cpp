@@ -0,0 +1,202 @@
+#include "flatsql/dictionary_index.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace flatsql {
+
+// ==================== PostingList ====================
+
+void PostingList::add(uint32_t ordinal) {
+    uint32_t high = ordinal >> 16;
+    uint16_t low = static_cast<uint16_t>(ordinal);
+    if (containers_.empty() || containers_.back().high != high) {
+        containers_.emplace_back();
+        containers_.back().high = high;
+    }
+    Container& c = containers_.back();
+    if (c.bitmap.empty()) {
+        c.array.push_back(low);
+        if (c.array.size() > ARRAY_LIMIT) {
+            c.bitmap.assign(65536 / 64, 0);
+            for (uint16_t v : c.array) c.bitmap[v >> 6] |= uint64_t(1) << (v & 63);
+            std::vector<uint16_t>().swap(c.array);
+        }
+    } else {
+        c.bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    c.count++;
+    size_++;
+}
+
+size_t PostingList::memoryBytes() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container& c : containers_) {
+        bytes += c.array.capacity() * sizeof(uint16_t) + c.bitmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+// ==================== DictionaryIndex ====================
+
+DictionaryIndex::DictionaryIndex(const std::string& tableName, const std::string& columnName)
+    : Index(tableName, columnName, ValueType::String) {}
+
+void DictionaryIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    insertKey(key, dataOffset, dataLength, sequence);
+}
+
+void DictionaryIndex::insertKey(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    const std::string* text = std::get_if<std::string>(&key);
+    if (!text) {
+        throw std::runtime_error(std::holds_alternative<std::monostate>(key)
+            ? "Failed to insert index entry: NULL key"
+            : "Failed to insert index entry: key type does not match " + name_);
+    }
+    if (rows_.size() > UINT32_MAX) {
+        throw std::runtime_error("Dictionary index is full: " + name_);
+    }
+
+    auto [it, added] = dictionary_.try_emplace(*text, static_cast<uint32_t>(codes_.size()));
+    if (added) {
+        codes_.push_back({&it->first, {}, 0, true});
+    }
+    Code& code = codes_[it->second];
+    code.ordered = code.ordered && sequence > code.lastSequence;
+    code.lastSequence = std::max(code.lastSequence, sequence);
+    code.postings.add(static_cast<uint32_t>(rows_.size()));
+    rows_.push_back({dataOffset, sequence, dataLength});
+    stats_.add(key);
+}
+
+void DictionaryIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    rows_.reserve(rows_.size() + sortedEntries.size());
+    for (const auto& entry : sortedEntries) {
+        insertKey(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+    }
+}
+
+void DictionaryIndex::appendPostings(const Code& code, std::vector<IndexEntry>& results) const {
+    size_t first = results.size();
+    results.reserve(first + code.postings.size());
+    code.postings.forEach([&](uint32_t ordinal) {
+        const Row& row = rows_[ordinal];
+        results.push_back({*code.key, row.offset, row.length, row.sequence});
+    });
+    if (!code.ordered) {
+        std::sort(results.begin() + static_cast<std::ptrdiff_t>(first), results.end(),
+                  [](const IndexEntry& a, const IndexEntry& b) { return a.sequence < b.sequence; });
+    }
+}
+
+std::vector<IndexEntry> DictionaryIndex::search(const Value& key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<IndexEntry> results;
+    const std::string* text = std::get_if<std::string>(&key);
+    if (!text) return results;
+    auto it = dictionary_.find(*text);
+    if (it != dictionary_.end()) {
+        appendPostings(codes_[it->second], results);
+    }
+    return results;
+}
+
+bool DictionaryIndex::searchFirst(const Value& key, IndexEntry& result) const {
+    const std::string* text = std::get_if<std::string>(&key);
+    if (!text) return false;
+    uint64_t offset, sequence;
+    uint32_t length;
+    if (!searchFirstString(*text, offset, length, sequence)) return false;
+    result = {key, offset, length, sequence};
+    return true;
+}
+
+std::vector<IndexEntry> DictionaryIndex::searchMany(std::vector<Value> keys) const {
+    sortKeys(keys);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<IndexEntry> results;
+    for (const auto& key : keys) {
+        const std::string* text = std::get_if<std::string>(&key);
+        if (!text) continue;
+        auto it = dictionary_.find(*text);
+        if (it != dictionary_.end()) {
+            appendPostings(codes_[it->second], results);
+        }
+    }
+    return results;
+}
+
+bool DictionaryIndex::searchFirstString(const std::string& key, uint64_t& outOffset,
+                                        uint32_t& outLength, uint64_t& outSequence) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = dictionary_.find(key);
+    if (it == dictionary_.end()) return false;
+
+    // Lowest sequence: the first posting unless inserts arrived out of order
+    const Code& code = codes_[it->second];
+    const Row* first = nullptr;
+    code.postings.forEach([&](uint32_t ordinal) {
+        const Row& row = rows_[ordinal];
+        if (!first || (!code.ordered && row.sequence < first->sequence)) first = &row;
+    });
+    if (!first) return false;
+    outOffset = first->offset;
+    outLength = first->length;
+    outSequence = first->sequence;
+    return true;
+}
+
+bool DictionaryIndex::searchFirstInt64(int64_t, uint64_t&, uint32_t&, uint64_t&) const {
+    return false;  // Only string keys match
+}
+
+std::vector<IndexEntry> DictionaryIndex::range(const Value& minKey, const Value& maxKey) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<IndexEntry> results;
+    bool openMin = std::holds_alternative<std::monostate>(minKey);
+    bool openMax = std::holds_alternative<std::monostate>(maxKey);
+    const std::string* lo = std::get_if<std::string>(&minKey);
+    const std::string* hi = std::get_if<std::string>(&maxKey);
+    if ((!openMin && !lo) || (!openMax && !hi)) return results;
+    if (lo && hi && *lo > *hi) return results;
+
+    auto it = lo ? dictionary_.lower_bound(*lo) : dictionary_.begin();
+    auto end = hi ? dictionary_.upper_bound(*hi) : dictionary_.end();
+    for (; it != end; ++it) {
+        appendPostings(codes_[it->second], results);
+    }
+    return results;
+}
+
+std::vector<IndexEntry> DictionaryIndex::all() const {
+    return range(std::monostate{}, std::monostate{});
+}
+
+void DictionaryIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dictionary_.clear();
+    codes_.clear();
+    rows_.clear();
+    stats_.clear();
+}
+
+size_t DictionaryIndex::getCodeCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return codes_.size();
+}
+
+size_t DictionaryIndex::memoryBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = rows_.capacity() * sizeof(Row) + codes_.capacity() * sizeof(Code);
+    for (const auto& [key, code] : dictionary_) {
+        bytes += key.capacity() + sizeof(std::string) + 3 * sizeof(void*) + sizeof(code);
+    }
+    for (const Code& code : codes_) {
+        bytes += code.postings.memoryBytes();
+    }
+    return bytes;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,283 @@
+#include "flatsql/field_cipher.h"
+#include "flatbuffers/encryption.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(__EMSCRIPTEN__)
+#define FLATSQL_HAVE_AESNI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#ifdef FLATSQL_HAVE_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+namespace flatsql {
+
+namespace {
+
+constexpr size_t BLOCK = 16;
+constexpr int ROUNDS = 14;  // AES-256
+
+// Big-endian increment of a 128-bit counter block
+void nextCounter(uint8_t* counter) {
+    for (int i = BLOCK - 1; i >= 0; i--) {
+        if (++counter[i] != 0) break;
+    }
+}
+
+// ---- flatbuffers' portable AES-CTR ----
+
+void portableCrypt(const FieldSpan* spans, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (spans[i].size > 0) {
+            flatbuffers::DecryptBytes(spans[i].bytes, spans[i].size, spans[i].cipher->key,
+                                      spans[i].cipher->iv);
+        }
+    }
+}
+
+// ---- AES-NI ----
+
+#ifdef FLATSQL_HAVE_AESNI
+
+bool cpuHasAesNi() {
+    static const bool supported = [] {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) != 0;
+    }();
+    return supported;
+}
+
+__attribute__((target("aes,sse2")))
+__m128i expandEven(__m128i previous, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    return _mm_xor_si128(previous, assist);
+}
+
+__attribute__((target("aes,sse2")))
+__m128i expandOdd(__m128i previous, __m128i last) {
+    __m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(last, 0x00), 0xaa);
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+    return _mm_xor_si128(previous, assist);
+}
+
+__attribute__((target("aes,sse2")))
+void aesniExpandKey(const uint8_t* key, uint8_t* roundKeys) {
+    __m128i rk[ROUNDS + 1];
+    rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    rk[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + BLOCK));
+    rk[2] = expandEven(rk[0], _mm_aeskeygenassist_si128(rk[1], 0x01));
+    rk[3] = expandOdd(rk[1], rk[2]);
+    rk[4] = expandEven(rk[2], _mm_aeskeygenassist_si128(rk[3], 0x02));
+    rk[5] = expandOdd(rk[3], rk[4]);
+    rk[6] = expandEven(rk[4], _mm_aeskeygenassist_si128(rk[5], 0x04));
+    rk[7] = expandOdd(rk[5], rk[6]);
+    rk[8] = expandEven(rk[6], _mm_aeskeygenassist_si128(rk[7], 0x08));
+    rk[9] = expandOdd(rk[7], rk[8]);
+    rk[10] = expandEven(rk[8], _mm_aeskeygenassist_si128(rk[9], 0x10));
+    rk[11] = expandOdd(rk[9], rk[10]);
+    rk[12] = expandEven(rk[10], _mm_aeskeygenassist_si128(rk[11], 0x20));
+    rk[13] = expandOdd(rk[11], rk[12]);
+    rk[14] = expandEven(rk[12], _mm_aeskeygenassist_si128(rk[13], 0x40));
+    for (int r = 0; r <= ROUNDS; r++) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(roundKeys + r * BLOCK), rk[r]);
+    }
+}
+
+// One counter block: its key, counter value and the bytes it covers
+struct Lane {
+    const uint8_t* roundKeys;
+    uint8_t counter[BLOCK];
+    uint8_t* out;
+    size_t size;  // <= BLOCK
+};
+
+// Blocks encrypted side by side, enough to hide aesenc latency
+constexpr size_t LANES = 8;
+
+__attribute__((target("aes,sse2")))
+void aesniLanes(const Lane* lanes, size_t count) {
+    __m128i blocks[LANES];
+    for (size_t i = 0; i < count; i++) {
+        blocks[i] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[i].counter)),
+                                  _mm_load_si128(reinterpret_cast<const __m128i*>(lanes[i].roundKeys)));
+    }
+    for (int r = 1; r < ROUNDS; r++) {
+        for (size_t i = 0; i < count; i++) {
+            blocks[i] = _mm_aesenc_si128(blocks[i], _mm_load_si128(
+                reinterpret_cast<const __m128i*>(lanes[i].roundKeys + r * BLOCK)));
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        blocks[i] = _mm_aesenclast_si128(blocks[i], _mm_load_si128(
+            reinterpret_cast<const __m128i*>(lanes[i].roundKeys + ROUNDS * BLOCK)));
+        const Lane& lane = lanes[i];
+        if (lane.size == BLOCK) {
+            __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane.out));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lane.out), _mm_xor_si128(data, blocks[i]));
+        } else {
+            alignas(16) uint8_t stream[BLOCK];
+            _mm_store_si128(reinterpret_cast<__m128i*>(stream), blocks[i]);
+            for (size_t j = 0; j < lane.size; j++) lane.out[j] ^= stream[j];
+        }
+    }
+}
+
+bool aesniCrypt(const FieldSpan* spans, size_t count) {
+    if (!cpuHasAesNi()) return false;
+    Lane lanes[LANES];
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        const FieldSpan& span = spans[i];
+        uint8_t counter[BLOCK];
+        std::memcpy(counter, span.cipher->iv, BLOCK);
+        for (size_t pos = 0; pos < span.size; pos += BLOCK) {
+            Lane& lane = lanes[used++];
+            lane.roundKeys = span.cipher->roundKeys;
+            std::memcpy(lane.counter, counter, BLOCK);
+            lane.out = span.bytes + pos;
+            lane.size = std::min(BLOCK, span.size - pos);
+            nextCounter(counter);
+            if (used == LANES) {
+                aesniLanes(lanes, used);
+                used = 0;
+            }
+        }
+    }
+    if (used > 0) {
+        aesniLanes(lanes, used);
+    }
+    return true;
+}
+
+#endif  // FLATSQL_HAVE_AESNI
+
+// ---- OpenSSL EVP ----
+
+#ifdef FLATSQL_HAVE_OPENSSL
+
+// Per-thread EVP context, re-keyed only when the key changes
+struct EvpCipher {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    uint8_t key[32];
+    bool keyed = false;
+    ~EvpCipher() { EVP_CIPHER_CTX_free(ctx); }
+};
+
+bool openSslCrypt(const FieldSpan* spans, size_t count) {
+    thread_local EvpCipher evp;
+    if (!evp.ctx) return false;
+    for (size_t i = 0; i < count; i++) {
+        const FieldSpan& span = spans[i];
+        if (span.size == 0) continue;
+        const FieldCipher& cipher = *span.cipher;
+        bool sameKey = evp.keyed && std::memcmp(evp.key, cipher.key, sizeof(evp.key)) == 0;
+        int ok = sameKey
+            ? EVP_EncryptInit_ex(evp.ctx, nullptr, nullptr, nullptr, cipher.iv)
+            : EVP_EncryptInit_ex(evp.ctx, EVP_aes_256_ctr(), nullptr, cipher.key, cipher.iv);
+        evp.keyed = ok == 1;
+        std::memcpy(evp.key, cipher.key, sizeof(evp.key));
+        int written = 0;
+        if (!evp.keyed) {
+            portableCrypt(&span, 1);  // Spans before this one are already done
+        } else if (EVP_EncryptUpdate(evp.ctx, span.bytes, &written, span.bytes,
+                                     static_cast<int>(span.size)) != 1) {
+            // CTR updates only fail on a broken context, before writing
+            evp.keyed = false;
+            portableCrypt(&span, 1);
+        }
+    }
+    return true;
+}
+
+#endif  // FLATSQL_HAVE_OPENSSL
+
+// Whether backend gives flatbuffers' portable output on a known input that
+// spans a partial block and carries across counter bytes
+bool matchesPortable(CipherBackend backend) {
+    FieldCipher cipher;
+    for (size_t i = 0; i < sizeof(cipher.key); i++) cipher.key[i] = static_cast<uint8_t>(0x5a ^ (i * 7));
+    for (size_t i = 0; i < sizeof(cipher.iv); i++) cipher.iv[i] = static_cast<uint8_t>(i * 13);
+    cipher.iv[14] = cipher.iv[15] = 0xff;
+    cipher.prepare();
+
+    uint8_t expected[53];
+    uint8_t actual[sizeof(expected)];
+    for (size_t i = 0; i < sizeof(expected); i++) expected[i] = static_cast<uint8_t>(i * 31 + 1);
+    std::memcpy(actual, expected, sizeof(expected));
+    flatbuffers::EncryptBytes(expected, sizeof(expected), cipher.key, cipher.iv);
+    FieldSpan span{actual, sizeof(actual), &cipher};
+    return cryptFieldsWith(backend, &span, 1) && std::memcmp(expected, actual, sizeof(actual)) == 0;
+}
+
+}  // namespace
+
+void FieldCipher::prepare() {
+#ifdef FLATSQL_HAVE_AESNI
+    if (cpuHasAesNi()) {
+        aesniExpandKey(key, roundKeys);
+        return;
+    }
+#endif
+    std::memset(roundKeys, 0, sizeof(roundKeys));
+}
+
+CipherBackend cipherBackend() {
+    static const CipherBackend backend = [] {
+        for (CipherBackend candidate : {CipherBackend::AesNi, CipherBackend::OpenSsl}) {
+            if (matchesPortable(candidate)) return candidate;
+        }
+        return CipherBackend::Portable;
+    }();
+    return backend;
+}
+
+const char* cipherBackendName(CipherBackend backend) {
+    switch (backend) {
+        case CipherBackend::AesNi: return "aes-ni";
+        case CipherBackend::OpenSsl: return "openssl";
+        default: return "portable";
+    }
+}
+
+bool cryptFieldsWith(CipherBackend backend, const FieldSpan* spans, size_t count) {
+    switch (backend) {
+        case CipherBackend::Portable:
+            portableCrypt(spans, count);
+            return true;
+        case CipherBackend::AesNi:
+#ifdef FLATSQL_HAVE_AESNI
+            return aesniCrypt(spans, count);
+#else
+            return false;
+#endif
+        case CipherBackend::OpenSsl:
+#ifdef FLATSQL_HAVE_OPENSSL
+            return openSslCrypt(spans, count);
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void cryptFields(const FieldSpan* spans, size_t count) {
+    if (!cryptFieldsWith(cipherBackend(), spans, count)) {
+        portableCrypt(spans, count);
+    }
+}
+
+void cryptField(uint8_t* bytes, size_t size, const FieldCipher& cipher) {
+    FieldSpan span{bytes, size, &cipher};
+    cryptFields(&span, 1);
+}
+
+}  // namespace flatsql
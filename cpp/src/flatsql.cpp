@@ -464,6 +464,11 @@ public:
         db_.clearTombstones(tableName);
     }
 
+    // Compact up to maxBytes of records, true when finished (rowids change)
+    bool compactStep(double maxBytes) {
+        return db_.compactStep(static_cast<size_t>(maxBytes));
+    }
+
     // ==================== Multi-Source API ====================
 
     // Get list of registered source names
@@ -544,6 +549,7 @@ EMSCRIPTEN_BINDINGS(flatsql) {
         .function("markDeleted", &JSFlatSQLDatabase::markDeleted)
         .function("getDeletedCount", &JSFlatSQLDatabase::getDeletedCount)
         .function("clearTombstones", &JSFlatSQLDatabase::clearTombstones)
+        .function("compactStep", &JSFlatSQLDatabase::compactStep)
         // Multi-source API
         .function("listSources", &JSFlatSQLDatabase::listSources)
         .function("createUnifiedView", &JSFlatSQLDatabase::createUnifiedView)
@@ -2,9 +2,16 @@
 // This avoids the "table index out of bounds" issue with SQLite vtable callbacks in workers
 
 #include "flatsql/database.h"
+#include "flatsql/result_buffer.h"
+#include "flatsql/trace.h"
 #include <flatbuffers/flatbuffers.h>
 #include <flatbuffers/encryption.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -214,13 +221,111 @@ Value extractPostFieldGeneric(const uint8_t* data, size_t length, const std::str
     return std::monostate{};
 }
 
-// Global state for result handling
-QueryResult g_lastResult;
-std::string g_lastError;
-std::vector<uint8_t> g_exportBuffer;
-std::vector<uint8_t> g_testBuffer;
-std::vector<FlatSQLDatabase::TableStats> g_statsBuffer;
-std::vector<std::string> g_sourcesBuffer;
+// Database handle returned by flatsql_create_db. Results, errors and
+// scratch buffers belong to the handle, so separate handles can be used
+// concurrently (each from one thread at a time) without a global lock.
+struct DbHandle {
+    DbHandle(const char* schema, const char* dbName)
+        : db(FlatSQLDatabase::fromSchema(schema, dbName)) {}
+    DbHandle(const uint8_t* compiled, size_t length)
+        : db(FlatSQLDatabase::fromCompiledSchema(compiled, length)) {}
+
+    FlatSQLDatabase db;
+    QueryResult lastResult;
+    std::string lastError;
+    std::vector<uint8_t> exportBuffer;
+    const uint8_t* exportSpan = nullptr;  // Last flatsql_export_data/_next result
+    size_t exportLength = 0;
+    StreamingFlatBufferStore::ExportCursor exportCursor;
+    std::vector<uint8_t> resultBuffer;
+    std::vector<FlatSQLDatabase::TableStats> statsBuffer;
+    std::vector<std::string> sourcesBuffer;
+
+    // Last raw FlatBuffer lookup
+    const uint8_t* rawFlatBuffer = nullptr;
+    uint32_t rawFlatBufferSize = 0;
+    uint64_t rawFlatBufferSequence = 0;
+};
+
+DbHandle& state(void* handle) {
+    return *static_cast<DbHandle*>(handle);
+}
+
+// Cursor handle returned by flatsql_prepare; errors go to its database handle
+struct CursorHandle {
+    DbHandle* owner;
+    std::unique_ptr<QueryCursor> cursor;
+    QueryResult batch;
+    std::vector<uint8_t> buffer;
+};
+
+// Aggregates as SQL labels, e.g. "COUNT(*), SUM(score), APPROX_PERCENTILE(score, 0.9)";
+// false if one is not OP(column) with a known OP
+bool parseAggregates(const char* text, std::vector<AggregateSpec>& specs) {
+    static const std::pair<const char*, AggregateSpec::Op> ops[] = {
+        {"COUNT", AggregateSpec::Op::Count}, {"SUM", AggregateSpec::Op::Sum},
+        {"MIN", AggregateSpec::Op::Min},     {"MAX", AggregateSpec::Op::Max},
+        {"AVG", AggregateSpec::Op::Avg},
+        {"APPROX_COUNT_DISTINCT", AggregateSpec::Op::ApproxCountDistinct},
+        {"APPROX_PERCENTILE", AggregateSpec::Op::ApproxPercentile},
+    };
+    auto trim = [](std::string value) {
+        size_t begin = value.find_first_not_of(" \t\n");
+        size_t end = value.find_last_not_of(" \t\n");
+        return begin == std::string::npos ? std::string() : value.substr(begin, end - begin + 1);
+    };
+
+    std::string list = text ? text : "";
+    size_t start = 0;
+    while (start <= list.size()) {
+        // Next comma outside parentheses (APPROX_PERCENTILE takes two arguments)
+        size_t comma = start;
+        for (int depth = 0; comma < list.size() && (list[comma] != ',' || depth > 0); comma++) {
+            if (list[comma] == '(') depth++;
+            if (list[comma] == ')') depth--;
+        }
+        if (comma == list.size()) comma = std::string::npos;
+        std::string item = trim(list.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        size_t open = item.find('(');
+        if (open == std::string::npos || item.back() != ')') return false;
+        std::string name = trim(item.substr(0, open));
+        for (char& c : name) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+
+        AggregateSpec spec;
+        bool known = false;
+        for (const auto& [label, op] : ops) {
+            if (name == label) {
+                spec.op = op;
+                known = true;
+            }
+        }
+        spec.column = trim(item.substr(open + 1, item.size() - open - 2));
+        if (spec.column == "*") spec.column.clear();
+        if (spec.op == AggregateSpec::Op::ApproxPercentile) {
+            // APPROX_PERCENTILE(column, fraction)
+            size_t separator = spec.column.find(',');
+            if (separator == std::string::npos) return false;
+            char* end = nullptr;
+            std::string fraction = trim(spec.column.substr(separator + 1));
+            spec.fraction = std::strtod(fraction.c_str(), &end);
+            if (fraction.empty() || *end != '\0' || !(spec.fraction >= 0.0 && spec.fraction <= 1.0)) return false;
+            spec.column = trim(spec.column.substr(0, separator));
+        }
+        if (!known || (spec.column.empty() && spec.op != AggregateSpec::Op::Count)) return false;
+        specs.push_back(spec);
+
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+    return !specs.empty();
+}
+
+// State not tied to a database handle: failed flatsql_create_db calls and
+// the test buffer builders
+thread_local std::string t_lastError;
+thread_local std::vector<uint8_t> t_testBuffer;
+thread_local std::vector<uint8_t> t_compiledSchema;
+thread_local std::string t_traceJson;  // Last flatsql_trace_export result
 
 }  // anonymous namespace
 
@@ -228,103 +333,198 @@ std::vector<std::string> g_sourcesBuffer;
 
 extern "C" {
 
+// Version of this C API; 2 = per-handle result and error state
+EMSCRIPTEN_KEEPALIVE
+int flatsql_api_version() {
+    return 2;
+}
+
+// Returns nullptr on error (see flatsql_get_error(nullptr))
 EMSCRIPTEN_KEEPALIVE
 void* flatsql_create_db(const char* schema, const char* dbName) {
-    auto* db = new FlatSQLDatabase(FlatSQLDatabase::fromSchema(schema, dbName));
-    return static_cast<void*>(db);
+    try {
+        auto* handle = new DbHandle(schema, dbName);
+        t_lastError.clear();
+        return static_cast<void*>(handle);
+    } catch (const std::exception& e) {
+        t_lastError = e.what();
+        return nullptr;
+    }
+}
+
+// Database from a flatsql_compile_schema() artifact; no schema is parsed
+EMSCRIPTEN_KEEPALIVE
+void* flatsql_create_db_compiled(const uint8_t* compiled, size_t length) {
+    try {
+        auto* handle = new DbHandle(compiled, length);
+        t_lastError.clear();
+        return static_cast<void*>(handle);
+    } catch (const std::exception& e) {
+        t_lastError = e.what();
+        return nullptr;
+    }
+}
+
+// Parse a schema once into the compiled form; the bytes stay valid until
+// the calling thread compiles again. Returns nullptr on error.
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_compile_schema(const char* schema, const char* dbName) {
+    try {
+        t_compiledSchema = SchemaParser::compile(SchemaParser::parse(schema, dbName));
+        t_lastError.clear();
+        return t_compiledSchema.data();
+    } catch (const std::exception& e) {
+        t_lastError = e.what();
+        t_compiledSchema.clear();
+        return nullptr;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_compiled_schema_size() {
+    return static_cast<int>(t_compiledSchema.size());
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_destroy_db(void* handle) {
-    delete static_cast<FlatSQLDatabase*>(handle);
+    delete static_cast<DbHandle*>(handle);
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_register_file_id(void* handle, const char* fileId, const char* tableName) {
-    static_cast<FlatSQLDatabase*>(handle)->registerFileId(fileId, tableName);
+    state(handle).db.registerFileId(fileId, tableName);
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_enable_demo_extractors(void* handle) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     db->setFieldExtractor("User", extractUserFieldGeneric);
     db->setFieldExtractor("Post", extractPostFieldGeneric);
 }
 
+// Ingest calls return -1 on error (see flatsql_get_error), e.g. while
+// over the hard memory limit (flatsql_set_memory_limits)
 EMSCRIPTEN_KEEPALIVE
 double flatsql_ingest(void* handle, const uint8_t* data, size_t length) {
-    return static_cast<double>(static_cast<FlatSQLDatabase*>(handle)->ingest(data, length));
+    try {
+        return static_cast<double>(state(handle).db.ingest(data, length));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 EMSCRIPTEN_KEEPALIVE
 double flatsql_ingest_one(void* handle, const uint8_t* data, size_t length) {
-    return static_cast<double>(static_cast<FlatSQLDatabase*>(handle)->ingestOne(data, length));
+    try {
+        return static_cast<double>(state(handle).db.ingestOne(data, length));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
+}
+
+// In-place streaming ingest: JS writes a chunk at the reserved pointer
+// (the store's tail) and commits the bytes written. Reserve returns 0 and
+// commit -1 on error (see flatsql_get_error).
+EMSCRIPTEN_KEEPALIVE
+uint8_t* flatsql_reserve_ingest(void* handle, size_t bytes) {
+    try {
+        return state(handle).db.reserveIngest(bytes);
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return nullptr;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+double flatsql_commit_ingest(void* handle, size_t bytes) {
+    try {
+        return static_cast<double>(state(handle).db.commitIngest(bytes));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 // Source-aware ingestion
 EMSCRIPTEN_KEEPALIVE
 void flatsql_register_source(void* handle, const char* sourceName) {
     try {
-        static_cast<FlatSQLDatabase*>(handle)->registerSource(sourceName);
+        state(handle).db.registerSource(sourceName);
     } catch (const std::exception& e) {
-        g_lastError = e.what();
+        state(handle).lastError = e.what();
     }
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_create_unified_views(void* handle) {
-    static_cast<FlatSQLDatabase*>(handle)->createUnifiedViews();
+    state(handle).db.createUnifiedViews();
 }
 
 EMSCRIPTEN_KEEPALIVE
 double flatsql_ingest_with_source(void* handle, const uint8_t* data, size_t length, const char* source) {
-    return static_cast<double>(static_cast<FlatSQLDatabase*>(handle)->ingestWithSource(data, length, source));
+    try {
+        return static_cast<double>(state(handle).db.ingestWithSource(data, length, source));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 EMSCRIPTEN_KEEPALIVE
 double flatsql_ingest_one_with_source(void* handle, const uint8_t* data, size_t length, const char* source) {
-    return static_cast<double>(static_cast<FlatSQLDatabase*>(handle)->ingestOneWithSource(data, length, source));
+    try {
+        return static_cast<double>(state(handle).db.ingestOneWithSource(data, length, source));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_query(void* handle, const char* sql) {
     try {
-        g_lastResult = static_cast<FlatSQLDatabase*>(handle)->query(sql);
-        g_lastError.clear();
+        state(handle).lastResult = state(handle).db.query(sql);
+        state(handle).lastError.clear();
         return 1;
     } catch (const std::exception& e) {
-        g_lastError = e.what();
+        state(handle).lastError = e.what();
         return 0;
     }
 }
 
+// Last error on a handle; with nullptr, the calling thread's last
+// flatsql_create_db failure
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_get_error() {
-    return g_lastError.c_str();
+const char* flatsql_get_error(void* handle) {
+    return handle ? state(handle).lastError.c_str() : t_lastError.c_str();
 }
 
 EMSCRIPTEN_KEEPALIVE
-int flatsql_result_column_count() {
-    return static_cast<int>(g_lastResult.columns.size());
+int flatsql_result_column_count(void* handle) {
+    return static_cast<int>(state(handle).lastResult.columns.size());
 }
 
 EMSCRIPTEN_KEEPALIVE
-int flatsql_result_row_count() {
-    return static_cast<int>(g_lastResult.rows.size());
+int flatsql_result_row_count(void* handle) {
+    return static_cast<int>(state(handle).lastResult.rows.size());
 }
 
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_result_column_name(int index) {
-    if (index < 0 || index >= static_cast<int>(g_lastResult.columns.size())) return "";
-    return g_lastResult.columns[index].c_str();
+const char* flatsql_result_column_name(void* handle, int index) {
+    const QueryResult& result = state(handle).lastResult;
+    if (index < 0 || index >= static_cast<int>(result.columns.size())) return "";
+    return result.columns[index].c_str();
 }
 
 EMSCRIPTEN_KEEPALIVE
-int flatsql_result_cell_type(int row, int col) {
-    if (row < 0 || row >= static_cast<int>(g_lastResult.rows.size())) return 0;
-    if (col < 0 || col >= static_cast<int>(g_lastResult.rows[row].size())) return 0;
+int flatsql_result_cell_type(void* handle, int row, int col) {
+    const QueryResult& result = state(handle).lastResult;
+    if (row < 0 || row >= static_cast<int>(result.rows.size())) return 0;
+    if (col < 0 || col >= static_cast<int>(result.rows[row].size())) return 0;
 
-    const Value& v = g_lastResult.rows[row][col];
+    const Value& v = result.rows[row][col];
     if (std::holds_alternative<std::monostate>(v)) return 0;
     if (std::holds_alternative<bool>(v)) return 1;
     if (std::holds_alternative<int32_t>(v)) return 2;
@@ -336,11 +536,12 @@ int flatsql_result_cell_type(int row, int col) {
 }
 
 EMSCRIPTEN_KEEPALIVE
-double flatsql_result_cell_number(int row, int col) {
-    if (row < 0 || row >= static_cast<int>(g_lastResult.rows.size())) return 0;
-    if (col < 0 || col >= static_cast<int>(g_lastResult.rows[row].size())) return 0;
+double flatsql_result_cell_number(void* handle, int row, int col) {
+    const QueryResult& result = state(handle).lastResult;
+    if (row < 0 || row >= static_cast<int>(result.rows.size())) return 0;
+    if (col < 0 || col >= static_cast<int>(result.rows[row].size())) return 0;
 
-    const Value& v = g_lastResult.rows[row][col];
+    const Value& v = result.rows[row][col];
     if (std::holds_alternative<bool>(v)) return std::get<bool>(v) ? 1 : 0;
     if (std::holds_alternative<int32_t>(v)) return static_cast<double>(std::get<int32_t>(v));
     if (std::holds_alternative<int64_t>(v)) return static_cast<double>(std::get<int64_t>(v));
@@ -349,11 +550,12 @@ double flatsql_result_cell_number(int row, int col) {
 }
 
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_result_cell_string(int row, int col) {
-    if (row < 0 || row >= static_cast<int>(g_lastResult.rows.size())) return "";
-    if (col < 0 || col >= static_cast<int>(g_lastResult.rows[row].size())) return "";
+const char* flatsql_result_cell_string(void* handle, int row, int col) {
+    const QueryResult& result = state(handle).lastResult;
+    if (row < 0 || row >= static_cast<int>(result.rows.size())) return "";
+    if (col < 0 || col >= static_cast<int>(result.rows[row].size())) return "";
 
-    const Value& v = g_lastResult.rows[row][col];
+    const Value& v = result.rows[row][col];
     if (std::holds_alternative<std::string>(v)) {
         return std::get<std::string>(v).c_str();
     }
@@ -361,11 +563,12 @@ const char* flatsql_result_cell_string(int row, int col) {
 }
 
 EMSCRIPTEN_KEEPALIVE
-const uint8_t* flatsql_result_cell_blob(int row, int col) {
-    if (row < 0 || row >= static_cast<int>(g_lastResult.rows.size())) return nullptr;
-    if (col < 0 || col >= static_cast<int>(g_lastResult.rows[row].size())) return nullptr;
+const uint8_t* flatsql_result_cell_blob(void* handle, int row, int col) {
+    const QueryResult& result = state(handle).lastResult;
+    if (row < 0 || row >= static_cast<int>(result.rows.size())) return nullptr;
+    if (col < 0 || col >= static_cast<int>(result.rows[row].size())) return nullptr;
 
-    const Value& v = g_lastResult.rows[row][col];
+    const Value& v = result.rows[row][col];
     if (std::holds_alternative<std::vector<uint8_t>>(v)) {
         return std::get<std::vector<uint8_t>>(v).data();
     }
@@ -373,154 +576,561 @@ const uint8_t* flatsql_result_cell_blob(int row, int col) {
 }
 
 EMSCRIPTEN_KEEPALIVE
-int flatsql_result_cell_blob_size(int row, int col) {
-    if (row < 0 || row >= static_cast<int>(g_lastResult.rows.size())) return 0;
-    if (col < 0 || col >= static_cast<int>(g_lastResult.rows[row].size())) return 0;
+int flatsql_result_cell_blob_size(void* handle, int row, int col) {
+    const QueryResult& result = state(handle).lastResult;
+    if (row < 0 || row >= static_cast<int>(result.rows.size())) return 0;
+    if (col < 0 || col >= static_cast<int>(result.rows[row].size())) return 0;
 
-    const Value& v = g_lastResult.rows[row][col];
+    const Value& v = result.rows[row][col];
     if (std::holds_alternative<std::vector<uint8_t>>(v)) {
         return static_cast<int>(std::get<std::vector<uint8_t>>(v).size());
     }
     return 0;
 }
 
+// Run a query and encode the whole result into one buffer (layout in
+// flatsql/result_buffer.h). Returns nullptr on error (see flatsql_get_error).
+// The buffer stays valid until the next flatsql_query_buffer call.
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_query_buffer(void* handle, const char* sql) {
+    try {
+        QueryResult result = state(handle).db.query(sql);
+        encodeResultBuffer(result, state(handle).resultBuffer);
+        state(handle).lastError.clear();
+        return state(handle).resultBuffer.data();
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        state(handle).resultBuffer.clear();
+        return nullptr;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_result_buffer_size(void* handle) {
+    return static_cast<int>(state(handle).resultBuffer.size());
+}
+
+// ==================== Cursor API ====================
+// Step through a result without materializing it. Column accessors read
+// the current row; strings and blobs stay valid until the next step.
+
+EMSCRIPTEN_KEEPALIVE
+void* flatsql_prepare(void* handle, const char* sql) {
+    try {
+        auto cursor = std::make_unique<CursorHandle>();
+        cursor->owner = &state(handle);
+        cursor->cursor = state(handle).db.openCursor(sql);
+        state(handle).lastError.clear();
+        return cursor.release();
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return nullptr;
+    }
+}
+
+// Returns 1 when a row is available, 0 when done, -1 on error
+EMSCRIPTEN_KEEPALIVE
+int flatsql_step(void* cursor) {
+    auto* c = static_cast<CursorHandle*>(cursor);
+    try {
+        return c->cursor->step() ? 1 : 0;
+    } catch (const std::exception& e) {
+        c->owner->lastError = e.what();
+        return -1;
+    }
+}
+
+// Encode up to maxRows further rows as a result buffer (see flatsql_query_buffer).
+// A buffer with fewer than maxRows rows is the last one. Returns nullptr on error.
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_step_buffer(void* cursor, int maxRows) {
+    auto* c = static_cast<CursorHandle*>(cursor);
+    try {
+        c->batch.rows.clear();
+        c->cursor->fetch(maxRows > 0 ? static_cast<size_t>(maxRows) : 1, c->batch);
+        encodeResultBuffer(c->batch, c->buffer);
+        return c->buffer.data();
+    } catch (const std::exception& e) {
+        c->owner->lastError = e.what();
+        c->buffer.clear();
+        return nullptr;
+    }
+}
+
+// flatsql_step_buffer that also returns once budgetMs has elapsed, so the
+// caller can handle other work between slices; flatsql_cursor_done tells
+// a finished query from a spent budget
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_step_buffer_for(void* cursor, int maxRows, double budgetMs) {
+    auto* c = static_cast<CursorHandle*>(cursor);
+    try {
+        c->batch.rows.clear();
+        auto budget = std::chrono::microseconds(static_cast<int64_t>(std::max(0.0, budgetMs) * 1000.0));
+        c->cursor->fetchFor(maxRows > 0 ? static_cast<size_t>(maxRows) : 1, budget, c->batch);
+        encodeResultBuffer(c->batch, c->buffer);
+        return c->buffer.data();
+    } catch (const std::exception& e) {
+        c->owner->lastError = e.what();
+        c->buffer.clear();
+        return nullptr;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_cursor_done(void* cursor) {
+    return static_cast<CursorHandle*>(cursor)->cursor->done() ? 1 : 0;
+}
+
+// Cancel a cursor's query: its next step fails with "Query cancelled"
+EMSCRIPTEN_KEEPALIVE
+void flatsql_cancel(void* cursor) {
+    static_cast<CursorHandle*>(cursor)->cursor->cancel();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_cursor_buffer_size(void* cursor) {
+    return static_cast<int>(static_cast<CursorHandle*>(cursor)->buffer.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_column_count(void* cursor) {
+    return static_cast<CursorHandle*>(cursor)->cursor->columnCount();
+}
+
+EMSCRIPTEN_KEEPALIVE
+const char* flatsql_column_name(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return "";
+    return c.columnName(col);
+}
+
+// Same type codes as flatsql_result_cell_type (integers are reported as int64)
+EMSCRIPTEN_KEEPALIVE
+int flatsql_column_type(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return 0;
+    switch (c.columnType(col)) {
+        case SQLITE_INTEGER: return 3;
+        case SQLITE_FLOAT: return 4;
+        case SQLITE_TEXT: return 5;
+        case SQLITE_BLOB: return 6;
+        default: return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+double flatsql_column_number(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return 0;
+    return c.getDouble(col);
+}
+
+EMSCRIPTEN_KEEPALIVE
+const char* flatsql_column_string(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return "";
+    return c.getText(col);
+}
+
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_column_blob(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return nullptr;
+    return c.getBlob(col);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_column_bytes(void* cursor, int col) {
+    QueryCursor& c = *static_cast<CursorHandle*>(cursor)->cursor;
+    if (col < 0 || col >= c.columnCount()) return 0;
+    return c.getBytes(col);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void flatsql_finalize(void* cursor) {
+    delete static_cast<CursorHandle*>(cursor);
+}
+
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_export_data(void* handle) {
-    g_exportBuffer = static_cast<FlatSQLDatabase*>(handle)->exportData();
-    return g_exportBuffer.data();
+    DbHandle& h = state(handle);
+    h.exportBuffer.clear();
+    if (h.db.getStorage().getStorageMode() == StorageMode::Segmented) {
+        h.exportBuffer = h.db.exportData();
+        h.exportSpan = h.exportBuffer.data();
+        h.exportLength = h.exportBuffer.size();
+        return h.exportSpan;
+    }
+
+    // A stream stored in one piece is returned in place, not copied
+    auto cursor = h.db.beginExport(0);
+    if (!h.db.nextExportChunk(cursor, &h.exportSpan, &h.exportLength)) {
+        h.exportSpan = h.exportBuffer.data();
+        h.exportLength = 0;
+    }
+    return h.exportSpan;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_export_size(void* handle) {
+    return static_cast<int>(state(handle).exportLength);
+}
+
+// Chunked export: begin after a sequence watermark (0 = everything), then
+// call flatsql_export_next until it returns 0. Each chunk holds whole
+// records, points into storage and is valid until the next call or
+// ingest; its size is flatsql_export_size. flatsql_export_watermark is the
+// last sequence returned so far.
+EMSCRIPTEN_KEEPALIVE
+void flatsql_export_begin(void* handle, double afterSequence) {
+    DbHandle& h = state(handle);
+    h.exportCursor = h.db.beginExport(static_cast<uint64_t>(afterSequence));
+    h.exportSpan = nullptr;
+    h.exportLength = 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_export_next(void* handle) {
+    DbHandle& h = state(handle);
+    if (!h.db.nextExportChunk(h.exportCursor, &h.exportSpan, &h.exportLength)) {
+        h.exportSpan = nullptr;
+        h.exportLength = 0;
+    }
+    return h.exportSpan;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double flatsql_export_watermark(void* handle) {
+    return static_cast<double>(state(handle).exportCursor.sequence);
+}
+
+// Replication: a leader enables its delete log and serves frames from
+// flatsql_replication_pull (size in flatsql_export_size, nullptr on
+// error); a follower applies them in order with flatsql_replication_apply
+// and pulls the next from its flatsql_replica_position. Position fields:
+// 0 epoch, 1 sequence, 2 deletes, 3 snapshot.
+static double positionField(const ReplicationPosition& position, int field) {
+    switch (field) {
+        case 0: return static_cast<double>(position.epoch);
+        case 1: return static_cast<double>(position.sequence);
+        case 2: return static_cast<double>(position.deletes);
+        case 3: return position.snapshot ? 1 : 0;
+        default: return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+void flatsql_enable_replication_log(void* handle) {
+    state(handle).db.enableReplicationLog();
+}
+
+EMSCRIPTEN_KEEPALIVE
+const uint8_t* flatsql_replication_pull(void* handle, double epoch, double sequence, double deletes,
+                                        int snapshot, double maxBytes) {
+    DbHandle& h = state(handle);
+    try {
+        ReplicationPosition position{static_cast<uint64_t>(epoch), static_cast<uint64_t>(sequence),
+                                     static_cast<uint64_t>(deletes), snapshot != 0};
+        h.exportBuffer = h.db.pullReplication(position, static_cast<size_t>(maxBytes));
+        h.exportSpan = h.exportBuffer.data();
+        h.exportLength = h.exportBuffer.size();
+        h.lastError.clear();
+        return h.exportSpan;
+    } catch (const std::exception& e) {
+        h.lastError = e.what();
+        h.exportSpan = nullptr;
+        h.exportLength = 0;
+        return nullptr;
+    }
+}
+
+// 0 on success, -1 on error
+EMSCRIPTEN_KEEPALIVE
+int flatsql_replication_apply(void* handle, const uint8_t* data, size_t length) {
+    try {
+        state(handle).db.applyReplication(data, length);
+        state(handle).lastError.clear();
+        return 0;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 EMSCRIPTEN_KEEPALIVE
-int flatsql_export_size() {
-    return static_cast<int>(g_exportBuffer.size());
+double flatsql_replica_position(void* handle, int field) {
+    return positionField(state(handle).db.getReplicaPosition(), field);
+}
+
+// The leader's head position (0 without a replication log)
+EMSCRIPTEN_KEEPALIVE
+double flatsql_replication_head(void* handle, int field) {
+    const FlatSQLDatabase& db = state(handle).db;
+    return db.isReplicationLogEnabled() ? positionField(db.getReplicationHead(), field) : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void flatsql_trim_replication_log(void* handle, double epoch, double deletes) {
+    ReplicationPosition applied{static_cast<uint64_t>(epoch), 0, static_cast<uint64_t>(deletes), false};
+    state(handle).db.trimReplicationLog(applied);
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_load_and_rebuild(void* handle, const uint8_t* data, size_t length) {
-    static_cast<FlatSQLDatabase*>(handle)->loadAndRebuild(data, length);
+    state(handle).db.loadAndRebuild(data, length);
 }
 
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_create_test_user(int32_t id, const char* name, const char* email, int32_t age) {
-    g_testBuffer = createUserFlatBufferInternal(id, name, email, age);
-    return g_testBuffer.data();
+    t_testBuffer = createUserFlatBufferInternal(id, name, email, age);
+    return t_testBuffer.data();
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_test_buffer_size() {
-    return static_cast<int>(g_testBuffer.size());
+    return static_cast<int>(t_testBuffer.size());
 }
 
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_create_test_post(int32_t id, int32_t userId, const char* title) {
-    g_testBuffer = createPostFlatBufferInternal(id, userId, title);
-    return g_testBuffer.data();
+    t_testBuffer = createPostFlatBufferInternal(id, userId, title);
+    return t_testBuffer.data();
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_get_stats_count(void* handle) {
-    g_statsBuffer = static_cast<FlatSQLDatabase*>(handle)->getStats();
-    return static_cast<int>(g_statsBuffer.size());
+    state(handle).statsBuffer = state(handle).db.getStats();
+    return static_cast<int>(state(handle).statsBuffer.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+const char* flatsql_get_stat_table_name(void* handle, int index) {
+    if (index < 0 || index >= static_cast<int>(state(handle).statsBuffer.size())) return "";
+    return state(handle).statsBuffer[index].tableName.c_str();
 }
 
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_get_stat_table_name(int index) {
-    if (index < 0 || index >= static_cast<int>(g_statsBuffer.size())) return "";
-    return g_statsBuffer[index].tableName.c_str();
+const char* flatsql_get_stat_file_id(void* handle, int index) {
+    if (index < 0 || index >= static_cast<int>(state(handle).statsBuffer.size())) return "";
+    return state(handle).statsBuffer[index].fileId.c_str();
 }
 
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_get_stat_file_id(int index) {
-    if (index < 0 || index >= static_cast<int>(g_statsBuffer.size())) return "";
-    return g_statsBuffer[index].fileId.c_str();
+double flatsql_get_stat_record_count(void* handle, int index) {
+    if (index < 0 || index >= static_cast<int>(state(handle).statsBuffer.size())) return 0;
+    return static_cast<double>(state(handle).statsBuffer[index].recordCount);
 }
 
 EMSCRIPTEN_KEEPALIVE
-double flatsql_get_stat_record_count(int index) {
-    if (index < 0 || index >= static_cast<int>(g_statsBuffer.size())) return 0;
-    return static_cast<double>(g_statsBuffer[index].recordCount);
+double flatsql_get_stat_memory_bytes(void* handle, int index) {
+    if (index < 0 || index >= static_cast<int>(state(handle).statsBuffer.size())) return 0;
+    return static_cast<double>(state(handle).statsBuffer[index].memoryBytes);
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_mark_deleted(void* handle, const char* tableName, double sequence) {
-    static_cast<FlatSQLDatabase*>(handle)->markDeleted(tableName, static_cast<uint64_t>(sequence));
+    state(handle).db.markDeleted(tableName, static_cast<uint64_t>(sequence));
 }
 
 EMSCRIPTEN_KEEPALIVE
 double flatsql_get_deleted_count(void* handle, const char* tableName) {
-    return static_cast<double>(static_cast<FlatSQLDatabase*>(handle)->getDeletedCount(tableName));
+    return static_cast<double>(state(handle).db.getDeletedCount(tableName));
 }
 
 EMSCRIPTEN_KEEPALIVE
 void flatsql_clear_tombstones(void* handle, const char* tableName) {
-    static_cast<FlatSQLDatabase*>(handle)->clearTombstones(tableName);
+    state(handle).db.clearTombstones(tableName);
+}
+
+// Queries read records up to sequence only (0 = latest); see
+// FlatSQLDatabase::setAsOfSequence
+EMSCRIPTEN_KEEPALIVE
+void flatsql_set_as_of(void* handle, double sequence) {
+    state(handle).db.setAsOfSequence(static_cast<uint64_t>(sequence));
+}
+
+// Latest published sequence, a watermark for flatsql_set_as_of
+EMSCRIPTEN_KEEPALIVE
+double flatsql_visible_sequence(void* handle) {
+    return static_cast<double>(state(handle).db.getVisibleSequence());
+}
+
+// Latest-wins ingest by primary key (see FlatSQLDatabase::setUpsertMode).
+// Returns 0 on error.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_upsert_mode(void* handle, const char* tableName, int enabled, int keepHistory) {
+    try {
+        state(handle).db.setUpsertMode(tableName, enabled != 0, keepHistory != 0);
+        state(handle).lastError.clear();
+        return 1;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return 0;
+    }
+}
+
+// Index keyColumns of a table together, carrying includeColumns too (both
+// comma-separated; see FlatSQLDatabase::addCompositeIndex). Returns 0 on error.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_add_composite_index(void* handle, const char* tableName, const char* name,
+                                const char* keyColumns, const char* includeColumns) {
+    auto split = [](const char* list) {
+        std::vector<std::string> names;
+        std::string text = list ? list : "";
+        size_t start = 0;
+        while (start <= text.size()) {
+            size_t end = text.find(',', start);
+            if (end == std::string::npos) end = text.size();
+            if (end > start) names.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+        return names;
+    };
+    try {
+        state(handle).db.addCompositeIndex(tableName, name, split(keyColumns), split(includeColumns));
+        state(handle).lastError.clear();
+        return 1;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return 0;
+    }
+}
+
+// Check a table's records against its schema: 0 = trusted, 1 = strict (at
+// ingest), 2 = lazy (on first read); see FlatSQLDatabase::setVerificationMode.
+// A null tableName sets every table. Returns 0 on error.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_verification_mode(void* handle, const char* tableName, int mode) {
+    try {
+        if (mode < 0 || mode > 2) {
+            throw std::runtime_error("Unknown verification mode: " + std::to_string(mode));
+        }
+        VerificationMode verificationMode = static_cast<VerificationMode>(mode);
+        if (tableName) {
+            state(handle).db.setVerificationMode(tableName, verificationMode);
+        } else {
+            state(handle).db.setVerificationMode(verificationMode);
+        }
+        state(handle).lastError.clear();
+        return 1;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return 0;
+    }
+}
+
+// Malformed records of a table found so far, -1 on error
+EMSCRIPTEN_KEEPALIVE
+double flatsql_verification_failures(void* handle, const char* tableName) {
+    try {
+        return static_cast<double>(state(handle).db.getVerificationFailures(tableName));
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
+}
+
+// Move to a newer version of the schema (FlatSQLDatabase::evolveSchema):
+// the new schema version, 0 on error
+EMSCRIPTEN_KEEPALIVE
+int flatsql_evolve_schema(void* handle, const char* schemaSource) {
+    try {
+        uint32_t version = state(handle).db.evolveSchema(std::string(schemaSource));
+        state(handle).lastError.clear();
+        return static_cast<int>(version);
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return 0;
+    }
+}
+
+// Index up to maxRecords stored records into indexes added by an evolved
+// schema: 1 = finished, 0 = more steps needed, -1 = error
+EMSCRIPTEN_KEEPALIVE
+int flatsql_backfill_step(void* handle, double maxRecords) {
+    try {
+        bool done = state(handle).db.backfillStep(static_cast<size_t>(maxRecords));
+        state(handle).lastError.clear();
+        return done ? 1 : 0;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
+}
+
+// Compact up to maxBytes of records: 1 = finished, 0 = more steps needed, -1 = error
+EMSCRIPTEN_KEEPALIVE
+int flatsql_compact_step(void* handle, double maxBytes) {
+    try {
+        bool done = state(handle).db.compactStep(static_cast<size_t>(maxBytes));
+        state(handle).lastError.clear();
+        return done ? 1 : 0;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
 }
 
 // Source listing
 EMSCRIPTEN_KEEPALIVE
 int flatsql_get_sources_count(void* handle) {
-    g_sourcesBuffer = static_cast<FlatSQLDatabase*>(handle)->listSources();
-    return static_cast<int>(g_sourcesBuffer.size());
+    state(handle).sourcesBuffer = state(handle).db.listSources();
+    return static_cast<int>(state(handle).sourcesBuffer.size());
 }
 
 EMSCRIPTEN_KEEPALIVE
-const char* flatsql_get_source_name(int index) {
-    if (index < 0 || index >= static_cast<int>(g_sourcesBuffer.size())) return "";
-    return g_sourcesBuffer[index].c_str();
+const char* flatsql_get_source_name(void* handle, int index) {
+    if (index < 0 || index >= static_cast<int>(state(handle).sourcesBuffer.size())) return "";
+    return state(handle).sourcesBuffer[index].c_str();
 }
 
 // ==================== Raw FlatBuffer Access API ====================
 // These functions provide direct memory access to FlatBuffer data
 
-// Global state for raw FlatBuffer access
-static const uint8_t* g_rawFlatBuffer = nullptr;
-static uint32_t g_rawFlatBufferSize = 0;
-static uint64_t g_rawFlatBufferSequence = 0;
-
 // Get raw FlatBuffer pointer by table name and indexed column value
 // Returns pointer to FlatBuffer in WASM memory, or 0 if not found
-// Call flatsql_get_raw_flatbuffer_size() after to get the size
+// Call flatsql_get_raw_flatbuffer_size(void* handle) after to get the size
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_get_flatbuffer_by_id(void* handle, const char* tableName, int32_t id) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
-    g_rawFlatBuffer = db->findRawByIndex(tableName, "id", static_cast<int64_t>(id),
-                                          &g_rawFlatBufferSize, &g_rawFlatBufferSequence);
-    return g_rawFlatBuffer;
+    FlatSQLDatabase* db = &state(handle).db;
+    state(handle).rawFlatBuffer = db->findRawByIndex(tableName, "id", static_cast<int64_t>(id),
+                                          &state(handle).rawFlatBufferSize, &state(handle).rawFlatBufferSequence);
+    return state(handle).rawFlatBuffer;
 }
 
 // Get raw FlatBuffer pointer by table name and email (string key)
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_get_flatbuffer_by_email(void* handle, const char* tableName, const char* email) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
-    g_rawFlatBuffer = db->findRawByIndex(tableName, "email", std::string(email),
-                                          &g_rawFlatBufferSize, &g_rawFlatBufferSequence);
-    return g_rawFlatBuffer;
+    FlatSQLDatabase* db = &state(handle).db;
+    state(handle).rawFlatBuffer = db->findRawByIndex(tableName, "email", std::string(email),
+                                          &state(handle).rawFlatBufferSize, &state(handle).rawFlatBufferSequence);
+    return state(handle).rawFlatBuffer;
 }
 
 // Get size of the last accessed raw FlatBuffer
 EMSCRIPTEN_KEEPALIVE
-int flatsql_get_raw_flatbuffer_size() {
-    return static_cast<int>(g_rawFlatBufferSize);
+int flatsql_get_raw_flatbuffer_size(void* handle) {
+    return static_cast<int>(state(handle).rawFlatBufferSize);
 }
 
 // Get sequence (rowid) of the last accessed raw FlatBuffer
 EMSCRIPTEN_KEEPALIVE
-double flatsql_get_raw_flatbuffer_sequence() {
-    return static_cast<double>(g_rawFlatBufferSequence);
+double flatsql_get_raw_flatbuffer_sequence(void* handle) {
+    return static_cast<double>(state(handle).rawFlatBufferSequence);
 }
 
 // Get the underlying storage buffer pointer (for advanced use)
-// This returns the base address of all FlatBuffer storage
+// This returns the base address of all FlatBuffer storage (null for segmented stores)
 EMSCRIPTEN_KEEPALIVE
 const uint8_t* flatsql_get_storage_buffer(void* handle) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return db->getStorage().getDataBuffer();
 }
 
 // Get the current storage buffer size
 EMSCRIPTEN_KEEPALIVE
 double flatsql_get_storage_size(void* handle) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return static_cast<double>(db->getStorage().getDataSize());
 }
 
@@ -529,34 +1139,34 @@ double flatsql_get_storage_size(void* handle) {
 EMSCRIPTEN_KEEPALIVE
 int flatsql_set_encryption_key(void* handle, const uint8_t* key, int keySize) {
     try {
-        auto* db = static_cast<FlatSQLDatabase*>(handle);
+        FlatSQLDatabase* db = &state(handle).db;
         db->setEncryptionKey(key, static_cast<size_t>(keySize));
         return 1;
     } catch (const std::exception& e) {
-        g_lastError = e.what();
+        state(handle).lastError = e.what();
         return 0;
     }
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_is_encrypted(void* handle) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return db->isEncrypted() ? 1 : 0;
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_encrypt_buffer(void* handle, uint8_t* buffer, int bufferSize,
                             const uint8_t* schema, int schemaSize) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     auto* ctx = db->getEncryptionContext();
     if (!ctx) {
-        g_lastError = "No encryption key set";
+        state(handle).lastError = "No encryption key set";
         return 0;
     }
     auto result = flatbuffers::EncryptBuffer(buffer, static_cast<size_t>(bufferSize),
                                               schema, static_cast<size_t>(schemaSize), *ctx);
     if (!result.ok()) {
-        g_lastError = result.message;
+        state(handle).lastError = result.message;
         return 0;
     }
     return 1;
@@ -565,16 +1175,16 @@ int flatsql_encrypt_buffer(void* handle, uint8_t* buffer, int bufferSize,
 EMSCRIPTEN_KEEPALIVE
 int flatsql_decrypt_buffer(void* handle, uint8_t* buffer, int bufferSize,
                             const uint8_t* schema, int schemaSize) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     auto* ctx = db->getEncryptionContext();
     if (!ctx) {
-        g_lastError = "No encryption key set";
+        state(handle).lastError = "No encryption key set";
         return 0;
     }
     auto result = flatbuffers::DecryptBuffer(buffer, static_cast<size_t>(bufferSize),
                                               schema, static_cast<size_t>(schemaSize), *ctx);
     if (!result.ok()) {
-        g_lastError = result.message;
+        state(handle).lastError = result.message;
         return 0;
     }
     return 1;
@@ -585,33 +1195,234 @@ int flatsql_decrypt_buffer(void* handle, uint8_t* buffer, int bufferSize,
 EMSCRIPTEN_KEEPALIVE
 int flatsql_set_hmac_verification(void* handle, int enabled) {
     try {
-        auto* db = static_cast<FlatSQLDatabase*>(handle);
+        FlatSQLDatabase* db = &state(handle).db;
         db->setHMACVerification(enabled != 0);
         return 1;
     } catch (const std::exception& e) {
-        g_lastError = e.what();
+        state(handle).lastError = e.what();
         return 0;
     }
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_is_hmac_enabled(void* handle) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return db->isHMACVerificationEnabled() ? 1 : 0;
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_compute_hmac(void* handle, const uint8_t* buffer, int bufferSize, uint8_t* outMAC) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return db->computeHMAC(buffer, static_cast<size_t>(bufferSize), outMAC) ? 1 : 0;
 }
 
 EMSCRIPTEN_KEEPALIVE
 int flatsql_verify_hmac(void* handle, const uint8_t* buffer, int bufferSize, const uint8_t* mac) {
-    auto* db = static_cast<FlatSQLDatabase*>(handle);
+    FlatSQLDatabase* db = &state(handle).db;
     return db->verifyHMAC(buffer, static_cast<size_t>(bufferSize), mac) ? 1 : 0;
 }
 
+// Ingest a size-prefixed stream with one 32-byte MAC per record (macs is
+// macCount * 32 bytes). Returns bytes consumed, or -1 with nothing stored
+// if any record fails verification.
+EMSCRIPTEN_KEEPALIVE
+double flatsql_ingest_verified(void* handle, const uint8_t* data, size_t length,
+                               const uint8_t* macs, size_t macCount) {
+    try {
+        size_t consumed = state(handle).db.ingestVerified(data, length, macs, macCount);
+        state(handle).lastError.clear();
+        return static_cast<double>(consumed);
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return -1;
+    }
+}
+
+// ==================== Parallel Scan and Ingest API ====================
+
+// Web Workers the pthreads build starts with (see CMakeLists.txt)
+#ifndef FLATSQL_WASM_THREAD_POOL
+#define FLATSQL_WASM_THREAD_POOL 8
+#endif
+
+// Threads one pool can use including the caller: 1 unless this is the
+// pthreads build (flatsql-mt). A pool's threads must come from the workers
+// started with the module, and a scan and an ingest pool each get half.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_max_threads() {
+#ifdef __EMSCRIPTEN_PTHREADS__
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<int>(std::min<unsigned>(cores, FLATSQL_WASM_THREAD_POOL / 2 + 1));
+#else
+    return 1;
+#endif
+}
+
+// Threads for flatsql_aggregate scans and for index key extraction during
+// ingest, including the caller (0 or more than flatsql_max_threads() =
+// flatsql_max_threads(), 1 = inline). Returns the threads used.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_scan_threads(void* handle, int threads) {
+    int max = flatsql_max_threads();
+    threads = threads <= 0 || threads > max ? max : threads;
+    state(handle).db.setScanThreads(static_cast<size_t>(threads));
+    return threads;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_ingest_threads(void* handle, int threads) {
+    int max = flatsql_max_threads();
+    threads = threads <= 0 || threads > max ? max : threads;
+    state(handle).db.setIngestThreads(static_cast<size_t>(threads));
+    return threads;
+}
+
+// Aggregates (e.g. "COUNT(*), SUM(score)") over a table or unified view on
+// the scan pool, grouped by groupBy unless it is empty; read the result
+// like flatsql_query's. Returns 0 on error.
+EMSCRIPTEN_KEEPALIVE
+int flatsql_aggregate(void* handle, const char* tableName, const char* aggregates, const char* groupBy) {
+    try {
+        std::vector<AggregateSpec> specs;
+        if (!parseAggregates(aggregates, specs)) {
+            throw std::runtime_error(std::string("Invalid aggregates: ") + (aggregates ? aggregates : ""));
+        }
+        state(handle).lastResult = state(handle).db.aggregate(tableName, specs, groupBy ? groupBy : "");
+        state(handle).lastError.clear();
+        return 1;
+    } catch (const std::exception& e) {
+        state(handle).lastError = e.what();
+        return 0;
+    }
+}
+
+// ==================== Query Stats API ====================
+
+// Record counters and timings of each query (off by default); all recent
+// queries can be read with SELECT * FROM flatsql_stats
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_query_stats(void* handle, int enabled) {
+    state(handle).db.setQueryStatsEnabled(enabled != 0);
+    return 1;
+}
+
+// One counter of the last recorded query, by its flatsql_stats column name
+// (e.g. "rows_scanned"); -1 if the name is unknown or nothing was recorded
+EMSCRIPTEN_KEEPALIVE
+double flatsql_last_query_stat(void* handle, const char* name) {
+    QueryStats stats = state(handle).db.getLastQueryStats();
+    const uint64_t* counter = name && stats.id ? findQueryStatsCounter(stats, name) : nullptr;
+    return counter ? static_cast<double>(*counter) : -1;
+}
+
+// ==================== Memory API ====================
+
+// One figure of FlatSQLDatabase::getMemoryUsage() by name: "total",
+// StorageMemory ("stream", "mapped", "cold", "cold_cache", "sequence_map",
+// "chunk_table", "record_lists"), TableMemory ("record_infos", "indexes",
+// "index_pages", "column_caches", "zone_maps", "tombstones") and
+// EngineMemory ("page_cache", "statements", "schema", "result_cache").
+// With a table name the TableMemory figures and "total" are that table's,
+// otherwise summed over tables. -1 for an unknown name or table.
+EMSCRIPTEN_KEEPALIVE
+double flatsql_memory_usage(void* handle, const char* tableName, const char* name) {
+    if (!name) return -1;
+    MemoryUsage usage = state(handle).db.getMemoryUsage();
+    std::string table = tableName ? tableName : "";
+    std::string field = name;
+
+    TableMemory tables;
+    bool found = table.empty();
+    for (const TableMemory& entry : usage.tables) {
+        if (!table.empty() && entry.tableName != table) continue;
+        found = true;
+        tables.recordInfoBytes += entry.recordInfoBytes;
+        tables.indexBytes += entry.indexBytes;
+        tables.indexPageBytes += entry.indexPageBytes;
+        tables.columnCacheBytes += entry.columnCacheBytes;
+        tables.zoneMapBytes += entry.zoneMapBytes;
+        tables.tombstoneBytes += entry.tombstoneBytes;
+        tables.verificationBytes += entry.verificationBytes;
+    }
+    if (!found) return -1;
+
+    const std::pair<const char*, uint64_t> fields[] = {
+        {"total", table.empty() ? usage.total() : tables.total()},
+        {"stream", usage.storage.streamBytes},
+        {"mapped", usage.storage.mappedBytes},
+        {"cold", usage.storage.coldBytes},
+        {"cold_cache", usage.storage.coldCacheBytes},
+        {"sequence_map", usage.storage.sequenceMapBytes},
+        {"chunk_table", usage.storage.chunkTableBytes},
+        {"record_lists", usage.storage.recordListBytes},
+        {"record_infos", tables.recordInfoBytes},
+        {"indexes", tables.indexBytes},
+        {"index_pages", tables.indexPageBytes},
+        {"column_caches", tables.columnCacheBytes},
+        {"zone_maps", tables.zoneMapBytes},
+        {"tombstones", tables.tombstoneBytes},
+        {"verification", tables.verificationBytes},
+        {"page_cache", usage.engine.pageCacheBytes},
+        {"statements", usage.engine.statementBytes},
+        {"schema", usage.engine.schemaBytes},
+        {"result_cache", usage.engine.resultCacheBytes},
+    };
+    for (const auto& [label, bytes] : fields) {
+        if (field == label) return static_cast<double>(bytes);
+    }
+    return -1;
+}
+
+// Soft and hard limits in bytes (0 = none); see MemoryLimits
+EMSCRIPTEN_KEEPALIVE
+int flatsql_set_memory_limits(void* handle, double softBytes, double hardBytes, int compactOverSoft) {
+    MemoryLimits limits;
+    limits.softBytes = static_cast<uint64_t>(softBytes);
+    limits.hardBytes = static_cast<uint64_t>(hardBytes);
+    limits.compactOverSoft = compactOverSoft != 0;
+    state(handle).db.setMemoryLimits(limits);
+    return 1;
+}
+
+// "footprint", "reliefs", "compactions" or "rejections" of
+// MemoryLimitStats; -1 for an unknown name
+EMSCRIPTEN_KEEPALIVE
+double flatsql_memory_limit_stat(void* handle, const char* name) {
+    MemoryLimitStats stats = state(handle).db.getMemoryLimitStats();
+    std::string field = name ? name : "";
+    if (field == "footprint") return static_cast<double>(stats.footprint);
+    if (field == "reliefs") return static_cast<double>(stats.reliefs);
+    if (field == "compactions") return static_cast<double>(stats.compactions);
+    if (field == "rejections") return static_cast<double>(stats.rejections);
+    return -1;
+}
+
+// ==================== Tracing ====================
+
+// 1 if this build records FLATSQL_TRACE_SCOPE events (FLATSQL_ENABLE_TRACING)
+EMSCRIPTEN_KEEPALIVE
+int flatsql_trace_compiled() {
+    return TRACING_COMPILED_IN ? 1 : 0;
+}
+
+// Recorded events as Chrome trace JSON (NUL-terminated, length from
+// flatsql_trace_export_size); valid until the next export on this thread
+EMSCRIPTEN_KEEPALIVE
+const char* flatsql_trace_export() {
+    t_traceJson = traceExportChromeJson();
+    return t_traceJson.c_str();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int flatsql_trace_export_size() {
+    return static_cast<int>(t_traceJson.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+void flatsql_trace_clear() {
+    traceClear();
+}
+
 }  // extern "C"
 
 #endif  // __EMSCRIPTEN__
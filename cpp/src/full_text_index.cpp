@@ -0,0 +1,333 @@
+#include "flatsql/full_text_index.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+
+namespace flatsql {
+
+// BM25 term-frequency saturation and length normalization (the usual values)
+static constexpr double BM25_K1 = 1.2;
+static constexpr double BM25_B = 0.75;
+
+static bool termByte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+// Call f(term) for each run of term bytes in text, lowercased
+template <typename F>
+static void forEachToken(std::string_view text, F&& f) {
+    std::string term;
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !termByte(static_cast<unsigned char>(text[i]))) i++;
+        term.clear();
+        while (i < text.size() && termByte(static_cast<unsigned char>(text[i]))) {
+            char c = text[i++];
+            term.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+        }
+        if (!term.empty()) f(term);
+    }
+}
+
+static bool startsWith(std::string_view text, std::string_view prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+FullTextIndex::FullTextIndex(const std::string& tableName, const std::string& columnName)
+    : Index(tableName, columnName, ValueType::String) {}
+
+std::vector<std::string> FullTextIndex::tokenize(std::string_view text) {
+    std::vector<std::string> terms;
+    forEachToken(text, [&terms](const std::string& term) { terms.push_back(term); });
+    return terms;
+}
+
+std::vector<FullTextIndex::Clause> FullTextIndex::parseQuery(std::string_view query) {
+    std::vector<Clause> clauses;
+    bool joinNext = false;    // Previous word was OR
+    bool negateNext = false;  // Previous word was NOT
+    size_t i = 0;
+    while (i < query.size()) {
+        while (i < query.size() && std::isspace(static_cast<unsigned char>(query[i]))) i++;
+        size_t start = i;
+        while (i < query.size() && !std::isspace(static_cast<unsigned char>(query[i]))) i++;
+        std::string_view raw = query.substr(start, i - start);
+        if (raw.empty()) break;
+
+        if (raw == "OR") {
+            joinNext = !clauses.empty() && !clauses.back().negated;
+            continue;
+        }
+        if (raw == "NOT") {
+            negateNext = true;
+            continue;
+        }
+        bool negated = negateNext;
+        negateNext = false;
+        if (raw.front() == '-') {
+            negated = true;
+            raw.remove_prefix(1);
+        }
+        bool prefix = !raw.empty() && raw.back() == '*';
+        if (prefix) raw.remove_suffix(1);
+
+        std::vector<std::string> terms = tokenize(raw);
+        for (size_t t = 0; t < terms.size(); t++) {
+            QueryWord word{std::move(terms[t]), prefix && t + 1 == terms.size()};
+            if (t == 0 && joinNext && !negated) {
+                clauses.back().words.push_back(std::move(word));
+            } else {
+                clauses.push_back({{std::move(word)}, negated});
+            }
+        }
+        joinNext = false;
+    }
+    return clauses;
+}
+
+template <typename F>
+void FullTextIndex::forEachTerm(const QueryWord& word, F&& f) const {
+    if (!word.prefix) {
+        auto it = terms_.find(word.text);
+        if (it != terms_.end()) f(it->second);
+        return;
+    }
+    for (auto it = terms_.lower_bound(word.text); it != terms_.end() && startsWith(it->first, word.text); ++it) {
+        f(it->second);
+    }
+}
+
+std::vector<uint32_t> FullTextIndex::clauseRows(const Clause& clause) const {
+    std::vector<uint32_t> rows;
+    size_t terms = 0;
+    for (const QueryWord& word : clause.words) {
+        forEachTerm(word, [&](const Term& term) {
+            terms++;
+            for (const Posting& posting : term.postings) rows.push_back(posting.row);
+        });
+    }
+    if (terms > 1) {
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    }
+    return rows;
+}
+
+void FullTextIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    const std::string* text = std::get_if<std::string>(&key);
+    if (!text) {
+        throw std::runtime_error(std::holds_alternative<std::monostate>(key)
+            ? "Failed to insert index entry: NULL key"
+            : "Failed to insert index entry: key type does not match " + name_);
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    insertText(*text, dataOffset, dataLength, sequence);
+    stats_.add(key);
+}
+
+void FullTextIndex::insertText(std::string_view text, uint64_t dataOffset, uint32_t dataLength,
+                               uint64_t sequence) {
+    if (rows_.size() >= UINT32_MAX) {
+        throw std::runtime_error("Full-text index is full: " + name_);
+    }
+    std::vector<std::string> tokens = tokenize(text);
+    std::sort(tokens.begin(), tokens.end());
+
+    // One posting per distinct term, so each term's rows stay ascending
+    uint32_t row = static_cast<uint32_t>(rows_.size());
+    for (size_t i = 0; i < tokens.size();) {
+        size_t j = i;
+        while (j < tokens.size() && tokens[j] == tokens[i]) j++;
+        auto it = terms_.find(tokens[i]);
+        if (it == terms_.end()) it = terms_.emplace(std::move(tokens[i]), Term()).first;
+        it->second.postings.push_back({row, static_cast<uint32_t>(j - i)});
+        i = j;
+    }
+    rows_.push_back({dataOffset, sequence, dataLength, static_cast<uint32_t>(tokens.size())});
+    totalTerms_ += tokens.size();
+}
+
+void FullTextIndex::insertBatch(std::vector<IndexEntry>& entries) {
+    bulkLoad(entries);  // Rows are independent documents: no sort needed
+}
+
+void FullTextIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    for (const auto& entry : sortedEntries) {
+        insert(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+    }
+}
+
+std::vector<IndexEntry> FullTextIndex::search(const Value& query) const {
+    std::vector<IndexEntry> results;
+    const std::string* text = std::get_if<std::string>(&query);
+    if (!text) return results;
+    std::vector<Clause> clauses = parseQuery(*text);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<uint32_t> matched, rows, kept;
+    bool positive = false;
+    for (const Clause& clause : clauses) {
+        if (clause.negated) continue;
+        rows = clauseRows(clause);
+        if (!positive) {
+            matched.swap(rows);
+            positive = true;
+        } else {
+            kept.clear();
+            std::set_intersection(matched.begin(), matched.end(), rows.begin(), rows.end(),
+                                  std::back_inserter(kept));
+            matched.swap(kept);
+        }
+        if (matched.empty()) return results;
+    }
+    if (!positive) return results;
+    for (const Clause& clause : clauses) {
+        if (!clause.negated) continue;
+        rows = clauseRows(clause);
+        kept.clear();
+        std::set_difference(matched.begin(), matched.end(), rows.begin(), rows.end(), std::back_inserter(kept));
+        matched.swap(kept);
+    }
+
+    // BM25: each positive term adds its weight in the rows it occurs in
+    std::vector<double> scores(matched.size(), 0.0);
+    const double rowCount = static_cast<double>(rows_.size());
+    const double averageTerms = rows_.empty() ? 1.0 : std::max(1.0, static_cast<double>(totalTerms_) / rowCount);
+    for (const Clause& clause : clauses) {
+        if (clause.negated) continue;
+        for (const QueryWord& word : clause.words) {
+            forEachTerm(word, [&](const Term& term) {
+                double occurring = static_cast<double>(term.postings.size());
+                double idf = std::log(1.0 + (rowCount - occurring + 0.5) / (occurring + 0.5));
+                size_t m = 0;
+                for (const Posting& posting : term.postings) {
+                    while (m < matched.size() && matched[m] < posting.row) m++;
+                    if (m == matched.size()) break;
+                    if (matched[m] != posting.row) continue;
+                    double tf = posting.occurrences;
+                    double norm = 1.0 - BM25_B + BM25_B * rows_[posting.row].terms / averageTerms;
+                    scores[m] += idf * tf * (BM25_K1 + 1.0) / (tf + BM25_K1 * norm);
+                }
+            });
+        }
+    }
+
+    results.reserve(matched.size());
+    for (size_t m = 0; m < matched.size(); m++) {
+        const Row& row = rows_[matched[m]];
+        results.push_back({scores[m], row.offset, row.length, row.sequence});
+    }
+    auto bySequence = [](const IndexEntry& a, const IndexEntry& b) { return a.sequence < b.sequence; };
+    if (!std::is_sorted(results.begin(), results.end(), bySequence)) {
+        std::sort(results.begin(), results.end(), bySequence);
+    }
+    return results;
+}
+
+bool FullTextIndex::searchFirst(const Value& query, IndexEntry& result) const {
+    std::vector<IndexEntry> results = search(query);
+    if (results.empty()) return false;
+    result = std::move(results.front());
+    return true;
+}
+
+bool FullTextIndex::searchFirstString(const std::string& query, uint64_t& outOffset,
+                                      uint32_t& outLength, uint64_t& outSequence) const {
+    IndexEntry entry;
+    if (!searchFirst(Value(query), entry)) return false;
+    outOffset = entry.dataOffset;
+    outLength = entry.dataLength;
+    outSequence = entry.sequence;
+    return true;
+}
+
+bool FullTextIndex::searchFirstInt64(int64_t, uint64_t&, uint32_t&, uint64_t&) const {
+    return false;  // Queries are strings
+}
+
+std::vector<IndexEntry> FullTextIndex::range(const Value&, const Value&) const {
+    return {};  // Terms have no order worth scanning by
+}
+
+std::vector<IndexEntry> FullTextIndex::all() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> texts(rows_.size());
+    for (const auto& [text, term] : terms_) {
+        for (const Posting& posting : term.postings) {
+            std::string& row = texts[posting.row];
+            for (uint32_t i = 0; i < posting.occurrences; i++) {
+                if (!row.empty()) row.push_back(' ');
+                row += text;
+            }
+        }
+    }
+    std::vector<IndexEntry> entries;
+    entries.reserve(rows_.size());
+    for (size_t i = 0; i < rows_.size(); i++) {
+        entries.push_back({std::move(texts[i]), rows_[i].offset, rows_[i].length, rows_[i].sequence});
+    }
+    return entries;
+}
+
+void FullTextIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    terms_.clear();
+    rows_.clear();
+    totalTerms_ = 0;
+    stats_.clear();
+}
+
+size_t FullTextIndex::estimateMatches(std::string_view query) const {
+    std::vector<Clause> clauses = parseQuery(query);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t estimate = 0;
+    bool positive = false;
+    for (const Clause& clause : clauses) {
+        if (clause.negated) continue;
+        size_t rows = 0;
+        for (const QueryWord& word : clause.words) {
+            forEachTerm(word, [&rows](const Term& term) { rows += term.postings.size(); });
+        }
+        estimate = positive ? std::min(estimate, rows) : rows;
+        positive = true;
+    }
+    return std::min(estimate, rows_.size());
+}
+
+size_t FullTextIndex::getTermCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return terms_.size();
+}
+
+size_t FullTextIndex::memoryBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = rows_.capacity() * sizeof(Row);
+    for (const auto& [text, term] : terms_) {
+        bytes += text.capacity() + sizeof(std::string) + 3 * sizeof(void*) + sizeof(Term) +
+                 term.postings.capacity() * sizeof(Posting);
+    }
+    return bytes;
+}
+
+bool FullTextIndex::matches(std::string_view query, std::string_view text) {
+    std::vector<Clause> clauses = parseQuery(query);
+    std::vector<std::string> terms = tokenize(text);
+    std::sort(terms.begin(), terms.end());
+
+    auto found = [&terms](const QueryWord& word) {
+        auto it = std::lower_bound(terms.begin(), terms.end(), word.text);
+        return it != terms.end() && (word.prefix ? startsWith(*it, word.text) : *it == word.text);
+    };
+    bool positive = false;
+    for (const Clause& clause : clauses) {
+        bool any = std::any_of(clause.words.begin(), clause.words.end(), found);
+        if (any == clause.negated) return false;
+        positive = positive || !clause.negated;
+    }
+    return positive;
+}
+
+}  // namespace flatsql
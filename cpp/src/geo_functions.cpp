@@ -1,11 +1,27 @@
 #include "flatsql/geo_functions.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 namespace flatsql {
 
 static constexpr double EARTH_RADIUS_KM = 6371.0;
 static constexpr double DEG_TO_RAD = M_PI / 180.0;
 
+// Great-circle distance in km between two points given in degrees
+static double haversineKm(double lat1, double lon1, double lat2, double lon2) {
+    lat1 *= DEG_TO_RAD;
+    lon1 *= DEG_TO_RAD;
+    lat2 *= DEG_TO_RAD;
+    lon2 *= DEG_TO_RAD;
+    double dlat = lat2 - lat1;
+    double dlon = lon2 - lon1;
+    double a = sin(dlat / 2) * sin(dlat / 2) +
+               cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+    return EARTH_RADIUS_KM * c;
+}
+
 // Haversine distance between two lat/lon points (returns km)
 static void geoDistanceFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
     if (argc != 4) {
@@ -19,18 +35,8 @@ static void geoDistanceFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv
         }
     }
 
-    double lat1 = sqlite3_value_double(argv[0]) * DEG_TO_RAD;
-    double lon1 = sqlite3_value_double(argv[1]) * DEG_TO_RAD;
-    double lat2 = sqlite3_value_double(argv[2]) * DEG_TO_RAD;
-    double lon2 = sqlite3_value_double(argv[3]) * DEG_TO_RAD;
-
-    double dlat = lat2 - lat1;
-    double dlon = lon2 - lon1;
-    double a = sin(dlat / 2) * sin(dlat / 2) +
-               cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
-    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-
-    sqlite3_result_double(ctx, EARTH_RADIUS_KM * c);
+    sqlite3_result_double(ctx, haversineKm(sqlite3_value_double(argv[0]), sqlite3_value_double(argv[1]),
+                                           sqlite3_value_double(argv[2]), sqlite3_value_double(argv[3])));
 }
 
 // Check if point is within bounding box
@@ -70,27 +76,250 @@ static void geoWithinRadiusFunc(sqlite3_context* ctx, int argc, sqlite3_value**
         }
     }
 
-    double lat1 = sqlite3_value_double(argv[0]) * DEG_TO_RAD;
-    double lon1 = sqlite3_value_double(argv[1]) * DEG_TO_RAD;
-    double lat2 = sqlite3_value_double(argv[2]) * DEG_TO_RAD;
-    double lon2 = sqlite3_value_double(argv[3]) * DEG_TO_RAD;
+    double distance = haversineKm(sqlite3_value_double(argv[0]), sqlite3_value_double(argv[1]),
+                                  sqlite3_value_double(argv[2]), sqlite3_value_double(argv[3]));
     double radiusKm = sqlite3_value_double(argv[4]);
 
-    double dlat = lat2 - lat1;
-    double dlon = lon2 - lon1;
-    double a = sin(dlat / 2) * sin(dlat / 2) +
-               cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
-    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-    double distance = EARTH_RADIUS_KM * c;
-
     sqlite3_result_int(ctx, distance <= radiusKm ? 1 : 0);
 }
 
+// ==================== Spatial index ====================
+
+static constexpr int GEO_CELL_BITS = 24;
+static constexpr uint32_t GEO_CELLS = uint32_t(1) << GEO_CELL_BITS;
+
+// Region values: a tag byte, then the doubles of geo_radius / geo_box
+static constexpr uint8_t REGION_RADIUS = 'R';
+static constexpr uint8_t REGION_BOX = 'B';
+static constexpr int RADIUS_BYTES = 1 + 3 * sizeof(double);
+static constexpr int BOX_BYTES = 1 + 4 * sizeof(double);
+
+// Degrees added around a circle's bounds, for rounding in the bound formulas
+static constexpr double GEO_BOUND_SLACK = 1e-6;
+
+// Grid cell of a coordinate in [min, min + span]
+static uint32_t quantize(double value, double min, double span) {
+    double cell = std::floor((value - min) / span * GEO_CELLS);
+    if (!(cell > 0)) return 0;  // Also NaN
+    if (cell >= GEO_CELLS - 1) return GEO_CELLS - 1;
+    return static_cast<uint32_t>(cell);
+}
+
+// Spread the low GEO_CELL_BITS bits of v to the even bit positions
+static uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+static int64_t interleave(uint32_t latCell, uint32_t lonCell) {
+    return static_cast<int64_t>((spreadBits(latCell) << 1) | spreadBits(lonCell));
+}
+
+int64_t geoCellKey(double lat, double lon) {
+    return interleave(quantize(lat, -90.0, 180.0), quantize(lon, -180.0, 360.0));
+}
+
+bool decodeGeoPoint(const void* blob, int length, double& lat, double& lon) {
+    if (!blob || length != GEO_POINT_BYTES) return false;
+    std::memcpy(&lat, blob, sizeof(double));
+    std::memcpy(&lon, static_cast<const uint8_t*>(blob) + sizeof(double), sizeof(double));
+    return true;
+}
+
+bool GeoRegion::decode(const void* blob, int length, GeoRegion& out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(blob);
+    if (!bytes || length < 1) return false;
+    double v[4];
+    if (bytes[0] == REGION_RADIUS && length == RADIUS_BYTES) {
+        std::memcpy(v, bytes + 1, 3 * sizeof(double));
+        out = GeoRegion();
+        out.radius = true;
+        out.centerLat = v[0];
+        out.centerLon = v[1];
+        out.radiusKm = v[2];
+
+        // Latitude reach is the angular radius; longitude reach widens
+        // with latitude and covers everything once a pole is inside
+        double angle = std::max(0.0, out.radiusKm) / EARTH_RADIUS_KM;
+        double dLat = angle / DEG_TO_RAD + GEO_BOUND_SLACK;
+        out.minLat = std::max(-90.0, out.centerLat - dLat);
+        out.maxLat = std::min(90.0, out.centerLat + dLat);
+        double reach = std::sin(angle) / std::cos(out.centerLat * DEG_TO_RAD);
+        if (out.minLat <= -90.0 || out.maxLat >= 90.0 || angle >= M_PI / 2 || !(reach < 1.0)) {
+            out.minLon = -180.0;
+            out.maxLon = 180.0;
+        } else {
+            double dLon = std::asin(reach) / DEG_TO_RAD + GEO_BOUND_SLACK;
+            out.minLon = out.centerLon - dLon;
+            out.maxLon = out.centerLon + dLon;
+            if (out.minLon < -180.0) out.minLon += 360.0;
+            if (out.maxLon > 180.0) out.maxLon -= 360.0;
+        }
+        return true;
+    }
+    if (bytes[0] == REGION_BOX && length == BOX_BYTES) {
+        std::memcpy(v, bytes + 1, 4 * sizeof(double));
+        out = GeoRegion();
+        out.minLat = v[0];
+        out.maxLat = v[1];
+        out.minLon = v[2];
+        out.maxLon = v[3];
+        return true;
+    }
+    return false;
+}
+
+bool GeoRegion::contains(double lat, double lon) const {
+    if (radius) {
+        return haversineKm(centerLat, centerLon, lat, lon) <= radiusKm;
+    }
+    return lat >= minLat && lat <= maxLat && lon >= minLon && lon <= maxLon;
+}
+
+double GeoRegion::boxFraction() const {
+    if (minLat > maxLat) return 0.0;
+    double lonSpan = maxLon - minLon;
+    if (lonSpan < 0) lonSpan = radius ? lonSpan + 360.0 : 0.0;
+    return std::min(1.0, (maxLat - minLat) / 180.0 * lonSpan / 360.0);
+}
+
+// Relative slack on the batch haversine bound, so rounding never drops a
+// point contains() would keep
+static constexpr double GEO_BATCH_SLACK = 1e-9;
+
+uint64_t GeoRegion::matchBatch(const double* lat, const double* lon, size_t count) const {
+    // Bounding box, branch-free per point (NaN coordinates fail it)
+    uint8_t inBox[64];
+    if (radius && minLon > maxLon) {
+        for (size_t i = 0; i < count; i++) {
+            inBox[i] = (lat[i] >= minLat) & (lat[i] <= maxLat) & ((lon[i] >= minLon) | (lon[i] <= maxLon));
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            inBox[i] = (lat[i] >= minLat) & (lat[i] <= maxLat) & (lon[i] >= minLon) & (lon[i] <= maxLon);
+        }
+    }
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        mask |= static_cast<uint64_t>(inBox[i]) << i;
+    }
+    if (!radius || !mask) return mask;
+
+    // distance <= radius  <=>  a <= sin^2(radius / 2R), for the haversine
+    // term a of haversineKm (any point matches once the radius spans half
+    // the globe)
+    double angle = radiusKm / EARTH_RADIUS_KM;
+    if (angle >= M_PI) return mask;
+    double half = std::sin(angle / 2);
+    double bound = half * half * (1 + GEO_BATCH_SLACK);
+    double lat1 = centerLat * DEG_TO_RAD;
+    double lon1 = centerLon * DEG_TO_RAD;
+    double cosLat1 = std::cos(lat1);
+    for (uint64_t candidates = mask; candidates; candidates &= candidates - 1) {
+        size_t i = static_cast<size_t>(__builtin_ctzll(candidates));
+        double lat2 = lat[i] * DEG_TO_RAD;
+        double sinLat = std::sin((lat2 - lat1) / 2);
+        double sinLon = std::sin((lon[i] * DEG_TO_RAD - lon1) / 2);
+        double a = sinLat * sinLat + cosLat1 * std::cos(lat2) * sinLon * sinLon;
+        if (!(a <= bound)) mask &= ~(uint64_t(1) << i);
+    }
+    return mask;
+}
+
+std::vector<std::pair<int64_t, int64_t>> GeoRegion::coveringKeyRanges(size_t maxCells) const {
+    // A circle wrapping the antimeridian is two boxes; an inverted box
+    // contains nothing (as with geo_bbox_contains)
+    std::vector<std::pair<double, double>> lonSpans;
+    if (minLat <= maxLat) {
+        if (minLon <= maxLon) {
+            lonSpans.push_back({minLon, maxLon});
+        } else if (radius) {
+            lonSpans.push_back({minLon, 180.0});
+            lonSpans.push_back({-180.0, maxLon});
+        }
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    for (const auto& [spanMin, spanMax] : lonSpans) {
+        uint32_t lat0 = quantize(minLat, -90.0, 180.0), lat1 = quantize(maxLat, -90.0, 180.0);
+        uint32_t lon0 = quantize(spanMin, -180.0, 360.0), lon1 = quantize(spanMax, -180.0, 360.0);
+
+        // Finest block size whose blocks over the box stay within maxCells
+        int shift = 0;
+        while (shift < GEO_CELL_BITS &&
+               static_cast<uint64_t>((lat1 >> shift) - (lat0 >> shift) + 1) *
+                       ((lon1 >> shift) - (lon0 >> shift) + 1) > maxCells) {
+            shift++;
+        }
+        int64_t blockKeys = int64_t(1) << (2 * shift);
+        for (uint32_t a = lat0 >> shift; a <= (lat1 >> shift); a++) {
+            for (uint32_t b = lon0 >> shift; b <= (lon1 >> shift); b++) {
+                int64_t first = interleave(a, b) << (2 * shift);
+                ranges.push_back({first, first + blockKeys - 1});
+            }
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (const auto& range : ranges) {
+        if (merged > 0 && range.first <= ranges[merged - 1].second + 1) {
+            ranges[merged - 1].second = std::max(ranges[merged - 1].second, range.second);
+        } else {
+            ranges[merged++] = range;
+        }
+    }
+    ranges.resize(merged);
+    return ranges;
+}
+
+// geo_radius(centerLat, centerLon, radiusKm) / geo_box(minLat, maxLat, minLon, maxLon)
+static void geoRegionFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    uint8_t region[BOX_BYTES];
+    region[0] = argc == 3 ? REGION_RADIUS : REGION_BOX;
+    for (int i = 0; i < argc; i++) {
+        if (sqlite3_value_type(argv[i]) == SQLITE_NULL) {
+            sqlite3_result_null(ctx);
+            return;
+        }
+        double v = sqlite3_value_double(argv[i]);
+        std::memcpy(region + 1 + i * sizeof(double), &v, sizeof(double));
+    }
+    sqlite3_result_blob(ctx, region, 1 + argc * static_cast<int>(sizeof(double)), SQLITE_TRANSIENT);
+}
+
+void geoWithinFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    if (argc != 2) {
+        sqlite3_result_error(ctx, "geo_within requires 2 args: point, region", -1);
+        return;
+    }
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    double lat, lon;
+    GeoRegion region;
+    if (!decodeGeoPoint(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]), lat, lon) ||
+        !GeoRegion::decode(sqlite3_value_blob(argv[1]), sqlite3_value_bytes(argv[1]), region)) {
+        sqlite3_result_error(ctx, "geo_within expects a _geo point and a geo_radius/geo_box region", -1);
+        return;
+    }
+    sqlite3_result_int(ctx, region.contains(lat, lon) ? 1 : 0);
+}
+
 void registerGeoFunctions(sqlite3* db) {
     int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
     sqlite3_create_function(db, "geo_distance", 4, flags, nullptr, geoDistanceFunc, nullptr, nullptr);
     sqlite3_create_function(db, "geo_bbox_contains", 6, flags, nullptr, geoBboxContainsFunc, nullptr, nullptr);
     sqlite3_create_function(db, "geo_within_radius", 5, flags, nullptr, geoWithinRadiusFunc, nullptr, nullptr);
+    sqlite3_create_function(db, "geo_radius", 3, flags, nullptr, geoRegionFunc, nullptr, nullptr);
+    sqlite3_create_function(db, "geo_box", 4, flags, nullptr, geoRegionFunc, nullptr, nullptr);
+    sqlite3_create_function(db, "geo_within", 2, flags, nullptr, geoWithinFunction, nullptr, nullptr);
 }
 
 }  // namespace flatsql
@@ -0,0 +1,131 @@
+#include "flatsql/hmac.h"
+#include "flatsql/worker_pool.h"
+#include <atomic>
+#include <cstring>
+
+#ifdef FLATSQL_HAVE_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+namespace flatsql {
+
+// MACs per verifyBatch() task: each is a few microseconds of hashing
+static constexpr size_t VERIFY_GRAIN = 16;
+
+#ifdef FLATSQL_HAVE_OPENSSL
+
+namespace {
+
+constexpr size_t SHA256_BLOCK = 64;
+
+// Per-thread context the precomputed pad states are copied into
+struct DigestScratch {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    ~DigestScratch() { EVP_MD_CTX_free(ctx); }
+};
+
+}  // namespace
+
+struct HmacSha256::Pads {
+    EVP_MD_CTX* inner = EVP_MD_CTX_new();  // SHA-256 state after key ^ ipad
+    EVP_MD_CTX* outer = EVP_MD_CTX_new();  // SHA-256 state after key ^ opad
+    bool ready = false;
+    ~Pads() {
+        EVP_MD_CTX_free(inner);
+        EVP_MD_CTX_free(outer);
+    }
+};
+
+HmacSha256::HmacSha256(const uint8_t* key, size_t keySize) : pads_(std::make_unique<Pads>()) {
+    // Keys longer than a block are hashed first (RFC 2104)
+    uint8_t block[SHA256_BLOCK] = {};
+    unsigned int hashed = 0;
+    if (keySize > SHA256_BLOCK) {
+        if (EVP_Digest(key, keySize, block, &hashed, EVP_sha256(), nullptr) != 1) return;
+    } else if (keySize > 0) {
+        std::memcpy(block, key, keySize);
+    }
+
+    uint8_t ipad[SHA256_BLOCK];
+    uint8_t opad[SHA256_BLOCK];
+    for (size_t i = 0; i < SHA256_BLOCK; i++) {
+        ipad[i] = block[i] ^ 0x36;
+        opad[i] = block[i] ^ 0x5c;
+    }
+    Pads& pads = *pads_;
+    pads.ready = pads.inner && pads.outer &&
+        EVP_DigestInit_ex(pads.inner, EVP_sha256(), nullptr) == 1 &&
+        EVP_DigestUpdate(pads.inner, ipad, sizeof(ipad)) == 1 &&
+        EVP_DigestInit_ex(pads.outer, EVP_sha256(), nullptr) == 1 &&
+        EVP_DigestUpdate(pads.outer, opad, sizeof(opad)) == 1;
+}
+
+bool HmacSha256::available() const {
+    return pads_->ready;
+}
+
+bool HmacSha256::compute(const uint8_t* data, size_t length, uint8_t* mac) const {
+    if (!pads_->ready) return false;
+    thread_local DigestScratch scratch;
+    if (!scratch.ctx) return false;
+
+    uint8_t digest[MAC_SIZE];
+    unsigned int size = 0;
+    return EVP_MD_CTX_copy_ex(scratch.ctx, pads_->inner) == 1 &&
+           EVP_DigestUpdate(scratch.ctx, data, length) == 1 &&
+           EVP_DigestFinal_ex(scratch.ctx, digest, &size) == 1 &&
+           EVP_MD_CTX_copy_ex(scratch.ctx, pads_->outer) == 1 &&
+           EVP_DigestUpdate(scratch.ctx, digest, sizeof(digest)) == 1 &&
+           EVP_DigestFinal_ex(scratch.ctx, mac, &size) == 1;
+}
+
+#else
+
+struct HmacSha256::Pads {};
+
+HmacSha256::HmacSha256(const uint8_t*, size_t) : pads_(std::make_unique<Pads>()) {}
+
+bool HmacSha256::available() const {
+    return false;
+}
+
+bool HmacSha256::compute(const uint8_t*, size_t, uint8_t*) const {
+    return false;
+}
+
+#endif  // FLATSQL_HAVE_OPENSSL
+
+HmacSha256::~HmacSha256() = default;
+
+bool HmacSha256::verify(const uint8_t* data, size_t length, const uint8_t* mac) const {
+    uint8_t computed[MAC_SIZE];
+    if (!compute(data, length, computed)) return false;
+    // Constant-time comparison to prevent timing attacks
+    uint8_t diff = 0;
+    for (size_t i = 0; i < MAC_SIZE; i++) {
+        diff |= computed[i] ^ mac[i];
+    }
+    return diff == 0;
+}
+
+size_t HmacSha256::verifyBatch(const uint8_t* data, const uint64_t* offsets, const uint32_t* lengths,
+                               const uint8_t* macs, size_t count, WorkerPool* pool) const {
+    std::atomic<size_t> firstFailure{count};
+    auto verifyRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (verify(data + offsets[i], lengths[i], macs + i * MAC_SIZE)) continue;
+            size_t seen = firstFailure.load(std::memory_order_relaxed);
+            while (i < seen && !firstFailure.compare_exchange_weak(seen, i, std::memory_order_relaxed)) {
+            }
+            return;  // Later buffers of this range can't fail first
+        }
+    };
+    if (pool) {
+        pool->parallelFor(count, verifyRange, VERIFY_GRAIN);
+    } else {
+        verifyRange(0, count);
+    }
+    return firstFailure.load();
+}
+
+}  // namespace flatsql
@@ -0,0 +1,390 @@
+#include "flatsql/index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace flatsql {
+
+// ==================== IndexStatistics ====================
+
+namespace {
+
+uint64_t mixHash(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t hashBytes(const uint8_t* data, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return mixHash(h);
+}
+
+// Hash under which keys that compareValues() treats as equal collide
+uint64_t hashKey(const Value& key) {
+    return std::visit([](const auto& v) -> uint64_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return hashBytes(reinterpret_cast<const uint8_t*>(v.data()), v.size());
+        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            return hashBytes(v.data(), v.size());
+        } else if constexpr (std::is_floating_point_v<T>) {
+            double d = static_cast<double>(v);
+            if (d == std::floor(d) && std::fabs(d) < 9.2e18) {
+                return mixHash(static_cast<uint64_t>(static_cast<int64_t>(d)));
+            }
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            return mixHash(bits);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return mixHash(static_cast<uint64_t>(v));
+        } else {
+            return 0;
+        }
+    }, key);
+}
+
+bool numericKey(const Value& key, double& out) {
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            out = static_cast<double>(v);
+            return true;
+        } else {
+            return false;
+        }
+    }, key);
+}
+
+}  // namespace
+
+IndexStatistics& IndexStatistics::operator=(const IndexStatistics& other) {
+    entries_.store(other.entries_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (size_t i = 0; i < REGISTERS; i++) {
+        registers_[i].store(other.registers_[i].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    }
+    hasRange_.store(other.hasRange_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    minKey_.store(other.minKey_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    maxKey_.store(other.maxKey_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+
+void IndexStatistics::add(const Value& key) {
+    entries_.fetch_add(1, std::memory_order_relaxed);
+
+    // HyperLogLog: top 7 bits pick the register, which keeps the longest
+    // run of leading zeros seen in the rest of the hash
+    uint64_t h = hashKey(key);
+    size_t reg = static_cast<size_t>(h >> 57);
+    uint64_t rest = h << 7;
+    uint8_t rank = rest ? static_cast<uint8_t>(__builtin_clzll(rest) + 1) : 58;
+    if (rank > registers_[reg].load(std::memory_order_relaxed)) {
+        registers_[reg].store(rank, std::memory_order_relaxed);
+    }
+
+    double d;
+    if (!numericKey(key, d) || std::isnan(d)) return;
+    if (!hasRange_.load(std::memory_order_relaxed)) {
+        minKey_.store(d, std::memory_order_relaxed);
+        maxKey_.store(d, std::memory_order_relaxed);
+        hasRange_.store(true, std::memory_order_relaxed);
+    } else if (d < minKey_.load(std::memory_order_relaxed)) {
+        minKey_.store(d, std::memory_order_relaxed);
+    } else if (d > maxKey_.load(std::memory_order_relaxed)) {
+        maxKey_.store(d, std::memory_order_relaxed);
+    }
+}
+
+void IndexStatistics::clear() {
+    entries_.store(0, std::memory_order_relaxed);
+    for (auto& r : registers_) r.store(0, std::memory_order_relaxed);
+    hasRange_.store(false, std::memory_order_relaxed);
+}
+
+void IndexStatistics::remove(uint64_t entries) {
+    uint64_t current = entries_.load(std::memory_order_relaxed);
+    entries_.store(current > entries ? current - entries : 0, std::memory_order_relaxed);
+}
+
+IndexStats IndexStatistics::snapshot() const {
+    IndexStats stats;
+    stats.entries = entries();
+    if (stats.entries == 0) return stats;
+
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (const auto& r : registers_) {
+        uint8_t rank = r.load(std::memory_order_relaxed);
+        sum += std::ldexp(1.0, -rank);
+        zeros += rank == 0;
+    }
+    const double m = static_cast<double>(REGISTERS);
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));  // Linear counting
+    }
+    stats.distinctKeys = std::max<uint64_t>(1, std::min<uint64_t>(
+        stats.entries, static_cast<uint64_t>(std::llround(estimate))));
+
+    stats.hasRange = hasRange_.load(std::memory_order_relaxed);
+    stats.minKey = minKey_.load(std::memory_order_relaxed);
+    stats.maxKey = maxKey_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+double IndexStats::equalityRows() const {
+    if (distinctKeys == 0) return 1.0;
+    return std::max(1.0, static_cast<double>(entries) / static_cast<double>(distinctKeys));
+}
+
+double IndexStats::rangeFraction(const double* lo, const double* hi) const {
+    if (!hasRange || !(maxKey > minKey)) {
+        return (lo ? 1.0 / 3.0 : 1.0) * (hi ? 1.0 / 3.0 : 1.0);
+    }
+    double from = lo ? std::max(*lo, minKey) : minKey;
+    double to = hi ? std::min(*hi, maxKey) : maxKey;
+    if (to < from) return 0.0;
+    // At least one key's worth, so point ranges don't estimate to zero
+    double fraction = (to - from) / (maxKey - minKey);
+    double oneKey = distinctKeys ? 1.0 / static_cast<double>(distinctKeys) : 1.0;
+    return std::min(1.0, std::max(fraction, oneKey));
+}
+
+// ==================== Index ====================
+
+void Index::insertBatch(std::vector<IndexEntry>& entries) {
+    std::sort(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        int cmp = compareValues(a.key, b.key);
+        return cmp != 0 ? cmp < 0 : a.sequence < b.sequence;
+    });
+    bulkLoad(entries);
+}
+
+void Index::eraseThrough(uint64_t sequence) {
+    // all() is in (key, sequence) order, so the kept entries stay sorted
+    std::vector<IndexEntry> entries = all();
+    size_t kept = 0;
+    for (auto& entry : entries) {
+        if (entry.sequence > sequence) entries[kept++] = std::move(entry);
+    }
+    if (kept == entries.size()) return;
+    entries.resize(kept);
+    clear();
+    bulkLoad(entries);
+}
+
+void Index::sortKeys(std::vector<Value>& keys) {
+    keys.erase(std::remove_if(keys.begin(), keys.end(), [](const Value& key) {
+        return std::holds_alternative<std::monostate>(key);
+    }), keys.end());
+    std::sort(keys.begin(), keys.end(), [](const Value& a, const Value& b) {
+        return compareValues(a, b) < 0;
+    });
+    keys.erase(std::unique(keys.begin(), keys.end(), [](const Value& a, const Value& b) {
+        return compareValues(a, b) == 0;
+    }), keys.end());
+}
+
+std::vector<IndexEntry> Index::searchMany(std::vector<Value> keys) const {
+    sortKeys(keys);
+    std::vector<IndexEntry> results;
+    for (const auto& key : keys) {
+        for (auto& entry : search(key)) {
+            results.push_back(std::move(entry));
+        }
+    }
+    return results;
+}
+
+namespace {
+
+// IndexCursor over entries already in memory, handed out as a single page
+class MaterializedCursor : public IndexCursor {
+public:
+    explicit MaterializedCursor(std::vector<IndexEntry> entries) : entries_(std::move(entries)) {}
+
+protected:
+    bool fetch(std::vector<IndexEntry>& page) override {
+        page.swap(entries_);
+        return false;
+    }
+
+private:
+    std::vector<IndexEntry> entries_;
+};
+
+}  // namespace
+
+std::unique_ptr<IndexCursor> Index::openRange(const Value& minKey, const Value& maxKey,
+                                              bool reverse) const {
+    std::vector<IndexEntry> entries = range(minKey, maxKey);
+    if (reverse) std::reverse(entries.begin(), entries.end());
+    return std::make_unique<MaterializedCursor>(std::move(entries));
+}
+
+static void execIndexSql(sqlite3* db, const std::string& sql, const char* what) {
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string err = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error(std::string(what) + ": " + err);
+    }
+}
+
+void Index::saveTo(sqlite3* db, const std::string& schemaName) const {
+    std::string table = "\"" + schemaName + "\".\"" + name_ + "\"";
+    execIndexSql(db, "DROP TABLE IF EXISTS " + table + "; "
+                     "CREATE TABLE " + table + " (key " + sqliteTypeForKey(keyType_) + ", "
+                     "data_offset INTEGER, data_length INTEGER, sequence INTEGER)",
+                 "Failed to save index");
+
+    sqlite3_stmt* stmt = nullptr;
+    std::string sql = "INSERT INTO " + table + " VALUES (?, ?, ?, ?)";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to save index: " + std::string(sqlite3_errmsg(db)));
+    }
+    for (const auto& entry : all()) {
+        sqlite3_reset(stmt);
+        bindIndexKey(stmt, 1, entry.key);
+        sqlite3_bind_int64(stmt, 2, static_cast<int64_t>(entry.dataOffset));
+        sqlite3_bind_int(stmt, 3, static_cast<int>(entry.dataLength));
+        sqlite3_bind_int64(stmt, 4, static_cast<int64_t>(entry.sequence));
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            sqlite3_finalize(stmt);
+            throw std::runtime_error("Failed to save index: " + std::string(sqlite3_errmsg(db)));
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+void Index::loadFrom(sqlite3* db, const std::string& schemaName) {
+    sqlite3_stmt* stmt = nullptr;
+    std::string sql = "SELECT key, data_offset, data_length, sequence FROM \"" + schemaName +
+                      "\".\"" + name_ + "\"";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to load index: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    std::vector<IndexEntry> entries;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        IndexEntry entry;
+        entry.key = readIndexKey(stmt, 0, keyType_);
+        entry.dataOffset = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+        entry.dataLength = static_cast<uint32_t>(sqlite3_column_int(stmt, 2));
+        entry.sequence = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
+        entries.push_back(std::move(entry));
+    }
+    sqlite3_finalize(stmt);
+
+    insertBatch(entries);
+}
+
+// ==================== SQLite key helpers ====================
+
+const char* sqliteTypeForKey(ValueType keyType) {
+    switch (keyType) {
+        case ValueType::Int8:
+        case ValueType::Int16:
+        case ValueType::Int32:
+        case ValueType::Int64:
+        case ValueType::UInt8:
+        case ValueType::UInt16:
+        case ValueType::UInt32:
+        case ValueType::UInt64:
+            return "INTEGER";
+        case ValueType::Float32:
+        case ValueType::Float64:
+            return "REAL";
+        case ValueType::String:
+            return "TEXT";
+        case ValueType::Bool:
+            return "INTEGER";
+        case ValueType::Bytes:
+            return "BLOB";
+        default:
+            return "BLOB";
+    }
+}
+
+void bindIndexKey(sqlite3_stmt* stmt, int index, const Value& key) {
+    std::visit([stmt, index](auto&& arg) {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            sqlite3_bind_null(stmt, index);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            sqlite3_bind_int(stmt, index, arg ? 1 : 0);
+        } else if constexpr (std::is_same_v<T, int8_t> || std::is_same_v<T, int16_t> ||
+                           std::is_same_v<T, int32_t>) {
+            sqlite3_bind_int(stmt, index, static_cast<int>(arg));
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            sqlite3_bind_int64(stmt, index, arg);
+        } else if constexpr (std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
+                           std::is_same_v<T, uint32_t>) {
+            sqlite3_bind_int(stmt, index, static_cast<int>(arg));
+        } else if constexpr (std::is_same_v<T, uint64_t>) {
+            sqlite3_bind_int64(stmt, index, static_cast<int64_t>(arg));
+        } else if constexpr (std::is_same_v<T, float>) {
+            sqlite3_bind_double(stmt, index, static_cast<double>(arg));
+        } else if constexpr (std::is_same_v<T, double>) {
+            sqlite3_bind_double(stmt, index, arg);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            sqlite3_bind_text(stmt, index, arg.c_str(), static_cast<int>(arg.size()), SQLITE_TRANSIENT);
+        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            sqlite3_bind_blob(stmt, index, arg.data(), static_cast<int>(arg.size()), SQLITE_TRANSIENT);
+        }
+    }, key);
+}
+
+Value readIndexKey(sqlite3_stmt* stmt, int column, ValueType keyType) {
+    switch (keyType) {
+        case ValueType::Int8:
+            return static_cast<int8_t>(sqlite3_column_int(stmt, column));
+        case ValueType::Int16:
+            return static_cast<int16_t>(sqlite3_column_int(stmt, column));
+        case ValueType::Int32:
+            return static_cast<int32_t>(sqlite3_column_int(stmt, column));
+        case ValueType::Int64:
+            return sqlite3_column_int64(stmt, column);
+        case ValueType::UInt8:
+            return static_cast<uint8_t>(sqlite3_column_int(stmt, column));
+        case ValueType::UInt16:
+            return static_cast<uint16_t>(sqlite3_column_int(stmt, column));
+        case ValueType::UInt32:
+            return static_cast<uint32_t>(sqlite3_column_int(stmt, column));
+        case ValueType::UInt64:
+            return static_cast<uint64_t>(sqlite3_column_int64(stmt, column));
+        case ValueType::Float32:
+            return static_cast<float>(sqlite3_column_double(stmt, column));
+        case ValueType::Float64:
+            return sqlite3_column_double(stmt, column);
+        case ValueType::String: {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+            return text ? std::string(text) : std::string();
+        }
+        case ValueType::Bool:
+            return sqlite3_column_int(stmt, column) != 0;
+        case ValueType::Bytes: {
+            const void* blob = sqlite3_column_blob(stmt, column);
+            int size = sqlite3_column_bytes(stmt, column);
+            if (blob && size > 0) {
+                const uint8_t* data = static_cast<const uint8_t*>(blob);
+                return std::vector<uint8_t>(data, data + size);
+            }
+            return std::vector<uint8_t>();
+        }
+        case ValueType::Null:
+        default:
+            return std::monostate{};
+    }
+}
+
+}  // namespace flatsql
@@ -0,0 +1,48 @@
+#include "flatsql/index_advisor.h"
+#include <algorithm>
+
+namespace flatsql {
+
+void IndexAdvisor::record(const std::string& table, const std::string& column, uint64_t rows) {
+    auto [it, inserted] = columns_.try_emplace({table, column});
+    IndexRecommendation& entry = it->second;
+    if (inserted) {
+        entry.table = table;
+        entry.column = column;
+    }
+    entry.scans++;
+    entry.rowsScanned += rows;
+}
+
+std::vector<IndexRecommendation> IndexAdvisor::sorted(std::vector<IndexRecommendation> list) {
+    std::stable_sort(list.begin(), list.end(), [](const IndexRecommendation& a, const IndexRecommendation& b) {
+        return a.rowsScanned > b.rowsScanned;
+    });
+    return list;
+}
+
+std::vector<IndexRecommendation> IndexAdvisor::recommendations() const {
+    std::vector<IndexRecommendation> list;
+    list.reserve(columns_.size());
+    for (const auto& [key, entry] : columns_) list.push_back(entry);
+    return sorted(std::move(list));
+}
+
+std::vector<IndexRecommendation> IndexAdvisor::due() const {
+    std::vector<IndexRecommendation> list;
+    for (const auto& [key, entry] : columns_) {
+        if (!entry.built && entry.rowsScanned >= threshold_) list.push_back(entry);
+    }
+    return sorted(std::move(list));
+}
+
+void IndexAdvisor::markBuilt(const std::string& table, const std::string& column) {
+    auto [it, inserted] = columns_.try_emplace({table, column});
+    if (inserted) {
+        it->second.table = table;
+        it->second.column = column;
+    }
+    it->second.built = true;
+}
+
+}  // namespace flatsql
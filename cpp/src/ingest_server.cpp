@@ -0,0 +1,408 @@
+#include "flatsql/ingest_server.h"
+#include "flatsql/database.h"
+#include "flatsql/stream_ingestor.h"
+#include <stdexcept>
+
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#define FLATSQL_HAVE_SOCKETS 1
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+namespace flatsql {
+
+#ifdef FLATSQL_HAVE_SOCKETS
+
+namespace {
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw std::runtime_error(std::string("fcntl failed: ") + std::strerror(errno));
+    }
+}
+
+// Readiness for a set of descriptors, level-triggered
+class Poller {
+public:
+#ifdef __linux__
+    Poller() : epoll_(epoll_create1(EPOLL_CLOEXEC)) {
+        if (epoll_ < 0) {
+            throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+        }
+    }
+    ~Poller() { close(epoll_); }
+
+    void add(int fd) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            throw std::runtime_error(std::string("epoll_ctl failed: ") + std::strerror(errno));
+        }
+    }
+
+    void setReading(int fd, bool reading) {
+        epoll_event event{};
+        event.events = reading ? static_cast<uint32_t>(EPOLLIN) : 0u;
+        event.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    void remove(int fd) { epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr); }
+
+    void wait(int timeoutMs, std::vector<int>& ready) {
+        ready.clear();
+        epoll_event events[64];
+        int n = epoll_wait(epoll_, events, 64, timeoutMs);
+        for (int i = 0; i < n; i++) {
+            ready.push_back(events[i].data.fd);
+        }
+    }
+
+private:
+    int epoll_;
+#else
+    void add(int fd) { fds_.push_back({fd, POLLIN, 0}); }
+
+    void setReading(int fd, bool reading) {
+        for (pollfd& p : fds_) {
+            if (p.fd == fd) p.events = reading ? POLLIN : 0;
+        }
+    }
+
+    void remove(int fd) {
+        fds_.erase(std::remove_if(fds_.begin(), fds_.end(),
+                                  [fd](const pollfd& p) { return p.fd == fd; }),
+                   fds_.end());
+    }
+
+    void wait(int timeoutMs, std::vector<int>& ready) {
+        ready.clear();
+        if (poll(fds_.data(), fds_.size(), timeoutMs) <= 0) return;
+        for (const pollfd& p : fds_) {
+            if (p.revents != 0) ready.push_back(p.fd);
+        }
+    }
+
+private:
+    std::vector<pollfd> fds_;
+#endif
+};
+
+}  // namespace
+
+struct IngestServer::Loop {
+    struct Connection {
+        std::unique_ptr<StreamIngestor> ingestor;
+        bool paused = false;
+    };
+
+    Poller poller;
+    std::vector<int> listeners;
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    std::string unixPath;  // Unlinked on close
+    std::unordered_map<int, Connection> connections;
+    size_t growthBytes = 0;  // Beyond receiveBufferSize, all connections
+    std::vector<int> ready;
+
+    ~Loop() {
+        for (auto& entry : connections) close(entry.first);
+        for (int fd : listeners) close(fd);
+        if (wakeRead >= 0) close(wakeRead);
+        if (wakeWrite >= 0) close(wakeWrite);
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+    }
+};
+
+IngestServer::IngestServer(FlatSQLDatabase& db, const IngestServerOptions& options)
+    : db_(db), options_(options), loop_(std::make_unique<Loop>()) {
+    if (options_.unixPath.empty() && options_.tcpPort < 0) {
+        throw std::runtime_error("IngestServer needs a Unix socket path or a TCP port");
+    }
+    Loop& loop = *loop_;
+
+    int wake[2];
+    if (pipe(wake) < 0) {
+        throw std::runtime_error(std::string("pipe failed: ") + std::strerror(errno));
+    }
+    loop.wakeRead = wake[0];
+    loop.wakeWrite = wake[1];
+    setNonBlocking(loop.wakeRead);
+    setNonBlocking(loop.wakeWrite);
+    loop.poller.add(loop.wakeRead);
+
+    if (!options_.unixPath.empty()) {
+        sockaddr_un addr{};
+        if (options_.unixPath.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Unix socket path too long: " + options_.unixPath);
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+        }
+        loop.listeners.push_back(fd);
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, options_.unixPath.c_str(), options_.unixPath.size() + 1);
+        unlink(options_.unixPath.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            throw std::runtime_error("Cannot listen on " + options_.unixPath + ": " + std::strerror(errno));
+        }
+        loop.unixPath = options_.unixPath;
+        setNonBlocking(fd);
+        loop.poller.add(fd);
+    }
+
+    if (options_.tcpPort >= 0) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+        addrinfo* found = nullptr;
+        std::string port = std::to_string(options_.tcpPort);
+        const char* host = options_.tcpHost.empty() ? nullptr : options_.tcpHost.c_str();
+        int rc = getaddrinfo(host, port.c_str(), &hints, &found);
+        if (rc != 0 || !found) {
+            throw std::runtime_error("Cannot resolve " + options_.tcpHost + ": " + gai_strerror(rc));
+        }
+        int fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+        if (fd < 0) {
+            freeaddrinfo(found);
+            throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+        }
+        loop.listeners.push_back(fd);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        bool listening = bind(fd, found->ai_addr, found->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+        freeaddrinfo(found);
+        if (!listening) {
+            throw std::runtime_error("Cannot listen on " + options_.tcpHost + ":" + port + ": " +
+                                     std::strerror(errno));
+        }
+
+        sockaddr_storage bound{};
+        socklen_t boundLength = sizeof(bound);
+        getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+        boundPort_ = bound.ss_family == AF_INET6
+            ? ntohs(reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port)
+            : ntohs(reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+        setNonBlocking(fd);
+        loop.poller.add(fd);
+    }
+}
+
+IngestServer::~IngestServer() {
+    stop();
+}
+
+void IngestServer::start() {
+    if (thread_) return;
+    stopping_ = false;
+    thread_ = std::make_unique<std::thread>([this] {
+        while (!stopping_.load(std::memory_order_acquire)) {
+            try {
+                pollOnce(-1);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(statsMutex_);
+                lastError_ = e.what();
+                return;
+            }
+        }
+    });
+}
+
+void IngestServer::stop() {
+    if (!thread_) return;
+    stopping_.store(true, std::memory_order_release);
+    uint8_t byte = 1;
+    ssize_t written = write(loop_->wakeWrite, &byte, 1);
+    (void)written;  // A full pipe already wakes the loop
+    thread_->join();
+    thread_.reset();
+}
+
+IngestServerStats IngestServer::getStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+std::string IngestServer::getLastError() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return lastError_;
+}
+
+size_t IngestServer::pollOnce(int timeoutMs) {
+    Loop& loop = *loop_;
+    const size_t baseSize = std::max<size_t>(options_.receiveBufferSize, SIZE_PREFIX_LENGTH);
+    IngestServerStats delta;
+    std::string error;
+
+    auto growthOf = [&](const Loop::Connection& conn) {
+        size_t capacity = conn.ingestor->capacity();
+        return capacity > baseSize ? capacity - baseSize : 0;
+    };
+
+    auto closeConnection = [&](int fd, const std::string& reason) {
+        auto it = loop.connections.find(fd);
+        if (it == loop.connections.end()) return;
+        loop.growthBytes -= growthOf(it->second);
+        loop.poller.remove(fd);
+        close(fd);
+        loop.connections.erase(it);
+        if (!reason.empty()) {
+            delta.connectionsDropped++;
+            error = reason;
+        }
+    };
+
+    size_t growthBefore = loop.growthBytes;
+    loop.poller.wait(timeoutMs, loop.ready);
+
+    for (int fd : loop.ready) {
+        if (fd == loop.wakeRead) {
+            uint8_t drain[64];
+            while (read(fd, drain, sizeof(drain)) > 0) {
+            }
+            continue;
+        }
+
+        if (std::find(loop.listeners.begin(), loop.listeners.end(), fd) != loop.listeners.end()) {
+            while (true) {
+                int client = accept(fd, nullptr, nullptr);
+                if (client < 0) break;
+                if (loop.connections.size() >= options_.maxConnections) {
+                    close(client);
+                    delta.connectionsRefused++;
+                    continue;
+                }
+                setNonBlocking(client);
+                Loop::Connection& conn = loop.connections[client];
+                conn.ingestor = std::make_unique<StreamIngestor>(db_, baseSize, options_.source);
+                conn.ingestor->setMaxFrameSize(options_.maxFrameSize);
+                loop.poller.add(client);
+                delta.connectionsAccepted++;
+            }
+            continue;
+        }
+
+        auto it = loop.connections.find(fd);
+        if (it == loop.connections.end()) continue;
+        Loop::Connection& conn = it->second;
+        StreamIngestor& ingestor = *conn.ingestor;
+
+        size_t budget = std::max<size_t>(options_.readBudget, 1);
+        bool open = true;
+        try {
+            while (budget > 0) {
+                // Growing for a large frame waits while others hold the growth allowance
+                size_t growth = ingestor.growthNeeded();
+                size_t held = growthOf(conn);
+                if (growth > 0 && loop.growthBytes > held &&
+                    loop.growthBytes + growth > options_.maxGrowthBytes) {
+                    if (!conn.paused) {
+                        conn.paused = true;
+                        loop.poller.setReading(fd, false);
+                        delta.readPauses++;
+                    }
+                    break;
+                }
+
+                size_t room = 0;
+                uint8_t* dest = ingestor.reserve(1, &room);
+                loop.growthBytes += growthOf(conn) - held;
+
+                ssize_t n = recv(fd, dest, std::min(room, budget), 0);
+                if (n > 0) {
+                    budget -= static_cast<size_t>(n);
+                    delta.bytesReceived += static_cast<uint64_t>(n);
+                    delta.recordsIngested += ingestor.commit(static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+                // Producer finished (or failed); an incomplete last frame is dropped
+                closeConnection(fd, "");
+                open = false;
+                break;
+            }
+        } catch (const std::exception& e) {
+            closeConnection(fd, e.what());
+            open = false;
+        }
+
+        if (open) {
+            // Large frame done: give the growth back
+            size_t held = growthOf(conn);
+            ingestor.shrink();
+            loop.growthBytes -= held - growthOf(conn);
+        }
+    }
+
+    // Growth given back: let paused connections read again
+    if (loop.growthBytes < growthBefore || loop.growthBytes == 0) {
+        for (auto& entry : loop.connections) {
+            if (entry.second.paused) {
+                entry.second.paused = false;
+                loop.poller.setReading(entry.first, true);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.connectionsAccepted += delta.connectionsAccepted;
+    stats_.connectionsRefused += delta.connectionsRefused;
+    stats_.connectionsDropped += delta.connectionsDropped;
+    stats_.bytesReceived += delta.bytesReceived;
+    stats_.recordsIngested += delta.recordsIngested;
+    stats_.readPauses += delta.readPauses;
+    stats_.activeConnections = loop.connections.size();
+    if (!error.empty()) {
+        lastError_ = error;
+    }
+    return static_cast<size_t>(delta.recordsIngested);
+}
+
+#else  // !FLATSQL_HAVE_SOCKETS
+
+struct IngestServer::Loop {};
+
+IngestServer::IngestServer(FlatSQLDatabase& db, const IngestServerOptions& options)
+    : db_(db), options_(options) {
+    throw std::runtime_error("IngestServer is not available on this platform");
+}
+
+IngestServer::~IngestServer() = default;
+
+size_t IngestServer::pollOnce(int) { return 0; }
+void IngestServer::start() {}
+void IngestServer::stop() {}
+
+IngestServerStats IngestServer::getStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+std::string IngestServer::getLastError() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return lastError_;
+}
+
+#endif  // FLATSQL_HAVE_SOCKETS
+
+}  // namespace flatsql
@@ -4,6 +4,7 @@
 #include <queue>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace flatsql {
@@ -183,10 +184,15 @@ std::vector<TableReference> SchemaAnalyzer::Impl::parseTableFields(const std::st
     std::sregex_iterator it(body.begin(), body.end(), fieldRegex);
     std::sregex_iterator end;
 
+    // Field IDs follow declaration order; a union field takes two (its
+    // _type field, then the value)
+    int nextFieldId = 0;
     for (; it != end; ++it) {
         std::string fieldName = (*it)[1].str();
         bool isVector = !(*it)[2].str().empty();
         std::string typeName = (*it)[3].str();
+        int fieldId = nextFieldId;
+        nextFieldId += unions.count(typeName) ? 2 : 1;
 
         // Skip scalar types and structs
         if (structs.count(typeName)) continue;
@@ -197,6 +203,7 @@ std::vector<TableReference> SchemaAnalyzer::Impl::parseTableFields(const std::st
             ref.fieldName = fieldName;
             ref.referencedType = typeName;
             ref.relationType = isVector ? RelationType::VECTOR_TABLE : RelationType::SINGLE_TABLE;
+            ref.fieldId = fieldId;
             refs.push_back(ref);
         }
         // Check if it's a union
@@ -206,6 +213,7 @@ std::vector<TableReference> SchemaAnalyzer::Impl::parseTableFields(const std::st
             ref.referencedType = typeName;
             ref.relationType = isVector ? RelationType::VECTOR_UNION : RelationType::UNION;
             ref.unionTypes = unions[typeName].memberTypes;
+            ref.fieldId = fieldId;
             refs.push_back(ref);
         }
         // Unknown type - might be a table defined later or in another file
@@ -394,24 +402,148 @@ struct JunctionRowData {
     std::optional<std::string> unionType;
 };
 
+/**
+ * One side of a junction in compressed sparse rows: keys (parent or
+ * child rowids, ascending) and, for key k, the slice
+ * [offsets[k], offsets[k + 1]) of targets (rowids on the other side, in
+ * insertion order) and rows (JunctionRowData indexes).
+ *
+ * insertWithRelations adds rows with ascending rowids on both sides, so
+ * appends are amortized O(1). A key below the last one is staged and
+ * merged in by the next lookup. A cleared key's entries are dropped at
+ * that merge; until then lookups skip it.
+ */
+class AdjacencyCsr {
+public:
+    void append(uint64_t key, uint64_t target, size_t row) {
+        bool inOrder = staged_.empty() &&
+                       (keys_.empty() || key > keys_.back() || (key == keys_.back() && !cleared_.back()));
+        if (!inOrder) {
+            staged_.push_back({key, target, row});
+            return;
+        }
+        if (keys_.empty() || key != keys_.back()) {
+            keys_.push_back(key);
+            offsets_.push_back(targets_.size());
+            cleared_.push_back(false);
+        }
+        targets_.push_back(target);
+        rows_.push_back(row);
+    }
+
+    // Slice [begin, end) of targets()/rows() for key (empty if none)
+    std::pair<size_t, size_t> find(uint64_t key) {
+        if (!staged_.empty()) merge();
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        if (it == keys_.end() || *it != key) return {0, 0};
+        size_t k = static_cast<size_t>(it - keys_.begin());
+        if (cleared_[k]) return {0, 0};
+        return {offsets_[k], k + 1 < offsets_.size() ? offsets_[k + 1] : targets_.size()};
+    }
+
+    // Drop every entry of key
+    void clear(uint64_t key) {
+        if (!staged_.empty()) merge();
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        if (it != keys_.end() && *it == key && !cleared_[it - keys_.begin()]) {
+            cleared_[it - keys_.begin()] = true;
+            clearedKeys_++;
+        }
+    }
+
+    // Keys, in ascending order, indexing slice(); liveKeys() are not cleared
+    size_t keyCount() {
+        if (!staged_.empty()) merge();
+        return keys_.size();
+    }
+    size_t liveKeys() {
+        return keyCount() - clearedKeys_;
+    }
+
+    // Slice of the k-th key (empty if cleared); keyCount() merges first
+    std::pair<size_t, size_t> slice(size_t k) const {
+        if (cleared_[k]) return {0, 0};
+        return {offsets_[k], k + 1 < offsets_.size() ? offsets_[k + 1] : targets_.size()};
+    }
+
+    const std::vector<uint64_t>& targets() const { return targets_; }
+    const std::vector<size_t>& rows() const { return rows_; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint64_t target;
+        size_t row;
+    };
+
+    // Rebuild the arrays with the staged entries, keeping insertion order
+    // within each key
+    void merge() {
+        std::vector<Entry> entries;
+        entries.reserve(targets_.size() + staged_.size());
+        for (size_t k = 0; k < keys_.size(); k++) {
+            if (cleared_[k]) continue;
+            size_t end = k + 1 < offsets_.size() ? offsets_[k + 1] : targets_.size();
+            for (size_t i = offsets_[k]; i < end; i++) {
+                entries.push_back({keys_[k], targets_[i], rows_[i]});
+            }
+        }
+        entries.insert(entries.end(), staged_.begin(), staged_.end());
+        staged_.clear();
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        keys_.clear();
+        offsets_.clear();
+        cleared_.clear();
+        clearedKeys_ = 0;
+        targets_.clear();
+        rows_.clear();
+        for (const Entry& e : entries) append(e.key, e.target, e.row);
+    }
+
+    std::vector<uint64_t> keys_;
+    std::vector<size_t> offsets_;  // Start of each key's slice
+    std::vector<bool> cleared_;
+    size_t clearedKeys_ = 0;
+    std::vector<uint64_t> targets_;
+    std::vector<size_t> rows_;
+    std::vector<Entry> staged_;    // Appended out of key order
+};
+
 struct JunctionTableData {
     JunctionTable definition;
     std::vector<JunctionRowData> rows;
     uint64_t nextId = 1;
+    size_t liveRows = 0;
+
+    AdjacencyCsr byParent;  // parent_rowid -> children
+    AdjacencyCsr byChild;   // child_rowid -> parents
+};
 
-    // Index structures for fast lookup
-    std::multimap<uint64_t, size_t> parentIndex;  // parent_rowid -> row index
-    std::multimap<uint64_t, size_t> childIndex;   // child_rowid -> row index
+// Child row of insertWithRelations: where its bytes are in the parent
+struct ChildRecordData {
+    uint64_t parentRowId;
+    uint32_t offset;             // In the parent's stored FlatBuffer
+    uint32_t length;
+    std::vector<uint8_t> copy;   // Rebased bytes when the child is not a view
 };
 
 struct JunctionManager::Impl {
     FlatSQLDatabase& db;
     SchemaAnalysis analysis;
     std::map<std::string, JunctionTableData> junctionTables;
-    std::set<uint64_t> deletedRowIds;  // Track soft-deleted rows for cleanup
+    std::map<std::string, size_t> releasedChildren;  // Orphans per child table, for cleanupOrphans
+    std::vector<ChildRecordData> childRecords;  // By child rowid - 1
 
     explicit Impl(FlatSQLDatabase& database) : db(database) {}
 
+    void fillChildLocation(JunctionRow& row) const {
+        if (row.childRowId == 0 || row.childRowId > childRecords.size()) return;
+        const ChildRecordData& record = childRecords[row.childRowId - 1];
+        row.childOffset = record.offset;
+        row.childLength = record.length;
+    }
+
     // Add a junction row
     uint64_t addJunctionRow(const std::string& junctionName,
                             uint64_t parentRowId,
@@ -431,38 +563,24 @@ struct JunctionManager::Impl {
         size_t rowIndex = it->second.rows.size();
         it->second.rows.push_back(row);
 
-        // Update indexes
-        it->second.parentIndex.emplace(parentRowId, rowIndex);
-        it->second.childIndex.emplace(childRowId, rowIndex);
+        it->second.byParent.append(parentRowId, childRowId, rowIndex);
+        it->second.byChild.append(childRowId, parentRowId, rowIndex);
+        it->second.liveRows++;
 
         return row.id;
     }
 
-    // Remove junction rows by parent
-    void removeByParent(const std::string& junctionName, uint64_t parentRowId) {
-        auto it = junctionTables.find(junctionName);
-        if (it == junctionTables.end()) return;
-
-        auto range = it->second.parentIndex.equal_range(parentRowId);
-        std::vector<size_t> toRemove;
-        for (auto pit = range.first; pit != range.second; ++pit) {
-            toRemove.push_back(pit->second);
-        }
-
-        // Mark rows as deleted (we'll compact later)
-        for (size_t idx : toRemove) {
-            it->second.rows[idx].id = 0;  // Mark as deleted
-        }
-
-        // Rebuild indexes (simple approach - could optimize)
-        it->second.parentIndex.clear();
-        it->second.childIndex.clear();
-        for (size_t i = 0; i < it->second.rows.size(); i++) {
-            if (it->second.rows[i].id != 0) {
-                it->second.parentIndex.emplace(it->second.rows[i].parentRowId, i);
-                it->second.childIndex.emplace(it->second.rows[i].childRowId, i);
-            }
-        }
+    // Append rows[rowIndex] of table to out unless it was deleted
+    void appendLive(const JunctionTableData& table, size_t rowIndex, std::vector<JunctionRow>& out) const {
+        const auto& rowData = table.rows[rowIndex];
+        if (rowData.id == 0) return;
+        JunctionRow row;
+        row.parentRowId = rowData.parentRowId;
+        row.childRowId = rowData.childRowId;
+        row.vectorIndex = rowData.vecIndex;
+        row.unionType = rowData.unionType;
+        fillChildLocation(row);
+        out.push_back(std::move(row));
     }
 
     // Get children by parent
@@ -471,17 +589,9 @@ struct JunctionManager::Impl {
         auto it = junctionTables.find(junctionName);
         if (it == junctionTables.end()) return result;
 
-        auto range = it->second.parentIndex.equal_range(parentRowId);
-        for (auto pit = range.first; pit != range.second; ++pit) {
-            const auto& rowData = it->second.rows[pit->second];
-            if (rowData.id != 0) {
-                JunctionRow row;
-                row.parentRowId = rowData.parentRowId;
-                row.childRowId = rowData.childRowId;
-                row.vectorIndex = rowData.vecIndex;
-                row.unionType = rowData.unionType;
-                result.push_back(row);
-            }
+        auto [begin, end] = it->second.byParent.find(parentRowId);
+        for (size_t i = begin; i < end; i++) {
+            appendLive(it->second, it->second.byParent.rows()[i], result);
         }
         return result;
     }
@@ -492,40 +602,41 @@ struct JunctionManager::Impl {
         auto it = junctionTables.find(junctionName);
         if (it == junctionTables.end()) return result;
 
-        auto range = it->second.childIndex.equal_range(childRowId);
-        for (auto pit = range.first; pit != range.second; ++pit) {
-            const auto& rowData = it->second.rows[pit->second];
-            if (rowData.id != 0) {
-                JunctionRow row;
-                row.parentRowId = rowData.parentRowId;
-                row.childRowId = rowData.childRowId;
-                row.vectorIndex = rowData.vecIndex;
-                row.unionType = rowData.unionType;
-                result.push_back(row);
-            }
+        auto [begin, end] = it->second.byChild.find(childRowId);
+        for (size_t i = begin; i < end; i++) {
+            appendLive(it->second, it->second.byChild.rows()[i], result);
         }
         return result;
     }
 
+    // Junction rows of table still linking childRowId to a parent
+    static size_t liveParents(JunctionTableData& table, uint64_t childRowId) {
+        size_t count = 0;
+        auto [begin, end] = table.byChild.find(childRowId);
+        for (size_t i = begin; i < end; i++) {
+            if (table.rows[table.byChild.rows()[i]].id != 0) count++;
+        }
+        return count;
+    }
+
     // Count references to a child
     size_t countChildReferences(uint64_t childRowId) {
         size_t count = 0;
-        for (const auto& [name, table] : junctionTables) {
-            auto range = table.childIndex.equal_range(childRowId);
-            for (auto it = range.first; it != range.second; ++it) {
-                if (table.rows[it->second].id != 0) {
-                    count++;
-                }
-            }
+        for (auto& [name, table] : junctionTables) {
+            count += liveParents(table, childRowId);
         }
         return count;
     }
 };
 
 JunctionManager::JunctionManager(FlatSQLDatabase& db)
-    : impl_(std::make_unique<Impl>(db)) {}
+    : impl_(std::make_unique<Impl>(db)) {
+    db.attachJunctions(this);
+}
 
-JunctionManager::~JunctionManager() = default;
+JunctionManager::~JunctionManager() {
+    impl_->db.detachJunctions(this);
+}
 
 void JunctionManager::initialize(const SchemaAnalysis& analysis) {
     impl_->analysis = analysis;
@@ -542,63 +653,161 @@ uint64_t JunctionManager::insertWithRelations(
     const std::string& tableName,
     const std::vector<uint8_t>& flatbufferData
 ) {
-    // 1. Insert parent record using streaming ingest
-    uint64_t parentRowId = impl_->db.ingestOne(flatbufferData.data(), flatbufferData.size());
+    return insertWithRelations(tableName, flatbufferData.data(), flatbufferData.size());
+}
+
+uint64_t JunctionManager::insertWithRelations(const std::string& tableName, const uint8_t* data,
+                                              size_t length) {
+    // 1. Insert parent record using streaming ingest (the only copy)
+    uint64_t parentRowId = impl_->db.ingestOne(data, length);
 
-    // 2. Extract and insert children
+    // 2. Locate children in the stored parent and link them
     auto tableIt = impl_->analysis.tables.find(tableName);
-    if (tableIt != impl_->analysis.tables.end()) {
-        auto children = FlatBufferExtractor::extractChildren(
-            flatbufferData, tableIt->second, impl_->analysis.tables
-        );
-
-        for (const auto& child : children) {
-            // Insert child using streaming ingest
-            uint64_t childRowId = impl_->db.ingestOne(child.data.data(), child.data.size());
-
-            // Create junction row
-            std::string junctionName = tableName + "__" + child.fieldName;
-            impl_->addJunctionRow(junctionName, parentRowId, childRowId,
-                                  child.vectorIndex, child.unionType);
+    if (tableIt == impl_->analysis.tables.end() || tableIt->second.references.empty()) {
+        return parentRowId;
+    }
+    const auto& storage = impl_->db.getStorage();
+    auto parentOffset = storage.getOffsetForSequence(parentRowId);
+    if (!parentOffset) return parentRowId;
+    uint32_t storedLength = 0;
+    const uint8_t* stored = storage.getDataAtOffset(*parentOffset, &storedLength);
+
+    auto children = FlatBufferExtractor::extractChildren(
+        stored, storedLength, tableIt->second, impl_->analysis.tables
+    );
+    impl_->childRecords.reserve(impl_->childRecords.size() + children.size());
+    for (auto& child : children) {
+        ChildRecordData record;
+        record.parentRowId = parentRowId;
+        record.offset = static_cast<uint32_t>(child.offset);
+        record.length = static_cast<uint32_t>(child.size());
+        record.copy = std::move(child.data);
+        impl_->childRecords.push_back(std::move(record));
+        uint64_t childRowId = impl_->childRecords.size();
+
+        // Create junction row
+        std::string junctionName = tableName + "__" + child.fieldName;
+        uint64_t junctionId = impl_->addJunctionRow(junctionName, parentRowId, childRowId,
+                                                    child.vectorIndex, child.unionType);
+        if (junctionId == 0) {
+            impl_->childRecords.pop_back();  // Field without a junction table
         }
     }
 
     return parentRowId;
 }
 
+const uint8_t* JunctionManager::getChildData(uint64_t childRowId, size_t* outLength) const {
+    if (childRowId == 0 || childRowId > impl_->childRecords.size()) return nullptr;
+    const ChildRecordData& record = impl_->childRecords[childRowId - 1];
+    if (record.parentRowId == 0) return nullptr;  // Released by deleteWithCascade
+    if (!record.copy.empty()) {
+        if (outLength) *outLength = record.copy.size();
+        return record.copy.data();
+    }
+    const auto& storage = impl_->db.getStorage();
+    auto parentOffset = storage.getOffsetForSequence(record.parentRowId);
+    if (!parentOffset) return nullptr;
+    uint32_t parentLength = 0;
+    const uint8_t* parent = storage.getDataAtOffset(*parentOffset, &parentLength);
+    if (static_cast<uint64_t>(record.offset) + record.length > parentLength) return nullptr;
+    if (outLength) *outLength = record.length;
+    return parent + record.offset;
+}
+
 void JunctionManager::deleteWithCascade(const std::string& tableName, uint64_t rowId) {
-    // Collect children to potentially delete
-    std::vector<std::pair<std::string, uint64_t>> childrenToCheck;
+    deleteWithCascade(tableName, std::vector<uint64_t>{rowId});
+}
 
-    // 1. Find all junction tables where this table is the parent
-    for (const auto& [jName, tableData] : impl_->junctionTables) {
-        if (tableData.definition.parentTable == tableName) {
-            // Get children before deleting junction rows
-            auto children = impl_->getChildrenByParent(jName, rowId);
-
-            for (const auto& child : children) {
-                std::string childTable = tableData.definition.childTable;
-                if (tableData.definition.relationType == RelationType::UNION ||
-                    tableData.definition.relationType == RelationType::VECTOR_UNION) {
-                    childTable = child.unionType.value_or("");
-                }
-                if (!childTable.empty()) {
-                    childrenToCheck.emplace_back(childTable, child.childRowId);
-                }
+size_t JunctionManager::deleteWithCascade(const std::string& tableName, const std::vector<uint64_t>& rowIds) {
+    std::vector<uint64_t> roots(rowIds);
+    std::sort(roots.begin(), roots.end());
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+    roots.erase(std::remove(roots.begin(), roots.end(), 0), roots.end());
+    if (roots.empty()) return 0;
+
+    // 1. Tombstone the parents together (throws before anything changes)
+    impl_->db.markDeleted(tableName, roots);
+
+    // 2. Drop their junction rows, keeping the children they linked
+    std::vector<std::pair<const std::string*, uint64_t>> children;
+    for (auto& [jName, table] : impl_->junctionTables) {
+        if (table.definition.parentTable != tableName) continue;
+        bool unionField = table.definition.relationType == RelationType::UNION ||
+                          table.definition.relationType == RelationType::VECTOR_UNION;
+        for (uint64_t root : roots) {
+            auto [begin, end] = table.byParent.find(root);
+            for (size_t i = begin; i < end; i++) {
+                JunctionRowData& row = table.rows[table.byParent.rows()[i]];
+                if (row.id == 0) continue;
+                row.id = 0;  // The child side skips it by id
+                table.liveRows--;
+                const std::string* childTable = &table.definition.childTable;
+                if (unionField) childTable = row.unionType ? &*row.unionType : nullptr;
+                if (childTable && !childTable->empty()) children.emplace_back(childTable, row.childRowId);
             }
-
-            // Delete junction rows
-            impl_->removeByParent(jName, rowId);
+            table.byParent.clear(root);
         }
     }
 
-    // 2. Track this row as deleted
-    impl_->deletedRowIds.insert(rowId);
+    // 3. Release the children nothing links any more. They are views into
+    // their parent's record with no junction rows of their own, so the
+    // closure ends here.
+    size_t released = 0;
+    for (const auto& [childTable, childRowId] : children) {
+        if (childRowId == 0 || childRowId > impl_->childRecords.size()) continue;
+        ChildRecordData& record = impl_->childRecords[childRowId - 1];
+        if (record.parentRowId == 0 || impl_->countChildReferences(childRowId) != 0) continue;
+        record.parentRowId = 0;
+        std::vector<uint8_t>().swap(record.copy);
+        impl_->releasedChildren[*childTable]++;
+        released++;
+    }
+    return released;
+}
+
+void JunctionManager::remapParents(const std::vector<uint64_t>& sequenceMap) {
+    auto remap = [&](uint64_t sequence) -> uint64_t {
+        return sequence < sequenceMap.size() ? sequenceMap[sequence] : 0;
+    };
+
+    // Children live inside their parent's record, so they go with it
+    std::vector<bool> released(impl_->childRecords.size(), false);
+    for (size_t i = 0; i < impl_->childRecords.size(); i++) {
+        ChildRecordData& record = impl_->childRecords[i];
+        if (record.parentRowId == 0) continue;
+        record.parentRowId = remap(record.parentRowId);
+        if (record.parentRowId == 0) {
+            std::vector<uint8_t>().swap(record.copy);
+            released[i] = true;
+        }
+    }
 
-    // 3. Check each child for orphan status and recursively delete
-    for (const auto& [childTable, childRowId] : childrenToCheck) {
-        if (getReferenceCount(childTable, childRowId) == 0) {
-            deleteWithCascade(childTable, childRowId);
+    // Rebuild both sides from the rows left, in row (insertion) order;
+    // clustered compaction may reorder parents, which appends stage
+    for (auto& [jName, table] : impl_->junctionTables) {
+        bool unionField = table.definition.relationType == RelationType::UNION ||
+                          table.definition.relationType == RelationType::VECTOR_UNION;
+        table.byParent = AdjacencyCsr();
+        table.byChild = AdjacencyCsr();
+        for (size_t rowIndex = 0; rowIndex < table.rows.size(); rowIndex++) {
+            JunctionRowData& row = table.rows[rowIndex];
+            if (row.id == 0) continue;
+            row.parentRowId = remap(row.parentRowId);
+            if (row.parentRowId == 0) {
+                row.id = 0;
+                table.liveRows--;
+                uint64_t childRowId = row.childRowId;
+                if (childRowId != 0 && childRowId <= released.size() && released[childRowId - 1]) {
+                    released[childRowId - 1] = false;  // Counted once
+                    const std::string* childTable = &table.definition.childTable;
+                    if (unionField) childTable = row.unionType ? &*row.unionType : nullptr;
+                    if (childTable && !childTable->empty()) impl_->releasedChildren[*childTable]++;
+                }
+                continue;
+            }
+            table.byParent.append(row.parentRowId, row.childRowId, rowIndex);
+            table.byChild.append(row.childRowId, row.parentRowId, rowIndex);
         }
     }
 }
@@ -612,6 +821,54 @@ std::vector<JunctionRow> JunctionManager::getChildren(
     return impl_->getChildrenByParent(junctionName, parentRowId);
 }
 
+RowIdSlice JunctionManager::getChildRowIds(const std::string& parentTable, const std::string& fieldName,
+                                           uint64_t parentRowId) {
+    auto it = impl_->junctionTables.find(parentTable + "__" + fieldName);
+    if (it == impl_->junctionTables.end()) return {};
+    auto [begin, end] = it->second.byParent.find(parentRowId);
+    if (begin == end) return {};
+    return {it->second.byParent.targets().data() + begin, end - begin};
+}
+
+void JunctionManager::collectChildren(const std::string& junctionName,
+                                      const std::vector<uint64_t>* parentRowIds,
+                                      std::vector<JunctionRow>& out) {
+    auto it = impl_->junctionTables.find(junctionName);
+    if (it == impl_->junctionTables.end()) return;
+    JunctionTableData& table = it->second;
+    const auto& rowIndexes = table.byParent.rows();
+
+    if (!parentRowIds) {
+        out.reserve(out.size() + table.liveRows);
+        size_t keys = table.byParent.keyCount();
+        for (size_t k = 0; k < keys; k++) {
+            auto [begin, end] = table.byParent.slice(k);
+            for (size_t i = begin; i < end; i++) {
+                impl_->appendLive(table, rowIndexes[i], out);
+            }
+        }
+        return;
+    }
+    for (uint64_t parentRowId : *parentRowIds) {
+        auto [begin, end] = table.byParent.find(parentRowId);
+        for (size_t i = begin; i < end; i++) {
+            impl_->appendLive(table, rowIndexes[i], out);
+        }
+    }
+}
+
+JunctionStats JunctionManager::getJunctionStats(const std::string& junctionName) {
+    auto it = impl_->junctionTables.find(junctionName);
+    if (it == impl_->junctionTables.end()) return {};
+    return {it->second.liveRows, it->second.byParent.liveKeys()};
+}
+
+void JunctionManager::registerTables() {
+    for (const auto& [name, tableData] : impl_->junctionTables) {
+        impl_->db.createJunctionTable(*this, tableData.definition);
+    }
+}
+
 std::vector<JunctionRow> JunctionManager::getParents(
     const std::string& childTable,
     uint64_t childRowId
@@ -640,11 +897,10 @@ std::vector<JunctionRow> JunctionManager::getParents(
 }
 
 size_t JunctionManager::cleanupOrphans(const std::string& tableName) {
-    // This would require iterating all records in tableName and checking
-    // if each has any junction references. For now, return the count of
-    // deleted rows that were marked.
-    size_t cleaned = impl_->deletedRowIds.size();
-    impl_->deletedRowIds.clear();
+    auto it = impl_->releasedChildren.find(tableName);
+    if (it == impl_->releasedChildren.end()) return 0;
+    size_t cleaned = it->second;
+    impl_->releasedChildren.erase(it);
     return cleaned;
 }
 
@@ -659,7 +915,7 @@ std::vector<JunctionTable> JunctionManager::getJunctionTables() const {
 size_t JunctionManager::getReferenceCount(const std::string& tableName, uint64_t rowId) {
     size_t count = 0;
 
-    for (const auto& [jName, tableData] : impl_->junctionTables) {
+    for (auto& [jName, tableData] : impl_->junctionTables) {
         bool matches = (tableData.definition.childTable == tableName);
         if (!matches) {
             for (const auto& ut : tableData.definition.unionChildTables) {
@@ -671,12 +927,7 @@ size_t JunctionManager::getReferenceCount(const std::string& tableName, uint64_t
         }
 
         if (matches) {
-            auto range = tableData.childIndex.equal_range(rowId);
-            for (auto it = range.first; it != range.second; ++it) {
-                if (tableData.rows[it->second].id != 0) {
-                    count++;
-                }
-            }
+            count += Impl::liveParents(tableData, rowId);
         }
     }
 
@@ -687,66 +938,171 @@ size_t JunctionManager::getReferenceCount(const std::string& tableName, uint64_t
 // FlatBufferExtractor implementation
 // ============================================================================
 
+namespace {
+
+// Bounds-checked little-endian reads from a FlatBuffer
+template <typename T>
+bool readAt(const uint8_t* data, size_t length, size_t pos, T& out) {
+    if (pos > length || length - pos < sizeof(T)) return false;
+    std::memcpy(&out, data + pos, sizeof(T));
+    return true;
+}
+
+// Position of field fieldId's value in the table at tablePos, 0 if absent
+size_t fieldPosition(const uint8_t* data, size_t length, size_t tablePos, int fieldId) {
+    int32_t soffset;
+    if (!readAt(data, length, tablePos, soffset)) return 0;
+    int64_t vtable = static_cast<int64_t>(tablePos) - soffset;
+    uint16_t vtableSize, fieldOffset;
+    if (vtable < 0 || !readAt(data, length, static_cast<size_t>(vtable), vtableSize)) return 0;
+    size_t slot = 4 + 2 * static_cast<size_t>(fieldId);
+    if (slot + 2 > vtableSize ||
+        !readAt(data, length, static_cast<size_t>(vtable) + slot, fieldOffset) || fieldOffset == 0) {
+        return 0;
+    }
+    return tablePos + fieldOffset;
+}
+
+// Target of the uoffset stored at pos, 0 if it leaves the buffer
+size_t follow(const uint8_t* data, size_t length, size_t pos) {
+    uint32_t offset;
+    if (!readAt(data, length, pos, offset) || offset == 0 || offset >= length - pos) return 0;
+    return pos + offset;
+}
+
+// Child whose table the uoffset at ref points to. Everything a table
+// refers to lies after it except possibly its vtable, so the child is
+// self-contained from ref onwards unless the vtable is before ref; then
+// the bytes from the vtable on are copied behind a new root offset.
+bool locateChild(const uint8_t* data, size_t length, size_t ref,
+                 FlatBufferExtractor::ExtractedChild& child) {
+    size_t table = follow(data, length, ref);
+    int32_t soffset;
+    if (table == 0 || !readAt(data, length, table, soffset)) return false;
+    int64_t vtable = static_cast<int64_t>(table) - soffset;
+    uint16_t vtableSize;
+    if (vtable < 0 || !readAt(data, length, static_cast<size_t>(vtable), vtableSize)) return false;
+
+    if (static_cast<size_t>(vtable) >= ref) {
+        child.offset = ref;
+        child.length = length - ref;
+        return true;
+    }
+    size_t from = static_cast<size_t>(vtable);
+    uint32_t root = static_cast<uint32_t>(4 + (table - from));
+    child.offset = ref;
+    child.data.resize(4 + (length - from));
+    std::memcpy(child.data.data(), &root, 4);
+    std::memcpy(child.data.data() + 4, data + from, length - from);
+    child.length = child.data.size();
+    return true;
+}
+
+// Elements of the vector whose uoffset is at pos: (count, first element)
+bool vectorAt(const uint8_t* data, size_t length, size_t pos, uint32_t& count, size_t& elements) {
+    size_t vector = follow(data, length, pos);
+    if (vector == 0 || !readAt(data, length, vector, count)) return false;
+    elements = vector + 4;
+    return elements <= length;
+}
+
+}  // anonymous namespace
+
 std::vector<FlatBufferExtractor::ExtractedChild> FlatBufferExtractor::extractChildren(
     const std::vector<uint8_t>& parentData,
     const TableInfo& tableInfo,
     const std::map<std::string, TableInfo>& allTables
 ) {
-    std::vector<ExtractedChild> children;
-
-    // This requires understanding the FlatBuffer binary format
-    // to extract nested tables from the parent buffer.
-    //
-    // For each table reference in tableInfo.references:
-    // 1. Find the field offset in the vtable
-    // 2. Read the offset to the nested table/vector
-    // 3. Extract the bytes for that nested FlatBuffer
-    // 4. For vectors, iterate and extract each element
-    // 5. For unions, also extract the type discriminator
+    return extractChildren(parentData.data(), parentData.size(), tableInfo, allTables);
+}
 
-    // This is a placeholder - actual implementation would use
-    // FlatBuffers reflection or generated accessors
+std::vector<FlatBufferExtractor::ExtractedChild> FlatBufferExtractor::extractChildren(
+    const uint8_t* data, size_t length,
+    const TableInfo& tableInfo,
+    const std::map<std::string, TableInfo>& /*allTables*/
+) {
+    std::vector<ExtractedChild> children;
+    size_t root = follow(data, length, 0);
+    if (root == 0) return children;
 
     for (const auto& ref : tableInfo.references) {
-        // Extract based on relationship type
+        if (ref.fieldId < 0) continue;
+        bool isUnion = ref.relationType == RelationType::UNION ||
+                       ref.relationType == RelationType::VECTOR_UNION;
+        size_t pos = fieldPosition(data, length, root, isUnion ? ref.fieldId + 1 : ref.fieldId);
+        if (pos == 0) continue;
+
+        // Union member named by a _type value (1-based, 0 = NONE)
+        auto memberOf = [&ref](uint8_t type) -> const std::string* {
+            if (type == 0 || type > ref.unionTypes.size()) return nullptr;
+            return &ref.unionTypes[type - 1];
+        };
+
         switch (ref.relationType) {
             case RelationType::SINGLE_TABLE: {
-                // Extract single nested table
                 ExtractedChild child;
                 child.fieldName = ref.fieldName;
                 child.tableName = ref.referencedType;
-                // child.data = extracted bytes
-                children.push_back(child);
+                if (locateChild(data, length, pos, child)) {
+                    children.push_back(std::move(child));
+                }
                 break;
             }
 
             case RelationType::VECTOR_TABLE: {
-                // Extract each element of the vector
-                // for (int i = 0; i < vectorLength; i++) {
-                //     ExtractedChild child;
-                //     child.fieldName = ref.fieldName;
-                //     child.tableName = ref.referencedType;
-                //     child.vectorIndex = i;
-                //     child.data = extracted bytes for element i
-                //     children.push_back(child);
-                // }
+                uint32_t count;
+                size_t elements;
+                if (!vectorAt(data, length, pos, count, elements)) break;
+                for (uint32_t i = 0; i < count; i++) {
+                    ExtractedChild child;
+                    child.fieldName = ref.fieldName;
+                    child.tableName = ref.referencedType;
+                    child.vectorIndex = static_cast<int32_t>(i);
+                    if (locateChild(data, length, elements + 4 * static_cast<size_t>(i), child)) {
+                        children.push_back(std::move(child));
+                    }
+                }
                 break;
             }
 
             case RelationType::UNION: {
-                // Extract union with type discriminator
+                size_t typePos = fieldPosition(data, length, root, ref.fieldId);
+                uint8_t type = 0;
+                if (typePos == 0 || !readAt(data, length, typePos, type)) break;
+                const std::string* member = memberOf(type);
+                if (!member) break;
                 ExtractedChild child;
                 child.fieldName = ref.fieldName;
-                // child.unionType = read type from union_type field
-                // child.tableName = resolve type name
-                // child.data = extracted bytes
-                children.push_back(child);
+                child.tableName = *member;
+                child.unionType = *member;
+                if (locateChild(data, length, pos, child)) {
+                    children.push_back(std::move(child));
+                }
                 break;
             }
 
             case RelationType::VECTOR_UNION: {
-                // Extract each union element
-                // Similar to VECTOR_TABLE but with type per element
+                size_t typesPos = fieldPosition(data, length, root, ref.fieldId);
+                uint32_t count, typeCount;
+                size_t elements, types;
+                if (typesPos == 0 || !vectorAt(data, length, pos, count, elements) ||
+                    !vectorAt(data, length, typesPos, typeCount, types)) {
+                    break;
+                }
+                for (uint32_t i = 0; i < count && i < typeCount; i++) {
+                    uint8_t type = 0;
+                    if (!readAt(data, length, types + i, type)) break;
+                    const std::string* member = memberOf(type);
+                    if (!member) continue;
+                    ExtractedChild child;
+                    child.fieldName = ref.fieldName;
+                    child.tableName = *member;
+                    child.unionType = *member;
+                    child.vectorIndex = static_cast<int32_t>(i);
+                    if (locateChild(data, length, elements + 4 * static_cast<size_t>(i), child)) {
+                        children.push_back(std::move(child));
+                    }
+                }
                 break;
             }
         }
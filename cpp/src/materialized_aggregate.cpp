@@ -0,0 +1,269 @@
+#include "flatsql/materialized_aggregate.h"
+#include "flatsql/column_cache.h"
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace flatsql {
+
+MaterializedAggregate::MaterializedAggregate(const std::string& name, const TableDef& table,
+                                             const MaterializedAggregateDef& def)
+    : name_(name), def_(def) {
+    auto readColumn = [&](const std::string& column, bool numeric) {
+        int col = table.getColumnIndex(column);
+        if (col < 0) {
+            throw std::runtime_error("Column not found: " + table.name + "." + column);
+        }
+        const ColumnDef& colDef = table.columns[col];
+        if (colDef.encrypted) {
+            throw std::runtime_error("Cannot aggregate encrypted column: " + column);
+        }
+        if (numeric && !ColumnCache::supports(colDef.type)) {
+            throw std::runtime_error("SUM and AVG require a numeric column: " + column);
+        }
+        auto it = std::find(readColumns_.begin(), readColumns_.end(), column);
+        if (it != readColumns_.end()) return static_cast<int>(it - readColumns_.begin());
+        readColumns_.push_back(column);
+        return static_cast<int>(readColumns_.size() - 1);
+    };
+
+    if (isGrouped()) {
+        readColumn(def_.groupBy, false);
+        columnNames_.push_back(def_.groupBy);
+    }
+    for (const AggregateSpec& spec : def_.aggregates) {
+        if (spec.column.empty()) {
+            if (spec.op != AggregateSpec::Op::Count) {
+                throw std::runtime_error("Only COUNT takes no column");
+            }
+            aggregateColumns_.push_back(-1);
+        } else if (spec.op == AggregateSpec::Op::ApproxCountDistinct ||
+                   spec.op == AggregateSpec::Op::ApproxPercentile) {
+            // Sketches cannot take a deleted record back out
+            throw std::runtime_error("Approximate aggregates cannot be materialized: " + spec.label());
+        } else {
+            bool numeric = spec.op == AggregateSpec::Op::Sum || spec.op == AggregateSpec::Op::Avg;
+            aggregateColumns_.push_back(readColumn(spec.column, numeric));
+        }
+        columnNames_.push_back(spec.label());
+    }
+    for (const std::string& column : def_.last) {
+        lastColumns_.push_back(readColumn(column, false));
+        columnNames_.push_back("LAST(" + column + ")");
+    }
+    values_.resize(readColumns_.size());
+
+    // The single group exists even before any record, like SELECT COUNT(*)
+    if (!isGrouped()) {
+        resetGroup(groups_[Value()]);
+    }
+}
+
+Value MaterializedAggregate::groupKey(const uint8_t* data, size_t length,
+                                      const FieldExtractor& extractor) const {
+    return isGrouped() ? toSqlValue(extractor(data, length, def_.groupBy)) : Value();
+}
+
+void MaterializedAggregate::resetGroup(Group& group) const {
+    group.rows = 0;
+    group.slots.assign(def_.aggregates.size(), Slot());
+    group.lastSequence = 0;
+    group.lastValues.assign(def_.last.size(), Value());
+}
+
+// Add value to a sum; past the int64 range the sum continues as a double
+static void addToSum(MaterializedAggregate::Slot& slot, const Value& value, bool subtract) {
+    std::visit([&slot, subtract](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            slot.realSum += subtract ? -static_cast<double>(v) : static_cast<double>(v);
+            slot.real = true;
+        } else if constexpr (std::is_integral_v<T>) {
+            int64_t n = static_cast<int64_t>(v);
+            bool overflow = subtract ? __builtin_sub_overflow(slot.intSum, n, &slot.intSum)
+                                     : __builtin_add_overflow(slot.intSum, n, &slot.intSum);
+            if (overflow) {
+                slot.realSum += subtract ? -static_cast<double>(n) : static_cast<double>(n);
+                slot.real = true;
+            }
+        }
+    }, value);
+}
+
+void MaterializedAggregate::accumulate(Group& group, const uint8_t* data, size_t length, uint64_t sequence,
+                                       const FieldExtractor& extractor) {
+    for (size_t c = 0; c < readColumns_.size(); c++) {
+        values_[c] = extractor(data, length, readColumns_[c]);
+    }
+
+    group.rows++;
+    for (size_t i = 0; i < group.slots.size(); i++) {
+        Slot& slot = group.slots[i];
+        if (aggregateColumns_[i] < 0) {
+            slot.count++;
+            continue;
+        }
+        const Value& value = values_[aggregateColumns_[i]];
+        if (std::holds_alternative<std::monostate>(value)) continue;
+        slot.count++;
+
+        switch (def_.aggregates[i].op) {
+            case AggregateSpec::Op::Count:
+                break;
+            case AggregateSpec::Op::Sum:
+            case AggregateSpec::Op::Avg:
+                addToSum(slot, value, false);
+                break;
+            case AggregateSpec::Op::Min:
+                if (slot.count == 1 || compareValues(value, slot.min) < 0) slot.min = toSqlValue(value);
+                break;
+            case AggregateSpec::Op::Max:
+                if (slot.count == 1 || compareValues(value, slot.max) > 0) slot.max = toSqlValue(value);
+                break;
+            default:
+                break;  // Approximate aggregates are rejected on construction
+        }
+    }
+
+    if (sequence >= group.lastSequence) {
+        group.lastSequence = sequence;
+        for (size_t i = 0; i < lastColumns_.size(); i++) {
+            group.lastValues[i] = toSqlValue(values_[lastColumns_[i]]);
+        }
+    }
+}
+
+void MaterializedAggregate::add(const uint8_t* data, size_t length, uint64_t sequence,
+                                const FieldExtractor& extractor) {
+    auto [it, inserted] = groups_.try_emplace(groupKey(data, length, extractor));
+    if (inserted) {
+        resetGroup(it->second);
+    }
+    accumulate(it->second, data, length, sequence, extractor);
+}
+
+void MaterializedAggregate::remove(const uint8_t* data, size_t length, uint64_t sequence,
+                                   const FieldExtractor& extractor) {
+    auto it = groups_.find(groupKey(data, length, extractor));
+    if (it == groups_.end() || it->second.rows == 0) return;
+    Group& group = it->second;
+
+    if (--group.rows == 0) {
+        if (group.stale) staleGroups_--;
+        resetGroup(group);
+        group.stale = false;
+        return;
+    }
+    if (group.stale) return;  // refresh() recounts it anyway
+
+    for (size_t c = 0; c < readColumns_.size(); c++) {
+        values_[c] = extractor(data, length, readColumns_[c]);
+    }
+    bool stale = !lastColumns_.empty() && sequence == group.lastSequence;
+    for (size_t i = 0; i < group.slots.size(); i++) {
+        Slot& slot = group.slots[i];
+        if (aggregateColumns_[i] < 0) {
+            slot.count--;
+            continue;
+        }
+        const Value& value = values_[aggregateColumns_[i]];
+        if (std::holds_alternative<std::monostate>(value)) continue;
+        if (--slot.count == 0) {
+            slot = Slot();
+            continue;
+        }
+
+        switch (def_.aggregates[i].op) {
+            case AggregateSpec::Op::Count:
+                break;
+            case AggregateSpec::Op::Sum:
+            case AggregateSpec::Op::Avg:
+                addToSum(slot, value, true);
+                break;
+            case AggregateSpec::Op::Min:
+                stale = stale || compareValues(value, slot.min) == 0;
+                break;
+            case AggregateSpec::Op::Max:
+                stale = stale || compareValues(value, slot.max) == 0;
+                break;
+            default:
+                break;
+        }
+    }
+    if (stale) {
+        group.stale = true;
+        staleGroups_++;
+    }
+}
+
+void MaterializedAggregate::remapSequences(const std::vector<uint64_t>& sequenceMap) {
+    for (auto& [key, group] : groups_) {
+        if (group.rows == 0) continue;
+        uint64_t sequence = group.lastSequence < sequenceMap.size() ? sequenceMap[group.lastSequence] : 0;
+        group.lastSequence = sequence;
+        if (sequence == 0 && !group.stale) {
+            group.stale = true;
+            staleGroups_++;
+        }
+    }
+}
+
+void MaterializedAggregate::clear() {
+    for (auto& [key, group] : groups_) {
+        resetGroup(group);
+        group.stale = false;
+    }
+    staleGroups_ = 0;
+}
+
+void MaterializedAggregate::refresh(const LiveScan& scan, const FieldExtractor& extractor) {
+    if (staleGroups_ == 0) return;
+    for (auto& [key, group] : groups_) {
+        if (group.stale) resetGroup(group);
+    }
+    scan([&](const uint8_t* data, size_t length, uint64_t sequence) {
+        auto it = groups_.find(groupKey(data, length, extractor));
+        if (it != groups_.end() && it->second.stale) {
+            accumulate(it->second, data, length, sequence, extractor);
+        }
+    });
+    for (auto& [key, group] : groups_) {
+        group.stale = false;
+    }
+    staleGroups_ = 0;
+}
+
+Value MaterializedAggregate::result(const Groups::value_type& entry, size_t column) const {
+    const Group& group = entry.second;
+    if (isGrouped()) {
+        if (column == 0) return entry.first;
+        column--;
+    }
+    if (column >= group.slots.size()) {
+        return group.lastValues[column - group.slots.size()];
+    }
+
+    const Slot& slot = group.slots[column];
+    AggregateSpec::Op op = def_.aggregates[column].op;
+    if (op == AggregateSpec::Op::Count) {
+        return static_cast<int64_t>(slot.count);
+    }
+    if (slot.count == 0) {
+        return std::monostate{};
+    }
+    switch (op) {
+        case AggregateSpec::Op::Sum:
+            if (slot.real) return static_cast<double>(slot.intSum) + slot.realSum;
+            return slot.intSum;
+        case AggregateSpec::Op::Avg:
+            return (static_cast<double>(slot.intSum) + slot.realSum) / static_cast<double>(slot.count);
+        case AggregateSpec::Op::Min:
+            return slot.min;
+        case AggregateSpec::Op::Max:
+            return slot.max;
+        default:
+            return std::monostate{};
+    }
+}
+
+}  // namespace flatsql
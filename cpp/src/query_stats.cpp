@@ -0,0 +1,63 @@
+#include "flatsql/query_stats.h"
+
+namespace flatsql {
+
+const QueryStatsCounter QUERY_STATS_COUNTERS[] = {
+    {"rows_scanned", &QueryStats::rowsScanned},
+    {"rows_returned", &QueryStats::rowsReturned},
+    {"index_probes", &QueryStats::indexProbes},
+    {"filter_calls", &QueryStats::filterCalls},
+    {"next_calls", &QueryStats::nextCalls},
+    {"column_calls", &QueryStats::columnCalls},
+    {"fast_extractor_calls", &QueryStats::fastExtractorCalls},
+    {"schema_extractor_calls", &QueryStats::schemaExtractorCalls},
+    {"slow_extractor_calls", &QueryStats::slowExtractorCalls},
+    {"batch_extractor_calls", &QueryStats::batchExtractorCalls},
+    {"column_cache_reads", &QueryStats::columnCacheReads},
+    {"covered_reads", &QueryStats::coveredReads},
+    {"decryptions", &QueryStats::decryptions},
+    {"bytes_touched", &QueryStats::bytesTouched},
+    {"filter_ns", &QueryStats::filterNanos},
+    {"next_ns", &QueryStats::nextNanos},
+    {"column_ns", &QueryStats::columnNanos},
+    {"total_ns", &QueryStats::totalNanos},
+};
+const size_t QUERY_STATS_COUNTER_COUNT = sizeof(QUERY_STATS_COUNTERS) / sizeof(QUERY_STATS_COUNTERS[0]);
+
+const uint64_t* findQueryStatsCounter(const QueryStats& stats, const std::string& column) {
+    for (size_t i = 0; i < QUERY_STATS_COUNTER_COUNT; i++) {
+        if (column == QUERY_STATS_COUNTERS[i].column) {
+            return &(stats.*QUERY_STATS_COUNTERS[i].field);
+        }
+    }
+    return nullptr;
+}
+
+void QueryStatsLog::setCapacity(size_t capacity) {
+    capacity_ = capacity > 0 ? capacity : 1;
+    while (recent_.size() > capacity_) {
+        recent_.pop_front();
+    }
+}
+
+bool QueryStatsLog::begin(const std::string& sql) {
+    if (!enabled_ || current) return false;
+    active_ = QueryStats();
+    active_.id = nextId_++;
+    active_.sql = sql;
+    started_ = Clock::now();
+    current = &active_;
+    return true;
+}
+
+void QueryStatsLog::end() {
+    if (!current) return;
+    active_.totalNanos = nanosSince(started_);
+    current = nullptr;
+    if (recent_.size() >= capacity_) {
+        recent_.pop_front();
+    }
+    recent_.push_back(active_);
+}
+
+}  // namespace flatsql
@@ -0,0 +1,33 @@
+#include "flatsql/record_verification.h"
+
+namespace flatsql {
+
+bool RecordVerification::check(uint64_t sequence, const uint8_t* data, size_t length) {
+    size_t word = static_cast<size_t>(sequence / SEQUENCES_PER_WORD);
+    unsigned shift = static_cast<unsigned>(sequence % SEQUENCES_PER_WORD) * 2;
+    if (word >= outcomes_.size()) {
+        return verify(data, length);
+    }
+
+    uint64_t& outcomes = outcomes_[word];
+    uint64_t outcome = (__atomic_load_n(&outcomes, __ATOMIC_ACQUIRE) >> shift) & (CHECKED | PASSED);
+    if (outcome & CHECKED) {
+        return (outcome & PASSED) != 0;
+    }
+    bool passed = verify(data, length);
+    uint64_t mark = (passed ? CHECKED | PASSED : CHECKED) << shift;
+    uint64_t before = __atomic_fetch_or(&outcomes, mark, __ATOMIC_ACQ_REL);
+    if (!passed && !((before >> shift) & CHECKED)) {
+        countFailure();  // Only the first of racing readers counts it
+    }
+    return passed;
+}
+
+void RecordVerification::reserve(uint64_t sequence) {
+    size_t words = static_cast<size_t>(sequence / SEQUENCES_PER_WORD) + 1;
+    while (outcomes_.size() < words) {
+        outcomes_.push_back(0);
+    }
+}
+
+}  // namespace flatsql
@@ -0,0 +1,132 @@
+#include "flatsql/replication.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace flatsql {
+
+namespace {
+
+constexpr uint8_t FRAME_MAGIC[4] = {'F', 'S', 'Q', 'R'};
+constexpr uint32_t FRAME_VERSION = 1;
+
+void putUint(std::vector<uint8_t>& out, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+void putPosition(std::vector<uint8_t>& out, const ReplicationPosition& position) {
+    putUint(out, position.epoch, 8);
+    putUint(out, position.sequence, 8);
+    putUint(out, position.deletes, 8);
+    out.push_back(position.snapshot ? 1 : 0);
+}
+
+class FrameReader {
+public:
+    FrameReader(const uint8_t* data, size_t length) : data_(data), end_(data + length) {}
+
+    const uint8_t* take(size_t n) {
+        if (static_cast<size_t>(end_ - data_) < n) {
+            throw std::runtime_error("Truncated replication frame");
+        }
+        const uint8_t* p = data_;
+        data_ += n;
+        return p;
+    }
+    uint64_t uint(size_t bytes) {
+        const uint8_t* p = take(bytes);
+        uint64_t v = 0;
+        for (size_t i = 0; i < bytes; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+        return v;
+    }
+    ReplicationPosition position() {
+        ReplicationPosition p;
+        p.epoch = uint(8);
+        p.sequence = uint(8);
+        p.deletes = uint(8);
+        p.snapshot = *take(1) != 0;
+        return p;
+    }
+    size_t remaining() const { return static_cast<size_t>(end_ - data_); }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+};
+
+}  // namespace
+
+void ReplicationLog::trim(uint64_t position) {
+    if (position <= firstDelete_) return;
+    size_t drop = static_cast<size_t>(std::min<uint64_t>(position - firstDelete_, deletes_.size()));
+    deletes_.erase(deletes_.begin(), deletes_.begin() + drop);
+    firstDelete_ += drop;
+}
+
+void ReplicationLog::newEpoch() {
+    epoch_++;
+    firstDelete_ = 0;
+    deletes_.clear();
+}
+
+ReplicationFrameWriter::ReplicationFrameWriter(const ReplicationPosition& from) {
+    out_.insert(out_.end(), FRAME_MAGIC, FRAME_MAGIC + sizeof(FRAME_MAGIC));
+    putUint(out_, FRAME_VERSION, 4);
+    putPosition(out_, from);
+    putUint(out_, 0, 8);  // Record bytes, filled in by finish()
+    recordsStart_ = out_.size();
+}
+
+void ReplicationFrameWriter::addRecords(const uint8_t* data, size_t length) {
+    out_.insert(out_.end(), data, data + length);
+}
+
+std::vector<uint8_t> ReplicationFrameWriter::finish(const ReplicationPosition& to,
+                                                    const std::vector<ReplicationDelete>& deletes) {
+    uint64_t recordBytes = out_.size() - recordsStart_;
+    for (size_t i = 0; i < 8; i++) {
+        out_[recordsStart_ - 8 + i] = static_cast<uint8_t>(recordBytes >> (8 * i));
+    }
+    putPosition(out_, to);
+    putUint(out_, deletes.size(), 4);
+    for (const auto& entry : deletes) {
+        if (entry.table.size() > UINT16_MAX) {
+            throw std::runtime_error("Table name too long for replication: " + entry.table);
+        }
+        putUint(out_, entry.table.size(), 2);
+        out_.insert(out_.end(), entry.table.begin(), entry.table.end());
+        putUint(out_, entry.sequence, 8);
+    }
+    return std::move(out_);
+}
+
+ReplicationFrame decodeReplicationFrame(const uint8_t* data, size_t length) {
+    FrameReader r(data, length);
+    if (std::memcmp(r.take(sizeof(FRAME_MAGIC)), FRAME_MAGIC, sizeof(FRAME_MAGIC)) != 0) {
+        throw std::runtime_error("Not a replication frame");
+    }
+    uint32_t version = static_cast<uint32_t>(r.uint(4));
+    if (version != FRAME_VERSION) {
+        throw std::runtime_error("Unsupported replication frame version: " + std::to_string(version));
+    }
+
+    ReplicationFrame frame;
+    frame.from = r.position();
+    frame.recordBytes = static_cast<size_t>(r.uint(8));
+    frame.records = r.take(frame.recordBytes);
+    frame.to = r.position();
+    size_t deletes = static_cast<size_t>(r.uint(4));
+    // Each delete takes at least 10 bytes
+    if (deletes > r.remaining() / 10) {
+        throw std::runtime_error("Truncated replication frame");
+    }
+    frame.deletes.resize(deletes);
+    for (auto& entry : frame.deletes) {
+        size_t nameLength = static_cast<size_t>(r.uint(2));
+        entry.table.assign(reinterpret_cast<const char*>(r.take(nameLength)), nameLength);
+        entry.sequence = r.uint(8);
+    }
+    return frame;
+}
+
+}  // namespace flatsql
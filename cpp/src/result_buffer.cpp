@@ -0,0 +1,237 @@
+#include "flatsql/result_buffer.h"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace flatsql {
+
+namespace {
+
+ResultCellType cellType(const Value& value) {
+    switch (value.index()) {
+        case 0: return ResultCellType::Null;
+        case 1: return ResultCellType::Bool;
+        case 10:
+        case 11: return ResultCellType::Float64;
+        case 12: return ResultCellType::String;
+        case 13: return ResultCellType::Bytes;
+        default: return ResultCellType::Int64;
+    }
+}
+
+int64_t cellInt64(const Value& value) {
+    return std::visit([](const auto& v) -> int64_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<int64_t>(v);
+        } else {
+            return 0;
+        }
+    }, value);
+}
+
+double cellDouble(const Value& value) {
+    return std::visit([](const auto& v) -> double {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<double>(v);
+        } else {
+            return 0.0;
+        }
+    }, value);
+}
+
+// Column type from the types of its non-null cells: one type is kept as
+// is, bool/integer/real combinations widen, anything else is Mixed
+ResultCellType columnType(const QueryResult& result, size_t col, uint32_t& nullCount) {
+    ResultCellType type = ResultCellType::Null;
+    nullCount = 0;
+    for (const auto& row : result.rows) {
+        ResultCellType cell = col < row.size() ? cellType(row[col]) : ResultCellType::Null;
+        if (cell == ResultCellType::Null) {
+            nullCount++;
+            continue;
+        }
+        if (type == ResultCellType::Null || type == cell || type == ResultCellType::Mixed) {
+            if (type == ResultCellType::Null) type = cell;
+            continue;
+        }
+        bool typeNumeric = type == ResultCellType::Bool || type == ResultCellType::Int64 ||
+                           type == ResultCellType::Float64;
+        bool cellNumeric = cell == ResultCellType::Bool || cell == ResultCellType::Int64 ||
+                           cell == ResultCellType::Float64;
+        if (typeNumeric && cellNumeric) {
+            type = (type == ResultCellType::Float64 || cell == ResultCellType::Float64)
+                ? ResultCellType::Float64 : ResultCellType::Int64;
+        } else {
+            type = ResultCellType::Mixed;
+        }
+    }
+    return type;
+}
+
+class BufferWriter {
+public:
+    explicit BufferWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    uint32_t align() {
+        out_.resize((out_.size() + 7) & ~size_t(7), 0);
+        return position();
+    }
+
+    uint32_t position() const {
+        if (out_.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Query result too large for result buffer");
+        }
+        return static_cast<uint32_t>(out_.size());
+    }
+
+    void append(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), bytes, bytes + length);
+    }
+
+    template <typename T>
+    void appendScalar(T value) {
+        append(&value, sizeof(value));
+    }
+
+    template <typename T>
+    void patch(size_t offset, T value) {
+        std::memcpy(out_.data() + offset, &value, sizeof(value));
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+};
+
+// Bytes of a cell as stored in a String, Bytes or Mixed data section
+void appendCellData(BufferWriter& writer, const Value& value, ResultCellType cell) {
+    switch (cell) {
+        case ResultCellType::Bool:
+        case ResultCellType::Int64:
+            writer.appendScalar(cellInt64(value));
+            break;
+        case ResultCellType::Float64:
+            writer.appendScalar(cellDouble(value));
+            break;
+        case ResultCellType::String: {
+            const auto& s = std::get<std::string>(value);
+            writer.append(s.data(), s.size());
+            break;
+        }
+        case ResultCellType::Bytes: {
+            const auto& b = std::get<std::vector<uint8_t>>(value);
+            writer.append(b.data(), b.size());
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+}  // namespace
+
+void encodeResultBuffer(const QueryResult& result, std::vector<uint8_t>& out) {
+    static const Value nullValue;
+
+    const size_t columnCount = result.columns.size();
+    const size_t rowCount = result.rows.size();
+    if (rowCount > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Query result too large for result buffer");
+    }
+
+    out.clear();
+    BufferWriter writer(out);
+    writer.appendScalar(RESULT_BUFFER_MAGIC);
+    writer.appendScalar(RESULT_BUFFER_VERSION);
+    writer.appendScalar(static_cast<uint32_t>(columnCount));
+    writer.appendScalar(static_cast<uint32_t>(rowCount));
+
+    const size_t directoryOffset = writer.position();
+    std::vector<ResultBufferColumn> directory(columnCount);
+    out.resize(out.size() + columnCount * sizeof(ResultBufferColumn), 0);
+
+    for (size_t c = 0; c < columnCount; c++) {
+        directory[c].nameOffset = writer.position();
+        directory[c].nameLength = static_cast<uint32_t>(result.columns[c].size());
+        writer.append(result.columns[c].data(), result.columns[c].size());
+    }
+
+    for (size_t c = 0; c < columnCount; c++) {
+        ResultBufferColumn& column = directory[c];
+        ResultCellType type = columnType(result, c, column.nullCount);
+        column.type = static_cast<uint32_t>(type);
+        auto cell = [&](size_t r) -> const Value& {
+            return c < result.rows[r].size() ? result.rows[r][c] : nullValue;
+        };
+
+        if (column.nullCount > 0 && type != ResultCellType::Null) {
+            column.validityOffset = writer.align();
+            std::vector<uint8_t> validity((rowCount + 7) / 8, 0);
+            for (size_t r = 0; r < rowCount; r++) {
+                if (cellType(cell(r)) != ResultCellType::Null) {
+                    validity[r >> 3] |= static_cast<uint8_t>(1u << (r & 7));
+                }
+            }
+            writer.append(validity.data(), validity.size());
+        }
+
+        switch (type) {
+            case ResultCellType::Null:
+                break;
+
+            case ResultCellType::Bool:
+                column.valuesOffset = writer.align();
+                for (size_t r = 0; r < rowCount; r++) {
+                    writer.appendScalar(static_cast<uint8_t>(cellInt64(cell(r)) != 0));
+                }
+                break;
+
+            case ResultCellType::Int64:
+                column.valuesOffset = writer.align();
+                for (size_t r = 0; r < rowCount; r++) {
+                    writer.appendScalar(cellInt64(cell(r)));
+                }
+                break;
+
+            case ResultCellType::Float64:
+                column.valuesOffset = writer.align();
+                for (size_t r = 0; r < rowCount; r++) {
+                    writer.appendScalar(cellDouble(cell(r)));
+                }
+                break;
+
+            case ResultCellType::String:
+            case ResultCellType::Bytes:
+            case ResultCellType::Mixed: {
+                if (type == ResultCellType::Mixed) {
+                    column.valuesOffset = writer.align();
+                    for (size_t r = 0; r < rowCount; r++) {
+                        writer.appendScalar(static_cast<uint8_t>(cellType(cell(r))));
+                    }
+                }
+
+                // Offsets are patched in once the data section is laid out
+                column.offsetsOffset = writer.align();
+                out.resize(out.size() + (rowCount + 1) * sizeof(uint32_t), 0);
+                column.dataOffset = writer.align();
+                uint32_t length = 0;
+                for (size_t r = 0; r < rowCount; r++) {
+                    writer.patch(column.offsetsOffset + r * sizeof(uint32_t), length);
+                    appendCellData(writer, cell(r), cellType(cell(r)));
+                    length = writer.position() - column.dataOffset;
+                }
+                writer.patch(column.offsetsOffset + rowCount * sizeof(uint32_t), length);
+                break;
+            }
+        }
+    }
+
+    writer.align();
+    for (size_t c = 0; c < columnCount; c++) {
+        writer.patch(directoryOffset + c * sizeof(ResultBufferColumn), directory[c]);
+    }
+}
+
+}  // namespace flatsql
@@ -0,0 +1,123 @@
+#include "flatsql/result_cache.h"
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace flatsql {
+
+uint64_t ResultCache::Watermark::visibleRecords() const {
+    const StreamingFlatBufferStore::RecordInfoList* infos = records ? records : store->getRecordInfoVector(fileId);
+    return infos ? StreamingFlatBufferStore::visibleCount(*infos, store->getVisibleSequence()) : 0;
+}
+
+void ResultCache::Watermark::capture() {
+    visible = visibleRecords();
+    version = tombstones ? tombstones->version() : 0;
+}
+
+bool ResultCache::Watermark::current() const {
+    return (tombstones ? tombstones->version() : 0) == version && visibleRecords() == visible;
+}
+
+std::string ResultCache::key(const std::string& sql, const std::vector<Value>& params) {
+    std::string key = sql;
+    for (const Value& param : params) {
+        key += '\0';
+        key += static_cast<char>(param.index());
+        std::visit([&key](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::vector<uint8_t>>) {
+                uint64_t size = v.size();
+                key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                key.append(reinterpret_cast<const char*>(v.data()), v.size());
+            } else if constexpr (!std::is_same_v<T, std::monostate>) {
+                key.append(reinterpret_cast<const char*>(&v), sizeof(v));
+            }
+        }, param);
+    }
+    return key;
+}
+
+// Rough heap footprint of a cached result
+static size_t resultBytes(const std::string& key, const QueryResult& result) {
+    size_t bytes = sizeof(QueryResult) + key.size() + result.columns.size() * sizeof(std::string);
+    for (const auto& column : result.columns) bytes += column.size();
+    for (const auto& row : result.rows) {
+        bytes += sizeof(row) + row.size() * sizeof(Value);
+        for (const Value& value : row) {
+            if (const auto* s = std::get_if<std::string>(&value)) {
+                bytes += s->size();
+            } else if (const auto* b = std::get_if<std::vector<uint8_t>>(&value)) {
+                bytes += b->size();
+            }
+        }
+    }
+    return bytes;
+}
+
+const QueryResult* ResultCache::find(const std::string& key) {
+    auto it = byKey_.find(key);
+    if (it == byKey_.end()) {
+        stats_.misses++;
+        return nullptr;
+    }
+    Entries::iterator entry = it->second;
+    for (const Watermark& watermark : entry->watermarks) {
+        if (!watermark.current()) {
+            erase(entry);
+            stats_.invalidations++;
+            stats_.misses++;
+            return nullptr;
+        }
+    }
+    entries_.splice(entries_.begin(), entries_, entry);
+    stats_.hits++;
+    return &entry->result;
+}
+
+void ResultCache::insert(const std::string& key, const QueryResult& result, std::vector<Watermark> watermarks) {
+    auto existing = byKey_.find(key);
+    if (existing != byKey_.end()) {
+        erase(existing->second);
+    }
+    size_t bytes = resultBytes(key, result);
+    if (bytes > capacity_) return;
+    evictTo(capacity_ - bytes);
+
+    entries_.push_front({key, result, std::move(watermarks), bytes});
+    byKey_[key] = entries_.begin();
+    stats_.bytes += bytes;
+}
+
+void ResultCache::erase(Entries::iterator it) {
+    stats_.bytes -= it->bytes;
+    byKey_.erase(it->key);
+    entries_.erase(it);
+}
+
+void ResultCache::evictTo(size_t bytes) {
+    while (stats_.bytes > bytes && !entries_.empty()) {
+        erase(std::prev(entries_.end()));
+        stats_.evictions++;
+    }
+}
+
+void ResultCache::clear() {
+    entries_.clear();
+    byKey_.clear();
+    stats_.bytes = 0;
+}
+
+void ResultCache::setCapacity(size_t bytes) {
+    capacity_ = bytes;
+    evictTo(bytes);
+}
+
+ResultCacheStats ResultCache::getStats() const {
+    ResultCacheStats stats = stats_;
+    stats.entries = byKey_.size();
+    stats.capacity = capacity_;
+    return stats;
+}
+
+}  // namespace flatsql
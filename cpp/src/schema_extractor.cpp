@@ -0,0 +1,343 @@
+#include "flatsql/schema_extractor.h"
+#include <cstring>
+#include <type_traits>
+
+namespace flatsql {
+
+namespace {
+
+template <typename T>
+T readScalar(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Bytes read at the field position, by Reader (offset fields read a uoffset)
+constexpr size_t READER_WIDTH[] = {0, 1, 1, 2, 4, 8, 1, 2, 4, 8, 4, 8, 4, 4};
+
+// Root table and its vtable, located once per record
+struct TableView {
+    uint32_t table = 0;
+    uint32_t vtable = 0;
+    uint16_t vtableSize = 0;
+};
+
+// False when the record is too short for the offsets it contains
+bool findTable(const uint8_t* data, size_t length, TableView& view) {
+    if (!data || length < 8) return false;
+    view.table = readScalar<uint32_t>(data);
+    if (uint64_t(view.table) + 4 > length) return false;
+    int64_t vtable = int64_t(view.table) - readScalar<int32_t>(data + view.table);
+    if (vtable < 0 || uint64_t(vtable) + 4 > length) return false;
+    view.vtable = static_cast<uint32_t>(vtable);
+    view.vtableSize = readScalar<uint16_t>(data + vtable);
+    return uint64_t(vtable) + view.vtableSize <= length;
+}
+
+/**
+ * Position of a field of the given width within data: 0 when the table's
+ * vtable has no entry for it (field absent), -1 when the field would run
+ * past the end of the record.
+ */
+int64_t fieldPosition(const uint8_t* data, size_t length, const TableView& view,
+                      uint16_t slot, size_t width) {
+    if (uint32_t(slot) + 2 > view.vtableSize) return 0;
+    uint16_t field = readScalar<uint16_t>(data + view.vtable + slot);
+    if (field == 0) return 0;
+    if (uint64_t(view.table) + field + width > length) return -1;
+    return int64_t(view.table) + field;
+}
+
+int64_t fieldPosition(const uint8_t* data, size_t length, uint16_t slot, size_t width) {
+    TableView view;
+    return findTable(data, length, view) ? fieldPosition(data, length, view, slot, width) : -1;
+}
+
+// Contents of the string or vector referenced by the uoffset at position
+bool readVector(const uint8_t* data, size_t length, int64_t position,
+                const uint8_t*& contents, uint32_t& size) {
+    uint64_t target = uint64_t(position) + readScalar<uint32_t>(data + position);
+    if (target + 4 > length) return false;
+    size = readScalar<uint32_t>(data + target);
+    if (size > length - target - 4) return false;
+    contents = data + target + 4;
+    return true;
+}
+
+// Scalar (or null) Value as an SQLite result
+void resultScalar(sqlite3_context* ctx, const Value& value) {
+    std::visit([ctx](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_floating_point_v<T>) {
+            sqlite3_result_double(ctx, static_cast<double>(v));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(v));
+        } else {
+            sqlite3_result_null(ctx);
+        }
+    }, value);
+}
+
+}  // namespace
+
+SchemaExtractor::SchemaExtractor(const TableDef& tableDef) {
+    columns_.resize(tableDef.columns.size());
+    for (size_t i = 0; i < tableDef.columns.size(); i++) {
+        const ColumnDef& def = tableDef.columns[i];
+        Column& column = columns_[i];
+        columnsByName_[def.name] = static_cast<int>(i);
+        if (!def.layoutKnown || def.type == ValueType::Null) continue;
+
+        // ValueType and Reader list the readable types in the same order
+        column.reader = static_cast<Reader>(static_cast<int>(def.type));
+        column.slot = static_cast<uint16_t>(4 + 2 * def.fieldId);
+        readableColumns_++;
+
+        // Absent scalars read as their schema default, absent offsets as NULL
+        switch (def.type) {
+            case ValueType::Bool:    column.absent = false; break;
+            case ValueType::Int8:    column.absent = int8_t(0); break;
+            case ValueType::Int16:   column.absent = int16_t(0); break;
+            case ValueType::Int32:   column.absent = int32_t(0); break;
+            case ValueType::Int64:   column.absent = int64_t(0); break;
+            case ValueType::UInt8:   column.absent = uint8_t(0); break;
+            case ValueType::UInt16:  column.absent = uint16_t(0); break;
+            case ValueType::UInt32:  column.absent = uint32_t(0); break;
+            case ValueType::UInt64:  column.absent = uint64_t(0); break;
+            case ValueType::Float32: column.absent = 0.0f; break;
+            case ValueType::Float64: column.absent = 0.0; break;
+            default: break;
+        }
+        if (def.defaultValue && column.reader != Reader::String && column.reader != Reader::Bytes) {
+            column.absent = *def.defaultValue;
+        }
+    }
+}
+
+ValueView SchemaExtractor::readView(const uint8_t* data, size_t length, int64_t pos,
+                                   const Column& c) const {
+    if (pos < 0) return std::monostate{};
+    if (pos == 0) return viewOf(c.absent);
+
+    const uint8_t* p = data + pos;
+    switch (c.reader) {
+        case Reader::Bool:    return p[0] != 0;
+        case Reader::Int8:    return readScalar<int8_t>(p);
+        case Reader::Int16:   return readScalar<int16_t>(p);
+        case Reader::Int32:   return readScalar<int32_t>(p);
+        case Reader::Int64:   return readScalar<int64_t>(p);
+        case Reader::UInt8:   return readScalar<uint8_t>(p);
+        case Reader::UInt16:  return readScalar<uint16_t>(p);
+        case Reader::UInt32:  return readScalar<uint32_t>(p);
+        case Reader::UInt64:  return readScalar<uint64_t>(p);
+        case Reader::Float32: return readScalar<float>(p);
+        case Reader::Float64: return readScalar<double>(p);
+        case Reader::String:
+        case Reader::Bytes: {
+            const uint8_t* contents;
+            uint32_t size;
+            if (!readVector(data, length, pos, contents, size)) return std::monostate{};
+            if (c.reader == Reader::String) {
+                return std::string_view(reinterpret_cast<const char*>(contents), size);
+            }
+            return BytesView{contents, size};
+        }
+        case Reader::None:
+            break;
+    }
+    return std::monostate{};
+}
+
+Value SchemaExtractor::extract(const uint8_t* data, size_t length, int column) const {
+    if (column < 0 || static_cast<size_t>(column) >= columns_.size()) return Value{};
+    const Column& c = columns_[column];
+    if (c.reader == Reader::None) return Value{};
+
+    Value value;
+    read(data, length, fieldPosition(data, length, c.slot, READER_WIDTH[static_cast<int>(c.reader)]),
+         c, value);
+    return value;
+}
+
+void SchemaExtractor::extractKeys(const uint8_t* data, size_t length, const int* columns,
+                                  size_t count, Value* keys) const {
+    TableView view;
+    bool valid = findTable(data, length, view);
+    for (size_t i = 0; i < count; i++) {
+        int column = columns[i];
+        if (!valid || column < 0 || static_cast<size_t>(column) >= columns_.size() ||
+            columns_[column].reader == Reader::None) {
+            keys[i] = std::monostate{};
+            continue;
+        }
+        const Column& c = columns_[column];
+        read(data, length,
+             fieldPosition(data, length, view, c.slot, READER_WIDTH[static_cast<int>(c.reader)]),
+             c, keys[i]);
+    }
+}
+
+ValueView SchemaExtractor::extractView(const uint8_t* data, size_t length, int column) const {
+    if (column < 0 || static_cast<size_t>(column) >= columns_.size()) return std::monostate{};
+    const Column& c = columns_[column];
+    if (c.reader == Reader::None) return std::monostate{};
+    return readView(data, length, fieldPosition(data, length, c.slot, READER_WIDTH[static_cast<int>(c.reader)]), c);
+}
+
+ValueView SchemaExtractor::extractView(const uint8_t* data, size_t length, const std::string& fieldName) const {
+    auto it = columnsByName_.find(fieldName);
+    return it != columnsByName_.end() ? extractView(data, length, it->second) : ValueView{};
+}
+
+Value SchemaExtractor::extract(const uint8_t* data, size_t length, const std::string& fieldName) const {
+    auto it = columnsByName_.find(fieldName);
+    return it != columnsByName_.end() ? extract(data, length, it->second) : Value{};
+}
+
+bool SchemaExtractor::extractTo(const uint8_t* data, size_t length, int column,
+                                sqlite3_context* ctx) const {
+    if (column < 0 || static_cast<size_t>(column) >= columns_.size()) return false;
+    const Column& c = columns_[column];
+    if (c.reader == Reader::None) return false;
+
+    int64_t pos = fieldPosition(data, length, c.slot, READER_WIDTH[static_cast<int>(c.reader)]);
+    if (pos <= 0) {
+        if (pos < 0) {
+            sqlite3_result_null(ctx);
+        } else {
+            resultScalar(ctx, c.absent);
+        }
+        return true;
+    }
+
+    const uint8_t* p = data + pos;
+    switch (c.reader) {
+        case Reader::Bool:    sqlite3_result_int(ctx, p[0] != 0); break;
+        case Reader::Int8:    sqlite3_result_int(ctx, readScalar<int8_t>(p)); break;
+        case Reader::Int16:   sqlite3_result_int(ctx, readScalar<int16_t>(p)); break;
+        case Reader::Int32:   sqlite3_result_int(ctx, readScalar<int32_t>(p)); break;
+        case Reader::Int64:   sqlite3_result_int64(ctx, readScalar<int64_t>(p)); break;
+        case Reader::UInt8:   sqlite3_result_int(ctx, readScalar<uint8_t>(p)); break;
+        case Reader::UInt16:  sqlite3_result_int(ctx, readScalar<uint16_t>(p)); break;
+        case Reader::UInt32:  sqlite3_result_int64(ctx, readScalar<uint32_t>(p)); break;
+        case Reader::UInt64:
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(readScalar<uint64_t>(p)));
+            break;
+        case Reader::Float32: sqlite3_result_double(ctx, readScalar<float>(p)); break;
+        case Reader::Float64: sqlite3_result_double(ctx, readScalar<double>(p)); break;
+        case Reader::String:
+        case Reader::Bytes: {
+            const uint8_t* contents;
+            uint32_t size;
+            if (!readVector(data, length, pos, contents, size)) {
+                sqlite3_result_null(ctx);
+            } else if (c.reader == Reader::String) {
+                // SQLITE_STATIC - string data lives in FlatBuffer storage
+                sqlite3_result_text(ctx, reinterpret_cast<const char*>(contents),
+                                    static_cast<int>(size), SQLITE_STATIC);
+            } else {
+                sqlite3_result_blob(ctx, contents, static_cast<int>(size), SQLITE_STATIC);
+            }
+            break;
+        }
+        case Reader::None:
+            return false;
+    }
+    return true;
+}
+
+bool SchemaExtractor::extractDecryptedTo(const uint8_t* data, size_t length, int column,
+                                         sqlite3_context* ctx, FieldDecryptor decrypt,
+                                         const void* cipher, std::vector<uint8_t>& scratch) const {
+    if (column < 0 || static_cast<size_t>(column) >= columns_.size()) return false;
+    const Column& c = columns_[column];
+    if (c.reader == Reader::None) return false;
+
+    size_t width = READER_WIDTH[static_cast<int>(c.reader)];
+    int64_t pos = fieldPosition(data, length, c.slot, width);
+    if (pos <= 0) {
+        if (pos < 0) {
+            sqlite3_result_null(ctx);
+        } else {
+            resultScalar(ctx, c.absent);
+        }
+        return true;
+    }
+
+    const uint8_t* contents = data + pos;
+    uint32_t size = static_cast<uint32_t>(width);
+    if ((c.reader == Reader::String || c.reader == Reader::Bytes) &&
+        !readVector(data, length, pos, contents, size)) {
+        sqlite3_result_null(ctx);
+        return true;
+    }
+    // Bool fields are never encrypted
+    if (c.reader == Reader::Bool) {
+        sqlite3_result_int(ctx, contents[0] != 0);
+        return true;
+    }
+
+    scratch.assign(contents, contents + size);
+    if (size > 0) {
+        decrypt(scratch.data(), size, cipher);
+    }
+    const uint8_t* p = size > 0 ? scratch.data() : contents;
+    switch (c.reader) {
+        case Reader::Int8:    sqlite3_result_int(ctx, readScalar<int8_t>(p)); break;
+        case Reader::Int16:   sqlite3_result_int(ctx, readScalar<int16_t>(p)); break;
+        case Reader::Int32:   sqlite3_result_int(ctx, readScalar<int32_t>(p)); break;
+        case Reader::Int64:   sqlite3_result_int64(ctx, readScalar<int64_t>(p)); break;
+        case Reader::UInt8:   sqlite3_result_int(ctx, readScalar<uint8_t>(p)); break;
+        case Reader::UInt16:  sqlite3_result_int(ctx, readScalar<uint16_t>(p)); break;
+        case Reader::UInt32:  sqlite3_result_int64(ctx, readScalar<uint32_t>(p)); break;
+        case Reader::UInt64:
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(readScalar<uint64_t>(p)));
+            break;
+        case Reader::Float32: sqlite3_result_double(ctx, readScalar<float>(p)); break;
+        case Reader::Float64: sqlite3_result_double(ctx, readScalar<double>(p)); break;
+        // Scratch is reused for the next field, so SQLite takes a copy
+        case Reader::String:
+            sqlite3_result_text(ctx, reinterpret_cast<const char*>(p), static_cast<int>(size),
+                                SQLITE_TRANSIENT);
+            break;
+        case Reader::Bytes:
+            sqlite3_result_blob(ctx, p, static_cast<int>(size), SQLITE_TRANSIENT);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool SchemaExtractor::verify(const uint8_t* data, size_t length) const {
+    TableView view;
+    if (!findTable(data, length, view)) return false;
+    if (view.table % 4 != 0 || view.vtable % 2 != 0 || view.vtableSize < 4 || view.vtableSize % 2 != 0) {
+        return false;
+    }
+    uint16_t tableSize = readScalar<uint16_t>(data + view.vtable + 2);
+    if (tableSize < 4 || uint64_t(view.table) + tableSize > length) return false;
+    for (uint32_t slot = 4; slot < view.vtableSize; slot += 2) {
+        if (readScalar<uint16_t>(data + view.vtable + slot) >= tableSize) return false;
+    }
+
+    for (const Column& c : columns_) {
+        if (c.reader == Reader::None) continue;
+        size_t width = READER_WIDTH[static_cast<int>(c.reader)];
+        int64_t pos = fieldPosition(data, length, view, c.slot, width);
+        if (pos == 0) continue;
+        if (pos < 0 || uint64_t(pos) + width > uint64_t(view.table) + tableSize) return false;
+        if (c.reader != Reader::String && c.reader != Reader::Bytes) continue;
+        const uint8_t* contents;
+        uint32_t size;
+        if (!readVector(data, length, pos, contents, size)) return false;
+        if (c.reader == Reader::String &&
+            (uint64_t(contents - data) + size >= length || contents[size] != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace flatsql
@@ -3,6 +3,11 @@
 #include <sstream>
 #include <algorithm>
 #include <stdexcept>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <cstring>
+#include <type_traits>
 
 namespace flatsql {
 
@@ -21,8 +26,43 @@ static std::string toLower(const std::string& str) {
     return result;
 }
 
-ValueType SchemaParser::idlTypeToValueType(const std::string& idlType) {
+// Default value text from "name: type = value;" in the column's type
+// (nullopt when it is not a literal, e.g. an enum constant name)
+static std::optional<Value> parseIDLDefault(const std::string& text, ValueType type) {
+    std::string literal = toLower(text);
+    if (literal == "null") return Value{};
+    if (literal == "true" || literal == "false") {
+        if (type == ValueType::Bool) return Value{literal == "true"};
+        return std::nullopt;
+    }
+
+    char* end = nullptr;
+    double real = std::strtod(literal.c_str(), &end);
+    if (literal.empty() || *end != '\0') return std::nullopt;
+    if (type == ValueType::Float32) return Value{static_cast<float>(real)};
+    if (type == ValueType::Float64) return Value{real};
+
+    long long integer = std::strtoll(literal.c_str(), &end, 0);
+    if (*end != '\0') return std::nullopt;
+    switch (type) {
+        case ValueType::Bool:    return Value{integer != 0};
+        case ValueType::Int8:    return Value{static_cast<int8_t>(integer)};
+        case ValueType::Int16:   return Value{static_cast<int16_t>(integer)};
+        case ValueType::Int32:   return Value{static_cast<int32_t>(integer)};
+        case ValueType::Int64:   return Value{static_cast<int64_t>(integer)};
+        case ValueType::UInt8:   return Value{static_cast<uint8_t>(integer)};
+        case ValueType::UInt16:  return Value{static_cast<uint16_t>(integer)};
+        case ValueType::UInt32:  return Value{static_cast<uint32_t>(integer)};
+        case ValueType::UInt64:
+            return Value{static_cast<uint64_t>(std::strtoull(literal.c_str(), nullptr, 0))};
+        default: break;
+    }
+    return std::nullopt;
+}
+
+ValueType SchemaParser::idlTypeToValueType(const std::string& idlType, bool* recognized) {
     std::string type = toLower(trim(idlType));
+    if (recognized) *recognized = true;
 
     if (type == "bool") return ValueType::Bool;
     if (type == "byte" || type == "int8") return ValueType::Int8;
@@ -43,6 +83,7 @@ ValueType SchemaParser::idlTypeToValueType(const std::string& idlType) {
     }
 
     // Default to string for unknown types
+    if (recognized) *recognized = false;
     return ValueType::String;
 }
 
@@ -70,6 +111,19 @@ DatabaseSchema SchemaParser::parseIDL(const std::string& idl, const std::string&
     DatabaseSchema schema;
     schema.name = dbName;
 
+    // Enums are stored as their underlying integer type; a union field
+    // takes two vtable slots (its type tag, then the value)
+    std::map<std::string, ValueType> enumTypes;
+    std::set<std::string> unionNames;
+    std::regex enumRegex(R"delim(enum\s+(\w+)\s*:\s*(\w+))delim");
+    for (std::sregex_iterator it(idl.begin(), idl.end(), enumRegex), end; it != end; ++it) {
+        enumTypes[(*it)[1].str()] = idlTypeToValueType((*it)[2].str());
+    }
+    std::regex unionRegex(R"delim(union\s+(\w+))delim");
+    for (std::sregex_iterator it(idl.begin(), idl.end(), unionRegex), end; it != end; ++it) {
+        unionNames.insert((*it)[1].str());
+    }
+
     // Match table definitions: table TableName { ... }
     std::regex tableRegex(R"delim(table\s+(\w+)\s*\{([^}]*)\})delim", std::regex::icase);
     std::smatch tableMatch;
@@ -86,6 +140,7 @@ DatabaseSchema SchemaParser::parseIDL(const std::string& idl, const std::string&
         std::smatch fieldMatch;
 
         std::string fieldsRemaining = fieldsStr;
+        uint16_t nextFieldId = 0;  // Field IDs follow declaration order (vtable slots)
         while (std::regex_search(fieldsRemaining, fieldMatch, fieldRegex)) {
             ColumnDef col;
             col.name = trim(fieldMatch[1].str());
@@ -97,6 +152,19 @@ DatabaseSchema SchemaParser::parseIDL(const std::string& idl, const std::string&
             std::smatch attrMatch;
             if (std::regex_search(typeStr, attrMatch, attrRegex)) {
                 std::string attrs = toLower(attrMatch[1].str());
+
+                // geo: "lon" pairs this latitude column with a longitude
+                // column in a spatial index; taken out first so the column
+                // name can't match the flags below
+                std::regex geoRegex(R"delim(\bgeo\s*:\s*"?(\w+)"?)delim");
+                std::smatch geoMatch;
+                std::string rawAttrs = attrMatch[1].str();
+                if (std::regex_search(rawAttrs, geoMatch, geoRegex)) {
+                    tableDef.geoLatColumn = col.name;
+                    tableDef.geoLonColumn = geoMatch[1].str();
+                    attrs = toLower(geoMatch.prefix().str() + geoMatch.suffix().str());
+                }
+
                 if (attrs.find("id") != std::string::npos) {
                     col.primaryKey = true;
                     col.indexed = true;
@@ -111,12 +179,49 @@ DatabaseSchema SchemaParser::parseIDL(const std::string& idl, const std::string&
                 if (attrs.find("encrypted") != std::string::npos) {
                     col.encrypted = true;
                 }
+                if (attrs.find("dictionary") != std::string::npos) {
+                    col.dictionary = true;
+                    col.indexed = true;
+                }
+                if (attrs.find("fulltext") != std::string::npos) {
+                    col.fullText = true;
+                    col.indexed = true;
+                }
+                if (attrs.find("trigram") != std::string::npos) {
+                    col.trigram = true;
+                    col.indexed = true;
+                }
                 // Remove attributes from type
                 typeStr = std::regex_replace(typeStr, attrRegex, "");
                 typeStr = trim(typeStr);
             }
 
-            col.type = idlTypeToValueType(typeStr);
+            std::string defaultStr;
+            size_t equals = typeStr.find('=');
+            if (equals != std::string::npos) {
+                defaultStr = trim(typeStr.substr(equals + 1));
+                typeStr = trim(typeStr.substr(0, equals));
+            }
+
+            auto enumIt = enumTypes.find(typeStr);
+            if (enumIt != enumTypes.end()) {
+                col.type = enumIt->second;
+                col.layoutKnown = true;
+            } else {
+                col.type = idlTypeToValueType(typeStr, &col.layoutKnown);
+            }
+            if (!defaultStr.empty() && col.layoutKnown) {
+                col.defaultValue = parseIDLDefault(defaultStr, col.type);
+            }
+
+            // Tables, structs, unions and non-byte vectors are not readable
+            // as a column; a union's value sits in its second slot
+            if (unionNames.count(typeStr)) {
+                col.fieldId = static_cast<uint16_t>(nextFieldId + 1);
+                nextFieldId += 2;
+            } else {
+                col.fieldId = nextFieldId++;
+            }
             tableDef.columns.push_back(col);
 
             if (col.primaryKey) {
@@ -126,11 +231,6 @@ DatabaseSchema SchemaParser::parseIDL(const std::string& idl, const std::string&
             fieldsRemaining = fieldMatch.suffix().str();
         }
 
-        // Assign field IDs based on position (maps to FlatBuffer vtable indices)
-        for (size_t i = 0; i < tableDef.columns.size(); i++) {
-            tableDef.columns[i].fieldId = static_cast<uint16_t>(i);
-        }
-
         schema.tables.push_back(tableDef);
         remaining = tableMatch.suffix().str();
     }
@@ -210,4 +310,223 @@ DatabaseSchema SchemaParser::parse(const std::string& source, const std::string&
     return parseIDL(source, dbName);
 }
 
+// ==================== Compiled schemas ====================
+
+// Layout: "FSQS" | version u32 | name | tableCount u32 | per table: name,
+// geoLat, geoLon, primaryKeyCount u32 + names, columnCount u32, per column:
+// name, type u8, flags u8, fieldId u16, default (type u8, 0xFF = none, and
+// its payload). Strings are u32 length + bytes; integers little-endian.
+static constexpr char COMPILED_MAGIC[4] = {'F', 'S', 'Q', 'S'};
+static constexpr uint32_t COMPILED_VERSION = 1;
+static constexpr uint8_t NO_DEFAULT = 0xFF;
+
+enum CompiledColumnFlag : uint8_t {
+    COLUMN_NULLABLE = 1 << 0,
+    COLUMN_INDEXED = 1 << 1,
+    COLUMN_PRIMARY_KEY = 1 << 2,
+    COLUMN_ENCRYPTED = 1 << 3,
+    COLUMN_DICTIONARY = 1 << 4,
+    COLUMN_LAYOUT_KNOWN = 1 << 5,
+    COLUMN_FULL_TEXT = 1 << 6,
+    COLUMN_TRIGRAM = 1 << 7,
+};
+
+namespace {
+
+class CompiledWriter {
+public:
+    explicit CompiledWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void u8(uint8_t v) { out_.push_back(v); }
+    void uint(uint64_t v, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) out_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void bytes(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), p, p + n);
+    }
+    void str(const std::string& s) {
+        uint(s.size(), 4);
+        bytes(s.data(), s.size());
+    }
+
+    void value(const Value& v) {
+        u8(static_cast<uint8_t>(v.index()));
+        std::visit([this](const auto& x) {
+            using T = std::decay_t<decltype(x)>;
+            if constexpr (std::is_same_v<T, std::monostate>) {
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                str(x);
+            } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+                uint(x.size(), 4);
+                bytes(x.data(), x.size());
+            } else if constexpr (std::is_floating_point_v<T>) {
+                using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+                Bits bits;
+                std::memcpy(&bits, &x, sizeof(bits));
+                uint(bits, sizeof(bits));
+            } else {
+                uint(static_cast<uint64_t>(x), sizeof(T));
+            }
+        }, v);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+};
+
+class CompiledReader {
+public:
+    CompiledReader(const uint8_t* data, size_t length) : data_(data), end_(data + length) {}
+
+    const uint8_t* take(size_t n) {
+        if (static_cast<size_t>(end_ - data_) < n) {
+            throw std::runtime_error("Truncated compiled schema");
+        }
+        const uint8_t* p = data_;
+        data_ += n;
+        return p;
+    }
+    uint8_t u8() { return *take(1); }
+    uint64_t uint(size_t bytes) {
+        const uint8_t* p = take(bytes);
+        uint64_t v = 0;
+        for (size_t i = 0; i < bytes; i++) v |= uint64_t(p[i]) << (8 * i);
+        return v;
+    }
+    std::string str() {
+        size_t n = static_cast<size_t>(uint(4));
+        const uint8_t* p = take(n);
+        return std::string(reinterpret_cast<const char*>(p), n);
+    }
+
+    Value value(uint8_t type) {
+        switch (static_cast<ValueType>(type)) {
+            case ValueType::Null: return std::monostate{};
+            case ValueType::Bool: return u8() != 0;
+            case ValueType::Int8: return static_cast<int8_t>(uint(1));
+            case ValueType::Int16: return static_cast<int16_t>(uint(2));
+            case ValueType::Int32: return static_cast<int32_t>(uint(4));
+            case ValueType::Int64: return static_cast<int64_t>(uint(8));
+            case ValueType::UInt8: return static_cast<uint8_t>(uint(1));
+            case ValueType::UInt16: return static_cast<uint16_t>(uint(2));
+            case ValueType::UInt32: return static_cast<uint32_t>(uint(4));
+            case ValueType::UInt64: return uint(8);
+            case ValueType::Float32: {
+                uint32_t bits = static_cast<uint32_t>(uint(4));
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                return f;
+            }
+            case ValueType::Float64: {
+                uint64_t bits = uint(8);
+                double d;
+                std::memcpy(&d, &bits, sizeof(d));
+                return d;
+            }
+            case ValueType::String: return str();
+            case ValueType::Bytes: {
+                size_t n = static_cast<size_t>(uint(4));
+                const uint8_t* p = take(n);
+                return std::vector<uint8_t>(p, p + n);
+            }
+        }
+        throw std::runtime_error("Invalid value type in compiled schema");
+    }
+
+    bool done() const { return data_ == end_; }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+};
+
+}  // namespace
+
+std::vector<uint8_t> SchemaParser::compile(const DatabaseSchema& schema) {
+    std::vector<uint8_t> out;
+    CompiledWriter w(out);
+    w.bytes(COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+    w.uint(COMPILED_VERSION, 4);
+    w.str(schema.name);
+    w.uint(schema.tables.size(), 4);
+    for (const auto& table : schema.tables) {
+        w.str(table.name);
+        w.str(table.geoLatColumn);
+        w.str(table.geoLonColumn);
+        w.uint(table.primaryKeyColumns.size(), 4);
+        for (const auto& key : table.primaryKeyColumns) {
+            w.str(key);
+        }
+        w.uint(table.columns.size(), 4);
+        for (const auto& col : table.columns) {
+            w.str(col.name);
+            w.u8(static_cast<uint8_t>(col.type));
+            w.u8((col.nullable ? COLUMN_NULLABLE : 0) | (col.indexed ? COLUMN_INDEXED : 0) |
+                 (col.primaryKey ? COLUMN_PRIMARY_KEY : 0) | (col.encrypted ? COLUMN_ENCRYPTED : 0) |
+                 (col.dictionary ? COLUMN_DICTIONARY : 0) | (col.layoutKnown ? COLUMN_LAYOUT_KNOWN : 0) |
+                 (col.fullText ? COLUMN_FULL_TEXT : 0) |
+                 (col.trigram ? COLUMN_TRIGRAM : 0));
+            w.uint(col.fieldId, 2);
+            if (col.defaultValue) {
+                w.value(*col.defaultValue);
+            } else {
+                w.u8(NO_DEFAULT);
+            }
+        }
+    }
+    return out;
+}
+
+DatabaseSchema SchemaParser::load(const uint8_t* data, size_t length) {
+    CompiledReader r(data, length);
+    if (std::memcmp(r.take(sizeof(COMPILED_MAGIC)), COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) != 0) {
+        throw std::runtime_error("Not a compiled schema");
+    }
+    uint32_t version = static_cast<uint32_t>(r.uint(4));
+    if (version != COMPILED_VERSION) {
+        throw std::runtime_error("Unsupported compiled schema version: " + std::to_string(version));
+    }
+
+    DatabaseSchema schema;
+    schema.name = r.str();
+    schema.tables.resize(static_cast<size_t>(r.uint(4)));
+    for (auto& table : schema.tables) {
+        table.name = r.str();
+        table.geoLatColumn = r.str();
+        table.geoLonColumn = r.str();
+        table.primaryKeyColumns.resize(static_cast<size_t>(r.uint(4)));
+        for (auto& key : table.primaryKeyColumns) {
+            key = r.str();
+        }
+        table.columns.resize(static_cast<size_t>(r.uint(4)));
+        for (auto& col : table.columns) {
+            col.name = r.str();
+            uint8_t type = r.u8();
+            if (type > static_cast<uint8_t>(ValueType::Bytes)) {
+                throw std::runtime_error("Invalid column type in compiled schema: " + col.name);
+            }
+            col.type = static_cast<ValueType>(type);
+            uint8_t flags = r.u8();
+            col.nullable = flags & COLUMN_NULLABLE;
+            col.indexed = flags & COLUMN_INDEXED;
+            col.primaryKey = flags & COLUMN_PRIMARY_KEY;
+            col.encrypted = flags & COLUMN_ENCRYPTED;
+            col.dictionary = flags & COLUMN_DICTIONARY;
+            col.layoutKnown = flags & COLUMN_LAYOUT_KNOWN;
+            col.fullText = flags & COLUMN_FULL_TEXT;
+            col.trigram = flags & COLUMN_TRIGRAM;
+            col.fieldId = static_cast<uint16_t>(r.uint(2));
+            uint8_t defaultType = r.u8();
+            if (defaultType != NO_DEFAULT) {
+                col.defaultValue = r.value(defaultType);
+            }
+        }
+    }
+    if (!r.done()) {
+        throw std::runtime_error("Trailing bytes after compiled schema");
+    }
+    return schema;
+}
+
 }  // namespace flatsql
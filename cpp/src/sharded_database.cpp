@@ -0,0 +1,241 @@
+#include "flatsql/sharded_database.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+namespace flatsql {
+
+namespace {
+
+// FNV-1a, so a key hashes the same in every process and build
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Little-endian bytes of v, whatever the host order
+uint64_t fnv1aInt(uint64_t hash, uint64_t v) {
+    uint8_t bytes[8];
+    for (size_t i = 0; i < 8; i++) bytes[i] = static_cast<uint8_t>(v >> (8 * i));
+    return fnv1a(hash, bytes, sizeof(bytes));
+}
+
+uint64_t partitionHash(const Value& value) {
+    // Keys equal as SQL values hash alike: 7, int8_t(7) and 7.0
+    Value key = subscriptionKey(value);
+    uint8_t type = static_cast<uint8_t>(key.index());
+    uint64_t hash = fnv1a(FNV_OFFSET, &type, 1);
+    return std::visit([hash](const auto& v) -> uint64_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            return hash;
+        } else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::vector<uint8_t>>) {
+            return fnv1a(hash, v.data(), v.size());
+        } else if constexpr (std::is_same_v<T, double>) {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            return fnv1aInt(hash, bits);
+        } else {
+            return fnv1aInt(hash, static_cast<uint64_t>(v));
+        }
+    }, key);
+}
+
+}  // namespace
+
+ShardedDatabase::ShardedDatabase(const DatabaseSchema& schema, size_t shards,
+                                 const StorageOptions& storageOptions, IndexEngine indexEngine)
+    : schema_(schema) {
+    if (shards == 0) {
+        throw std::runtime_error("A sharded database needs at least one shard");
+    }
+    for (size_t i = 0; i < shards; i++) {
+        shards_.push_back(std::make_unique<FlatSQLDatabase>(schema, storageOptions, indexEngine));
+    }
+}
+
+void ShardedDatabase::registerFileId(const std::string& fileId, const std::string& tableName) {
+    for (auto& shard : shards_) {
+        shard->registerFileId(fileId, tableName);
+    }
+    fileIdTables_[fileId] = tableName;
+}
+
+void ShardedDatabase::setFieldExtractor(const std::string& tableName, TableStore::FieldExtractor extractor) {
+    for (auto& shard : shards_) {
+        shard->setFieldExtractor(tableName, extractor);
+    }
+    routes_[tableName].extractor = std::move(extractor);
+}
+
+void ShardedDatabase::setPartitionKey(const std::string& tableName, const std::string& column) {
+    const TableDef* def = nullptr;
+    for (const auto& table : schema_.tables) {
+        if (table.name == tableName) def = &table;
+    }
+    if (!def) {
+        throw std::runtime_error("Table not found: " + tableName);
+    }
+    if (def->getColumnIndex(column) < 0) {
+        throw std::runtime_error("Column not found: " + tableName + "." + column);
+    }
+    routes_[tableName].column = column;
+}
+
+size_t ShardedDatabase::shardFor(const Value& key) const {
+    return static_cast<size_t>(partitionHash(key) % shards_.size());
+}
+
+void ShardedDatabase::setThreads(size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::min(threads, shards_.size());
+    pool_ = threads > 1 ? std::make_unique<WorkerPool>(threads) : nullptr;
+}
+
+void ShardedDatabase::forEachShard(const std::function<void(size_t)>& fn) {
+    auto run = [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) fn(i);
+    };
+    if (pool_) {
+        pool_->parallelFor(shards_.size(), run, 1);
+    } else {
+        run(0, shards_.size());
+    }
+}
+
+size_t ShardedDatabase::ingest(const uint8_t* data, size_t length, size_t* recordsIngested) {
+    // Deal the complete records out into one stream per shard
+    std::vector<std::vector<uint8_t>> streams(shards_.size());
+    size_t offset = 0;
+    while (offset + SIZE_PREFIX_LENGTH <= length) {
+        uint32_t fbSize = static_cast<uint32_t>(data[offset]) |
+                          (static_cast<uint32_t>(data[offset + 1]) << 8) |
+                          (static_cast<uint32_t>(data[offset + 2]) << 16) |
+                          (static_cast<uint32_t>(data[offset + 3]) << 24);
+        if (offset + SIZE_PREFIX_LENGTH + fbSize > length) break;
+        const uint8_t* fbData = data + offset + SIZE_PREFIX_LENGTH;
+
+        const Route* route = nullptr;
+        if (fbSize >= FILE_IDENTIFIER_OFFSET + FILE_IDENTIFIER_LENGTH) {
+            auto table = fileIdTables_.find(std::string(
+                reinterpret_cast<const char*>(fbData + FILE_IDENTIFIER_OFFSET), FILE_IDENTIFIER_LENGTH));
+            if (table != fileIdTables_.end()) {
+                auto it = routes_.find(table->second);
+                if (it != routes_.end() && !it->second.column.empty()) route = &it->second;
+            }
+        }
+        size_t shard;
+        if (route) {
+            if (!route->extractor) {
+                throw std::runtime_error("Partition key needs a field extractor: " + route->column);
+            }
+            shard = shardFor(route->extractor(fbData, fbSize, route->column));
+        } else {
+            shard = nextShard_++ % shards_.size();
+        }
+        streams[shard].insert(streams[shard].end(), data + offset, fbData + fbSize);
+        offset += SIZE_PREFIX_LENGTH + fbSize;
+    }
+
+    std::vector<size_t> counts(shards_.size(), 0);
+    forEachShard([&](size_t i) {
+        if (!streams[i].empty()) shards_[i]->ingest(streams[i].data(), streams[i].size(), &counts[i]);
+    });
+    if (recordsIngested) {
+        *recordsIngested = 0;
+        for (size_t count : counts) *recordsIngested += count;
+    }
+    return offset;
+}
+
+QueryResult ShardedDatabase::query(const std::string& sql, const std::vector<Value>& params,
+                                   const std::vector<ShardOrder>& orderBy, size_t limit) {
+    std::vector<QueryResult> partials(shards_.size());
+    forEachShard([&](size_t i) { partials[i] = shards_[i]->query(sql, params); });
+
+    QueryResult result;
+    result.columns = partials[0].columns;
+    if (orderBy.empty()) {
+        for (auto& partial : partials) {
+            for (auto& row : partial.rows) {
+                if (result.rows.size() >= limit) return result;
+                result.rows.push_back(std::move(row));
+            }
+        }
+        return result;
+    }
+
+    // Merge the shards' sorted rows: take the least head row each time
+    std::vector<std::pair<size_t, bool>> keys;  // Result column, descending
+    for (const auto& order : orderBy) {
+        size_t column = 0;
+        while (column < result.columns.size() && result.columns[column] != order.column) column++;
+        if (column == result.columns.size()) {
+            throw std::runtime_error("ORDER BY column not in the result: " + order.column);
+        }
+        keys.push_back({column, order.descending});
+    }
+    auto before = [&keys](const std::vector<Value>& a, const std::vector<Value>& b) {
+        for (const auto& [column, descending] : keys) {
+            int c = compareValues(a[column], b[column]);
+            if (c != 0) return descending ? c > 0 : c < 0;
+        }
+        return false;
+    };
+    std::vector<size_t> heads(partials.size(), 0);
+    while (result.rows.size() < limit) {
+        size_t best = partials.size();
+        for (size_t i = 0; i < partials.size(); i++) {
+            if (heads[i] == partials[i].rows.size()) continue;
+            if (best == partials.size() || before(partials[i].rows[heads[i]], partials[best].rows[heads[best]])) {
+                best = i;
+            }
+        }
+        if (best == partials.size()) break;
+        result.rows.push_back(std::move(partials[best].rows[heads[best]++]));
+    }
+    return result;
+}
+
+QueryResult ShardedDatabase::queryShard(const Value& key, const std::string& sql,
+                                        const std::vector<Value>& params) {
+    return shards_[shardFor(key)]->query(sql, params);
+}
+
+std::vector<StoredRecord> ShardedDatabase::findByIndex(const std::string& tableName, const std::string& column,
+                                                       const Value& value) {
+    auto it = routes_.find(tableName);
+    if (it != routes_.end() && it->second.column == column) {
+        return shards_[shardFor(value)]->findByIndex(tableName, column, value);
+    }
+    std::vector<std::vector<StoredRecord>> partials(shards_.size());
+    forEachShard([&](size_t i) { partials[i] = shards_[i]->findByIndex(tableName, column, value); });
+    std::vector<StoredRecord> records;
+    for (auto& partial : partials) {
+        records.insert(records.end(), std::make_move_iterator(partial.begin()), std::make_move_iterator(partial.end()));
+    }
+    return records;
+}
+
+QueryResult ShardedDatabase::aggregate(const std::string& tableName, const std::vector<AggregateSpec>& aggregates,
+                                       const std::string& groupBy) {
+    std::vector<AggregateGroups> partials(shards_.size());
+    forEachShard([&](size_t i) { partials[i] = shards_[i]->aggregateGroups(tableName, aggregates, groupBy); });
+    AggregateGroups groups;
+    for (auto& partial : partials) {
+        mergeAggregateGroups(groups, std::move(partial));
+    }
+    return aggregateResult(groups, aggregates, groupBy);
+}
+
+}  // namespace flatsql
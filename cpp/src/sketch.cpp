@@ -0,0 +1,400 @@
+#include "flatsql/sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace flatsql {
+
+namespace {
+
+constexpr uint8_t HLL_MAGIC[4] = {'F', 'S', 'H', 'L'};
+constexpr uint8_t DIGEST_MAGIC[4] = {'F', 'S', 'T', 'D'};
+
+// Type tags, so 1 and "1" hash apart
+constexpr uint64_t NUMBER_TAG = 0x9e3779b97f4a7c15ull;
+constexpr uint64_t TEXT_TAG = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t BLOB_TAG = 0x165667b19e3779f9ull;
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t hashInt(int64_t v) {
+    return mix(static_cast<uint64_t>(v) ^ NUMBER_TAG);
+}
+
+uint64_t hashReal(double v) {
+    // Integral reals hash as the integer they equal
+    if (v >= -9.2e18 && v <= 9.2e18 && v == std::floor(v)) {
+        return hashInt(static_cast<int64_t>(v));
+    }
+    if (v == 0) v = 0;  // -0.0
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return mix(bits ^ NUMBER_TAG ^ 1);
+}
+
+uint64_t hashBytes(uint64_t tag, const void* data, size_t length) {
+    // FNV-1a, then mixed so every bit depends on every byte
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = 14695981039346656037ull ^ tag;
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return mix(h);
+}
+
+void putUint(std::vector<uint8_t>& out, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+void putDouble(std::vector<uint8_t>& out, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    putUint(out, bits, 8);
+}
+
+uint64_t getUint(const uint8_t* p, size_t bytes) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+double getDouble(const uint8_t* p) {
+    uint64_t bits = getUint(p, 8);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+// ==================== HyperLogLog ====================
+
+uint64_t HyperLogLog::hash(const Value& value) {
+    return std::visit([](const auto& v) -> uint64_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            return mix(0);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return hashBytes(TEXT_TAG, v.data(), v.size());
+        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            return hashBytes(BLOB_TAG, v.data(), v.size());
+        } else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            return hashReal(static_cast<double>(v));
+        } else if constexpr (std::is_same_v<T, uint64_t>) {
+            return v > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())
+                       ? hashReal(static_cast<double>(v))
+                       : hashInt(static_cast<int64_t>(v));
+        } else {
+            return hashInt(static_cast<int64_t>(v));
+        }
+    }, value);
+}
+
+void HyperLogLog::add(const Value& value) {
+    addHash(hash(value));
+}
+
+void HyperLogLog::addHash(uint64_t hash) {
+    if (registers_.empty()) registers_.assign(REGISTERS, 0);
+    // Top bits pick the register, which keeps the longest run of leading
+    // zeros seen in the rest of the hash
+    size_t reg = static_cast<size_t>(hash >> (64 - PRECISION));
+    uint64_t rest = hash << PRECISION;
+    uint8_t rank = rest ? static_cast<uint8_t>(__builtin_clzll(rest) + 1) : static_cast<uint8_t>(64 - PRECISION + 1);
+    if (rank > registers_[reg]) registers_[reg] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.registers_.empty()) return;
+    if (registers_.empty()) {
+        registers_ = other.registers_;
+        return;
+    }
+    for (size_t i = 0; i < REGISTERS; i++) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+uint64_t HyperLogLog::estimate() const {
+    if (registers_.empty()) return 0;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t rank : registers_) {
+        sum += std::ldexp(1.0, -rank);
+        zeros += rank == 0;
+    }
+    const double m = static_cast<double>(REGISTERS);
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));  // Linear counting
+    }
+    return static_cast<uint64_t>(std::llround(estimate));
+}
+
+std::vector<uint8_t> HyperLogLog::serialize() const {
+    std::vector<uint8_t> out(HLL_MAGIC, HLL_MAGIC + sizeof(HLL_MAGIC));
+    out.push_back(static_cast<uint8_t>(PRECISION));
+    if (registers_.empty()) {
+        out.resize(out.size() + REGISTERS, 0);
+    } else {
+        out.insert(out.end(), registers_.begin(), registers_.end());
+    }
+    return out;
+}
+
+HyperLogLog HyperLogLog::deserialize(const uint8_t* data, size_t length) {
+    if (length != sizeof(HLL_MAGIC) + 1 + REGISTERS || std::memcmp(data, HLL_MAGIC, sizeof(HLL_MAGIC)) != 0 ||
+        data[sizeof(HLL_MAGIC)] != PRECISION) {
+        throw std::runtime_error("Not a HyperLogLog sketch");
+    }
+    HyperLogLog sketch;
+    const uint8_t* registers = data + sizeof(HLL_MAGIC) + 1;
+    if (std::any_of(registers, registers + REGISTERS, [](uint8_t rank) { return rank != 0; })) {
+        sketch.registers_.assign(registers, registers + REGISTERS);
+    }
+    return sketch;
+}
+
+// ==================== TDigest ====================
+
+TDigest::TDigest(double compression) : compression_(std::max(compression, 10.0)) {}
+
+void TDigest::add(double value, double weight) {
+    if (std::isnan(value) || !(weight > 0)) return;
+    if (empty()) {
+        min_ = max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    buffer_.push_back({value, weight});
+    buffered_ += weight;
+    if (buffer_.size() >= static_cast<size_t>(compression_ * 5)) compress();
+}
+
+void TDigest::merge(const TDigest& other) {
+    if (other.empty()) return;
+    if (empty()) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    buffered_ += other.total_ + other.buffered_;
+    if (buffer_.size() >= static_cast<size_t>(compression_ * 5)) compress();
+}
+
+void TDigest::compress() const {
+    if (buffer_.empty()) return;
+    centroids_.insert(centroids_.end(), buffer_.begin(), buffer_.end());
+    buffer_.clear();
+    total_ += buffered_;
+    buffered_ = 0.0;
+    std::sort(centroids_.begin(), centroids_.end(),
+              [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    // k1 scale: a centroid may grow until it spans one unit of
+    // k(q) = compression / 2pi * asin(2q - 1), which is steep at the tails
+    const double scale = compression_ / (2.0 * M_PI);
+    auto nextLimit = [&](double q) {
+        double k = scale * std::asin(2.0 * q - 1.0) + 1.0;
+        if (k >= compression_ / 4.0) return 1.0;
+        return (std::sin(k / scale) + 1.0) / 2.0;
+    };
+
+    std::vector<Centroid> merged;
+    merged.reserve(static_cast<size_t>(compression_) * 2);
+    double before = 0.0;  // Weight ahead of merged.back()
+    double limit = total_ * nextLimit(0.0);
+    for (const Centroid& c : centroids_) {
+        if (merged.empty()) {
+            merged.push_back(c);
+            continue;
+        }
+        Centroid& last = merged.back();
+        if (before + last.weight + c.weight <= limit) {
+            last.weight += c.weight;
+            last.mean += (c.mean - last.mean) * c.weight / last.weight;
+        } else {
+            before += last.weight;
+            limit = total_ * nextLimit(before / total_);
+            merged.push_back(c);
+        }
+    }
+    centroids_.swap(merged);
+}
+
+double TDigest::quantile(double q) const {
+    compress();
+    if (centroids_.empty()) return std::numeric_limits<double>::quiet_NaN();
+    q = std::min(std::max(q, 0.0), 1.0);
+    double target = q * total_;
+    if (centroids_.size() == 1) return centroids_[0].mean;
+
+    // Each centroid's weight is centered on its mean: interpolate between
+    // neighbouring centers, and from min / max to the outer ones
+    const Centroid& first = centroids_.front();
+    if (target < first.weight / 2) {
+        return min_ + (first.mean - min_) * target / (first.weight / 2);
+    }
+    double cumulative = 0.0;
+    for (size_t i = 0; i + 1 < centroids_.size(); i++) {
+        const Centroid& a = centroids_[i];
+        const Centroid& b = centroids_[i + 1];
+        double center = cumulative + a.weight / 2;
+        double nextCenter = cumulative + a.weight + b.weight / 2;
+        if (target < nextCenter) {
+            return a.mean + (b.mean - a.mean) * (target - center) / (nextCenter - center);
+        }
+        cumulative += a.weight;
+    }
+    const Centroid& last = centroids_.back();
+    double center = total_ - last.weight / 2;
+    return std::min(max_, last.mean + (max_ - last.mean) * (target - center) / (last.weight / 2));
+}
+
+std::vector<uint8_t> TDigest::serialize() const {
+    compress();
+    std::vector<uint8_t> out(DIGEST_MAGIC, DIGEST_MAGIC + sizeof(DIGEST_MAGIC));
+    putDouble(out, compression_);
+    putDouble(out, min_);
+    putDouble(out, max_);
+    putUint(out, centroids_.size(), 4);
+    for (const Centroid& c : centroids_) {
+        putDouble(out, c.mean);
+        putDouble(out, c.weight);
+    }
+    return out;
+}
+
+TDigest TDigest::deserialize(const uint8_t* data, size_t length) {
+    constexpr size_t HEADER = sizeof(DIGEST_MAGIC) + 3 * 8 + 4;
+    if (length < HEADER || std::memcmp(data, DIGEST_MAGIC, sizeof(DIGEST_MAGIC)) != 0) {
+        throw std::runtime_error("Not a t-digest");
+    }
+    const uint8_t* p = data + sizeof(DIGEST_MAGIC);
+    TDigest digest(getDouble(p));
+    digest.min_ = getDouble(p + 8);
+    digest.max_ = getDouble(p + 16);
+    size_t count = static_cast<size_t>(getUint(p + 24, 4));
+    if ((length - HEADER) / 16 != count || (length - HEADER) % 16 != 0) {
+        throw std::runtime_error("Truncated t-digest");
+    }
+    p = data + HEADER;
+    for (size_t i = 0; i < count; i++, p += 16) {
+        Centroid c{getDouble(p), getDouble(p + 8)};
+        if (!(c.weight > 0) || std::isnan(c.mean)) throw std::runtime_error("Corrupt t-digest");
+        if (!digest.centroids_.empty() && c.mean < digest.centroids_.back().mean) {
+            throw std::runtime_error("Corrupt t-digest");
+        }
+        digest.centroids_.push_back(c);
+        digest.total_ += c.weight;
+    }
+    return digest;
+}
+
+// ==================== SQL functions ====================
+
+namespace {
+
+// Hash of a SQL value, as HyperLogLog::hash() gives for the same Value
+uint64_t hashSqlValue(sqlite3_value* value) {
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER:
+            return hashInt(sqlite3_value_int64(value));
+        case SQLITE_FLOAT:
+            return hashReal(sqlite3_value_double(value));
+        case SQLITE_TEXT:
+            return hashBytes(TEXT_TAG, sqlite3_value_text(value), static_cast<size_t>(sqlite3_value_bytes(value)));
+        default:
+            return hashBytes(BLOB_TAG, sqlite3_value_blob(value), static_cast<size_t>(sqlite3_value_bytes(value)));
+    }
+}
+
+// Aggregate context: a pointer to the running sketch, freed by xFinal
+template <typename State>
+State* stateFor(sqlite3_context* ctx, bool create) {
+    auto** slot = static_cast<State**>(sqlite3_aggregate_context(ctx, create ? sizeof(State*) : 0));
+    if (!slot) return nullptr;
+    if (!*slot && create) *slot = new State();
+    return *slot;
+}
+
+void approxCountDistinctStep(sqlite3_context* ctx, int /*argc*/, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    HyperLogLog* sketch = stateFor<HyperLogLog>(ctx, true);
+    if (!sketch) {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+    sketch->addHash(hashSqlValue(argv[0]));
+}
+
+void approxCountDistinctFinal(sqlite3_context* ctx) {
+    HyperLogLog* sketch = stateFor<HyperLogLog>(ctx, false);
+    sqlite3_result_int64(ctx, sketch ? static_cast<sqlite3_int64>(sketch->estimate()) : 0);
+    delete sketch;
+}
+
+struct PercentileState {
+    TDigest digest;
+    double fraction = -1.0;  // From the first row
+};
+
+void approxPercentileStep(sqlite3_context* ctx, int /*argc*/, sqlite3_value** argv) {
+    PercentileState* state = stateFor<PercentileState>(ctx, true);
+    if (!state) {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+    if (state->fraction < 0) {
+        int type = sqlite3_value_type(argv[1]);
+        double fraction = sqlite3_value_double(argv[1]);
+        if ((type != SQLITE_INTEGER && type != SQLITE_FLOAT) || !(fraction >= 0.0 && fraction <= 1.0)) {
+            sqlite3_result_error(ctx, "approx_percentile fraction must be between 0 and 1", -1);
+            return;
+        }
+        state->fraction = fraction;
+    }
+    int type = sqlite3_value_type(argv[0]);
+    if (type == SQLITE_INTEGER || type == SQLITE_FLOAT) {
+        state->digest.add(sqlite3_value_double(argv[0]));
+    }
+}
+
+void approxPercentileFinal(sqlite3_context* ctx) {
+    PercentileState* state = stateFor<PercentileState>(ctx, false);
+    if (state && !state->digest.empty()) {
+        sqlite3_result_double(ctx, state->digest.quantile(state->fraction));
+    } else {
+        sqlite3_result_null(ctx);
+    }
+    delete state;
+}
+
+}  // namespace
+
+void registerSketchFunctions(sqlite3* db) {
+    int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    sqlite3_create_function(db, "approx_count_distinct", 1, flags, nullptr, nullptr,
+                            approxCountDistinctStep, approxCountDistinctFinal);
+    sqlite3_create_function(db, "approx_percentile", 2, flags, nullptr, nullptr,
+                            approxPercentileStep, approxPercentileFinal);
+}
+
+}  // namespace flatsql
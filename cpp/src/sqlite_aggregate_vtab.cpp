@@ -0,0 +1,201 @@
+#include "flatsql/sqlite_aggregate_vtab.h"
+#include "flatsql/sqlite_vtab.h"
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace flatsql {
+
+sqlite3_module AggregateVTabModule::module_ = {
+    0,                          // iVersion
+    xCreate,                    // xCreate
+    xConnect,                   // xConnect
+    xBestIndex,                 // xBestIndex
+    xDisconnect,                // xDisconnect
+    xDestroy,                   // xDestroy
+    xOpen,                      // xOpen
+    xClose,                     // xClose
+    xFilter,                    // xFilter
+    xNext,                      // xNext
+    xEof,                       // xEof
+    xColumn,                    // xColumn
+    xRowid,                     // xRowid
+    nullptr,                    // xUpdate (read-only)
+    nullptr,                    // xBegin
+    nullptr,                    // xSync
+    nullptr,                    // xCommit
+    nullptr,                    // xRollback
+    nullptr,                    // xFindFunction
+    nullptr,                    // xRename
+    nullptr,                    // xSavepoint
+    nullptr,                    // xRelease
+    nullptr,                    // xRollbackTo
+    nullptr,                    // xShadowName
+    nullptr                     // xIntegrity
+};
+
+sqlite3_module* AggregateVTabModule::getModule() {
+    return &module_;
+}
+
+int AggregateVTabModule::xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                                 sqlite3_vtab** ppVTab, char** pzErr) {
+    return xConnect(db, pAux, argc, argv, ppVTab, pzErr);
+}
+
+int AggregateVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                                  sqlite3_vtab** ppVTab, char** pzErr) {
+    (void)argc;
+    (void)argv;
+
+    AggregateVTabInfo* info = static_cast<AggregateVTabInfo*>(pAux);
+    if (!info || !info->aggregate) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Missing materialized aggregate");
+        }
+        return SQLITE_ERROR;
+    }
+
+    // Labels such as COUNT(*) need quoting as column names
+    std::string decl = "CREATE TABLE x(";
+    const auto& names = info->aggregate->getColumnNames();
+    for (size_t i = 0; i < names.size(); i++) {
+        if (i > 0) decl += ", ";
+        decl += '"';
+        for (char c : names[i]) {
+            decl += c;
+            if (c == '"') decl += '"';
+        }
+        decl += '"';
+    }
+    decl += ")";
+
+    int rc = sqlite3_declare_vtab(db, decl.c_str());
+    if (rc != SQLITE_OK) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
+        }
+        return rc;
+    }
+
+    AggregateVTab* vtab = new AggregateVTab();
+    memset(static_cast<sqlite3_vtab*>(vtab), 0, sizeof(sqlite3_vtab));
+    vtab->info = info;
+    *ppVTab = vtab;
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xDisconnect(sqlite3_vtab* pVTab) {
+    delete static_cast<AggregateVTab*>(pVTab);
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xDestroy(sqlite3_vtab* pVTab) {
+    return xDisconnect(pVTab);
+}
+
+int AggregateVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo) {
+    AggregateVTab* vtab = static_cast<AggregateVTab*>(pVTab);
+    const MaterializedAggregate& aggregate = *vtab->info->aggregate;
+    double groups = static_cast<double>(aggregate.getGroups().size());
+
+    // idxNum 1: look up the group column's value (SQLite still checks it)
+    if (aggregate.isGrouped()) {
+        for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+            const auto& constraint = pIdxInfo->aConstraint[i];
+            if (constraint.usable && constraint.iColumn == 0 && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+                pIdxInfo->idxNum = 1;
+                pIdxInfo->estimatedCost = 1.0;
+                pIdxInfo->estimatedRows = 1;
+                pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+                return SQLITE_OK;
+            }
+        }
+    }
+
+    pIdxInfo->idxNum = 0;
+    pIdxInfo->estimatedCost = groups + 1.0;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(groups) + 1;
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor) {
+    AggregateCursor* cursor = new AggregateCursor();
+    memset(static_cast<sqlite3_vtab_cursor*>(cursor), 0, sizeof(sqlite3_vtab_cursor));
+    cursor->vtab = static_cast<AggregateVTab*>(pVTab);
+    cursor->current = cursor->end = cursor->vtab->info->aggregate->getGroups().end();
+    cursor->rowid = 0;
+    *ppCursor = cursor;
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xClose(sqlite3_vtab_cursor* pCursor) {
+    delete static_cast<AggregateCursor*>(pCursor);
+    return SQLITE_OK;
+}
+
+void AggregateVTabModule::skipEmpty(AggregateCursor* cursor) {
+    if (!cursor->vtab->info->aggregate->isGrouped()) return;
+    while (cursor->current != cursor->end && cursor->current->second.rows == 0) {
+        ++cursor->current;
+    }
+}
+
+int AggregateVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                                 int argc, sqlite3_value** argv) {
+    (void)idxStr;
+    AggregateCursor* cursor = static_cast<AggregateCursor*>(pCursor);
+    AggregateVTabInfo* info = cursor->vtab->info;
+    if (info->aggregate->needsRefresh() && info->refresh) {
+        try {
+            info->refresh();
+        } catch (const std::exception& e) {
+            sqlite3_free(cursor->vtab->zErrMsg);
+            cursor->vtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+            return SQLITE_ERROR;
+        }
+    }
+
+    const auto& groups = info->aggregate->getGroups();
+    cursor->rowid = 1;
+    if (idxNum == 1 && argc >= 1) {
+        Value key = FlatBufferVTabModule::valueFromSqlite(argv[0]);
+        auto it = std::holds_alternative<std::monostate>(key) ? groups.end() : groups.find(key);
+        cursor->current = it;
+        cursor->end = it == groups.end() ? it : std::next(it);
+    } else {
+        cursor->current = groups.begin();
+        cursor->end = groups.end();
+    }
+    skipEmpty(cursor);
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
+    AggregateCursor* cursor = static_cast<AggregateCursor*>(pCursor);
+    ++cursor->current;
+    cursor->rowid++;
+    skipEmpty(cursor);
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xEof(sqlite3_vtab_cursor* pCursor) {
+    AggregateCursor* cursor = static_cast<AggregateCursor*>(pCursor);
+    return cursor->current == cursor->end ? 1 : 0;
+}
+
+int AggregateVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N) {
+    AggregateCursor* cursor = static_cast<AggregateCursor*>(pCursor);
+    const MaterializedAggregate& aggregate = *cursor->vtab->info->aggregate;
+    FlatBufferVTabModule::setResultFromValue(ctx, aggregate.result(*cursor->current, static_cast<size_t>(N)));
+    return SQLITE_OK;
+}
+
+int AggregateVTabModule::xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    *pRowid = static_cast<AggregateCursor*>(pCursor)->rowid;
+    return SQLITE_OK;
+}
+
+}  // namespace flatsql
@@ -1,8 +1,16 @@
 #include "flatsql/sqlite_engine.h"
 #include "flatsql/geo_functions.h"
+#include "flatsql/sketch.h"
+#include "flatsql/trigram_index.h"
+#include "flatsql/sqlite_stats_vtab.h"
+#include "flatsql/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <cctype>
+#include <cstring>
 
 // sqlean extension init functions (C linkage)
 extern "C" {
@@ -38,7 +46,9 @@ static std::string normalizeSQL(const std::string& sql) {
     return result;
 }
 
-SQLiteEngine::SQLiteEngine() : db_(nullptr) {
+SQLiteEngine::SQLiteEngine()
+    : db_(nullptr), snapshot_(std::make_unique<ReadSnapshot>()),
+      queryStats_(std::make_unique<QueryStatsLog>()), indexAdvisor_(std::make_unique<IndexAdvisor>()) {
     int rc = sqlite3_open(":memory:", &db_);
     if (rc != SQLITE_OK) {
         std::string error = sqlite3_errmsg(db_);
@@ -49,6 +59,8 @@ SQLiteEngine::SQLiteEngine() : db_(nullptr) {
 
     // Register custom geo/spatial functions
     registerGeoFunctions(db_);
+    registerSketchFunctions(db_);
+    registerTrigramFunctions(db_);
 
     // Register sqlean extensions
     math_init(db_);
@@ -56,6 +68,10 @@ SQLiteEngine::SQLiteEngine() : db_(nullptr) {
     text_init(db_);
     uuid_init(db_);
     fuzzy_init(db_);
+
+    // Eponymous, so SELECT * FROM flatsql_stats works without a CREATE
+    sqlite3_create_module_v2(db_, StatsVTabModule::TABLE_NAME, StatsVTabModule::getModule(),
+                             queryStats_.get(), nullptr);
 }
 
 SQLiteEngine::~SQLiteEngine() {
@@ -66,31 +82,72 @@ SQLiteEngine::~SQLiteEngine() {
     }
 }
 
+void SQLiteEngine::setCacheLimits(const EngineCacheLimits& limits) {
+    stmtCache_.setCapacity(limits.statements);
+    parsedQueryCache_.setCapacity(limits.parsedQueries);
+    sourceNameCache_.setCapacity(limits.sourceNames);
+    columnNamesCache_.setCapacity(limits.columnNames);
+}
+
+EngineCacheLimits SQLiteEngine::getCacheLimits() const {
+    EngineCacheLimits limits;
+    limits.statements = stmtCache_.capacity();
+    limits.parsedQueries = parsedQueryCache_.capacity();
+    limits.sourceNames = sourceNameCache_.capacity();
+    limits.columnNames = columnNamesCache_.capacity();
+    return limits;
+}
+
+EngineCacheStats SQLiteEngine::getCacheStats() const {
+    EngineCacheStats stats;
+    stats.statements = stmtCache_.getStats();
+    stats.parsedQueries = parsedQueryCache_.getStats();
+    stats.sourceNames = sourceNameCache_.getStats();
+    stats.columnNames = columnNamesCache_.getStats();
+    return stats;
+}
+
 void SQLiteEngine::clearStmtCache() {
-    for (auto& [sql, stmt] : stmtCache_) {
-        if (stmt) {
-            sqlite3_finalize(stmt);
+    stmtCache_.clear();  // Finalizes each statement
+}
+
+EngineMemory SQLiteEngine::getMemoryUsage() const {
+    EngineMemory usage;
+    int current = 0;
+    int highwater = 0;
+    if (sqlite3_db_status(db_, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) == SQLITE_OK) {
+        usage.pageCacheBytes = static_cast<uint64_t>(current);
+    }
+    if (sqlite3_db_status(db_, SQLITE_DBSTATUS_STMT_USED, &current, &highwater, 0) == SQLITE_OK) {
+        usage.statementBytes = static_cast<uint64_t>(current);
+    }
+    if (sqlite3_db_status(db_, SQLITE_DBSTATUS_SCHEMA_USED, &current, &highwater, 0) == SQLITE_OK) {
+        usage.schemaBytes = static_cast<uint64_t>(current);
+    }
+    usage.resultCacheBytes = getResultCacheStats().bytes;
+    return usage;
+}
+
+void SQLiteEngine::releaseMemory() {
+    clearResultCache();
+    clearStmtCache();
+    parsedQueryCache_.clear();
+    sqlite3_db_release_memory(db_);
+}
+
+void SQLiteEngine::resetActiveStatements() {
+    for (sqlite3_stmt* stmt = sqlite3_next_stmt(db_, nullptr); stmt;
+         stmt = sqlite3_next_stmt(db_, stmt)) {
+        if (sqlite3_stmt_busy(stmt)) {
+            sqlite3_reset(stmt);
         }
     }
-    stmtCache_.clear();
 }
 
 sqlite3_stmt* SQLiteEngine::getOrPrepareStmt(const std::string& sql) const {
-    auto it = stmtCache_.find(sql);
-    if (it != stmtCache_.end()) {
-        sqlite3_reset(it->second);
-        return it->second;
-    }
-
-    // Evict old entries if cache is full
-    if (stmtCache_.size() >= MAX_STMT_CACHE_SIZE) {
-        // Simple eviction: clear entire cache
-        for (auto& [s, stmt] : stmtCache_) {
-            if (stmt) {
-                sqlite3_finalize(stmt);
-            }
-        }
-        stmtCache_.clear();
+    if (sqlite3_stmt** cached = stmtCache_.find(sql)) {
+        sqlite3_reset(*cached);
+        return *cached;
     }
 
     sqlite3_stmt* stmt = nullptr;
@@ -99,22 +156,35 @@ sqlite3_stmt* SQLiteEngine::getOrPrepareStmt(const std::string& sql) const {
         throw std::runtime_error("SQL error: " + std::string(sqlite3_errmsg(db_)));
     }
 
-    stmtCache_[sql] = stmt;
-    return stmt;
+    // The least recently used statement is finalized when the cache is full
+    return stmtCache_.insert(sql, stmt);
 }
 
 SQLiteEngine::SQLiteEngine(SQLiteEngine&& other) noexcept
-    : db_(other.db_), sources_(std::move(other.sources_)) {
+    : db_(other.db_), sources_(std::move(other.sources_)), unions_(std::move(other.unions_)),
+      aggregates_(std::move(other.aggregates_)), snapshot_(std::move(other.snapshot_)),
+      resultCache_(std::move(other.resultCache_)), queryStats_(std::move(other.queryStats_)),
+      indexAdvisor_(std::move(other.indexAdvisor_)) {
     other.db_ = nullptr;
 }
 
 SQLiteEngine& SQLiteEngine::operator=(SQLiteEngine&& other) noexcept {
     if (this != &other) {
+        clearStmtCache();
         if (db_) {
             sqlite3_close(db_);
         }
         db_ = other.db_;
         sources_ = std::move(other.sources_);
+        unions_ = std::move(other.unions_);
+        aggregates_ = std::move(other.aggregates_);
+        snapshot_ = std::move(other.snapshot_);
+        resultCache_ = std::move(other.resultCache_);
+        queryStats_ = std::move(other.queryStats_);
+        indexAdvisor_ = std::move(other.indexAdvisor_);
+        sourceNameCache_.clear();
+        parsedQueryCache_.clear();
+        columnNamesCache_.clear();
         other.db_ = nullptr;
     }
     return *this;
@@ -126,10 +196,16 @@ void SQLiteEngine::registerSource(
     const TableDef* tableDef,
     const std::string& fileId,
     FieldExtractor extractor,
-    const std::unordered_map<std::string, SqliteIndex*>& indexes,
+    const std::unordered_map<std::string, Index*>& indexes,
     FastFieldExtractor fastExtractor,
     BatchExtractor batchExtractor,
-    const std::vector<StreamingFlatBufferStore::FileRecordInfo>* sourceRecordInfos
+    const StreamingFlatBufferStore::RecordInfoList* sourceRecordInfos,
+    const ColumnCacheSlots* columnCaches,
+    const SchemaExtractor* schemaExtractor,
+    const ZoneMapSlots* zoneMaps,
+    const ZoneBloomSlots* bloomFilters,
+    const flatbuffers::EncryptionContext* encryptionCtx,
+    RecordVerification* verification
 ) {
     if (sources_.count(sourceName)) {
         throw std::runtime_error("Source already registered: " + sourceName);
@@ -145,17 +221,110 @@ void SQLiteEngine::registerSource(
     sourceInfo->batchExtractor = batchExtractor;
     sourceInfo->indexes = indexes;
     sourceInfo->sourceRecordInfos = sourceRecordInfos;
+    sourceInfo->encryptionCtx = encryptionCtx;
 
     // Set up VTabCreateInfo (pointer will be stable after insert)
     sourceInfo->vtabInfo.store = store;
     sourceInfo->vtabInfo.tableDef = tableDef;
     sourceInfo->vtabInfo.sourceName = sourceName;
     sourceInfo->vtabInfo.fastExtractor = fastExtractor;
+    sourceInfo->vtabInfo.batchExtractor = batchExtractor;
     sourceInfo->vtabInfo.fileId = fileId;
     sourceInfo->vtabInfo.extractor = extractor;
     sourceInfo->vtabInfo.indexes = indexes;
     sourceInfo->vtabInfo.tombstones = &sourceInfo->tombstones;
     sourceInfo->vtabInfo.sourceRecordInfos = sourceRecordInfos;
+    sourceInfo->vtabInfo.columnCaches = columnCaches;
+    sourceInfo->vtabInfo.zoneMaps = zoneMaps;
+    sourceInfo->vtabInfo.bloomFilters = bloomFilters;
+    sourceInfo->vtabInfo.schemaExtractor = schemaExtractor;
+    sourceInfo->vtabInfo.encryptionCtx = encryptionCtx;
+    sourceInfo->vtabInfo.verification = verification;
+
+    sourceInfo->vtabInfo.snapshot = snapshot_.get();
+    sourceInfo->vtabInfo.queryStats = queryStats_.get();
+    sourceInfo->vtabInfo.indexAdvisor = indexAdvisor_.get();
+
+    createVirtualTable(std::move(sourceInfo));
+}
+
+void SQLiteEngine::registerSharedSource(const SourceInfo& shared) {
+    if (sources_.count(shared.name)) {
+        throw std::runtime_error("Source already registered: " + shared.name);
+    }
+
+    // Same store, indexes and extractors as the owning engine; tombstones
+    // stay with the owner so deletes made there are seen here
+    auto sourceInfo = std::make_unique<SourceInfo>();
+    sourceInfo->name = shared.name;
+    sourceInfo->store = shared.store;
+    sourceInfo->tableDef = shared.tableDef;
+    sourceInfo->fileId = shared.fileId;
+    sourceInfo->extractor = shared.extractor;
+    sourceInfo->fastExtractor = shared.vtabInfo.fastExtractor;
+    sourceInfo->batchExtractor = shared.batchExtractor;
+    sourceInfo->indexes = shared.indexes;
+    sourceInfo->sourceRecordInfos = shared.sourceRecordInfos;
+    sourceInfo->encryptionCtx = shared.encryptionCtx;
+    sourceInfo->vtabInfo = shared.vtabInfo;
+    sourceInfo->vtabInfo.snapshot = snapshot_.get();
+    sourceInfo->vtabInfo.queryStats = queryStats_.get();
+    sourceInfo->vtabInfo.indexAdvisor = indexAdvisor_.get();
+    sourceInfo->vtabInfo.connected = nullptr;  // The owner's table
+
+    createVirtualTable(std::move(sourceInfo));
+}
+
+void SQLiteEngine::setIndexAdvisorEnabled(bool enabled) {
+    if (indexAdvisor_->enabled() == enabled) return;
+    indexAdvisor_->setEnabled(enabled);
+    clearStmtCache();
+}
+
+void SQLiteEngine::addSourceIndex(const std::string& sourceName, const std::string& key, Index* index) {
+    auto it = sources_.find(sourceName);
+    if (it == sources_.end()) {
+        throw std::runtime_error("Source not found: " + sourceName);
+    }
+    SourceInfo& info = *it->second;
+    info.indexes[key] = index;
+    info.vtabInfo.indexes[key] = index;
+    if (info.vtabInfo.connected) {
+        info.vtabInfo.connected->indexes[key] = index;
+        FlatBufferVTabModule::collectComposites(info.vtabInfo.connected);
+    }
+    // Plans of cached statements predate the index
+    clearStmtCache();
+}
+
+void SQLiteEngine::refreshSource(const std::string& sourceName, FieldExtractor extractor,
+                                 const SchemaExtractor* schemaExtractor) {
+    auto it = sources_.find(sourceName);
+    if (it == sources_.end()) {
+        throw std::runtime_error("Source not found: " + sourceName);
+    }
+    SourceInfo& info = *it->second;
+    clearStmtCache();  // Before the table they were prepared against goes
+    sourceNameCache_.clear();
+    columnNamesCache_.clear();
+    clearResultCache();
+    info.extractor = extractor;
+    info.vtabInfo.extractor = std::move(extractor);
+    info.vtabInfo.schemaExtractor = schemaExtractor;
+
+    // Registering the module again drops its eponymous table
+    int rc = sqlite3_create_module_v2(db_, sourceName.c_str(), FlatBufferVTabModule::getModule(),
+                                      &info.vtabInfo, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to create SQLite module: " + std::string(sqlite3_errmsg(db_)));
+    }
+}
+
+void SQLiteEngine::createVirtualTable(std::unique_ptr<SourceInfo> sourceInfo) {
+    const std::string sourceName = sourceInfo->name;
+    sourceNameCache_.clear();
+    columnNamesCache_.clear();
+    clearResultCache();  // Entries may point at a replaced source
 
     // Store before registering (so pointers are stable)
     SourceInfo* infoPtr = sourceInfo.get();
@@ -175,34 +344,10 @@ void SQLiteEngine::registerSource(
         throw std::runtime_error("Failed to create SQLite module: " + std::string(sqlite3_errmsg(db_)));
     }
 
-    // Create the virtual table
-    std::ostringstream sql;
-    sql << "CREATE VIRTUAL TABLE \"" << sourceName << "\" USING \"" << sourceName << "\"()";
-
-    char* errMsg = nullptr;
-    rc = sqlite3_exec(db_, sql.str().c_str(), nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK) {
-        std::string error = errMsg ? errMsg : "Unknown error";
-        sqlite3_free(errMsg);
-        sources_.erase(sourceName);
-        throw std::runtime_error("Failed to create virtual table: " + error);
-    }
-}
-
-std::string SQLiteEngine::buildColumnList(const TableDef* tableDef) const {
-    std::ostringstream ss;
-    bool first = true;
-
-    for (const auto& col : tableDef->columns) {
-        if (!first) ss << ", ";
-        first = false;
-        ss << "\"" << col.name << "\"";
-    }
-
-    // Add virtual columns
-    ss << ", \"_source\", \"_rowid\", \"_offset\", \"_data\"";
-
-    return ss.str();
+    // No CREATE VIRTUAL TABLE: the module is eponymous, so the table is
+    // there by name and xConnect only runs once a query uses it. Opening
+    // a database with many tables therefore changes no schema and
+    // declares no columns up front.
 }
 
 void SQLiteEngine::createUnifiedView(
@@ -244,19 +389,29 @@ void SQLiteEngine::createUnifiedView(
         sqlite3_free(errMsg);  // Ignore errors
     }
 
-    // Build UNION ALL view with _source column
-    std::ostringstream sql;
-    sql << "CREATE VIEW \"" << viewName << "\" AS ";
-
-    bool first = true;
+    // The module keeps a pointer to the info, so replace it only once the
+    // old table is gone
+    auto info = std::make_unique<UnionVTabInfo>();
+    info->sourceNames = sourceNames;
     for (const auto& name : sourceNames) {
-        if (!first) sql << " UNION ALL ";
-        first = false;
-        sql << "SELECT " << buildColumnList(baseSchema) << " FROM \"" << name << "\"";
+        info->members.push_back(&sources_.at(name)->vtabInfo);
+    }
+    UnionVTabInfo* infoPtr = info.get();
+    unions_[viewName] = std::move(info);
+    sourceNameCache_.clear();
+    clearResultCache();
+
+    std::string moduleName = "union:" + viewName;
+    int rc = sqlite3_create_module_v2(db_, moduleName.c_str(), UnionVTabModule::getModule(),
+                                      infoPtr, nullptr);
+    if (rc != SQLITE_OK) {
+        unions_.erase(viewName);
+        throw std::runtime_error("Failed to create SQLite module: " + std::string(sqlite3_errmsg(db_)));
     }
 
+    std::string sql = "CREATE VIRTUAL TABLE \"" + viewName + "\" USING \"" + moduleName + "\"()";
     char* errMsg = nullptr;
-    int rc = sqlite3_exec(db_, sql.str().c_str(), nullptr, nullptr, &errMsg);
+    rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
     if (rc != SQLITE_OK) {
         std::string error = errMsg ? errMsg : "Unknown error";
         sqlite3_free(errMsg);
@@ -264,6 +419,64 @@ void SQLiteEngine::createUnifiedView(
     }
 }
 
+void SQLiteEngine::createAggregateTable(const std::string& tableName, const AggregateVTabInfo& info) {
+    if (aggregates_.count(tableName)) {
+        throw std::runtime_error("Materialized aggregate already exists: " + tableName);
+    }
+    auto owned = std::make_unique<AggregateVTabInfo>(info);
+    AggregateVTabInfo* infoPtr = owned.get();
+
+    std::string moduleName = "aggregate:" + tableName;
+    int rc = sqlite3_create_module_v2(db_, moduleName.c_str(), AggregateVTabModule::getModule(),
+                                      infoPtr, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to create SQLite module: " + std::string(sqlite3_errmsg(db_)));
+    }
+    aggregates_[tableName] = std::move(owned);
+
+    std::string sql = "CREATE VIRTUAL TABLE \"" + tableName + "\" USING \"" + moduleName + "\"()";
+    char* errMsg = nullptr;
+    rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string error = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Failed to create materialized aggregate table: " + error);
+    }
+}
+
+void SQLiteEngine::createJunctionTable(const std::string& tableName, const JunctionVTabInfo& info) {
+    if (junctions_.count(tableName)) {
+        throw std::runtime_error("Junction table already exists: " + tableName);
+    }
+    auto owned = std::make_unique<JunctionVTabInfo>(info);
+    JunctionVTabInfo* infoPtr = owned.get();
+
+    std::string moduleName = "junction:" + tableName;
+    int rc = sqlite3_create_module_v2(db_, moduleName.c_str(), JunctionVTabModule::getModule(),
+                                      infoPtr, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to create SQLite module: " + std::string(sqlite3_errmsg(db_)));
+    }
+    junctions_[tableName] = std::move(owned);
+
+    std::string sql = "CREATE VIRTUAL TABLE \"" + tableName + "\" USING \"" + moduleName + "\"()";
+    char* errMsg = nullptr;
+    rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string error = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Failed to create junction table: " + error);
+    }
+}
+
+std::map<std::string, std::vector<std::string>> SQLiteEngine::getUnifiedViews() const {
+    std::map<std::string, std::vector<std::string>> views;
+    for (const auto& [name, info] : unions_) {
+        views[name] = info->sourceNames;
+    }
+    return views;
+}
+
 void SQLiteEngine::bindValue(sqlite3_stmt* stmt, int idx, const Value& value) const {
     std::visit([&](const auto& v) {
         using T = std::decay_t<decltype(v)>;
@@ -293,18 +506,246 @@ void SQLiteEngine::bindValue(sqlite3_stmt* stmt, int idx, const Value& value) co
     }, value);
 }
 
+// Copy the current row's column into a Value
+static Value columnValue(sqlite3_stmt* stmt, int col) {
+    switch (sqlite3_column_type(stmt, col)) {
+        case SQLITE_INTEGER:
+            return static_cast<int64_t>(sqlite3_column_int64(stmt, col));
+
+        case SQLITE_FLOAT:
+            return sqlite3_column_double(stmt, col);
+
+        case SQLITE_TEXT: {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+            int len = sqlite3_column_bytes(stmt, col);
+            return std::string(text ? text : "", len);
+        }
+
+        case SQLITE_BLOB: {
+            const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+            int len = sqlite3_column_bytes(stmt, col);
+            return std::vector<uint8_t>(blob, blob + len);
+        }
+
+        case SQLITE_NULL:
+        default:
+            return std::monostate{};
+    }
+}
+
 QueryResult SQLiteEngine::execute(const std::string& sql) {
     return execute(sql, {});
 }
 
+namespace {
+
+// Records the statement execute() runs while query stats are on, until
+// it returns or throws
+class RecordedStatement {
+public:
+    RecordedStatement(QueryStatsLog& log, const std::string& sql) : log_(log), recording_(log.begin(sql)) {}
+    ~RecordedStatement() {
+        if (recording_) log_.end();
+    }
+
+    RecordedStatement(const RecordedStatement&) = delete;
+    RecordedStatement& operator=(const RecordedStatement&) = delete;
+
+    QueryStats* stats() const { return recording_ ? log_.current : nullptr; }
+
+    QueryResult returned(QueryResult result) const {
+        returnedRows(result.rows.size());
+        return result;
+    }
+
+    void returnedRows(size_t rows) const {
+        if (QueryStats* s = stats()) s->rowsReturned = rows;
+    }
+
+private:
+    QueryStatsLog& log_;
+    bool recording_;
+};
+
+}  // namespace
+
 QueryResult SQLiteEngine::execute(const std::string& sql, const std::vector<Value>& params) {
+    RecordedStatement recorded(*queryStats_, sql);
+    if (!resultCache_) {
+        return recorded.returned(executeStatement(sql, params));
+    }
+    std::string key = ResultCache::key(sql, params);
+    if (const QueryResult* cached = resultCache_->find(key)) {
+        if (QueryStats* stats = recorded.stats()) stats->resultCacheHit = true;
+        return recorded.returned(*cached);
+    }
+
+    // Tables cannot change during the statement (ingest runs on this
+    // thread), so watermarks taken now describe what it reads
+    std::vector<ResultCache::Watermark> watermarks;
+    bool cacheable = resultWatermarks(sql, watermarks);
+    QueryResult result = executeStatement(sql, params);
+    if (cacheable) {
+        resultCache_->insert(key, result, std::move(watermarks));
+    }
+    return recorded.returned(std::move(result));
+}
+
+void SQLiteEngine::setQueryStatsEnabled(bool enabled) {
+    queryStats_->setEnabled(enabled);
+}
+
+bool SQLiteEngine::queryStatsEnabled() const {
+    return queryStats_->enabled();
+}
+
+void SQLiteEngine::setQueryStatsCapacity(size_t statements) {
+    queryStats_->setCapacity(statements);
+}
+
+std::vector<QueryStats> SQLiteEngine::getQueryStats() const {
+    const auto& recent = queryStats_->recent();
+    return std::vector<QueryStats>(recent.begin(), recent.end());
+}
+
+QueryStats SQLiteEngine::getLastQueryStats() const {
+    const QueryStats* last = queryStats_->last();
+    return last ? *last : QueryStats();
+}
+
+void SQLiteEngine::clearQueryStats() {
+    queryStats_->clear();
+}
+
+void SQLiteEngine::setResultCacheSize(size_t capacityBytes) {
+    if (capacityBytes == 0) {
+        resultCache_.reset();
+    } else if (resultCache_) {
+        resultCache_->setCapacity(capacityBytes);
+    } else {
+        resultCache_ = std::make_unique<ResultCache>(capacityBytes);
+    }
+}
+
+ResultCacheStats SQLiteEngine::getResultCacheStats() const {
+    return resultCache_ ? resultCache_->getStats() : ResultCacheStats();
+}
+
+void SQLiteEngine::setAsOfSequence(uint64_t sequence) {
+    if (snapshot_->asOf == sequence) return;
+    snapshot_->asOf = sequence;
+    // Cached results were read at the previous watermark
+    clearResultCache();
+}
+
+uint64_t SQLiteEngine::getAsOfSequence() const {
+    return snapshot_->asOf;
+}
+
+void SQLiteEngine::clearResultCache() {
+    if (resultCache_) {
+        resultCache_->clear();
+    }
+}
+
+namespace {
+
+// Names of the tables a statement reads, collected while preparing it
+struct StatementReads {
+    std::set<std::string> tables;
+    bool deterministic = true;
+};
+
+int collectReads(void* arg, int action, const char* arg1, const char* arg2, const char*, const char*) {
+    StatementReads* reads = static_cast<StatementReads*>(arg);
+    if (action == SQLITE_READ && arg1) {
+        reads->tables.insert(arg1);
+    } else if (action == SQLITE_FUNCTION && arg2) {
+        static const char* const VOLATILE_FUNCTIONS[] = {
+            "random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+            "date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff",
+            "current_date", "current_time", "current_timestamp"};
+        for (const char* name : VOLATILE_FUNCTIONS) {
+            if (sqlite3_stricmp(arg2, name) == 0) reads->deterministic = false;
+        }
+    }
+    return SQLITE_OK;
+}
+
+}  // namespace
+
+bool SQLiteEngine::resultWatermarks(const std::string& sql, std::vector<ResultCache::Watermark>& watermarks) {
+    StatementReads reads;
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_set_authorizer(db_, collectReads, &reads);
+    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
+    sqlite3_set_authorizer(db_, nullptr, nullptr);
+    bool readOnly = rc == SQLITE_OK && stmt && sqlite3_stmt_readonly(stmt);
+    sqlite3_finalize(stmt);
+    if (!readOnly || !reads.deterministic) return false;
+
+    auto addSource = [&](const std::string& name) {
+        auto it = sources_.find(name);
+        if (it == sources_.end()) return false;
+        const SourceInfo& source = *it->second;
+        ResultCache::Watermark watermark{source.store, source.sourceRecordInfos, source.fileId,
+                                         source.vtabInfo.tombstones};
+        watermark.capture();
+        watermarks.push_back(std::move(watermark));
+        return true;
+    };
+    for (const std::string& table : reads.tables) {
+        if (auto view = unions_.find(table); view != unions_.end()) {
+            for (const auto& member : view->second->sourceNames) {
+                if (!addSource(member)) return false;
+            }
+        } else if (auto aggregate = aggregates_.find(table); aggregate != aggregates_.end()) {
+            if (!addSource(aggregate->second->tableName)) return false;
+        } else if (!addSource(table)) {
+            return false;  // A table without a watermark
+        }
+    }
+    return true;
+}
+
+QueryResult SQLiteEngine::executeStatement(const std::string& sql, const std::vector<Value>& params) {
+    FLATSQL_TRACE_SCOPE("SQLiteEngine::executeStatement");
     QueryResult result;
+    snapshot_->reset();
 
     // Try fast path for simple queries
     if (tryFastPath(sql, params, result)) {
+        if (queryStats_->current) queryStats_->current->fastPath = true;
         return result;
     }
 
+    sqlite3_stmt* stmt = prepareBound(sql, params, result.columns);
+    int numCols = static_cast<int>(result.columns.size());
+
+    // Fetch rows - optimized to reduce allocations
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        result.rows.emplace_back();
+        std::vector<Value>& row = result.rows.back();
+        row.resize(numCols);
+
+        for (int i = 0; i < numCols; i++) {
+            row[i] = columnValue(stmt, i);
+        }
+    }
+
+    // Don't finalize - statement is cached
+    // sqlite3_reset is called by getOrPrepareStmt on next use
+
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("SQL execution error: " + std::string(sqlite3_errmsg(db_)));
+    }
+
+    return result;
+}
+
+sqlite3_stmt* SQLiteEngine::prepareBound(const std::string& sql, const std::vector<Value>& params,
+                                         std::vector<std::string>& columns) {
     // Use cached prepared statement
     sqlite3_stmt* stmt = getOrPrepareStmt(sql);
 
@@ -315,67 +756,184 @@ QueryResult SQLiteEngine::execute(const std::string& sql, const std::vector<Valu
 
     // Get column names
     int numCols = sqlite3_column_count(stmt);
-    result.columns.reserve(numCols);
+    columns.reserve(numCols);
     for (int i = 0; i < numCols; i++) {
         const char* name = sqlite3_column_name(stmt, i);
-        result.columns.push_back(name ? name : "");
+        columns.push_back(name ? name : "");
     }
+    return stmt;
+}
 
-    // Fetch rows - optimized to reduce allocations
+void SQLiteEngine::execute(const std::string& sql, const std::vector<Value>& params, ArenaQueryResult& out) {
+    RecordedStatement recorded(*queryStats_, sql);
+    out.clear();
+    if (resultCache_) {
+        if (const QueryResult* cached = resultCache_->find(ResultCache::key(sql, params))) {
+            if (QueryStats* stats = recorded.stats()) stats->resultCacheHit = true;
+            out.assign(*cached);
+            recorded.returnedRows(out.rowCount());
+            return;
+        }
+    }
+
+    snapshot_->reset();
+    QueryResult fast;
+    if (tryFastPath(sql, params, fast)) {
+        if (queryStats_->current) queryStats_->current->fastPath = true;
+        out.assign(fast);
+        recorded.returnedRows(out.rowCount());
+        return;
+    }
+
+    sqlite3_stmt* stmt = prepareBound(sql, params, out.columns);
+    int numCols = static_cast<int>(out.columns.size());
     int rc;
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        result.rows.emplace_back();
-        std::vector<Value>& row = result.rows.back();
-        row.resize(numCols);
-
+        ValueView* row = out.addRow();
         for (int i = 0; i < numCols; i++) {
-            int colType = sqlite3_column_type(stmt, i);
-
-            switch (colType) {
-                case SQLITE_NULL:
-                    row[i] = std::monostate{};
-                    break;
-
+            switch (sqlite3_column_type(stmt, i)) {
                 case SQLITE_INTEGER:
                     row[i] = static_cast<int64_t>(sqlite3_column_int64(stmt, i));
                     break;
-
                 case SQLITE_FLOAT:
                     row[i] = sqlite3_column_double(stmt, i);
                     break;
-
                 case SQLITE_TEXT: {
                     const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
-                    int len = sqlite3_column_bytes(stmt, i);
-                    row[i] = std::string(text ? text : "", len);
+                    row[i] = out.copyText(text ? text : "", sqlite3_column_bytes(stmt, i));
                     break;
                 }
-
                 case SQLITE_BLOB: {
                     const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, i));
-                    int len = sqlite3_column_bytes(stmt, i);
-                    row[i] = std::vector<uint8_t>(blob, blob + len);
+                    row[i] = out.copyBytes(blob, sqlite3_column_bytes(stmt, i));
                     break;
                 }
-
                 default:
-                    row[i] = std::monostate{};
-                    break;
+                    break;  // Cells start NULL
             }
         }
     }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("SQL execution error: " + std::string(sqlite3_errmsg(db_)));
+    }
+    recorded.returnedRows(out.rowCount());
+}
 
-    // Don't finalize - statement is cached
-    // sqlite3_reset is called by getOrPrepareStmt on next use
+std::unique_ptr<QueryCursor> SQLiteEngine::openCursor(const std::string& sql,
+                                                     const std::vector<Value>& params) {
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("SQL error: " + std::string(sqlite3_errmsg(db_)));
+    }
+
+    std::unique_ptr<QueryCursor> cursor(new QueryCursor(db_, stmt, snapshot_.get()));
+    for (size_t i = 0; i < params.size(); i++) {
+        bindValue(stmt, static_cast<int>(i + 1), params[i]);
+    }
+    return cursor;
+}
+
+QueryCursor::QueryCursor(sqlite3* db, sqlite3_stmt* stmt, ReadSnapshot* engineSnapshot)
+    : db_(db), stmt_(stmt), engineSnapshot_(engineSnapshot),
+      columnCount_(sqlite3_column_count(stmt)) {}
+
+QueryCursor::~QueryCursor() {
+    sqlite3_finalize(stmt_);
+}
 
+// Virtual machine instructions between cancellation checks in a step
+static constexpr int PROGRESS_INSTRUCTIONS = 1000;
+
+int QueryCursor::progress(void* cursor) {
+    return static_cast<QueryCursor*>(cursor)->cancelled() ? 1 : 0;
+}
+
+bool QueryCursor::step() {
+    if (cancelled()) {
+        done_ = true;
+        throw std::runtime_error("Query cancelled");
+    }
+    if (done_) return false;
+
+    // Swap this statement's pins in for the duration of the step, so
+    // scans it opens later (e.g. inner loops of a join) see the same
+    // snapshot even if other statements ran in between
+    std::swap(engineSnapshot_->pins, pins_.pins);
+    sqlite3_progress_handler(db_, PROGRESS_INSTRUCTIONS, progress, this);
+    int rc = sqlite3_step(stmt_);
+    sqlite3_progress_handler(db_, 0, nullptr, nullptr);
+    std::swap(engineSnapshot_->pins, pins_.pins);
+
+    if (rc == SQLITE_ROW) return true;
+    done_ = true;
+    if (rc == SQLITE_INTERRUPT && cancelled()) {
+        throw std::runtime_error("Query cancelled");
+    }
     if (rc != SQLITE_DONE) {
         throw std::runtime_error("SQL execution error: " + std::string(sqlite3_errmsg(db_)));
     }
+    return false;
+}
+
+void QueryCursor::setColumns(QueryResult& result) const {
+    if (!result.columns.empty()) return;
+    for (int i = 0; i < columnCount_; i++) {
+        result.columns.push_back(columnName(i));
+    }
+}
 
-    return result;
+void QueryCursor::appendRow(QueryResult& result) const {
+    result.rows.emplace_back();
+    std::vector<Value>& row = result.rows.back();
+    row.resize(columnCount_);
+    for (int i = 0; i < columnCount_; i++) {
+        row[i] = columnValue(stmt_, i);
+    }
+}
+
+size_t QueryCursor::fetch(size_t maxRows, QueryResult& result) {
+    setColumns(result);
+    size_t added = 0;
+    while (added < maxRows && step()) {
+        appendRow(result);
+        added++;
+    }
+    return added;
+}
+
+size_t QueryCursor::fetchFor(size_t maxRows, std::chrono::microseconds budget, QueryResult& result) {
+    setColumns(result);
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    size_t added = 0;
+    while (added < maxRows && step()) {
+        appendRow(result);
+        added++;
+        if (std::chrono::steady_clock::now() >= deadline) break;
+    }
+    return added;
+}
+
+const char* QueryCursor::columnName(int col) const {
+    const char* name = sqlite3_column_name(stmt_, col);
+    return name ? name : "";
+}
+
+const char* QueryCursor::getText(int col) const {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, col));
+    return text ? text : "";
+}
+
+const uint8_t* QueryCursor::getBlob(int col) const {
+    return static_cast<const uint8_t*>(sqlite3_column_blob(stmt_, col));
+}
+
+Value QueryCursor::getValue(int col) const {
+    return columnValue(stmt_, col);
 }
 
 size_t SQLiteEngine::executeAndCount(const std::string& sql, const std::vector<Value>& params) {
+    snapshot_->reset();
     // Try fast path for simple queries - bypass VTable entirely
     size_t fastCount = 0;
     if (tryFastPathCount(sql, params, fastCount)) {
@@ -422,26 +980,10 @@ size_t SQLiteEngine::executeAndCount(const std::string& sql, const std::vector<V
 
 static int fastPathCountHits = 0;
 
-// Cache for case-insensitive lookups (table name -> actual source name)
-static thread_local std::unordered_map<std::string, SourceInfo*> sourceNameCache_;
-
-// Cache for parsed SQL queries
-struct ParsedQuery {
-    std::string tableName;
-    std::string columnName;
-    bool isPointQuery;
-    bool isFullScan;
-};
-static thread_local std::unordered_map<std::string, ParsedQuery> parsedQueryCache_;
-
-// Cache for column names (avoids rebuilding for each query)
-static thread_local std::unordered_map<std::string, std::vector<std::string>> columnNamesCache_;
-
 // Helper to get cached column names for a source
-static const std::vector<std::string>& getCachedColumnNames(const SourceInfo* source) {
-    auto it = columnNamesCache_.find(source->name);
-    if (it != columnNamesCache_.end()) {
-        return it->second;
+const std::vector<std::string>& SQLiteEngine::getCachedColumnNames(const SourceInfo* source) {
+    if (const std::vector<std::string>* cached = columnNamesCache_.find(source->name)) {
+        return *cached;
     }
 
     std::vector<std::string> cols;
@@ -454,16 +996,23 @@ static const std::vector<std::string>& getCachedColumnNames(const SourceInfo* so
     cols.push_back("_offset");
     cols.push_back("_data");
 
-    columnNamesCache_[source->name] = std::move(cols);
-    return columnNamesCache_[source->name];
+    return columnNamesCache_.insert(source->name, std::move(cols));
 }
 
 // Helper to find source with case-insensitive matching (with caching)
 SourceInfo* SQLiteEngine::findSourceCaseInsensitive(const std::string& lowerTableName) {
     // Check cache first
-    auto cacheIt = sourceNameCache_.find(lowerTableName);
-    if (cacheIt != sourceNameCache_.end()) {
-        return cacheIt->second;
+    if (SourceInfo** cached = sourceNameCache_.find(lowerTableName)) {
+        return *cached;
+    }
+    // A unified view shadows the base table of the same name
+    for (const auto& [name, info] : unions_) {
+        std::string lowerName = name;
+        for (char& c : lowerName) c = std::tolower(c);
+        if (lowerName == lowerTableName) {
+            sourceNameCache_.insert(lowerTableName, nullptr);
+            return nullptr;
+        }
     }
     // Try exact match first
     auto it = sources_.find(lowerTableName);
@@ -477,87 +1026,171 @@ SourceInfo* SQLiteEngine::findSourceCaseInsensitive(const std::string& lowerTabl
         for (char& c : lowerName) c = std::tolower(c);
         if (lowerName == lowerTableName) {
             // Cache the result
-            sourceNameCache_[lowerTableName] = src.get();
+            sourceNameCache_.insert(lowerTableName, src.get());
             return src.get();
         }
     }
-    sourceNameCache_[lowerTableName] = nullptr;
+    sourceNameCache_.insert(lowerTableName, nullptr);
     return nullptr;
 }
 
-bool SQLiteEngine::tryFastPathCount(const std::string& sql, const std::vector<Value>& params, size_t& count) {
-    // Check cache first
-    auto cacheIt = parsedQueryCache_.find(sql);
-    ParsedQuery* parsed = nullptr;
+// First entry for key that is visible and not deleted. When the key was
+// deleted and ingested again (an upsert table replacing its version), the
+// first entry is a tombstoned one, so the newest live entry is taken.
+static bool searchLive(const Index* index, const Value& key, uint64_t visible,
+                       const DeletionBitmap* tombstones, IndexEntry& entry) {
+    if (!index->searchFirst(key, entry) || entry.sequence > visible) return false;
+    if (tombstones->empty() || !tombstones->contains(entry.sequence)) return true;
+    bool found = false;
+    for (IndexEntry& candidate : index->search(key)) {
+        if (candidate.sequence > visible || tombstones->contains(candidate.sequence)) continue;
+        if (!found || candidate.sequence > entry.sequence) entry = std::move(candidate);
+        found = true;
+    }
+    return found;
+}
 
-    if (cacheIt != parsedQueryCache_.end()) {
-        parsed = &cacheIt->second;
-    } else {
-        // Parse and cache the query
-        std::string normalized = normalizeSQL(sql);
+bool SQLiteEngine::searchVisible(const SourceInfo* source, Index* index, const Value& key,
+                                 IndexEntry& entry) {
+    return searchLive(index, key, snapshot_->pin(source->store), source->vtabInfo.tombstones, entry);
+}
+
+// Read a bare or double-quoted identifier of normalized SQL at pos
+static bool readIdentifier(const std::string& sql, size_t& pos, std::string& name) {
+    if (pos < sql.size() && sql[pos] == '"') {
+        size_t end = sql.find('"', pos + 1);
+        if (end == std::string::npos || end == pos + 1) return false;
+        name = sql.substr(pos + 1, end - pos - 1);
+        pos = end + 1;
+        return true;
+    }
+    size_t start = pos;
+    while (pos < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[pos])) || sql[pos] == '_')) {
+        pos++;
+    }
+    name = sql.substr(start, pos - start);
+    return pos > start;
+}
+
+// Skip text if normalized SQL has it at pos
+static bool skipText(const std::string& sql, size_t& pos, const char* text) {
+    size_t length = std::strlen(text);
+    if (sql.compare(pos, length, text) != 0) return false;
+    pos += length;
+    return true;
+}
 
-        // Check for "select * from"
-        if (normalized.size() < 14 || normalized.substr(0, 14) != "select * from ") {
-            parsedQueryCache_[sql] = {.tableName = "", .columnName = "", .isPointQuery = false, .isFullScan = false};
+bool SQLiteEngine::parseAggregate(const std::string& sql, const std::string& normalized, ParsedQuery& pq) {
+    size_t pos = 0;
+    if (!skipText(normalized, pos, "select ")) return false;
+    if (skipText(normalized, pos, "count(*)")) {
+        pq.aggregate = PushedAggregate::Count;
+    } else if (skipText(normalized, pos, "min(") || skipText(normalized, pos, "max(")) {
+        pq.aggregate = normalized[pos - 3] == 'i' ? PushedAggregate::Min : PushedAggregate::Max;
+        if (!readIdentifier(normalized, pos, pq.columnName) || !skipText(normalized, pos, ")")) return false;
+    } else {
+        return false;
+    }
+    if (!skipText(normalized, pos, " from ") || !readIdentifier(normalized, pos, pq.tableName)) return false;
+    if (pq.aggregate == PushedAggregate::Count && skipText(normalized, pos, " where ")) {
+        if (!readIdentifier(normalized, pos, pq.columnName)) return false;
+        if (skipText(normalized, pos, " = ?")) {
+            pq.aggregate = PushedAggregate::CountEqual;
+        } else if (skipText(normalized, pos, " between ? and ?")) {
+            pq.aggregate = PushedAggregate::CountBetween;
+        } else {
             return false;
         }
+    }
+    if (!skipText(normalized, pos, " ;")) skipText(normalized, pos, ";");
+    if (pos != normalized.size()) return false;
+
+    // SQLite names the column after the expression as written
+    size_t start = 0;
+    while (std::isspace(static_cast<unsigned char>(sql[start]))) start++;
+    start += 6;  // select
+    while (std::isspace(static_cast<unsigned char>(sql[start]))) start++;
+    pq.resultColumn = sql.substr(start, sql.find(')', start) + 1 - start);
+    return true;
+}
 
-        size_t wherePos = normalized.find(" where ", 14);
-        ParsedQuery pq;
-        pq.isFullScan = (wherePos == std::string::npos);
-        pq.isPointQuery = !pq.isFullScan;
+const SQLiteEngine::ParsedQuery& SQLiteEngine::parseFastPathQuery(const std::string& sql) {
+    if (const ParsedQuery* parsed = parsedQueryCache_.find(sql)) {
+        return *parsed;
+    }
 
-        if (pq.isFullScan) {
-            pq.tableName = normalized.substr(14);
-            while (!pq.tableName.empty() && (pq.tableName.back() == ' ' || pq.tableName.back() == ';')) {
-                pq.tableName.pop_back();
-            }
-            if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
-                pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
-            }
-        } else {
-            pq.tableName = normalized.substr(14, wherePos - 14);
-            if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
-                pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
-            }
+    // Parse and cache the query
+    std::string normalized = normalizeSQL(sql);
+    ParsedQuery aggregate{.tableName = "", .columnName = "", .isPointQuery = false, .isFullScan = false};
+    if (parseAggregate(sql, normalized, aggregate)) {
+        return parsedQueryCache_.insert(sql, std::move(aggregate));
+    }
+
+    // Check for "select * from"
+    if (normalized.size() < 14 || normalized.substr(0, 14) != "select * from ") {
+        return parsedQueryCache_.insert(sql, {.tableName = "", .columnName = "", .isPointQuery = false, .isFullScan = false});
+    }
+
+    size_t wherePos = normalized.find(" where ", 14);
+    ParsedQuery pq;
+    pq.isFullScan = (wherePos == std::string::npos);
+    pq.isPointQuery = !pq.isFullScan;
+
+    if (pq.isFullScan) {
+        pq.tableName = normalized.substr(14);
+        while (!pq.tableName.empty() && (pq.tableName.back() == ' ' || pq.tableName.back() == ';')) {
+            pq.tableName.pop_back();
+        }
+        if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
+            pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
+        }
+    } else {
+        pq.tableName = normalized.substr(14, wherePos - 14);
+        if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
+            pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
+        }
 
-            // Parse column name
-            std::string whereClause = normalized.substr(wherePos + 7);
-            size_t eqPos = whereClause.find(" = ?");
-            if (eqPos == std::string::npos) {
-                eqPos = whereClause.find("= ?");
+        // Parse column name
+        std::string whereClause = normalized.substr(wherePos + 7);
+        size_t eqPos = whereClause.find(" = ?");
+        if (eqPos == std::string::npos) {
+            eqPos = whereClause.find("= ?");
+        }
+        if (eqPos != std::string::npos) {
+            pq.columnName = whereClause.substr(0, eqPos);
+            while (!pq.columnName.empty() && pq.columnName.back() == ' ') {
+                pq.columnName.pop_back();
             }
-            if (eqPos != std::string::npos) {
-                pq.columnName = whereClause.substr(0, eqPos);
-                while (!pq.columnName.empty() && pq.columnName.back() == ' ') {
-                    pq.columnName.pop_back();
-                }
-                if (pq.columnName.size() >= 2 && pq.columnName.front() == '"' && pq.columnName.back() == '"') {
-                    pq.columnName = pq.columnName.substr(1, pq.columnName.size() - 2);
-                }
-            } else {
-                pq.isPointQuery = false;
+            if (pq.columnName.size() >= 2 && pq.columnName.front() == '"' && pq.columnName.back() == '"') {
+                pq.columnName = pq.columnName.substr(1, pq.columnName.size() - 2);
             }
+        } else {
+            pq.isPointQuery = false;
         }
-
-        parsedQueryCache_[sql] = pq;
-        parsed = &parsedQueryCache_[sql];
     }
 
+    return parsedQueryCache_.insert(sql, std::move(pq));
+}
+
+bool SQLiteEngine::tryFastPathCount(const std::string& sql, const std::vector<Value>& params, size_t& count) {
+    const ParsedQuery* parsed = &parseFastPathQuery(sql);
+
     // Fast path: full scan
     if (parsed->isFullScan && params.empty()) {
         auto* source = findSourceCaseInsensitive(parsed->tableName);
         if (source && source->store && source->tableDef) {
             const auto* recordInfos = source->store->getRecordInfoVector(source->fileId);
             if (recordInfos) {
-                const auto* tombstones = &source->tombstones;
+                const auto* tombstones = source->vtabInfo.tombstones;
+                size_t visible = StreamingFlatBufferStore::visibleCount(
+                    *recordInfos, snapshot_->pin(source->store));
                 if (tombstones->empty()) {
                     // Fast path: no tombstones
-                    count = recordInfos->size();
+                    count = visible;
                 } else {
                     count = 0;
-                    for (const auto& info : *recordInfos) {
-                        if (!tombstones->count(info.sequence)) {
+                    for (size_t i = 0; i < visible; i++) {
+                        if (!tombstones->contains((*recordInfos)[i].sequence)) {
                             count++;
                         }
                     }
@@ -580,21 +1213,157 @@ bool SQLiteEngine::tryFastPathCount(const std::string& sql, const std::vector<Va
         }
 
         IndexEntry entry;
-        if (!indexIt->second->searchFirst(params[0], entry)) {
-            count = 0;
-            return true;
+        count = searchVisible(source, indexIt->second, params[0], entry) ? 1 : 0;
+        return true;
+    }
+
+    return false;
+}
+
+// Whether reads of the source's records must go through the virtual
+// table, which verifies each before reading its fields
+static bool verifiedOnRead(const SourceInfo* source) {
+    return source->vtabInfo.verification &&
+           source->vtabInfo.verification->getMode() == VerificationMode::Lazy;
+}
+
+// Whether SQLite orders a column's values as its index orders the keys;
+// xColumn narrows 32-bit unsigned values and reports bools as integers
+static bool ordersLikeIndex(const ColumnDef& column) {
+    switch (column.type) {
+        case ValueType::Null:
+        case ValueType::Bool:
+        case ValueType::UInt32:
+        case ValueType::UInt64:
+            return false;
+        default:
+            return !column.encrypted;
+    }
+}
+
+// Whether a parameter compares with a column's keys as SQLite compares it
+// with the column (NULL matches nothing, which is handled by the caller)
+static bool comparableKey(const Value& value, ValueType type) {
+    switch (type) {
+        case ValueType::String: return std::holds_alternative<std::string>(value);
+        case ValueType::Bytes:  return std::holds_alternative<std::vector<uint8_t>>(value);
+        default:
+            return !std::holds_alternative<bool>(value) && value.index() > 0 &&
+                   value.index() < static_cast<size_t>(ValueType::String);
+    }
+}
+
+// A record's column value as SQLite would hold it after xColumn
+static Value sqlValue(const Value& value) {
+    return std::visit([](const auto& v) -> Value {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, float>) {
+            return static_cast<double>(v);
+        } else if constexpr (std::is_integral_v<T>) {
+            return static_cast<int64_t>(v);
+        } else {
+            return v;
         }
+    }, value);
+}
 
-        if (!source->tombstones.empty() && source->tombstones.count(entry.sequence)) {
-            count = 0;
-            return true;
+bool SQLiteEngine::tryAggregatePushdown(const ParsedQuery& parsed, const std::vector<Value>& params,
+                                        QueryResult& result) {
+    size_t parameters = parsed.aggregate == PushedAggregate::CountEqual ? 1
+                      : parsed.aggregate == PushedAggregate::CountBetween ? 2 : 0;
+    if (params.size() != parameters) {
+        return false;
+    }
+    SourceInfo* source = findSourceCaseInsensitive(parsed.tableName);
+    if (!source || !source->store || !source->tableDef) {
+        return false;
+    }
+    const uint64_t visible = snapshot_->pin(source->store);
+    const DeletionBitmap* tombstones = source->vtabInfo.tombstones;
+    auto live = [&](uint64_t sequence) {
+        return sequence <= visible && (tombstones->empty() || !tombstones->contains(sequence));
+    };
+
+    if (parsed.aggregate == PushedAggregate::Count) {
+        // Visible records, less the expired prefix and the marked ones in the list
+        const auto* infos = source->sourceRecordInfos ? source->sourceRecordInfos
+                                                      : source->store->getRecordInfoVector(source->fileId);
+        size_t count = 0;
+        if (infos) {
+            using Store = StreamingFlatBufferStore;
+            uint64_t expired = std::min(tombstones->expiredThrough(), visible);
+            count = Store::visibleCount(*infos, visible) - Store::visibleCount(*infos, expired);
+            tombstones->forEach([&](uint64_t sequence) {
+                if (sequence > expired && sequence <= visible &&
+                    Store::visibleCount(*infos, sequence) != Store::visibleCount(*infos, sequence - 1)) {
+                    count--;
+                }
+            });
         }
+        result.columns = {parsed.resultColumn};
+        result.rows.push_back({Value(static_cast<int64_t>(count))});
+        return true;
+    }
 
-        count = 1;
+    const ColumnDef* column = nullptr;
+    for (const ColumnDef& candidate : source->tableDef->columns) {
+        std::string lowerName = candidate.name;
+        for (char& c : lowerName) c = std::tolower(c);
+        if (lowerName == parsed.columnName) {
+            column = &candidate;
+            break;
+        }
+    }
+    if (!column || !ordersLikeIndex(*column)) {
+        return false;
+    }
+    auto indexIt = source->indexes.find(column->name);
+    if (indexIt == source->indexes.end() || !indexIt->second) {
+        return false;
+    }
+    const Index* index = indexIt->second;
+
+    if (parsed.aggregate == PushedAggregate::Min || parsed.aggregate == PushedAggregate::Max) {
+        // NULLs are not indexed, so the first live entry at that end holds the answer
+        if (!source->extractor || verifiedOnRead(source)) {
+            return false;
+        }
+        Value extreme;
+        auto cursor = index->openRange(Value(), Value(), parsed.aggregate == PushedAggregate::Max);
+        IndexEntry entry;
+        while (cursor->next(entry)) {
+            if (!live(entry.sequence)) continue;
+            uint32_t length = 0;
+            const uint8_t* data = source->store->getVisibleDataAtOffset(entry.dataOffset, &length);
+            if (!data) return false;
+            extreme = sqlValue(source->extractor(data, length, column->name));
+            if (!std::holds_alternative<std::monostate>(extreme)) break;
+        }
+        result.columns = {parsed.resultColumn};
+        result.rows.push_back({std::move(extreme)});
         return true;
     }
 
-    return false;
+    // Filtered count: the live entries of the key range, no record read
+    bool matchable = true;
+    for (const Value& param : params) {
+        if (std::holds_alternative<std::monostate>(param)) {
+            matchable = false;
+        } else if (!comparableKey(param, column->type)) {
+            return false;
+        }
+    }
+    size_t count = 0;
+    if (matchable) {
+        auto cursor = index->openRange(params.front(), params.back(), false);
+        IndexEntry entry;
+        while (cursor->next(entry)) {
+            if (live(entry.sequence)) count++;
+        }
+    }
+    result.columns = {parsed.resultColumn};
+    result.rows.push_back({Value(static_cast<int64_t>(count))});
+    return true;
 }
 
 void SQLiteEngine::markDeleted(const std::string& sourceName, uint64_t sequence) {
@@ -602,7 +1371,18 @@ void SQLiteEngine::markDeleted(const std::string& sourceName, uint64_t sequence)
     if (it == sources_.end()) {
         throw std::runtime_error("Source not found: " + sourceName);
     }
-    it->second->tombstones.insert(sequence);
+    it->second->vtabInfo.tombstones->insert(sequence);
+}
+
+void SQLiteEngine::markDeleted(const std::string& sourceName, const std::vector<uint64_t>& sequences) {
+    auto it = sources_.find(sourceName);
+    if (it == sources_.end()) {
+        throw std::runtime_error("Source not found: " + sourceName);
+    }
+    DeletionBitmap& tombstones = *it->second->vtabInfo.tombstones;
+    for (uint64_t sequence : sequences) {
+        tombstones.insert(sequence);
+    }
 }
 
 size_t SQLiteEngine::getDeletedCount(const std::string& sourceName) const {
@@ -610,16 +1390,21 @@ size_t SQLiteEngine::getDeletedCount(const std::string& sourceName) const {
     if (it == sources_.end()) {
         return 0;
     }
-    return it->second->tombstones.size();
+    return it->second->vtabInfo.tombstones->size();
 }
 
 void SQLiteEngine::clearTombstones(const std::string& sourceName) {
     auto it = sources_.find(sourceName);
     if (it != sources_.end()) {
-        it->second->tombstones.clear();
+        it->second->vtabInfo.tombstones->clear();
     }
 }
 
+DeletionBitmap* SQLiteEngine::getTombstones(const std::string& sourceName) {
+    auto it = sources_.find(sourceName);
+    return it != sources_.end() ? it->second->vtabInfo.tombstones : nullptr;
+}
+
 std::vector<std::string> SQLiteEngine::listSources() const {
     std::vector<std::string> names;
     names.reserve(sources_.size());
@@ -650,78 +1435,27 @@ const SourceInfo* SQLiteEngine::getSource(const std::string& sourceName) const {
     return it != sources_.end() ? it->second.get() : nullptr;
 }
 
-static int fastPathHits = 0;
-static int fastPathFullScanHits = 0;
+static std::atomic<int> fastPathHits{0};
+static std::atomic<int> fastPathFullScanHits{0};
 
 // Debug counters exposed for testing
 int getFastPathHits() { return fastPathHits; }
 int getFastPathFullScanHits() { return fastPathFullScanHits; }
 
 bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>& params, QueryResult& result) {
-    // Check cache first
-    auto cacheIt = parsedQueryCache_.find(sql);
-    ParsedQuery* parsed = nullptr;
-
-    if (cacheIt != parsedQueryCache_.end()) {
-        parsed = &cacheIt->second;
-        // Early exit for non-optimizable queries
-        if (!parsed->isPointQuery && !parsed->isFullScan) {
-            return false;
-        }
-    } else {
-        // Parse and cache the query (same logic as tryFastPathCount)
-        std::string normalized = normalizeSQL(sql);
-
-        if (normalized.size() < 14 || normalized.substr(0, 14) != "select * from ") {
-            parsedQueryCache_[sql] = {.tableName = "", .columnName = "", .isPointQuery = false, .isFullScan = false};
-            return false;
-        }
-
-        size_t wherePos = normalized.find(" where ", 14);
-        ParsedQuery pq;
-        pq.isFullScan = (wherePos == std::string::npos);
-        pq.isPointQuery = !pq.isFullScan;
-
-        if (pq.isFullScan) {
-            pq.tableName = normalized.substr(14);
-            while (!pq.tableName.empty() && (pq.tableName.back() == ' ' || pq.tableName.back() == ';')) {
-                pq.tableName.pop_back();
-            }
-            if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
-                pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
-            }
-        } else {
-            pq.tableName = normalized.substr(14, wherePos - 14);
-            if (pq.tableName.size() >= 2 && pq.tableName.front() == '"' && pq.tableName.back() == '"') {
-                pq.tableName = pq.tableName.substr(1, pq.tableName.size() - 2);
-            }
-
-            std::string whereClause = normalized.substr(wherePos + 7);
-            size_t eqPos = whereClause.find(" = ?");
-            if (eqPos == std::string::npos) {
-                eqPos = whereClause.find("= ?");
-            }
-            if (eqPos != std::string::npos) {
-                pq.columnName = whereClause.substr(0, eqPos);
-                while (!pq.columnName.empty() && pq.columnName.back() == ' ') {
-                    pq.columnName.pop_back();
-                }
-                if (pq.columnName.size() >= 2 && pq.columnName.front() == '"' && pq.columnName.back() == '"') {
-                    pq.columnName = pq.columnName.substr(1, pq.columnName.size() - 2);
-                }
-            } else {
-                pq.isPointQuery = false;
-            }
-        }
-
-        parsedQueryCache_[sql] = pq;
-        parsed = &parsedQueryCache_[sql];
+    const ParsedQuery* parsed = &parseFastPathQuery(sql);
+    if (parsed->aggregate != PushedAggregate::None) {
+        return tryAggregatePushdown(*parsed, params, result);
+    }
+    // Early exit for non-optimizable queries
+    if (!parsed->isPointQuery && !parsed->isFullScan) {
+        return false;
     }
 
     // Full scan fast path
     if (parsed->isFullScan && params.empty()) {
         auto* source = findSourceCaseInsensitive(parsed->tableName);
-        if (source && source->store && source->tableDef && source->extractor) {
+        if (source && source->store && source->tableDef && source->extractor && !verifiedOnRead(source)) {
             fastPathFullScanHits++;
 
             // Build column names
@@ -735,18 +1469,21 @@ bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>&
 
             const auto* recordInfos = source->store->getRecordInfoVector(source->fileId);
             if (recordInfos) {
-                const uint8_t* dataBuffer = source->store->getDataBuffer();
-                const auto* tombstones = &source->tombstones;
-                result.rows.reserve(recordInfos->size());
+                const auto* store = source->store;
+                const auto* tombstones = source->vtabInfo.tombstones;
+                size_t visible = StreamingFlatBufferStore::visibleCount(
+                    *recordInfos, snapshot_->pin(store));
+                result.rows.reserve(visible);
 
                 // Use batch extractor if available
                 if (source->batchExtractor) {
-                    for (const auto& info : *recordInfos) {
-                        if (!tombstones->empty() && tombstones->count(info.sequence)) {
+                    for (size_t i = 0; i < visible; i++) {
+                        const auto& info = (*recordInfos)[i];
+                        if (!tombstones->empty() && tombstones->contains(info.sequence)) {
                             continue;
                         }
 
-                        const uint8_t* ptr = dataBuffer + info.offset;
+                        const uint8_t* ptr = store->recordAt(info.offset);
                         uint32_t len = static_cast<uint32_t>(ptr[0]) |
                                        (static_cast<uint32_t>(ptr[1]) << 8) |
                                        (static_cast<uint32_t>(ptr[2]) << 16) |
@@ -765,12 +1502,13 @@ bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>&
                         result.rows.push_back(std::move(row));
                     }
                 } else {
-                    for (const auto& info : *recordInfos) {
-                        if (!tombstones->empty() && tombstones->count(info.sequence)) {
+                    for (size_t i = 0; i < visible; i++) {
+                        const auto& info = (*recordInfos)[i];
+                        if (!tombstones->empty() && tombstones->contains(info.sequence)) {
                             continue;
                         }
 
-                        const uint8_t* ptr = dataBuffer + info.offset;
+                        const uint8_t* ptr = store->recordAt(info.offset);
                         uint32_t len = static_cast<uint32_t>(ptr[0]) |
                                        (static_cast<uint32_t>(ptr[1]) << 8) |
                                        (static_cast<uint32_t>(ptr[2]) << 16) |
@@ -803,7 +1541,7 @@ bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>&
     }
 
     auto* source = findSourceCaseInsensitive(parsed->tableName);
-    if (!source || !source->store || !source->tableDef) {
+    if (!source || !source->store || !source->tableDef || verifiedOnRead(source)) {
         return false;
     }
 
@@ -814,27 +1552,20 @@ bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>&
 
     fastPathHits++;
 
-    SqliteIndex* index = indexIt->second;
+    Index* index = indexIt->second;
     const Value& searchValue = params[0];
 
     // Do the lookup first - avoid work if no match
     IndexEntry entry;
-    if (!index->searchFirst(searchValue, entry)) {
+    if (!searchVisible(source, index, searchValue, entry)) {
         // No match found - return empty result with cached column names (avoid copy with move)
         result.columns = getCachedColumnNames(source);
         return true;
     }
 
-    // Check tombstone only if there are any
-    if (!source->tombstones.empty() && source->tombstones.count(entry.sequence)) {
-        // Tombstoned - return empty result
-        result.columns = getCachedColumnNames(source);
-        return true;
-    }
-
     // Get the data
     uint32_t dataLen = 0;
-    const uint8_t* data = source->store->getDataAtOffset(entry.dataOffset, &dataLen);
+    const uint8_t* data = source->store->getVisibleDataAtOffset(entry.dataOffset, &dataLen);
     if (!data) {
         return false;  // Error, fall back to VTable
     }
@@ -872,6 +1603,7 @@ bool SQLiteEngine::tryFastPath(const std::string& sql, const std::vector<Value>&
 bool SQLiteEngine::tryFastPathMinimal(const std::string& sql, const std::vector<Value>& params,
                                        const uint8_t** outData, uint32_t* outLen,
                                        uint64_t* outSequence) {
+    snapshot_->reset();
     // Only intercept simple point queries with one parameter
     if (params.size() != 1) {
         return false;
@@ -933,25 +1665,35 @@ bool SQLiteEngine::tryFastPathMinimal(const std::string& sql, const std::vector<
         return false;  // No index, fall back to VTable
     }
 
-    SqliteIndex* index = indexIt->second;
-    const Value& searchValue = params[0];
-
-    // Check tombstones set
-    const auto* tombstones = &source->tombstones;
+    return PreparedLookup(source, indexIt->second).find(params[0], outData, outLen, outSequence);
+}
 
-    // Do the lookup
-    IndexEntry entry;
-    if (!index->searchFirst(searchValue, entry)) {
-        return false;  // No match
+PreparedLookup SQLiteEngine::prepareLookup(const std::string& sourceName,
+                                           const std::string& columnName) const {
+    const SourceInfo* source = getSource(sourceName);
+    if (!source || !source->store) {
+        throw std::runtime_error("Source not found: " + sourceName);
+    }
+    auto indexIt = source->indexes.find(columnName);
+    if (indexIt == source->indexes.end() || !indexIt->second) {
+        throw std::runtime_error("No index on " + sourceName + "." + columnName);
     }
+    return PreparedLookup(source, indexIt->second);
+}
+
+uint64_t PreparedLookup::visibleSequence() const {
+    uint64_t visible = source_->store->getVisibleSequence();
+    return source_->vtabInfo.snapshot ? source_->vtabInfo.snapshot->cap(visible) : visible;
+}
 
-    // Check tombstone
-    if (!tombstones->empty() && tombstones->count(entry.sequence)) {
-        return false;  // Tombstoned
+bool PreparedLookup::find(const Value& key, const uint8_t** outData, uint32_t* outLen,
+                          uint64_t* outSequence) const {
+    IndexEntry entry;
+    if (!searchLive(index_, key, visibleSequence(), source_->vtabInfo.tombstones, entry)) {
+        return false;
     }
 
-    // Get the data
-    const uint8_t* data = source->store->getDataAtOffset(entry.dataOffset, outLen);
+    const uint8_t* data = source_->store->getVisibleDataAtOffset(entry.dataOffset, outLen);
     if (!data) {
         return false;
     }
@@ -963,4 +1705,16 @@ bool SQLiteEngine::tryFastPathMinimal(const std::string& sql, const std::vector<
     return true;
 }
 
+std::vector<IndexEntry> PreparedLookup::findMany(std::vector<Value> keys) const {
+    std::vector<IndexEntry> entries = index_->searchMany(std::move(keys));
+    const uint64_t visible = visibleSequence();
+    const auto* tombstones = source_->vtabInfo.tombstones;
+    bool checkTombstones = !tombstones->empty();
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const IndexEntry& entry) {
+        return entry.sequence > visible ||
+               (checkTombstones && tombstones->contains(entry.sequence));
+    }), entries.end());
+    return entries;
+}
+
 }  // namespace flatsql
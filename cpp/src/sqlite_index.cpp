@@ -1,13 +1,37 @@
 #include "flatsql/sqlite_index.h"
+#include "flatsql/trace.h"
 #include <stdexcept>
 #include <cstring>
 #include <algorithm>
 
 namespace flatsql {
 
-// Helper to convert Value to int64 for comparison (optimized with get_if)
+// Holds the connection's mutex (recursive; null when SQLite is built
+// single-threaded) so concurrent lookups don't interleave on shared statements
+class ConnectionLock {
+public:
+    explicit ConnectionLock(sqlite3* db) : mutex_(sqlite3_db_mutex(db)) { sqlite3_mutex_enter(mutex_); }
+    ~ConnectionLock() { sqlite3_mutex_leave(mutex_); }
+    ConnectionLock(const ConnectionLock&) = delete;
+    ConnectionLock& operator=(const ConnectionLock&) = delete;
+
+private:
+    sqlite3_mutex* mutex_;
+};
+
+// Rows per multi-row INSERT in bulkLoad (4 parameters each, well under SQLITE_MAX_VARIABLE_NUMBER)
+static constexpr int BULK_INSERT_ROWS = 64;
+
+// Keys bound per searchMany statement
+static constexpr int SEARCH_MANY_KEYS = 256;
+
+// Bytes an entry takes in the index pages, for pageBytes() without dbstat
+static constexpr size_t ESTIMATED_PAGE_ENTRY_BYTES = 48;
+
+// Helper to convert a Value (or ValueView) to int64 for comparison
 // Order by frequency: int32_t most common in FlatBuffers, then int64_t
-static bool tryGetInt64(const Value& v, int64_t& out) {
+template <typename V>
+static bool tryGetInt64(const V& v, int64_t& out) {
     // Fast path for common types using get_if (faster than visit)
     if (auto* p = std::get_if<int32_t>(&v)) { out = *p; return true; }  // Most common
     if (auto* p = std::get_if<int64_t>(&v)) { out = *p; return true; }
@@ -20,8 +44,9 @@ static bool tryGetInt64(const Value& v, int64_t& out) {
     return false;
 }
 
-// Helper to convert Value to double for comparison
-static bool tryGetDouble(const Value& v, double& out) {
+// Helper to convert a Value (or ValueView) to double for comparison
+template <typename V>
+static bool tryGetDouble(const V& v, double& out) {
     return std::visit([&out](const auto& val) -> bool {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
@@ -38,8 +63,19 @@ static bool tryGetDouble(const Value& v, double& out) {
     }, v);
 }
 
-// Compare two Values with numeric type coercion
-int compareValues(const Value& a, const Value& b) {
+// String and byte alternatives of Value and ValueView, as views
+static std::string_view textOf(const std::string& s) { return s; }
+static std::string_view textOf(std::string_view s) { return s; }
+static BytesView bytesOf(const std::vector<uint8_t>& b) { return {b.data(), b.size()}; }
+static BytesView bytesOf(BytesView b) { return b; }
+
+// Both variants list the same alternatives in the same order
+static constexpr size_t STRING_ALTERNATIVE = static_cast<size_t>(ValueType::String);
+static constexpr size_t BYTES_ALTERNATIVE = static_cast<size_t>(ValueType::Bytes);
+
+// Compare two Values or ValueViews with numeric type coercion
+template <typename V>
+static int compareAlike(const V& a, const V& b) {
     // Handle null comparisons
     if (std::holds_alternative<std::monostate>(a)) {
         return std::holds_alternative<std::monostate>(b) ? 0 : -1;
@@ -65,21 +101,20 @@ int compareValues(const Value& a, const Value& b) {
     }
 
     // String comparison
-    if (std::holds_alternative<std::string>(a) && std::holds_alternative<std::string>(b)) {
-        return std::get<std::string>(a).compare(std::get<std::string>(b));
+    if (a.index() == STRING_ALTERNATIVE && b.index() == STRING_ALTERNATIVE) {
+        int c = textOf(std::get<STRING_ALTERNATIVE>(a)).compare(textOf(std::get<STRING_ALTERNATIVE>(b)));
+        return c < 0 ? -1 : (c > 0 ? 1 : 0);
     }
 
     // Blob comparison
-    if (std::holds_alternative<std::vector<uint8_t>>(a) && std::holds_alternative<std::vector<uint8_t>>(b)) {
-        const auto& aVec = std::get<std::vector<uint8_t>>(a);
-        const auto& bVec = std::get<std::vector<uint8_t>>(b);
-        size_t minLen = std::min(aVec.size(), bVec.size());
-        for (size_t i = 0; i < minLen; i++) {
-            if (aVec[i] < bVec[i]) return -1;
-            if (aVec[i] > bVec[i]) return 1;
-        }
-        if (aVec.size() < bVec.size()) return -1;
-        if (aVec.size() > bVec.size()) return 1;
+    if (a.index() == BYTES_ALTERNATIVE && b.index() == BYTES_ALTERNATIVE) {
+        BytesView aBytes = bytesOf(std::get<BYTES_ALTERNATIVE>(a));
+        BytesView bBytes = bytesOf(std::get<BYTES_ALTERNATIVE>(b));
+        size_t minLen = std::min(aBytes.size, bBytes.size);
+        int c = minLen ? std::memcmp(aBytes.data, bBytes.data, minLen) : 0;
+        if (c != 0) return c < 0 ? -1 : 1;
+        if (aBytes.size < bBytes.size) return -1;
+        if (aBytes.size > bBytes.size) return 1;
         return 0;
     }
 
@@ -94,19 +129,131 @@ int compareValues(const Value& a, const Value& b) {
     return a.index() < b.index() ? -1 : 1;
 }
 
+int compareValues(const Value& a, const Value& b) {
+    return compareAlike(a, b);
+}
+
+int compareValueViews(const ValueView& a, const ValueView& b) {
+    return compareAlike(a, b);
+}
+
+ValueView viewOf(const Value& value) {
+    return std::visit([](const auto& v) -> ValueView {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return std::string_view(v);
+        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            return BytesView{v.data(), v.size()};
+        } else {
+            return v;
+        }
+    }, value);
+}
+
+Value toValue(const ValueView& view) {
+    Value value;
+    assignValue(value, view);
+    return value;
+}
+
+void assignValue(Value& out, const ValueView& view) {
+    std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string_view>) {
+            if (auto* s = std::get_if<std::string>(&out)) {
+                s->assign(v.data(), v.size());
+            } else {
+                out = std::string(v);
+            }
+        } else if constexpr (std::is_same_v<T, BytesView>) {
+            if (auto* b = std::get_if<std::vector<uint8_t>>(&out)) {
+                b->assign(v.data, v.data + v.size);
+            } else {
+                out = std::vector<uint8_t>(v.data, v.data + v.size);
+            }
+        } else {
+            out = v;
+        }
+    }, view);
+}
+
+// Bind a key of the index's own type T directly, converting it as
+// bindIndexKey would; other alternatives go through bindIndexKey
+template <typename T>
+static void bindTypedKey(sqlite3_stmt* stmt, int param, const Value& key) {
+    const T* v = std::get_if<T>(&key);
+    if (!v) {
+        bindIndexKey(stmt, param, key);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        sqlite3_bind_text(stmt, param, v->data(), static_cast<int>(v->size()), SQLITE_TRANSIENT);
+    } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+        sqlite3_bind_blob(stmt, param, v->data(), static_cast<int>(v->size()), SQLITE_TRANSIENT);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        sqlite3_bind_double(stmt, param, static_cast<double>(*v));
+    } else if constexpr (sizeof(T) == sizeof(int64_t)) {
+        sqlite3_bind_int64(stmt, param, static_cast<int64_t>(*v));
+    } else {
+        sqlite3_bind_int(stmt, param, static_cast<int>(*v));
+    }
+}
+
+// Read a key column stored for key type T
+template <typename T>
+static Value readTypedKey(sqlite3_stmt* stmt, int column) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? std::string(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column))) : std::string();
+    } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+        const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, column));
+        int size = sqlite3_column_bytes(stmt, column);
+        return blob && size > 0 ? std::vector<uint8_t>(blob, blob + size) : std::vector<uint8_t>();
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return sqlite3_column_int(stmt, column) != 0;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(sqlite3_column_double(stmt, column));
+    } else if constexpr (sizeof(T) == sizeof(int64_t)) {
+        return static_cast<T>(sqlite3_column_int64(stmt, column));
+    } else {
+        return static_cast<T>(sqlite3_column_int(stmt, column));
+    }
+}
+
+static Value readNullKey(sqlite3_stmt* /*stmt*/, int /*column*/) {
+    return std::monostate{};
+}
+
+SqliteIndex::KeyCodec SqliteIndex::codecFor(ValueType keyType) {
+    switch (keyType) {
+        case ValueType::Bool: return {&bindTypedKey<bool>, &readTypedKey<bool>};
+        case ValueType::Int8: return {&bindTypedKey<int8_t>, &readTypedKey<int8_t>};
+        case ValueType::Int16: return {&bindTypedKey<int16_t>, &readTypedKey<int16_t>};
+        case ValueType::Int32: return {&bindTypedKey<int32_t>, &readTypedKey<int32_t>};
+        case ValueType::Int64: return {&bindTypedKey<int64_t>, &readTypedKey<int64_t>};
+        case ValueType::UInt8: return {&bindTypedKey<uint8_t>, &readTypedKey<uint8_t>};
+        case ValueType::UInt16: return {&bindTypedKey<uint16_t>, &readTypedKey<uint16_t>};
+        case ValueType::UInt32: return {&bindTypedKey<uint32_t>, &readTypedKey<uint32_t>};
+        case ValueType::UInt64: return {&bindTypedKey<uint64_t>, &readTypedKey<uint64_t>};
+        case ValueType::Float32: return {&bindTypedKey<float>, &readTypedKey<float>};
+        case ValueType::Float64: return {&bindTypedKey<double>, &readTypedKey<double>};
+        case ValueType::String: return {&bindTypedKey<std::string>, &readTypedKey<std::string>};
+        case ValueType::Bytes: return {&bindTypedKey<std::vector<uint8_t>>, &readTypedKey<std::vector<uint8_t>>};
+        case ValueType::Null:
+        default:
+            return {&bindIndexKey, &readNullKey};
+    }
+}
+
 SqliteIndex::SqliteIndex(sqlite3* db, const std::string& tableName,
                          const std::string& columnName, ValueType keyType)
-    : db_(db), keyType_(keyType) {
-
-    // Create unique index table name: _idx_{table}_{column}
-    indexTableName_ = "_idx_" + tableName + "_" + columnName;
+    : Index(tableName, columnName, keyType), db_(db), codec_(codecFor(keyType)) {}
 
+void SqliteIndex::open() const {
     // Create the index table with appropriate type
     // Use (key, sequence) as composite primary key to support non-unique indexes
     // This allows multiple records with the same key (e.g., posts by same user_id)
-    std::string sqlType = getSqliteType();
+    std::string sqlType = sqliteTypeForKey(keyType_);
     std::string createSql =
-        "CREATE TABLE IF NOT EXISTS \"" + indexTableName_ + "\" ("
+        "CREATE TABLE IF NOT EXISTS \"" + name_ + "\" ("
         "key " + sqlType + " NOT NULL, "
         "data_offset INTEGER NOT NULL, "
         "data_length INTEGER NOT NULL, "
@@ -123,7 +270,7 @@ SqliteIndex::SqliteIndex(sqlite3* db, const std::string& tableName,
     }
 
     // Prepare statements
-    std::string insertSql = "INSERT INTO \"" + indexTableName_ +
+    std::string insertSql = "INSERT INTO \"" + name_ +
         "\" (key, data_offset, data_length, sequence) VALUES (?, ?, ?, ?)";
     rc = sqlite3_prepare_v2(db_, insertSql.c_str(), -1, &insertStmt_, nullptr);
     if (rc != SQLITE_OK) {
@@ -131,7 +278,7 @@ SqliteIndex::SqliteIndex(sqlite3* db, const std::string& tableName,
     }
 
     std::string searchSql = "SELECT key, data_offset, data_length, sequence FROM \"" +
-        indexTableName_ + "\" WHERE key = ?";
+        name_ + "\" WHERE key = ?";
     rc = sqlite3_prepare_v2(db_, searchSql.c_str(), -1, &searchStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare search statement");
@@ -139,33 +286,42 @@ SqliteIndex::SqliteIndex(sqlite3* db, const std::string& tableName,
 
     // searchFirst returns just the first match (with LIMIT 1 for efficiency)
     std::string searchFirstSql = "SELECT key, data_offset, data_length, sequence FROM \"" +
-        indexTableName_ + "\" WHERE key = ? LIMIT 1";
+        name_ + "\" WHERE key = ? LIMIT 1";
     rc = sqlite3_prepare_v2(db_, searchFirstSql.c_str(), -1, &searchFirstStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare searchFirst statement");
     }
 
+    // The typed lookups need only the location, which the leaf holds
+    // next to the key
+    std::string lookupSql = "SELECT data_offset, data_length, sequence FROM \"" +
+        name_ + "\" WHERE key = ? LIMIT 1";
+    rc = sqlite3_prepare_v2(db_, lookupSql.c_str(), -1, &lookupStmt_, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare lookup statement");
+    }
+
     std::string rangeSql = "SELECT key, data_offset, data_length, sequence FROM \"" +
-        indexTableName_ + "\" WHERE key >= ? AND key <= ? ORDER BY key";
+        name_ + "\" WHERE key >= ? AND key <= ? ORDER BY key";
     rc = sqlite3_prepare_v2(db_, rangeSql.c_str(), -1, &rangeStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare range statement");
     }
 
     std::string allSql = "SELECT key, data_offset, data_length, sequence FROM \"" +
-        indexTableName_ + "\" ORDER BY key";
+        name_ + "\" ORDER BY key";
     rc = sqlite3_prepare_v2(db_, allSql.c_str(), -1, &allStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare all statement");
     }
 
-    std::string countSql = "SELECT COUNT(*) FROM \"" + indexTableName_ + "\"";
+    std::string countSql = "SELECT COUNT(*) FROM \"" + name_ + "\"";
     rc = sqlite3_prepare_v2(db_, countSql.c_str(), -1, &countStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare count statement");
     }
 
-    std::string clearSql = "DELETE FROM \"" + indexTableName_ + "\"";
+    std::string clearSql = "DELETE FROM \"" + name_ + "\"";
     rc = sqlite3_prepare_v2(db_, clearSql.c_str(), -1, &clearStmt_, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare clear statement");
@@ -176,33 +332,54 @@ SqliteIndex::~SqliteIndex() {
     if (insertStmt_) sqlite3_finalize(insertStmt_);
     if (searchStmt_) sqlite3_finalize(searchStmt_);
     if (searchFirstStmt_) sqlite3_finalize(searchFirstStmt_);
+    if (lookupStmt_) sqlite3_finalize(lookupStmt_);
     if (rangeStmt_) sqlite3_finalize(rangeStmt_);
     if (allStmt_) sqlite3_finalize(allStmt_);
     if (countStmt_) sqlite3_finalize(countStmt_);
     if (clearStmt_) sqlite3_finalize(clearStmt_);
+    if (batchInsertStmt_) sqlite3_finalize(batchInsertStmt_);
+    if (searchManyStmt_) sqlite3_finalize(searchManyStmt_);
+    if (rangeFromStmt_) sqlite3_finalize(rangeFromStmt_);
+    if (rangeToStmt_) sqlite3_finalize(rangeToStmt_);
+    for (sqlite3_stmt* stmt : pageStmts_) {
+        if (stmt) sqlite3_finalize(stmt);
+    }
 }
 
 SqliteIndex::SqliteIndex(SqliteIndex&& other) noexcept
-    : db_(other.db_)
-    , indexTableName_(std::move(other.indexTableName_))
-    , keyType_(other.keyType_)
-    , entryCount_(other.entryCount_)
+    : Index(other)
+    , db_(other.db_)
+    , codec_(other.codec_)
     , insertStmt_(other.insertStmt_)
     , searchStmt_(other.searchStmt_)
     , searchFirstStmt_(other.searchFirstStmt_)
+    , lookupStmt_(other.lookupStmt_)
     , rangeStmt_(other.rangeStmt_)
     , allStmt_(other.allStmt_)
     , countStmt_(other.countStmt_)
     , clearStmt_(other.clearStmt_)
+    , batchInsertStmt_(other.batchInsertStmt_)
+    , searchManyStmt_(other.searchManyStmt_)
+    , rangeFromStmt_(other.rangeFromStmt_)
+    , rangeToStmt_(other.rangeToStmt_)
 {
     other.db_ = nullptr;
     other.insertStmt_ = nullptr;
     other.searchStmt_ = nullptr;
     other.searchFirstStmt_ = nullptr;
+    other.lookupStmt_ = nullptr;
     other.rangeStmt_ = nullptr;
     other.allStmt_ = nullptr;
     other.countStmt_ = nullptr;
     other.clearStmt_ = nullptr;
+    other.batchInsertStmt_ = nullptr;
+    other.searchManyStmt_ = nullptr;
+    other.rangeFromStmt_ = nullptr;
+    other.rangeToStmt_ = nullptr;
+    for (int i = 0; i < PAGE_STATEMENTS; i++) {
+        pageStmts_[i] = other.pageStmts_[i];
+        other.pageStmts_[i] = nullptr;
+    }
 }
 
 SqliteIndex& SqliteIndex::operator=(SqliteIndex&& other) noexcept {
@@ -211,138 +388,60 @@ SqliteIndex& SqliteIndex::operator=(SqliteIndex&& other) noexcept {
         if (insertStmt_) sqlite3_finalize(insertStmt_);
         if (searchStmt_) sqlite3_finalize(searchStmt_);
         if (searchFirstStmt_) sqlite3_finalize(searchFirstStmt_);
+        if (lookupStmt_) sqlite3_finalize(lookupStmt_);
         if (rangeStmt_) sqlite3_finalize(rangeStmt_);
         if (allStmt_) sqlite3_finalize(allStmt_);
         if (countStmt_) sqlite3_finalize(countStmt_);
         if (clearStmt_) sqlite3_finalize(clearStmt_);
+        if (batchInsertStmt_) sqlite3_finalize(batchInsertStmt_);
+        if (searchManyStmt_) sqlite3_finalize(searchManyStmt_);
+        if (rangeFromStmt_) sqlite3_finalize(rangeFromStmt_);
+        if (rangeToStmt_) sqlite3_finalize(rangeToStmt_);
+        for (sqlite3_stmt* stmt : pageStmts_) {
+            if (stmt) sqlite3_finalize(stmt);
+        }
 
         // Move from other
+        Index::operator=(other);
         db_ = other.db_;
-        indexTableName_ = std::move(other.indexTableName_);
-        keyType_ = other.keyType_;
-        entryCount_ = other.entryCount_;
+        codec_ = other.codec_;
         insertStmt_ = other.insertStmt_;
         searchStmt_ = other.searchStmt_;
         searchFirstStmt_ = other.searchFirstStmt_;
+        lookupStmt_ = other.lookupStmt_;
         rangeStmt_ = other.rangeStmt_;
         allStmt_ = other.allStmt_;
         countStmt_ = other.countStmt_;
         clearStmt_ = other.clearStmt_;
+        batchInsertStmt_ = other.batchInsertStmt_;
+        searchManyStmt_ = other.searchManyStmt_;
+        rangeFromStmt_ = other.rangeFromStmt_;
+        rangeToStmt_ = other.rangeToStmt_;
 
         other.db_ = nullptr;
         other.insertStmt_ = nullptr;
         other.searchStmt_ = nullptr;
         other.searchFirstStmt_ = nullptr;
+        other.lookupStmt_ = nullptr;
         other.rangeStmt_ = nullptr;
         other.allStmt_ = nullptr;
         other.countStmt_ = nullptr;
         other.clearStmt_ = nullptr;
-    }
-    return *this;
-}
-
-std::string SqliteIndex::getSqliteType() const {
-    switch (keyType_) {
-        case ValueType::Int8:
-        case ValueType::Int16:
-        case ValueType::Int32:
-        case ValueType::Int64:
-        case ValueType::UInt8:
-        case ValueType::UInt16:
-        case ValueType::UInt32:
-        case ValueType::UInt64:
-            return "INTEGER";
-        case ValueType::Float32:
-        case ValueType::Float64:
-            return "REAL";
-        case ValueType::String:
-            return "TEXT";
-        case ValueType::Bool:
-            return "INTEGER";
-        case ValueType::Bytes:
-            return "BLOB";
-        default:
-            return "BLOB";
-    }
-}
-
-void SqliteIndex::bindKey(sqlite3_stmt* stmt, int index, const Value& key) const {
-    std::visit([stmt, index](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::monostate>) {
-            sqlite3_bind_null(stmt, index);
-        } else if constexpr (std::is_same_v<T, bool>) {
-            sqlite3_bind_int(stmt, index, arg ? 1 : 0);
-        } else if constexpr (std::is_same_v<T, int8_t> || std::is_same_v<T, int16_t> ||
-                           std::is_same_v<T, int32_t>) {
-            sqlite3_bind_int(stmt, index, static_cast<int>(arg));
-        } else if constexpr (std::is_same_v<T, int64_t>) {
-            sqlite3_bind_int64(stmt, index, arg);
-        } else if constexpr (std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
-                           std::is_same_v<T, uint32_t>) {
-            sqlite3_bind_int(stmt, index, static_cast<int>(arg));
-        } else if constexpr (std::is_same_v<T, uint64_t>) {
-            sqlite3_bind_int64(stmt, index, static_cast<int64_t>(arg));
-        } else if constexpr (std::is_same_v<T, float>) {
-            sqlite3_bind_double(stmt, index, static_cast<double>(arg));
-        } else if constexpr (std::is_same_v<T, double>) {
-            sqlite3_bind_double(stmt, index, arg);
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            sqlite3_bind_text(stmt, index, arg.c_str(), static_cast<int>(arg.size()), SQLITE_TRANSIENT);
-        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
-            sqlite3_bind_blob(stmt, index, arg.data(), static_cast<int>(arg.size()), SQLITE_TRANSIENT);
-        }
-    }, key);
-}
-
-Value SqliteIndex::extractKey(sqlite3_stmt* stmt, int column) const {
-    int type = sqlite3_column_type(stmt, column);
-
-    switch (keyType_) {
-        case ValueType::Int8:
-            return static_cast<int8_t>(sqlite3_column_int(stmt, column));
-        case ValueType::Int16:
-            return static_cast<int16_t>(sqlite3_column_int(stmt, column));
-        case ValueType::Int32:
-            return static_cast<int32_t>(sqlite3_column_int(stmt, column));
-        case ValueType::Int64:
-            return sqlite3_column_int64(stmt, column);
-        case ValueType::UInt8:
-            return static_cast<uint8_t>(sqlite3_column_int(stmt, column));
-        case ValueType::UInt16:
-            return static_cast<uint16_t>(sqlite3_column_int(stmt, column));
-        case ValueType::UInt32:
-            return static_cast<uint32_t>(sqlite3_column_int(stmt, column));
-        case ValueType::UInt64:
-            return static_cast<uint64_t>(sqlite3_column_int64(stmt, column));
-        case ValueType::Float32:
-            return static_cast<float>(sqlite3_column_double(stmt, column));
-        case ValueType::Float64:
-            return sqlite3_column_double(stmt, column);
-        case ValueType::String: {
-            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
-            return text ? std::string(text) : std::string();
-        }
-        case ValueType::Bool:
-            return sqlite3_column_int(stmt, column) != 0;
-        case ValueType::Bytes: {
-            const void* blob = sqlite3_column_blob(stmt, column);
-            int size = sqlite3_column_bytes(stmt, column);
-            if (blob && size > 0) {
-                const uint8_t* data = static_cast<const uint8_t*>(blob);
-                return std::vector<uint8_t>(data, data + size);
-            }
-            return std::vector<uint8_t>();
+        other.batchInsertStmt_ = nullptr;
+        other.searchManyStmt_ = nullptr;
+        other.rangeFromStmt_ = nullptr;
+        other.rangeToStmt_ = nullptr;
+        for (int i = 0; i < PAGE_STATEMENTS; i++) {
+            pageStmts_[i] = other.pageStmts_[i];
+            other.pageStmts_[i] = nullptr;
         }
-        case ValueType::Null:
-        default:
-            return std::monostate{};
     }
+    return *this;
 }
 
 IndexEntry SqliteIndex::extractEntry(sqlite3_stmt* stmt) const {
     IndexEntry entry;
-    entry.key = extractKey(stmt, 0);
+    entry.key = codec_.read(stmt, 0);
     entry.dataOffset = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
     entry.dataLength = static_cast<uint32_t>(sqlite3_column_int(stmt, 2));
     entry.sequence = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
@@ -350,10 +449,12 @@ IndexEntry SqliteIndex::extractEntry(sqlite3_stmt* stmt) const {
 }
 
 void SqliteIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::insert");
+    if (!insertStmt_) open();
     sqlite3_reset(insertStmt_);
     sqlite3_clear_bindings(insertStmt_);
 
-    bindKey(insertStmt_, 1, key);
+    codec_.bind(insertStmt_, 1, key);
     sqlite3_bind_int64(insertStmt_, 2, static_cast<int64_t>(dataOffset));
     sqlite3_bind_int(insertStmt_, 3, static_cast<int>(dataLength));
     sqlite3_bind_int64(insertStmt_, 4, static_cast<int64_t>(sequence));
@@ -364,15 +465,65 @@ void SqliteIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLen
             std::string(sqlite3_errmsg(db_)));
     }
 
-    entryCount_++;
+    stats_.add(key);
+}
+
+void SqliteIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::bulkLoad");
+    if (!insertStmt_) open();
+    if (!batchInsertStmt_) {
+        std::string sql = "INSERT INTO \"" + name_ +
+            "\" (key, data_offset, data_length, sequence) VALUES ";
+        for (int i = 0; i < BULK_INSERT_ROWS; i++) {
+            sql += (i == 0) ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+        }
+        int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &batchInsertStmt_, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare batch insert statement");
+        }
+    }
+
+    size_t i = 0;
+    size_t fullBatches = sortedEntries.size() / BULK_INSERT_ROWS;
+    for (size_t batch = 0; batch < fullBatches; batch++) {
+        sqlite3_reset(batchInsertStmt_);
+        for (int row = 0; row < BULK_INSERT_ROWS; row++) {
+            const IndexEntry& e = sortedEntries[i + row];
+            int p = row * 4;
+            codec_.bind(batchInsertStmt_, p + 1, e.key);
+            sqlite3_bind_int64(batchInsertStmt_, p + 2, static_cast<int64_t>(e.dataOffset));
+            sqlite3_bind_int(batchInsertStmt_, p + 3, static_cast<int>(e.dataLength));
+            sqlite3_bind_int64(batchInsertStmt_, p + 4, static_cast<int64_t>(e.sequence));
+        }
+
+        if (sqlite3_step(batchInsertStmt_) != SQLITE_DONE) {
+            // A bad row fails the whole statement - redo row by row so the
+            // error surfaces at the same entry as with insert()
+            sqlite3_reset(batchInsertStmt_);
+            break;
+        }
+        for (int row = 0; row < BULK_INSERT_ROWS; row++) {
+            stats_.add(sortedEntries[i + row].key);
+        }
+        i += BULK_INSERT_ROWS;
+    }
+    sqlite3_clear_bindings(batchInsertStmt_);
+
+    for (; i < sortedEntries.size(); i++) {
+        const IndexEntry& e = sortedEntries[i];
+        insert(e.key, e.dataOffset, e.dataLength, e.sequence);
+    }
 }
 
 std::vector<IndexEntry> SqliteIndex::search(const Value& key) const {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::search");
+    ConnectionLock lock(db_);
     std::vector<IndexEntry> results;
+    if (!insertStmt_) return results;
 
     sqlite3_reset(searchStmt_);
     sqlite3_clear_bindings(searchStmt_);
-    bindKey(searchStmt_, 1, key);
+    codec_.bind(searchStmt_, 1, key);
 
     while (sqlite3_step(searchStmt_) == SQLITE_ROW) {
         results.push_back(extractEntry(searchStmt_));
@@ -381,10 +532,50 @@ std::vector<IndexEntry> SqliteIndex::search(const Value& key) const {
     return results;
 }
 
+std::vector<IndexEntry> SqliteIndex::searchMany(std::vector<Value> keys) const {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::searchMany");
+    sortKeys(keys);
+    std::vector<IndexEntry> results;
+    if (keys.empty() || !insertStmt_) return results;
+
+    ConnectionLock lock(db_);
+    if (!searchManyStmt_) {
+        std::string sql = "SELECT key, data_offset, data_length, sequence FROM \"" + name_ +
+            "\" WHERE key IN (";
+        for (int i = 0; i < SEARCH_MANY_KEYS; i++) {
+            sql += (i == 0) ? "?" : ", ?";
+        }
+        sql += ") ORDER BY key, sequence";
+        if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &searchManyStmt_, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare searchMany statement");
+        }
+    }
+
+    // Keys are sorted, so consecutive chunks return consecutive key ranges.
+    // A short last chunk repeats its final key in the unused parameters.
+    for (size_t begin = 0; begin < keys.size(); begin += SEARCH_MANY_KEYS) {
+        size_t end = std::min(keys.size(), begin + SEARCH_MANY_KEYS);
+        sqlite3_reset(searchManyStmt_);
+        for (int p = 0; p < SEARCH_MANY_KEYS; p++) {
+            size_t k = std::min(begin + p, end - 1);
+            codec_.bind(searchManyStmt_, p + 1, keys[k]);
+        }
+        while (sqlite3_step(searchManyStmt_) == SQLITE_ROW) {
+            results.push_back(extractEntry(searchManyStmt_));
+        }
+    }
+    sqlite3_reset(searchManyStmt_);
+    sqlite3_clear_bindings(searchManyStmt_);
+    return results;
+}
+
 bool SqliteIndex::searchFirst(const Value& key, IndexEntry& result) const {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::searchFirst");
+    ConnectionLock lock(db_);
+    if (!insertStmt_) return false;
     sqlite3_reset(searchFirstStmt_);
     sqlite3_clear_bindings(searchFirstStmt_);
-    bindKey(searchFirstStmt_, 1, key);
+    codec_.bind(searchFirstStmt_, 1, key);
 
     if (sqlite3_step(searchFirstStmt_) == SQLITE_ROW) {
         result = extractEntry(searchFirstStmt_);
@@ -395,15 +586,18 @@ bool SqliteIndex::searchFirst(const Value& key, IndexEntry& result) const {
 }
 
 bool SqliteIndex::searchFirstString(const std::string& key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const {
-    sqlite3_reset(searchFirstStmt_);
+    FLATSQL_TRACE_SCOPE("SqliteIndex::searchFirstString");
+    ConnectionLock lock(db_);
+    if (!insertStmt_) return false;
+    sqlite3_reset(lookupStmt_);
     // Bind string directly - no variant dispatch
-    sqlite3_bind_text(searchFirstStmt_, 1, key.c_str(), static_cast<int>(key.size()), SQLITE_STATIC);
+    sqlite3_bind_text(lookupStmt_, 1, key.c_str(), static_cast<int>(key.size()), SQLITE_STATIC);
 
-    if (sqlite3_step(searchFirstStmt_) == SQLITE_ROW) {
-        // Extract only what we need - skip key extraction entirely
-        outOffset = static_cast<uint64_t>(sqlite3_column_int64(searchFirstStmt_, 1));
-        outLength = static_cast<uint32_t>(sqlite3_column_int(searchFirstStmt_, 2));
-        outSequence = static_cast<uint64_t>(sqlite3_column_int64(searchFirstStmt_, 3));
+    if (sqlite3_step(lookupStmt_) == SQLITE_ROW) {
+        // The statement selects only the location - no key extraction
+        outOffset = static_cast<uint64_t>(sqlite3_column_int64(lookupStmt_, 0));
+        outLength = static_cast<uint32_t>(sqlite3_column_int(lookupStmt_, 1));
+        outSequence = static_cast<uint64_t>(sqlite3_column_int64(lookupStmt_, 2));
         return true;
     }
 
@@ -411,15 +605,18 @@ bool SqliteIndex::searchFirstString(const std::string& key, uint64_t& outOffset,
 }
 
 bool SqliteIndex::searchFirstInt64(int64_t key, uint64_t& outOffset, uint32_t& outLength, uint64_t& outSequence) const {
-    sqlite3_reset(searchFirstStmt_);
+    FLATSQL_TRACE_SCOPE("SqliteIndex::searchFirstInt64");
+    ConnectionLock lock(db_);
+    if (!insertStmt_) return false;
+    sqlite3_reset(lookupStmt_);
     // Bind int64 directly - no variant dispatch
-    sqlite3_bind_int64(searchFirstStmt_, 1, key);
+    sqlite3_bind_int64(lookupStmt_, 1, key);
 
-    if (sqlite3_step(searchFirstStmt_) == SQLITE_ROW) {
-        // Extract only what we need - skip key extraction entirely
-        outOffset = static_cast<uint64_t>(sqlite3_column_int64(searchFirstStmt_, 1));
-        outLength = static_cast<uint32_t>(sqlite3_column_int(searchFirstStmt_, 2));
-        outSequence = static_cast<uint64_t>(sqlite3_column_int64(searchFirstStmt_, 3));
+    if (sqlite3_step(lookupStmt_) == SQLITE_ROW) {
+        // The statement selects only the location - no key extraction
+        outOffset = static_cast<uint64_t>(sqlite3_column_int64(lookupStmt_, 0));
+        outLength = static_cast<uint32_t>(sqlite3_column_int(lookupStmt_, 1));
+        outSequence = static_cast<uint64_t>(sqlite3_column_int64(lookupStmt_, 2));
         return true;
     }
 
@@ -427,22 +624,50 @@ bool SqliteIndex::searchFirstInt64(int64_t key, uint64_t& outOffset, uint32_t& o
 }
 
 std::vector<IndexEntry> SqliteIndex::range(const Value& minKey, const Value& maxKey) const {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::range");
+    bool openMin = std::holds_alternative<std::monostate>(minKey);
+    bool openMax = std::holds_alternative<std::monostate>(maxKey);
+    if (openMin && openMax) return all();
+
+    ConnectionLock lock(db_);
     std::vector<IndexEntry> results;
+    if (!insertStmt_) return results;
+
+    // One-sided ranges use their own statement, prepared on first use
+    sqlite3_stmt* stmt = rangeStmt_;
+    if (openMin || openMax) {
+        sqlite3_stmt*& halfStmt = openMax ? rangeFromStmt_ : rangeToStmt_;
+        if (!halfStmt) {
+            std::string sql = "SELECT key, data_offset, data_length, sequence FROM \"" + name_ +
+                "\" WHERE key " + (openMax ? ">=" : "<=") + " ? ORDER BY key";
+            if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &halfStmt, nullptr) != SQLITE_OK) {
+                throw std::runtime_error("Failed to prepare range statement");
+            }
+        }
+        stmt = halfStmt;
+    }
 
-    sqlite3_reset(rangeStmt_);
-    sqlite3_clear_bindings(rangeStmt_);
-    bindKey(rangeStmt_, 1, minKey);
-    bindKey(rangeStmt_, 2, maxKey);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (stmt == rangeStmt_) {
+        codec_.bind(stmt, 1, minKey);
+        codec_.bind(stmt, 2, maxKey);
+    } else {
+        codec_.bind(stmt, 1, openMax ? minKey : maxKey);
+    }
 
-    while (sqlite3_step(rangeStmt_) == SQLITE_ROW) {
-        results.push_back(extractEntry(rangeStmt_));
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        results.push_back(extractEntry(stmt));
     }
 
     return results;
 }
 
 std::vector<IndexEntry> SqliteIndex::all() const {
+    FLATSQL_TRACE_SCOPE("SqliteIndex::all");
+    ConnectionLock lock(db_);
     std::vector<IndexEntry> results;
+    if (!insertStmt_) return results;
 
     sqlite3_reset(allStmt_);
 
@@ -453,7 +678,103 @@ std::vector<IndexEntry> SqliteIndex::all() const {
     return results;
 }
 
+// Where an openRange page query starts: at the end of the index, at the
+// range bound, or just past the last entry of the previous page
+enum PageStart { PAGE_FROM_END = 0, PAGE_FROM_BOUND = 1, PAGE_AFTER_ENTRY = 2 };
+
+sqlite3_stmt* SqliteIndex::pageStatement(bool reverse, int start, bool bounded) const {
+    sqlite3_stmt*& stmt = pageStmts_[(reverse ? 6 : 0) + start * 2 + (bounded ? 1 : 0)];
+    if (stmt) return stmt;
+
+    std::vector<std::string> conditions;
+    if (start == PAGE_FROM_BOUND) {
+        conditions.push_back(reverse ? "key <= ?" : "key >= ?");
+    } else if (start == PAGE_AFTER_ENTRY) {
+        conditions.push_back(reverse ? "(key, sequence) < (?, ?)" : "(key, sequence) > (?, ?)");
+    }
+    if (bounded) {
+        conditions.push_back(reverse ? "key >= ?" : "key <= ?");
+    }
+
+    std::string sql = "SELECT key, data_offset, data_length, sequence FROM \"" + name_ + "\"";
+    for (size_t i = 0; i < conditions.size(); i++) {
+        sql += (i == 0 ? " WHERE " : " AND ") + conditions[i];
+    }
+    sql += reverse ? " ORDER BY key DESC, sequence DESC" : " ORDER BY key, sequence";
+    sql += " LIMIT " + std::to_string(IndexCursor::PAGE_ENTRIES);
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare range page statement");
+    }
+    return stmt;
+}
+
+class SqliteIndex::RangeCursor : public IndexCursor {
+public:
+    RangeCursor(const SqliteIndex& index, const Value& minKey, const Value& maxKey, bool reverse)
+        : index_(index), reverse_(reverse),
+          start_(reverse ? maxKey : minKey), end_(reverse ? minKey : maxKey) {}
+
+    ~RangeCursor() override { sqlite3_value_free(resume_); }
+
+protected:
+    bool fetch(std::vector<IndexEntry>& page) override {
+        FLATSQL_TRACE_SCOPE("SqliteIndex::RangeCursor::fetch");
+        bool fromBound = !std::holds_alternative<std::monostate>(start_);
+        bool bounded = !std::holds_alternative<std::monostate>(end_);
+
+        ConnectionLock lock(index_.db_);
+        if (!index_.insertStmt_) return false;  // Never written to
+        sqlite3_stmt* stmt = index_.pageStatement(
+            reverse_, resume_ ? PAGE_AFTER_ENTRY : fromBound ? PAGE_FROM_BOUND : PAGE_FROM_END, bounded);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        int param = 1;
+        if (resume_) {
+            sqlite3_bind_value(stmt, param++, resume_);
+            sqlite3_bind_int64(stmt, param++, static_cast<int64_t>(resumeSequence_));
+        } else if (fromBound) {
+            index_.codec_.bind(stmt, param++, start_);
+        }
+        if (bounded) {
+            index_.codec_.bind(stmt, param++, end_);
+        }
+
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            IndexEntry entry;
+            entry.dataOffset = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+            entry.dataLength = static_cast<uint32_t>(sqlite3_column_int(stmt, 2));
+            entry.sequence = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
+            page.push_back(entry);
+            if (page.size() == PAGE_ENTRIES) {
+                // Keep the stored key as is, so the next page resumes exactly after it
+                sqlite3_value_free(resume_);
+                resume_ = sqlite3_value_dup(sqlite3_column_value(stmt, 0));
+                resumeSequence_ = entry.sequence;
+            }
+        }
+        sqlite3_reset(stmt);
+        return page.size() == PAGE_ENTRIES && resume_;
+    }
+
+private:
+    const SqliteIndex& index_;
+    bool reverse_;
+    Value start_;  // Bound the scan starts from (lower one going forward)
+    Value end_;
+    sqlite3_value* resume_ = nullptr;
+    uint64_t resumeSequence_ = 0;
+};
+
+std::unique_ptr<IndexCursor> SqliteIndex::openRange(const Value& minKey, const Value& maxKey,
+                                                    bool reverse) const {
+    return std::make_unique<RangeCursor>(*this, minKey, maxKey, reverse);
+}
+
 void SqliteIndex::clear() {
+    if (!insertStmt_) {
+        stats_.clear();
+        return;
+    }
     sqlite3_reset(clearStmt_);
 
     int rc = sqlite3_step(clearStmt_);
@@ -462,7 +783,77 @@ void SqliteIndex::clear() {
             std::string(sqlite3_errmsg(db_)));
     }
 
-    entryCount_ = 0;
+    stats_.clear();
+}
+
+void SqliteIndex::eraseThrough(uint64_t sequence) {
+    if (!insertStmt_) return;  // Never written, nothing to erase
+    std::string sql = "DELETE FROM \"" + name_ + "\" WHERE sequence <= ?";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare index erase: " + std::string(sqlite3_errmsg(db_)));
+    }
+    sqlite3_bind_int64(stmt, 1, static_cast<int64_t>(sequence));
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to erase index entries: " + std::string(sqlite3_errmsg(db_)));
+    }
+    stats_.remove(static_cast<uint64_t>(sqlite3_changes(db_)));
+}
+
+size_t SqliteIndex::pageBytes() const {
+    if (!insertStmt_) return 0;  // Table not created yet
+    ConnectionLock lock(db_);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT SUM(pgsize) FROM dbstat('main', 1) WHERE name = ?", -1, &stmt,
+                           nullptr) != SQLITE_OK) {
+        return static_cast<size_t>(getEntryCount()) * ESTIMATED_PAGE_ENTRY_BYTES;
+    }
+    sqlite3_bind_text(stmt, 1, name_.c_str(), static_cast<int>(name_.size()), SQLITE_STATIC);
+    size_t bytes = sqlite3_step(stmt) == SQLITE_ROW ? static_cast<size_t>(sqlite3_column_int64(stmt, 0)) : 0;
+    sqlite3_finalize(stmt);
+    return bytes;
+}
+
+void SqliteIndex::saveTo(sqlite3* /*db*/, const std::string& schemaName) const {
+    if (!insertStmt_) open();
+    // Plain table in the sidecar; rows are written in key order so loading
+    // back into the WITHOUT ROWID table is a sequential append
+    std::string sql =
+        "DROP TABLE IF EXISTS \"" + schemaName + "\".\"" + name_ + "\"; "
+        "CREATE TABLE \"" + schemaName + "\".\"" + name_ + "\" AS "
+        "SELECT key, data_offset, data_length, sequence FROM main.\"" + name_ + "\"";
+
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string err = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Failed to save index: " + err);
+    }
+}
+
+void SqliteIndex::loadFrom(sqlite3* /*db*/, const std::string& schemaName) {
+    if (!insertStmt_) open();
+    std::string sql =
+        "INSERT INTO main.\"" + name_ + "\" (key, data_offset, data_length, sequence) "
+        "SELECT key, data_offset, data_length, sequence FROM \"" + schemaName + "\".\"" +
+        name_ + "\"";
+
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::string err = errMsg ? errMsg : "Unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Failed to load index: " + err);
+    }
+
+    // Loaded rows bypass insert(); rebuild the statistics from the table
+    stats_.clear();
+    for (const auto& entry : all()) {
+        stats_.add(entry.key);
+    }
 }
 
 }  // namespace flatsql
@@ -0,0 +1,288 @@
+#include "flatsql/sqlite_junction_vtab.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace flatsql {
+
+// Columns before the child table's
+static constexpr int PARENT_ROWID_COLUMN = 0;
+static constexpr int CHILD_ROWID_COLUMN = 1;
+static constexpr int VEC_INDEX_COLUMN = 2;
+static constexpr int UNION_TYPE_COLUMN = 3;
+static constexpr int FIRST_CHILD_COLUMN = 4;
+
+// Plans: idxNum 0 scans every parent, 1 looks up one parent_rowid and 2
+// the whole parent_rowid IN (...) list
+static constexpr int SCAN_ALL = 0;
+static constexpr int PARENT_EQ = 1;
+static constexpr int PARENT_IN = 2;
+
+// Values in an IN list whose size SQLite doesn't tell us
+static constexpr double PLANNED_IN_PARENTS = 10.0;
+
+sqlite3_module JunctionVTabModule::module_ = {
+    0,                          // iVersion
+    xCreate,                    // xCreate
+    xConnect,                   // xConnect
+    xBestIndex,                 // xBestIndex
+    xDisconnect,                // xDisconnect
+    xDestroy,                   // xDestroy
+    xOpen,                      // xOpen
+    xClose,                     // xClose
+    xFilter,                    // xFilter
+    xNext,                      // xNext
+    xEof,                       // xEof
+    xColumn,                    // xColumn
+    xRowid,                     // xRowid
+    nullptr,                    // xUpdate (read-only)
+    nullptr,                    // xBegin
+    nullptr,                    // xSync
+    nullptr,                    // xCommit
+    nullptr,                    // xRollback
+    nullptr,                    // xFindFunction
+    nullptr,                    // xRename
+    nullptr,                    // xSavepoint
+    nullptr,                    // xRelease
+    nullptr,                    // xRollbackTo
+    nullptr,                    // xShadowName
+    nullptr                     // xIntegrity
+};
+
+sqlite3_module* JunctionVTabModule::getModule() {
+    return &module_;
+}
+
+int JunctionVTabModule::xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                                sqlite3_vtab** ppVTab, char** pzErr) {
+    return xConnect(db, pAux, argc, argv, ppVTab, pzErr);
+}
+
+int JunctionVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                                 sqlite3_vtab** ppVTab, char** pzErr) {
+    (void)argc;
+    (void)argv;
+
+    JunctionVTabInfo* info = static_cast<JunctionVTabInfo*>(pAux);
+    if (!info || !info->junctions) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Missing junction");
+        }
+        return SQLITE_ERROR;
+    }
+
+    std::string decl = "CREATE TABLE x(\"parent_rowid\" INTEGER, \"child_rowid\" INTEGER, "
+                       "\"vec_index\" INTEGER, \"union_type\" TEXT";
+    int childColumns = 0;
+    if (info->childDef && info->extractor) {
+        for (const auto& column : info->childDef->columns) {
+            decl += ", \"" + column.name + "\" " + FlatBufferVTabModule::valueTypeToSQLite(column.type);
+        }
+        childColumns = static_cast<int>(info->childDef->columns.size());
+    }
+    decl += ", \"_data\" BLOB)";
+
+    int rc = sqlite3_declare_vtab(db, decl.c_str());
+    if (rc != SQLITE_OK) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
+        }
+        return rc;
+    }
+
+    JunctionVTab* vtab = new JunctionVTab();
+    memset(static_cast<sqlite3_vtab*>(vtab), 0, sizeof(sqlite3_vtab));
+    vtab->info = info;
+    vtab->childColumns = childColumns;
+    *ppVTab = vtab;
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xDisconnect(sqlite3_vtab* pVTab) {
+    delete static_cast<JunctionVTab*>(pVTab);
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xDestroy(sqlite3_vtab* pVTab) {
+    return xDisconnect(pVTab);
+}
+
+int JunctionVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo) {
+    JunctionVTab* vtab = static_cast<JunctionVTab*>(pVTab);
+    JunctionStats stats = vtab->info->junctions->getJunctionStats(vtab->info->junctionName);
+    double rows = std::max(1.0, static_cast<double>(stats.rows));
+    double parents = std::max(1.0, static_cast<double>(stats.parents));
+    double fanout = std::max(1.0, rows / parents);
+    double lookup = std::log2(parents) + 1.0 + fanout;
+
+    pIdxInfo->idxNum = SCAN_ALL;
+    pIdxInfo->estimatedCost = rows;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(rows);
+
+    // parent_rowid = x is a slice of the parent-side arrays; an IN list
+    // is taken whole so its parents are read in one pass, in order
+    for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+        const auto& constraint = pIdxInfo->aConstraint[i];
+        if (!constraint.usable || constraint.iColumn != PARENT_ROWID_COLUMN ||
+            constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) {
+            continue;
+        }
+        pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+        pIdxInfo->aConstraintUsage[i].omit = 1;
+        if (sqlite3_vtab_in(pIdxInfo, i, -1)) {
+            pIdxInfo->idxNum = PARENT_IN;
+            pIdxInfo->estimatedCost = PLANNED_IN_PARENTS * lookup;
+            pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(PLANNED_IN_PARENTS * fanout);
+        } else {
+            pIdxInfo->idxNum = PARENT_EQ;
+            pIdxInfo->estimatedCost = lookup;
+            pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(fanout);
+        }
+        break;
+    }
+
+    // Every plan returns rows by parent_rowid
+    if (pIdxInfo->nOrderBy == 1 && pIdxInfo->aOrderBy[0].iColumn == PARENT_ROWID_COLUMN &&
+        !pIdxInfo->aOrderBy[0].desc) {
+        pIdxInfo->orderByConsumed = 1;
+    }
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor) {
+    JunctionCursor* cursor = new JunctionCursor();
+    memset(static_cast<sqlite3_vtab_cursor*>(cursor), 0, sizeof(sqlite3_vtab_cursor));
+    cursor->vtab = static_cast<JunctionVTab*>(pVTab);
+    cursor->position = 0;
+    cursor->childData = nullptr;
+    cursor->childLength = 0;
+    cursor->childLoaded = false;
+    *ppCursor = cursor;
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xClose(sqlite3_vtab_cursor* pCursor) {
+    delete static_cast<JunctionCursor*>(pCursor);
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                                int argc, sqlite3_value** argv) {
+    (void)idxStr;
+    JunctionCursor* cursor = static_cast<JunctionCursor*>(pCursor);
+    JunctionVTabInfo* info = cursor->vtab->info;
+    cursor->rows.clear();
+    cursor->position = 0;
+    cursor->childLoaded = false;
+
+    try {
+        if (idxNum == SCAN_ALL || argc < 1) {
+            info->junctions->collectChildren(info->junctionName, nullptr, cursor->rows);
+            return SQLITE_OK;
+        }
+
+        // Parent rowids are sequences: positive integers
+        std::vector<uint64_t> parents;
+        auto add = [&parents](sqlite3_value* value) {
+            if (sqlite3_value_numeric_type(value) != SQLITE_INTEGER) return;
+            sqlite3_int64 rowid = sqlite3_value_int64(value);
+            if (rowid > 0) parents.push_back(static_cast<uint64_t>(rowid));
+        };
+        if (idxNum == PARENT_IN) {
+            sqlite3_value* value = nullptr;
+            int rc = sqlite3_vtab_in_first(argv[0], &value);
+            for (; rc == SQLITE_OK && value; rc = sqlite3_vtab_in_next(argv[0], &value)) {
+                add(value);
+            }
+            if (rc != SQLITE_OK && rc != SQLITE_DONE) return rc;
+            std::sort(parents.begin(), parents.end());
+            parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+        } else {
+            add(argv[0]);
+        }
+        info->junctions->collectChildren(info->junctionName, &parents, cursor->rows);
+    } catch (const std::exception& e) {
+        sqlite3_free(cursor->vtab->zErrMsg);
+        cursor->vtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
+    JunctionCursor* cursor = static_cast<JunctionCursor*>(pCursor);
+    cursor->position++;
+    cursor->childLoaded = false;
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xEof(sqlite3_vtab_cursor* pCursor) {
+    JunctionCursor* cursor = static_cast<JunctionCursor*>(pCursor);
+    return cursor->position >= cursor->rows.size() ? 1 : 0;
+}
+
+int JunctionVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N) {
+    JunctionCursor* cursor = static_cast<JunctionCursor*>(pCursor);
+    JunctionVTabInfo* info = cursor->vtab->info;
+    const JunctionRow& row = cursor->rows[cursor->position];
+
+    switch (N) {
+        case PARENT_ROWID_COLUMN:
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(row.parentRowId));
+            return SQLITE_OK;
+        case CHILD_ROWID_COLUMN:
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(row.childRowId));
+            return SQLITE_OK;
+        case VEC_INDEX_COLUMN:
+            if (row.vectorIndex) {
+                sqlite3_result_int(ctx, *row.vectorIndex);
+            } else {
+                sqlite3_result_null(ctx);
+            }
+            return SQLITE_OK;
+        case UNION_TYPE_COLUMN:
+            if (row.unionType) {
+                sqlite3_result_text(ctx, row.unionType->c_str(), static_cast<int>(row.unionType->size()),
+                                    SQLITE_TRANSIENT);
+            } else {
+                sqlite3_result_null(ctx);
+            }
+            return SQLITE_OK;
+        default:
+            break;
+    }
+
+    if (!cursor->childLoaded) {
+        cursor->childLength = 0;
+        cursor->childData = info->junctions->getChildData(row.childRowId, &cursor->childLength);
+        cursor->childLoaded = true;
+    }
+    if (!cursor->childData) {
+        sqlite3_result_null(ctx);
+        return SQLITE_OK;
+    }
+
+    int childColumn = N - FIRST_CHILD_COLUMN;
+    if (childColumn >= cursor->vtab->childColumns) {
+        sqlite3_result_blob(ctx, cursor->childData, static_cast<int>(cursor->childLength), SQLITE_TRANSIENT);
+        return SQLITE_OK;
+    }
+    try {
+        const std::string& name = info->childDef->columns[childColumn].name;
+        FlatBufferVTabModule::setResultFromValue(ctx, info->extractor(cursor->childData, cursor->childLength, name));
+    } catch (const std::exception& e) {
+        sqlite3_result_error(ctx, e.what(), -1);
+    }
+    return SQLITE_OK;
+}
+
+int JunctionVTabModule::xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    // A child row belongs to one junction row
+    JunctionCursor* cursor = static_cast<JunctionCursor*>(pCursor);
+    *pRowid = static_cast<sqlite3_int64>(cursor->rows[cursor->position].childRowId);
+    return SQLITE_OK;
+}
+
+}  // namespace flatsql
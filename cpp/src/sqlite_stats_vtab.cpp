@@ -0,0 +1,168 @@
+#include "flatsql/sqlite_stats_vtab.h"
+#include <cstring>
+#include <string>
+
+namespace flatsql {
+
+// xCreate is xConnect, so the table exists in every schema without a
+// CREATE VIRTUAL TABLE
+sqlite3_module StatsVTabModule::module_ = {
+    0,                          // iVersion
+    xConnect,                   // xCreate
+    xConnect,                   // xConnect
+    xBestIndex,                 // xBestIndex
+    xDisconnect,                // xDisconnect
+    xDisconnect,                // xDestroy
+    xOpen,                      // xOpen
+    xClose,                     // xClose
+    xFilter,                    // xFilter
+    xNext,                      // xNext
+    xEof,                       // xEof
+    xColumn,                    // xColumn
+    xRowid,                     // xRowid
+    nullptr,                    // xUpdate (read-only)
+    nullptr,                    // xBegin
+    nullptr,                    // xSync
+    nullptr,                    // xCommit
+    nullptr,                    // xRollback
+    nullptr,                    // xFindFunction
+    nullptr,                    // xRename
+    nullptr,                    // xSavepoint
+    nullptr,                    // xRelease
+    nullptr,                    // xRollbackTo
+    nullptr,                    // xShadowName
+    nullptr                     // xIntegrity
+};
+
+// Columns before QUERY_STATS_COUNTERS: id, sql, fast_path, cache_hit
+static constexpr int FIRST_COUNTER = 4;
+
+sqlite3_module* StatsVTabModule::getModule() {
+    return &module_;
+}
+
+int StatsVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                              sqlite3_vtab** ppVTab, char** pzErr) {
+    (void)argc;
+    (void)argv;
+
+    std::string decl = "CREATE TABLE x(id INTEGER, sql TEXT, fast_path INTEGER, cache_hit INTEGER";
+    for (size_t i = 0; i < QUERY_STATS_COUNTER_COUNT; i++) {
+        decl += ", ";
+        decl += QUERY_STATS_COUNTERS[i].column;
+        decl += " INTEGER";
+    }
+    decl += ")";
+
+    int rc = sqlite3_declare_vtab(db, decl.c_str());
+    if (rc != SQLITE_OK) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
+        }
+        return rc;
+    }
+
+    StatsVTab* vtab = new StatsVTab();
+    memset(static_cast<sqlite3_vtab*>(vtab), 0, sizeof(sqlite3_vtab));
+    vtab->log = static_cast<const QueryStatsLog*>(pAux);
+    if (!vtab->log) {
+        delete vtab;
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Missing query stats log");
+        }
+        return SQLITE_ERROR;
+    }
+    *ppVTab = vtab;
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xDisconnect(sqlite3_vtab* pVTab) {
+    delete static_cast<StatsVTab*>(pVTab);
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo) {
+    const QueryStatsLog* log = static_cast<StatsVTab*>(pVTab)->log;
+    size_t rows = log->recent().size();
+    pIdxInfo->estimatedCost = static_cast<double>(rows) + 1.0;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(rows) + 1;
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor) {
+    StatsCursor* cursor = new StatsCursor();
+    memset(static_cast<sqlite3_vtab_cursor*>(cursor), 0, sizeof(sqlite3_vtab_cursor));
+    cursor->vtab = static_cast<StatsVTab*>(pVTab);
+    cursor->position = 0;
+    cursor->count = 0;
+    *ppCursor = cursor;
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xClose(sqlite3_vtab_cursor* pCursor) {
+    delete static_cast<StatsCursor*>(pCursor);
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                             int argc, sqlite3_value** argv) {
+    (void)idxNum;
+    (void)idxStr;
+    (void)argc;
+    (void)argv;
+    StatsCursor* cursor = static_cast<StatsCursor*>(pCursor);
+    const QueryStatsLog* log = cursor->vtab->log;
+    cursor->position = 0;
+    cursor->count = log->recent().size();
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
+    static_cast<StatsCursor*>(pCursor)->position++;
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xEof(sqlite3_vtab_cursor* pCursor) {
+    // The log may have dropped statements since xFilter if a QueryCursor
+    // is reading this table while other statements run
+    StatsCursor* cursor = static_cast<StatsCursor*>(pCursor);
+    return cursor->position >= cursor->count ||
+           cursor->position >= cursor->vtab->log->recent().size() ? 1 : 0;
+}
+
+int StatsVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N) {
+    StatsCursor* cursor = static_cast<StatsCursor*>(pCursor);
+    const QueryStats& stats = cursor->vtab->log->recent()[cursor->position];
+    switch (N) {
+        case 0:
+            sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(stats.id));
+            break;
+        case 1:
+            sqlite3_result_text(ctx, stats.sql.c_str(), static_cast<int>(stats.sql.size()), SQLITE_TRANSIENT);
+            break;
+        case 2:
+            sqlite3_result_int(ctx, stats.fastPath ? 1 : 0);
+            break;
+        case 3:
+            sqlite3_result_int(ctx, stats.resultCacheHit ? 1 : 0);
+            break;
+        default: {
+            size_t counter = static_cast<size_t>(N - FIRST_COUNTER);
+            if (N >= FIRST_COUNTER && counter < QUERY_STATS_COUNTER_COUNT) {
+                sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(stats.*QUERY_STATS_COUNTERS[counter].field));
+            } else {
+                sqlite3_result_null(ctx);
+            }
+            break;
+        }
+    }
+    return SQLITE_OK;
+}
+
+int StatsVTabModule::xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    StatsCursor* cursor = static_cast<StatsCursor*>(pCursor);
+    *pRowid = static_cast<sqlite3_int64>(cursor->vtab->log->recent()[cursor->position].id);
+    return SQLITE_OK;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,309 @@
+#include "flatsql/sqlite_union_vtab.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace flatsql {
+
+sqlite3_module UnionVTabModule::module_ = {
+    0,                          // iVersion
+    xCreate,                    // xCreate
+    xConnect,                   // xConnect
+    xBestIndex,                 // xBestIndex
+    xDisconnect,                // xDisconnect
+    xDestroy,                   // xDestroy
+    xOpen,                      // xOpen
+    xClose,                     // xClose
+    xFilter,                    // xFilter
+    xNext,                      // xNext
+    xEof,                       // xEof
+    xColumn,                    // xColumn
+    xRowid,                     // xRowid
+    nullptr,                    // xUpdate (read-only)
+    nullptr,                    // xBegin
+    nullptr,                    // xSync
+    nullptr,                    // xCommit
+    nullptr,                    // xRollback
+    xFindFunction,              // xFindFunction
+    nullptr,                    // xRename
+    nullptr,                    // xSavepoint
+    nullptr,                    // xRelease
+    nullptr,                    // xRollbackTo
+    nullptr,                    // xShadowName
+    nullptr                     // xIntegrity
+};
+
+sqlite3_module* UnionVTabModule::getModule() {
+    return &module_;
+}
+
+int UnionVTabModule::xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                             sqlite3_vtab** ppVTab, char** pzErr) {
+    return xConnect(db, pAux, argc, argv, ppVTab, pzErr);
+}
+
+int UnionVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
+                              sqlite3_vtab** ppVTab, char** pzErr) {
+    (void)argc;
+    (void)argv;
+
+    UnionVTabInfo* info = static_cast<UnionVTabInfo*>(pAux);
+    if (!info || info->members.empty() || !info->members[0]->tableDef) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Missing union sources");
+        }
+        return SQLITE_ERROR;
+    }
+
+    std::string decl = FlatBufferVTabModule::buildTableDecl(*info->members[0]->tableDef);
+    int rc = sqlite3_declare_vtab(db, decl.c_str());
+    if (rc != SQLITE_OK) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
+        }
+        return rc;
+    }
+
+    UnionVTab* vtab = new UnionVTab();
+    memset(static_cast<sqlite3_vtab*>(vtab), 0, sizeof(sqlite3_vtab));
+    vtab->planner = 0;
+    size_t plannerRecords = 0;
+    for (const VTabCreateInfo* member : info->members) {
+        size_t records = member->sourceRecordInfos ? member->sourceRecordInfos->size() : 0;
+        if (records > plannerRecords) {
+            plannerRecords = records;
+            vtab->planner = vtab->members.size();
+        }
+        vtab->members.push_back(FlatBufferVTabModule::createVTab(*member));
+    }
+
+    // Plans name composite indexes by position, so members keep only those
+    // every member has
+    for (FlatBufferVTab* member : vtab->members) {
+        auto& composites = member->composites;
+        composites.erase(std::remove_if(composites.begin(), composites.end(), [&](const CompositeIndex* composite) {
+            return std::any_of(vtab->members.begin(), vtab->members.end(), [&](const FlatBufferVTab* other) {
+                return std::none_of(other->composites.begin(), other->composites.end(), [&](const CompositeIndex* same) {
+                    return same->getIndexName() == composite->getIndexName() &&
+                           same->getOrdinals() == composite->getOrdinals() &&
+                           same->getKeyColumns().size() == composite->getKeyColumns().size();
+                });
+            });
+        }), composites.end());
+    }
+
+    *ppVTab = vtab;
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xDisconnect(sqlite3_vtab* pVTab) {
+    UnionVTab* vtab = static_cast<UnionVTab*>(pVTab);
+    for (FlatBufferVTab* member : vtab->members) {
+        FlatBufferVTabModule::xDisconnect(member);
+    }
+    delete vtab;
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xDestroy(sqlite3_vtab* pVTab) {
+    return xDisconnect(pVTab);
+}
+
+int UnionVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo) {
+    UnionVTab* vtab = static_cast<UnionVTab*>(pVTab);
+    FlatBufferVTab* planner = vtab->members[vtab->planner];
+
+    // One plan for every member (same schema and indexed columns)
+    int rc = FlatBufferVTabModule::xBestIndex(planner, pIdxInfo);
+    if (rc != SQLITE_OK) return rc;
+
+    // idxStr: "mergeColumn|" followed by the member plan's own list
+    int mergeColumn = NO_MERGE;
+    if (pIdxInfo->orderByConsumed && pIdxInfo->nOrderBy == 1) {
+        mergeColumn = pIdxInfo->aOrderBy[0].iColumn;
+    }
+    std::string idxStr = std::to_string(mergeColumn) + "|" + (pIdxInfo->idxStr ? pIdxInfo->idxStr : "");
+    if (pIdxInfo->needToFreeIdxStr) {
+        sqlite3_free(pIdxInfo->idxStr);
+    }
+    pIdxInfo->idxStr = sqlite3_mprintf("%s", idxStr.c_str());
+    pIdxInfo->needToFreeIdxStr = 1;
+
+    // Every member runs the plan unless _source picked one; a key unique
+    // within each source may still repeat across them
+    bool sourcePicked = false;
+    for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+        if (pIdxInfo->aConstraint[i].iColumn == planner->sourceColumnIndex &&
+            pIdxInfo->aConstraintUsage[i].argvIndex > 0) {
+            sourcePicked = true;
+        }
+    }
+    double members = sourcePicked ? 1.0 : static_cast<double>(vtab->members.size());
+    pIdxInfo->estimatedCost *= members;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(static_cast<double>(pIdxInfo->estimatedRows) * members);
+    if (vtab->members.size() > 1) {
+        pIdxInfo->idxFlags &= ~SQLITE_INDEX_SCAN_UNIQUE;
+    }
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCursor) {
+    UnionVTab* vtab = static_cast<UnionVTab*>(pVTab);
+
+    UnionCursor* cursor = new UnionCursor();
+    memset(static_cast<sqlite3_vtab_cursor*>(cursor), 0, sizeof(sqlite3_vtab_cursor));
+    cursor->vtab = vtab;
+    cursor->livePosition = 0;
+    cursor->current = 0;
+    cursor->mergeColumn = NO_MERGE;
+    cursor->descending = false;
+    cursor->rowsLeft = UINT64_MAX;
+    cursor->atEof = true;
+    cursor->heads.resize(vtab->members.size());
+
+    for (FlatBufferVTab* member : vtab->members) {
+        sqlite3_vtab_cursor* memberCursor = nullptr;
+        FlatBufferVTabModule::xOpen(member, &memberCursor);
+        memberCursor->pVtab = member;
+        cursor->cursors.push_back(static_cast<FlatBufferCursor*>(memberCursor));
+    }
+
+    *ppCursor = cursor;
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xClose(sqlite3_vtab_cursor* pCursor) {
+    UnionCursor* cursor = static_cast<UnionCursor*>(pCursor);
+    for (FlatBufferCursor* memberCursor : cursor->cursors) {
+        FlatBufferVTabModule::xClose(memberCursor);
+    }
+    delete cursor;
+    return SQLITE_OK;
+}
+
+Value UnionVTabModule::mergeKey(const UnionCursor* cursor, size_t member) {
+    FlatBufferCursor* memberCursor = cursor->cursors[member];
+    const FlatBufferVTab* vtab = cursor->vtab->members[member];
+    if (cursor->mergeColumn < 0 || !vtab->extractor || !FlatBufferVTabModule::loadRecord(memberCursor)) {
+        return std::monostate{};
+    }
+    return vtab->extractor(memberCursor->currentData, memberCursor->currentLength,
+                           vtab->tableDef->columns[cursor->mergeColumn].name);
+}
+
+bool UnionVTabModule::mergesBefore(const UnionCursor* cursor, size_t a, size_t b) {
+    // Members return (key, sequence) order, reversed for DESC
+    int cmp = cursor->mergeColumn >= 0 ? compareValues(cursor->heads[a], cursor->heads[b]) : 0;
+    if (cmp == 0) {
+        uint64_t sa = cursor->cursors[a]->currentSequence;
+        uint64_t sb = cursor->cursors[b]->currentSequence;
+        cmp = sa < sb ? -1 : (sa > sb ? 1 : 0);
+    }
+    return cursor->descending ? cmp > 0 : cmp < 0;
+}
+
+int UnionVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
+                             int argc, sqlite3_value** argv) {
+    UnionCursor* cursor = static_cast<UnionCursor*>(pCursor);
+    UnionVTab* vtab = cursor->vtab;
+
+    const char* memberStr = idxStr ? std::strchr(idxStr, '|') : nullptr;
+    cursor->mergeColumn = memberStr ? std::atoi(idxStr) : NO_MERGE;
+    memberStr = memberStr && memberStr[1] ? memberStr + 1 : nullptr;
+    cursor->descending = FlatBufferVTabModule::isDescending(idxNum);
+    cursor->live.clear();
+    cursor->livePosition = 0;
+    cursor->atEof = true;
+
+    cursor->rowsLeft = FlatBufferVTabModule::pushedRowLimit(memberStr, argc, argv);
+    if (cursor->rowsLeft == 0) {
+        return SQLITE_OK;
+    }
+
+    // Sources ruled out by _source are never opened
+    for (size_t m = 0; m < vtab->members.size(); m++) {
+        if (!FlatBufferVTabModule::matchesSource(vtab->members[m], memberStr, argc, argv)) continue;
+        int rc = FlatBufferVTabModule::xFilter(cursor->cursors[m], idxNum, memberStr, argc, argv);
+        if (rc != SQLITE_OK) return rc;
+        if (!FlatBufferVTabModule::xEof(cursor->cursors[m])) {
+            cursor->live.push_back(m);
+        }
+    }
+    if (cursor->live.empty()) {
+        return SQLITE_OK;
+    }
+
+    if (cursor->mergeColumn != NO_MERGE) {
+        for (size_t m : cursor->live) {
+            cursor->heads[m] = mergeKey(cursor, m);
+        }
+        std::make_heap(cursor->live.begin(), cursor->live.end(), [cursor](size_t a, size_t b) {
+            return mergesBefore(cursor, b, a);
+        });
+    }
+    cursor->current = cursor->live.front();
+    cursor->atEof = false;
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
+    UnionCursor* cursor = static_cast<UnionCursor*>(pCursor);
+    if (--cursor->rowsLeft == 0) {
+        cursor->atEof = true;  // Pushed-down LIMIT reached
+        return SQLITE_OK;
+    }
+
+    FlatBufferCursor* memberCursor = cursor->cursors[cursor->current];
+    int rc = FlatBufferVTabModule::xNext(memberCursor);
+    if (rc != SQLITE_OK) return rc;
+    bool memberDone = FlatBufferVTabModule::xEof(memberCursor) != 0;
+
+    if (cursor->mergeColumn != NO_MERGE) {
+        // The current member is the heap top: take it out, re-key, put it back
+        auto later = [cursor](size_t a, size_t b) { return mergesBefore(cursor, b, a); };
+        std::pop_heap(cursor->live.begin(), cursor->live.end(), later);
+        if (memberDone) {
+            cursor->live.pop_back();
+        } else {
+            cursor->heads[cursor->current] = mergeKey(cursor, cursor->current);
+            std::push_heap(cursor->live.begin(), cursor->live.end(), later);
+        }
+        if (cursor->live.empty()) {
+            cursor->atEof = true;
+        } else {
+            cursor->current = cursor->live.front();
+        }
+        return SQLITE_OK;
+    }
+
+    if (memberDone && ++cursor->livePosition >= cursor->live.size()) {
+        cursor->atEof = true;
+    } else {
+        cursor->current = cursor->live[cursor->livePosition];
+    }
+    return SQLITE_OK;
+}
+
+int UnionVTabModule::xEof(sqlite3_vtab_cursor* pCursor) {
+    return static_cast<UnionCursor*>(pCursor)->atEof ? 1 : 0;
+}
+
+int UnionVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N) {
+    UnionCursor* cursor = static_cast<UnionCursor*>(pCursor);
+    return FlatBufferVTabModule::xColumn(cursor->cursors[cursor->current], ctx, N);
+}
+
+int UnionVTabModule::xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    UnionCursor* cursor = static_cast<UnionCursor*>(pCursor);
+    return FlatBufferVTabModule::xRowid(cursor->cursors[cursor->current], pRowid);
+}
+
+int UnionVTabModule::xFindFunction(sqlite3_vtab* pVTab, int nArg, const char* zName,
+                                   void (**pxFunc)(sqlite3_context*, int, sqlite3_value**),
+                                   void** ppArg) {
+    UnionVTab* vtab = static_cast<UnionVTab*>(pVTab);
+    return FlatBufferVTabModule::xFindFunction(vtab->members[vtab->planner], nArg, zName, pxFunc, ppArg);
+}
+
+}  // namespace flatsql
@@ -1,65 +1,63 @@
 #include "flatsql/sqlite_vtab.h"
+#include "flatsql/geo_functions.h"
+#include "flatsql/trace.h"
 #include "flatbuffers/encryption.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <iterator>
 #include <sstream>
+#include <type_traits>
 
 namespace flatsql {
 
-// Decrypt a column value in-place using the FlatBuffer field-level encryption scheme
-static void decryptColumnValue(Value& value,
-                                const flatbuffers::EncryptionContext& ctx,
-                                uint16_t fieldId) {
-    if (auto* s = std::get_if<std::string>(&value)) {
-        if (!s->empty()) {
-            flatbuffers::DecryptString(
-                reinterpret_cast<uint8_t*>(s->data()),
-                s->size(), ctx, fieldId);
-        }
-    } else if (auto* i64 = std::get_if<int64_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(i64), sizeof(int64_t), ctx, fieldId);
-    } else if (auto* i32 = std::get_if<int32_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(i32), sizeof(int32_t), ctx, fieldId);
-    } else if (auto* d = std::get_if<double>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(d), sizeof(double), ctx, fieldId);
-    } else if (auto* f = std::get_if<float>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(f), sizeof(float), ctx, fieldId);
-    } else if (auto* u64 = std::get_if<uint64_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(u64), sizeof(uint64_t), ctx, fieldId);
-    } else if (auto* u32 = std::get_if<uint32_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(u32), sizeof(uint32_t), ctx, fieldId);
-    } else if (auto* i16 = std::get_if<int16_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(i16), sizeof(int16_t), ctx, fieldId);
-    } else if (auto* u16 = std::get_if<uint16_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(u16), sizeof(uint16_t), ctx, fieldId);
-    } else if (auto* i8 = std::get_if<int8_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(i8), sizeof(int8_t), ctx, fieldId);
-    } else if (auto* u8val = std::get_if<uint8_t>(&value)) {
-        flatbuffers::DecryptScalar(
-            reinterpret_cast<uint8_t*>(u8val), sizeof(uint8_t), ctx, fieldId);
-    } else if (auto* blob = std::get_if<std::vector<uint8_t>>(&value)) {
-        if (!blob->empty()) {
-            uint8_t key[flatbuffers::kEncryptionKeySize];
-            uint8_t iv[flatbuffers::kEncryptionIVSize];
-            ctx.DeriveFieldKey(fieldId, key);
-            ctx.DeriveFieldIV(fieldId, iv);
-            flatbuffers::DecryptBytes(blob->data(), blob->size(), key, iv);
+static_assert(sizeof(FieldCipher::key) == flatbuffers::kEncryptionKeySize &&
+              sizeof(FieldCipher::iv) == flatbuffers::kEncryptionIVSize,
+              "FieldCipher must hold one field's key and IV");
+
+// Decrypted values a cursor keeps for encrypted columns
+static constexpr size_t DECRYPTED_VALUE_SLOTS = 256;
+
+// Records whose encrypted column a full scan decrypts in one call: the
+// current one and those just ahead of it
+static constexpr size_t DECRYPT_AHEAD = 8;
+
+// SchemaExtractor::FieldDecryptor over a FieldCipher
+static void decryptField(uint8_t* bytes, size_t size, const void* cipher) {
+    cryptField(bytes, size, *static_cast<const FieldCipher*>(cipher));
+}
+
+// Stored bytes of a column value, to be decrypted in place under the
+// FlatBuffer field-level encryption scheme (bools are never encrypted)
+static FieldSpan encryptedBytes(Value& value, const FieldCipher& cipher) {
+    FieldSpan span{nullptr, 0, &cipher};
+    std::visit([&span](auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::vector<uint8_t>>) {
+            span.bytes = reinterpret_cast<uint8_t*>(v.data());
+            span.size = v.size();
+        } else if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+            span.bytes = reinterpret_cast<uint8_t*>(&v);
+            span.size = sizeof(v);
         }
-    }
+    }, value);
+    return span;
+}
+
+static DecryptedValue& decryptedSlot(FlatBufferCursor* cursor, uint64_t sequence, int column) {
+    uint64_t key = sequence * static_cast<uint64_t>(cursor->numRealColumns) + static_cast<uint64_t>(column);
+    return cursor->decryptedValues[key % DECRYPTED_VALUE_SLOTS];
 }
 
 // Static module instance
+// xCreate is xConnect, which makes every source module an eponymous
+// virtual table: it exists by name without CREATE VIRTUAL TABLE and is
+// connected the first time a statement refers to it
 sqlite3_module FlatBufferVTabModule::module_ = {
     0,                          // iVersion
-    xCreate,                    // xCreate
+    xConnect,                   // xCreate
     xConnect,                   // xConnect
     xBestIndex,                 // xBestIndex
     xDisconnect,                // xDisconnect
@@ -76,7 +74,7 @@ sqlite3_module FlatBufferVTabModule::module_ = {
     nullptr,                    // xSync
     nullptr,                    // xCommit
     nullptr,                    // xRollback
-    nullptr,                    // xFindFunction
+    xFindFunction,              // xFindFunction
     nullptr,                    // xRename
     nullptr,                    // xSavepoint
     nullptr,                    // xRelease
@@ -117,11 +115,6 @@ std::string FlatBufferVTabModule::buildColumnDecl(const ColumnDef& col) {
     return decl;
 }
 
-int FlatBufferVTabModule::xCreate(sqlite3* db, void* pAux, int argc, const char* const* argv,
-                                   sqlite3_vtab** ppVTab, char** pzErr) {
-    return xConnect(db, pAux, argc, argv, ppVTab, pzErr);
-}
-
 int FlatBufferVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char* const* argv,
                                     sqlite3_vtab** ppVTab, char** pzErr) {
     (void)argc;
@@ -135,13 +128,36 @@ int FlatBufferVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char
         return SQLITE_ERROR;
     }
 
-    // Build CREATE TABLE statement for schema declaration
+    int rc = sqlite3_declare_vtab(db, buildTableDecl(*info->tableDef).c_str());
+    if (rc != SQLITE_OK) {
+        if (pzErr) {
+            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
+        }
+        return rc;
+    }
+
+    FlatBufferVTab* vtab = createVTab(*info);
+    vtab->createInfo = info;
+    info->connected = vtab;
+    *ppVTab = vtab;
+    return SQLITE_OK;
+}
+
+int FlatBufferVTabModule::rankColumnIndex(const TableDef& tableDef) {
+    for (const auto& col : tableDef.columns) {
+        if (col.fullText) {
+            // After _source, _rowid, _offset, _data and _geo (if any)
+            return static_cast<int>(tableDef.columns.size()) + 4 + (tableDef.geoLatColumn.empty() ? 0 : 1);
+        }
+    }
+    return -1;
+}
+
+std::string FlatBufferVTabModule::buildTableDecl(const TableDef& tableDef) {
     std::ostringstream sql;
     sql << "CREATE TABLE x(";
 
-    const TableDef& tableDef = *info->tableDef;
     bool first = true;
-
     for (const auto& col : tableDef.columns) {
         if (!first) sql << ", ";
         first = false;
@@ -156,38 +172,82 @@ int FlatBufferVTabModule::xConnect(sqlite3* db, void* pAux, int argc, const char
     sql << ", \"_offset\" INTEGER";
     sql << ", \"_data\" BLOB";
 
-    sql << ")";
+    // Point of a spatially indexed row, for geo_within()
+    if (!tableDef.geoLatColumn.empty()) {
+        sql << ", \"" << GEO_COLUMN << "\" BLOB HIDDEN";
+    }
 
-    int rc = sqlite3_declare_vtab(db, sql.str().c_str());
-    if (rc != SQLITE_OK) {
-        if (pzErr) {
-            *pzErr = sqlite3_mprintf("Failed to declare vtab: %s", sqlite3_errmsg(db));
-        }
-        return rc;
+    // Score of a row found by MATCH on a full-text column
+    if (rankColumnIndex(tableDef) >= 0) {
+        sql << ", \"" << RANK_COLUMN << "\" REAL HIDDEN";
     }
 
-    // Allocate our custom vtab structure
+    sql << ")";
+    return sql.str();
+}
+
+FlatBufferVTab* FlatBufferVTabModule::createVTab(const VTabCreateInfo& info) {
     FlatBufferVTab* vtab = new FlatBufferVTab();
     memset(static_cast<sqlite3_vtab*>(vtab), 0, sizeof(sqlite3_vtab));
 
-    vtab->store = info->store;
-    vtab->tableDef = info->tableDef;
-    vtab->sourceName = info->sourceName;
-    vtab->fileId = info->fileId;
-    vtab->extractor = info->extractor;
-    vtab->fastExtractor = info->fastExtractor;
-    vtab->indexes = info->indexes;
-    vtab->tombstones = info->tombstones;
-    vtab->sourceRecordInfos = info->sourceRecordInfos;
-    vtab->encryptionCtx = info->encryptionCtx;
-    vtab->sourceColumnIndex = static_cast<int>(tableDef.columns.size());  // _source is first virtual column
+    vtab->store = info.store;
+    vtab->tableDef = info.tableDef;
+    vtab->sourceName = info.sourceName;
+    vtab->fileId = info.fileId;
+    vtab->extractor = info.extractor;
+    vtab->fastExtractor = info.fastExtractor;
+    vtab->batchExtractor = info.batchExtractor;
+    vtab->indexes = info.indexes;
+    vtab->tombstones = info.tombstones;
+    vtab->sourceRecordInfos = info.sourceRecordInfos;
+    vtab->encryptionCtx = info.encryptionCtx;
+    if (info.encryptionCtx) {
+        vtab->fieldCiphers.resize(info.tableDef->columns.size());
+        for (size_t i = 0; i < info.tableDef->columns.size(); i++) {
+            const ColumnDef& col = info.tableDef->columns[i];
+            if (col.encrypted) {
+                info.encryptionCtx->DeriveFieldKey(col.fieldId, vtab->fieldCiphers[i].key);
+                info.encryptionCtx->DeriveFieldIV(col.fieldId, vtab->fieldCiphers[i].iv);
+                vtab->fieldCiphers[i].prepare();
+            }
+        }
+    }
+    vtab->snapshot = info.snapshot;
+    vtab->columnCaches = info.columnCaches;
+    vtab->zoneMaps = info.zoneMaps;
+    vtab->bloomFilters = info.bloomFilters;
+    vtab->schemaExtractor = info.schemaExtractor;
+    vtab->verification = info.verification;
+    vtab->queryStats = info.queryStats;
+    vtab->indexAdvisor = info.indexAdvisor;
+    vtab->createInfo = nullptr;
+    vtab->sourceColumnIndex = static_cast<int>(info.tableDef->columns.size());  // _source is first virtual column
+    vtab->rankColumnIndex = rankColumnIndex(*info.tableDef);
+    collectComposites(vtab);
+    return vtab;
+}
 
-    *ppVTab = vtab;
-    return SQLITE_OK;
+void FlatBufferVTabModule::collectComposites(FlatBufferVTab* vtab) {
+    // Plans number composites by their place here, so the order is fixed
+    static const std::string prefix = compositeIndexKey("");
+    std::vector<std::pair<const std::string*, const CompositeIndex*>> named;
+    for (const auto& [key, index] : vtab->indexes) {
+        if (index && key.compare(0, prefix.size(), prefix) == 0) {
+            named.push_back({&key, static_cast<const CompositeIndex*>(index)});
+        }
+    }
+    std::sort(named.begin(), named.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+    vtab->composites.clear();
+    for (const auto& entry : named) {
+        vtab->composites.push_back(entry.second);
+    }
 }
 
 int FlatBufferVTabModule::xDisconnect(sqlite3_vtab* pVTab) {
     FlatBufferVTab* vtab = static_cast<FlatBufferVTab*>(pVTab);
+    if (vtab->createInfo && vtab->createInfo->connected == vtab) {
+        vtab->createInfo->connected = nullptr;
+    }
     delete vtab;
     return SQLITE_OK;
 }
@@ -196,20 +256,247 @@ int FlatBufferVTabModule::xDestroy(sqlite3_vtab* pVTab) {
     return xDisconnect(pVTab);
 }
 
+// idxNum: low bits hold the strategy, range scans flag their bounds
+static constexpr int STRATEGY_MASK = 0x0F;
+static constexpr int RANGE_LOWER = 0x10;
+static constexpr int RANGE_UPPER = 0x20;
+static constexpr int ORDER_DESC = 0x40;  // Index results are returned in reverse
+static constexpr int ROW_BATCH = 0x80;   // Decode whole rows with the BatchExtractor
+static constexpr int RECORD_UNUSED = 0x40000000;  // Full scan reading no record bytes
+static constexpr int INDEX_COVERED = 0x20000000;  // Composite scan answered from its keys
+
+// Strategy 9 packs its equality count and composite below INDEX_COVERED
+static constexpr int COMPOSITE_EQ_SHIFT = 8;
+static constexpr int COMPOSITE_EQ_MASK = 0xFF;
+static constexpr int COMPOSITE_SHIFT = 16;
+static constexpr int COMPOSITE_MASK = 0x1FFF;
+
+// Share of a composite's entries assumed to match an equality on a key
+// column it has no statistics for yet
+static constexpr double PLANNED_COMPOSITE_FRACTION = 0.1;
+
+// A plan reading at least this share of a table's columns (and two or
+// more) decodes whole rows in one pass rather than one column at a time
+static constexpr double BATCH_COLUMN_SHARE = 0.5;
+
+// Tables are costed as at least this many rows: plans are cached with their
+// statements, so one prepared against a still-empty table must not lock in
+// a full scan
+static constexpr double MIN_PLANNED_ROWS = 1000.0;
+
+// Fetching a record through an index costs about this many sequential rows
+static constexpr double INDEX_ROW_COST = 2.0;
+
+// Reading an index entry without fetching its record (index intersection)
+static constexpr double INDEX_ENTRY_COST = 0.5;
+
+// List length assumed for col IN (...) (SQLite doesn't pass it to xBestIndex)
+static constexpr double PLANNED_IN_KEYS = 10.0;
+
+// Grid cells per region box probed by a spatial index scan
+static constexpr size_t GEO_COVER_CELLS = 32;
+
+// Share of a spatial index assumed matched by a region SQLite can't show us
+static constexpr double PLANNED_GEO_FRACTION = 0.01;
+
+// Share of a full-text index assumed to match a query SQLite can't show us
+static constexpr double PLANNED_MATCH_FRACTION = 0.01;
+
+// Share of a trigram index assumed to pass a pattern SQLite can't show us
+static constexpr double PLANNED_FUZZY_FRACTION = 0.01;
+
+// Regions covering at least this share of the plane are cheaper to test
+// against cached coordinates in a full scan than to fetch from the index
+static constexpr double GEO_SCAN_FRACTION = 0.25;
+
+// Constant numeric right-hand side of constraint i, if SQLite knows it
+static bool constraintNumber(sqlite3_index_info* pIdxInfo, int i, double& out) {
+    sqlite3_value* value = nullptr;
+    if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) != SQLITE_OK || !value) return false;
+    int type = sqlite3_value_type(value);
+    if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) return false;
+    out = sqlite3_value_double(value);
+    return true;
+}
+
+// Whether constraint i is an equality a Bloom filter can test: bytes only
+// compare equal under BINARY collation
+static bool bloomPushable(const FlatBufferVTab* vtab, sqlite3_index_info* pIdxInfo, int i) {
+    const auto& constraint = pIdxInfo->aConstraint[i];
+    if (!vtab->bloomFilters || constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) return false;
+    if (constraint.iColumn < 0 || constraint.iColumn >= static_cast<int>(vtab->bloomFilters->size())) return false;
+    if (!(*vtab->bloomFilters)[constraint.iColumn]) return false;
+    const char* collation = sqlite3_vtab_collation(pIdxInfo, i);
+    return !collation || sqlite3_stricmp(collation, "BINARY") == 0;
+}
+
+// Share of complete zones that every predicate leaves open (1 if none)
+static double openZoneFraction(const std::vector<ZonePredicate>& predicates) {
+    size_t zones = SIZE_MAX;
+    for (const ZonePredicate& predicate : predicates) {
+        zones = std::min(zones, predicate.zoneCount());
+    }
+    if (predicates.empty() || zones == 0) return 1.0;
+
+    size_t open = 0;
+    for (size_t zone = 0; zone < zones; zone++) {
+        bool possible = true;
+        for (const ZonePredicate& predicate : predicates) {
+            possible = possible && predicate.mayMatch(zone);
+        }
+        if (possible) open++;
+    }
+    return static_cast<double>(open) / static_cast<double>(zones);
+}
+
+// Whether every column a plan reads (colUsed) is held by composite or is a
+// virtual column answered without the record
+static bool compositeCovers(const FlatBufferVTab* vtab, const CompositeIndex* composite, sqlite3_uint64 colUsed) {
+    const int columnCount = static_cast<int>(vtab->tableDef->columns.size());
+    if (colUsed & (sqlite3_uint64(1) << 63)) return false;
+    for (int i = 0; i < 63; i++) {
+        if (!(colUsed & (sqlite3_uint64(1) << i))) continue;
+        bool answered = i < columnCount
+            ? composite->covers(i)
+            : i == vtab->sourceColumnIndex || i == columnCount + 1 || i == columnCount + 2;
+        if (!answered) return false;
+    }
+    return true;
+}
+
 int FlatBufferVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pIdxInfo) {
+    FLATSQL_TRACE_SCOPE("FlatBufferVTab::xBestIndex");
     FlatBufferVTab* vtab = static_cast<FlatBufferVTab*>(pVTab);
 
     // Analyze constraints to find best index strategy
-    // idxNum encoding (high bits = column index, low bits = strategy):
+    // idxNum encoding (bits 8+ = column index, bits 0-3 = strategy):
     //   0 = full scan
     //   1 = rowid equality
     //   2 + (colIdx << 8) = index equality on column colIdx
-    //   3 + (colIdx << 8) = index range on column colIdx
+    //   3 + (colIdx << 8) = index range on column colIdx; RANGE_LOWER /
+    //       RANGE_UPPER flag which bounds follow in argv, lower first
+    //   4 + (colIdx << 8) = index lookup of a whole IN list on column colIdx
+    //   5 = intersection (by sequence) of lookups on several indexed
+    //       columns, listed in idxStr as "column:op:argvIndex;"
+    //   6 = spatial index probe for geo_within(_geo, region), region in argv
+    //   7 + (colIdx << 8) = full-text index query (column MATCH query) on
+    //       column colIdx, query in argv
+    //   8 + (colIdx << 8) = trigram index candidates for
+    //       fuzzy_within(column, pattern) on column colIdx, pattern in argv
+    //   9 + (nEq << 8) + (composite << 16) = key range of a composite
+    //       index (vtab->composites[composite]): equalities on its first
+    //       nEq key columns, then RANGE_LOWER / RANGE_UPPER bounds on the
+    //       next, all in argv in that order
+    //   ORDER_DESC = index results are returned in reverse (ORDER BY ... DESC)
+    //   ROW_BATCH = the columns read (colUsed) make whole-row decoding pay
+    //   RECORD_UNUSED = a full scan whose columns read (colUsed) are all
+    //       answered without the record, so rows are never fetched
+    //   INDEX_COVERED = a composite scan whose columns read are all in the
+    //       index, so rows are decoded from its keys instead
+    //
+    // idxStr also carries full-scan predicates and a pushed-down LIMIT /
+    // OFFSET in the same "column:op:argvIndex;" form.
+    //
+    // One strategy drives the scan and its constraints come first in argv;
+    // SQLite checks the rest itself (argvIndex 0, not omitted).
+    //
+    // Costs are in sequential-row units: a full scan reads every row once,
+    // index paths pay a B-tree descent plus INDEX_ROW_COST per row fetched.
+    // Row estimates come from the index statistics (IndexStats).
+
+    const int columnCount = static_cast<int>(vtab->tableDef->columns.size());
+    const double tableRows = std::max(
+        MIN_PLANNED_ROWS, vtab->store ? static_cast<double>(vtab->store->getVisibleSequence()) : 0.0);
+
+    // Zone maps limit a full scan to the zones every known comparison on a
+    // zone-mapped column leaves open (but it still reads at least one), and
+    // Bloom filters to those that may hold a known string
+    std::vector<ZonePredicate> zonePredicates;
+    for (int i = 0; (vtab->zoneMaps || vtab->bloomFilters) && i < pIdxInfo->nConstraint; i++) {
+        const auto& constraint = pIdxInfo->aConstraint[i];
+        int colIdx = constraint.iColumn;
+        if (!constraint.usable || colIdx < 0 || colIdx >= columnCount) continue;
+        if (bloomPushable(vtab, pIdxInfo, i)) {
+            sqlite3_value* value = nullptr;
+            if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) == SQLITE_OK && value &&
+                sqlite3_value_type(value) == SQLITE_TEXT) {
+                ZonePredicate predicate{nullptr, {}};
+                predicate.bloom = (*vtab->bloomFilters)[colIdx].get();
+                predicate.hash = ZoneBloomFilter::hash(sqlite3_value_text(value),
+                                                       static_cast<size_t>(sqlite3_value_bytes(value)));
+                zonePredicates.push_back(predicate);
+            }
+            continue;
+        }
+        if (!vtab->zoneMaps || !(*vtab->zoneMaps)[colIdx]) continue;
+        ColumnCache::CompareOp op;
+        switch (constraint.op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ: op = ColumnCache::CompareOp::Eq; break;
+            case SQLITE_INDEX_CONSTRAINT_LT: op = ColumnCache::CompareOp::Lt; break;
+            case SQLITE_INDEX_CONSTRAINT_LE: op = ColumnCache::CompareOp::Le; break;
+            case SQLITE_INDEX_CONSTRAINT_GT: op = ColumnCache::CompareOp::Gt; break;
+            case SQLITE_INDEX_CONSTRAINT_GE: op = ColumnCache::CompareOp::Ge; break;
+            default: continue;
+        }
+        const ZoneMap* zones = (*vtab->zoneMaps)[colIdx].get();
+        sqlite3_value* value = nullptr;
+        ColumnCache::Comparison comparison;
+        if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) == SQLITE_OK && value &&
+            ColumnCache::makeComparison(zones->isReal(), op, valueFromSqlite(value), comparison)) {
+            zonePredicates.push_back({zones, comparison});
+        }
+    }
+    const double zoneFraction = openZoneFraction(zonePredicates);
+    const double scanRows = zoneFraction < 1.0
+        ? std::min(tableRows, std::max(static_cast<double>(ZoneMap::ZONE_ROWS), zoneFraction * tableRows))
+        : tableRows;
 
     int idxNum = 0;
-    double estimatedCost = 1000000.0;  // Full scan cost
-    int argvIndex = 1;
-    int usableConstraints = 0;
+    double estimatedCost = scanRows;  // Full scan cost
+    double estimatedRows = scanRows;
+    bool unique = false;
+    int chosen[2] = {-1, -1};  // Driving constraints, in argv order
+    bool chosenIn = false;
+
+    auto consider = [&](int strategy, double cost, double rows, bool isUnique,
+                        int first, int second) {
+        if (cost >= estimatedCost) return;
+        idxNum = strategy;
+        estimatedCost = cost;
+        estimatedRows = rows;
+        unique = isUnique;
+        chosen[0] = first;
+        chosen[1] = second;
+        chosenIn = false;
+    };
+
+    // Range bounds per indexed column, paired up after the scan
+    std::vector<int> lowerBounds(columnCount, -1);
+    std::vector<int> upperBounds(columnCount, -1);
+
+    // One lookup per indexed column (equality, else range), for intersection
+    struct IndexProbe {
+        int constraints[2];
+        double rows;
+        double entries;
+        bool equality;
+    };
+    std::vector<IndexProbe> probes;
+    std::vector<bool> probed(columnCount, false);
+
+    // Cheapest MATCH plan, kept in case _rank is read (below)
+    struct MatchPlan {
+        int strategy = 0;
+        int constraint = -1;
+        double cost = 0.0;
+        double rows = 0.0;
+    } matchPlan;
+
+    // _geo follows _data; xFindFunction only overloads geo_within() on
+    // tables with a spatial index
+    const int geoColumn = columnCount + 4;
+    auto geoIt = vtab->indexes.find(GEO_COLUMN);
+    const Index* geoIndex = geoIt != vtab->indexes.end() ? geoIt->second : nullptr;
 
     for (int i = 0; i < pIdxInfo->nConstraint; i++) {
         const auto& constraint = pIdxInfo->aConstraint[i];
@@ -217,73 +504,524 @@ int FlatBufferVTabModule::xBestIndex(sqlite3_vtab* pVTab, sqlite3_index_info* pI
 
         int colIdx = constraint.iColumn;
 
-        // Check for rowid lookup (column -1 is rowid)
-        if (colIdx == -1 && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
-            idxNum = 1;
-            pIdxInfo->aConstraintUsage[i].argvIndex = argvIndex++;
-            pIdxInfo->aConstraintUsage[i].omit = 1;
-            estimatedCost = 1.0;
-            usableConstraints++;
+        // geo_within(_geo, region): rows are estimated from the area of the
+        // region's bounding box, as if points were spread evenly
+        if (constraint.op == SQLITE_INDEX_CONSTRAINT_FUNCTION && colIdx == geoColumn && geoIndex) {
+            double entries = std::max(MIN_PLANNED_ROWS, static_cast<double>(geoIndex->getStats().entries));
+            double fraction = PLANNED_GEO_FRACTION;
+            sqlite3_value* value = nullptr;
+            GeoRegion region;
+            if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) == SQLITE_OK && value &&
+                GeoRegion::decode(sqlite3_value_blob(value), sqlite3_value_bytes(value), region)) {
+                fraction = region.boxFraction();
+            }
+            double rows = std::max(1.0, fraction * entries);
+            consider(6, GEO_COVER_CELLS * std::log2(entries) + INDEX_ROW_COST * rows, rows, false, i, -1);
+            continue;
+        }
+
+        // column MATCH 'query': rows are estimated from the query's rarest
+        // term. Without a full-text index SQLite calls match() per row.
+        if (constraint.op == SQLITE_INDEX_CONSTRAINT_MATCH && colIdx >= 0 && colIdx < columnCount) {
+            auto ftsIt = vtab->indexes.find(fullTextIndexKey(vtab->tableDef->columns[colIdx].name));
+            if (ftsIt == vtab->indexes.end() || !ftsIt->second) continue;
+            const FullTextIndex* fts = static_cast<const FullTextIndex*>(ftsIt->second);
+            double entries = std::max(MIN_PLANNED_ROWS, static_cast<double>(fts->getStats().entries));
+            double rows = PLANNED_MATCH_FRACTION * entries;
+            sqlite3_value* value = nullptr;
+            if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) == SQLITE_OK && value &&
+                sqlite3_value_type(value) == SQLITE_TEXT) {
+                rows = static_cast<double>(fts->estimateMatches(
+                    std::string_view(reinterpret_cast<const char*>(sqlite3_value_text(value)),
+                                     static_cast<size_t>(sqlite3_value_bytes(value)))));
+            }
+            rows = std::max(1.0, rows);
+            double cost = std::log2(entries) + INDEX_ROW_COST * rows;
+            if (matchPlan.constraint < 0 || cost < matchPlan.cost) {
+                matchPlan = {7 + (colIdx << 8), i, cost, rows};
+            }
+            consider(matchPlan.strategy, cost, rows, false, i, -1);
             continue;
         }
 
-        // Skip virtual columns for index optimization
-        if (colIdx >= static_cast<int>(vtab->tableDef->columns.size())) {
-            // Check if filtering by _source
-            if (colIdx == vtab->sourceColumnIndex && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
-                // _source filter - we can use this to skip the table entirely
-                // if it doesn't match our source name (handled at xFilter time)
-                pIdxInfo->aConstraintUsage[i].argvIndex = argvIndex++;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                usableConstraints++;
+        // fuzzy_within(column, pattern): rows are bounded by the postings
+        // of the pattern's rarest trigrams; fuzzy_within() checks them all
+        if (constraint.op == SQLITE_INDEX_CONSTRAINT_FUNCTION && colIdx >= 0 && colIdx < columnCount) {
+            auto trigramIt = vtab->indexes.find(trigramIndexKey(vtab->tableDef->columns[colIdx].name));
+            if (trigramIt == vtab->indexes.end() || !trigramIt->second) continue;
+            const TrigramIndex* trigrams = static_cast<const TrigramIndex*>(trigramIt->second);
+            double entries = std::max(MIN_PLANNED_ROWS, static_cast<double>(trigrams->getStats().entries));
+            double rows = PLANNED_FUZZY_FRACTION * entries;
+            sqlite3_value* value = nullptr;
+            if (sqlite3_vtab_rhs_value(pIdxInfo, i, &value) == SQLITE_OK && value &&
+                sqlite3_value_type(value) == SQLITE_TEXT) {
+                std::string_view target;
+                uint32_t maxDistance = 0;
+                TrigramIndex::parsePattern(
+                    std::string_view(reinterpret_cast<const char*>(sqlite3_value_text(value)),
+                                     static_cast<size_t>(sqlite3_value_bytes(value))),
+                    target, maxDistance);
+                rows = static_cast<double>(trigrams->estimateCandidates(target, maxDistance));
             }
+            rows = std::max(1.0, rows);
+            consider(8 + (colIdx << 8), std::log2(entries) + INDEX_ROW_COST * rows, rows, false, i, -1);
             continue;
         }
 
-        // Get column name
-        const std::string& colName = vtab->tableDef->columns[colIdx].name;
+        // Check for rowid lookup (column -1 is rowid)
+        if (colIdx == -1 && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            consider(1, 1.0, 1.0, true, i, -1);
+            continue;
+        }
+
+        // Virtual columns (_source, _rowid, _offset) have no index
+        if (colIdx < 0 || colIdx >= columnCount) continue;
 
         // Check if we have an index for this column
-        auto indexIt = vtab->indexes.find(colName);
-        if (indexIt != vtab->indexes.end() && indexIt->second != nullptr) {
+        const ColumnDef& column = vtab->tableDef->columns[colIdx];
+        auto indexIt = vtab->indexes.find(column.name);
+        if (indexIt == vtab->indexes.end() || indexIt->second == nullptr) continue;
+
+        if (constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            IndexStats stats = indexIt->second->getStats();
+            double descent = std::log2(std::max(MIN_PLANNED_ROWS, static_cast<double>(stats.entries)));
+            double rows = column.primaryKey ? 1.0 : stats.equalityRows();
+
+            // col IN (...) arrives as EQ; take the whole list in one
+            // xFilter call when SQLite allows it
+            if (sqlite3_vtab_in(pIdxInfo, i, -1)) {
+                double before = estimatedCost;
+                consider(4 + (colIdx << 8), PLANNED_IN_KEYS * (descent + INDEX_ROW_COST * rows),
+                         PLANNED_IN_KEYS * rows, false, i, -1);
+                chosenIn = estimatedCost < before;
+            } else {
+                consider(2 + (colIdx << 8), descent + INDEX_ROW_COST * rows, rows,
+                         column.primaryKey, i, -1);
+                if (!probed[colIdx]) {
+                    probed[colIdx] = true;
+                    probes.push_back({{i, -1}, rows,
+                                      std::max(MIN_PLANNED_ROWS, static_cast<double>(stats.entries)), true});
+                }
+            }
+        } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_GE ||
+                   constraint.op == SQLITE_INDEX_CONSTRAINT_GT) {
+            if (lowerBounds[colIdx] < 0) lowerBounds[colIdx] = i;
+        } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_LE ||
+                   constraint.op == SQLITE_INDEX_CONSTRAINT_LT) {
+            if (upperBounds[colIdx] < 0) upperBounds[colIdx] = i;
+        }
+    }
+
+    // Range scan per column with bounds (kept for ORDER BY below)
+    std::vector<double> rangeRows(columnCount, 0.0);
+    auto rangeStrategy = [&](int colIdx) {
+        return 3 + (colIdx << 8) + (lowerBounds[colIdx] >= 0 ? RANGE_LOWER : 0) +
+               (upperBounds[colIdx] >= 0 ? RANGE_UPPER : 0);
+    };
+    for (int colIdx = 0; colIdx < columnCount; colIdx++) {
+        int lower = lowerBounds[colIdx];
+        int upper = upperBounds[colIdx];
+        if (lower < 0 && upper < 0) continue;
+
+        // Bounds SQLite can't show us (parameters, join columns) are
+        // assumed to keep a third of the entries each
+        IndexStats stats = vtab->indexes.at(vtab->tableDef->columns[colIdx].name)->getStats();
+        double lo = 0.0, hi = 0.0;
+        bool loKnown = lower >= 0 && constraintNumber(pIdxInfo, lower, lo);
+        bool hiKnown = upper >= 0 && constraintNumber(pIdxInfo, upper, hi);
+        double fraction = stats.rangeFraction(loKnown ? &lo : nullptr, hiKnown ? &hi : nullptr);
+        if (lower >= 0 && !loKnown) fraction /= 3.0;
+        if (upper >= 0 && !hiKnown) fraction /= 3.0;
+
+        double entries = std::max(MIN_PLANNED_ROWS, static_cast<double>(stats.entries));
+        double rows = std::max(1.0, fraction * entries);
+        rangeRows[colIdx] = rows;
+        consider(rangeStrategy(colIdx), std::log2(entries) + INDEX_ROW_COST * rows, rows, false,
+                 lower >= 0 ? lower : upper, lower >= 0 ? upper : -1);
+        if (!probed[colIdx]) {
+            probes.push_back({{lower >= 0 ? lower : upper, lower >= 0 ? upper : -1},
+                              rows, entries, false});
+        }
+    }
+
+    // Composite indexes: equalities on leading key columns and at most a
+    // range on the next one form one key range. Its bounds hold every
+    // match but may hold more (constraints the key encoding can't take),
+    // so SQLite checks them all again. Columns are assumed independent.
+    std::vector<int> compositeConstraints;  // Of the chosen composite plan, in argv order
+    if (!vtab->composites.empty()) {
+        std::vector<int> equalities(columnCount, -1), lows(columnCount, -1), highs(columnCount, -1);
+        for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+            const auto& constraint = pIdxInfo->aConstraint[i];
+            int colIdx = constraint.iColumn;
+            if (!constraint.usable || colIdx < 0 || colIdx >= columnCount) continue;
+            ValueType type = vtab->tableDef->columns[colIdx].type;
+            if (type == ValueType::String || type == ValueType::Bytes) {
+                const char* collation = sqlite3_vtab_collation(pIdxInfo, i);
+                if (collation && sqlite3_stricmp(collation, "BINARY") != 0) continue;
+            }
             if (constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
-                // Encode column index in idxNum (strategy 2 + column << 8)
-                idxNum = 2 + (colIdx << 8);
-                pIdxInfo->aConstraintUsage[i].argvIndex = argvIndex++;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                estimatedCost = 10.0;  // Index lookup cost
-                usableConstraints++;
-            } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_GE ||
-                       constraint.op == SQLITE_INDEX_CONSTRAINT_GT ||
-                       constraint.op == SQLITE_INDEX_CONSTRAINT_LE ||
-                       constraint.op == SQLITE_INDEX_CONSTRAINT_LT) {
-                // Range query - encode column index in idxNum (strategy 3 + column << 8)
-                if ((idxNum & 0xFF) < 2) {  // Don't override equality
-                    idxNum = 3 + (colIdx << 8);
+                if (equalities[colIdx] < 0 && !sqlite3_vtab_in(pIdxInfo, i, -1)) equalities[colIdx] = i;
+            } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_GE || constraint.op == SQLITE_INDEX_CONSTRAINT_GT) {
+                if (lows[colIdx] < 0) lows[colIdx] = i;
+            } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_LE || constraint.op == SQLITE_INDEX_CONSTRAINT_LT) {
+                if (highs[colIdx] < 0) highs[colIdx] = i;
+            }
+        }
+
+        for (size_t c = 0; c < vtab->composites.size() && c <= static_cast<size_t>(COMPOSITE_MASK); c++) {
+            const CompositeIndex* composite = vtab->composites[c];
+            const auto& keys = composite->getKeyColumns();
+            double entries = std::max(MIN_PLANNED_ROWS, static_cast<double>(composite->getStats().entries));
+            double fraction = 1.0;
+            std::vector<int> used;
+
+            size_t nEq = 0;
+            while (nEq < keys.size() && nEq < static_cast<size_t>(COMPOSITE_EQ_MASK) &&
+                   equalities[keys[nEq].ordinal] >= 0) {
+                IndexStats column = composite->getColumnStats(nEq);
+                fraction *= column.entries > 0 ? column.equalityRows() / static_cast<double>(column.entries)
+                                               : PLANNED_COMPOSITE_FRACTION;
+                used.push_back(equalities[keys[nEq].ordinal]);
+                nEq++;
+            }
+
+            int flags = 0;
+            if (nEq < keys.size()) {
+                int lower = lows[keys[nEq].ordinal];
+                int upper = highs[keys[nEq].ordinal];
+                if (lower >= 0 || upper >= 0) {
+                    IndexStats column = composite->getColumnStats(nEq);
+                    double lo = 0.0, hi = 0.0;
+                    bool loKnown = lower >= 0 && constraintNumber(pIdxInfo, lower, lo);
+                    bool hiKnown = upper >= 0 && constraintNumber(pIdxInfo, upper, hi);
+                    double rangeFraction = column.rangeFraction(loKnown ? &lo : nullptr, hiKnown ? &hi : nullptr);
+                    if (lower >= 0 && !loKnown) rangeFraction /= 3.0;
+                    if (upper >= 0 && !hiKnown) rangeFraction /= 3.0;
+                    fraction *= rangeFraction;
+                    if (lower >= 0) {
+                        used.push_back(lower);
+                        flags |= RANGE_LOWER;
+                    }
+                    if (upper >= 0) {
+                        used.push_back(upper);
+                        flags |= RANGE_UPPER;
+                    }
                 }
-                pIdxInfo->aConstraintUsage[i].argvIndex = argvIndex++;
-                pIdxInfo->aConstraintUsage[i].omit = 0;  // Don't omit - SQLite will double-check
-                estimatedCost = 100.0;  // Range scan cost
-                usableConstraints++;
             }
+            if (used.empty()) continue;
+
+            // A covered scan reads entries only, like an intersection
+            double rows = std::max(1.0, fraction * entries);
+            bool covered = compositeCovers(vtab, composite, pIdxInfo->colUsed);
+            double before = estimatedCost;
+            consider(9 | (static_cast<int>(nEq) << COMPOSITE_EQ_SHIFT) | (static_cast<int>(c) << COMPOSITE_SHIFT) | flags,
+                     std::log2(entries) + (covered ? INDEX_ENTRY_COST : INDEX_ROW_COST) * rows, rows, false, -1, -1);
+            if (estimatedCost < before) compositeConstraints = std::move(used);
         }
     }
 
-    pIdxInfo->idxNum = idxNum;
-    pIdxInfo->estimatedCost = estimatedCost;
+    // Intersection: starting from the most selective lookup, add lookups
+    // while the records they save fetching outweigh reading their entries.
+    // Columns are assumed independent.
+    std::vector<const IndexProbe*> intersected;
+    if (probes.size() >= 2 && !unique) {
+        std::sort(probes.begin(), probes.end(), [](const IndexProbe& a, const IndexProbe& b) {
+            return a.rows < b.rows;
+        });
+        double fetched = probes[0].rows;
+        double cost = std::log2(probes[0].entries) + INDEX_ENTRY_COST * probes[0].rows;
+        intersected.push_back(&probes[0]);
+        for (size_t p = 1; p < probes.size(); p++) {
+            const IndexProbe& probe = probes[p];
+            double narrowed = fetched * probe.rows / probe.entries;
+            double added = std::log2(probe.entries) + INDEX_ENTRY_COST * probe.rows;
+            if (added + INDEX_ROW_COST * narrowed < INDEX_ROW_COST * fetched) {
+                intersected.push_back(&probe);
+                cost += added;
+                fetched = narrowed;
+            }
+        }
+        fetched = std::max(1.0, fetched);
+        if (intersected.size() >= 2 && cost + INDEX_ROW_COST * fetched < estimatedCost) {
+            idxNum = 5;
+            estimatedCost = cost + INDEX_ROW_COST * fetched;
+            estimatedRows = fetched;
+            chosen[0] = chosen[1] = -1;
+            chosenIn = false;
+        } else {
+            intersected.clear();
+        }
+    }
+
+    // Only a full-text plan knows the scores, so reading _rank makes MATCH
+    // drive the scan whatever else is cheaper
+    const int rankColumn = vtab->rankColumnIndex;
+    bool rankUsed = rankColumn >= 0 &&
+                    (pIdxInfo->colUsed & (sqlite3_uint64(1) << std::min(rankColumn, 63))) != 0;
+    if (rankUsed && matchPlan.constraint >= 0 && (idxNum & STRATEGY_MASK) != 7) {
+        idxNum = matchPlan.strategy;
+        estimatedCost = matchPlan.cost;
+        estimatedRows = matchPlan.rows;
+        unique = false;
+        chosen[0] = matchPlan.constraint;
+        chosen[1] = -1;
+        chosenIn = false;
+        intersected.clear();
+    }
 
-    // If we have an index, indicate row count estimate
-    int strategy = idxNum & 0xFF;
-    if (vtab->store) {
-        if (strategy == 0) {
-            pIdxInfo->estimatedRows = vtab->store->getRecordCount();
-        } else if (strategy == 1) {
-            pIdxInfo->estimatedRows = 1;
-        } else if (strategy == 2) {
-            pIdxInfo->estimatedRows = 10;  // Estimate for equality lookup
+    // LIMIT / OFFSET can only be applied here if nothing is left for SQLite
+    // to filter; with only them present, the cap shortens ordered scans
+    int limitConstraint = -1, offsetConstraint = -1;
+    bool onlyLimit = true;
+    for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+        const auto& constraint = pIdxInfo->aConstraint[i];
+        if (constraint.op == SQLITE_INDEX_CONSTRAINT_LIMIT && constraint.usable) {
+            limitConstraint = i;
+        } else if (constraint.op == SQLITE_INDEX_CONSTRAINT_OFFSET && constraint.usable) {
+            offsetConstraint = i;
         } else {
-            pIdxInfo->estimatedRows = vtab->store->getRecordCount() / 10;  // Estimate for range
+            onlyLimit = false;
+        }
+    }
+    double rowCap = INFINITY;
+    double limit = 0.0, offset = 0.0;
+    if (limitConstraint >= 0 && constraintNumber(pIdxInfo, limitConstraint, limit) && limit >= 0 &&
+        (offsetConstraint < 0 || constraintNumber(pIdxInfo, offsetConstraint, offset))) {
+        rowCap = limit + std::max(0.0, offset);
+    }
+
+    // ORDER BY on one column: consumed if the chosen plan already returns
+    // rows in that order (index scans in key order, everything else by
+    // sequence), otherwise worth an ordered index scan when that beats
+    // scanning and sorting
+    bool orderConsumed = false;
+    bool descending = false;
+    if (pIdxInfo->nOrderBy == 1) {
+        int orderColumn = pIdxInfo->aOrderBy[0].iColumn;
+        descending = pIdxInfo->aOrderBy[0].desc != 0;
+        int strategy = idxNum & STRATEGY_MASK;
+        if (orderColumn == -1) {
+            orderConsumed = strategy == 1 || strategy == 2 || strategy == 5 || strategy == 6 ||
+                            strategy == 7 || strategy == 8 || (strategy == 0 && !descending);
+        } else if (orderColumn >= 0 && orderColumn < columnCount) {
+            orderConsumed = strategy >= 2 && strategy <= 4 && (idxNum >> 8) == orderColumn;
+
+            // A composite range is in order of its equality columns (each
+            // a constant) and of the key column after them
+            if (strategy == 9) {
+                const CompositeIndex* composite =
+                    vtab->composites[(idxNum >> COMPOSITE_SHIFT) & COMPOSITE_MASK];
+                size_t nEq = static_cast<size_t>((idxNum >> COMPOSITE_EQ_SHIFT) & COMPOSITE_EQ_MASK);
+                for (size_t k = 0; k <= nEq && k < composite->getKeyColumns().size(); k++) {
+                    orderConsumed = orderConsumed || composite->getKeyColumns()[k].ordinal == orderColumn;
+                }
+            }
+
+            // Indexes hold no NULL keys, so without bounds an index scan
+            // only covers every row of a primary-key or required column
+            const ColumnDef& column = vtab->tableDef->columns[orderColumn];
+            bool covering = rangeRows[orderColumn] > 0.0 || column.primaryKey || !column.nullable;
+            auto indexIt = vtab->indexes.find(column.name);
+            if (!orderConsumed && covering && !(rankUsed && strategy == 7) && indexIt != vtab->indexes.end() && indexIt->second) {
+                double entries = std::max(MIN_PLANNED_ROWS,
+                                          static_cast<double>(indexIt->second->getStats().entries));
+                double rows = rangeRows[orderColumn] > 0.0 ? rangeRows[orderColumn] : entries;
+                double fetched = onlyLimit ? std::min(rows, rowCap) : rows;
+                double orderedCost = std::log2(entries) + INDEX_ROW_COST * std::max(1.0, fetched);
+                double sortCost = estimatedRows * std::log2(std::max(2.0, estimatedRows));
+                if (orderedCost < estimatedCost + sortCost) {
+                    int lower = lowerBounds[orderColumn], upper = upperBounds[orderColumn];
+                    idxNum = rangeStrategy(orderColumn);
+                    estimatedCost = orderedCost;
+                    estimatedRows = rows;
+                    unique = false;
+                    chosen[0] = lower >= 0 ? lower : upper;
+                    chosen[1] = lower >= 0 ? upper : -1;
+                    chosenIn = false;
+                    intersected.clear();
+                    orderConsumed = true;
+                }
+            }
+        }
+    }
+    if (orderConsumed) {
+        pIdxInfo->orderByConsumed = 1;
+        if (descending) idxNum |= ORDER_DESC;
+    }
+
+    int argvIndex = 1;
+    int strategy = idxNum & STRATEGY_MASK;
+    for (int c : chosen) {
+        if (c < 0) continue;
+        pIdxInfo->aConstraintUsage[c].argvIndex = argvIndex++;
+        // Range scans use inclusive bounds, spatial probes return every
+        // point of the covering cells and trigram probes every candidate -
+        // SQLite double-checks them
+        pIdxInfo->aConstraintUsage[c].omit = strategy == 3 || strategy == 6 || strategy == 8 ? 0 : 1;
+    }
+    if (chosenIn) {
+        sqlite3_vtab_in(pIdxInfo, chosen[0], 1);
+    }
+    if (strategy == 9) {
+        for (int c : compositeConstraints) {
+            pIdxInfo->aConstraintUsage[c].argvIndex = argvIndex++;
+            pIdxInfo->aConstraintUsage[c].omit = 0;
+        }
+        const CompositeIndex* composite = vtab->composites[(idxNum >> COMPOSITE_SHIFT) & COMPOSITE_MASK];
+        if (compositeCovers(vtab, composite, pIdxInfo->colUsed)) idxNum |= INDEX_COVERED;
+    }
+
+    // Constraint list for idxStr: "column:op:argvIndex;" entries (column
+    // -1 for LIMIT / OFFSET, whose iColumn is meaningless)
+    std::string constraintList;
+    auto listConstraint = [&](int i, bool omit) {
+        int op = pIdxInfo->aConstraint[i].op;
+        bool limitOp = op == SQLITE_INDEX_CONSTRAINT_LIMIT || op == SQLITE_INDEX_CONSTRAINT_OFFSET;
+        pIdxInfo->aConstraintUsage[i].argvIndex = argvIndex;
+        pIdxInfo->aConstraintUsage[i].omit = omit ? 1 : 0;
+        constraintList += std::to_string(limitOp ? -1 : pIdxInfo->aConstraint[i].iColumn) + ":" +
+                          std::to_string(pIdxInfo->aConstraint[i].op) + ":" +
+                          std::to_string(argvIndex) + ";";
+        argvIndex++;
+    };
+    for (const IndexProbe* probe : intersected) {
+        for (int c : probe->constraints) {
+            if (c >= 0) listConstraint(c, probe->equality);
+        }
+    }
+
+    // Full scans evaluate comparisons on cached columns themselves, so rows
+    // that fail never reach the VDBE, and skip zones a zone map or Bloom
+    // filter rules out (already costed above). SQLite still re-checks each
+    // surviving row (omit = 0), which keeps text-affinity and other edge
+    // cases exact.
+    if (strategy == 0 && (vtab->columnCaches || vtab->zoneMaps || vtab->bloomFilters)) {
+        for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+            const auto& constraint = pIdxInfo->aConstraint[i];
+            int colIdx = constraint.iColumn;
+            if (!constraint.usable || pIdxInfo->aConstraintUsage[i].argvIndex != 0) continue;
+            if (colIdx < 0 || colIdx >= columnCount) continue;
+            if (bloomPushable(vtab, pIdxInfo, i)) {
+                listConstraint(i, false);
+                continue;
+            }
+            bool cached = vtab->columnCaches && (*vtab->columnCaches)[colIdx];
+            bool zoned = vtab->zoneMaps && (*vtab->zoneMaps)[colIdx];
+            if (!cached && !zoned) continue;
+            switch (constraint.op) {
+                case SQLITE_INDEX_CONSTRAINT_EQ:
+                case SQLITE_INDEX_CONSTRAINT_LT:
+                case SQLITE_INDEX_CONSTRAINT_LE:
+                case SQLITE_INDEX_CONSTRAINT_GT:
+                case SQLITE_INDEX_CONSTRAINT_GE:
+                    break;
+                default:
+                    continue;
+            }
+            listConstraint(i, false);
+            if (cached) estimatedCost *= 0.5;
+        }
+    }
+
+    // Comparisons SQLite is left to check on unindexed columns are listed
+    // without an argv slot (argvIndex 0) for the index advisor: xFilter
+    // charges the scan's rows to each of their columns
+    if (strategy == 0 && vtab->indexAdvisor && vtab->indexAdvisor->enabled()) {
+        for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+            const auto& constraint = pIdxInfo->aConstraint[i];
+            int colIdx = constraint.iColumn;
+            if (!constraint.usable || pIdxInfo->aConstraintUsage[i].argvIndex != 0) continue;
+            if (colIdx < 0 || colIdx >= columnCount) continue;
+            const ColumnDef& column = vtab->tableDef->columns[colIdx];
+            if (column.encrypted || vtab->indexes.count(column.name)) continue;
+            switch (constraint.op) {
+                case SQLITE_INDEX_CONSTRAINT_EQ:
+                case SQLITE_INDEX_CONSTRAINT_LT:
+                case SQLITE_INDEX_CONSTRAINT_LE:
+                case SQLITE_INDEX_CONSTRAINT_GT:
+                case SQLITE_INDEX_CONSTRAINT_GE:
+                    constraintList += std::to_string(colIdx) + ":" + std::to_string(constraint.op) + ":0;";
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // The table serves a single source, so _source = 'name' (or IN a list)
+    // keeps every row or none; xFilter decides once instead of per row
+    for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+        const auto& constraint = pIdxInfo->aConstraint[i];
+        if (!constraint.usable || constraint.iColumn != vtab->sourceColumnIndex ||
+            constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        const char* collation = sqlite3_vtab_collation(pIdxInfo, i);
+        if (collation && sqlite3_stricmp(collation, "BINARY") != 0) continue;
+        if (sqlite3_vtab_in(pIdxInfo, i, -1)) {
+            sqlite3_vtab_in(pIdxInfo, i, 1);
+        }
+        listConstraint(i, true);
+    }
+
+    // LIMIT (and OFFSET, which SQLite still applies) are listed too once
+    // every other constraint is enforced here and no sort follows; xNext
+    // then stops after LIMIT + OFFSET rows
+    if (limitConstraint >= 0 && (pIdxInfo->nOrderBy == 0 || orderConsumed)) {
+        bool exact = true;
+        for (int i = 0; i < pIdxInfo->nConstraint && exact; i++) {
+            if (i == limitConstraint || i == offsetConstraint) continue;
+            exact = pIdxInfo->aConstraintUsage[i].argvIndex > 0 && pIdxInfo->aConstraintUsage[i].omit;
+        }
+        if (exact) {
+            listConstraint(limitConstraint, true);
+            if (offsetConstraint >= 0) listConstraint(offsetConstraint, false);
+            if (rowCap < estimatedRows) {
+                estimatedCost *= rowCap / estimatedRows;
+                estimatedRows = rowCap;
+            }
+        }
+    }
+
+    if (!constraintList.empty()) {
+        pIdxInfo->idxStr = sqlite3_mprintf("%s", constraintList.c_str());
+        pIdxInfo->needToFreeIdxStr = 1;
+    }
+
+    // Wide projections decode each row once: colUsed has a bit per column
+    // below 63, and bit 63 stands for every column from there on
+    if (vtab->batchExtractor) {
+        int used = 0;
+        for (int i = 0; i < columnCount && i < 63; i++) {
+            if (pIdxInfo->colUsed & (sqlite3_uint64(1) << i)) used++;
+        }
+        if (columnCount > 63 && (pIdxInfo->colUsed & (sqlite3_uint64(1) << 63))) {
+            used += columnCount - 63;
+        }
+        if (used >= 2 && used >= BATCH_COLUMN_SHARE * columnCount) {
+            idxNum |= ROW_BATCH;
+        }
+    }
+
+    // Count-only scans and those reading rowids, offsets, the source name
+    // or materialized columns step through record infos alone
+    if ((idxNum & STRATEGY_MASK) == 0 && !(pIdxInfo->colUsed & (sqlite3_uint64(1) << 63))) {
+        bool recordUnused = true;
+        for (int i = 0; i < 63 && recordUnused; i++) {
+            if (!(pIdxInfo->colUsed & (sqlite3_uint64(1) << i))) continue;
+            if (i < columnCount) {
+                recordUnused = vtab->columnCaches && (*vtab->columnCaches)[i];
+            } else {
+                recordUnused = i == vtab->sourceColumnIndex || i == columnCount + 1 || i == columnCount + 2;
+            }
         }
+        if (recordUnused) idxNum |= RECORD_UNUSED;
+    }
+
+    pIdxInfo->idxNum = idxNum;
+    pIdxInfo->estimatedCost = estimatedCost;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(estimatedRows);
+    if (unique) {
+        pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
     }
 
     return SQLITE_OK;
@@ -300,18 +1038,33 @@ int FlatBufferVTabModule::xOpen(sqlite3_vtab* pVTab, sqlite3_vtab_cursor** ppCur
     cursor->currentSequence = 0;
     cursor->currentData = nullptr;
     cursor->currentLength = 0;
+    cursor->verifiedSequence = 0;
     cursor->atEof = true;
     cursor->scanType = ScanType::FullScan;
     cursor->indexPosition = 0;
     cursor->scanPosition = 0;
     cursor->cacheValid = false;
+    cursor->scanColumnCaches = nullptr;
+    cursor->scanZoneMaps = nullptr;
+    cursor->scanBloomFilters = nullptr;
+    cursor->predicateBlock = SIZE_MAX;
+    cursor->predicateMask = 0;
+    cursor->predicateZone = SIZE_MAX;
+    cursor->rowsLeft = UINT64_MAX;
+    cursor->stats = nullptr;
     cursor->numRealColumns = static_cast<int>(vtab->tableDef->columns.size());
 
     // Pre-allocate column cache
     cursor->columnCache.resize(cursor->numRealColumns);
+    if (!vtab->fieldCiphers.empty()) {
+        cursor->decryptedValues.resize(DECRYPTED_VALUE_SLOTS);
+    }
 
     // Cache the fast extractor to avoid vtab pointer chase in hot path
     cursor->cachedFastExtractor = vtab->fastExtractor;
+    cursor->rowExtractor = nullptr;
+    cursor->deferRecord = false;
+    cursor->coveringIndex = nullptr;
 
     *ppCursor = cursor;
     return SQLITE_OK;
@@ -344,21 +1097,426 @@ Value FlatBufferVTabModule::valueFromSqlite(sqlite3_value* val) {
     }
 }
 
+// Drop index entries that are deleted or newer than the pinned snapshot
+// (the writer indexes a batch before publishing it)
+static void filterIndexResults(std::vector<IndexEntry>& results,
+                               const DeletionBitmap* tombstones,
+                               uint64_t visible) {
+    bool checkTombstones = tombstones && !tombstones->empty();
+    results.erase(std::remove_if(results.begin(), results.end(),
+                                 [&](const IndexEntry& entry) {
+                                     return entry.sequence > visible ||
+                                            (checkTombstones && tombstones->contains(entry.sequence));
+                                 }),
+                  results.end());
+}
+
+// Next "column:op:argvIndex;" entry of an idxStr constraint list
+static bool nextConstraint(const char*& p, long& colIdx, long& op, long& arg) {
+    if (!*p) return false;
+    char* end;
+    colIdx = std::strtol(p, &end, 10);
+    op = std::strtol(end + 1, &end, 10);
+    arg = std::strtol(end + 1, &end, 10);
+    p = *end ? end + 1 : end;
+    return true;
+}
+
+bool FlatBufferVTabModule::isDescending(int idxNum) {
+    return (idxNum & ORDER_DESC) != 0;
+}
+
+uint64_t FlatBufferVTabModule::pushedRowLimit(const char* idxStr, int argc, sqlite3_value** argv) {
+    int64_t limit = -1, offset = 0;
+    const char* p = idxStr ? idxStr : "";
+    long col, op, arg;
+    while (nextConstraint(p, col, op, arg)) {
+        if (arg < 1 || arg > argc) continue;
+        if (op == SQLITE_INDEX_CONSTRAINT_LIMIT) {
+            limit = sqlite3_value_int64(argv[arg - 1]);
+        } else if (op == SQLITE_INDEX_CONSTRAINT_OFFSET) {
+            offset = std::max<int64_t>(0, sqlite3_value_int64(argv[arg - 1]));
+        }
+    }
+    if (limit < 0) return UINT64_MAX;
+    return static_cast<uint64_t>(limit) + static_cast<uint64_t>(limit > 0 ? offset : 0);
+}
+
+bool FlatBufferVTabModule::matchesSource(const FlatBufferVTab* vtab, const char* idxStr,
+                                         int argc, sqlite3_value** argv) {
+    const char* p = idxStr ? idxStr : "";
+    long col, op, arg;
+    while (nextConstraint(p, col, op, arg)) {
+        if (col != vtab->sourceColumnIndex || arg < 1 || arg > argc) continue;
+
+        // An IN list (handled all at once) matches if any element does
+        auto equals = [&](sqlite3_value* value) {
+            const unsigned char* text = sqlite3_value_text(value);
+            return text && vtab->sourceName == reinterpret_cast<const char*>(text);
+        };
+        bool matched = false;
+        sqlite3_value* value = nullptr;
+        int rc = sqlite3_vtab_in_first(argv[arg - 1], &value);
+        if (rc == SQLITE_OK) {
+            for (; rc == SQLITE_OK && value && !matched; rc = sqlite3_vtab_in_next(argv[arg - 1], &value)) {
+                matched = equals(value);
+            }
+        } else {
+            matched = equals(argv[arg - 1]);
+        }
+        if (!matched) return false;
+    }
+    return true;
+}
+
+// Whether a range bound orders directly against the index keys; other
+// bounds are left open, since SQLite re-checks every row anyway
+static bool usableRangeBound(sqlite3_value* value, ValueType keyType) {
+    int type = sqlite3_value_type(value);
+    switch (keyType) {
+        case ValueType::String: return type == SQLITE_TEXT;
+        case ValueType::Bytes:  return type == SQLITE_BLOB;
+        case ValueType::Null:   return false;
+        default:                return type == SQLITE_INTEGER || type == SQLITE_FLOAT;
+    }
+}
+
+// Advance a streamed index scan to its next visible, live entry, or to
+// EOF once the index cursor runs out
+static void stepIndexCursor(FlatBufferCursor* cursor) {
+    FlatBufferVTab* vtab = cursor->vtab;
+    IndexEntry entry;
+    while (cursor->indexCursor->next(entry)) {
+        if (entry.sequence > cursor->visibleSequence ||
+            (cursor->hasTombstones && vtab->tombstones->contains(entry.sequence))) {
+            continue;
+        }
+        if (cursor->coveringIndex) {
+            if (!cursor->coveringIndex->decode(entry.key, cursor->coveredValues)) break;
+            cursor->currentOffset = entry.dataOffset;
+            cursor->currentSequence = entry.sequence;
+            cursor->currentData = nullptr;
+            cursor->currentLength = 0;
+            return;
+        }
+        uint32_t len = 0;
+        const uint8_t* data = vtab->store->getVisibleDataAtOffset(entry.dataOffset, &len, &cursor->segmentPin);
+        if (!data) break;
+        cursor->currentOffset = entry.dataOffset;
+        cursor->currentSequence = entry.sequence;
+        cursor->currentData = data;
+        cursor->currentLength = len;
+        return;
+    }
+    cursor->atEof = true;
+}
+
+// Position an index scan on its first result, or at EOF if there is none
+static void seekIndexResults(FlatBufferCursor* cursor, bool reverse) {
+    if (reverse) {
+        std::reverse(cursor->indexResults.begin(), cursor->indexResults.end());
+    }
+    cursor->indexPosition = 0;
+    if (cursor->indexResults.empty()) {
+        cursor->atEof = true;
+        return;
+    }
+
+    const IndexEntry& entry = cursor->indexResults[0];
+    uint32_t len = 0;
+    const uint8_t* data = cursor->vtab->store->getVisibleDataAtOffset(entry.dataOffset, &len, &cursor->segmentPin);
+    if (data) {
+        cursor->currentOffset = entry.dataOffset;
+        cursor->currentSequence = entry.sequence;
+        cursor->currentData = data;
+        cursor->currentLength = len;
+    } else {
+        cursor->atEof = true;
+    }
+}
+
+uint64_t ScanPredicate::matchBlock(size_t block) const {
+    if (!lonCache) {
+        return cache->matchBlock(block, comparison);
+    }
+
+    // Rows not cached yet in both columns report a match, as in ColumnCache
+    double lat[64], lon[64];
+    uint64_t latNulls = 0, lonNulls = 0;
+    size_t count = std::min(cache->readBlock(block, lat, latNulls), lonCache->readBlock(block, lon, lonNulls));
+    uint64_t mask = region.matchBatch(lat, lon, count) & ~(latNulls | lonNulls);
+    if (count < 64) {
+        mask |= ~uint64_t(0) << count;
+    }
+    return mask;
+}
+
+// Add geo_within(_geo, region) to a full scan's predicates, evaluated over
+// the cached lat / lon columns; false if either is not cached
+static bool pushGeoPredicate(FlatBufferCursor* cursor, const GeoRegion& region) {
+    const TableDef& tableDef = *cursor->vtab->tableDef;
+    const ColumnCacheSlots& caches = *cursor->scanColumnCaches;
+    int lat = tableDef.getColumnIndex(tableDef.geoLatColumn);
+    int lon = tableDef.getColumnIndex(tableDef.geoLonColumn);
+    if (lat < 0 || lon < 0 || !caches[lat] || !caches[lon]) return false;
+    ScanPredicate predicate{caches[lat].get(), {}};
+    predicate.lonCache = caches[lon].get();
+    predicate.region = region;
+    cursor->scanPredicates.push_back(predicate);
+    return true;
+}
+
+void FlatBufferVTabModule::parseScanPredicates(FlatBufferCursor* cursor, const char* idxStr,
+                                               int argc, sqlite3_value** argv) {
+    static const std::pair<int, ColumnCache::CompareOp> ops[] = {
+        {SQLITE_INDEX_CONSTRAINT_EQ, ColumnCache::CompareOp::Eq},
+        {SQLITE_INDEX_CONSTRAINT_LT, ColumnCache::CompareOp::Lt},
+        {SQLITE_INDEX_CONSTRAINT_LE, ColumnCache::CompareOp::Le},
+        {SQLITE_INDEX_CONSTRAINT_GT, ColumnCache::CompareOp::Gt},
+        {SQLITE_INDEX_CONSTRAINT_GE, ColumnCache::CompareOp::Ge},
+    };
+
+    const char* p = idxStr;
+    long colIdx, op, arg;
+    while (nextConstraint(p, colIdx, op, arg)) {
+        if (colIdx < 0 || colIdx >= cursor->numRealColumns || arg < 1 || arg > argc) continue;
+        const ColumnCache* cache = cursor->scanColumnCaches ? (*cursor->scanColumnCaches)[colIdx].get() : nullptr;
+        const ZoneMap* zones = cursor->scanZoneMaps ? (*cursor->scanZoneMaps)[colIdx].get() : nullptr;
+        const ZoneBloomFilter* bloom =
+            cursor->scanBloomFilters ? (*cursor->scanBloomFilters)[colIdx].get() : nullptr;
+        if (bloom && op == SQLITE_INDEX_CONSTRAINT_EQ && sqlite3_value_type(argv[arg - 1]) == SQLITE_TEXT) {
+            ZonePredicate predicate{nullptr, {}};
+            predicate.bloom = bloom;
+            predicate.hash = ZoneBloomFilter::hash(sqlite3_value_text(argv[arg - 1]),
+                                                   static_cast<size_t>(sqlite3_value_bytes(argv[arg - 1])));
+            cursor->zonePredicates.push_back(predicate);
+        }
+        if (!cache && !zones) continue;
+        for (const auto& [sqliteOp, compareOp] : ops) {
+            if (sqliteOp != op) continue;
+            Value operand = valueFromSqlite(argv[arg - 1]);
+            ColumnCache::Comparison comparison;
+            if (cache && cache->makeComparison(compareOp, operand, comparison)) {
+                cursor->scanPredicates.push_back({cache, comparison});
+            }
+            if (zones && ColumnCache::makeComparison(zones->isReal(), compareOp, operand, comparison)) {
+                cursor->zonePredicates.push_back({zones, comparison});
+            }
+        }
+    }
+}
+
+// Set a cursor up for a full scan of its table's records below visible
+// Charge a full scan's rows to the unindexed columns xBestIndex listed
+// for the index advisor (argvIndex 0), once per column
+static void recordAdvisedColumns(const FlatBufferCursor* cursor, const char* idxStr) {
+    FlatBufferVTab* vtab = cursor->vtab;
+    std::vector<long> recorded;
+    const char* p = idxStr;
+    long colIdx, op, arg;
+    while (nextConstraint(p, colIdx, op, arg)) {
+        if (arg != 0 || colIdx < 0 || colIdx >= static_cast<long>(vtab->tableDef->columns.size())) continue;
+        if (std::find(recorded.begin(), recorded.end(), colIdx) != recorded.end()) continue;
+        recorded.push_back(colIdx);
+        vtab->indexAdvisor->record(vtab->sourceName, vtab->tableDef->columns[colIdx].name, cursor->scanFileCount);
+    }
+}
+
+static void beginFullScan(FlatBufferCursor* cursor, uint64_t visible) {
+    // Full scan - use indexed iteration with cached vector and buffer pointers
+    FlatBufferVTab* vtab = cursor->vtab;
+    cursor->scanType = ScanType::FullScan;
+    cursor->useLazyScan = false;
+    cursor->scanFileIndex = 0;
+    // Prefer source-specific record infos if available (for multi-source routing)
+    if (vtab->sourceRecordInfos) {
+        cursor->scanRecordInfos = vtab->sourceRecordInfos;
+    } else {
+        cursor->scanRecordInfos = vtab->store->getRecordInfoVector(vtab->fileId);
+    }
+    cursor->scanFileCount = cursor->scanRecordInfos
+        ? StreamingFlatBufferStore::visibleCount(*cursor->scanRecordInfos, visible) : 0;
+    cursor->scanStore = vtab->store;
+    // Cache and zone rows follow the table's own record list
+    if (cursor->scanRecordInfos == vtab->sourceRecordInfos) {
+        cursor->scanColumnCaches = vtab->columnCaches;
+        cursor->scanZoneMaps = vtab->zoneMaps;
+        cursor->scanBloomFilters = vtab->bloomFilters;
+    }
+}
+
+// Rows ahead of a full scan whose records are prefetched: the size prefix
+// and root offset at the far distance, the root table and its vtable (found
+// through the by then cached header) at the near one. Records of one table
+// are strided through a stream shared with other tables, which defeats the
+// hardware prefetcher.
+static constexpr size_t PREFETCH_HEADER_ROWS = 16;
+static constexpr size_t PREFETCH_VTABLE_ROWS = 8;
+
+static inline uint32_t loadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline void prefetchScanRows(const FlatBufferCursor* cursor) {
+    const auto& infos = *cursor->scanRecordInfos;
+    size_t row = cursor->scanFileIndex;
+    if (row + PREFETCH_HEADER_ROWS < cursor->scanFileCount) {
+        const uint8_t* ahead = cursor->scanStore->residentRecordAt(infos[row + PREFETCH_HEADER_ROWS].offset);
+        if (ahead) __builtin_prefetch(ahead);
+    }
+    if (row + PREFETCH_VTABLE_ROWS < cursor->scanFileCount) {
+        const uint8_t* ptr = cursor->scanStore->residentRecordAt(infos[row + PREFETCH_VTABLE_ROWS].offset);
+        if (!ptr) return;
+        uint32_t len = loadLE32(ptr);
+        if (len < 8) return;
+        const uint8_t* data = ptr + SIZE_PREFIX_LENGTH;
+        uint32_t root = loadLE32(data);
+        if (root > len - 4) return;
+        int32_t vtable = static_cast<int32_t>(loadLE32(data + root));
+        __builtin_prefetch(data + root);
+        // A bad vtable offset only prefetches a useless address, never faults
+        __builtin_prefetch(data + root - vtable);
+    }
+}
+
+// Move a full scan to the first row at or after scanFileIndex that is not
+// deleted and passes the pushed-down predicates, or to EOF
+static void seekFullScan(FlatBufferCursor* cursor) {
+    const auto* tombstones = cursor->hasTombstones ? cursor->vtab->tombstones : nullptr;
+    size_t& row = cursor->scanFileIndex;
+
+    while (row < cursor->scanFileCount) {
+        // Rows evicted by retention are one run at the front: jump past it
+        if (tombstones && (*cursor->scanRecordInfos)[row].sequence <= tombstones->expiredThrough()) {
+            row = std::max(row + 1, StreamingFlatBufferStore::visibleCount(*cursor->scanRecordInfos,
+                                                                          tombstones->expiredThrough()));
+            continue;
+        }
+        if (!cursor->zonePredicates.empty()) {
+            size_t zone = row >> ZoneMap::ZONE_SHIFT;
+            if (zone != cursor->predicateZone) {
+                bool possible = true;
+                for (const ZonePredicate& predicate : cursor->zonePredicates) {
+                    if (!predicate.mayMatch(zone)) {
+                        possible = false;
+                        break;
+                    }
+                }
+                if (!possible) {
+                    row = (zone + 1) << ZoneMap::ZONE_SHIFT;
+                    continue;
+                }
+                cursor->predicateZone = zone;
+            }
+        }
+        if (!cursor->scanPredicates.empty()) {
+            size_t block = row >> 6;
+            if (block != cursor->predicateBlock) {
+                uint64_t mask = ~uint64_t(0);
+                for (const ScanPredicate& predicate : cursor->scanPredicates) {
+                    mask &= predicate.matchBlock(block);
+                    if (!mask) break;
+                }
+                cursor->predicateBlock = block;
+                cursor->predicateMask = mask;
+            }
+            uint64_t remaining = cursor->predicateMask & (~uint64_t(0) << (row & 63));
+            if (!remaining) {
+                row = (block + 1) << 6;
+                continue;
+            }
+            row = (block << 6) + static_cast<size_t>(__builtin_ctzll(remaining));
+            if (row >= cursor->scanFileCount) break;
+        }
+
+        const auto& info = (*cursor->scanRecordInfos)[row];
+        if (!tombstones || !tombstones->contains(info.sequence)) {
+            if (cursor->deferRecord) {
+                cursor->currentOffset = info.offset;
+                cursor->currentSequence = info.sequence;
+                cursor->currentData = nullptr;
+                cursor->currentLength = 0;
+                return;
+            }
+            prefetchScanRows(cursor);
+            // Inline data access - read size prefix and compute pointer
+            const uint8_t* ptr = cursor->scanStore->recordAt(info.offset, cursor->segmentPin);
+            uint32_t len = static_cast<uint32_t>(ptr[0]) |
+                           (static_cast<uint32_t>(ptr[1]) << 8) |
+                           (static_cast<uint32_t>(ptr[2]) << 16) |
+                           (static_cast<uint32_t>(ptr[3]) << 24);
+            cursor->currentOffset = info.offset;
+            cursor->currentSequence = info.sequence;
+            cursor->currentData = ptr + 4;  // Skip size prefix
+            cursor->currentLength = len;
+            return;
+        }
+        row++;
+    }
+
+    cursor->atEof = true;
+}
+
+namespace {
+
+// Times an xFilter or xNext call into the cursor's statement stats and
+// counts the row it leaves the cursor on
+class CursorStepStats {
+public:
+    CursorStepStats(FlatBufferCursor* cursor, uint64_t QueryStats::*calls, uint64_t QueryStats::*nanos)
+        : cursor_(cursor), timer_(cursor->stats, nanos) {
+        if (cursor->stats) cursor->stats->*calls += 1;
+    }
+    ~CursorStepStats() {
+        QueryStats* stats = cursor_->stats;
+        if (stats && !cursor_->atEof) {
+            stats->rowsScanned++;
+            stats->bytesTouched += cursor_->currentLength;
+        }
+    }
+
+    CursorStepStats(const CursorStepStats&) = delete;
+    CursorStepStats& operator=(const CursorStepStats&) = delete;
+
+private:
+    FlatBufferCursor* cursor_;
+    QueryStatsTimer timer_;
+};
+
+}  // namespace
+
 int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr,
                                    int argc, sqlite3_value** argv) {
-    (void)idxStr;  // No longer used - column index encoded in idxNum
+    FLATSQL_TRACE_SCOPE("FlatBufferVTab::xFilter");
+    // Index strategies carry their column in idxNum; idxStr only holds
+    // full-scan predicates
     FlatBufferCursor* cursor = static_cast<FlatBufferCursor*>(pCursor);
     FlatBufferVTab* vtab = cursor->vtab;
+    cursor->stats = vtab->queryStats ? vtab->queryStats->current : nullptr;
+    CursorStepStats stepStats(cursor, &QueryStats::filterCalls, &QueryStats::filterNanos);
 
     // Reset cursor state
     cursor->atEof = false;
     cursor->indexResults.clear();
     cursor->indexPosition = 0;
+    cursor->indexCursor.reset();
     cursor->scanRefs.clear();
     cursor->scanPosition = 0;
     cursor->currentData = nullptr;
     cursor->currentLength = 0;
     cursor->cacheValid = false;
+    cursor->scanColumnCaches = nullptr;
+    cursor->scanZoneMaps = nullptr;
+    cursor->scanBloomFilters = nullptr;
+    cursor->scanPredicates.clear();
+    cursor->zonePredicates.clear();
+    cursor->predicateZone = SIZE_MAX;
+    cursor->predicateBlock = SIZE_MAX;
+    cursor->rowExtractor = (idxNum & ROW_BATCH) ? vtab->batchExtractor : nullptr;
+    cursor->deferRecord = false;
+    cursor->ranked = false;
+    cursor->coveringIndex = nullptr;
 
     if (!vtab->store) {
         cursor->atEof = true;
@@ -367,49 +1525,43 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
 
     int argIdx = 0;
 
-    // Decode idxNum: low byte = strategy, high bytes = column index
-    int strategy = idxNum & 0xFF;
-    int colIdx = idxNum >> 8;
+    // Pin the published record count so the whole scan (and every other
+    // cursor over this store in the same statement) sees one snapshot
+    const uint64_t visible = vtab->snapshot ? vtab->snapshot->pin(vtab->store)
+                                            : vtab->store->getVisibleSequence();
+    cursor->visibleSequence = visible;
+    cursor->hasTombstones = vtab->tombstones && !vtab->tombstones->empty();
+
+    // Decode idxNum: low bits = strategy and flags, high bytes = column index
+    int strategy = idxNum & STRATEGY_MASK;
+    int colIdx = (idxNum & ~RECORD_UNUSED) >> 8;
+    bool reverse = (idxNum & ORDER_DESC) != 0;
+
+    // Pushed-down LIMIT: xNext stops after LIMIT + OFFSET rows (SQLite
+    // skips the OFFSET rows itself)
+    cursor->rowsLeft = pushedRowLimit(idxStr, argc, argv);
+    if (cursor->rowsLeft == 0 || !matchesSource(vtab, idxStr, argc, argv)) {
+        cursor->atEof = true;
+        return SQLITE_OK;
+    }
+
+    if (cursor->stats && strategy >= 2) {
+        cursor->stats->indexProbes++;  // Past the full scan and rowid strategies
+    }
 
     switch (strategy) {
         case 0: {
-            // Full scan - use indexed iteration with cached vector and buffer pointers
-            cursor->scanType = ScanType::FullScan;
-            cursor->useLazyScan = false;
-            cursor->scanFileIndex = 0;
-            // Prefer source-specific record infos if available (for multi-source routing)
-            if (vtab->sourceRecordInfos) {
-                cursor->scanRecordInfos = vtab->sourceRecordInfos;
-            } else {
-                cursor->scanRecordInfos = vtab->store->getRecordInfoVector(vtab->fileId);
-            }
-            cursor->scanFileCount = cursor->scanRecordInfos ? cursor->scanRecordInfos->size() : 0;
-            cursor->scanDataBuffer = vtab->store->getDataBuffer();
-            cursor->hasTombstones = vtab->tombstones && !vtab->tombstones->empty();
-
-            // Find first non-tombstoned record
-            while (cursor->scanFileIndex < cursor->scanFileCount) {
-                const auto& info = (*cursor->scanRecordInfos)[cursor->scanFileIndex];
-                // Check tombstone
-                if (!vtab->tombstones || !vtab->tombstones->count(info.sequence)) {
-                    // Inline data access - read size prefix and compute pointer
-                    const uint8_t* ptr = cursor->scanDataBuffer + info.offset;
-                    uint32_t len = static_cast<uint32_t>(ptr[0]) |
-                                   (static_cast<uint32_t>(ptr[1]) << 8) |
-                                   (static_cast<uint32_t>(ptr[2]) << 16) |
-                                   (static_cast<uint32_t>(ptr[3]) << 24);
-                    cursor->currentOffset = info.offset;
-                    cursor->currentSequence = info.sequence;
-                    cursor->currentData = ptr + 4;  // Skip size prefix
-                    cursor->currentLength = len;
-                    break;
-                }
-                cursor->scanFileIndex++;
+            beginFullScan(cursor, visible);
+            cursor->deferRecord = (idxNum & RECORD_UNUSED) != 0;
+            if (vtab->indexAdvisor && vtab->indexAdvisor->enabled() && idxStr) {
+                recordAdvisedColumns(cursor, idxStr);
             }
-
-            if (cursor->scanFileIndex >= cursor->scanFileCount) {
-                cursor->atEof = true;
+            if ((cursor->scanColumnCaches || cursor->scanZoneMaps || cursor->scanBloomFilters) && idxStr) {
+                parseScanPredicates(cursor, idxStr, argc, argv);
             }
+
+            // Find first non-tombstoned, matching record
+            seekFullScan(cursor);
             break;
         }
 
@@ -423,8 +1575,9 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
 
             int64_t rowid = sqlite3_value_int64(argv[argIdx]);
 
-            // Check tombstone
-            if (vtab->tombstones && vtab->tombstones->count(static_cast<uint64_t>(rowid))) {
+            // Check tombstone and visibility
+            if (rowid <= 0 || static_cast<uint64_t>(rowid) > visible ||
+                (vtab->tombstones && vtab->tombstones->contains(static_cast<uint64_t>(rowid)))) {
                 cursor->atEof = true;
                 return SQLITE_OK;
             }
@@ -435,7 +1588,7 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
                 cursor->atEof = true;
             } else {
                 uint32_t len = 0;
-                const uint8_t* data = vtab->store->getDataAtOffset(offsetOpt.value(), &len);
+                const uint8_t* data = vtab->store->getVisibleDataAtOffset(offsetOpt.value(), &len, &cursor->segmentPin);
                 if (data) {
                     cursor->currentOffset = offsetOpt.value();
                     cursor->currentSequence = static_cast<uint64_t>(rowid);
@@ -470,15 +1623,20 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
             bool isPrimaryKey = vtab->tableDef->columns[colIdx].primaryKey;
 
             // For primary key (unique) columns, use fast single-result path
-            // For non-unique indexed columns, must use search() to get all matches
-            if (isPrimaryKey && indexIt->second->searchFirst(searchValue, cursor->singleResult)) {
+            // For non-unique indexed columns, must use search() to get all matches.
+            // A tombstoned first entry may have been replaced by a later one
+            // (upsert tables), so that case streams the matches instead.
+            bool single = isPrimaryKey && indexIt->second->searchFirst(searchValue, cursor->singleResult) &&
+                          (!vtab->tombstones || !vtab->tombstones->contains(cursor->singleResult.sequence));
+            if (single) {
                 // Fast path for primary key: single result expected
-                if (!vtab->tombstones || !vtab->tombstones->count(cursor->singleResult.sequence)) {
+                if (cursor->singleResult.sequence <= visible) {
                     cursor->scanType = ScanType::IndexSingleLookup;
                     cursor->singleResultReturned = false;
 
                     uint32_t len = 0;
-                    const uint8_t* data = vtab->store->getDataAtOffset(cursor->singleResult.dataOffset, &len);
+                    const uint8_t* data = vtab->store->getVisibleDataAtOffset(
+                        cursor->singleResult.dataOffset, &len, &cursor->segmentPin);
                     if (data) {
                         cursor->currentOffset = cursor->singleResult.dataOffset;
                         cursor->currentSequence = cursor->singleResult.sequence;
@@ -488,41 +1646,17 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
                         cursor->atEof = true;
                     }
                 } else {
-                    // Tombstoned primary key - no match
+                    // Primary key ingested after the statement's snapshot
                     cursor->atEof = true;
                 }
+            } else if (std::holds_alternative<std::monostate>(searchValue)) {
+                // = NULL matches nothing
+                cursor->atEof = true;
             } else {
-                // Non-unique index OR primary key with tombstone: search for all matches
+                // Non-unique index OR primary key with tombstone: stream all matches
                 cursor->scanType = ScanType::IndexEquality;
-                cursor->indexResults = indexIt->second->search(searchValue);
-
-                // Filter out tombstoned entries if needed
-                if (vtab->tombstones && !vtab->tombstones->empty()) {
-                    std::vector<IndexEntry> filtered;
-                    for (const auto& entry : cursor->indexResults) {
-                        if (!vtab->tombstones->count(entry.sequence)) {
-                            filtered.push_back(entry);
-                        }
-                    }
-                    cursor->indexResults = std::move(filtered);
-                }
-
-                cursor->indexPosition = 0;
-                if (cursor->indexResults.empty()) {
-                    cursor->atEof = true;
-                } else {
-                    const IndexEntry& entry = cursor->indexResults[0];
-                    uint32_t len = 0;
-                    const uint8_t* data = vtab->store->getDataAtOffset(entry.dataOffset, &len);
-                    if (data) {
-                        cursor->currentOffset = entry.dataOffset;
-                        cursor->currentSequence = entry.sequence;
-                        cursor->currentData = data;
-                        cursor->currentLength = len;
-                    } else {
-                        cursor->atEof = true;
-                    }
-                }
+                cursor->indexCursor = indexIt->second->openRange(searchValue, searchValue, reverse);
+                stepIndexCursor(cursor);
             }
             break;
         }
@@ -544,36 +1678,238 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
                 return SQLITE_OK;
             }
 
-            cursor->indexResults = indexIt->second->all();
-
-            // Filter out tombstoned entries
-            if (vtab->tombstones) {
-                std::vector<IndexEntry> filtered;
-                filtered.reserve(cursor->indexResults.size());
-                for (const auto& entry : cursor->indexResults) {
-                    if (!vtab->tombstones->count(entry.sequence)) {
-                        filtered.push_back(entry);
-                    }
+            // Bounds flagged in idxNum, lower first; the rest stay open
+            Value bounds[2];
+            int boundArg = argIdx;
+            for (int b = 0; b < 2; b++) {
+                if (!(idxNum & (b == 0 ? RANGE_LOWER : RANGE_UPPER)) || boundArg >= argc) continue;
+                sqlite3_value* bound = argv[boundArg++];
+                if (usableRangeBound(bound, vtab->tableDef->columns[colIdx].type)) {
+                    bounds[b] = valueFromSqlite(bound);
                 }
-                cursor->indexResults = std::move(filtered);
             }
+            cursor->indexCursor = indexIt->second->openRange(bounds[0], bounds[1], reverse);
+            stepIndexCursor(cursor);
+            break;
+        }
+
+        case 9: {
+            // Composite key range: nEq equalities, then the flagged bounds
+            cursor->scanType = ScanType::IndexRange;
+            size_t composite = static_cast<size_t>((idxNum >> COMPOSITE_SHIFT) & COMPOSITE_MASK);
+            if (composite >= vtab->composites.size()) {
+                cursor->atEof = true;
+                return SQLITE_OK;
+            }
+            const CompositeIndex* index = vtab->composites[composite];
+            size_t nEq = static_cast<size_t>((idxNum >> COMPOSITE_EQ_SHIFT) & COMPOSITE_EQ_MASK);
 
-            cursor->indexPosition = 0;
-            if (cursor->indexResults.empty()) {
+            std::vector<Value> equal;
+            int arg = argIdx;
+            for (size_t k = 0; k < nEq && arg < argc; k++) {
+                equal.push_back(valueFromSqlite(argv[arg++]));
+            }
+            Value bounds[2];
+            bool bounded[2] = {false, false};
+            for (int b = 0; b < 2; b++) {
+                if (!(idxNum & (b == 0 ? RANGE_LOWER : RANGE_UPPER)) || arg >= argc) continue;
+                bounds[b] = valueFromSqlite(argv[arg++]);
+                bounded[b] = true;
+            }
+
+            Value minKey, maxKey;
+            if (equal.size() < nEq ||
+                !index->bounds(equal, bounded[0] ? &bounds[0] : nullptr, bounded[1] ? &bounds[1] : nullptr,
+                               minKey, maxKey)) {
                 cursor->atEof = true;
+                return SQLITE_OK;
+            }
+            if (idxNum & INDEX_COVERED) {
+                cursor->coveringIndex = index;
+                cursor->coveredValues.resize(cursor->numRealColumns);
+                cursor->indexCursor = index->openKeyedRange(minKey, maxKey, reverse);
             } else {
-                const IndexEntry& entry = cursor->indexResults[0];
-                uint32_t len = 0;
-                const uint8_t* data = vtab->store->getDataAtOffset(entry.dataOffset, &len);
-                if (data) {
-                    cursor->currentOffset = entry.dataOffset;
-                    cursor->currentSequence = entry.sequence;
-                    cursor->currentData = data;
-                    cursor->currentLength = len;
+                cursor->indexCursor = index->openRange(minKey, maxKey, reverse);
+            }
+            stepIndexCursor(cursor);
+            break;
+        }
+
+        case 4: {
+            // Index lookup of every value of an IN list in one pass
+            cursor->scanType = ScanType::IndexEquality;
+            if (argc < 1 || colIdx < 0 || colIdx >= static_cast<int>(vtab->tableDef->columns.size())) {
+                cursor->atEof = true;
+                return SQLITE_OK;
+            }
+
+            auto indexIt = vtab->indexes.find(vtab->tableDef->columns[colIdx].name);
+            if (indexIt == vtab->indexes.end() || !indexIt->second) {
+                cursor->atEof = true;
+                return SQLITE_OK;
+            }
+
+            std::vector<Value> keys;
+            sqlite3_value* value = nullptr;
+            for (int rc = sqlite3_vtab_in_first(argv[argIdx], &value); rc == SQLITE_OK && value;
+                 rc = sqlite3_vtab_in_next(argv[argIdx], &value)) {
+                keys.push_back(valueFromSqlite(value));
+            }
+
+            cursor->indexResults = indexIt->second->searchMany(std::move(keys));
+            filterIndexResults(cursor->indexResults, vtab->tombstones, visible);
+            seekIndexResults(cursor, reverse);
+            break;
+        }
+
+        case 5: {
+            // Intersection of index lookups on several columns, by sequence
+            cursor->scanType = ScanType::IndexEquality;
+            const int columnCount = static_cast<int>(vtab->tableDef->columns.size());
+
+            // Per column: an equality key, or range bounds (open if unusable)
+            struct Lookup {
+                const Index* index;
+                ValueType type;
+                bool equality = false;
+                Value values[2];
+            };
+            std::vector<Lookup> lookups;
+            std::vector<int> lookupOf(columnCount, -1);
+            const char* p = idxStr ? idxStr : "";
+            long col, op, arg;
+            while (nextConstraint(p, col, op, arg)) {
+                if (col < 0 || col >= columnCount || arg < 1 || arg > argc) continue;
+                if (lookupOf[col] < 0) {
+                    auto indexIt = vtab->indexes.find(vtab->tableDef->columns[col].name);
+                    if (indexIt == vtab->indexes.end() || !indexIt->second) continue;
+                    lookupOf[col] = static_cast<int>(lookups.size());
+                    lookups.push_back({indexIt->second, vtab->tableDef->columns[col].type});
+                }
+                Lookup& lookup = lookups[lookupOf[col]];
+                sqlite3_value* value = argv[arg - 1];
+                if (op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                    lookup.equality = true;
+                    lookup.values[0] = valueFromSqlite(value);
+                } else if (usableRangeBound(value, lookup.type)) {
+                    bool lower = op == SQLITE_INDEX_CONSTRAINT_GT || op == SQLITE_INDEX_CONSTRAINT_GE;
+                    lookup.values[lower ? 0 : 1] = valueFromSqlite(value);
+                }
+            }
+
+            auto bySequence = [](const IndexEntry& a, const IndexEntry& b) {
+                return a.sequence < b.sequence;
+            };
+            std::vector<IndexEntry> matched, next, kept;
+            for (size_t l = 0; l < lookups.size(); l++) {
+                const Lookup& lookup = lookups[l];
+                next = lookup.equality ? lookup.index->search(lookup.values[0])
+                                       : lookup.index->range(lookup.values[0], lookup.values[1]);
+                std::sort(next.begin(), next.end(), bySequence);
+                if (l == 0) {
+                    matched.swap(next);
                 } else {
-                    cursor->atEof = true;
+                    kept.clear();
+                    std::set_intersection(matched.begin(), matched.end(), next.begin(), next.end(),
+                                          std::back_inserter(kept), bySequence);
+                    matched.swap(kept);
+                }
+                if (matched.empty()) break;
+            }
+
+            cursor->indexResults = std::move(matched);
+            filterIndexResults(cursor->indexResults, vtab->tombstones, visible);
+            seekIndexResults(cursor, reverse);
+            break;
+        }
+
+        case 6: {
+            // Spatial index: every point in the grid cells covering the
+            // region, in sequence order; geo_within() rejects the rest
+            cursor->scanType = ScanType::IndexEquality;
+            auto indexIt = vtab->indexes.find(GEO_COLUMN);
+            GeoRegion region;
+            if (argc < 1 || indexIt == vtab->indexes.end() || !indexIt->second ||
+                !GeoRegion::decode(sqlite3_value_blob(argv[argIdx]), sqlite3_value_bytes(argv[argIdx]),
+                                   region)) {
+                cursor->atEof = true;
+                return SQLITE_OK;
+            }
+
+            // The plan was made without seeing the region; a large one is
+            // tested against cached coordinates instead, still in sequence
+            // order (so only when ascending)
+            if (!reverse && region.boxFraction() >= GEO_SCAN_FRACTION) {
+                beginFullScan(cursor, visible);
+                if (cursor->scanColumnCaches && pushGeoPredicate(cursor, region)) {
+                    seekFullScan(cursor);
+                    break;
                 }
+                cursor->scanColumnCaches = nullptr;
+                cursor->scanZoneMaps = nullptr;
+                cursor->scanBloomFilters = nullptr;
+                cursor->scanType = ScanType::IndexEquality;
+            }
+
+            std::vector<IndexEntry> matched;
+            for (const auto& [lo, hi] : region.coveringKeyRanges(GEO_COVER_CELLS)) {
+                std::vector<IndexEntry> cell = indexIt->second->range(Value(lo), Value(hi));
+                matched.insert(matched.end(), std::make_move_iterator(cell.begin()),
+                               std::make_move_iterator(cell.end()));
+            }
+            std::sort(matched.begin(), matched.end(), [](const IndexEntry& a, const IndexEntry& b) {
+                return a.sequence < b.sequence;
+            });
+
+            cursor->indexResults = std::move(matched);
+            filterIndexResults(cursor->indexResults, vtab->tombstones, visible);
+            seekIndexResults(cursor, reverse);
+            break;
+        }
+
+        case 7: {
+            // Full-text index: the query's matches in sequence order, with
+            // their scores for _rank; MATCH is fully answered here
+            cursor->scanType = ScanType::IndexEquality;
+            const int columnCount = static_cast<int>(vtab->tableDef->columns.size());
+            auto indexIt = colIdx < columnCount
+                ? vtab->indexes.find(fullTextIndexKey(vtab->tableDef->columns[colIdx].name))
+                : vtab->indexes.end();
+            if (argc < 1 || indexIt == vtab->indexes.end() || !indexIt->second ||
+                sqlite3_value_type(argv[argIdx]) != SQLITE_TEXT) {
+                cursor->atEof = true;
+                return SQLITE_OK;
+            }
+            cursor->indexResults = indexIt->second->search(valueFromSqlite(argv[argIdx]));
+            cursor->ranked = true;
+            filterIndexResults(cursor->indexResults, vtab->tombstones, visible);
+            seekIndexResults(cursor, reverse);
+            break;
+        }
+
+        case 8: {
+            // Trigram index: rows sharing enough trigrams with the pattern's
+            // target, in sequence order; fuzzy_within() rejects the rest
+            cursor->scanType = ScanType::IndexEquality;
+            const int columnCount = static_cast<int>(vtab->tableDef->columns.size());
+            auto indexIt = colIdx < columnCount
+                ? vtab->indexes.find(trigramIndexKey(vtab->tableDef->columns[colIdx].name))
+                : vtab->indexes.end();
+            if (argc < 1 || indexIt == vtab->indexes.end() || !indexIt->second ||
+                sqlite3_value_type(argv[argIdx]) == SQLITE_NULL) {
+                cursor->atEof = true;
+                return SQLITE_OK;
             }
+            std::string_view target;
+            uint32_t maxDistance = 0;
+            TrigramIndex::parsePattern(
+                std::string_view(reinterpret_cast<const char*>(sqlite3_value_text(argv[argIdx])),
+                                 static_cast<size_t>(sqlite3_value_bytes(argv[argIdx]))),
+                target, maxDistance);
+            cursor->indexResults =
+                static_cast<const TrigramIndex*>(indexIt->second)->candidates(target, maxDistance);
+            filterIndexResults(cursor->indexResults, vtab->tombstones, visible);
+            seekIndexResults(cursor, reverse);
             break;
         }
 
@@ -586,21 +1922,37 @@ int FlatBufferVTabModule::xFilter(sqlite3_vtab_cursor* pCursor, int idxNum, cons
 }
 
 int FlatBufferVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
+    FLATSQL_TRACE_SCOPE("FlatBufferVTab::xNext");
     FlatBufferCursor* cursor = static_cast<FlatBufferCursor*>(pCursor);
+    CursorStepStats stepStats(cursor, &QueryStats::nextCalls, &QueryStats::nextNanos);
 
     // Invalidate column cache on row change
     cursor->cacheValid = false;
 
+    if (--cursor->rowsLeft == 0) {
+        cursor->atEof = true;  // Pushed-down LIMIT reached
+        return SQLITE_OK;
+    }
+
     switch (cursor->scanType) {
         case ScanType::FullScan: {
             // Use indexed iteration with inlined buffer access
             cursor->scanFileIndex++;
 
-            // Fast path: no tombstones (common case, cached check)
-            if (__builtin_expect(!cursor->hasTombstones, 1)) {
+            // Fast path: no tombstones or predicates (common case, cached check)
+            if (__builtin_expect(!cursor->hasTombstones && cursor->scanPredicates.empty() &&
+                                 cursor->zonePredicates.empty(), 1)) {
                 if (__builtin_expect(cursor->scanFileIndex < cursor->scanFileCount, 1)) {
                     const auto& info = (*cursor->scanRecordInfos)[cursor->scanFileIndex];
-                    const uint8_t* ptr = cursor->scanDataBuffer + info.offset;
+                    if (cursor->deferRecord) {
+                        cursor->currentOffset = info.offset;
+                        cursor->currentSequence = info.sequence;
+                        cursor->currentData = nullptr;
+                        cursor->currentLength = 0;
+                        return SQLITE_OK;
+                    }
+                    prefetchScanRows(cursor);
+                    const uint8_t* ptr = cursor->scanStore->recordAt(info.offset, cursor->segmentPin);
                     uint32_t len = static_cast<uint32_t>(ptr[0]) |
                                    (static_cast<uint32_t>(ptr[1]) << 8) |
                                    (static_cast<uint32_t>(ptr[2]) << 16) |
@@ -615,25 +1967,8 @@ int FlatBufferVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
                 return SQLITE_OK;
             }
 
-            // Slow path: has tombstones, need to check each record
-            while (cursor->scanFileIndex < cursor->scanFileCount) {
-                const auto& info = (*cursor->scanRecordInfos)[cursor->scanFileIndex];
-                if (!cursor->vtab->tombstones->count(info.sequence)) {
-                    const uint8_t* ptr = cursor->scanDataBuffer + info.offset;
-                    uint32_t len = static_cast<uint32_t>(ptr[0]) |
-                                   (static_cast<uint32_t>(ptr[1]) << 8) |
-                                   (static_cast<uint32_t>(ptr[2]) << 16) |
-                                   (static_cast<uint32_t>(ptr[3]) << 24);
-                    cursor->currentOffset = info.offset;
-                    cursor->currentSequence = info.sequence;
-                    cursor->currentData = ptr + 4;
-                    cursor->currentLength = len;
-                    return SQLITE_OK;
-                }
-                cursor->scanFileIndex++;
-            }
-
-            cursor->atEof = true;
+            // Slow path: tombstones or predicates to check per record
+            seekFullScan(cursor);
             break;
         }
 
@@ -645,13 +1980,18 @@ int FlatBufferVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
 
         case ScanType::IndexEquality:
         case ScanType::IndexRange: {
+            if (cursor->indexCursor) {
+                stepIndexCursor(cursor);
+                break;
+            }
             cursor->indexPosition++;
             if (cursor->indexPosition >= cursor->indexResults.size()) {
                 cursor->atEof = true;
             } else {
                 const IndexEntry& entry = cursor->indexResults[cursor->indexPosition];
                 uint32_t len = 0;
-                const uint8_t* data = cursor->vtab->store->getDataAtOffset(entry.dataOffset, &len);
+                const uint8_t* data = cursor->vtab->store->getVisibleDataAtOffset(
+                    entry.dataOffset, &len, &cursor->segmentPin);
                 if (data) {
                     cursor->currentOffset = entry.dataOffset;
                     cursor->currentSequence = entry.sequence;
@@ -668,6 +2008,18 @@ int FlatBufferVTabModule::xNext(sqlite3_vtab_cursor* pCursor) {
     return SQLITE_OK;
 }
 
+bool FlatBufferVTabModule::loadRecord(FlatBufferCursor* cursor) {
+    if (cursor->atEof) return false;
+    if (cursor->currentData || !cursor->deferRecord) return cursor->currentData != nullptr;
+    const uint8_t* ptr = cursor->scanStore->recordAt(cursor->currentOffset, cursor->segmentPin);
+    cursor->currentData = ptr + SIZE_PREFIX_LENGTH;
+    cursor->currentLength = static_cast<uint32_t>(ptr[0]) |
+                            (static_cast<uint32_t>(ptr[1]) << 8) |
+                            (static_cast<uint32_t>(ptr[2]) << 16) |
+                            (static_cast<uint32_t>(ptr[3]) << 24);
+    return true;
+}
+
 int FlatBufferVTabModule::xEof(sqlite3_vtab_cursor* pCursor) {
     FlatBufferCursor* cursor = static_cast<FlatBufferCursor*>(pCursor);
     return cursor->atEof ? 1 : 0;
@@ -729,14 +2081,55 @@ void FlatBufferVTabModule::setResultFromValue(sqlite3_context* ctx, const Value&
     }
 }
 
+// One coordinate of the current row's point (false if missing or not numeric)
+static bool geoCoordinate(const FlatBufferVTab* vtab, const FlatBufferCursor* cursor,
+                          const std::string& column, double& out) {
+    if (cursor->scanColumnCaches) {
+        const ColumnCache* cache = (*cursor->scanColumnCaches)[vtab->tableDef->getColumnIndex(column)].get();
+        size_t row = cursor->scanFileIndex;
+        if (cache && row < cache->size()) {
+            out = cache->getDouble(row);
+            return !cache->isNull(row) && !std::isnan(out);
+        }
+    }
+    Value value = vtab->extractor(cursor->currentData, cursor->currentLength, column);
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            out = static_cast<double>(v);
+            return !std::isnan(out);
+        }
+        return false;
+    }, value);
+}
+
 int FlatBufferVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* ctx, int N) {
+    FLATSQL_TRACE_SCOPE("FlatBufferVTab::xColumn");
     FlatBufferCursor* cursor = static_cast<FlatBufferCursor*>(pCursor);
+    QueryStats* stats = cursor->stats;
+    QueryStatsTimer timer(stats, &QueryStats::columnNanos);
+    if (stats) stats->columnCalls++;
+
+    // Covered scan: the composite index key held the column
+    if (cursor->coveringIndex && N >= 0 && N < cursor->numRealColumns) {
+        if (stats) stats->coveredReads++;
+        setResultFromValue(ctx, cursor->coveredValues[N]);
+        return SQLITE_OK;
+    }
 
-    // Fast path: regular column with fast extractor (most common case)
-    // Skip fast path when encryption is active - must go through cache for decryption
-    if (N >= 0 && N < cursor->numRealColumns && cursor->currentData
-        && cursor->cachedFastExtractor && !cursor->vtab->encryptionCtx) {
-        if (cursor->cachedFastExtractor(cursor->currentData, cursor->currentLength, N, ctx)) {
+    // Materialized column: read the array instead of the FlatBuffer
+    if (cursor->scanColumnCaches && N >= 0 && N < cursor->numRealColumns) {
+        const ColumnCache* cache = (*cursor->scanColumnCaches)[N].get();
+        size_t row = cursor->scanFileIndex;
+        if (cache && row < cache->size()) {
+            if (stats) stats->columnCacheReads++;
+            if (cache->isNull(row)) {
+                sqlite3_result_null(ctx);
+            } else if (cache->isReal()) {
+                sqlite3_result_double(ctx, cache->getDouble(row));
+            } else {
+                sqlite3_result_int64(ctx, cache->getInt64(row));
+            }
             return SQLITE_OK;
         }
     }
@@ -744,6 +2137,70 @@ int FlatBufferVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context*
     FlatBufferVTab* vtab = cursor->vtab;
     int numRealColumns = cursor->numRealColumns;
 
+    // Rows of a record-free plan are fetched only if a column still needs
+    // one (a materialized column behind the scan, say)
+    if (cursor->deferRecord && !cursor->currentData && N != vtab->sourceColumnIndex &&
+        N != numRealColumns + 1 && N != numRealColumns + 2) {
+        loadRecord(cursor);
+    }
+
+    // Lazy verification: check the record on the first column read from it
+    if (vtab->verification && cursor->currentData && cursor->verifiedSequence != cursor->currentSequence &&
+        N >= 0 && N < numRealColumns && vtab->verification->getMode() == VerificationMode::Lazy) {
+        if (!vtab->verification->check(cursor->currentSequence, cursor->currentData, cursor->currentLength)) {
+            std::string message = "FlatBuffer verification failed for record " +
+                                  std::to_string(cursor->currentSequence);
+            sqlite3_result_error(ctx, message.c_str(), static_cast<int>(message.size()));
+            return SQLITE_ERROR;
+        }
+        cursor->verifiedSequence = cursor->currentSequence;
+    }
+
+    // Encrypted columns must be decrypted, the rest read as usual
+    const FieldCipher* cipher = nullptr;
+    if (!vtab->fieldCiphers.empty() && N >= 0 && N < numRealColumns &&
+        vtab->tableDef->columns[N].encrypted) {
+        cipher = &vtab->fieldCiphers[N];
+    }
+
+    // Wide projection: decode the whole row on its first column
+    if (cursor->rowExtractor && N >= 0 && N < numRealColumns && cursor->currentData && !cipher) {
+        if (!cursor->cacheValid) {
+            if (stats) stats->batchExtractorCalls++;
+            cursor->columnCache.clear();
+            cursor->rowExtractor(cursor->currentData, cursor->currentLength, cursor->columnCache);
+            cursor->columnCache.resize(numRealColumns);
+            cursor->cacheValid = true;
+        }
+        setResultFromValue(ctx, cursor->columnCache[N]);
+        return SQLITE_OK;
+    }
+
+    // Fast path: regular column with fast extractor (most common case)
+    if (N >= 0 && N < numRealColumns && cursor->currentData
+        && cursor->cachedFastExtractor && !cipher) {
+        if (stats) stats->fastExtractorCalls++;
+        if (cursor->cachedFastExtractor(cursor->currentData, cursor->currentLength, N, ctx)) {
+            return SQLITE_OK;
+        }
+    }
+
+    // Generated reader for tables without a hand-written fast extractor
+    if (N >= 0 && N < numRealColumns && cursor->currentData && vtab->schemaExtractor
+        && !cursor->cachedFastExtractor) {
+        if (stats) {
+            stats->schemaExtractorCalls++;
+            if (cipher) stats->decryptions++;
+        }
+        bool done = cipher
+            ? vtab->schemaExtractor->extractDecryptedTo(cursor->currentData, cursor->currentLength, N,
+                                                        ctx, decryptField, cipher, cursor->decryptScratch)
+            : vtab->schemaExtractor->extractTo(cursor->currentData, cursor->currentLength, N, ctx);
+        if (done) {
+            return SQLITE_OK;
+        }
+    }
+
     // Slow path: virtual columns or fallback extraction
     if (N == vtab->sourceColumnIndex) {
         sqlite3_result_text(ctx, vtab->sourceName.c_str(),
@@ -767,6 +2224,29 @@ int FlatBufferVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context*
         return SQLITE_OK;
     }
 
+    if (N == vtab->rankColumnIndex) {
+        const Value* score = cursor->ranked && cursor->indexPosition < cursor->indexResults.size()
+            ? &cursor->indexResults[cursor->indexPosition].key : nullptr;
+        if (score && std::holds_alternative<double>(*score)) {
+            sqlite3_result_double(ctx, std::get<double>(*score));
+        } else {
+            sqlite3_result_null(ctx);
+        }
+        return SQLITE_OK;
+    }
+
+    if (N == numRealColumns + 4) {
+        double point[2];
+        if (cursor->currentData && vtab->extractor &&
+            geoCoordinate(vtab, cursor, vtab->tableDef->geoLatColumn, point[0]) &&
+            geoCoordinate(vtab, cursor, vtab->tableDef->geoLonColumn, point[1])) {
+            sqlite3_result_blob(ctx, point, GEO_POINT_BYTES, SQLITE_TRANSIENT);
+        } else {
+            sqlite3_result_null(ctx);
+        }
+        return SQLITE_OK;
+    }
+
     if (N < 0 || N >= numRealColumns || !cursor->currentData) {
         sqlite3_result_null(ctx);
         return SQLITE_OK;
@@ -779,29 +2259,111 @@ int FlatBufferVTabModule::xColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context*
     }
 
     if (!cursor->cacheValid) {
+        if (stats) stats->slowExtractorCalls++;
         for (int i = 0; i < numRealColumns; i++) {
             cursor->columnCache[i] = vtab->extractor(cursor->currentData, cursor->currentLength,
                                                       vtab->tableDef->columns[i].name);
         }
+        cursor->cacheValid = true;
+    }
 
-        // Decrypt encrypted columns if encryption context is present
-        if (vtab->encryptionCtx) {
-            for (int i = 0; i < numRealColumns; i++) {
-                if (vtab->tableDef->columns[i].encrypted) {
-                    decryptColumnValue(cursor->columnCache[i],
-                                       *vtab->encryptionCtx,
-                                       vtab->tableDef->columns[i].fieldId);
+    // Decrypt on first use, keeping the plaintext for the next visit
+    if (cipher) {
+        uint64_t sequence = cursor->currentSequence;
+        DecryptedValue& slot = decryptedSlot(cursor, sequence, N);
+        if (slot.sequence != sequence || slot.column != N) {
+            DecryptedValue* filled[DECRYPT_AHEAD];
+            FieldSpan spans[DECRYPT_AHEAD];
+            size_t count = 0;
+            slot.value = cursor->columnCache[N];
+            slot.sequence = sequence;
+            slot.column = N;
+            filled[count] = &slot;
+            spans[count++] = encryptedBytes(slot.value, *cipher);
+
+            // A full scan will ask for the same column of the next rows
+            if (cursor->scanType == ScanType::FullScan && !cursor->useLazyScan &&
+                cursor->scanRecordInfos) {
+                const std::string& name = vtab->tableDef->columns[N].name;
+                for (size_t row = cursor->scanFileIndex + 1;
+                     row < cursor->scanFileCount && count < DECRYPT_AHEAD; row++) {
+                    const auto& info = (*cursor->scanRecordInfos)[row];
+                    DecryptedValue& ahead = decryptedSlot(cursor, info.sequence, N);
+                    if (ahead.sequence == info.sequence && ahead.column == N) continue;
+                    // Stop before evicting a value decrypted by this call
+                    if (std::find(filled, filled + count, &ahead) != filled + count) break;
+                    const uint8_t* record = cursor->scanStore->recordAt(info.offset);
+                    uint32_t length = static_cast<uint32_t>(record[0]) |
+                                      (static_cast<uint32_t>(record[1]) << 8) |
+                                      (static_cast<uint32_t>(record[2]) << 16) |
+                                      (static_cast<uint32_t>(record[3]) << 24);
+                    ahead.value = vtab->extractor(record + SIZE_PREFIX_LENGTH, length, name);
+                    ahead.sequence = info.sequence;
+                    ahead.column = N;
+                    filled[count] = &ahead;
+                    spans[count++] = encryptedBytes(ahead.value, *cipher);
                 }
             }
+            cryptFields(spans, count);
+            if (stats) stats->decryptions += count;
         }
-
-        cursor->cacheValid = true;
+        setResultFromValue(ctx, slot.value);
+        return SQLITE_OK;
     }
 
     setResultFromValue(ctx, cursor->columnCache[N]);
     return SQLITE_OK;
 }
 
+// match(query, text) for MATCH without a full-text index: NULL for NULLs
+static void matchFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    if (argc != 2 || sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    auto text = [](sqlite3_value* value) {
+        const char* data = reinterpret_cast<const char*>(sqlite3_value_text(value));
+        return std::string_view(data ? data : "", static_cast<size_t>(sqlite3_value_bytes(value)));
+    };
+    sqlite3_result_int(ctx, FullTextIndex::matches(text(argv[0]), text(argv[1])) ? 1 : 0);
+}
+
+int FlatBufferVTabModule::xFindFunction(sqlite3_vtab* pVTab, int nArg, const char* zName,
+                                        void (**pxFunc)(sqlite3_context*, int, sqlite3_value**),
+                                        void** ppArg) {
+    // column MATCH 'query' that no full-text index answered: test each
+    // row's text (match() receives the query first)
+    if (nArg == 2 && sqlite3_stricmp(zName, "match") == 0) {
+        *pxFunc = matchFunction;
+        *ppArg = nullptr;
+        return 1;
+    }
+
+    // fuzzy_within(column, pattern) as a constraint, answered from the
+    // column's trigram index if it has one (xBestIndex sees the column)
+    FlatBufferVTab* vtab = static_cast<FlatBufferVTab*>(pVTab);
+    if (nArg == 2 && sqlite3_stricmp(zName, "fuzzy_within") == 0) {
+        const auto& columns = vtab->tableDef->columns;
+        if (std::none_of(columns.begin(), columns.end(), [](const ColumnDef& col) { return col.trigram; })) {
+            return 0;
+        }
+        *pxFunc = fuzzyWithinFunction;
+        *ppArg = nullptr;
+        return SQLITE_INDEX_CONSTRAINT_FUNCTION;
+    }
+
+    // Same function, but as a constraint xBestIndex can answer from the
+    // spatial index
+    auto indexIt = vtab->indexes.find(GEO_COLUMN);
+    if (nArg != 2 || sqlite3_stricmp(zName, "geo_within") != 0 ||
+        indexIt == vtab->indexes.end() || !indexIt->second) {
+        return 0;
+    }
+    *pxFunc = geoWithinFunction;
+    *ppArg = nullptr;
+    return SQLITE_INDEX_CONSTRAINT_FUNCTION;
+}
+
 int FlatBufferVTabModule::xRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
     FlatBufferCursor* cursor = static_cast<FlatBufferCursor*>(pCursor);
     *pRowid = static_cast<sqlite3_int64>(cursor->currentSequence);
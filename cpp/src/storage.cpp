@@ -1,7 +1,20 @@
 #include "flatsql/storage.h"
+#include "flatsql/block_codec.h"
+#include "flatsql/trace.h"
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <mutex>
 #include <stdexcept>
 
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define FLATSQL_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace flatsql {
 
 // CRC32 implementation (IEEE polynomial) - kept for potential future use
@@ -41,11 +54,50 @@ static inline uint32_t readLE32(const uint8_t* src) {
 
 // ==================== StreamingFlatBufferStore ====================
 
+// Layout IDs are never reused, so a pin can't outlive its store's layout
+static uint64_t nextLayoutId() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
 StreamingFlatBufferStore::StreamingFlatBufferStore(size_t initialCapacity)
-    : data_(initialCapacity) {
+    : data_(initialCapacity), layoutId_(nextLayoutId()) {
+    flatBase_ = data_.data();
+}
+
+StreamingFlatBufferStore::StreamingFlatBufferStore(const StorageOptions& options)
+    : mode_(options.mode),
+      coldCacheCapacity_(std::max<size_t>(1, options.coldCacheSegments)),
+      layoutId_(nextLayoutId()) {
+    if (options.mode == StorageMode::Contiguous) {
+        data_.resize(options.initialCapacity);
+        flatBase_ = data_.data();
+        return;
+    }
+    if (options.mode == StorageMode::MappedFile) {
+        openMapped(options);
+        return;
+    }
+
+    // Round the chunk size up to a power of two so offsets split with shift/mask
+    uint32_t shift = 4;
+    while ((uint64_t(1) << shift) < options.segmentSize && shift < 62) {
+        shift++;
+    }
+    segmentShift_ = shift;
+    segmentMask_ = (uint64_t(1) << shift) - 1;
+}
+
+StreamingFlatBufferStore::~StreamingFlatBufferStore() {
+    closeMapped();
 }
 
 void StreamingFlatBufferStore::ensureCapacity(size_t needed) {
+    if (mode_ == StorageMode::MappedFile) {
+        growMapping(writeOffset_ + needed);
+        return;
+    }
+
     size_t totalNeeded = static_cast<size_t>(writeOffset_) + needed;
     if (totalNeeded <= data_.size()) return;
 
@@ -54,6 +106,488 @@ void StreamingFlatBufferStore::ensureCapacity(size_t needed) {
         newSize *= 2;
     }
     data_.resize(newSize);
+    flatBase_ = data_.data();
+}
+
+// ==================== MappedFile mode ====================
+
+// Sidecar layout (native byte order, rewritten on every sync):
+//   "FSQM" | version u32 | streamLength u64 | nextSequence u64 | lastOffset u64 |
+//   fileIdCount u64 | per file ID: idLength u32, id bytes, count u64, count x (offset u64, sequence u64)
+static constexpr char SIDECAR_MAGIC[4] = {'F', 'S', 'Q', 'M'};
+static constexpr uint32_t SIDECAR_VERSION = 1;
+
+void StreamingFlatBufferStore::openMapped(const StorageOptions& options) {
+#ifdef FLATSQL_HAVE_MMAP
+    if (options.path.empty()) {
+        throw std::runtime_error("MappedFile storage requires a path");
+    }
+    mapPath_ = options.path;
+
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t reserve = options.mapReserve;
+    if (reserve == 0) {
+        reserve = sizeof(void*) >= 8 ? (uint64_t(1) << 38) : (uint64_t(1) << 30);
+    }
+    mapReserved_ = (reserve + pageSize - 1) / pageSize * pageSize;
+
+    mapFd_ = ::open(mapPath_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (mapFd_ < 0) {
+        throw std::runtime_error("Failed to open storage file: " + mapPath_);
+    }
+
+    struct stat st;
+    if (fstat(mapFd_, &st) != 0 || static_cast<uint64_t>(st.st_size) > mapReserved_) {
+        ::close(mapFd_);
+        mapFd_ = -1;
+        throw std::runtime_error("Storage file exceeds reserved mapping size: " + mapPath_);
+    }
+    uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+
+    // Reserve the address range once so the mapping never moves
+    void* base = mmap(nullptr, static_cast<size_t>(mapReserved_), PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        ::close(mapFd_);
+        mapFd_ = -1;
+        throw std::runtime_error("Failed to reserve address space for storage file");
+    }
+    flatBase_ = static_cast<uint8_t*>(base);
+
+    if (fileSize > 0) {
+        growMapping(fileSize);
+        if (!loadSidecar(fileSize)) {
+            sequenceOffsets_.clear();
+            fileIdToRecords_.clear();
+            fileIdRoutes_.clear();
+            recordCount_ = 0;
+            nextSequence_ = 1;
+            writeOffset_ = 0;
+            restoredLength_ = 0;
+        }
+        // Pick up anything appended after the last sync
+        scanMapped(restoredLength_, fileSize);
+        publish();
+    }
+#else
+    (void)options;
+    throw std::runtime_error("MappedFile storage is not supported on this platform");
+#endif
+}
+
+void StreamingFlatBufferStore::growMapping(uint64_t needed) {
+#ifdef FLATSQL_HAVE_MMAP
+    if (needed <= mapLength_) return;
+    if (needed > mapReserved_) {
+        throw std::runtime_error("Storage file exceeded reserved mapping size");
+    }
+
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t newLength = mapLength_ ? mapLength_ * 2 : 1024 * 1024;
+    while (newLength < needed) {
+        newLength *= 2;
+    }
+    newLength = (newLength + pageSize - 1) / pageSize * pageSize;
+    if (newLength > mapReserved_) {
+        newLength = mapReserved_;
+    }
+
+    struct stat st;
+    if (fstat(mapFd_, &st) != 0) {
+        throw std::runtime_error("Failed to stat storage file: " + mapPath_);
+    }
+    if (static_cast<uint64_t>(st.st_size) < newLength &&
+        ftruncate(mapFd_, static_cast<off_t>(newLength)) != 0) {
+        throw std::runtime_error("Failed to extend storage file: " + mapPath_);
+    }
+
+    // Map only the new tail, in place inside the reserved range
+    void* p = mmap(flatBase_ + mapLength_, static_cast<size_t>(newLength - mapLength_),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                   mapFd_, static_cast<off_t>(mapLength_));
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Failed to map storage file: " + mapPath_);
+    }
+    mapLength_ = newLength;
+#else
+    (void)needed;
+#endif
+}
+
+void StreamingFlatBufferStore::scanMapped(uint64_t fromOffset, uint64_t fileSize) {
+    // The file may carry a zero-filled tail from growth that was never
+    // trimmed (e.g. after a crash), so a zero size prefix ends the stream.
+    uint64_t offset = fromOffset;
+    while (offset + SIZE_PREFIX_LENGTH <= fileSize) {
+        uint32_t fbSize = readLE32(flatBase_ + offset);
+        if (fbSize == 0 || offset + SIZE_PREFIX_LENGTH + fbSize > fileSize) {
+            break;
+        }
+
+        uint64_t seq = nextSequence_++;
+        sequenceOffsets_.push_back(offset);
+        recordCount_++;
+        indexRecord(flatBase_ + offset + SIZE_PREFIX_LENGTH, fbSize, offset, seq);
+
+        offset += SIZE_PREFIX_LENGTH + fbSize;
+    }
+    writeOffset_ = offset;
+}
+
+bool StreamingFlatBufferStore::loadSidecar(uint64_t fileSize) {
+    FILE* f = std::fopen((mapPath_ + ".meta").c_str(), "rb");
+    if (!f) return false;
+
+    auto readU32 = [f](uint32_t& v) { return std::fread(&v, sizeof(v), 1, f) == 1; };
+    auto readU64 = [f](uint64_t& v) { return std::fread(&v, sizeof(v), 1, f) == 1; };
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t streamLength = 0, nextSequence = 0, lastOffset = 0, fileIdCount = 0;
+    bool ok = std::fread(magic, 1, 4, f) == 4 &&
+              std::memcmp(magic, SIDECAR_MAGIC, 4) == 0 &&
+              readU32(version) && version == SIDECAR_VERSION &&
+              readU64(streamLength) && readU64(nextSequence) &&
+              readU64(lastOffset) && readU64(fileIdCount) &&
+              streamLength <= fileSize;
+
+    // The last record described by the sidecar must end exactly at streamLength
+    if (ok && streamLength > 0) {
+        ok = lastOffset + SIZE_PREFIX_LENGTH <= streamLength &&
+             lastOffset + SIZE_PREFIX_LENGTH + readLE32(flatBase_ + lastOffset) == streamLength;
+    }
+
+    for (uint64_t i = 0; ok && i < fileIdCount; i++) {
+        uint32_t idLength = 0;
+        uint64_t count = 0;
+        std::string fileId;
+        ok = readU32(idLength) && idLength <= 256;
+        if (ok) {
+            fileId.resize(idLength);
+            ok = std::fread(&fileId[0], 1, idLength, f) == idLength && readU64(count);
+        }
+        if (!ok) break;
+
+        if (i == 0) {
+            ok = nextSequence >= 1;
+            sequenceOffsets_.assign(ok ? static_cast<size_t>(nextSequence - 1) : 0, UINT64_MAX);
+        }
+
+        std::vector<FileRecordInfo> infos(static_cast<size_t>(count));
+        ok = ok && (count == 0 || std::fread(infos.data(), sizeof(FileRecordInfo), infos.size(), f) == infos.size());
+        auto& list = fileIdToRecords_[fileId];
+        for (size_t j = 0; ok && j < infos.size(); j++) {
+            const FileRecordInfo& info = infos[j];
+            if (info.offset >= streamLength || info.sequence == 0 || info.sequence >= nextSequence) {
+                ok = false;
+                break;
+            }
+            sequenceOffsets_[info.sequence - 1] = info.offset;
+            list.push_back(info);
+        }
+        recordCount_ += ok ? count : 0;
+    }
+    std::fclose(f);
+
+    // Every sequence must be accounted for, in ascending offset order
+    ok = ok && recordCount_ == sequenceOffsets_.size() &&
+         (sequenceOffsets_.empty() || sequenceOffsets_.back() != UINT64_MAX);
+    for (size_t i = 1; ok && i < sequenceOffsets_.size(); i++) {
+        ok = sequenceOffsets_[i - 1] <= sequenceOffsets_[i];
+    }
+    if (!ok) return false;
+    writeOffset_ = streamLength;
+    nextSequence_ = nextSequence;
+    restoredLength_ = streamLength;
+    return true;
+}
+
+void StreamingFlatBufferStore::sync() {
+    if (mode_ != StorageMode::MappedFile) return;
+#ifdef FLATSQL_HAVE_MMAP
+    if (writeOffset_ > 0 && msync(flatBase_, static_cast<size_t>(writeOffset_), MS_SYNC) != 0) {
+        throw std::runtime_error("Failed to flush storage file: " + mapPath_);
+    }
+
+    // Last record offset lets a reopen verify the sidecar matches the stream
+    uint64_t lastOffset = 0;
+    for (const auto& [fileId, infos] : fileIdToRecords_) {
+        if (!infos.empty() && infos.back().offset > lastOffset) {
+            lastOffset = infos.back().offset;
+        }
+    }
+
+    std::string tmpPath = mapPath_ + ".meta.tmp";
+    FILE* f = std::fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        throw std::runtime_error("Failed to write storage sidecar: " + tmpPath);
+    }
+    uint64_t fileIdCount = fileIdToRecords_.size();
+    bool ok = std::fwrite(SIDECAR_MAGIC, 1, 4, f) == 4 &&
+              std::fwrite(&SIDECAR_VERSION, sizeof(uint32_t), 1, f) == 1 &&
+              std::fwrite(&writeOffset_, sizeof(uint64_t), 1, f) == 1 &&
+              std::fwrite(&nextSequence_, sizeof(uint64_t), 1, f) == 1 &&
+              std::fwrite(&lastOffset, sizeof(uint64_t), 1, f) == 1 &&
+              std::fwrite(&fileIdCount, sizeof(uint64_t), 1, f) == 1;
+    for (const auto& [fileId, infos] : fileIdToRecords_) {
+        if (!ok) break;
+        uint32_t idLength = static_cast<uint32_t>(fileId.size());
+        uint64_t count = infos.size();
+        ok = std::fwrite(&idLength, sizeof(idLength), 1, f) == 1 &&
+             std::fwrite(fileId.data(), 1, idLength, f) == idLength &&
+             std::fwrite(&count, sizeof(count), 1, f) == 1;
+        infos.forEachRun([&](const FileRecordInfo* run, size_t n) {
+            ok = ok && std::fwrite(run, sizeof(FileRecordInfo), n, f) == n;
+        });
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmpPath.c_str(), (mapPath_ + ".meta").c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("Failed to write storage sidecar: " + mapPath_ + ".meta");
+    }
+#endif
+}
+
+void StreamingFlatBufferStore::closeMapped() {
+#ifdef FLATSQL_HAVE_MMAP
+    if (mapFd_ < 0) return;
+    try {
+        sync();
+    } catch (...) {
+        // Best effort: without a sidecar the next open rescans the stream
+    }
+    munmap(flatBase_, static_cast<size_t>(mapReserved_));
+    // Trim growth slack so the file is exactly the size-prefixed stream
+    if (ftruncate(mapFd_, static_cast<off_t>(writeOffset_)) != 0) {
+        // Leave the zero tail; reopen stops at the first empty prefix
+    }
+    ::close(mapFd_);
+    mapFd_ = -1;
+    flatBase_ = nullptr;
+#endif
+}
+
+uint8_t* StreamingFlatBufferStore::reserveRecord(size_t bytes, uint64_t* outOffset) {
+    if (__builtin_expect(pendingIngest_ != 0, 0)) {
+        throw std::runtime_error("A partial record from commitIngest() is pending");
+    }
+    reservedIngest_ = 0;
+    if (segmentShift_ == 0) {
+        ensureCapacity(bytes);
+        *outOffset = writeOffset_;
+        uint8_t* dest = flatBase_ + writeOffset_;
+        writeOffset_ += bytes;
+        return dest;
+    }
+
+    // Records never straddle chunks: if this one does not fit in the current
+    // chunk, abandon its tail and start a fresh run at the next boundary.
+    size_t slot = static_cast<size_t>(writeOffset_ >> segmentShift_);
+    uint64_t used = writeOffset_ & segmentMask_;
+    if (slot >= segmentBases_.size() || used + bytes > segmentMask_ + 1) {
+        startSegmentRun(bytes, 0);
+    }
+
+    *outOffset = writeOffset_;
+    uint8_t* dest = segmentBases_[writeOffset_ >> segmentShift_] + (writeOffset_ & segmentMask_);
+    writeOffset_ += bytes;
+    segmentEnd_[(writeOffset_ - 1) >> segmentShift_] = writeOffset_;
+    return dest;
+}
+
+void StreamingFlatBufferStore::startSegmentRun(size_t bytes, size_t keep) {
+    uint64_t start = (writeOffset_ + segmentMask_) & ~segmentMask_;
+    size_t first = static_cast<size_t>(start >> segmentShift_);
+    size_t count = static_cast<size_t>((bytes + segmentMask_) >> segmentShift_);
+    size_t chunkBytes = static_cast<size_t>(segmentMask_ + 1);
+
+    // Oversized records get one allocation covering consecutive chunk slots
+    std::unique_ptr<uint8_t[]> block(new uint8_t[count * chunkBytes]);
+    if (keep) {
+        std::memcpy(block.get(), segmentBases_[writeOffset_ >> segmentShift_] + (writeOffset_ & segmentMask_), keep);
+    }
+
+    // Chunks of the last allocation past the write position hold nothing
+    // yet (a reserveIngest() tail outgrew them); the new run takes their slots
+    size_t unused = segmentBases_.size() - first;
+    if (unused) {
+        segmentRuns_.back() -= unused;
+        if (segmentRuns_.back() == 0) {
+            segmentStorage_.pop_back();
+            segmentRuns_.pop_back();
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (first + i < segmentBases_.size()) {
+            segmentBases_[first + i] = block.get() + i * chunkBytes;
+            segmentEnd_[first + i] = 0;
+        } else {
+            segmentBases_.push_back(block.get() + i * chunkBytes);
+            segmentEnd_.push_back(0);
+        }
+    }
+    segmentStorage_.push_back(std::move(block));
+    segmentRuns_.push_back(count);
+    writeOffset_ = start;
+}
+
+uint8_t* StreamingFlatBufferStore::reserveIngest(size_t bytes) {
+    size_t total = pendingIngest_ + bytes;
+    if (segmentShift_ == 0) {
+        ensureCapacity(total);
+        reservedIngest_ = bytes;
+        return flatBase_ + writeOffset_ + pendingIngest_;
+    }
+
+    // The pending record and the new bytes must be contiguous, so a tail
+    // that outgrows the last allocation moves with them to a new run
+    if (writeOffset_ + total > uint64_t(segmentBases_.size()) << segmentShift_) {
+        startSegmentRun(total, pendingIngest_);
+    }
+    reservedIngest_ = bytes;
+    return segmentBases_[writeOffset_ >> segmentShift_] + (writeOffset_ & segmentMask_) + pendingIngest_;
+}
+
+size_t StreamingFlatBufferStore::commitIngest(size_t bytes, IngestCallback callback) {
+    if (bytes > reservedIngest_) {
+        throw std::runtime_error("commitIngest() past the reserved space");
+    }
+    reservedIngest_ = 0;
+    pendingIngest_ += bytes;
+
+    // reserveIngest() keeps the whole tail in one allocation
+    uint8_t* tail = segmentShift_ == 0
+        ? flatBase_ + writeOffset_
+        : segmentBases_[writeOffset_ >> segmentShift_] + (writeOffset_ & segmentMask_);
+
+    size_t records = 0;
+    size_t offset = 0;
+    while (offset + SIZE_PREFIX_LENGTH <= pendingIngest_) {
+        uint32_t fbSize = readLE32(tail + offset);
+        if (offset + SIZE_PREFIX_LENGTH + fbSize > pendingIngest_) {
+            break;  // Incomplete, wait for more data
+        }
+
+        const uint8_t* fbData = tail + offset + SIZE_PREFIX_LENGTH;
+        uint64_t storeOffset = writeOffset_ + offset;
+        uint64_t seq = nextSequence_++;
+        sequenceOffsets_.push_back(storeOffset);
+        recordCount_++;
+
+        std::string_view fileId = indexRecord(fbData, fbSize, storeOffset, seq);
+        if (callback) {
+            callback(fileId, fbData, fbSize, seq, storeOffset);
+        }
+
+        offset += SIZE_PREFIX_LENGTH + fbSize;
+        records++;
+    }
+
+    if (segmentShift_ != 0 && offset != 0) {
+        // Inside a run of several chunks records may cross chunk boundaries;
+        // a chunk they run past ends at its boundary, so nextRecordOffset()
+        // never skips from it
+        uint64_t end = writeOffset_ + offset;
+        for (size_t c = static_cast<size_t>(writeOffset_ >> segmentShift_);
+             c <= static_cast<size_t>((end - 1) >> segmentShift_); c++) {
+            segmentEnd_[c] = std::min(end, (uint64_t(c) + 1) << segmentShift_);
+        }
+    }
+    writeOffset_ += offset;
+    pendingIngest_ -= offset;
+
+    if (!publishDeferred_) {
+        publish();
+    }
+    return records;
+}
+
+uint64_t StreamingFlatBufferStore::nextRecordOffset(uint64_t offset, uint32_t fbSize) const {
+    uint64_t next = offset + SIZE_PREFIX_LENGTH + fbSize;
+    // Last record of a chunk: skip the unused tail to the next chunk boundary
+    if (segmentShift_ != 0 && next < writeOffset_ &&
+        next == segmentEnd_[(next - 1) >> segmentShift_]) {
+        next = (next + segmentMask_) & ~segmentMask_;
+    }
+    return next;
+}
+
+StreamingFlatBufferStore::ExportCursor StreamingFlatBufferStore::beginExport(uint64_t afterSequence) const {
+    ExportCursor cursor;
+    cursor.end = writeOffset_;
+    cursor.endSequence = nextSequence_ - 1;
+    afterSequence = std::max(afterSequence, evictedSequence_);
+    cursor.sequence = afterSequence;
+    // Sequence s + 1 is stored at sequenceOffsets_[s]
+    cursor.offset = afterSequence < cursor.endSequence ? sequenceOffsets_[afterSequence] : cursor.end;
+    return cursor;
+}
+
+bool StreamingFlatBufferStore::nextExportChunk(ExportCursor& cursor, const uint8_t** data,
+                                               size_t* length) const {
+    if (cursor.offset >= cursor.end) {
+        return false;
+    }
+    if (segmentShift_ == 0) {
+        *data = flatBase_ + cursor.offset;
+        *length = static_cast<size_t>(cursor.end - cursor.offset);
+        cursor.offset = cursor.end;
+        cursor.sequence = cursor.endSequence;
+        return true;
+    }
+
+    // Gather records while they sit back to back in memory: a chunk, or
+    // a run of chunks that came from one allocation
+    const uint8_t* start = nullptr;
+    size_t spanLength = 0;
+    size_t spanSlot = 0;
+    while (cursor.offset < cursor.end) {
+        size_t slot = static_cast<size_t>(cursor.offset >> segmentShift_);
+        // A cold chunk's copy only lives while the pin holds it
+        if (start && slot != spanSlot && (!segmentBases_[slot] || !segmentBases_[spanSlot])) {
+            break;
+        }
+        const uint8_t* record = recordAt(cursor.offset, cursor.pin);
+        if (start && record != start + spanLength) {
+            break;
+        }
+        if (!start) {
+            start = record;
+            spanSlot = slot;
+        }
+        uint32_t fbSize = readLE32(record);
+        spanLength += SIZE_PREFIX_LENGTH + fbSize;
+        cursor.sequence++;
+        cursor.offset = nextRecordOffset(cursor.offset, fbSize);
+    }
+    *data = start;
+    *length = spanLength;
+    return true;
+}
+
+uint64_t StreamingFlatBufferStore::exportChunks(const ExportCallback& callback, uint64_t afterSequence) const {
+    ExportCursor cursor = beginExport(afterSequence);
+    const uint8_t* data;
+    size_t length;
+    uint64_t exported = cursor.sequence;
+    while (nextExportChunk(cursor, &data, &length)) {
+        if (!callback(data, length)) break;
+        exported = cursor.sequence;
+    }
+    return exported;
+}
+
+std::vector<uint8_t> StreamingFlatBufferStore::exportSince(uint64_t sequence) const {
+    // Re-pack the chunks into a plain stream (chunk tails are dropped)
+    std::vector<uint8_t> out;
+    ExportCursor cursor = beginExport(sequence);
+    out.reserve(static_cast<size_t>(cursor.end - cursor.offset));
+    const uint8_t* data;
+    size_t length;
+    while (nextExportChunk(cursor, &data, &length)) {
+        out.insert(out.end(), data, data + length);
+    }
+    return out;
 }
 
 std::string StreamingFlatBufferStore::extractFileId(const uint8_t* flatbuffer, size_t length) {
@@ -66,6 +600,7 @@ std::string StreamingFlatBufferStore::extractFileId(const uint8_t* flatbuffer, s
 }
 
 size_t StreamingFlatBufferStore::ingest(const uint8_t* data, size_t length, IngestCallback callback, size_t* recordsProcessed) {
+    FLATSQL_TRACE_SCOPE("StreamingFlatBufferStore::ingest");
     size_t records = 0;
     size_t offset = 0;
 
@@ -81,20 +616,17 @@ size_t StreamingFlatBufferStore::ingest(const uint8_t* data, size_t length, Inge
         const uint8_t* fbData = data + offset + SIZE_PREFIX_LENGTH;
 
         // Store with size prefix
-        uint64_t storeOffset = writeOffset_;
-        ensureCapacity(SIZE_PREFIX_LENGTH + fbSize);
-        std::memcpy(&data_[writeOffset_], data + offset, SIZE_PREFIX_LENGTH + fbSize);
-        writeOffset_ += SIZE_PREFIX_LENGTH + fbSize;
+        uint64_t storeOffset;
+        uint8_t* dest = reserveRecord(SIZE_PREFIX_LENGTH + fbSize, &storeOffset);
+        std::memcpy(dest, data + offset, SIZE_PREFIX_LENGTH + fbSize);
 
         // Assign sequence and index
         uint64_t seq = nextSequence_++;
-        sequenceToOffset_[seq] = storeOffset;
-        offsetToSequence_[storeOffset] = seq;
+        sequenceOffsets_.push_back(storeOffset);
         recordCount_++;
 
         // Extract file identifier and build file ID index
-        std::string fileId = extractFileId(fbData, fbSize);
-        indexRecord(fileId, storeOffset);
+        std::string_view fileId = indexRecord(fbData, fbSize, storeOffset, seq);
 
         if (callback) {
             callback(fileId, fbData, fbSize, seq, storeOffset);
@@ -107,6 +639,9 @@ size_t StreamingFlatBufferStore::ingest(const uint8_t* data, size_t length, Inge
     if (recordsProcessed) {
         *recordsProcessed = records;
     }
+    if (!publishDeferred_) {
+        publish();
+    }
     return offset;  // Return bytes consumed
 }
 
@@ -124,62 +659,61 @@ uint64_t StreamingFlatBufferStore::ingestOne(const uint8_t* sizePrefixedData, si
     const uint8_t* fbData = sizePrefixedData + SIZE_PREFIX_LENGTH;
 
     // Store
-    uint64_t storeOffset = writeOffset_;
-    ensureCapacity(SIZE_PREFIX_LENGTH + fbSize);
-    std::memcpy(&data_[writeOffset_], sizePrefixedData, SIZE_PREFIX_LENGTH + fbSize);
-    writeOffset_ += SIZE_PREFIX_LENGTH + fbSize;
+    uint64_t storeOffset;
+    uint8_t* dest = reserveRecord(SIZE_PREFIX_LENGTH + fbSize, &storeOffset);
+    std::memcpy(dest, sizePrefixedData, SIZE_PREFIX_LENGTH + fbSize);
 
     // Assign sequence
     uint64_t seq = nextSequence_++;
-    sequenceToOffset_[seq] = storeOffset;
-    offsetToSequence_[storeOffset] = seq;
+    sequenceOffsets_.push_back(storeOffset);
     recordCount_++;
 
     // Build file ID index
-    std::string fileId = extractFileId(fbData, fbSize);
-    indexRecord(fileId, storeOffset);
+    std::string_view fileId = indexRecord(fbData, fbSize, storeOffset, seq);
 
     if (callback) {
         callback(fileId, fbData, fbSize, seq, storeOffset);
     }
 
+    if (!publishDeferred_) {
+        publish();
+    }
     return seq;
 }
 
 uint64_t StreamingFlatBufferStore::ingestFlatBuffer(const uint8_t* data, size_t length,
                                                      IngestCallback callback) {
     // Store with size prefix
-    uint64_t storeOffset = writeOffset_;
-    ensureCapacity(SIZE_PREFIX_LENGTH + length);
-
-    writeLE32(&data_[writeOffset_], static_cast<uint32_t>(length));
-    writeOffset_ += SIZE_PREFIX_LENGTH;
-
-    std::memcpy(&data_[writeOffset_], data, length);
-    writeOffset_ += length;
+    uint64_t storeOffset;
+    uint8_t* dest = reserveRecord(SIZE_PREFIX_LENGTH + length, &storeOffset);
+    writeLE32(dest, static_cast<uint32_t>(length));
+    std::memcpy(dest + SIZE_PREFIX_LENGTH, data, length);
 
     // Assign sequence
     uint64_t seq = nextSequence_++;
-    sequenceToOffset_[seq] = storeOffset;
-    offsetToSequence_[storeOffset] = seq;
+    sequenceOffsets_.push_back(storeOffset);
     recordCount_++;
 
     // Build file ID index
-    std::string fileId = extractFileId(data, length);
-    indexRecord(fileId, storeOffset);
+    std::string_view fileId = indexRecord(data, length, storeOffset, seq);
 
     if (callback) {
         callback(fileId, data, length, seq, storeOffset);
     }
 
+    if (!publishDeferred_) {
+        publish();
+    }
     return seq;
 }
 
 void StreamingFlatBufferStore::loadAndRebuild(const uint8_t* data, size_t length,
                                                IngestCallback callback) {
-    // Copy all data
-    ensureCapacity(length);
-    std::memcpy(data_.data(), data, length);
+    // Copy all data (Segmented mode copies record by record below)
+    if (segmentShift_ == 0) {
+        ensureCapacity(length);
+        std::memcpy(flatBase_, data, length);
+    }
 
     // Scan through and rebuild indexes
     size_t offset = 0;
@@ -192,22 +726,296 @@ void StreamingFlatBufferStore::loadAndRebuild(const uint8_t* data, size_t length
 
         const uint8_t* fbData = data + offset + SIZE_PREFIX_LENGTH;
 
+        uint64_t storeOffset = offset;
+        if (segmentShift_ != 0) {
+            uint8_t* dest = reserveRecord(SIZE_PREFIX_LENGTH + fbSize, &storeOffset);
+            std::memcpy(dest, data + offset, SIZE_PREFIX_LENGTH + fbSize);
+        }
+
         uint64_t seq = nextSequence_++;
-        sequenceToOffset_[seq] = offset;
-        offsetToSequence_[offset] = seq;
+        sequenceOffsets_.push_back(storeOffset);
         recordCount_++;
 
-        std::string fileId = extractFileId(fbData, fbSize);
-        indexRecord(fileId, offset);
+        std::string_view fileId = indexRecord(fbData, fbSize, storeOffset, seq);
 
         if (callback) {
-            callback(fileId, fbData, fbSize, seq, offset);
+            callback(fileId, fbData, fbSize, seq, storeOffset);
         }
 
         offset += SIZE_PREFIX_LENGTH + fbSize;
     }
 
-    writeOffset_ = offset;
+    if (segmentShift_ == 0) {
+        writeOffset_ = offset;
+    }
+    if (!publishDeferred_) {
+        publish();
+    }
+}
+
+void StreamingFlatBufferStore::publish() {
+    // Length first: a reader that sees the new sequence also sees its bytes
+    visibleLength_.store(writeOffset_, std::memory_order_release);
+    visibleSequence_.store(nextSequence_ - 1, std::memory_order_release);
+}
+
+void StreamingFlatBufferStore::swapContents(StreamingFlatBufferStore& other) {
+    if (mode_ == StorageMode::MappedFile || other.mode_ == StorageMode::MappedFile) {
+        throw std::runtime_error("Cannot swap file-backed storage");
+    }
+    if (mode_ != other.mode_ || segmentShift_ != other.segmentShift_) {
+        throw std::runtime_error("Cannot swap storage with a different layout");
+    }
+    if (pendingIngest_ != 0 || other.pendingIngest_ != 0) {
+        throw std::runtime_error("Cannot swap storage with a partial record pending");
+    }
+    reservedIngest_ = 0;
+
+    data_.swap(other.data_);
+    std::swap(flatBase_, other.flatBase_);
+    segmentStorage_.swap(other.segmentStorage_);
+    segmentRuns_.swap(other.segmentRuns_);
+    segmentBases_.swap(other.segmentBases_);
+    segmentEnd_.swap(other.segmentEnd_);
+    coldSegments_.swap(other.coldSegments_);
+    std::swap(evictedRuns_, other.evictedRuns_);
+    std::swap(evictedSlots_, other.evictedSlots_);
+    std::swap(evictedEnd_, other.evictedEnd_);
+    std::swap(evictedSequence_, other.evictedSequence_);
+    clearColdCache();
+    other.clearColdCache();
+    layoutId_ = nextLayoutId();
+    other.layoutId_ = nextLayoutId();
+    std::swap(writeOffset_, other.writeOffset_);
+    std::swap(recordCount_, other.recordCount_);
+    std::swap(nextSequence_, other.nextSequence_);
+    sequenceOffsets_.swap(other.sequenceOffsets_);
+
+    // Callers hold pointers to this store's lists, so swap them in place
+    {
+        std::unique_lock<std::shared_mutex> lock(fileIdMutex_);
+        std::unique_lock<std::shared_mutex> otherLock(other.fileIdMutex_);
+        for (auto& [fileId, infos] : other.fileIdToRecords_) {
+            fileIdToRecords_.try_emplace(fileId);
+        }
+        for (auto& [fileId, infos] : fileIdToRecords_) {
+            infos.swap(other.fileIdToRecords_[fileId]);
+        }
+    }
+
+    uint64_t sequence = visibleSequence_.load(std::memory_order_relaxed);
+    uint64_t length = visibleLength_.load(std::memory_order_relaxed);
+    visibleSequence_.store(other.visibleSequence_.load(std::memory_order_relaxed), std::memory_order_release);
+    visibleLength_.store(other.visibleLength_.load(std::memory_order_relaxed), std::memory_order_release);
+    other.visibleSequence_.store(sequence, std::memory_order_release);
+    other.visibleLength_.store(length, std::memory_order_release);
+}
+
+size_t StreamingFlatBufferStore::compressColdSegments(size_t keepHot) {
+    if (mode_ != StorageMode::Segmented) {
+        throw std::runtime_error("Cold segment compression requires Segmented storage");
+    }
+
+    // Chunks below the write position are sealed; the newest keepHot stay raw
+    size_t sealed = static_cast<size_t>(writeOffset_ >> segmentShift_);
+    size_t coldEnd = sealed > keepHot ? sealed - keepHot : 0;
+    coldSegments_.resize(segmentBases_.size());
+
+    size_t released = 0;
+    size_t slot = 0;
+    std::vector<uint8_t> compressed;
+    for (size_t b = 0; b < segmentStorage_.size() && slot < coldEnd; slot += segmentRuns_[b++]) {
+        // Oversized records span their run of chunks, which stays raw
+        std::unique_ptr<uint8_t[]>& block = segmentStorage_[b];
+        if (!block || segmentRuns_[b] != 1) continue;
+
+        size_t rawLength = static_cast<size_t>(segmentEnd_[slot] - (uint64_t(slot) << segmentShift_));
+        compressBlock(block.get(), rawLength, compressed);
+        if (compressed.size() > rawLength - rawLength / 8) continue;
+
+        ColdSegment& cold = coldSegments_[slot];
+        cold.bytes.assign(compressed.begin(), compressed.end());
+        cold.rawLength = rawLength;
+        segmentBases_[slot] = nullptr;
+        block.reset();
+        released += static_cast<size_t>(segmentMask_ + 1) - cold.bytes.size();
+    }
+    return released;
+}
+
+size_t StreamingFlatBufferStore::evictThrough(uint64_t sequence) {
+    if (mode_ != StorageMode::Segmented) {
+        throw std::runtime_error("Segment eviction requires Segmented storage");
+    }
+
+    // An allocation goes once it ends at or before the first kept record
+    // and below the write position (so it is sealed)
+    uint64_t keep = sequence < sequenceOffsets_.size() ? sequenceOffsets_[sequence] : writeOffset_;
+    size_t chunkBytes = static_cast<size_t>(segmentMask_ + 1);
+    size_t released = 0;
+    while (evictedRuns_ < segmentStorage_.size()) {
+        size_t run = segmentRuns_[evictedRuns_];
+        uint64_t end = uint64_t(evictedSlots_ + run) << segmentShift_;
+        if (end > keep || end > writeOffset_) break;
+
+        for (size_t slot = evictedSlots_; slot < evictedSlots_ + run; slot++) {
+            segmentBases_[slot] = nullptr;
+            if (slot < coldSegments_.size() && coldSegments_[slot].rawLength != 0) {
+                released += coldSegments_[slot].bytes.size();
+                coldSegments_[slot] = ColdSegment();
+            }
+        }
+        if (segmentStorage_[evictedRuns_]) {
+            released += run * chunkBytes;
+            segmentStorage_[evictedRuns_].reset();
+        }
+        evictedSlots_ += run;
+        evictedRuns_++;
+    }
+
+    evictedEnd_ = std::max(evictedEnd_, uint64_t(evictedSlots_) << segmentShift_);
+    evictedSequence_ = recordsBefore(evictedEnd_);
+    clearColdCache();
+    return released;
+}
+
+bool StreamingFlatBufferStore::getSealedSegment(size_t index, uint64_t* firstSequence,
+                                                uint64_t* lastSequence) const {
+    if (mode_ != StorageMode::Segmented) return false;
+    size_t run = evictedRuns_;
+    size_t slot = evictedSlots_;
+    for (; run < segmentRuns_.size() && index > 0; index--) {
+        slot += segmentRuns_[run++];
+    }
+    if (run == segmentRuns_.size()) return false;
+    uint64_t end = uint64_t(slot + segmentRuns_[run]) << segmentShift_;
+    if (end > writeOffset_) return false;
+    *firstSequence = recordsBefore(uint64_t(slot) << segmentShift_) + 1;
+    *lastSequence = recordsBefore(end);
+    return true;
+}
+
+size_t StreamingFlatBufferStore::getColdSegmentCount() const {
+    size_t count = 0;
+    for (const ColdSegment& cold : coldSegments_) {
+        count += cold.rawLength != 0;
+    }
+    return count;
+}
+
+uint64_t StreamingFlatBufferStore::getColdBytes() const {
+    uint64_t bytes = 0;
+    for (const ColdSegment& cold : coldSegments_) {
+        bytes += cold.bytes.size();
+    }
+    return bytes;
+}
+
+StorageMemory StreamingFlatBufferStore::getMemoryUsage() const {
+    StorageMemory usage;
+    if (mode_ == StorageMode::MappedFile) {
+        usage.mappedBytes = mapLength_;
+    } else if (segmentShift_ == 0) {
+        usage.streamBytes = data_.capacity();
+    } else {
+        for (size_t b = 0; b < segmentStorage_.size(); b++) {
+            if (segmentStorage_[b]) usage.streamBytes += uint64_t(segmentRuns_[b]) << segmentShift_;
+        }
+        usage.coldBytes = getColdBytes();
+        usage.chunkTableBytes = segmentBases_.capacityBytes() + segmentEnd_.capacity() * sizeof(uint64_t) +
+                                segmentStorage_.capacity() * (sizeof(std::unique_ptr<uint8_t[]>) + sizeof(size_t)) +
+                                coldSegments_.capacity() * sizeof(ColdSegment);
+        std::lock_guard<std::mutex> lock(coldCacheMutex_);
+        for (const auto& [slot, entry] : coldCache_) {
+            usage.coldCacheBytes += entry.data->capacity();
+        }
+    }
+    usage.sequenceMapBytes = sequenceOffsets_.capacityBytes();
+
+    std::shared_lock<std::shared_mutex> lock(fileIdMutex_);
+    for (const auto& [fileId, list] : fileIdToRecords_) {
+        usage.recordListBytes += list.capacityBytes() + sizeof(list) + fileId.capacity();
+    }
+    return usage;
+}
+
+const uint8_t* StreamingFlatBufferStore::coldRecordAt(uint64_t offset) const {
+    static thread_local SegmentPin threadPin;
+    return coldRecordAt(offset, threadPin);
+}
+
+const uint8_t* StreamingFlatBufferStore::coldRecordAt(uint64_t offset, SegmentPin& pin) const {
+    size_t slot = static_cast<size_t>(offset >> segmentShift_);
+    if (pin.store != layoutId_ || pin.slot != slot) {
+        pin.data = loadColdSegment(slot);
+        pin.store = layoutId_;
+        pin.slot = slot;
+    }
+    return pin.data->data() + (offset & segmentMask_);
+}
+
+std::shared_ptr<const std::vector<uint8_t>> StreamingFlatBufferStore::loadColdSegment(size_t slot) const {
+    std::lock_guard<std::mutex> lock(coldCacheMutex_);
+    auto it = coldCache_.find(slot);
+    if (it != coldCache_.end()) {
+        coldCacheOrder_.splice(coldCacheOrder_.begin(), coldCacheOrder_, it->second.position);
+        return it->second.data;
+    }
+
+    const ColdSegment& cold = coldSegments_[slot];
+    auto data = std::make_shared<std::vector<uint8_t>>(cold.rawLength);
+    if (!decompressBlock(cold.bytes.data(), cold.bytes.size(), data->data(), cold.rawLength)) {
+        throw std::runtime_error("Corrupt compressed segment");
+    }
+
+    // Holders of evicted chunks keep them through their pins
+    coldCacheOrder_.push_front(slot);
+    coldCache_[slot] = {data, coldCacheOrder_.begin()};
+    while (coldCache_.size() > coldCacheCapacity_) {
+        coldCache_.erase(coldCacheOrder_.back());
+        coldCacheOrder_.pop_back();
+    }
+    return data;
+}
+
+void StreamingFlatBufferStore::clearColdCache() {
+    std::lock_guard<std::mutex> lock(coldCacheMutex_);
+    coldCache_.clear();
+    coldCacheOrder_.clear();
+}
+
+size_t StreamingFlatBufferStore::visibleCount(const RecordInfoList& infos, uint64_t visibleSequence) {
+    size_t n = infos.size();
+    if (n == 0 || infos[n - 1].sequence <= visibleSequence) {
+        return n;
+    }
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (infos[mid].sequence <= visibleSequence) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void StreamingFlatBufferStore::replayFrom(uint64_t fromOffset, IngestCallback callback) const {
+    uint64_t offset = std::max(fromOffset, evictedEnd_);
+    uint64_t sequence = getSequenceForOffset(offset);
+    while (sequence != 0 && offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
+        const uint8_t* record = recordAt(offset);
+        uint32_t fbSize = readLE32(record);
+        if (offset + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
+            break;
+        }
+
+        const uint8_t* fbData = record + SIZE_PREFIX_LENGTH;
+        callback(fileIdView(fbData, fbSize), fbData, fbSize, sequence++, offset);
+
+        offset = nextRecordOffset(offset, fbSize);
+    }
 }
 
 const uint8_t* StreamingFlatBufferStore::getDataAtOffset(uint64_t offset, uint32_t* outLength) const {
@@ -216,8 +1024,12 @@ const uint8_t* StreamingFlatBufferStore::getDataAtOffset(uint64_t offset, uint32
     if (off + SIZE_PREFIX_LENGTH > writeOffset_) {
         throw std::runtime_error("Invalid offset: beyond data bounds");
     }
+    if (offset < evictedEnd_) {
+        throw std::runtime_error("Invalid offset: record evicted");
+    }
 
-    uint32_t fbSize = readLE32(&data_[off]);
+    const uint8_t* record = recordAt(off);
+    uint32_t fbSize = readLE32(record);
     if (off + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
         throw std::runtime_error("Invalid record: data extends beyond bounds");
     }
@@ -225,7 +1037,29 @@ const uint8_t* StreamingFlatBufferStore::getDataAtOffset(uint64_t offset, uint32
     if (outLength) {
         *outLength = fbSize;
     }
-    return &data_[off + SIZE_PREFIX_LENGTH];
+    return record + SIZE_PREFIX_LENGTH;
+}
+
+const uint8_t* StreamingFlatBufferStore::getVisibleDataAtOffset(uint64_t offset, uint32_t* outLength,
+                                                                SegmentPin* pin) const {
+    uint64_t limit = visibleLength_.load(std::memory_order_acquire);
+    if (offset + SIZE_PREFIX_LENGTH > limit) {
+        throw std::runtime_error("Invalid offset: beyond visible data");
+    }
+    if (offset < evictedEnd_) {
+        throw std::runtime_error("Invalid offset: record evicted");
+    }
+
+    const uint8_t* record = pin ? recordAt(offset, *pin) : recordAt(offset);
+    uint32_t fbSize = readLE32(record);
+    if (offset + SIZE_PREFIX_LENGTH + fbSize > limit) {
+        throw std::runtime_error("Invalid record: data extends beyond visible data");
+    }
+
+    if (outLength) {
+        *outLength = fbSize;
+    }
+    return record + SIZE_PREFIX_LENGTH;
 }
 
 StoredRecord StreamingFlatBufferStore::readRecordAtOffset(uint64_t offset) const {
@@ -237,11 +1071,7 @@ StoredRecord StreamingFlatBufferStore::readRecordAtOffset(uint64_t offset) const
     record.header.dataLength = fbSize;
     record.header.fileId = extractFileId(fbData, fbSize);
 
-    // Look up sequence in reverse map (O(1) instead of O(n))
-    auto it = offsetToSequence_.find(offset);
-    if (it != offsetToSequence_.end()) {
-        record.header.sequence = it->second;
-    }
+    record.header.sequence = getSequenceForOffset(offset);
 
     record.data.resize(fbSize);
     std::memcpy(record.data.data(), fbData, fbSize);
@@ -250,37 +1080,39 @@ StoredRecord StreamingFlatBufferStore::readRecordAtOffset(uint64_t offset) const
 }
 
 StoredRecord StreamingFlatBufferStore::readRecord(uint64_t sequence) const {
-    auto it = sequenceToOffset_.find(sequence);
-    if (it == sequenceToOffset_.end()) {
+    if (!hasRecord(sequence)) {
         throw std::runtime_error("Record not found for sequence: " + std::to_string(sequence));
     }
-    return readRecordAtOffset(it->second);
+    return readRecordAtOffset(sequenceOffsets_[sequence - 1]);
 }
 
-uint64_t StreamingFlatBufferStore::getSequenceForOffset(uint64_t offset) const {
-    auto it = offsetToSequence_.find(offset);
-    if (it != offsetToSequence_.end()) {
-        return it->second;
+size_t StreamingFlatBufferStore::recordsBefore(uint64_t offset) const {
+    // Offsets ascend with sequence, so the reverse mapping is a binary search
+    size_t lo = 0, hi = sequenceOffsets_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sequenceOffsets_[mid] < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return 0;  // Invalid sequence
+    return lo;
 }
 
-bool StreamingFlatBufferStore::hasRecord(uint64_t sequence) const {
-    return sequenceToOffset_.find(sequence) != sequenceToOffset_.end();
-}
-
-std::optional<uint64_t> StreamingFlatBufferStore::getOffsetForSequence(uint64_t sequence) const {
-    auto it = sequenceToOffset_.find(sequence);
-    if (it == sequenceToOffset_.end()) {
-        return std::nullopt;
+uint64_t StreamingFlatBufferStore::getSequenceForOffset(uint64_t offset) const {
+    size_t lo = recordsBefore(offset);
+    if (lo < sequenceOffsets_.size() && sequenceOffsets_[lo] == offset) {
+        return static_cast<uint64_t>(lo) + 1;
     }
-    return it->second;
+    return 0;  // Invalid sequence
 }
 
+
 void StreamingFlatBufferStore::iterateRecords(std::function<bool(const StoredRecord&)> callback) const {
-    size_t offset = 0;
+    size_t offset = static_cast<size_t>(evictedEnd_);
     while (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
-        uint32_t fbSize = readLE32(&data_[offset]);
+        uint32_t fbSize = readLE32(recordAt(offset));
         if (offset + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
             break;
         }
@@ -290,7 +1122,7 @@ void StreamingFlatBufferStore::iterateRecords(std::function<bool(const StoredRec
             break;
         }
 
-        offset += SIZE_PREFIX_LENGTH + fbSize;
+        offset = nextRecordOffset(offset, fbSize);
     }
 }
 
@@ -306,14 +1138,15 @@ void StreamingFlatBufferStore::iterateByFileId(std::string_view fileId,
 
 void StreamingFlatBufferStore::iterateRefsByFileId(std::string_view fileId,
                                                     std::function<bool(const RecordRef&)> callback) const {
-    size_t offset = 0;
+    size_t offset = static_cast<size_t>(evictedEnd_);
+    uint64_t sequence = evictedSequence_ + 1;  // Walk visits every record in sequence order
     while (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
-        uint32_t fbSize = readLE32(&data_[offset]);
+        uint32_t fbSize = readLE32(recordAt(offset));
         if (offset + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
             break;
         }
 
-        const uint8_t* fbData = &data_[offset + SIZE_PREFIX_LENGTH];
+        const uint8_t* fbData = recordAt(offset) + SIZE_PREFIX_LENGTH;
 
         // Compare file ID without allocation (inline comparison)
         bool matches = false;
@@ -326,8 +1159,7 @@ void StreamingFlatBufferStore::iterateRefsByFileId(std::string_view fileId,
         if (matches) {
             RecordRef ref;
             ref.offset = offset;
-            auto it = offsetToSequence_.find(offset);
-            ref.sequence = (it != offsetToSequence_.end()) ? it->second : 0;
+            ref.sequence = sequence;
             ref.data = fbData;
             ref.length = fbSize;
 
@@ -336,21 +1168,22 @@ void StreamingFlatBufferStore::iterateRefsByFileId(std::string_view fileId,
             }
         }
 
-        offset += SIZE_PREFIX_LENGTH + fbSize;
+        offset = nextRecordOffset(offset, fbSize);
+        sequence++;
     }
 }
 
 bool StreamingFlatBufferStore::getFirstRecord(std::string_view fileId,
                                                uint64_t* outOffset, uint64_t* outSequence,
                                                const uint8_t** outData, uint32_t* outLength) const {
-    size_t offset = 0;
+    size_t offset = static_cast<size_t>(evictedEnd_);
     while (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
-        uint32_t fbSize = readLE32(&data_[offset]);
+        uint32_t fbSize = readLE32(recordAt(offset));
         if (offset + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
             break;
         }
 
-        const uint8_t* fbData = &data_[offset + SIZE_PREFIX_LENGTH];
+        const uint8_t* fbData = recordAt(offset) + SIZE_PREFIX_LENGTH;
 
         // Compare file ID inline without allocation
         if (fbSize >= 8) {
@@ -358,15 +1191,14 @@ bool StreamingFlatBufferStore::getFirstRecord(std::string_view fileId,
                                           FILE_IDENTIFIER_LENGTH);
             if (recordFileId == fileId) {
                 *outOffset = offset;
-                auto it = offsetToSequence_.find(offset);
-                *outSequence = (it != offsetToSequence_.end()) ? it->second : 0;
+                *outSequence = getSequenceForOffset(offset);
                 *outData = fbData;
                 *outLength = fbSize;
                 return true;
             }
         }
 
-        offset += SIZE_PREFIX_LENGTH + fbSize;
+        offset = nextRecordOffset(offset, fbSize);
     }
     return false;
 }
@@ -377,20 +1209,22 @@ bool StreamingFlatBufferStore::getNextRecord(uint64_t afterOffset, std::string_v
     // Start after the given offset
     size_t offset = static_cast<size_t>(afterOffset);
 
-    // Skip current record
-    if (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
-        uint32_t currentSize = readLE32(&data_[offset]);
-        offset += SIZE_PREFIX_LENGTH + currentSize;
+    // Skip current record (unless it was evicted: then the first kept one is next)
+    if (offset < evictedEnd_) {
+        offset = static_cast<size_t>(evictedEnd_);
+    } else if (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
+        uint32_t currentSize = readLE32(recordAt(offset));
+        offset = nextRecordOffset(offset, currentSize);
     }
 
     // Find next record with matching file ID
     while (offset + SIZE_PREFIX_LENGTH <= writeOffset_) {
-        uint32_t fbSize = readLE32(&data_[offset]);
+        uint32_t fbSize = readLE32(recordAt(offset));
         if (offset + SIZE_PREFIX_LENGTH + fbSize > writeOffset_) {
             break;
         }
 
-        const uint8_t* fbData = &data_[offset + SIZE_PREFIX_LENGTH];
+        const uint8_t* fbData = recordAt(offset) + SIZE_PREFIX_LENGTH;
 
         // Compare file ID inline without allocation
         if (fbSize >= 8) {
@@ -398,63 +1232,93 @@ bool StreamingFlatBufferStore::getNextRecord(uint64_t afterOffset, std::string_v
                                           FILE_IDENTIFIER_LENGTH);
             if (recordFileId == fileId) {
                 *outOffset = offset;
-                auto it = offsetToSequence_.find(offset);
-                *outSequence = (it != offsetToSequence_.end()) ? it->second : 0;
+                *outSequence = getSequenceForOffset(offset);
                 *outData = fbData;
                 *outLength = fbSize;
                 return true;
             }
         }
 
-        offset += SIZE_PREFIX_LENGTH + fbSize;
+        offset = nextRecordOffset(offset, fbSize);
     }
     return false;
 }
 
-void StreamingFlatBufferStore::indexRecord(const std::string& fileId, uint64_t offset) {
-    auto it = offsetToSequence_.find(offset);
-    uint64_t seq = (it != offsetToSequence_.end()) ? it->second : 0;
-    fileIdToRecords_[fileId].push_back({offset, seq});
+std::string_view StreamingFlatBufferStore::indexRecord(const uint8_t* flatbuffer, size_t length,
+                                                       uint64_t offset, uint64_t sequence) {
+    std::string_view fileId = fileIdView(flatbuffer, length);
+    uint32_t key = packFileId(fileId);
+    RecordInfoList* list = nullptr;
+    if (key != 0) {
+        for (const auto& [routeKey, routeList] : fileIdRoutes_) {
+            if (routeKey == key) {
+                list = routeList;
+                break;
+            }
+        }
+        if (!list) {
+            list = &recordListFor(fileId);
+            fileIdRoutes_.emplace_back(key, list);
+        }
+    } else {
+        // Too small for an identifier, or an all-zero one
+        list = &recordListFor(fileId);
+    }
+    list->push_back({offset, sequence});
+    return fileId;
+}
+
+StreamingFlatBufferStore::RecordInfoList& StreamingFlatBufferStore::recordListFor(std::string_view fileId) {
+    // Only the writer inserts, so its own lookup needs no lock
+    std::string key(fileId);
+    auto it = fileIdToRecords_.find(key);
+    if (it == fileIdToRecords_.end()) {
+        std::unique_lock<std::shared_mutex> lock(fileIdMutex_);
+        it = fileIdToRecords_.try_emplace(std::move(key)).first;
+    }
+    return it->second;
 }
 
 bool StreamingFlatBufferStore::getRecordByFileIndex(std::string_view fileId, size_t index,
                                                      uint64_t* outOffset, uint64_t* outSequence,
                                                      const uint8_t** outData, uint32_t* outLength) const {
     // Look up file ID index
-    auto it = fileIdToRecords_.find(std::string(fileId));
-    if (it == fileIdToRecords_.end() || index >= it->second.size()) {
+    const RecordInfoList* infos = getRecordInfoVector(fileId);
+    if (!infos || index >= infos->size()) {
         return false;
     }
 
-    const FileRecordInfo& info = it->second[index];
+    const FileRecordInfo& info = (*infos)[index];
+    if (info.sequence <= evictedSequence_) {
+        return false;
+    }
 
     // Inline data access to avoid function call overhead
     size_t off = static_cast<size_t>(info.offset);
     if (off + SIZE_PREFIX_LENGTH > writeOffset_) {
         return false;
     }
-    uint32_t fbSize = static_cast<uint32_t>(data_[off]) |
-                      (static_cast<uint32_t>(data_[off + 1]) << 8) |
-                      (static_cast<uint32_t>(data_[off + 2]) << 16) |
-                      (static_cast<uint32_t>(data_[off + 3]) << 24);
+    const uint8_t* record = recordAt(off);
+    uint32_t fbSize = static_cast<uint32_t>(record[0]) |
+                      (static_cast<uint32_t>(record[1]) << 8) |
+                      (static_cast<uint32_t>(record[2]) << 16) |
+                      (static_cast<uint32_t>(record[3]) << 24);
 
     *outOffset = info.offset;
     *outSequence = info.sequence;
-    *outData = &data_[off + SIZE_PREFIX_LENGTH];
+    *outData = record + SIZE_PREFIX_LENGTH;
     *outLength = fbSize;
     return true;
 }
 
 size_t StreamingFlatBufferStore::getRecordCountByFileId(std::string_view fileId) const {
-    auto it = fileIdToRecords_.find(std::string(fileId));
-    if (it == fileIdToRecords_.end()) {
-        return 0;
-    }
-    return it->second.size();
+    const RecordInfoList* infos = getRecordInfoVector(fileId);
+    return infos ? infos->size() : 0;
 }
 
-const std::vector<StreamingFlatBufferStore::FileRecordInfo>*
+const StreamingFlatBufferStore::RecordInfoList*
 StreamingFlatBufferStore::getRecordInfoVector(std::string_view fileId) const {
+    std::shared_lock<std::shared_mutex> lock(fileIdMutex_);
     auto it = fileIdToRecords_.find(std::string(fileId));
     if (it == fileIdToRecords_.end()) {
         return nullptr;
@@ -0,0 +1,128 @@
+#include "flatsql/stream_ingestor.h"
+#include "flatsql/database.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace flatsql {
+
+namespace {
+
+size_t prefixedSize(const uint8_t* p) {
+    return SIZE_PREFIX_LENGTH + (static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                                 (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24));
+}
+
+}  // namespace
+
+StreamIngestor::StreamIngestor(FlatSQLDatabase& db, size_t capacity, const std::string& source)
+    : db_(db), source_(source),
+      buffer_(std::max(capacity, SIZE_PREFIX_LENGTH)),
+      baseCapacity_(buffer_.size()) {}
+
+size_t StreamIngestor::frameBytes() const {
+    return pending() >= SIZE_PREFIX_LENGTH ? prefixedSize(buffer_.data() + begin_) : 0;
+}
+
+void StreamIngestor::checkFrame(const uint8_t* prefix, size_t available) const {
+    if (available < SIZE_PREFIX_LENGTH) return;
+    size_t size = prefixedSize(prefix) - SIZE_PREFIX_LENGTH;
+    if (size > maxFrameSize_) {
+        throw std::runtime_error("Frame of " + std::to_string(size) + " bytes exceeds maxFrameSize (" +
+                                 std::to_string(maxFrameSize_) + ")");
+    }
+}
+
+size_t StreamIngestor::growthNeeded() const {
+    size_t needed = std::max(frameBytes(), pending() + 1);
+    return needed > buffer_.size() ? needed - buffer_.size() : 0;
+}
+
+uint8_t* StreamIngestor::reserve(size_t minBytes, size_t* writable) {
+    checkFrame(buffer_.data() + begin_, pending());
+    size_t held = pending();
+    if (held == 0) {
+        begin_ = end_ = 0;
+    }
+
+    // Bytes from begin_ that must fit: the whole frame, and the request
+    size_t needed = std::max(frameBytes(), held + std::max<size_t>(minBytes, 1));
+    if (begin_ + needed > buffer_.size()) {
+        if (needed > buffer_.size()) {
+            std::vector<uint8_t> grown(needed);
+            std::memcpy(grown.data(), buffer_.data() + begin_, held);
+            buffer_.swap(grown);
+        } else {
+            std::memmove(buffer_.data(), buffer_.data() + begin_, held);
+        }
+        begin_ = 0;
+        end_ = held;
+    }
+
+    if (writable) *writable = buffer_.size() - end_;
+    return buffer_.data() + end_;
+}
+
+size_t StreamIngestor::commit(size_t bytes) {
+    if (bytes > buffer_.size() - end_) {
+        throw std::runtime_error("StreamIngestor::commit past the reserved region");
+    }
+    end_ += bytes;
+    size_t records = 0;
+    begin_ += ingestSpan(buffer_.data() + begin_, pending(), &records);
+    if (begin_ == end_) {
+        begin_ = end_ = 0;
+    }
+    checkFrame(buffer_.data() + begin_, pending());
+    return records;
+}
+
+size_t StreamIngestor::write(const uint8_t* data, size_t length) {
+    size_t records = 0;
+
+    // Complete the held frame first, copying only its missing bytes
+    while (length > 0 && pending() > 0) {
+        size_t frame = frameBytes();
+        size_t take = std::min(length, frame ? frame - pending() : SIZE_PREFIX_LENGTH - pending());
+        uint8_t* dest = reserve(take, nullptr);
+        std::memcpy(dest, data, take);
+        records += commit(take);
+        data += take;
+        length -= take;
+    }
+    if (length == 0) return records;
+
+    // Nothing held: ingest straight from the chunk and keep its tail
+    size_t chunkRecords = 0;
+    size_t consumed = length >= SIZE_PREFIX_LENGTH ? ingestSpan(data, length, &chunkRecords) : 0;
+    records += chunkRecords;
+    data += consumed;
+    length -= consumed;
+    if (length > 0) {
+        checkFrame(data, length);
+        size_t room = length >= SIZE_PREFIX_LENGTH ? std::max(length, prefixedSize(data)) : length;
+        uint8_t* dest = reserve(room, nullptr);
+        std::memcpy(dest, data, length);
+        end_ += length;
+    }
+    return records;
+}
+
+void StreamIngestor::shrink() {
+    size_t held = pending();
+    if (buffer_.size() <= baseCapacity_ || held > baseCapacity_ || frameBytes() > baseCapacity_) return;
+    std::vector<uint8_t> shrunk(baseCapacity_);
+    std::memcpy(shrunk.data(), buffer_.data() + begin_, held);
+    buffer_.swap(shrunk);
+    begin_ = 0;
+    end_ = held;
+}
+
+size_t StreamIngestor::ingestSpan(const uint8_t* data, size_t length, size_t* records) {
+    size_t consumed = source_.empty() ? db_.ingest(data, length, records)
+                                      : db_.ingestWithSource(data, length, source_, records);
+    recordsIngested_ += *records;
+    return consumed;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,158 @@
+#include "flatsql/subscription.h"
+#include "flatsql/aggregate.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+namespace flatsql {
+
+Value subscriptionKey(const Value& value) {
+    Value key = toSqlValue(value);
+    if (const double* d = std::get_if<double>(&key)) {
+        if (std::trunc(*d) == *d && *d >= -9.2e18 && *d <= 9.2e18) {
+            return static_cast<int64_t>(*d);
+        }
+    }
+    return key;
+}
+
+size_t SubscriptionKeyHash::operator()(const Value& key) const {
+    return std::visit([](const auto& v) -> size_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            return 0;
+        } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            return std::hash<std::string_view>()(
+                std::string_view(reinterpret_cast<const char*>(v.data()), v.size()));
+        } else {
+            return std::hash<T>()(v);
+        }
+    }, key);
+}
+
+void SubscriptionSet::add(uint64_t id, const TableDef& table, const std::vector<SubscriptionFilter>& filters,
+                          SubscriptionCallback callback) {
+    auto subscription = std::make_unique<Subscription>();
+    subscription->id = id;
+    subscription->callback = std::move(callback);
+    for (const SubscriptionFilter& filter : filters) {
+        int column = table.getColumnIndex(filter.column);
+        if (column < 0) {
+            throw std::runtime_error("Unknown column in subscription: " + table.name + "." + filter.column);
+        }
+        subscription->filters.push_back({column, filter.op, subscriptionKey(filter.value)});
+    }
+
+    if (columnNames_.empty()) {
+        for (const ColumnDef& column : table.columns) columnNames_.push_back(column.name);
+        recordKeys_.resize(columnNames_.size());
+        recordKeyStamp_.assign(columnNames_.size(), 0);
+    }
+
+    // File under the first equality with a value (= NULL never matches)
+    for (size_t f = 0; f < subscription->filters.size(); f++) {
+        const Filter& filter = subscription->filters[f];
+        if (filter.op != SubscriptionFilter::Op::Eq) continue;
+        subscription->probe = static_cast<int>(f);
+        auto probe = std::find_if(probes_.begin(), probes_.end(),
+                                  [&](const Probe& p) { return p.column == filter.column; });
+        if (probe == probes_.end()) {
+            probes_.push_back({filter.column, {}});
+            probe = probes_.end() - 1;
+        }
+        probe->byKey[filter.key].push_back(subscription.get());
+        break;
+    }
+    if (subscription->probe < 0) {
+        scanned_.push_back(subscription.get());
+    }
+    subscriptions_[id] = std::move(subscription);
+}
+
+bool SubscriptionSet::remove(uint64_t id) {
+    auto it = subscriptions_.find(id);
+    if (it == subscriptions_.end()) return false;
+    Subscription* subscription = it->second.get();
+
+    if (subscription->probe >= 0) {
+        const Filter& filter = subscription->filters[subscription->probe];
+        for (size_t p = 0; p < probes_.size(); p++) {
+            if (probes_[p].column != filter.column) continue;
+            auto bucket = probes_[p].byKey.find(filter.key);
+            auto& list = bucket->second;
+            list.erase(std::find(list.begin(), list.end(), subscription));
+            if (list.empty()) probes_[p].byKey.erase(bucket);
+            if (probes_[p].byKey.empty()) probes_.erase(probes_.begin() + p);
+            break;
+        }
+    } else {
+        scanned_.erase(std::find(scanned_.begin(), scanned_.end(), subscription));
+    }
+    subscriptions_.erase(it);
+    return true;
+}
+
+const SubscriptionCallback* SubscriptionSet::callback(uint64_t id) const {
+    auto it = subscriptions_.find(id);
+    return it != subscriptions_.end() ? &it->second->callback : nullptr;
+}
+
+const Value& SubscriptionSet::columnKey(int column, const uint8_t* data, size_t length,
+                                        const FieldExtractor& extractor) {
+    if (recordKeyStamp_[column] != recordStamp_) {
+        recordKeys_[column] = subscriptionKey(extractor(data, length, columnNames_[column]));
+        recordKeyStamp_[column] = recordStamp_;
+    }
+    return recordKeys_[column];
+}
+
+bool SubscriptionSet::matchesFilters(const Subscription& subscription, const uint8_t* data, size_t length,
+                                     const FieldExtractor& extractor) {
+    for (size_t f = 0; f < subscription.filters.size(); f++) {
+        if (static_cast<int>(f) == subscription.probe) continue;  // Matched by the lookup
+        const Filter& filter = subscription.filters[f];
+        const Value& key = columnKey(filter.column, data, length, extractor);
+        if (std::holds_alternative<std::monostate>(key) ||
+            std::holds_alternative<std::monostate>(filter.key)) {
+            return false;
+        }
+        int cmp = compareValues(key, filter.key);
+        bool pass = false;
+        switch (filter.op) {
+            case SubscriptionFilter::Op::Eq: pass = cmp == 0; break;
+            case SubscriptionFilter::Op::Ne: pass = cmp != 0; break;
+            case SubscriptionFilter::Op::Lt: pass = cmp < 0; break;
+            case SubscriptionFilter::Op::Le: pass = cmp <= 0; break;
+            case SubscriptionFilter::Op::Gt: pass = cmp > 0; break;
+            case SubscriptionFilter::Op::Ge: pass = cmp >= 0; break;
+        }
+        if (!pass) return false;
+    }
+    return true;
+}
+
+void SubscriptionSet::match(const uint8_t* data, size_t length, const FieldExtractor& extractor,
+                            Matches& out) {
+    if (subscriptions_.empty() || !extractor) return;
+    recordStamp_++;
+
+    for (const Probe& probe : probes_) {
+        const Value& key = columnKey(probe.column, data, length, extractor);
+        if (std::holds_alternative<std::monostate>(key)) continue;
+        auto bucket = probe.byKey.find(key);
+        if (bucket == probe.byKey.end()) continue;
+        for (const Subscription* subscription : bucket->second) {
+            if (matchesFilters(*subscription, data, length, extractor)) {
+                out.push_back(subscription->id);
+            }
+        }
+    }
+    for (const Subscription* subscription : scanned_) {
+        if (matchesFilters(*subscription, data, length, extractor)) {
+            out.push_back(subscription->id);
+        }
+    }
+}
+
+}  // namespace flatsql
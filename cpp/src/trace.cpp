@@ -0,0 +1,151 @@
+#include "flatsql/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flatsql {
+
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Written by its thread only; written counts every event ever appended
+struct TraceRing {
+    explicit TraceRing(uint32_t thread) : thread(thread), events(new TraceEvent[TRACE_RING_EVENTS]) {}
+
+    uint32_t thread;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> cleared{0};  // Events before this one were dropped
+
+    // First event still held (older ones are overwritten or cleared)
+    uint64_t first(uint64_t end) const {
+        uint64_t kept = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+        return std::max(kept, cleared.load(std::memory_order_relaxed));
+    }
+};
+
+// Rings outlive their threads, so events of finished threads still export.
+// Leaked: threads may still trace while static destructors run.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+thread_local TraceRing* t_ring = nullptr;
+
+TraceRing& threadRing() {
+    if (!t_ring) {
+        TraceRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(std::make_unique<TraceRing>(static_cast<uint32_t>(reg.rings.size() + 1)));
+        t_ring = reg.rings.back().get();
+    }
+    return *t_ring;
+}
+
+void appendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* p = text; *p; p++) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+}  // namespace
+
+uint64_t traceNow() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+void traceRecord(const char* name, uint64_t start, uint64_t duration) {
+    TraceRing& ring = threadRing();
+    uint64_t n = ring.written.load(std::memory_order_relaxed);
+    ring.events[n & (TRACE_RING_EVENTS - 1)] = {name, start, duration};
+    ring.written.store(n + 1, std::memory_order_release);
+}
+
+size_t traceEventCount() {
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    size_t count = 0;
+    for (const auto& ring : reg.rings) {
+        uint64_t end = ring->written.load(std::memory_order_acquire);
+        count += static_cast<size_t>(end - std::min(end, ring->first(end)));
+    }
+    return count;
+}
+
+void traceClear() {
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& ring : reg.rings) {
+        ring->cleared.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+std::string traceExportChromeJson() {
+    std::vector<TraceEvent> events;
+    std::string json = "{\"traceEvents\":[";
+    bool firstEvent = true;
+
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& ring : reg.rings) {
+        uint64_t end = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = std::min(end, ring->first(end));
+        events.clear();
+        for (uint64_t i = begin; i < end; i++) {
+            events.push_back(ring->events[i & (TRACE_RING_EVENTS - 1)]);
+        }
+
+        // Drop events the thread overwrote while they were copied, and the
+        // slot it may be writing now (event after, which reuses after - RING)
+        uint64_t after = ring->written.load(std::memory_order_acquire);
+        uint64_t valid = after >= TRACE_RING_EVENTS ? after + 1 - TRACE_RING_EVENTS : 0;
+        size_t skip = valid > begin ? static_cast<size_t>(std::min(valid - begin, end - begin)) : 0;
+
+        for (size_t i = skip; i < events.size(); i++) {
+            const TraceEvent& event = events[i];
+            char fields[160];
+            std::snprintf(fields, sizeof(fields),
+                          ",\"cat\":\"flatsql\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                          event.start / 1000.0, event.duration / 1000.0, ring->thread);
+            json += firstEvent ? "\n{\"name\":" : ",\n{\"name\":";
+            appendJsonString(json, event.name);
+            json += fields;
+            firstEvent = false;
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return json;
+}
+
+}  // namespace flatsql
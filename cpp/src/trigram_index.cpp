@@ -0,0 +1,279 @@
+#include "flatsql/trigram_index.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+// Levenshtein distance kernel of the vendored sqlean fuzzy extension
+extern "C" unsigned levenshtein(const char* str1, const char* str2);
+
+namespace flatsql {
+
+// NUL bytes on each side of the text, so its ends get trigrams of their own
+static constexpr size_t TRIGRAM_PADDING = 2;
+
+// Trigrams one edit can change
+static constexpr int64_t TRIGRAMS_PER_EDIT = 3;
+
+// Trigrams a row within maxDistance of a target of length bytes must share
+static int64_t sharedTrigrams(size_t length, uint32_t maxDistance) {
+    return static_cast<int64_t>(length + TRIGRAM_PADDING) - TRIGRAMS_PER_EDIT * maxDistance;
+}
+
+static bool withinLength(size_t a, size_t b, uint32_t maxDistance) {
+    return (a > b ? a - b : b - a) <= maxDistance;
+}
+
+TrigramIndex::TrigramIndex(const std::string& tableName, const std::string& columnName,
+                           std::unique_ptr<Index> exact)
+    : Index(tableName, columnName, ValueType::String), exact_(std::move(exact)) {}
+
+std::vector<std::pair<uint32_t, uint32_t>> TrigramIndex::trigrams(std::string_view text) {
+    std::string padded(TRIGRAM_PADDING, '\0');
+    padded.append(text);
+    padded.append(TRIGRAM_PADDING, '\0');
+
+    std::vector<uint32_t> grams;
+    grams.reserve(padded.size() - 2);
+    for (size_t i = 0; i + 2 < padded.size(); i++) {
+        grams.push_back((static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16) |
+                        (static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8) |
+                        static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 2])));
+    }
+    std::sort(grams.begin(), grams.end());
+
+    std::vector<std::pair<uint32_t, uint32_t>> counted;
+    for (uint32_t gram : grams) {
+        if (!counted.empty() && counted.back().first == gram) {
+            counted.back().second++;
+        } else {
+            counted.push_back({gram, 1});
+        }
+    }
+    return counted;
+}
+
+void TrigramIndex::addText(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    const auto* text = std::get_if<std::string>(&key);
+    if (!text) return;
+    uint32_t row = static_cast<uint32_t>(rows_.size());
+    rows_.push_back({dataOffset, sequence, dataLength, static_cast<uint32_t>(text->size())});
+    for (const auto& [gram, occurrences] : trigrams(*text)) {
+        postings_[gram].push_back({row, occurrences});
+    }
+    stats_.add(key);
+}
+
+void TrigramIndex::rebuild() {
+    postings_.clear();
+    rows_.clear();
+    stats_.clear();
+    for (const auto& entry : exact_->all()) {
+        addText(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+    }
+}
+
+void TrigramIndex::insert(const Value& key, uint64_t dataOffset, uint32_t dataLength, uint64_t sequence) {
+    exact_->insert(key, dataOffset, dataLength, sequence);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    addText(key, dataOffset, dataLength, sequence);
+}
+
+void TrigramIndex::insertBatch(std::vector<IndexEntry>& entries) {
+    // Before the wrapped index, which may move the keys out
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& entry : entries) {
+            addText(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+        }
+    }
+    exact_->insertBatch(entries);
+}
+
+void TrigramIndex::bulkLoad(const std::vector<IndexEntry>& sortedEntries) {
+    exact_->bulkLoad(sortedEntries);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& entry : sortedEntries) {
+        addText(entry.key, entry.dataOffset, entry.dataLength, entry.sequence);
+    }
+}
+
+std::vector<IndexEntry> TrigramIndex::search(const Value& key) const {
+    return exact_->search(key);
+}
+
+bool TrigramIndex::searchFirst(const Value& key, IndexEntry& result) const {
+    return exact_->searchFirst(key, result);
+}
+
+std::vector<IndexEntry> TrigramIndex::searchMany(std::vector<Value> keys) const {
+    return exact_->searchMany(std::move(keys));
+}
+
+bool TrigramIndex::searchFirstString(const std::string& key, uint64_t& outOffset,
+                                     uint32_t& outLength, uint64_t& outSequence) const {
+    return exact_->searchFirstString(key, outOffset, outLength, outSequence);
+}
+
+bool TrigramIndex::searchFirstInt64(int64_t key, uint64_t& outOffset,
+                                    uint32_t& outLength, uint64_t& outSequence) const {
+    return exact_->searchFirstInt64(key, outOffset, outLength, outSequence);
+}
+
+std::vector<IndexEntry> TrigramIndex::range(const Value& minKey, const Value& maxKey) const {
+    return exact_->range(minKey, maxKey);
+}
+
+std::vector<IndexEntry> TrigramIndex::all() const {
+    return exact_->all();
+}
+
+std::unique_ptr<IndexCursor> TrigramIndex::openRange(const Value& minKey, const Value& maxKey,
+                                                     bool reverse) const {
+    return exact_->openRange(minKey, maxKey, reverse);
+}
+
+void TrigramIndex::clear() {
+    exact_->clear();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    postings_.clear();
+    rows_.clear();
+    stats_.clear();
+}
+
+void TrigramIndex::eraseThrough(uint64_t sequence) {
+    exact_->eraseThrough(sequence);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    rebuild();
+}
+
+void TrigramIndex::saveTo(sqlite3* db, const std::string& schemaName) const {
+    exact_->saveTo(db, schemaName);
+}
+
+void TrigramIndex::loadFrom(sqlite3* db, const std::string& schemaName) {
+    exact_->loadFrom(db, schemaName);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    rebuild();
+}
+
+std::vector<IndexEntry> TrigramIndex::candidates(std::string_view target, uint32_t maxDistance) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<uint32_t> rows;
+    const int64_t needed = sharedTrigrams(target.size(), maxDistance);
+    if (needed <= 0) {
+        for (uint32_t row = 0; row < rows_.size(); row++) {
+            if (withinLength(rows_[row].textLength, target.size(), maxDistance)) rows.push_back(row);
+        }
+    } else {
+        // Shared trigrams per row, counted over the target's postings
+        std::vector<uint32_t> shared(rows_.size(), 0);
+        for (const auto& [gram, occurrences] : trigrams(target)) {
+            auto it = postings_.find(gram);
+            if (it == postings_.end()) continue;
+            for (const Posting& posting : it->second) {
+                uint32_t& count = shared[posting.row];
+                bool reached = count >= needed;
+                count += std::min(occurrences, posting.occurrences);
+                if (!reached && count >= needed &&
+                    withinLength(rows_[posting.row].textLength, target.size(), maxDistance)) {
+                    rows.push_back(posting.row);
+                }
+            }
+        }
+    }
+
+    std::vector<IndexEntry> entries;
+    entries.reserve(rows.size());
+    for (uint32_t row : rows) {
+        const Row& r = rows_[row];
+        IndexEntry entry;
+        entry.dataOffset = r.offset;
+        entry.dataLength = r.length;
+        entry.sequence = r.sequence;
+        entries.push_back(std::move(entry));
+    }
+    std::sort(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.sequence < b.sequence;
+    });
+    return entries;
+}
+
+size_t TrigramIndex::estimateCandidates(std::string_view target, uint32_t maxDistance) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const int64_t needed = sharedTrigrams(target.size(), maxDistance);
+    if (needed <= 0) return rows_.size();
+
+    // A candidate misses at most (grams - needed) of the target's trigram
+    // occurrences, so it holds one of the rarest (grams - needed + 1)
+    std::vector<size_t> lengths;
+    int64_t grams = 0;
+    for (const auto& [gram, occurrences] : trigrams(target)) {
+        auto it = postings_.find(gram);
+        size_t length = it == postings_.end() ? 0 : it->second.size();
+        lengths.insert(lengths.end(), occurrences, length);
+        grams += occurrences;
+    }
+    std::sort(lengths.begin(), lengths.end());
+    size_t bound = 0;
+    for (int64_t i = 0; i < grams - needed + 1 && i < static_cast<int64_t>(lengths.size()); i++) {
+        bound += lengths[i];
+    }
+    return std::min(bound, rows_.size());
+}
+
+size_t TrigramIndex::getTrigramCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return postings_.size();
+}
+
+size_t TrigramIndex::memoryBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = rows_.capacity() * sizeof(Row) + postings_.bucket_count() * sizeof(void*);
+    for (const auto& [gram, list] : postings_) {
+        bytes += sizeof(gram) + 3 * sizeof(void*) + list.capacity() * sizeof(Posting);
+    }
+    return bytes + exact_->memoryBytes();
+}
+
+void TrigramIndex::parsePattern(std::string_view pattern, std::string_view& target, uint32_t& maxDistance) {
+    target = pattern;
+    maxDistance = DEFAULT_DISTANCE;
+    size_t tilde = pattern.rfind('~');
+    if (tilde == std::string_view::npos || tilde + 1 == pattern.size()) return;
+
+    uint32_t distance = 0;
+    for (size_t i = tilde + 1; i < pattern.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(pattern[i]);
+        if (!std::isdigit(c) || distance > 1000) return;  // Not a ~k suffix: part of the target
+        distance = distance * 10 + (c - '0');
+    }
+    target = pattern.substr(0, tilde);
+    maxDistance = distance;
+}
+
+bool TrigramIndex::within(std::string_view text, std::string_view pattern) {
+    std::string_view target;
+    uint32_t maxDistance = 0;
+    parsePattern(pattern, target, maxDistance);
+    if (!withinLength(text.size(), target.size(), maxDistance)) return false;
+    return levenshtein(std::string(text).c_str(), std::string(target).c_str()) <= maxDistance;
+}
+
+void fuzzyWithinFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    if (argc != 2 || sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    auto text = [](sqlite3_value* value) {
+        const char* data = reinterpret_cast<const char*>(sqlite3_value_text(value));
+        return std::string_view(data ? data : "", static_cast<size_t>(sqlite3_value_bytes(value)));
+    };
+    sqlite3_result_int(ctx, TrigramIndex::within(text(argv[0]), text(argv[1])) ? 1 : 0);
+}
+
+void registerTrigramFunctions(sqlite3* db) {
+    int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    sqlite3_create_function(db, "fuzzy_within", 2, flags, nullptr, fuzzyWithinFunction, nullptr, nullptr);
+}
+
+}  // namespace flatsql
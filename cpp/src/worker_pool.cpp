@@ -0,0 +1,114 @@
+#include "flatsql/worker_pool.h"
+#include <algorithm>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define FLATSQL_NO_THREADS 1
+#endif
+
+namespace flatsql {
+
+WorkerPool::WorkerPool(size_t threads) {
+#ifndef FLATSQL_NO_THREADS
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; i++) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+#else
+    (void)threads;
+#endif
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn,
+                             size_t minGrain) {
+    if (count == 0) return;
+    minGrain = std::max<size_t>(1, minGrain);
+    if (workers_.empty() || count < 2 * minGrain) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        // A few ranges per thread so uneven records still balance out
+        grain_ = std::max(minGrain, (count + size() * 4 - 1) / (size() * 4));
+        next_ = 0;
+        error_ = nullptr;
+        generation_++;
+    }
+    wake_.notify_all();
+
+    runRanges();
+
+    std::exception_ptr error;
+    {
+        // Every range is claimed once runRanges() returns; wait for the
+        // workers still running theirs
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return active_ == 0; });
+        fn_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::runRanges() {
+    for (;;) {
+        size_t begin, end;
+        const std::function<void(size_t, size_t)>* fn;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (next_ >= count_) return;
+            begin = next_;
+            end = std::min(count_, begin + grain_);
+            next_ = end;
+            fn = fn_;
+        }
+        try {
+            (*fn)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+            next_ = count_;  // Stop handing out ranges
+        }
+    }
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this, seen]() { return stopping_ || generation_ != seen; });
+        if (stopping_) return;
+        seen = generation_;
+        if (!fn_ || next_ >= count_) continue;  // Woke after the loop finished
+
+        active_++;
+        lock.unlock();
+        runRanges();
+        lock.lock();
+        if (--active_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
+
+}  // namespace flatsql
@@ -0,0 +1,123 @@
+#include "flatsql/zone_map.h"
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+namespace flatsql {
+
+ZoneMap::ZoneMap(ValueType type)
+    : real_(type == ValueType::Float32 || type == ValueType::Float64) {
+    if (!ColumnCache::supports(type)) {
+        throw std::runtime_error("Zone maps only support numeric columns");
+    }
+}
+
+void ZoneMap::append(const Value& value) {
+    // Same conversions as ColumnCache::append
+    bool present = false;
+    int64_t i = 0;
+    double d = 0.0;
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            d = static_cast<double>(v);
+            i = std::isfinite(d) && std::fabs(d) < 9.2e18 ? static_cast<int64_t>(d) : 0;
+            present = !real_ || !std::isnan(d);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            i = static_cast<int64_t>(v);
+            d = static_cast<double>(v);
+            present = true;
+        }
+    }, value);
+
+    if (present) {
+        if (!open_.any) {
+            open_.any = true;
+            open_.intMin = open_.intMax = i;
+            open_.realMin = open_.realMax = d;
+        } else if (real_) {
+            open_.realMin = std::min(open_.realMin, d);
+            open_.realMax = std::max(open_.realMax, d);
+        } else {
+            open_.intMin = std::min(open_.intMin, i);
+            open_.intMax = std::max(open_.intMax, i);
+        }
+    }
+
+    if (++rows_ % ZONE_ROWS == 0) {
+        zones_.push_back(open_);
+        open_ = Zone();
+    }
+}
+
+template <typename T>
+static bool boundsMayMatch(T min, T max, ColumnCache::CompareOp op, T operand) {
+    switch (op) {
+        case ColumnCache::CompareOp::Eq: return min <= operand && operand <= max;
+        case ColumnCache::CompareOp::Lt: return min < operand;
+        case ColumnCache::CompareOp::Le: return min <= operand;
+        case ColumnCache::CompareOp::Gt: return max > operand;
+        case ColumnCache::CompareOp::Ge: return max >= operand;
+    }
+    return true;
+}
+
+bool ZoneMap::mayMatch(size_t zone, const ColumnCache::Comparison& cmp) const {
+    if (zone >= zones_.size()) return true;
+    const Zone& z = zones_[zone];
+    if (!z.any || cmp.matchesNone) return false;
+    return real_ ? boundsMayMatch(z.realMin, z.realMax, cmp.op, cmp.realOperand)
+                 : boundsMayMatch(z.intMin, z.intMax, cmp.op, cmp.intOperand);
+}
+
+uint64_t ZoneBloomFilter::hash(const void* data, size_t length) {
+    // FNV-1a, then a finalizer so both 32-bit halves are well mixed
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ bytes[i]) * 0x100000001b3ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Probe i of a hash: double hashing over the zone's bits
+static size_t bloomBit(uint64_t hash, int i) {
+    constexpr size_t bits = ZoneBloomFilter::ZONE_WORDS * 64;
+    uint32_t h1 = static_cast<uint32_t>(hash);
+    uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+    return (h1 + static_cast<size_t>(i) * h2) & (bits - 1);
+}
+
+void ZoneBloomFilter::append(const Value& value) {
+    if (const auto* text = std::get_if<std::string>(&value)) {
+        uint64_t h = hash(text->data(), text->size());
+        for (int i = 0; i < HASHES; i++) {
+            size_t bit = bloomBit(h, i);
+            open_[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+    }
+
+    if (++rows_ % ZoneMap::ZONE_ROWS == 0) {
+        for (size_t w = 0; w < ZONE_WORDS; w++) {
+            words_.push_back(open_[w]);
+            open_[w] = 0;
+        }
+    }
+}
+
+bool ZoneBloomFilter::mayContain(size_t zone, uint64_t hash) const {
+    if (zone >= zones()) return true;
+    size_t base = zone * ZONE_WORDS;
+    for (int i = 0; i < HASHES; i++) {
+        size_t bit = bloomBit(hash, i);
+        if (!((words_[base + (bit >> 6)] >> (bit & 63)) & 1)) return false;
+    }
+    return true;
+}
+
+}  // namespace flatsql
@@ -0,0 +1,572 @@
+// Benchmark suite: parameterized FlatSQL scenarios with JSON output
+//
+// Like the MPE benchmark this does NOT run as part of CI. Every scenario
+// runs at each record count and thread count given, and results can be
+// written as JSON and compared with a baseline from an earlier run, so
+// regressions between releases show up as a failing exit code.
+//
+// Usage:
+//   ./flatsql_bench [--records=10000,100000] [--threads=1,4] [--iterations=2000]
+//                   [--scenarios=ingest,point_lookup,...] [--json=out.json]
+//                   [--baseline=base.json] [--tolerance=0.15]
+//
+// Scenarios: ingest, point_lookup, range, full_scan, aggregate,
+// unified_view, encrypted and join. Threads are ingest threads for ingest,
+// scan threads for aggregate, and concurrent read sessions for the
+// queries. A result regresses when its throughput falls, or its p99
+// latency rises, by more than the tolerance against the baseline result
+// with the same scenario, records and threads.
+//
+// Records are built by hand (no generated code) and read through the
+// schema-generated extractor, so the suite only needs the library.
+
+#include "flatsql/database.h"
+#include "flatsql/schema_parser.h"
+#include "flatbuffers/encryption.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace flatsql;
+using namespace std::chrono;
+
+static const char* SCHEMA = R"(
+    table readings {
+        id: int (id);
+        sensor: int (key);
+        value: double;
+        label: string;
+    }
+    table sensors {
+        id: int (id);
+        name: string;
+    }
+)";
+
+// Same table with its label encrypted
+static const char* SECURE_SCHEMA = R"(
+    table readings {
+        id: int (id);
+        sensor: int (key);
+        value: double;
+        label: string (encrypted);
+    }
+)";
+
+static constexpr int32_t SENSORS = 100;
+static constexpr int32_t RANGE_WIDTH = 100;
+
+struct Options {
+    std::vector<size_t> records = {10000, 100000};
+    std::vector<size_t> threads = {1, 4};
+    size_t iterations = 2000;
+    std::vector<std::string> scenarios = {"ingest", "point_lookup", "range", "full_scan",
+                                          "aggregate", "unified_view", "encrypted", "join"};
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 0.15;
+};
+
+struct Result {
+    std::string scenario;
+    size_t records = 0;
+    size_t threads = 0;
+    size_t operations = 0;
+    size_t rows = 0;          // Rows returned (records for ingest), as a sanity check
+    double totalMs = 0;
+    double opsPerSec = 0;
+    double meanUs = 0;
+    double p50Us = 0;
+    double p99Us = 0;
+};
+
+// Size-prefixed readings (or sensors) record: vtable, then a table of
+// id, sensor, label offset and value, then the label string
+static void appendRecord(std::vector<uint8_t>& stream, const char fileId[4], int32_t id, int32_t sensor,
+                         double value, const std::string& label) {
+    std::vector<uint8_t> buf(48, 0);
+    auto put = [&buf](size_t at, const void* p, size_t n) {
+        if (buf.size() < at + n) buf.resize(at + n, 0);
+        std::memcpy(buf.data() + at, p, n);
+    };
+    auto put16 = [&put](size_t at, uint16_t v) { put(at, &v, 2); };
+    auto put32 = [&put](size_t at, uint32_t v) { put(at, &v, 4); };
+
+    const size_t vtable = 8, table = 24;
+    bool sensorTable = std::memcmp(fileId, "SENS", 4) == 0;
+    put32(0, table);
+    put(4, fileId, 4);
+    if (sensorTable) {
+        put16(vtable, 8);         // id, name
+        put16(vtable + 2, 16);
+        put16(vtable + 4, 4);
+        put16(vtable + 6, 12);
+    } else {
+        put16(vtable, 12);        // id, sensor, value, label
+        put16(vtable + 2, 24);
+        put16(vtable + 4, 4);
+        put16(vtable + 6, 8);
+        put16(vtable + 8, 16);
+        put16(vtable + 10, 12);
+        put(table + 8, &sensor, 4);
+        put(table + 16, &value, 8);
+    }
+    int32_t soffset = int32_t(table - vtable);
+    put(table, &soffset, 4);
+    put(table + 4, &id, 4);
+    put32(table + 12, uint32_t(48 - (table + 12)));
+    put32(48, uint32_t(label.size()));
+    put(52, label.data(), label.size());
+    buf.resize((52 + label.size() + 1 + 3) & ~size_t(3), 0);
+
+    uint32_t size = static_cast<uint32_t>(buf.size());
+    const uint8_t* prefix = reinterpret_cast<const uint8_t*>(&size);
+    stream.insert(stream.end(), prefix, prefix + 4);
+    stream.insert(stream.end(), buf.begin(), buf.end());
+}
+
+static std::string labelOf(int32_t id) {
+    return "reading-" + std::to_string(id);
+}
+
+// Readings 1..count, optionally with their labels encrypted under ctx
+static std::vector<uint8_t> buildReadings(size_t count, int32_t firstId = 1,
+                                          const flatbuffers::EncryptionContext* ctx = nullptr,
+                                          uint16_t labelField = 0) {
+    std::vector<uint8_t> stream;
+    stream.reserve(count * 72);
+    for (size_t i = 0; i < count; i++) {
+        int32_t id = firstId + static_cast<int32_t>(i);
+        std::string label = labelOf(id);
+        if (ctx) {
+            flatbuffers::EncryptString(reinterpret_cast<uint8_t*>(label.data()), label.size(), *ctx, labelField);
+        }
+        appendRecord(stream, "READ", id, id % SENSORS, id * 0.25, label);
+    }
+    return stream;
+}
+
+static std::unique_ptr<FlatSQLDatabase> openDatabase(const char* schema, const char* name) {
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;  // Needed by read sessions
+    // fromSchema reads records through the schema-generated extractor
+    std::unique_ptr<FlatSQLDatabase> db(new FlatSQLDatabase(FlatSQLDatabase::fromSchema(schema, name, segmented)));
+    db->registerFileId("READ", "readings");
+    if (std::strstr(schema, "table sensors")) {
+        db->registerFileId("SENS", "sensors");
+    }
+    return db;
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t at = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(at, sorted.size() - 1)];
+}
+
+// Summarize per-operation latencies (microseconds) over wall time totalMs
+static Result summarize(const std::string& scenario, size_t records, size_t threads,
+                        std::vector<double> latencies, double totalMs) {
+    Result result;
+    result.scenario = scenario;
+    result.records = records;
+    result.threads = threads;
+    result.operations = latencies.size();
+    result.totalMs = totalMs;
+    result.opsPerSec = totalMs > 0 ? static_cast<double>(latencies.size()) * 1000.0 / totalMs : 0;
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double us : latencies) sum += us;
+    result.meanUs = latencies.empty() ? 0 : sum / static_cast<double>(latencies.size());
+    result.p50Us = percentile(latencies, 0.50);
+    result.p99Us = percentile(latencies, 0.99);
+    return result;
+}
+
+using Query = std::function<QueryResult(const std::string&, const std::vector<Value>&)>;
+
+// Run iterations queries from threads connections (the database itself
+// when there is one thread, else a read session each), timing each
+static Result runQueries(const std::string& scenario, size_t records, size_t threads, size_t iterations,
+                         FlatSQLDatabase& db,
+                         const std::function<size_t(const Query&, std::mt19937&)>& operation) {
+    std::vector<std::unique_ptr<ReadSession>> sessions;
+    std::vector<Query> connections;
+    if (threads <= 1) {
+        connections.push_back([&db](const std::string& sql, const std::vector<Value>& params) {
+            return db.query(sql, params);
+        });
+    } else {
+        for (size_t t = 0; t < threads; t++) {
+            sessions.push_back(db.openReadSession());
+            ReadSession* session = sessions.back().get();
+            connections.push_back([session](const std::string& sql, const std::vector<Value>& params) {
+                return session->query(sql, params);
+            });
+        }
+    }
+
+    // Warm statement caches and pages before timing
+    for (size_t t = 0; t < connections.size(); t++) {
+        std::mt19937 rng(static_cast<uint32_t>(1000 + t));
+        for (size_t i = 0; i < std::max<size_t>(iterations / 10, 1) / connections.size() + 1; i++) {
+            operation(connections[t], rng);
+        }
+    }
+
+    std::vector<std::vector<double>> perThread(connections.size());
+    std::vector<size_t> rows(connections.size(), 0);
+    auto work = [&](size_t t) {
+        std::mt19937 rng(static_cast<uint32_t>(42 + t));
+        size_t share = iterations / connections.size() + (t < iterations % connections.size() ? 1 : 0);
+        perThread[t].reserve(share);
+        for (size_t i = 0; i < share; i++) {
+            auto start = steady_clock::now();
+            rows[t] += operation(connections[t], rng);
+            perThread[t].push_back(duration<double, std::micro>(steady_clock::now() - start).count());
+        }
+    };
+
+    auto start = steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < connections.size(); t++) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (auto& worker : workers) worker.join();
+    double totalMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    std::vector<double> latencies;
+    for (const auto& local : perThread) {
+        latencies.insert(latencies.end(), local.begin(), local.end());
+    }
+    Result result = summarize(scenario, records, threads, std::move(latencies), totalMs);
+    for (size_t count : rows) result.rows += count;
+    return result;
+}
+
+static int32_t randomId(std::mt19937& rng, size_t records) {
+    return static_cast<int32_t>(rng() % records) + 1;
+}
+
+static Result benchIngest(size_t records, size_t threads) {
+    std::vector<uint8_t> stream = buildReadings(records);
+    auto db = openDatabase(SCHEMA, "bench_ingest");
+    db->setIngestThreads(threads);
+
+    // One operation per chunk of about 1000 records
+    std::vector<double> latencies;
+    const size_t chunkBytes = 1000 * 72;
+    auto start = steady_clock::now();
+    size_t offset = 0;
+    while (offset < stream.size()) {
+        auto chunkStart = steady_clock::now();
+        size_t consumed = db->ingest(stream.data() + offset,
+                                     std::min(chunkBytes, stream.size() - offset));
+        latencies.push_back(duration<double, std::micro>(steady_clock::now() - chunkStart).count());
+        if (consumed == 0) break;
+        offset += consumed;
+    }
+    double totalMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    Result result = summarize("ingest", records, threads, std::move(latencies), totalMs);
+    result.rows = static_cast<size_t>(std::get<int64_t>(db->query("SELECT COUNT(*) FROM readings").rows[0][0]));
+    result.opsPerSec = totalMs > 0 ? static_cast<double>(records) * 1000.0 / totalMs : 0;  // Records/s
+    return result;
+}
+
+static Result benchAggregate(FlatSQLDatabase& db, size_t records, size_t threads, size_t iterations) {
+    using Op = AggregateSpec::Op;
+    const std::vector<AggregateSpec> specs = {{Op::Count, ""}, {Op::Sum, "value"}, {Op::Max, "id"}};
+    db.setScanThreads(threads);
+    size_t runs = std::max<size_t>(iterations / 100, 5);
+    db.aggregate("readings", specs, "sensor");
+
+    std::vector<double> latencies;
+    size_t rows = 0;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        auto runStart = steady_clock::now();
+        rows += db.aggregate("readings", specs, "sensor").rowCount();
+        latencies.push_back(duration<double, std::micro>(steady_clock::now() - runStart).count());
+    }
+    double totalMs = duration<double, std::milli>(steady_clock::now() - start).count();
+    db.setScanThreads(1);
+    Result result = summarize("aggregate", records, threads, std::move(latencies), totalMs);
+    result.rows = rows;
+    return result;
+}
+
+static std::vector<Result> runScenarios(const Options& options, size_t records, size_t threads) {
+    auto wants = [&options](const char* name) {
+        return std::find(options.scenarios.begin(), options.scenarios.end(), name) != options.scenarios.end();
+    };
+    std::vector<Result> results;
+    size_t iterations = options.iterations;
+    // Scans touch every record, so run fewer of them
+    size_t scans = std::max<size_t>(iterations / 100, 5);
+
+    if (wants("ingest")) {
+        results.push_back(benchIngest(records, threads));
+    }
+
+    bool queries = wants("point_lookup") || wants("range") || wants("full_scan") ||
+                   wants("aggregate") || wants("join");
+    if (queries) {
+        auto db = openDatabase(SCHEMA, "bench_query");
+        std::vector<uint8_t> stream = buildReadings(records);
+        db->ingest(stream.data(), stream.size());
+        std::vector<uint8_t> sensors;
+        for (int32_t id = 0; id < SENSORS; id++) {
+            appendRecord(sensors, "SENS", id, 0, 0, "sensor-" + std::to_string(id));
+        }
+        db->ingest(sensors.data(), sensors.size());
+
+        if (wants("point_lookup")) {
+            results.push_back(runQueries("point_lookup", records, threads, iterations, *db,
+                [records](const Query& query, std::mt19937& rng) {
+                    return query("SELECT * FROM readings WHERE id = ?",
+                                 {Value(int64_t(randomId(rng, records)))}).rowCount();
+                }));
+        }
+        if (wants("range")) {
+            results.push_back(runQueries("range", records, threads, iterations, *db,
+                [records](const Query& query, std::mt19937& rng) {
+                    int64_t from = randomId(rng, records);
+                    return query("SELECT id, value FROM readings WHERE id BETWEEN ? AND ?",
+                          {Value(from), Value(from + RANGE_WIDTH - 1)}).rowCount();
+                }));
+        }
+        if (wants("full_scan")) {
+            results.push_back(runQueries("full_scan", records, threads, scans, *db,
+                [](const Query& query, std::mt19937&) {
+                    // Reads label from every record, returns a tenth of them
+                    return query("SELECT id, label FROM readings WHERE label LIKE 'reading-%9'", {}).rowCount();
+                }));
+        }
+        if (wants("aggregate")) {
+            results.push_back(benchAggregate(*db, records, threads, iterations));
+        }
+        if (wants("join")) {
+            results.push_back(runQueries("join", records, threads, scans, *db,
+                [](const Query& query, std::mt19937& rng) {
+                    return query("SELECT s.name, r.value FROM sensors s JOIN readings r ON r.sensor = s.id "
+                          "WHERE s.id = ?", {Value(int64_t(rng() % SENSORS))}).rowCount();
+                }));
+        }
+    }
+
+    if (wants("unified_view")) {
+        auto db = openDatabase(SCHEMA, "bench_unified");
+        const char* sources[] = {"east", "west", "north", "south"};
+        for (const char* source : sources) {
+            db->registerSource(source);
+        }
+        size_t perSource = records / 4;
+        for (size_t s = 0; s < 4; s++) {
+            std::vector<uint8_t> stream = buildReadings(perSource, static_cast<int32_t>(s * perSource + 1));
+            db->ingestWithSource(stream.data(), stream.size(), sources[s]);
+        }
+        db->createUnifiedViews();
+        results.push_back(runQueries("unified_view", records, threads, iterations, *db,
+            [perSource](const Query& query, std::mt19937& rng) {
+                int64_t from = randomId(rng, perSource * 4);
+                return query("SELECT _source, id FROM readings WHERE id BETWEEN ? AND ? ORDER BY id",
+                             {Value(from), Value(from + RANGE_WIDTH - 1)}).rowCount();
+            }));
+    }
+
+    if (wants("encrypted")) {
+        uint8_t key[32];
+        for (int i = 0; i < 32; i++) key[i] = static_cast<uint8_t>(5 * i + 1);
+        flatbuffers::EncryptionContext ctx(key, 32);
+        uint16_t labelField = SchemaParser::parseIDL(SECURE_SCHEMA).tables[0].columns[3].fieldId;
+        auto db = openDatabase(SECURE_SCHEMA, "bench_secure");
+        db->setEncryptionKey(key, 32);
+        std::vector<uint8_t> stream = buildReadings(records, 1, &ctx, labelField);
+        db->ingest(stream.data(), stream.size());
+        results.push_back(runQueries("encrypted", records, threads, iterations, *db,
+            [records](const Query& query, std::mt19937& rng) {
+                int64_t from = randomId(rng, records);
+                return query("SELECT label FROM readings WHERE id BETWEEN ? AND ?",
+                             {Value(from), Value(from + RANGE_WIDTH - 1)}).rowCount();
+            }));
+    }
+    return results;
+}
+
+// ==================== JSON ====================
+
+static std::string toJson(const std::vector<Result>& results) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"version\": 1,\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    {\"scenario\": \"" << r.scenario << "\", \"records\": " << r.records
+            << ", \"threads\": " << r.threads << ", \"operations\": " << r.operations
+            << ", \"rows\": " << r.rows
+            << ", \"total_ms\": " << r.totalMs << ", \"ops_per_sec\": " << r.opsPerSec
+            << ", \"mean_us\": " << r.meanUs << ", \"p50_us\": " << r.p50Us
+            << ", \"p99_us\": " << r.p99Us << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+// Results of a file written by toJson (flat objects of strings and numbers)
+static std::vector<Result> parseResults(const std::string& json) {
+    std::vector<Result> results;
+    size_t pos = json.find("\"results\"");
+    while (pos != std::string::npos && (pos = json.find('{', pos)) != std::string::npos) {
+        size_t end = json.find('}', pos);
+        if (end == std::string::npos) break;
+        std::map<std::string, std::string> fields;
+        size_t at = pos + 1;
+        while (true) {
+            size_t keyStart = json.find('"', at);
+            if (keyStart == std::string::npos || keyStart > end) break;
+            size_t keyEnd = json.find('"', keyStart + 1);
+            size_t colon = json.find(':', keyEnd);
+            size_t valueStart = json.find_first_not_of(" \t\n", colon + 1);
+            size_t valueEnd;
+            std::string value;
+            if (json[valueStart] == '"') {
+                valueEnd = json.find('"', valueStart + 1);
+                value = json.substr(valueStart + 1, valueEnd - valueStart - 1);
+                valueEnd++;
+            } else {
+                valueEnd = json.find_first_of(",}", valueStart);
+                value = json.substr(valueStart, valueEnd - valueStart);
+            }
+            fields[json.substr(keyStart + 1, keyEnd - keyStart - 1)] = value;
+            at = valueEnd;
+        }
+        Result r;
+        r.scenario = fields["scenario"];
+        r.records = std::stoull(fields.count("records") ? fields["records"] : "0");
+        r.threads = std::stoull(fields.count("threads") ? fields["threads"] : "0");
+        r.opsPerSec = std::stod(fields.count("ops_per_sec") ? fields["ops_per_sec"] : "0");
+        r.p99Us = std::stod(fields.count("p99_us") ? fields["p99_us"] : "0");
+        results.push_back(r);
+        pos = end + 1;
+    }
+    return results;
+}
+
+// Print regressions against baseline; returns how many there are
+static size_t checkBaseline(const std::vector<Result>& results, const std::vector<Result>& baseline,
+                            double tolerance) {
+    size_t regressions = 0;
+    for (const Result& r : results) {
+        for (const Result& b : baseline) {
+            if (b.scenario != r.scenario || b.records != r.records || b.threads != r.threads) continue;
+            bool slower = b.opsPerSec > 0 && r.opsPerSec < b.opsPerSec * (1.0 - tolerance);
+            bool laggier = r.scenario != "ingest" && b.p99Us > 0 && r.p99Us > b.p99Us * (1.0 + tolerance);
+            if (slower || laggier) {
+                regressions++;
+                std::cout << "REGRESSION " << r.scenario << " records=" << r.records
+                          << " threads=" << r.threads << std::fixed << std::setprecision(1)
+                          << ": " << r.opsPerSec << " ops/s (baseline " << b.opsPerSec << "), p99 "
+                          << r.p99Us << " us (baseline " << b.p99Us << ")\n";
+            }
+        }
+    }
+    return regressions;
+}
+
+// ==================== Main ====================
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static std::vector<size_t> splitSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    for (const std::string& item : splitList(list)) {
+        sizes.push_back(std::stoull(item));
+    }
+    return sizes;
+}
+
+static void printResult(const Result& r) {
+    std::cout << std::left << std::setw(14) << r.scenario
+              << std::right << std::setw(10) << r.records << std::setw(8) << r.threads
+              << std::fixed << std::setprecision(1)
+              << std::setw(14) << r.opsPerSec << std::setw(11) << r.p50Us << std::setw(11) << r.p99Us << "\n";
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (name == "--records") options.records = splitSizes(value);
+        else if (name == "--threads") options.threads = splitSizes(value);
+        else if (name == "--iterations") options.iterations = std::stoull(value);
+        else if (name == "--scenarios") options.scenarios = splitList(value);
+        else if (name == "--json") options.jsonPath = value;
+        else if (name == "--baseline") options.baselinePath = value;
+        else if (name == "--tolerance") options.tolerance = std::stod(value);
+        else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    std::cout << "FlatSQL Benchmark Suite\n" << std::string(68, '=') << "\n";
+    std::cout << std::left << std::setw(14) << "Scenario" << std::right << std::setw(10) << "Records"
+              << std::setw(8) << "Threads" << std::setw(14) << "Ops/s" << std::setw(11) << "p50 us"
+              << std::setw(11) << "p99 us" << "\n" << std::string(68, '-') << "\n";
+
+    std::vector<Result> results;
+    for (size_t records : options.records) {
+        for (size_t threads : options.threads) {
+            for (const Result& r : runScenarios(options, records, threads)) {
+                printResult(r);
+                if (r.rows == 0) {
+                    std::cout << "  warning: " << r.scenario << " returned no rows\n";
+                }
+                results.push_back(r);
+            }
+        }
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream(options.jsonPath) << toJson(results);
+        std::cout << "\nWrote " << options.jsonPath << "\n";
+    }
+
+    if (!options.baselinePath.empty()) {
+        std::ifstream in(options.baselinePath);
+        if (!in) {
+            std::cerr << "Cannot read baseline " << options.baselinePath << "\n";
+            return 2;
+        }
+        std::stringstream json;
+        json << in.rdbuf();
+        size_t regressions = checkBaseline(results, parseResults(json.str()), options.tolerance);
+        std::cout << "\n" << regressions << " regression(s) against " << options.baselinePath << "\n";
+        return regressions ? 1 : 0;
+    }
+    return 0;
+}
@@ -1,10 +1,26 @@
 #include "flatsql/database.h"
 #include "flatsql/junction.h"
 #include "flatsql/sqlite_index.h"
+#include "flatsql/btree.h"
+#include "flatsql/result_buffer.h"
+#include "flatsql/block_codec.h"
+#include "flatsql/hmac.h"
+#include "flatsql/ingest_server.h"
+#include "flatsql/stream_ingestor.h"
+#include "flatsql/sharded_database.h"
+#include "flatsql/trace.h"
 #include "flatbuffers/encryption.h"
 #include <sqlite3.h>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace flatsql;
 
@@ -268,11 +284,281 @@ void testSqliteIndex() {
         assert(range.empty());
     }
 
+    // ==================== Batched Insert Tests ====================
+    std::cout << "  Testing batched insert..." << std::endl;
+    {
+        SqliteIndex batchIndex(db, "batch_table", "value", ValueType::Int32);
+
+        // Unsorted input, not a multiple of the statement row count, with duplicates
+        std::vector<IndexEntry> entries;
+        for (int i = 0; i < 150; i++) {
+            int32_t key = (i * 37) % 100;
+            entries.push_back({key, static_cast<uint64_t>(i * 10), 10, static_cast<uint64_t>(i + 1)});
+        }
+        batchIndex.insertBatch(entries);
+        assert(batchIndex.getEntryCount() == 150);
+
+        auto all = batchIndex.all();
+        assert(all.size() == 150);
+        for (size_t i = 1; i < all.size(); i++) {
+            assert(compareValues(all[i - 1].key, all[i].key) <= 0);
+        }
+        assert(batchIndex.search(37).size() == 2);
+
+        // A NULL key fails the batch statement; rows before it are still kept
+        std::vector<IndexEntry> bad = {{int32_t(500), 0, 1, 1000}, {std::monostate{}, 0, 1, 1001}};
+        bool threw = false;
+        try {
+            batchIndex.bulkLoad(bad);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        assert(batchIndex.search(500).size() == 1);
+    }
+
+    // ==================== Typed Key Tests ====================
+    std::cout << "  Testing typed keys..." << std::endl;
+    {
+        // Keys of the index's type bind directly and read back as that type
+        SqliteIndex unsignedIndex(db, "typed", "u32", ValueType::UInt32);
+        for (uint32_t i = 0; i < 10; i++) {
+            unsignedIndex.insert(uint32_t(3000000000u + i), i * 10, 10, i);
+        }
+        auto hits = unsignedIndex.search(uint32_t(3000000004u));
+        assert(hits.size() == 1 && hits[0].dataOffset == 40);
+        assert(std::get<uint32_t>(hits[0].key) == 3000000004u);
+        assert(unsignedIndex.range(uint32_t(3000000002u), uint32_t(3000000005u)).size() == 4);
+
+        // Other alternatives are compared as SQL values
+        SqliteIndex intIndex(db, "typed", "i32", ValueType::Int32);
+        for (int32_t i = 0; i < 20; i++) intIndex.insert(i, i * 10, 10, i);
+        assert(intIndex.search(int64_t(7)).size() == 1);
+        assert(intIndex.search(7.0).size() == 1);
+        assert(intIndex.search(7.5).empty());
+        assert(intIndex.range(9.5, 12.5).size() == 3);
+        assert(intIndex.range(Value(std::monostate{}), 2.5).size() == 3);
+        uint64_t offset;
+        uint32_t len;
+        uint64_t seq;
+        assert(intIndex.searchFirstString("12", offset, len, seq) && offset == 120 && seq == 12);
+
+        SqliteIndex realIndex(db, "typed", "f32", ValueType::Float32);
+        realIndex.insert(1.5f, 0, 1, 1);
+        realIndex.insert(-2.25f, 1, 1, 2);
+        auto reals = realIndex.all();
+        assert(reals.size() == 2 && std::get<float>(reals[0].key) == -2.25f);
+        assert(realIndex.search(int32_t(1)).empty() && realIndex.search(1.5).size() == 1);
+
+        // Strings keep embedded NULs and sort bytewise
+        SqliteIndex textIndex(db, "typed", "text", ValueType::String);
+        std::string withNul("a\0b", 3);
+        textIndex.insert(withNul, 0, 1, 1);
+        textIndex.insert(std::string("a"), 1, 1, 2);
+        textIndex.insert(std::string("B"), 2, 1, 3);
+        auto texts = textIndex.all();
+        assert(texts.size() == 3 && std::get<std::string>(texts[0].key) == "B");
+        assert(std::get<std::string>(texts[2].key) == withNul);
+        assert(textIndex.search(withNul).size() == 1);
+
+        SqliteIndex blobIndex(db, "typed", "blob", ValueType::Bytes);
+        blobIndex.insert(std::vector<uint8_t>{1, 2}, 5, 1, 1);
+        assert(blobIndex.search(std::vector<uint8_t>{1, 2}).size() == 1);
+        assert(std::get<std::vector<uint8_t>>(blobIndex.all()[0].key) == (std::vector<uint8_t>{1, 2}));
+
+        SqliteIndex flagIndex(db, "typed", "flag", ValueType::Bool);
+        flagIndex.insert(true, 7, 1, 1);
+        assert(flagIndex.search(true).size() == 1 && flagIndex.search(int32_t(1)).size() == 1);
+        assert(std::get<bool>(flagIndex.all()[0].key));
+
+        // Moved indexes keep their codec and statements
+        SqliteIndex moved(std::move(intIndex));
+        assert(moved.search(int32_t(3)).size() == 1);
+        assert(moved.searchFirstInt64(19, offset, len, seq) && offset == 190);
+    }
+
     sqlite3_close(db);
 
     std::cout << "SQLite-backed index tests passed!" << std::endl;
 }
 
+void testBTreeIndex() {
+    std::cout << "Testing native B+tree index..." << std::endl;
+
+    // ==================== Integer Keys ====================
+    std::cout << "  Testing integer keys..." << std::endl;
+    {
+        BTreeIndex index("test_table", "int_column", ValueType::Int32);
+        for (int i = 0; i < 1000; i++) {
+            index.insert(i, static_cast<uint64_t>(i * 100), 50, static_cast<uint64_t>(i));
+        }
+        assert(index.getEntryCount() == 1000);
+        assert(index.getHeight() == 2);
+
+        auto results = index.search(42);
+        assert(results.size() == 1);
+        assert(results[0].dataOffset == 4200);
+        assert(std::get<int32_t>(results[0].key) == 42);
+
+        uint64_t offset, seq;
+        uint32_t len;
+        assert(index.searchFirstInt64(500, offset, len, seq));
+        assert(offset == 50000 && len == 50 && seq == 500);
+        assert(!index.searchFirstInt64(5000, offset, len, seq));
+
+        // Numeric coercion: int64 and integral doubles match, fractional ones don't
+        assert(index.search(int64_t(7)).size() == 1);
+        assert(index.search(7.0).size() == 1);
+        assert(index.search(7.5).empty());
+        assert(index.range(9.5, 20.5).size() == 11);  // 10 through 20
+        assert(index.range(10, 20).size() == 11);
+        assert(index.range(20, 10).empty());
+        assert(index.search(std::string("7")).empty());
+        assert(index.search(std::monostate{}).empty());
+
+        auto all = index.all();
+        assert(all.size() == 1000);
+        for (size_t i = 0; i < all.size(); i++) {
+            assert(all[i].sequence == i);
+        }
+
+        index.clear();
+        assert(index.getEntryCount() == 0);
+        assert(index.all().empty());
+        assert(!index.searchFirstInt64(42, offset, len, seq));
+
+        bool threw = false;
+        try {
+            index.insert(std::monostate{}, 0, 1, 1);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // ==================== String Keys ====================
+    std::cout << "  Testing string keys..." << std::endl;
+    {
+        BTreeIndex index("test_table", "string_column", ValueType::String);
+        // Shared 8-byte prefixes force the arena tie-break
+        std::vector<std::string> keys = {"common_prefix_b", "common_prefix_a", "common_p", "", "z",
+                                         "common_prefix_a_longer", "alice", "bob"};
+        for (size_t i = 0; i < keys.size(); i++) {
+            index.insert(keys[i], i * 10, 5, i + 1);
+        }
+
+        auto all = index.all();
+        assert(all.size() == keys.size());
+        for (size_t i = 1; i < all.size(); i++) {
+            assert(std::get<std::string>(all[i - 1].key) < std::get<std::string>(all[i].key));
+        }
+
+        uint64_t offset, seq;
+        uint32_t len;
+        assert(index.searchFirstString("common_prefix_a", offset, len, seq));
+        assert(offset == 10);
+        assert(index.searchFirstString("", offset, len, seq));
+        assert(seq == 4);
+        assert(!index.searchFirstString("common_prefix", offset, len, seq));
+        assert(index.range(std::string("common_prefix_a"), std::string("common_prefix_b")).size() == 3);
+        assert(index.search(42).empty());
+    }
+
+    // ==================== Duplicates, Doubles, Bulk Load ====================
+    std::cout << "  Testing duplicates and bulk load..." << std::endl;
+    {
+        BTreeIndex index("posts", "user_id", ValueType::Int32);
+        std::vector<IndexEntry> entries;
+        for (int i = 0; i < 5000; i++) {
+            entries.push_back({int32_t((i * 7919) % 250), static_cast<uint64_t>(i), 1,
+                               static_cast<uint64_t>(i + 1)});
+        }
+        index.insertBatch(entries);  // Sorted bottom-up build
+        assert(index.getEntryCount() == 5000);
+        assert(index.search(17).size() == 20);
+
+        // Incremental inserts into the packed tree split leaves and inner nodes
+        for (int i = 5000; i < 6000; i++) {
+            index.insert(int32_t(i % 250), static_cast<uint64_t>(i), 1, static_cast<uint64_t>(i + 1));
+        }
+        auto dup = index.search(17);
+        assert(dup.size() == 24);
+        for (size_t i = 1; i < dup.size(); i++) {
+            assert(dup[i - 1].sequence < dup[i].sequence);
+        }
+        assert(index.range(0, 249).size() == 6000);
+
+        BTreeIndex real("samples", "value", ValueType::Float64);
+        for (int i = -50; i < 50; i++) {
+            real.insert(i * 0.5, static_cast<uint64_t>(i + 50), 1, static_cast<uint64_t>(i + 50));
+        }
+        assert(std::get<double>(real.all().front().key) == -25.0);
+        assert(real.search(-0.0).size() == 1);
+        assert(real.search(int32_t(3)).size() == 1);
+        assert(real.range(-1, 1).size() == 5);
+    }
+
+    // ==================== Agreement with SqliteIndex ====================
+    std::cout << "  Testing agreement with SqliteIndex..." << std::endl;
+    {
+        sqlite3* db;
+        int rc = sqlite3_open(":memory:", &db);
+        assert(rc == SQLITE_OK);
+        {
+            SqliteIndex reference(db, "cmp", "value", ValueType::Int64);
+            BTreeIndex index("cmp", "value", ValueType::Int64);
+
+            uint64_t state = 12345;
+            for (uint64_t i = 1; i <= 3000; i++) {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                int64_t key = static_cast<int64_t>(state >> 40) - (1 << 23);
+                reference.insert(key, i, 1, i);
+                index.insert(key, i, 1, i);
+            }
+
+            auto expected = reference.all();
+            auto actual = index.all();
+            assert(expected.size() == actual.size());
+            for (size_t i = 0; i < expected.size(); i++) {
+                assert(compareValues(expected[i].key, actual[i].key) == 0);
+                assert(expected[i].sequence == actual[i].sequence);
+            }
+            assert(reference.range(-100000, 100000).size() == index.range(-100000, 100000).size());
+        }
+        sqlite3_close(db);
+    }
+
+    // ==================== Database Queries ====================
+    std::cout << "  Testing database with B+tree indexes..." << std::endl;
+    {
+        std::string schema = R"(
+            table items {
+                id: int (id);
+                name: string;
+            }
+        )";
+        FlatSQLDatabase db(SchemaParser::parse(schema, "btree"), StorageOptions(), IndexEngine::BTree);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+            if (field != "id" || length < 12) return std::monostate{};
+            int32_t id;
+            std::memcpy(&id, data + 8, sizeof(id));
+            return id;
+        });
+        for (int32_t id = 1; id <= 200; id++) {
+            std::vector<uint8_t> item = {0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M', 0, 0, 0, 0};
+            std::memcpy(item.data() + 8, &id, sizeof(id));
+            db.ingestOne(item.data(), item.size());
+        }
+        assert(db.query("SELECT id FROM items WHERE id = 42").rowCount() == 1);
+        assert(db.query("SELECT id FROM items WHERE id BETWEEN 10 AND 19").rowCount() == 10);
+        assert(db.query("SELECT id FROM items WHERE id = 999").rowCount() == 0);
+        assert(db.query("SELECT * FROM items").rowCount() == 200);
+    }
+
+    std::cout << "Native B+tree index tests passed!" << std::endl;
+}
+
 void testStorage() {
     std::cout << "Testing streaming FlatBuffer storage..." << std::endl;
 
@@ -320,6 +606,14 @@ void testStorage() {
     assert(store.hasRecord(seq1));
     assert(store.hasRecord(seq2));
     assert(!store.hasRecord(999));
+    assert(!store.hasRecord(0));
+
+    // Dense sequence <-> offset mapping
+    auto offset2 = store.getOffsetForSequence(seq2);
+    assert(offset2.has_value());
+    assert(store.getSequenceForOffset(*offset2) == seq2);
+    assert(store.getSequenceForOffset(*offset2 + 1) == 0);
+    assert(!store.getOffsetForSequence(999).has_value());
 
     // Export and reload
     auto exportedData = store.exportData();
@@ -341,6 +635,155 @@ void testStorage() {
     std::cout << "Storage tests passed!" << std::endl;
 }
 
+void testSegmentedStorage() {
+    std::cout << "Testing segmented FlatBuffer storage..." << std::endl;
+
+    // Tiny chunks so records spill across several segments
+    StorageOptions options;
+    options.mode = StorageMode::Segmented;
+    options.segmentSize = 64;
+    StreamingFlatBufferStore store(options);
+    StreamingFlatBufferStore contiguous;
+    assert(store.getStorageMode() == StorageMode::Segmented);
+    assert(store.getDataBuffer() == nullptr);
+
+    std::vector<uint8_t> small = {0x08, 0x00, 0x00, 0x00, 'U', 'S', 'E', 'R', 0x0C, 0x00,
+                                  0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A};
+    std::vector<uint8_t> large(200, 0xAB);  // Larger than one segment
+    std::memcpy(large.data() + 4, "POST", 4);
+
+    uint32_t firstLength = 0;
+    store.ingestFlatBuffer(small.data(), small.size(), nullptr);
+    const uint8_t* firstPtr = store.getDataAtOffset(0, &firstLength);
+
+    for (int i = 0; i < 20; i++) {
+        const auto& data = (i % 7 == 3) ? large : small;
+        store.ingestFlatBuffer(data.data(), data.size(), nullptr);
+        contiguous.ingestFlatBuffer(data.data(), data.size(), nullptr);
+    }
+    contiguous.ingestFlatBuffer(small.data(), small.size(), nullptr);
+
+    // Earlier pointers stay valid as the arena grows
+    assert(store.getDataAtOffset(0, &firstLength) == firstPtr);
+    assert(firstLength == small.size());
+    assert(store.getRecordCount() == 21);
+
+    // Every record reads back through its sequence and the file ID index
+    for (uint64_t seq = 1; seq <= 21; seq++) {
+        StoredRecord record = store.readRecord(seq);
+        assert(record.data.size() == small.size() || record.data == large);
+    }
+    assert(store.getRecordCountByFileId("USER") == 18);
+    assert(store.getRecordCountByFileId("POST") == 3);
+
+    // Sequential walks skip segment tails
+    size_t walked = 0;
+    store.iterateRecords([&](const StoredRecord&) { walked++; return true; });
+    assert(walked == 21);
+
+    size_t postCount = 0;
+    uint64_t off, seq;
+    const uint8_t* data;
+    uint32_t len;
+    bool found = store.getFirstRecord("POST", &off, &seq, &data, &len);
+    while (found) {
+        assert(len == large.size());
+        postCount++;
+        found = store.getNextRecord(off, "POST", &off, &seq, &data, &len);
+    }
+    assert(postCount == 3);
+
+    // Export re-packs into a plain stream, regardless of ingest order
+    auto exported = store.exportData();
+    auto expected = contiguous.exportData();
+    assert(exported.size() == expected.size());
+
+    StreamingFlatBufferStore reloaded(options);
+    reloaded.loadAndRebuild(exported.data(), exported.size(), nullptr);
+    assert(reloaded.getRecordCount() == 21);
+    assert(reloaded.exportData() == exported);
+
+    std::cout << "Segmented storage tests passed!" << std::endl;
+}
+
+void testMappedStorage() {
+    std::cout << "Testing memory-mapped storage..." << std::endl;
+
+    std::string path = "flatsql_test_mapped.fbs";
+    std::remove(path.c_str());
+    std::remove((path + ".meta").c_str());
+    std::remove((path + ".idx").c_str());
+
+    std::string schema = R"(
+        table items {
+            id: int (id);
+            name: string;
+        }
+    )";
+    StorageOptions options;
+    options.mode = StorageMode::MappedFile;
+    options.path = path;
+
+    // Fake FlatBuffers: "ITEM" identifier, id as LE int32 at bytes 8-11
+    auto makeItem = [](int32_t id) {
+        std::vector<uint8_t> data = {0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M', 0, 0, 0, 0};
+        std::memcpy(data.data() + 8, &id, sizeof(id));
+        return data;
+    };
+    auto extractId = [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+        if (field != "id" || length < 12) return std::monostate{};
+        int32_t id;
+        std::memcpy(&id, data + 8, sizeof(id));
+        return id;
+    };
+    auto openDb = [&]() {
+        auto db = std::make_unique<FlatSQLDatabase>(SchemaParser::parse(schema, "mapped"), options);
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", extractId);
+        return db;
+    };
+
+    {
+        auto db = openDb();
+        assert(!db->reopen());  // Fresh file
+        for (int32_t id = 1; id <= 100; id++) {
+            auto item = makeItem(id);
+            db->ingestOne(item.data(), item.size());
+        }
+        assert(db->query("SELECT id FROM items WHERE id = 42").rowCount() == 1);
+    }  // Destructor syncs both sidecars
+
+    {
+        // Indexes come back from the sidecar without re-extraction
+        auto db = openDb();
+        assert(db->getStorage().getRestoredLength() == db->getStorage().getDataSize());
+        assert(db->reopen());
+        assert(db->getStorage().getRecordCount() == 100);
+        assert(db->query("SELECT * FROM items").rowCount() == 100);
+        assert(db->query("SELECT id FROM items WHERE id = 42").rowCount() == 1);
+
+        auto item = makeItem(101);
+        db->ingestOne(item.data(), item.size());
+    }
+
+    {
+        // Without sidecars every record is rescanned and re-indexed
+        std::remove((path + ".meta").c_str());
+        std::remove((path + ".idx").c_str());
+        auto db = openDb();
+        assert(db->getStorage().getRestoredLength() == 0);
+        assert(!db->reopen());
+        assert(db->getStorage().getRecordCount() == 101);
+        assert(db->query("SELECT id FROM items WHERE id = 101").rowCount() == 1);
+    }
+
+    std::remove(path.c_str());
+    std::remove((path + ".meta").c_str());
+    std::remove((path + ".idx").c_str());
+
+    std::cout << "Memory-mapped storage tests passed!" << std::endl;
+}
+
 void testDatabase() {
     std::cout << "Testing FlatSQL database..." << std::endl;
 
@@ -716,6 +1159,4530 @@ void testEncryptionRoundTrip() {
     std::cout << "Encryption round-trip tests passed!" << std::endl;
 }
 
+void testParallelIngest() {
+    std::cout << "Testing parallel index extraction during ingest..." << std::endl;
+
+    std::string schema = R"(
+        table items {
+            id: int (id);
+            bucket: int (key);
+        }
+    )";
+    auto extractor = [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+        if (length < 12) return std::monostate{};
+        int32_t id;
+        std::memcpy(&id, data + 8, sizeof(id));
+        if (field == "id") return id;
+        if (field == "bucket") return id % 97;
+        return std::monostate{};
+    };
+
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 20000; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+
+    FlatSQLDatabase serial(SchemaParser::parse(schema, "serial"));
+    FlatSQLDatabase parallel(SchemaParser::parse(schema, "parallel"));
+    parallel.setIngestThreads(4);
+    for (FlatSQLDatabase* db : {&serial, &parallel}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", extractor);
+        // Uneven chunks so extraction ranges split mid-chunk
+        size_t pos = 0;
+        while (pos < stream.size()) {
+            size_t len = std::min<size_t>(stream.size() - pos, 16 * 1237);
+            pos += db->ingest(stream.data() + pos, len);
+        }
+    }
+
+    // Same rows, sequences and offsets either way
+    const char* queries[] = {
+        "SELECT id, _rowid, _offset FROM items WHERE bucket = 5",
+        "SELECT id, _rowid FROM items WHERE id BETWEEN 9000 AND 9100",
+        "SELECT id, _rowid FROM items WHERE id = 12345",
+    };
+    for (const char* sql : queries) {
+        auto expected = serial.query(sql);
+        auto actual = parallel.query(sql);
+        assert(expected.rowCount() > 0);
+        assert(expected.rowCount() == actual.rowCount());
+        for (size_t i = 0; i < expected.rowCount(); i++) {
+            for (size_t c = 0; c < expected.rows[i].size(); c++) {
+                assert(compareValues(expected.rows[i][c], actual.rows[i][c]) == 0);
+            }
+        }
+    }
+
+    // A throwing extractor surfaces from ingest; records stay stored
+    {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "throwing"));
+        db.setIngestThreads(4);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", [](const uint8_t*, size_t, const std::string&) -> Value {
+            throw std::runtime_error("bad record");
+        });
+        bool threw = false;
+        try {
+            db.ingest(stream.data(), stream.size());
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        assert(db.getStorage().getRecordCount() == 20000);
+    }
+
+    std::cout << "Parallel ingest tests passed!" << std::endl;
+}
+
+// Items table shared by the column cache tests. Record layout after the file
+// ID: int32 id, then score = id / 4, qty = id % 7 (null when id % 10 == 0)
+static const char* ITEMS_SCHEMA = R"(
+    table items {
+        id: int (id);
+        score: double;
+        qty: int;
+        name: string;
+    }
+)";
+static std::atomic<size_t> itemsExtractorCalls{0};  // Extractors may run on scan workers
+
+static Value itemsExtractor(const uint8_t* data, size_t length, const std::string& field) {
+    itemsExtractorCalls++;
+    if (length < 12) return std::monostate{};
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    if (field == "id") return id;
+    if (field == "score") return id / 4.0;
+    if (field == "qty") return id % 10 == 0 ? Value(std::monostate{}) : Value(int32_t(id % 7));
+    if (field == "name") return std::string("item");
+    return std::monostate{};
+}
+
+static void ingestItems(FlatSQLDatabase& db, int32_t from, int32_t to) {
+    std::vector<uint8_t> stream;
+    for (int32_t id = from; id <= to; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    db.ingest(stream.data(), stream.size());
+}
+
+void testColumnCache() {
+    std::cout << "Testing materialized column caches..." << std::endl;
+
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "plain"));
+    FlatSQLDatabase cached(SchemaParser::parse(ITEMS_SCHEMA, "cached"));
+    for (FlatSQLDatabase* db : {&plain, &cached}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", itemsExtractor);
+    }
+    cached.enableColumnCache("items", "score");
+    ingestItems(plain, 1, 500);
+    ingestItems(cached, 1, 500);
+
+    // Enabling later backfills existing rows
+    cached.enableColumnCache("items", "qty");
+    ingestItems(plain, 501, 1000);
+    ingestItems(cached, 501, 1000);
+
+    bool threw = false;
+    try {
+        cached.enableColumnCache("items", "name");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    const char* sql = "SELECT SUM(score), AVG(qty), COUNT(qty), MAX(score) FROM items";
+    auto expected = plain.query(sql);
+    size_t callsBefore = itemsExtractorCalls;
+    auto actual = cached.query(sql);
+    assert(itemsExtractorCalls == callsBefore);  // Served from the arrays
+    for (size_t c = 0; c < expected.rows[0].size(); c++) {
+        assert(compareValues(expected.rows[0][c], actual.rows[0][c]) == 0);
+    }
+    assert(actual.rows[0][2] == Value(int64_t(900)));
+
+    // Deleted rows are skipped as usual
+    cached.markDeleted("items", 1000);
+    auto afterDelete = cached.query("SELECT COUNT(score) FROM items");
+    assert(afterDelete.rows[0][0] == Value(int64_t(999)));
+
+    std::cout << "Column cache tests passed!" << std::endl;
+}
+
+static size_t itemsKeyExtractorCalls = 0;
+
+static void itemsKeyExtractor(const uint8_t* data, size_t length, const int* columns,
+                              size_t count, Value* keys) {
+    itemsKeyExtractorCalls++;
+    for (size_t i = 0; i < count; i++) {
+        // Only id (column 0) is indexed in ITEMS_SCHEMA
+        int32_t id = 0;
+        if (columns[i] == 0 && length >= 12) std::memcpy(&id, data + 8, sizeof(id));
+        keys[i] = columns[i] == 0 && length >= 12 ? Value(id) : Value(std::monostate{});
+    }
+}
+
+void testKeyExtractor() {
+    std::cout << "Testing index key extractors..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "keys"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    db.setKeyExtractor("items", itemsKeyExtractor);
+
+    size_t fieldCalls = itemsExtractorCalls;
+    ingestItems(db, 1, 300);
+    assert(itemsKeyExtractorCalls == 300);          // One call per record
+    assert(itemsExtractorCalls == fieldCalls);      // Not used for keys
+
+    auto hit = db.query("SELECT score FROM items WHERE id = 120");
+    assert(hit.rowCount() == 1 && hit.rows[0][0] == Value(30.0));
+    auto range = db.query("SELECT COUNT(*) FROM items WHERE id BETWEEN 10 AND 19");
+    assert(range.rows[0][0] == Value(int64_t(10)));
+
+    std::cout << "Key extractor tests passed!" << std::endl;
+}
+
+void testPreparedLookup() {
+    std::cout << "Testing prepared lookups..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "lookup"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 200);
+
+    PreparedLookup byId = db.prepareLookup("items", "id");
+    const uint8_t* data = nullptr;
+    uint32_t length = 0;
+    uint64_t sequence = 0;
+    assert(byId.find(int32_t(150), &data, &length, &sequence));
+    assert(length == 12 && sequence == 150);
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    assert(id == 150);
+    assert(!byId.find(int32_t(201), &data, &length));
+
+    // Later ingest and deletes are seen without re-preparing
+    ingestItems(db, 201, 210);
+    assert(byId.find(int32_t(205), &data, &length));
+    db.markDeleted("items", 150);
+    assert(!byId.find(int32_t(150), &data, &length));
+
+    bool threw = false;
+    try {
+        db.prepareLookup("items", "score");  // Not indexed
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Prepared lookup tests passed!" << std::endl;
+}
+
+void testBatchedLookup() {
+    std::cout << "Testing batched index lookups..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "batched"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 2000);
+
+        // Sorted, deduplicated; missing and NULL keys drop out
+        auto entries = db.findManyByIndex("items", "id",
+            {int32_t(5), int32_t(3), int32_t(5), int32_t(9999), Value(std::monostate{})});
+        assert(entries.size() == 2);
+        assert(entries[0].sequence == 3 && entries[1].sequence == 5);
+        uint32_t length = 0;
+        const uint8_t* data = db.getStorage().getDataAtOffset(entries[1].dataOffset, &length);
+        int32_t id;
+        std::memcpy(&id, data + 8, sizeof(id));
+        assert(id == 5);
+
+        // More keys than one statement binds, spanning many B-tree leaves
+        std::vector<Value> keys;
+        for (int32_t k = 2500; k >= 1; k -= 3) keys.push_back(k);
+        entries = db.findManyByIndex("items", "id", keys);
+        assert(entries.size() == 667);
+        for (size_t i = 0; i < entries.size(); i++) {
+            assert(entries[i].sequence == 1 + 3 * i);
+        }
+
+        // Non-unique keys come back grouped by key
+        entries = db.findManyByIndex("items", "qty", {int32_t(4), int32_t(2)});
+        assert(!entries.empty());
+        size_t twos = 0;
+        for (const auto& entry : entries) {
+            bool two = entry.sequence % 7 == 2;
+            assert(two || entry.sequence % 7 == 4);
+            assert(!two || twos == static_cast<size_t>(&entry - &entries[0]));
+            twos += two;
+        }
+
+        // Prepared handles skip deleted records
+        db.markDeleted("items", 151);
+        PreparedLookup byId = db.prepareLookup("items", "id");
+        entries = byId.findMany({int32_t(150), int32_t(151), int32_t(152)});
+        assert(entries.size() == 2 && entries[0].sequence == 150 && entries[1].sequence == 152);
+
+        // IN lists on an indexed column are resolved in one xFilter call
+        auto plan = db.query("EXPLAIN QUERY PLAN SELECT id FROM items WHERE id IN (1, 2, 3)");
+        assert(std::get<std::string>(plan.rows[0][3]).find("INDEX 4:") != std::string::npos);
+
+        // Reference queries defeat the index with "+ 0" ('12' takes the
+        // column's integer affinity only in the indexed form)
+        const char* queries[][2] = {
+            {"SELECT id FROM items WHERE id IN (7, 151, 3, 7, 4000, '12') ORDER BY id",
+             "SELECT id FROM items WHERE id + 0 IN (7, 151, 3, 7, 4000, 12) ORDER BY id"},
+            {"SELECT id FROM items WHERE qty IN (2, 4) AND score > 400 ORDER BY id",
+             "SELECT id FROM items WHERE qty + 0 IN (2, 4) AND score > 400 ORDER BY id"},
+            {"SELECT id FROM items WHERE id IN (SELECT id * 2 FROM items WHERE id < 40) ORDER BY id",
+             "SELECT id FROM items WHERE id + 0 IN (SELECT id * 2 FROM items WHERE id < 40) ORDER BY id"},
+            {"SELECT id FROM items WHERE id IN (10, 20, 30) AND qty = 6 ORDER BY id",
+             "SELECT id FROM items WHERE id + 0 IN (10, 20, 30) AND qty + 0 = 6 ORDER BY id"},
+            {"SELECT COUNT(*) FROM items WHERE id IN (1, 2) AND _source = 'other'",
+             "SELECT 0"},
+        };
+        for (const auto& query : queries) {
+            auto actual = db.query(query[0]);
+            auto expected = db.query(query[1]);
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+            }
+        }
+    }
+
+    std::cout << "Batched lookup tests passed!" << std::endl;
+}
+
+void testIndexStatistics() {
+    std::cout << "Testing index statistics and planner costs..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "stats"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 2000);
+
+        IndexStats ids = db.getIndexStats("items", "id");
+        assert(ids.entries == 2000);
+        assert(ids.distinctKeys > 1700 && ids.distinctKeys <= 2000);
+        assert(ids.hasRange && ids.minKey == 1.0 && ids.maxKey == 2000.0);
+        double lo = 501.0, hi = 1000.0;
+        assert(ids.rangeFraction(&lo, &hi) > 0.24 && ids.rangeFraction(&lo, &hi) < 0.26);
+        assert(ids.rangeFraction(nullptr, nullptr) == 1.0);
+
+        // qty is NULL for every tenth id and not indexed there
+        IndexStats qty = db.getIndexStats("items", "qty");
+        assert(qty.entries == 1800 && qty.distinctKeys >= 5 && qty.distinctKeys <= 9);
+        assert(qty.equalityRows() == 1800.0 / qty.distinctKeys);
+
+        // The primary key wins over a non-unique index, a selective
+        // non-unique EQ over a wide range, and ranges apply their bounds
+        auto planOf = [&db](const char* sql) {
+            auto plan = db.query(std::string("EXPLAIN QUERY PLAN ") + sql);
+            return std::get<std::string>(plan.rows[0][3]);
+        };
+        assert(planOf("SELECT id FROM items WHERE qty = 3 AND id = 17").find("INDEX 2:") != std::string::npos);
+        assert(planOf("SELECT id FROM items WHERE id > 5 AND qty = 3").find("INDEX 514:") != std::string::npos);
+        assert(planOf("SELECT id FROM items WHERE id BETWEEN 10 AND 20").find("INDEX 51:") != std::string::npos);
+        assert(planOf("SELECT id FROM items WHERE id > 5 AND score > 0").find("INDEX 0:") != std::string::npos);
+
+        const char* queries[][2] = {
+            {"SELECT id FROM items WHERE id BETWEEN 10 AND 20",
+             "SELECT id FROM items WHERE id + 0 BETWEEN 10 AND 20"},
+            {"SELECT id FROM items WHERE id > 1990.5",
+             "SELECT id FROM items WHERE id + 0 > 1990.5"},
+            // '3' can't bound the integer index, so that side stays open
+            {"SELECT id FROM items WHERE id < 7 AND id >= '3'",
+             "SELECT id FROM items WHERE id + 0 < 7 AND id + 0 >= 3"},
+            {"SELECT id FROM items WHERE qty = 3 AND id = 17",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 = 17"},
+            {"SELECT id FROM items WHERE id > 5 AND qty = 3 AND id < 100",
+             "SELECT id FROM items WHERE id + 0 > 5 AND qty + 0 = 3 AND id + 0 < 100"},
+        };
+        for (const auto& query : queries) {
+            auto actual = db.query(std::string(query[0]) + " ORDER BY id");
+            auto expected = db.query(std::string(query[1]) + " ORDER BY id");
+            assert(!expected.rows.empty());
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+            }
+        }
+    }
+
+    std::cout << "Index statistics tests passed!" << std::endl;
+}
+
+void testIndexIntersection() {
+    std::cout << "Testing index intersection..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "intersect"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 2000);
+        db.markDeleted("items", 66);  // qty 3
+
+        // Two moderately selective lookups beat either one alone
+        auto plan = db.query("EXPLAIN QUERY PLAN SELECT id FROM items WHERE qty = 3 AND id < 200");
+        assert(std::get<std::string>(plan.rows[0][3]).find("INDEX 5:") != std::string::npos);
+
+        const char* queries[][2] = {
+            {"SELECT id FROM items WHERE qty = 3 AND id < 200",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 < 200"},
+            {"SELECT id FROM items WHERE qty = 5 AND id >= 100 AND id <= 250 AND score > 30",
+             "SELECT id FROM items WHERE qty + 0 = 5 AND id + 0 BETWEEN 100 AND 250 AND score > 30"},
+            {"SELECT id FROM items WHERE qty = 3 AND id < 200 AND id > 190.5",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 < 200 AND id + 0 > 190.5"},
+            {"SELECT id FROM items WHERE qty = 3 AND id < 0",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 < 0"},
+        };
+        for (const auto& query : queries) {
+            auto actual = db.query(std::string(query[0]) + " ORDER BY id");
+            auto expected = db.query(std::string(query[1]) + " ORDER BY id");
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+            }
+        }
+    }
+
+    std::cout << "Index intersection tests passed!" << std::endl;
+}
+
+void testIndexRangeCursor() {
+    std::cout << "Testing streaming index range cursors..." << std::endl;
+
+    sqlite3* db;
+    int rc = sqlite3_open(":memory:", &db);
+    assert(rc == SQLITE_OK);
+    {
+        SqliteIndex sqliteInts(db, "cursor", "qty", ValueType::Int32);
+        SqliteIndex sqliteNames(db, "cursor", "name", ValueType::String);
+        BTreeIndex btreeInts("cursor", "qty", ValueType::Int32);
+        BTreeIndex btreeNames("cursor", "name", ValueType::String);
+        Index* ints[] = {&sqliteInts, &btreeInts};
+        Index* names[] = {&sqliteNames, &btreeNames};
+
+        // Scattered insertion order, many pages per key
+        for (uint64_t i = 0; i < 3000; i++) {
+            uint64_t seq = (i * 7919) % 3000 + 1;
+            for (Index* index : ints) index->insert(static_cast<int32_t>(seq % 5), seq * 10, 8, seq);
+            std::string name = "customer-name-" + std::to_string(seq % 40);
+            for (Index* index : names) index->insert(name, seq * 10, 8, seq);
+        }
+
+        auto drain = [](IndexCursor& cursor) {
+            std::vector<uint64_t> sequences;
+            IndexEntry entry;
+            while (cursor.next(entry)) sequences.push_back(entry.sequence);
+            return sequences;
+        };
+        auto check = [&drain](const Index& index, const Value& lo, const Value& hi) {
+            std::vector<uint64_t> expected;
+            for (const auto& entry : index.range(lo, hi)) expected.push_back(entry.sequence);
+            auto forward = index.openRange(lo, hi, false);
+            assert(drain(*forward) == expected);
+            std::reverse(expected.begin(), expected.end());
+            auto backward = index.openRange(lo, hi, true);
+            assert(drain(*backward) == expected);
+            return expected.size();
+        };
+
+        const Value open;
+        for (Index* index : ints) {
+            assert(check(*index, open, open) == 3000);
+            assert(check(*index, 2, 2) == 600);
+            assert(check(*index, 1, 3) == 1800);
+            assert(check(*index, 3, open) == 1200);
+            assert(check(*index, open, 0) == 600);
+            assert(check(*index, 1.5, 2.5) == 600);
+            assert(check(*index, 3, 1) == 0);
+            assert(check(*index, 9, open) == 0);
+        }
+        for (Index* index : names) {
+            assert(check(*index, open, open) == 3000);
+            assert(check(*index, std::string("customer-name-7"), std::string("customer-name-7")) == 75);
+            assert(check(*index, std::string("customer-name-2"), std::string("customer-name-3")) > 75);
+        }
+
+        // Entries inserted mid-scan don't disturb the resume position
+        for (Index* index : ints) {
+            auto cursor = index->openRange(2, 2, false);
+            IndexEntry entry;
+            std::vector<uint64_t> seen;
+            while (cursor->next(entry)) {
+                seen.push_back(entry.sequence);
+                if (seen.size() % 100 == 0) {
+                    uint64_t seq = 3000 + seen.size();
+                    index->insert(int32_t(2), seq * 10, 8, seq);
+                }
+            }
+            assert(std::is_sorted(seen.begin(), seen.end()));
+            assert(std::adjacent_find(seen.begin(), seen.end()) == seen.end());
+            assert(seen.size() >= 600);
+        }
+    }
+    sqlite3_close(db);
+
+    // Equality and range plans stream through the vtab
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase fdb(SchemaParser::parse(schema, "streamed"), StorageOptions(), engine);
+        fdb.registerFileId("ITEM", "items");
+        fdb.setFieldExtractor("items", itemsExtractor);
+        ingestItems(fdb, 1, 3000);
+        fdb.markDeleted("items", 700);
+        fdb.markDeleted("items", 1200);
+
+        const char* queries[][2] = {
+            {"SELECT id FROM items WHERE qty = 3", "SELECT id FROM items WHERE qty + 0 = 3"},
+            {"SELECT id FROM items WHERE id > 500 ORDER BY id DESC",
+             "SELECT id FROM items WHERE id + 0 > 500 ORDER BY id + 0 DESC"},
+            {"SELECT id FROM items WHERE id BETWEEN 650 AND 1300",
+             "SELECT id FROM items WHERE id + 0 BETWEEN 650 AND 1300"},
+            {"SELECT COUNT(*) FROM items WHERE qty = NULL", "SELECT 0"},
+        };
+        for (const auto& query : queries) {
+            auto actual = fdb.query(query[0]);
+            auto expected = fdb.query(query[1]);
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+            }
+        }
+    }
+
+    std::cout << "Streaming index range cursor tests passed!" << std::endl;
+}
+
+void testOrderLimitPushdown() {
+    std::cout << "Testing ORDER BY / LIMIT pushdown..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "ordered"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 3000);
+        db.markDeleted("items", 2999);
+
+        auto sorts = [&db](const std::string& sql) {
+            auto plan = db.query("EXPLAIN QUERY PLAN " + sql);
+            for (const auto& row : plan.rows) {
+                if (std::get<std::string>(row[3]).find("TEMP B-TREE") != std::string::npos) return true;
+            }
+            return false;
+        };
+
+        // "Latest N": ordered index scan, stopped after LIMIT + OFFSET rows
+        const char* latest = "SELECT id FROM items ORDER BY id DESC LIMIT 3 OFFSET 1";
+        assert(!sorts(latest));
+        size_t calls = itemsExtractorCalls;
+        auto rows = db.query(latest);
+        assert(itemsExtractorCalls - calls < 20);
+        assert(rows.rows.size() == 3);
+        assert(rows.rows[0][0] == Value(int64_t(2998)));
+        assert(rows.rows[2][0] == Value(int64_t(2996)));
+
+        // Rowid order is the scan order; ranges return key order
+        assert(!sorts("SELECT id FROM items ORDER BY rowid"));
+        assert(!sorts("SELECT id FROM items WHERE qty > 4 ORDER BY qty DESC"));
+        // qty has NULLs the index doesn't hold, so an unbounded ORDER BY sorts
+        assert(sorts("SELECT id FROM items ORDER BY qty"));
+
+        const char* queries[][2] = {
+            {"SELECT id FROM items ORDER BY id DESC LIMIT 5",
+             "SELECT id FROM items ORDER BY id + 0 DESC LIMIT 5"},
+            {"SELECT id FROM items ORDER BY rowid LIMIT 4 OFFSET 2",
+             "SELECT id FROM items ORDER BY rowid + 0 LIMIT 4 OFFSET 2"},
+            {"SELECT id FROM items WHERE id > 2990 ORDER BY id DESC",
+             "SELECT id FROM items WHERE id + 0 > 2990 ORDER BY id + 0 DESC"},
+            {"SELECT qty, id FROM items WHERE qty >= 5 ORDER BY qty DESC LIMIT 20",
+             "SELECT qty, id FROM items WHERE qty + 0 >= 5 ORDER BY qty + 0 DESC, rowid DESC LIMIT 20"},
+            {"SELECT id FROM items WHERE qty = 2 ORDER BY id LIMIT 7",
+             "SELECT id FROM items WHERE qty + 0 = 2 ORDER BY id + 0 LIMIT 7"},
+            {"SELECT id FROM items WHERE id IN (9, 4, 7) ORDER BY id DESC",
+             "SELECT id FROM items WHERE id + 0 IN (9, 4, 7) ORDER BY id + 0 DESC"},
+            {"SELECT id FROM items LIMIT 0", "SELECT id FROM items WHERE 0"},
+        };
+        for (const auto& query : queries) {
+            auto actual = db.query(query[0]);
+            auto expected = db.query(query[1]);
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                for (size_t c = 0; c < actual.rows[r].size(); c++) {
+                    assert(compareValues(actual.rows[r][c], expected.rows[r][c]) == 0);
+                }
+            }
+        }
+    }
+
+    std::cout << "ORDER BY / LIMIT pushdown tests passed!" << std::endl;
+}
+
+void testScanPredicatePushdown() {
+    std::cout << "Testing full-scan predicate pushdown..." << std::endl;
+
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "plain"));
+    FlatSQLDatabase cached(SchemaParser::parse(ITEMS_SCHEMA, "cached"));
+    for (FlatSQLDatabase* db : {&plain, &cached}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", itemsExtractor);
+    }
+    cached.enableColumnCache("items", "score");
+    cached.enableColumnCache("items", "qty");
+    ingestItems(plain, 1, 3000);
+    ingestItems(cached, 1, 3000);
+    plain.markDeleted("items", 150);
+    cached.markDeleted("items", 150);
+
+    // Comparisons on cached columns are carried to xFilter in idxStr
+    auto plan = cached.query("EXPLAIN QUERY PLAN SELECT id FROM items WHERE qty = 3 AND score > 10");
+    assert(std::get<std::string>(plan.rows[0][3]).find("INDEX 0:") != std::string::npos);
+
+    const char* queries[] = {
+        "SELECT id FROM items WHERE score > 700",
+        "SELECT id FROM items WHERE score BETWEEN 10 AND 40.5",
+        "SELECT id FROM items WHERE score = 37",
+        "SELECT id FROM items WHERE qty = 3 AND score < 100",
+        "SELECT id FROM items WHERE qty < 2.5",
+        "SELECT id FROM items WHERE qty > 2.5 AND qty <= 4",
+        "SELECT id FROM items WHERE qty = 2.5",
+        "SELECT id FROM items WHERE qty >= -1 AND score <= 1.0",
+        "SELECT id FROM items WHERE qty > '3'",
+        "SELECT id FROM items WHERE qty = NULL",
+        "SELECT id FROM items WHERE qty = 6 AND name = 'item'",
+    };
+    for (const char* sql : queries) {
+        auto expected = plain.query(sql);
+        auto actual = cached.query(sql);
+        assert(expected.rowCount() == actual.rowCount());
+        for (size_t r = 0; r < expected.rowCount(); r++) {
+            assert(compareValues(expected.rows[r][0], actual.rows[r][0]) == 0);
+        }
+    }
+
+    // Bound parameters are converted per execution
+    auto low = cached.query("SELECT COUNT(*) FROM items WHERE score < ?", std::vector<Value>{int64_t(25)});
+    auto high = cached.query("SELECT COUNT(*) FROM items WHERE score < ?", std::vector<Value>{2.5});
+    assert(low.rows[0][0] == Value(int64_t(99)));
+    assert(high.rows[0][0] == Value(int64_t(9)));
+
+    std::cout << "Predicate pushdown tests passed!" << std::endl;
+}
+
+void testCompaction() {
+    std::cout << "Testing incremental compaction..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;
+    segmented.segmentSize = 4096;
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        for (const StorageOptions& options : {StorageOptions(), segmented}) {
+            FlatSQLDatabase db(SchemaParser::parse(schema, "compact"), options, engine);
+            db.registerFileId("ITEM", "items");
+            db.setFieldExtractor("items", itemsExtractor);
+            db.enableColumnCache("items", "score");
+            ingestItems(db, 1, 1000);
+            for (uint64_t sequence = 1; sequence <= 1000; sequence += 3) {
+                db.markDeleted("items", sequence);
+            }
+            assert(db.getDeletedCount("items") == 334);
+
+            // Slices interleave with ingest; later records are copied too
+            assert(!db.compactStep(1024));
+            assert(db.isCompacting());
+            ingestItems(db, 1001, 1100);
+            db.markDeleted("items", 2);     // Already copied: stays tombstoned
+            db.markDeleted("items", 1002);  // Not copied yet: dropped
+            while (!db.compactStep(1024)) {
+            }
+            assert(!db.isCompacting());
+
+            assert(db.getStorage().getRecordCount() == 765);
+            assert(db.getDeletedCount("items") == 1);
+            auto count = db.query("SELECT COUNT(*), SUM(score) FROM items");
+            assert(count.rows[0][0] == Value(int64_t(764)));
+
+            // Rowids are dense again and indexes point at the new records
+            auto last = db.query("SELECT rowid, id FROM items WHERE id = 1100");
+            assert(last.rows[0][0] == Value(int64_t(765)));
+            assert(db.query("SELECT id FROM items WHERE id = 1").rowCount() == 0);
+            assert(db.query("SELECT id FROM items WHERE id = 2").rowCount() == 0);
+            assert(db.query("SELECT id FROM items WHERE id = 1002").rowCount() == 0);
+            auto byQty = db.query("SELECT COUNT(*) FROM items WHERE qty = 3");
+            auto scanned = db.query("SELECT COUNT(*) FROM items WHERE qty + 0 = 3");
+            assert(byQty.rows[0][0] == scanned.rows[0][0]);
+            auto range = db.query("SELECT id FROM items WHERE id BETWEEN 10 AND 20");
+            assert(range.rowCount() == 7);  // 11, 12, 14, 15, 17, 18, 20
+            double expected = 0;
+            for (int32_t id = 1; id <= 1100; id++) {
+                if ((id <= 1000 && id % 3 == 1) || id == 2 || id == 1002) continue;
+                expected += id / 4.0;
+            }
+            assert(count.rows[0][1] == Value(expected));
+
+            // Ingest continues after the rewritten stream
+            ingestItems(db, 1101, 1101);
+            auto added = db.query("SELECT rowid FROM items WHERE id = 1101");
+            assert(added.rows[0][0] == Value(int64_t(766)));
+        }
+    }
+
+    std::cout << "Compaction tests passed!" << std::endl;
+}
+
+void testUnifiedVTab() {
+    std::cout << "Testing unified fan-out views..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;
+    FlatSQLDatabase db(SchemaParser::parse(schema, "unified"), segmented);
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    const char* sources[] = {"a", "b", "c"};
+    for (const char* source : sources) {
+        db.registerSource(source);
+    }
+    // Sources take turns in runs of ten, so sequences interleave
+    for (int32_t run = 0; run < 90; run++) {
+        std::vector<uint8_t> stream;
+        for (int32_t id = run * 10 + 1; id <= run * 10 + 10; id++) {
+            uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+            std::memcpy(record + 12, &id, sizeof(id));
+            stream.insert(stream.end(), record, record + sizeof(record));
+        }
+        db.ingestWithSource(stream.data(), stream.size(), sources[run % 3]);
+    }
+    db.createUnifiedViews();
+    db.markDeleted("items@b", 885);  // id 885, run 88
+
+    auto sorts = [&db](const std::string& sql) {
+        auto plan = db.query("EXPLAIN QUERY PLAN " + sql);
+        for (const auto& row : plan.rows) {
+            if (std::get<std::string>(row[3]).find("TEMP B-TREE") != std::string::npos) return true;
+        }
+        return false;
+    };
+
+    assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(899)));
+    assert(db.query("SELECT * FROM items").rowCount() == 899);
+
+    // _source picks members before any is scanned
+    size_t calls = itemsExtractorCalls;
+    auto one = db.query("SELECT COUNT(*), SUM(score) FROM items WHERE _source = 'items@b'");
+    assert(one.rows[0][0] == Value(int64_t(299)));
+    size_t unionCalls = itemsExtractorCalls - calls;
+    calls = itemsExtractorCalls;
+    db.query("SELECT COUNT(*), SUM(score) FROM \"items@b\"");
+    assert(unionCalls == itemsExtractorCalls - calls);
+    auto two = db.query("SELECT COUNT(*) FROM items WHERE _source IN ('items@a', 'items@c', 'x')");
+    assert(two.rows[0][0] == Value(int64_t(600)));
+    assert(db.query("SELECT COUNT(*) FROM items WHERE _source = 'x'").rows[0][0] == Value(int64_t(0)));
+
+    // Index-ordered member streams are merged, so LIMIT stops early
+    const char* latest = "SELECT id, _source FROM items ORDER BY id DESC LIMIT 3";
+    assert(!sorts(latest));
+    assert(!sorts("SELECT id FROM items WHERE qty = 2 ORDER BY rowid"));
+    calls = itemsExtractorCalls;
+    auto rows = db.query(latest);
+    assert(itemsExtractorCalls - calls < 30);
+    assert(rows.rows.size() == 3);
+    assert(rows.rows[0][0] == Value(int64_t(900)));
+    assert(rows.rows[1][0] == Value(int64_t(899)));
+    assert(rows.rows[1][1] == Value(std::string("items@c")));
+
+    const std::string all =
+        "(SELECT rowid AS r, * FROM \"items@a\" UNION ALL SELECT rowid, * FROM \"items@b\" "
+        "UNION ALL SELECT rowid, * FROM \"items@c\")";
+    std::string queries[][2] = {
+        {"SELECT id FROM items ORDER BY id LIMIT 25 OFFSET 5",
+         "SELECT id FROM " + all + " ORDER BY id LIMIT 25 OFFSET 5"},
+        {"SELECT rowid, id FROM items ORDER BY rowid DESC LIMIT 15",
+         "SELECT r, id FROM " + all + " ORDER BY r DESC LIMIT 15"},
+        {"SELECT id FROM items WHERE id BETWEEN 95 AND 215 ORDER BY id DESC",
+         "SELECT id FROM " + all + " WHERE id BETWEEN 95 AND 215 ORDER BY id DESC"},
+        {"SELECT qty FROM items WHERE qty >= 5 ORDER BY qty DESC LIMIT 140",
+         "SELECT qty FROM " + all + " WHERE qty >= 5 ORDER BY qty DESC LIMIT 140"},
+        {"SELECT id FROM items WHERE id IN (300, 7, 885, 12) ORDER BY id",
+         "SELECT id FROM " + all + " WHERE id IN (300, 7, 885, 12) ORDER BY id"},
+        {"SELECT id FROM items WHERE _source <> 'items@a' AND score < 10 ORDER BY id",
+         "SELECT id FROM " + all + " WHERE _source <> 'items@a' AND score < 10 ORDER BY id"},
+    };
+    for (const auto& query : queries) {
+        auto actual = db.query(query[0]);
+        auto expected = db.query(query[1]);
+        assert(actual.rows.size() == expected.rows.size());
+        for (size_t r = 0; r < actual.rows.size(); r++) {
+            for (size_t c = 0; c < actual.rows[r].size(); c++) {
+                assert(compareValues(actual.rows[r][c], expected.rows[r][c]) == 0);
+            }
+        }
+    }
+
+    // Read sessions get the same view over the shared sources
+    auto session = db.openReadSession();
+    assert(session->query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(899)));
+    auto max = session->query("SELECT id FROM items WHERE _source = 'items@b' ORDER BY id DESC LIMIT 1");
+    assert(max.rows[0][0] == Value(int64_t(890)));
+
+    std::cout << "Unified view tests passed!" << std::endl;
+}
+
+void testParallelAggregate() {
+    std::cout << "Testing parallel aggregate scans..." << std::endl;
+
+    using Op = AggregateSpec::Op;
+    std::vector<AggregateSpec> specs = {
+        {Op::Count, ""}, {Op::Count, "qty"}, {Op::Sum, "id"}, {Op::Sum, "score"},
+        {Op::Min, "score"}, {Op::Max, "id"}, {Op::Avg, "qty"},
+    };
+    const char* sql = "SELECT qty, COUNT(*), COUNT(qty), SUM(id), SUM(score), MIN(score), MAX(id), AVG(qty) "
+                      "FROM items GROUP BY qty";
+    auto sameResult = [](const QueryResult& actual, const QueryResult& expected) {
+        assert(actual.rowCount() == expected.rowCount());
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            assert(actual.rows[r].size() == expected.rows[r].size());
+            for (size_t c = 0; c < actual.rows[r].size(); c++) {
+                const Value& a = actual.rows[r][c];
+                const Value& e = expected.rows[r][c];
+                if (std::holds_alternative<double>(e)) {
+                    assert(std::abs(std::get<double>(a) - std::get<double>(e)) < 1e-9);
+                } else {
+                    assert(compareValues(a, e) == 0);
+                }
+            }
+        }
+    };
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "aggregate"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    db.enableColumnCache("items", "score");
+    db.setScanThreads(4);
+    ingestItems(db, 1, 50000);
+    for (uint64_t sequence = 5; sequence <= 50000; sequence += 97) {
+        db.markDeleted("items", sequence);
+    }
+
+    auto grouped = db.aggregate("items", specs, "qty");
+    assert(grouped.columns[0] == "qty" && grouped.columns[3] == "SUM(id)");
+    assert(grouped.rowCount() == 8);  // NULL, then 0..6
+    assert(std::holds_alternative<std::monostate>(grouped.rows[0][0]));
+    sameResult(grouped, db.query(sql));
+
+    auto total = db.aggregate("items", {{Op::Count, ""}, {Op::Sum, "score"}});
+    sameResult(total, db.query("SELECT COUNT(*), SUM(score) FROM items"));
+
+    // Same result inline
+    db.setScanThreads(1);
+    sameResult(db.aggregate("items", specs, "qty"), grouped);
+
+    bool threw = false;
+    try {
+        db.aggregate("items", {{Op::Sum, "name"}});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // A unified view aggregates each source and merges them
+    FlatSQLDatabase multi(SchemaParser::parse(ITEMS_SCHEMA, "aggregate_multi"));
+    multi.registerFileId("ITEM", "items");
+    multi.setFieldExtractor("items", itemsExtractor);
+    multi.setScanThreads(0);
+    multi.registerSource("north");
+    multi.registerSource("south");
+    for (int32_t run = 0; run < 6; run++) {
+        std::vector<uint8_t> stream;
+        for (int32_t id = run * 5000 + 1; id <= run * 5000 + 5000; id++) {
+            uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+            std::memcpy(record + 12, &id, sizeof(id));
+            stream.insert(stream.end(), record, record + sizeof(record));
+        }
+        multi.ingestWithSource(stream.data(), stream.size(), run % 2 ? "south" : "north");
+    }
+    multi.createUnifiedViews();
+    multi.markDeleted("items@south", 5001);
+    sameResult(multi.aggregate("items", specs, "qty"), multi.query(sql));
+    auto north = multi.aggregate("items@north", {{Op::Count, ""}, {Op::Max, "id"}});
+    assert(north.rows[0][0] == Value(int64_t(15000)));
+    assert(north.rows[0][1] == Value(int64_t(25000)));
+
+    std::cout << "Parallel aggregate tests passed!" << std::endl;
+}
+
+void testResultBuffer() {
+    std::cout << "Testing columnar result buffer..." << std::endl;
+
+    QueryResult result;
+    result.columns = {"id", "score", "name", "blob", "flag", "mixed", "empty"};
+    result.rows = {
+        {int64_t(1), 1.5, std::string("a"), std::vector<uint8_t>{1, 2}, true, int64_t(7), std::monostate{}},
+        {int32_t(2), std::monostate{}, std::string("bcd"), std::vector<uint8_t>{}, false, std::string("x"), std::monostate{}},
+        {std::monostate{}, int64_t(3), std::string(""), std::vector<uint8_t>{9}, true, 2.5, std::monostate{}},
+    };
+
+    std::vector<uint8_t> buffer;
+    encodeResultBuffer(result, buffer);
+    assert(buffer.size() % 8 == 0);
+
+    auto u32 = [&](size_t offset) {
+        uint32_t v;
+        std::memcpy(&v, buffer.data() + offset, sizeof(v));
+        return v;
+    };
+    assert(u32(0) == RESULT_BUFFER_MAGIC);
+    assert(u32(4) == RESULT_BUFFER_VERSION);
+    assert(u32(8) == 7 && u32(12) == 3);
+
+    std::vector<ResultBufferColumn> dir(7);
+    std::memcpy(dir.data(), buffer.data() + RESULT_BUFFER_HEADER_SIZE, 7 * sizeof(ResultBufferColumn));
+    for (size_t c = 0; c < dir.size(); c++) {
+        assert(std::string(reinterpret_cast<const char*>(buffer.data() + dir[c].nameOffset),
+                           dir[c].nameLength) == result.columns[c]);
+        assert(dir[c].valuesOffset % 8 == 0 && dir[c].offsetsOffset % 8 == 0);
+    }
+
+    // id: int64 with one null
+    assert(dir[0].type == uint32_t(ResultCellType::Int64) && dir[0].nullCount == 1);
+    int64_t ids[3];
+    std::memcpy(ids, buffer.data() + dir[0].valuesOffset, sizeof(ids));
+    assert(ids[0] == 1 && ids[1] == 2 && ids[2] == 0);
+    assert(buffer[dir[0].validityOffset] == 0x3);
+
+    // score: integer and real rows widen to float64
+    assert(dir[1].type == uint32_t(ResultCellType::Float64));
+    double scores[3];
+    std::memcpy(scores, buffer.data() + dir[1].valuesOffset, sizeof(scores));
+    assert(scores[0] == 1.5 && scores[2] == 3.0);
+
+    // name: offsets into UTF-8 data
+    assert(dir[2].type == uint32_t(ResultCellType::String) && dir[2].nullCount == 0);
+    assert(dir[2].validityOffset == 0);
+    assert(u32(dir[2].offsetsOffset + 4) == 1 && u32(dir[2].offsetsOffset + 8) == 4 &&
+           u32(dir[2].offsetsOffset + 12) == 4);
+    assert(std::memcmp(buffer.data() + dir[2].dataOffset, "abcd", 4) == 0);
+
+    assert(dir[3].type == uint32_t(ResultCellType::Bytes));
+    assert(u32(dir[3].offsetsOffset + 12) == 3);
+    assert(buffer[dir[3].dataOffset + 2] == 9);
+
+    assert(dir[4].type == uint32_t(ResultCellType::Bool));
+    assert(buffer[dir[4].valuesOffset] == 1 && buffer[dir[4].valuesOffset + 1] == 0);
+
+    // mixed: per-row tags, numbers stored as 8 bytes in the data section
+    assert(dir[5].type == uint32_t(ResultCellType::Mixed));
+    assert(buffer[dir[5].valuesOffset] == uint8_t(ResultCellType::Int64));
+    assert(buffer[dir[5].valuesOffset + 1] == uint8_t(ResultCellType::String));
+    assert(buffer[dir[5].valuesOffset + 2] == uint8_t(ResultCellType::Float64));
+    assert(u32(dir[5].offsetsOffset + 4) == 8 && u32(dir[5].offsetsOffset + 8) == 9);
+    double mixedReal;
+    std::memcpy(&mixedReal, buffer.data() + dir[5].dataOffset + 9, sizeof(mixedReal));
+    assert(mixedReal == 2.5);
+
+    assert(dir[6].type == uint32_t(ResultCellType::Null) && dir[6].nullCount == 3);
+
+    // Empty results still carry the column directory
+    QueryResult none;
+    none.columns = {"a"};
+    encodeResultBuffer(none, buffer);
+    assert(u32(8) == 1 && u32(12) == 0);
+
+    std::cout << "Result buffer tests passed!" << std::endl;
+}
+
+void testQueryCursor() {
+    std::cout << "Testing streaming query cursors..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "cursor_test"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 2000);
+
+    // Row by row matches the materialized result
+    const char* sql = "SELECT id, score, name FROM items WHERE qty = 3";
+    auto expected = db.query(sql);
+    auto cursor = db.openCursor(sql);
+    assert(cursor->columnCount() == 3);
+    assert(std::string(cursor->columnName(1)) == "score");
+    size_t rows = 0;
+    while (cursor->step()) {
+        assert(cursor->columnType(0) == SQLITE_INTEGER);
+        assert(cursor->getInt64(0) == std::get<int64_t>(expected.rows[rows][0]));
+        assert(cursor->getDouble(1) == std::get<double>(expected.rows[rows][1]));
+        assert(std::string(cursor->getText(2), cursor->getBytes(2)) == "item");
+        rows++;
+    }
+    assert(rows == expected.rowCount());
+    assert(cursor->done() && !cursor->step());
+
+    // Batches, with ingest and other queries in between, keep the
+    // snapshot taken by the first step
+    auto batched = db.openCursor("SELECT id FROM items WHERE id > ?", {Value(int64_t(100))});
+    QueryResult batch;
+    assert(batched->fetch(500, batch) == 500);
+    ingestItems(db, 2001, 2500);
+    assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(2500)));
+    size_t total = batch.rowCount();
+    while (true) {
+        batch.rows.clear();
+        size_t added = batched->fetch(500, batch);
+        total += added;
+        if (added < 500) break;
+    }
+    assert(batch.columns.size() == 1 && batch.columns[0] == "id");
+    assert(total == 1900);
+
+    bool threw = false;
+    try {
+        db.openCursor("SELECT nope FROM items");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Query cursor tests passed!" << std::endl;
+}
+
+// Size-prefixed FlatBuffer for the gadgets table in testSchemaExtractor,
+// laid out by hand: vtable (7 fields, union at slots 4-5), then the table
+static std::vector<uint8_t> buildGadget(int32_t id, const char* name, const double* weight,
+                                        int8_t color, const std::vector<uint8_t>& tags) {
+    std::vector<uint8_t> buf(4 + 4);  // root offset, file ID
+    std::memcpy(buf.data() + 4, "GDGT", 4);
+    auto put = [&buf](size_t at, const void* p, size_t n) {
+        if (buf.size() < at + n) buf.resize(at + n, 0);
+        std::memcpy(buf.data() + at, p, n);
+    };
+    auto put16 = [&put](size_t at, uint16_t v) { put(at, &v, 2); };
+    auto put32 = [&put](size_t at, uint32_t v) { put(at, &v, 4); };
+
+    const size_t vtable = 8, table = 28;
+    put16(vtable, 20);        // vtable size: 4 + 2 * 8 slots
+    put16(vtable + 2, 28);    // table size
+    put16(vtable + 4, 4);     // id
+    put16(vtable + 6, name ? 16 : 0);
+    put16(vtable + 8, weight ? 8 : 0);
+    put16(vtable + 10, 20);   // color; slots 4-5 (union) and 7 (rank) absent
+    put16(vtable + 16, 24);   // tags
+    put32(0, table);
+    int32_t soffset = int32_t(table - vtable);
+    put(table, &soffset, 4);
+    put(table + 4, &id, 4);
+    if (weight) put(table + 8, weight, 8);
+    put(table + 20, &color, 1);
+
+    size_t end = table + 28;
+    if (name) {
+        put32(table + 16, uint32_t(end - (table + 16)));
+        put32(end, uint32_t(std::strlen(name)));
+        put(end + 4, name, std::strlen(name) + 1);
+        end = (buf.size() + 3) & ~size_t(3);
+    }
+    put32(table + 24, uint32_t(end - (table + 24)));
+    put32(end, uint32_t(tags.size()));
+    if (!tags.empty()) put(end + 4, tags.data(), tags.size());
+    buf.resize(end + 4 + tags.size());
+
+    std::vector<uint8_t> record(4);
+    uint32_t size = static_cast<uint32_t>(buf.size());
+    std::memcpy(record.data(), &size, 4);
+    record.insert(record.end(), buf.begin(), buf.end());
+    return record;
+}
+
+void testSchemaExtractor() {
+    std::cout << "Testing schema-generated extractors..." << std::endl;
+
+    const char* schema = R"(
+        enum Color : byte { Red, Green, Blue }
+        union Payload { Gadget }
+        table gadgets {
+            id: int (id);
+            name: string (key);
+            weight: double = 1.5;
+            color: Color;
+            payload: Payload;
+            tags: [ubyte];
+            rank: short = 7;
+        }
+    )";
+
+    DatabaseSchema parsed = SchemaParser::parseIDL(schema);
+    const TableDef& def = parsed.tables[0];
+    assert(def.columns[3].type == ValueType::Int8 && def.columns[3].layoutKnown);
+    assert(!def.columns[4].layoutKnown && def.columns[4].fieldId == 5);
+    assert(def.columns[5].fieldId == 6 && def.columns[6].fieldId == 7);
+    assert(def.columns[2].defaultValue == Value(1.5));
+
+    // No extractor set: fromSchema generates one from the IDL
+    FlatSQLDatabase db = FlatSQLDatabase::fromSchema(schema, "gadgets");
+    db.registerFileId("GDGT", "gadgets");
+    double heavy = 9.25;
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 100; id++) {
+        std::string name = "gadget" + std::to_string(id);
+        auto record = buildGadget(id, id % 10 == 0 ? nullptr : name.c_str(),
+                                  id % 2 ? &heavy : nullptr, int8_t(id % 3), {uint8_t(id), 2, 3});
+        stream.insert(stream.end(), record.begin(), record.end());
+    }
+    db.ingest(stream.data(), stream.size());
+
+    auto row = db.query("SELECT id, name, weight, color, payload, tags, rank FROM gadgets WHERE id = 4");
+    assert(row.rowCount() == 1);
+    assert(row.rows[0][0] == Value(int64_t(4)));
+    assert(row.rows[0][1] == Value(std::string("gadget4")));
+    assert(row.rows[0][2] == Value(1.5));             // Absent: schema default
+    assert(row.rows[0][3] == Value(int64_t(1)));
+    assert(std::holds_alternative<std::monostate>(row.rows[0][4]));
+    assert(row.rows[0][5] == Value(std::vector<uint8_t>{4, 2, 3}));
+    assert(row.rows[0][6] == Value(int64_t(7)));
+
+    // Indexes were built from the generated extractor
+    auto byName = db.query("SELECT id FROM gadgets WHERE name = 'gadget77'");
+    assert(byName.rowCount() == 1 && byName.rows[0][0] == Value(int64_t(77)));
+    auto nullNames = db.query("SELECT COUNT(*) FROM gadgets WHERE name IS NULL");
+    assert(nullNames.rows[0][0] == Value(int64_t(10)));
+    auto sums = db.query("SELECT SUM(weight), SUM(color) FROM gadgets");
+    assert(sums.rows[0][0] == Value(50 * 9.25 + 50 * 1.5));
+    assert(sums.rows[0][1] == Value(int64_t(100)));
+
+    // Truncated records read as NULL rather than past the buffer
+    SchemaExtractor extractor(def);
+    auto record = buildGadget(5, "x", &heavy, 2, {});
+    assert(extractor.extract(record.data() + 4, record.size() - 4, 1) == Value(std::string("x")));
+    assert(std::holds_alternative<std::monostate>(extractor.extract(record.data() + 4, 30, "name")));
+    assert(std::holds_alternative<std::monostate>(extractor.extract(record.data() + 4, 6, 0)));
+
+    // A user extractor replaces the generated one
+    FlatSQLDatabase custom = FlatSQLDatabase::fromSchema(schema, "custom");
+    custom.registerFileId("GDGT", "gadgets");
+    custom.setFieldExtractor("gadgets", [](const uint8_t*, size_t, const std::string& field) -> Value {
+        return field == "id" ? Value(int32_t(42)) : Value(std::monostate{});
+    });
+    auto first = buildGadget(1, "a", nullptr, 0, {});
+    custom.ingestOne(first.data() + 4, first.size() - 4);
+    auto customRow = custom.query("SELECT id, name FROM gadgets");
+    assert(customRow.rows[0][0] == Value(int64_t(42)));
+    assert(std::holds_alternative<std::monostate>(customRow.rows[0][1]));
+
+    std::cout << "Schema extractor tests passed!" << std::endl;
+}
+
+void testConcurrentReaders() {
+    std::cout << "Testing concurrent read sessions during ingest..." << std::endl;
+
+    std::string schema = R"(
+        table items {
+            id: int (id);
+        }
+    )";
+
+    // Contiguous storage relocates on growth, so it cannot serve readers
+    {
+        FlatSQLDatabase contiguous(SchemaParser::parse(schema, "contiguous"));
+        bool threw = false;
+        try {
+            contiguous.openReadSession();
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        StorageOptions options;
+        options.mode = StorageMode::Segmented;
+        options.segmentSize = 4096;
+        FlatSQLDatabase db(SchemaParser::parse(schema, "concurrent"), options, engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+            if (field != "id" || length < 12) return std::monostate{};
+            int32_t id;
+            std::memcpy(&id, data + 8, sizeof(id));
+            return id;
+        });
+        auto session = db.openReadSession();
+        assert(session->query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(0)));
+
+        constexpr int32_t CHUNK = 50;
+        constexpr int32_t CHUNKS = 200;
+        std::atomic<bool> done{false};
+        std::thread writer([&]() {
+            std::vector<uint8_t> chunk;
+            for (int32_t c = 0; c < CHUNKS; c++) {
+                chunk.clear();
+                for (int32_t i = 0; i < CHUNK; i++) {
+                    int32_t id = c * CHUNK + i + 1;
+                    uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+                    std::memcpy(record + 12, &id, sizeof(id));
+                    chunk.insert(chunk.end(), record, record + sizeof(record));
+                }
+                db.ingest(chunk.data(), chunk.size());
+            }
+            done = true;
+        });
+
+        // Each statement sees whole ingest chunks, and the count never goes back
+        int64_t lastCount = 0;
+        bool finished = false;
+        while (!finished) {
+            finished = done;
+            int64_t count = std::get<int64_t>(session->query("SELECT COUNT(*) FROM items").rows[0][0]);
+            assert(count >= lastCount);
+            assert(count % CHUNK == 0);
+            lastCount = count;
+            if (count > 0) {
+                auto last = session->query("SELECT id FROM items WHERE id = ?", {Value(int32_t(count))});
+                assert(last.rowCount() == 1);
+                auto seen = session->query("SELECT COUNT(*) FROM items WHERE id <= ?", {Value(int32_t(count))});
+                assert(std::get<int64_t>(seen.rows[0][0]) == count);
+            }
+        }
+        writer.join();
+        assert(lastCount == CHUNK * CHUNKS);
+        assert(session->query("SELECT * FROM items WHERE id = 1").rowCount() == 1);
+    }
+
+    std::cout << "Concurrent read session tests passed!" << std::endl;
+}
+
+// Places spread over the globe: lat / lon derived from the id, which sits
+// after the "PLAC" file ID
+static const char* PLACES_SCHEMA = R"(
+    table places {
+        id: int (id);
+        lat: double (geo: "lon");
+        lon: double;
+    }
+)";
+static std::atomic<size_t> placesExtractorCalls{0};
+
+static Value placesExtractor(const uint8_t* data, size_t length, const std::string& field) {
+    placesExtractorCalls++;
+    if (length < 12) return std::monostate{};
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    if (field == "id") return id;
+    if (field == "lat") return (id * 37 % 1800) / 10.0 - 90.0;
+    if (field == "lon") return id % 50 == 0 ? Value(std::monostate{}) : Value((id * 101 % 3600) / 10.0 - 180.0);
+    return std::monostate{};
+}
+
+void testGeoIndex() {
+    std::cout << "Testing spatial index..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(PLACES_SCHEMA, "geo"));
+    assert(db.getSchema().tables[0].geoLatColumn == "lat");
+    assert(db.getSchema().tables[0].geoLonColumn == "lon");
+    db.registerFileId("PLAC", "places");
+    db.setFieldExtractor("places", placesExtractor);
+
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 20000; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'P', 'L', 'A', 'C'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    db.ingest(stream.data(), stream.size());
+    db.markDeleted("places", 7);
+
+    auto sameIds = [&](const std::string& indexed, const std::string& scanned) {
+        auto expected = db.query("SELECT id FROM places WHERE " + scanned + " ORDER BY id");
+        placesExtractorCalls = 0;
+        auto actual = db.query("SELECT id FROM places WHERE " + indexed + " ORDER BY id");
+        assert(actual.rowCount() == expected.rowCount());
+        assert(actual.rowCount() > 0);
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+        }
+        // Only the candidate cells are read, not all 20000 records
+        assert(placesExtractorCalls < 20000 / 4);
+    };
+
+    sameIds("geo_within(_geo, geo_radius(40.0, -74.0, 800))",
+            "geo_within_radius(40.0, -74.0, lat, lon, 800)");
+    sameIds("geo_within(_geo, geo_box(10.0, 25.0, -30.0, 5.0))",
+            "geo_bbox_contains(10.0, 25.0, -30.0, 5.0, lat, lon)");
+
+    // Circles across the antimeridian and around a pole
+    sameIds("geo_within(_geo, geo_radius(5.0, 179.5, 900))",
+            "geo_within_radius(5.0, 179.5, lat, lon, 900)");
+    sameIds("geo_within(_geo, geo_radius(89.0, 0.0, 300))",
+            "geo_within_radius(89.0, 0.0, lat, lon, 300)");
+
+    auto plan = db.query("EXPLAIN QUERY PLAN SELECT id FROM places "
+                         "WHERE geo_within(_geo, geo_radius(40.0, -74.0, 800))");
+    assert(std::get<std::string>(plan.rows[0][3]).find("INDEX 6") != std::string::npos);
+
+    // _geo is hidden and NULL without a longitude
+    auto all = db.query("SELECT * FROM places LIMIT 1");
+    assert(std::find(all.columns.begin(), all.columns.end(), "_geo") == all.columns.end());
+    auto missing = db.query("SELECT _geo IS NULL FROM places WHERE id = 50");
+    assert(compareValues(missing.rows[0][0], Value(int64_t(1))) == 0);
+
+    // Schema errors surface when the table is built
+    bool threw = false;
+    try {
+        FlatSQLDatabase bad(SchemaParser::parse(R"(
+            table places { lat: double (geo: "longitude"); lon: double; }
+        )", "geo_bad"));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Spatial index tests passed!" << std::endl;
+}
+
+void testGeoBatchScan() {
+    std::cout << "Testing batched geo predicates on full scans..." << std::endl;
+
+    // The batch kernel keeps every point contains() keeps
+    std::vector<GeoRegion> regions(3);
+    uint8_t radius[25] = {'R'}, wrapped[25] = {'R'}, box[33] = {'B'};
+    double radiusArgs[3] = {40.0, -74.0, 2500.0}, wrappedArgs[3] = {-20.0, 178.0, 1500.0};
+    double boxArgs[4] = {-30.0, 45.0, -100.0, 60.0};
+    std::memcpy(radius + 1, radiusArgs, sizeof(radiusArgs));
+    std::memcpy(wrapped + 1, wrappedArgs, sizeof(wrappedArgs));
+    std::memcpy(box + 1, boxArgs, sizeof(boxArgs));
+    assert(GeoRegion::decode(radius, sizeof(radius), regions[0]));
+    assert(GeoRegion::decode(wrapped, sizeof(wrapped), regions[1]));
+    assert(GeoRegion::decode(box, sizeof(box), regions[2]));
+    double lat[64], lon[64];
+    for (const GeoRegion& region : regions) {
+        for (int round = 0; round < 50; round++) {
+            for (int i = 0; i < 64; i++) {
+                lat[i] = ((round * 64 + i) * 37 % 1800) / 10.0 - 90.0;
+                lon[i] = ((round * 64 + i) * 101 % 3600) / 10.0 - 180.0;
+            }
+            lat[5] = NAN;
+            uint64_t mask = region.matchBatch(lat, lon, 64);
+            for (int i = 0; i < 64; i++) {
+                assert(((mask >> i) & 1) == (region.contains(lat[i], lon[i]) ? 1u : 0u));
+            }
+        }
+    }
+
+    // Regions too big for the spatial index to pay off are checked against
+    // the cached coordinates in a full scan, so most rows are never decoded
+    FlatSQLDatabase db(SchemaParser::parse(PLACES_SCHEMA, "geo_scan"));
+    db.registerFileId("PLAC", "places");
+    db.setFieldExtractor("places", placesExtractor);
+    db.enableColumnCache("places", "lat");
+    db.enableColumnCache("places", "lon");
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 20000; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'P', 'L', 'A', 'C'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    db.ingest(stream.data(), stream.size());
+    db.markDeleted("places", 11);
+
+    const char* indexed[] = {
+        "geo_within(_geo, geo_box(-60.0, 60.0, -150.0, 150.0))",
+        "geo_within(_geo, geo_radius(0.0, 180.0, 9000))",
+    };
+    const char* scanned[] = {
+        "geo_bbox_contains(-60.0, 60.0, -150.0, 150.0, lat, lon)",
+        "geo_within_radius(0.0, 180.0, lat, lon, 9000)",
+    };
+    for (int q = 0; q < 2; q++) {
+        auto expected = db.query("SELECT id FROM places WHERE " + std::string(scanned[q]) + " ORDER BY id");
+        placesExtractorCalls = 0;
+        auto actual = db.query("SELECT id FROM places WHERE " + std::string(indexed[q]) + " ORDER BY id");
+        assert(actual.rowCount() == expected.rowCount());
+        assert(actual.rowCount() > 1000 && actual.rowCount() < 20000);
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+        }
+        // Only matching rows are decoded
+        assert(placesExtractorCalls <= 3 * actual.rowCount());
+    }
+
+    std::cout << "Batched geo predicate tests passed!" << std::endl;
+}
+
+void testZoneMaps() {
+    std::cout << "Testing zone maps..." << std::endl;
+
+    // score = id / 4 rises with arrival order, qty cycles
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "zones_plain"));
+    FlatSQLDatabase zoned(SchemaParser::parse(ITEMS_SCHEMA, "zones"));
+    for (FlatSQLDatabase* db : {&plain, &zoned}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", itemsExtractor);
+        ingestItems(*db, 1, 30000);
+    }
+    zoned.enableZoneMap("items", "score");  // Backfills the first 30000
+    zoned.enableZoneMap("items", "qty");
+    for (FlatSQLDatabase* db : {&plain, &zoned}) {
+        ingestItems(*db, 30001, 50000);
+        for (uint64_t sequence = 3; sequence <= 50000; sequence += 101) {
+            db->markDeleted("items", sequence);
+        }
+    }
+
+    ZoneMap zones(ValueType::Float64);
+    for (int32_t id = 1; id <= 50000; id++) {
+        zones.append(id % 10 == 0 ? Value(std::monostate{}) : Value(id / 4.0));
+    }
+    assert(zones.zones() == 50000 / ZoneMap::ZONE_ROWS);
+    ColumnCache::Comparison high;
+    assert(ColumnCache::makeComparison(true, ColumnCache::CompareOp::Gt, Value(11000.0), high));
+    assert(!zones.mayMatch(0, high) && zones.mayMatch(10, high));
+    assert(zones.mayMatch(zones.zones(), high));  // Open zone
+
+    const char* predicates[] = {
+        "score >= 10000 AND score < 10500",
+        "score = 123.25",
+        "score > 12400",
+        "score < 100 AND qty = 3",
+        "score > 20000",
+        "qty > 6",
+    };
+    for (const char* predicate : predicates) {
+        // Full scans return rows in arrival order
+        std::string sql = std::string("SELECT id, qty FROM items WHERE ") + predicate;
+        auto expected = plain.query(sql);
+        itemsExtractorCalls = 0;
+        auto actual = zoned.query(sql);
+        assert(actual.rowCount() == expected.rowCount());
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+        }
+        // Only zones that may match are decoded (qty > 6 rules out every one)
+        if (std::string(predicate).find("score") == 0 || std::string(predicate) == "qty > 6") {
+            assert(itemsExtractorCalls < 50000);
+        }
+    }
+
+    // Compaction rebuilds the zones over the surviving rows
+    zoned.compact();
+    plain.compact();
+    auto expected = plain.query("SELECT COUNT(*) FROM items WHERE score >= 10000 AND score < 10500");
+    auto actual = zoned.query("SELECT COUNT(*) FROM items WHERE score >= 10000 AND score < 10500");
+    assert(compareValues(actual.rows[0][0], expected.rows[0][0]) == 0);
+
+    std::cout << "Zone map tests passed!" << std::endl;
+}
+
+void testBloomFilters() {
+    std::cout << "Testing zone Bloom filters..." << std::endl;
+
+    ZoneBloomFilter filter;
+    for (int i = 0; i < 3 * static_cast<int>(ZoneMap::ZONE_ROWS); i++) {
+        filter.append(i % 3 == 0 ? Value(std::monostate{}) : Value("key-" + std::to_string(i)));
+    }
+    assert(filter.zones() == 3);
+    uint64_t present = ZoneBloomFilter::hash("key-5000", 8);
+    assert(!filter.mayContain(0, present) || !filter.mayContain(2, present));
+    assert(filter.mayContain(1, present));
+    assert(filter.mayContain(3, present));  // Open zone
+    size_t falsePositives = 0;
+    for (int i = 0; i < 1000; i++) {
+        std::string absent = "absent-" + std::to_string(i);
+        falsePositives += filter.mayContain(0, ZoneBloomFilter::hash(absent.data(), absent.size()));
+    }
+    assert(falsePositives < 60);
+
+    // Names are unique per item here, like an identifier nobody indexes
+    auto extractor = [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+        Value value = itemsExtractor(data, length, field);
+        if (field == "name" && !std::holds_alternative<std::monostate>(value)) {
+            int32_t id;
+            std::memcpy(&id, data + 8, sizeof(id));
+            return "item-" + std::to_string(id);
+        }
+        return value;
+    };
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "bloom_plain"));
+    FlatSQLDatabase filtered(SchemaParser::parse(ITEMS_SCHEMA, "bloom"));
+    for (FlatSQLDatabase* db : {&plain, &filtered}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", extractor);
+        ingestItems(*db, 1, 30000);
+    }
+    filtered.enableBloomFilter("items", "name");  // Backfills the first 30000
+    for (FlatSQLDatabase* db : {&plain, &filtered}) {
+        ingestItems(*db, 30001, 50000);
+        db->markDeleted("items", 20001);
+    }
+
+    bool threw = false;
+    try {
+        filtered.enableBloomFilter("items", "score");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    const char* predicates[] = {
+        "name = 'item-12345'",
+        "name = 'item-20001'",
+        "name = 'item-49999'",
+        "name = 'missing'",
+        "name = 'item-777' AND qty = 0",
+        "name IN ('item-5', 'item-40000')",
+        "name = 'ITEM-12345' COLLATE NOCASE",
+    };
+    for (const char* predicate : predicates) {
+        std::string sql = std::string("SELECT id FROM items WHERE ") + predicate;
+        auto expected = plain.query(sql);
+        itemsExtractorCalls = 0;
+        auto actual = filtered.query(sql);
+        // IN lists run one probe per value, in no particular order
+        auto byId = [](const std::vector<Value>& x, const std::vector<Value>& y) {
+            return compareValues(x[0], y[0]) < 0;
+        };
+        std::sort(expected.rows.begin(), expected.rows.end(), byId);
+        std::sort(actual.rows.begin(), actual.rows.end(), byId);
+        assert(actual.rowCount() == expected.rowCount());
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+        }
+        // An equality decodes a few zones at most, the open one included
+        // (rows are decoded whole: four fields each)
+        if (std::string(predicate).find(" = 'i") != std::string::npos ||
+            std::string(predicate) == "name = 'missing'") {
+            assert(itemsExtractorCalls < 4 * 5 * ZoneMap::ZONE_ROWS);
+        }
+    }
+
+    // Compaction rebuilds the filters over the surviving rows
+    filtered.compact();
+    itemsExtractorCalls = 0;
+    auto found = filtered.query("SELECT id FROM items WHERE name = 'item-33333'");
+    assert(found.rowCount() == 1 && compareValues(found.rows[0][0], Value(int64_t(33333))) == 0);
+    assert(itemsExtractorCalls < 4 * 5 * ZoneMap::ZONE_ROWS);
+
+    std::cout << "Zone Bloom filter tests passed!" << std::endl;
+}
+
+void testColdSegments() {
+    std::cout << "Testing cold segment compression..." << std::endl;
+
+    // Codec round trip, including overlapping matches and short inputs
+    std::vector<uint8_t> raw;
+    for (int i = 0; i < 5000; i++) {
+        raw.push_back(static_cast<uint8_t>(i % 13 == 0 ? i * 7 : 'a' + i % 3));
+    }
+    for (size_t length : {size_t(0), size_t(5), size_t(12), size_t(13), raw.size()}) {
+        std::vector<uint8_t> packed, unpacked(length);
+        compressBlock(raw.data(), length, packed);
+        assert(decompressBlock(packed.data(), packed.size(), unpacked.data(), length));
+        assert(std::equal(unpacked.begin(), unpacked.end(), raw.begin()));
+        if (length == raw.size()) {
+            assert(packed.size() < raw.size() / 2);
+            assert(!decompressBlock(packed.data(), packed.size() - 1, unpacked.data(), length));
+        }
+    }
+
+    StorageOptions options;
+    options.mode = StorageMode::Segmented;
+    options.segmentSize = 16 * 1024;
+    options.coldCacheSegments = 2;
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "cold_plain"));
+    FlatSQLDatabase cold(SchemaParser::parse(ITEMS_SCHEMA, "cold"), options);
+    for (FlatSQLDatabase* db : {&plain, &cold}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", itemsExtractor);
+        ingestItems(*db, 1, 20000);
+        db->markDeleted("items", 777);
+    }
+
+    bool threw = false;
+    try {
+        plain.compressColdSegments();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Every sealed chunk but the newest goes cold
+    size_t chunks = (20000 * 16 + options.segmentSize - 1) / options.segmentSize;
+    assert(cold.compressColdSegments() > 0);
+    const StreamingFlatBufferStore& store = cold.getStorage();
+    assert(store.getColdSegmentCount() == chunks - 2);
+    assert(store.getColdBytes() < (chunks - 2) * options.segmentSize / 2);
+    assert(cold.compressColdSegments() == 0);
+
+    // Prefetching only sees resident chunks
+    uint64_t newest = store.getRecordInfoVector("ITEM")->back().offset;
+    assert(store.residentRecordAt(0) == nullptr);
+    assert(store.residentRecordAt(newest) == store.recordAt(newest));
+
+    // Reads decompress on demand; the self-join keeps two cold chunks in
+    // use at once through a cache of two
+    ingestItems(plain, 20001, 21000);
+    ingestItems(cold, 20001, 21000);
+    const char* queries[] = {
+        "SELECT id, qty FROM items WHERE id = 4321",
+        "SELECT id FROM items WHERE id BETWEEN 700 AND 900 ORDER BY id",
+        "SELECT COUNT(*), SUM(qty), MAX(score) FROM items",
+        "SELECT a.id, b.id FROM items a JOIN items b ON b.id = a.id + 15000 WHERE a.id % 97 = 0 ORDER BY a.id",
+        "SELECT id FROM items WHERE qty = 3 AND id > 20500 ORDER BY id",
+    };
+    for (const char* sql : queries) {
+        auto expected = plain.query(sql);
+        auto actual = cold.query(sql);
+        assert(actual.rowCount() == expected.rowCount() && actual.rowCount() > 0);
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            for (size_t c = 0; c < actual.rows[r].size(); c++) {
+                assert(compareValues(actual.rows[r][c], expected.rows[r][c]) == 0);
+            }
+        }
+    }
+    StoredRecord record = store.readRecord(100);
+    int32_t id;
+    std::memcpy(&id, record.data.data() + 8, sizeof(id));
+    assert(id == 100);
+
+    // Compaction reads through the cold chunks into a raw stream
+    cold.compact();
+    assert(store.getColdSegmentCount() == 0);
+    auto count = cold.query("SELECT COUNT(*) FROM items");
+    assert(compareValues(count.rows[0][0], Value(int64_t(20999))) == 0);
+
+    std::cout << "Cold segment compression tests passed!" << std::endl;
+}
+
+void testDictionaryIndex() {
+    std::cout << "Testing dictionary-encoded string indexes..." << std::endl;
+
+    // Postings switch from arrays to bitmaps per 65536 ordinals
+    PostingList postings;
+    std::vector<uint32_t> members;
+    for (uint32_t i = 0; i < 200000; i += (i < 65536 ? 1 : 97)) {
+        postings.add(i);
+        members.push_back(i);
+    }
+    std::vector<uint32_t> walked;
+    postings.forEach([&](uint32_t ordinal) { walked.push_back(ordinal); });
+    assert(walked == members && postings.size() == members.size());
+    assert(postings.memoryBytes() < members.size() * sizeof(uint32_t) / 2);
+
+    // Same answers as the B+tree over a low-cardinality column
+    DictionaryIndex dict("events", "kind");
+    BTreeIndex tree("events", "kind", ValueType::String);
+    static const char* const kinds[] = {"alert", "track", "ping", "contact", "alert-high"};
+    for (uint64_t seq = 1; seq <= 20000; seq++) {
+        std::string kind = kinds[(seq + seq / 3) % 5];
+        dict.insert(kind, seq * 16, 12, seq);
+        tree.insert(kind, seq * 16, 12, seq);
+    }
+    std::vector<IndexEntry> late = {{std::string("zulu"), 9000, 12, 3}, {std::string("alert"), 8000, 12, 2}};
+    dict.insertBatch(late);  // Out of sequence order for "alert"
+    tree.insertBatch(late);
+    assert(dict.getCodeCount() == 6 && dict.getEntryCount() == 20002);
+
+    auto same = [](const std::vector<IndexEntry>& a, const std::vector<IndexEntry>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].sequence != b[i].sequence || a[i].dataOffset != b[i].dataOffset ||
+                compareValues(a[i].key, b[i].key) != 0) return false;
+        }
+        return true;
+    };
+    assert(same(dict.search(std::string("alert")), tree.search(std::string("alert"))));
+    assert(same(dict.search(std::string("zulu")), tree.search(std::string("zulu"))));
+    assert(dict.search(std::string("missing")).empty() && dict.search(int64_t(1)).empty());
+    assert(same(dict.searchMany({std::string("ping"), std::string("alert"), std::string("nope"), std::string("ping")}),
+                tree.searchMany({std::string("ping"), std::string("alert"), std::string("nope"), std::string("ping")})));
+    assert(same(dict.range(std::string("alert"), std::string("ping")),
+                tree.range(std::string("alert"), std::string("ping"))));
+    assert(same(dict.range(std::string("b"), std::monostate{}), tree.range(std::string("b"), std::monostate{})));
+    assert(dict.range(std::string("z"), std::string("a")).empty());
+    assert(same(dict.all(), tree.all()));
+
+    IndexEntry first;
+    assert(dict.searchFirst(std::string("alert"), first) && first.sequence == 2);
+    uint64_t offset, seq;
+    uint32_t len;
+    assert(!dict.searchFirstInt64(1, offset, len, seq));
+    assert(dict.searchFirstString("track", offset, len, seq) && seq == tree.search(std::string("track"))[0].sequence);
+
+    // A row costs its fixed entry plus a few bits, not a copy of the key
+    assert(dict.memoryBytes() < 20002 * 48);
+
+    bool threw = false;
+    try {
+        dict.insert(int64_t(5), 0, 1, 1);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    dict.clear();
+    assert(dict.getCodeCount() == 0 && dict.all().empty());
+
+    // (dictionary) columns of a database get one, and queries agree with a
+    // plain (key) index
+    auto extractor = [](const uint8_t* data, size_t length, const std::string& field) -> Value {
+        if (length < 12) return std::monostate{};
+        int32_t id;
+        std::memcpy(&id, data + 8, sizeof(id));
+        if (field == "id") return id;
+        if (field == "kind") return id % 11 == 0 ? Value(std::monostate{}) : Value(std::string(kinds[id % 5]));
+        return std::monostate{};
+    };
+    FlatSQLDatabase keyed(SchemaParser::parse("table events { id: int (id); kind: string (key); }", "keyed"));
+    FlatSQLDatabase coded(SchemaParser::parse("table events { id: int (id); kind: string (dictionary); }", "coded"));
+    assert(coded.getSchema().tables[0].columns[1].dictionary && coded.getSchema().tables[0].columns[1].indexed);
+    for (FlatSQLDatabase* db : {&keyed, &coded}) {
+        db->registerFileId("ITEM", "events");
+        db->setFieldExtractor("events", extractor);
+        ingestItems(*db, 1, 5000);
+        db->markDeleted("events", 42);
+    }
+    const char* queries[] = {
+        "SELECT id FROM events WHERE kind = 'ping' ORDER BY id",
+        "SELECT id FROM events WHERE kind IN ('track', 'contact') ORDER BY id",
+        "SELECT COUNT(*) FROM events WHERE kind >= 'b' AND kind < 'q'",
+        "SELECT kind, COUNT(*) FROM events GROUP BY kind ORDER BY kind",
+        "SELECT id FROM events WHERE kind = 'absent'",
+    };
+    for (const char* sql : queries) {
+        auto expected = keyed.query(sql);
+        auto actual = coded.query(sql);
+        assert(actual.rowCount() == expected.rowCount());
+        for (size_t r = 0; r < actual.rowCount(); r++) {
+            for (size_t c = 0; c < actual.rows[r].size(); c++) {
+                assert(compareValues(actual.rows[r][c], expected.rows[r][c]) == 0);
+            }
+        }
+    }
+
+    threw = false;
+    try {
+        FlatSQLDatabase bad(SchemaParser::parse("table events { id: int (id); n: int (dictionary); }", "bad"));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Dictionary index tests passed!" << std::endl;
+}
+
+void testFileIdRouting() {
+    std::cout << "Testing packed file ID routing..." << std::endl;
+
+    uint32_t itemKey = StreamingFlatBufferStore::packFileId("ITEM");
+    assert(itemKey == (uint32_t('I') | uint32_t('T') << 8 | uint32_t('E') << 16 | uint32_t('M') << 24));
+    assert(StreamingFlatBufferStore::packFileId("") == 0);
+    assert(StreamingFlatBufferStore::packFileId("ITEMS") == 0);
+
+    // Callbacks see the identifier bytes of the record in flight
+    StreamingFlatBufferStore store;
+    uint8_t tiny[6] = {1, 2, 3, 4, 5, 6};
+    uint8_t zero[8] = {8, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t item[12] = {8, 0, 0, 0, 'I', 'T', 'E', 'M', 0, 0, 0, 0};
+    std::vector<std::string> seen;
+    auto record = [&seen](std::string_view fileId, const uint8_t*, size_t, uint64_t, uint64_t) {
+        seen.emplace_back(fileId);
+    };
+    for (int i = 0; i < 3; i++) {
+        store.ingestFlatBuffer(item, sizeof(item), record);
+        store.ingestFlatBuffer(tiny, sizeof(tiny), record);
+        store.ingestFlatBuffer(zero, sizeof(zero), record);
+    }
+    assert(seen.size() == 9 && seen[0] == "ITEM" && seen[1].empty() && seen[2] == std::string(4, '\0'));
+    assert(store.getRecordCountByFileId("ITEM") == 3);
+    assert(store.getRecordCountByFileId("") == 3);
+    assert(store.getRecordCountByFileId(std::string(4, '\0')) == 3);
+
+    // Records of unregistered file IDs or sources are stored but not indexed
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "routing"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    db.registerSource("east");
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 40; id++) {
+        uint8_t bytes[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        if (id % 4 == 0) std::memcpy(bytes + 8, "ITEX", 4);
+        std::memcpy(bytes + 12, &id, sizeof(id));
+        stream.insert(stream.end(), bytes, bytes + sizeof(bytes));
+    }
+    db.ingest(stream.data(), stream.size());
+    db.ingestWithSource(stream.data(), stream.size(), "east");
+    db.ingestWithSource(stream.data(), stream.size(), "west");
+    auto count = [&db](const std::string& table) {
+        return std::get<int64_t>(db.query("SELECT COUNT(*) FROM \"" + table + "\"").rows[0][0]);
+    };
+    assert(count("items") == 30);
+    assert(count("items@east") == 30);
+    assert(db.getStorage().getRecordCount() == 120);
+
+    std::cout << "File ID routing tests passed!" << std::endl;
+}
+
+void testFieldCipher() {
+    std::cout << "Testing AES-CTR field cipher backends..." << std::endl;
+
+    // NIST SP 800-38A F.5.5 (CTR-AES256), first two blocks plus a partial one
+    auto hex = [](const char* text) {
+        std::vector<uint8_t> bytes;
+        for (size_t i = 0; text[i] && text[i + 1]; i += 2) {
+            bytes.push_back(static_cast<uint8_t>(std::stoi(std::string(text + i, 2), nullptr, 16)));
+        }
+        return bytes;
+    };
+    FieldCipher nist;
+    auto key = hex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    auto iv = hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    std::memcpy(nist.key, key.data(), 32);
+    std::memcpy(nist.iv, iv.data(), 16);
+    nist.prepare();
+    auto plain = hex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46");
+    auto cipher = hex("601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930da");
+
+    // Fields of mixed lengths and keys, some sharing a counter pipeline
+    std::vector<FieldCipher> ciphers(3);
+    for (size_t c = 0; c < ciphers.size(); c++) {
+        for (int i = 0; i < 32; i++) ciphers[c].key[i] = static_cast<uint8_t>(c * 40 + i);
+        for (int i = 0; i < 16; i++) ciphers[c].iv[i] = static_cast<uint8_t>(c * 9 + i * 3);
+        ciphers[c].iv[15] = 0xfe;  // Counters carry within the first fields
+        ciphers[c].prepare();
+    }
+    std::vector<std::vector<uint8_t>> fields;
+    for (size_t i = 0; i < 40; i++) {
+        std::vector<uint8_t> field(i * 7 % 45);
+        for (size_t j = 0; j < field.size(); j++) field[j] = static_cast<uint8_t>(i + j);
+        fields.push_back(field);
+    }
+    auto spansOf = [&](std::vector<std::vector<uint8_t>>& data) {
+        std::vector<FieldSpan> spans;
+        for (size_t i = 0; i < data.size(); i++) {
+            spans.push_back({data[i].data(), data[i].size(), &ciphers[i % ciphers.size()]});
+        }
+        return spans;
+    };
+
+    std::vector<std::vector<uint8_t>> reference;
+    for (CipherBackend backend : {CipherBackend::AesNi, CipherBackend::OpenSsl}) {
+        std::vector<uint8_t> block = plain;
+        FieldSpan span{block.data(), block.size(), &nist};
+        if (!cryptFieldsWith(backend, &span, 1)) continue;
+        assert(block == cipher);
+
+        // Hardware backends agree on batches
+        auto data = fields;
+        auto spans = spansOf(data);
+        assert(cryptFieldsWith(backend, spans.data(), spans.size()));
+        if (reference.empty()) reference = data;
+        assert(data == reference);
+        std::cout << "  " << cipherBackendName(backend) << ": OK" << std::endl;
+    }
+
+    // The chosen backend matches flatbuffers' own cipher, one field or many
+    auto data = fields;
+    auto spans = spansOf(data);
+    cryptFields(spans.data(), spans.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+        auto expected = fields[i];
+        const FieldCipher& c = ciphers[i % ciphers.size()];
+        if (!expected.empty()) flatbuffers::EncryptBytes(expected.data(), expected.size(), c.key, c.iv);
+        assert(data[i] == expected);
+        cryptField(data[i].data(), data[i].size(), c);
+        assert(data[i] == fields[i]);
+    }
+    std::cout << "  active backend: " << cipherBackendName(cipherBackend()) << std::endl;
+
+    std::cout << "Field cipher tests passed!" << std::endl;
+}
+
+void testEncryptedColumns() {
+    std::cout << "Testing decryption of encrypted columns in queries..." << std::endl;
+
+    const char* schema = R"(
+        enum Color : byte { Red, Green, Blue }
+        union Payload { Gadget }
+        table gadgets {
+            id: int (id);
+            name: string (encrypted);
+            weight: double (encrypted);
+            color: Color;
+            payload: Payload;
+            tags: [ubyte];
+            rank: short = 7;
+        }
+    )";
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++) key[i] = static_cast<uint8_t>(7 * i + 3);
+    flatbuffers::EncryptionContext ctx(key, 32);
+    DatabaseSchema parsed = SchemaParser::parseIDL(schema);
+    uint16_t nameField = parsed.tables[0].columns[1].fieldId;
+    uint16_t weightField = parsed.tables[0].columns[2].fieldId;
+
+    // Records as a writer encrypting name and weight would produce them
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 50; id++) {
+        std::string name = "gadget" + std::to_string(id);
+        double weight = id * 0.5;
+        flatbuffers::EncryptString(reinterpret_cast<uint8_t*>(name.data()), name.size(), ctx, nameField);
+        flatbuffers::EncryptScalar(reinterpret_cast<uint8_t*>(&weight), sizeof(weight), ctx, weightField);
+        auto record = buildGadget(id, name.c_str(), &weight, int8_t(id % 3), {});
+        stream.insert(stream.end(), record.begin(), record.end());
+    }
+
+    // Generated reader (decrypts into scratch), then the Value path
+    FlatSQLDatabase generated = FlatSQLDatabase::fromSchema(schema, "sealed");
+    FlatSQLDatabase valued = FlatSQLDatabase::fromSchema(schema, "sealed_values");
+    SchemaExtractor reader(parsed.tables[0]);
+    valued.setFieldExtractor("gadgets", [&reader](const uint8_t* data, size_t length, const std::string& field) {
+        return reader.extract(data, length, field);
+    });
+    for (FlatSQLDatabase* db : {&generated, &valued}) {
+        db->setEncryptionKey(key, 32);
+        db->registerFileId("GDGT", "gadgets");
+        db->ingest(stream.data(), stream.size());
+
+        auto row = db->query("SELECT name, weight, color FROM gadgets WHERE id = 7");
+        assert(row.rowCount() == 1);
+        assert(row.rows[0][0] == Value(std::string("gadget7")));
+        assert(row.rows[0][1] == Value(3.5));
+        assert(row.rows[0][2] == Value(int64_t(1)));
+
+        // A self-join revisits every inner record once per outer row
+        auto pairs = db->query(
+            "SELECT COUNT(*), SUM(b.weight) FROM gadgets a JOIN gadgets b "
+            "ON b.name > a.name WHERE a.id <= 10");
+        auto names = db->query("SELECT name FROM gadgets ORDER BY name");
+        size_t expected = 0;
+        double weights = 0.0;
+        for (int32_t a = 1; a <= 10; a++) {
+            for (int32_t b = 1; b <= 50; b++) {
+                if ("gadget" + std::to_string(b) > "gadget" + std::to_string(a)) {
+                    expected++;
+                    weights += b * 0.5;
+                }
+            }
+        }
+        assert(pairs.rows[0][0] == Value(int64_t(expected)));
+        assert(compareValues(pairs.rows[0][1], Value(weights)) == 0);
+        assert(names.rowCount() == 50 && names.rows[0][0] == Value(std::string("gadget1")));
+    }
+
+    std::cout << "Encrypted column tests passed!" << std::endl;
+}
+
+void testVerifiedIngest() {
+    std::cout << "Testing batched HMAC verification on ingest..." << std::endl;
+
+    // RFC 4231 test case 2
+    const std::string jefe = "Jefe";
+    const std::string message = "what do ya want for nothing?";
+    HmacSha256 rfc(reinterpret_cast<const uint8_t*>(jefe.data()), jefe.size());
+    if (!rfc.available()) {
+        std::cout << "  SKIPPED (no OpenSSL)" << std::endl;
+        return;
+    }
+    const uint8_t expected[32] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43};
+    uint8_t mac[32];
+    assert(rfc.compute(reinterpret_cast<const uint8_t*>(message.data()), message.size(), mac));
+    assert(std::memcmp(mac, expected, sizeof(mac)) == 0);
+    assert(rfc.verify(reinterpret_cast<const uint8_t*>(message.data()), message.size(), expected));
+    std::cout << "  RFC 4231 vector: OK" << std::endl;
+
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++) key[i] = static_cast<uint8_t>(i * 3 + 1);
+
+    for (size_t threads : {size_t(0), size_t(4)}) {
+        FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "verified"));
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        if (threads > 0) db.setIngestThreads(threads);
+        db.setEncryptionKey(key, 32);
+        db.setHMACVerification(true);
+
+        // 100 records and a MAC for each, then a record without one
+        std::vector<uint8_t> stream;
+        std::vector<uint8_t> macs;
+        for (int32_t id = 1; id <= 101; id++) {
+            uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+            std::memcpy(record + 12, &id, sizeof(id));
+            stream.insert(stream.end(), record, record + sizeof(record));
+            if (id <= 100) {
+                macs.resize(macs.size() + 32);
+                assert(db.computeHMAC(record + 4, 12, macs.data() + macs.size() - 32));
+            }
+        }
+
+        // Plain ingest is refused while verification is on
+        bool threw = false;
+        try {
+            db.ingest(stream.data(), stream.size());
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+
+        // One bad MAC rejects the whole batch
+        std::vector<uint8_t> badMacs = macs;
+        badMacs[57 * 32 + 5] ^= 1;
+        threw = false;
+        try {
+            db.ingestVerified(stream.data(), stream.size(), badMacs.data(), 100);
+        } catch (const std::runtime_error& e) {
+            threw = std::string(e.what()).find("record 57") != std::string::npos;
+        }
+        assert(threw);
+        assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(0)));
+
+        size_t records = 0;
+        size_t consumed = db.ingestVerified(stream.data(), stream.size(), macs.data(), 100, &records);
+        assert(consumed == 100 * 16);
+        assert(records == 100);
+        QueryResult result = db.query("SELECT COUNT(*), SUM(id) FROM items");
+        assert(result.rows[0][0] == Value(int64_t(100)));
+        assert(result.rows[0][1] == Value(int64_t(5050)));
+
+        // Single records
+        const uint8_t* last = stream.data() + 100 * 16 + 4;
+        uint8_t lastMac[32];
+        assert(db.computeHMAC(last, 12, lastMac));
+        lastMac[0] ^= 1;
+        threw = false;
+        try {
+            db.ingestOneVerified(last, 12, lastMac);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        lastMac[0] ^= 1;
+        db.ingestOneVerified(last, 12, lastMac);
+        assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(101)));
+    }
+    std::cout << "  batch verify, sequential and pooled: OK" << std::endl;
+
+    // A short key gives no HMAC key; nothing past its 16 bytes is read
+    {
+        FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "short_key"));
+        db.registerFileId("ITEM", "items");
+        std::vector<uint8_t> shortKey(key, key + 16);
+        db.setEncryptionKey(shortKey.data(), shortKey.size());
+        db.setHMACVerification(true);
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M', 1, 0, 0, 0};
+        uint8_t mac[32] = {};
+        assert(!db.computeHMAC(record + 4, 12, mac));
+        bool threw = false;
+        try {
+            db.ingestVerified(record, sizeof(record), mac, 1);
+        } catch (const std::runtime_error& e) {
+            threw = std::string(e.what()).find("without an encryption key") != std::string::npos;
+        }
+        assert(threw);
+        assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(0)));
+
+        // A full key afterwards enables them
+        db.setEncryptionKey(key, 32);
+        assert(db.computeHMAC(record + 4, 12, mac));
+        db.ingestVerified(record, sizeof(record), mac, 1);
+        assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(1)));
+    }
+    std::cout << "  short key: OK" << std::endl;
+
+    std::cout << "Verified ingest tests passed!" << std::endl;
+}
+
+// Connected client socket for the ingest server test (-1 on failure)
+static int connectIngest(const std::string& unixPath, int tcpPort) {
+    int fd;
+    if (!unixPath.empty()) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, unixPath.c_str(), sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+    } else {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(tcpPort));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+// Items stream for ids [from, to]; every 50th record is padded to 300 bytes
+static std::vector<uint8_t> itemsStream(int32_t from, int32_t to) {
+    std::vector<uint8_t> stream;
+    for (int32_t id = from; id <= to; id++) {
+        uint32_t size = id % 50 == 0 ? 300 : 12;
+        uint8_t header[16] = {0, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        std::memcpy(header, &size, sizeof(size));
+        std::memcpy(header + 12, &id, sizeof(id));
+        stream.insert(stream.end(), header, header + sizeof(header));
+        stream.resize(stream.size() + (size - 12), 0xee);
+    }
+    return stream;
+}
+
+void testStreamIngestor() {
+    std::cout << "Testing streaming ingestor..." << std::endl;
+
+    // 400 records, every 50th padded to 300 bytes (larger than the buffer)
+    std::vector<uint8_t> stream = itemsStream(1, 400);
+    const int64_t expectedSum = 400 * 401 / 2;
+
+    // write(): chunks cut anywhere, including inside size prefixes
+    {
+        FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "chunks"));
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        StreamIngestor ingestor(db, 64);
+        size_t records = 0;
+        size_t piece = 1;
+        for (size_t offset = 0; offset < stream.size();) {
+            size_t n = std::min(piece, stream.size() - offset);
+            records += ingestor.write(stream.data() + offset, n);
+            offset += n;
+            piece = piece * 7 % 113 + 1;
+        }
+        assert(records == 400);
+        assert(ingestor.pending() == 0);
+        assert(ingestor.getRecordsIngested() == 400);
+        QueryResult result = db.query("SELECT COUNT(*), SUM(id) FROM items");
+        assert(result.rows[0][0] == Value(int64_t(400)));
+        assert(result.rows[0][1] == Value(expectedSum));
+    }
+    std::cout << "  write() with arbitrary chunk boundaries: OK" << std::endl;
+
+    // reserve()/commit(): filled in place like a socket read
+    {
+        FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "reserved"));
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        StreamIngestor ingestor(db, 64);
+        size_t records = 0;
+        size_t offset = 0;
+        while (offset < stream.size()) {
+            size_t room = 0;
+            uint8_t* dest = ingestor.reserve(1, &room);
+            assert(room >= 1);
+            size_t n = std::min({room, stream.size() - offset, size_t(37)});
+            std::memcpy(dest, stream.data() + offset, n);
+            records += ingestor.commit(n);
+            offset += n;
+            // A padded frame makes the buffer grow to hold it whole
+            if (ingestor.frameBytes() > 64) {
+                ingestor.reserve(1, &room);
+                assert(ingestor.capacity() >= ingestor.frameBytes());
+            }
+            ingestor.shrink();
+        }
+        assert(records == 400);
+        assert(ingestor.capacity() == 64);
+        assert(db.query("SELECT SUM(id) FROM items").rows[0][0] == Value(expectedSum));
+
+        // Partial frames wait for the rest
+        std::vector<uint8_t> one = itemsStream(401, 401);
+        assert(ingestor.write(one.data(), 10) == 0);
+        assert(ingestor.pending() == 10);
+        assert(ingestor.frameBytes() == one.size());
+        assert(ingestor.write(one.data() + 10, one.size() - 10) == 1);
+        assert(ingestor.pending() == 0);
+
+        // Oversized frames are refused once their prefix arrives
+        ingestor.setMaxFrameSize(1024);
+        uint8_t huge[4] = {0, 0, 1, 0};
+        bool threw = false;
+        try {
+            ingestor.write(huge, sizeof(huge));
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    std::cout << "  reserve()/commit() in place: OK" << std::endl;
+
+    std::cout << "Streaming ingestor tests passed!" << std::endl;
+}
+
+void testIngestServer() {
+    std::cout << "Testing network ingest server..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "served"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+
+    IngestServerOptions options;
+    options.unixPath = "/tmp/flatsql_ingest_test.sock";
+    options.tcpPort = 0;
+    options.receiveBufferSize = 64;  // Frames cross reads, padded ones outgrow the buffer
+    options.maxGrowthBytes = 256;    // Only one grown buffer at a time
+    options.maxFrameSize = 4096;
+    options.readBudget = 100;
+    IngestServer server(db, options);
+    assert(server.tcpPort() > 0);
+
+    // Four producers, two per transport, sending in uneven pieces
+    const int32_t perProducer = 500;
+    std::vector<std::thread> producers;
+    std::atomic<int> connected{0};
+    for (int p = 0; p < 4; p++) {
+        producers.emplace_back([&, p] {
+            int fd = connectIngest(p % 2 == 0 ? options.unixPath : "", server.tcpPort());
+            if (fd < 0) return;
+            connected++;
+            std::vector<uint8_t> stream = itemsStream(p * perProducer + 1, (p + 1) * perProducer);
+            size_t piece = 1 + p * 7;
+            for (size_t offset = 0; offset < stream.size();) {
+                size_t n = std::min(piece, stream.size() - offset);
+                ssize_t sent = send(fd, stream.data() + offset, n, 0);
+                if (sent <= 0) break;
+                offset += static_cast<size_t>(sent);
+                piece = piece % 97 + 13;
+            }
+            close(fd);
+        });
+    }
+
+    size_t total = 4 * perProducer;
+    for (int i = 0; i < 20000 && server.getStats().recordsIngested < total; i++) {
+        server.pollOnce(10);
+    }
+    for (std::thread& t : producers) t.join();
+    assert(connected == 4);
+    for (int i = 0; i < 100 && server.getStats().activeConnections > 0; i++) {
+        server.pollOnce(10);
+    }
+
+    IngestServerStats stats = server.getStats();
+    assert(stats.recordsIngested == total);
+    assert(stats.connectionsAccepted == 4);
+    assert(stats.activeConnections == 0);
+    QueryResult result = db.query("SELECT COUNT(*), SUM(id) FROM items");
+    assert(result.rows[0][0] == Value(int64_t(total)));
+    assert(result.rows[0][1] == Value(int64_t(total * (total + 1) / 2)));
+    std::cout << "  4 producers over Unix socket and TCP: OK (" << stats.readPauses
+              << " backpressure pauses)" << std::endl;
+
+    // A frame over maxFrameSize drops its producer
+    {
+        int fd = connectIngest("", server.tcpPort());
+        assert(fd >= 0);
+        uint8_t header[4] = {0, 0, 1, 0};  // 65536 bytes
+        assert(send(fd, header, sizeof(header), 0) == 4);
+        for (int i = 0; i < 200 && server.getStats().connectionsDropped == 0; i++) {
+            server.pollOnce(10);
+        }
+        close(fd);
+        assert(server.getStats().connectionsDropped == 1);
+        assert(server.getLastError().find("maxFrameSize") != std::string::npos);
+    }
+
+    // Background loop
+    server.start();
+    {
+        int fd = connectIngest(options.unixPath, 0);
+        assert(fd >= 0);
+        std::vector<uint8_t> stream = itemsStream(total + 1, total + 100);
+        assert(send(fd, stream.data(), stream.size(), 0) == static_cast<ssize_t>(stream.size()));
+        close(fd);
+        for (int i = 0; i < 500 && server.getStats().recordsIngested < total + 100; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    server.stop();
+    assert(server.getStats().recordsIngested == total + 100);
+    assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(total + 100)));
+    std::cout << "  background loop start/stop: OK" << std::endl;
+
+    std::cout << "Ingest server tests passed!" << std::endl;
+}
+
+void testSubscriptions() {
+    std::cout << "Testing ingest subscriptions..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "subscribed"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);  // Before subscribing: never delivered
+
+    using Op = SubscriptionFilter::Op;
+    auto idOf = [](const MatchedRecord& record) {
+        int32_t id;
+        std::memcpy(&id, record.data + 8, sizeof(id));
+        return id;
+    };
+
+    // Equality (hash lookup), with an int64 filter on an int32 column
+    std::vector<int32_t> byId;
+    uint64_t eqSub = db.subscribe("items", {{"id", Op::Eq, int64_t(142)}}, [&](const MatchedRecord& record) {
+        byId.push_back(idOf(record));
+        // Published before delivery: queries see the record
+        assert(db.query("SELECT COUNT(*) FROM items WHERE id = 142").rows[0][0] == Value(int64_t(1)));
+    });
+
+    // Equality on a double column matched by an integral value, plus a range
+    std::vector<int32_t> byScore;
+    db.subscribe("items", {{"score", Op::Eq, int32_t(40)}, {"id", Op::Gt, int32_t(150)}},
+                 [&](const MatchedRecord& record) { byScore.push_back(idOf(record)); });
+
+    // Ranges only (tested one by one); NULL qty never matches
+    std::vector<int32_t> byRange;
+    uint64_t rangeSub = 0;
+    rangeSub = db.subscribe("items", {{"qty", Op::Ge, int32_t(5)}, {"id", Op::Lt, int32_t(130)}},
+                            [&](const MatchedRecord& record) {
+        byRange.push_back(idOf(record));
+        if (byRange.size() == 3) db.unsubscribe(rangeSub);  // From inside a callback
+    });
+
+    ingestItems(db, 101, 200);
+    assert(byId == std::vector<int32_t>({142}));
+    assert(byScore == std::vector<int32_t>({160}));
+    // qty = id % 7, NULL when id % 10 == 0 (so 110 is skipped)
+    assert(byRange == std::vector<int32_t>({103, 104, 111}));
+
+    // Single-record ingest delivers too; unsubscribed ones stay quiet
+    assert(db.unsubscribe(eqSub));
+    assert(!db.unsubscribe(eqSub));
+    uint8_t record[12] = {0x08, 0, 0, 0, 'I', 'T', 'E', 'M'};
+    int32_t id = 142;
+    std::memcpy(record + 8, &id, sizeof(id));
+    db.ingestOne(record, sizeof(record));
+    assert(byId.size() == 1);
+
+    bool threw = false;
+    try {
+        db.subscribe("items", {{"missing", Op::Eq, int32_t(1)}}, [](const MatchedRecord&) {});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Subscription tests passed!" << std::endl;
+}
+
+void testMaterializedAggregates() {
+    std::cout << "Testing materialized aggregates..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "materialized"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);  // Counted when the aggregate is created
+
+    using Op = AggregateSpec::Op;
+    db.createMaterializedAggregate("by_qty", "items",
+        {"qty", {{Op::Count, ""}, {Op::Sum, "id"}, {Op::Min, "score"}, {Op::Max, "id"}, {Op::Avg, "score"}},
+         {"id"}});
+    db.createMaterializedAggregate("totals", "items", {"", {{Op::Count, ""}, {Op::Count, "qty"}}, {}});
+
+    // Ids ascend with sequence, so LAST(id) is MAX(id)
+    auto check = [&db] {
+        QueryResult materialized = db.query(
+            "SELECT qty, \"COUNT(*)\", \"SUM(id)\", \"MIN(score)\", \"MAX(id)\", \"AVG(score)\", "
+            "\"LAST(id)\" FROM by_qty ORDER BY qty");
+        QueryResult scanned = db.query(
+            "SELECT qty, COUNT(*), SUM(id), MIN(score), MAX(id), AVG(score), MAX(id) FROM items "
+            "GROUP BY qty ORDER BY qty");
+        assert(materialized.rows == scanned.rows);
+        QueryResult totals = db.query("SELECT * FROM totals");
+        assert(totals.rowCount() == 1);
+        assert(totals.rows[0] == db.query("SELECT COUNT(*), COUNT(qty) FROM items").rows[0]);
+    };
+    check();
+
+    ingestItems(db, 101, 200);
+    check();
+
+    // Deleting a group's MAX, LAST and MIN, and deleting twice
+    auto sequenceOf = [&db](int32_t id) {
+        return static_cast<uint64_t>(std::get<int64_t>(
+            db.query("SELECT _rowid FROM items WHERE id = ?", {Value(id)}).rows[0][0]));
+    };
+    for (int32_t id : {196, 195, 1}) {
+        db.markDeleted("items", sequenceOf(id));
+    }
+    uint64_t twice = sequenceOf(50);
+    db.markDeleted("items", twice);
+    db.markDeleted("items", twice);
+    check();
+
+    // Group lookup by value
+    QueryResult group = db.query("SELECT \"COUNT(*)\" FROM by_qty WHERE qty = 3");
+    assert(group.rowCount() == 1);
+    assert(group.rows[0][0] == db.query("SELECT COUNT(*) FROM items WHERE qty = 3").rows[0][0]);
+    assert(db.query("SELECT * FROM by_qty WHERE qty = 99").rowCount() == 0);
+
+    db.compact();
+    check();
+    ingestItems(db, 201, 260);
+    db.markDeleted("items", sequenceOf(259));
+    check();
+
+    // Emptied groups disappear
+    for (int32_t id = 1; id <= 260; id++) {
+        if (id % 10 != 0 && id % 7 == 6 && id != 195) db.markDeleted("items", sequenceOf(id));
+    }
+    assert(db.query("SELECT * FROM by_qty WHERE qty = 6").rowCount() == 0);
+    check();
+
+    bool threw = false;
+    try {
+        db.createMaterializedAggregate("bad", "items", {"", {{Op::Sum, "name"}}, {}});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "  Materialized aggregates tests passed!" << std::endl;
+}
+
+void testResultCache() {
+    std::cout << "Testing query result cache..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "cached"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+    db.setResultCacheSize(1 << 20);
+
+    const std::string byQty = "SELECT COUNT(*), MAX(id) FROM items WHERE qty = ?";
+    QueryResult first = db.query(byQty, {Value(int64_t(3))});
+    QueryResult again = db.query(byQty, {Value(int64_t(3))});
+    assert(again.rows == first.rows && again.columns == first.columns);
+    db.query(byQty, {Value(int64_t(4))});  // Other parameters, other entry
+    ResultCacheStats stats = db.getResultCacheStats();
+    assert(stats.hits == 1 && stats.misses == 2 && stats.entries == 2);
+
+    // New records and deletes invalidate, even for a query reading no column
+    const std::string count = "SELECT COUNT(*) FROM items";
+    assert(db.query(count).rows[0][0] == Value(int64_t(100)));
+    assert(db.query(count).rows[0][0] == Value(int64_t(100)));
+    ingestItems(db, 101, 110);
+    assert(db.query(count).rows[0][0] == Value(int64_t(110)));
+    assert(db.query(byQty, {Value(int64_t(3))}).rows[0][1] == Value(int64_t(108)));
+    db.markDeleted("items", 1);
+    assert(db.query(count).rows[0][0] == Value(int64_t(109)));
+    stats = db.getResultCacheStats();
+    assert(stats.invalidations == 3 && stats.hits == 2);
+
+    // Volatile functions are never cached
+    db.query("SELECT random() FROM items LIMIT 1");
+    db.query("SELECT random() FROM items LIMIT 1");
+    assert(db.getResultCacheStats().hits == 2);
+
+    // The capacity evicts least recently used entries
+    db.setResultCacheSize(2048);
+    for (int64_t qty = 0; qty < 7; qty++) {
+        db.query("SELECT id, name FROM items WHERE qty = ?", {Value(qty)});
+    }
+    stats = db.getResultCacheStats();
+    assert(stats.evictions > 0 && stats.bytes <= 2048 && stats.capacity == 2048);
+    assert(stats.hitRate() > 0.0 && stats.hitRate() < 1.0);
+
+    db.setResultCacheSize(0);
+    assert(db.getResultCacheStats().entries == 0);
+    assert(db.query(count).rows[0][0] == Value(int64_t(109)));
+
+    // Compaction renumbers rowids even where a table's visible records and
+    // tombstones stay the same, as when only another table had deletes
+    FlatSQLDatabase mixed(SchemaParser::parse(std::string(ITEMS_SCHEMA) + "table others { id: int (id); }",
+                                              "cached_compact"));
+    mixed.registerFileId("ITEM", "items");
+    mixed.registerFileId("OTHR", "others");
+    mixed.setFieldExtractor("items", itemsExtractor);
+    uint8_t other[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'O', 'T', 'H', 'R'};
+    mixed.ingest(other, sizeof(other));
+    ingestItems(mixed, 1, 20);
+    mixed.setResultCacheSize(1 << 20);
+    const std::string rowidOf = "SELECT rowid FROM items WHERE score = 2.5";  // Item 10
+    assert(mixed.query(rowidOf).rows[0][0] == Value(int64_t(11)));
+    mixed.markDeleted("others", 1);
+    assert(mixed.query(rowidOf).rows[0][0] == Value(int64_t(11)));
+    assert(mixed.getResultCacheStats().hits == 1);
+    mixed.compact();
+    assert(mixed.query(rowidOf).rows[0][0] == Value(int64_t(10)));
+
+    std::cout << "  Result cache tests passed!" << std::endl;
+}
+
+void testEngineCacheLimits() {
+    std::cout << "Testing bounded engine caches..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "bounded"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+
+    EngineCacheLimits limits;
+    limits.statements = 4;
+    limits.parsedQueries = 8;
+    db.setCacheLimits(limits);
+
+    // Unique SQL strings (inlined literals) stay within the limits
+    for (int id = 1; id <= 50; id++) {
+        std::string sql = "SELECT name, id FROM items WHERE id = " + std::to_string(id);
+        QueryResult result = db.query(sql);
+        assert(result.rowCount() == 1 && result.rows[0][1] == Value(int64_t(id)));
+    }
+    EngineCacheStats stats = db.getCacheStats();
+    assert(stats.statements.entries == 4 && stats.statements.capacity == 4);
+    assert(stats.statements.evictions == 46);
+    assert(stats.parsedQueries.entries == 8 && stats.parsedQueries.evictions == 42);
+
+    // Recently used entries are kept, older ones were evicted
+    db.query("SELECT name, id FROM items WHERE id = 50");
+    db.query("SELECT name, id FROM items WHERE id = 1");
+    EngineCacheStats after = db.getCacheStats();
+    assert(after.statements.hits == stats.statements.hits + 1);
+    assert(after.statements.misses == stats.statements.misses + 1);
+
+    // Fast-path point lookups reuse cached column names
+    for (int i = 0; i < 3; i++) {
+        assert(db.query("SELECT * FROM items WHERE id = ?", {Value(int64_t(7))}).rowCount() == 1);
+    }
+    after = db.getCacheStats();
+    assert(after.columnNames.hits >= 2 && after.sourceNames.entries <= limits.sourceNames);
+    assert(after.parsedQueries.hitRate() > 0.0);
+
+    std::cout << "  Bounded engine cache tests passed!" << std::endl;
+}
+
+void testQueryStats() {
+    std::cout << "Testing per-query stats..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "stats"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+
+    // Nothing is recorded until enabled
+    db.query("SELECT id FROM items WHERE qty > 3");
+    assert(db.getQueryStats().empty() && db.getLastQueryStats().id == 0);
+    db.setQueryStatsEnabled(true);
+
+    // Full scan through the slow extractor: one extraction per row
+    QueryResult scanned = db.query("SELECT id, qty FROM items WHERE qty > 3");
+    QueryStats scan = db.getLastQueryStats();
+    assert(scan.id == 1 && !scan.fastPath && !scan.resultCacheHit);
+    assert(scan.rowsScanned == 100 && scan.rowsReturned == scanned.rowCount());
+    assert(scan.slowExtractorCalls == 100 && scan.fastExtractorCalls == 0);
+    assert(scan.filterCalls == 1 && scan.nextCalls == 100 && scan.indexProbes == 0);
+    assert(scan.columnCalls >= 100 && scan.bytesTouched > 0);
+    assert(scan.totalNanos >= scan.filterNanos + scan.nextNanos);
+
+    // Index range scan only visits its matches
+    assert(db.query("SELECT name FROM items WHERE id BETWEEN 10 AND 19").rowCount() == 10);
+    QueryStats range = db.getLastQueryStats();
+    assert(range.indexProbes == 1 && range.rowsScanned == 10 && range.rowsReturned == 10);
+
+    // Point lookups skip the vtab entirely
+    assert(db.query("SELECT * FROM items WHERE id = ?", {Value(int64_t(5))}).rowCount() == 1);
+    QueryStats point = db.getLastQueryStats();
+    assert(point.fastPath && point.rowsScanned == 0 && point.rowsReturned == 1);
+
+    // The same counters through SQL (the stats query itself is recorded after)
+    QueryResult table = db.query(
+        "SELECT id, fast_path, rows_scanned, slow_extractor_calls FROM flatsql_stats ORDER BY id");
+    assert(table.rowCount() == 3);
+    assert(table.rows[0][0] == Value(int64_t(1)) && table.rows[0][2] == Value(int64_t(100)));
+    assert(table.rows[0][3] == Value(int64_t(100)));
+    assert(table.rows[2][1] == Value(int64_t(1)));
+    assert(db.getQueryStats().size() == 4);
+
+    std::cout << "  Per-query stats tests passed!" << std::endl;
+}
+
+static const char* JUNCTION_SCHEMA = R"(
+    table Weapon {
+        id: int (id);
+        damage: int;
+    }
+    table Monster {
+        id: int (id);
+        name: string;
+        weapon: Weapon;
+        inventory: [Weapon];
+    }
+)";
+
+// Monster 7 with weapon 100 and inventory [101, 102], laid out as flatc
+// would: parent table first, children (sharing one vtable) after it
+static std::vector<uint8_t> buildMonsterWithWeapons() {
+    std::vector<uint8_t> buf(92, 0);
+    auto put16 = [&buf](size_t at, uint16_t v) { std::memcpy(buf.data() + at, &v, 2); };
+    auto put32 = [&buf](size_t at, uint32_t v) { std::memcpy(buf.data() + at, &v, 4); };
+    put32(0, 20);
+    std::memcpy(buf.data() + 4, "MONS", 4);
+    put16(8, 12); put16(10, 16); put16(12, 4); put16(14, 0); put16(16, 8); put16(18, 12);
+    put32(20, 12); put32(24, 7); put32(28, 56 - 28); put32(32, 36 - 32);
+    put32(36, 2); put32(40, 68 - 40); put32(44, 80 - 44);
+    put16(48, 8); put16(50, 12); put16(52, 4); put16(54, 8);
+    for (uint32_t w = 0; w < 3; w++) {
+        size_t table = 56 + 12 * w;
+        put32(table, static_cast<uint32_t>(table - 48));
+        put32(table + 4, 100 + w);
+        put32(table + 8, 10 + w);
+    }
+    return buf;
+}
+
+void testJunctionChildViews() {
+    std::cout << "Testing junction child views..." << std::endl;
+
+    std::string schema = JUNCTION_SCHEMA;
+    SchemaAnalyzer analyzer;
+    analyzer.addSchema("monster.fbs", schema);
+    SchemaAnalysis analysis = analyzer.analyze();
+    assert(analysis.tables["Monster"].references.size() == 2);
+    assert(analysis.tables["Monster"].references[0].fieldId == 2);
+    assert(analysis.tables["Monster"].references[1].fieldId == 3);
+
+    std::vector<uint8_t> buf = buildMonsterWithWeapons();
+    auto children = FlatBufferExtractor::extractChildren(buf, analysis.tables["Monster"], analysis.tables);
+    assert(children.size() == 3);
+    assert(children[0].fieldName == "weapon" && children[0].offset == 28 && children[0].isView());
+    assert(children[2].vectorIndex == 1 && children[2].offset == 44);
+
+    auto db = FlatSQLDatabase::fromSchema(schema, "junction_views");
+    db.registerFileId("MONS", "Monster");
+    JunctionManager junctions(db);
+    junctions.initialize(analysis);
+    uint64_t parent = junctions.insertWithRelations("Monster", buf);
+    assert(db.getStorage().getRecordCount() == 1);  // Children are not stored again
+
+    auto inventory = junctions.getChildren("Monster", "inventory", parent);
+    assert(inventory.size() == 2);
+    SchemaExtractor weapons(SchemaParser::parseIDL(schema).tables[0]);
+    for (const auto& row : inventory) {
+        size_t length = 0;
+        const uint8_t* child = junctions.getChildData(row.childRowId, &length);
+        assert(child && length == row.childLength);
+        int64_t id = 101 + *row.vectorIndex;
+        assert(weapons.extract(child, length, "id") == Value(int32_t(id)));
+        assert(weapons.extract(child, length, "damage") == Value(int32_t(id - 90)));
+    }
+    auto weapon = junctions.getChildren("Monster", "weapon", parent);
+    assert(weapon.size() == 1 && weapon[0].childOffset == 28);
+
+    std::cout << "Junction child view tests passed!" << std::endl;
+}
+
+void testJunctionAdjacency() {
+    std::cout << "Testing junction adjacency arrays..." << std::endl;
+
+    SchemaAnalyzer analyzer;
+    analyzer.addSchema("monster.fbs", JUNCTION_SCHEMA);
+    SchemaAnalysis analysis = analyzer.analyze();
+    auto db = FlatSQLDatabase::fromSchema(JUNCTION_SCHEMA, "junction_csr");
+    db.registerFileId("MONS", "Monster");
+    JunctionManager junctions(db);
+    junctions.initialize(analysis);
+
+    std::vector<uint8_t> buf = buildMonsterWithWeapons();
+    std::vector<uint64_t> parents;
+    for (int i = 0; i < 3; i++) {
+        parents.push_back(junctions.insertWithRelations("Monster", buf));
+    }
+
+    // Children of each parent are one slice, in vector order
+    for (size_t p = 0; p < parents.size(); p++) {
+        RowIdSlice inventory = junctions.getChildRowIds("Monster", "inventory", parents[p]);
+        assert(inventory.size == 2 && inventory[1] == inventory[0] + 1);
+        auto back = junctions.getParents("Weapon", inventory[0]);
+        assert(back.size() == 1 && back[0].parentRowId == parents[p]);
+        assert(junctions.getReferenceCount("Weapon", inventory[0]) == 1);
+    }
+    assert(junctions.getChildRowIds("Monster", "inventory", 999).empty());
+
+    // Deleting the middle parent empties its slices and orphans its children
+    RowIdSlice middle = junctions.getChildRowIds("Monster", "inventory", parents[1]);
+    uint64_t orphan = middle[0];
+    junctions.deleteWithCascade("Monster", parents[1]);
+    assert(junctions.getChildRowIds("Monster", "inventory", parents[1]).empty());
+    assert(junctions.getChildren("Monster", "weapon", parents[1]).empty());
+    assert(junctions.getReferenceCount("Weapon", orphan) == 0);
+    assert(junctions.getParents("Weapon", orphan).empty());
+    assert(junctions.getChildRowIds("Monster", "inventory", parents[2]).size == 2);
+    assert(junctions.getChildren("Monster", "weapon", parents[0]).size() == 1);
+
+    std::cout << "Junction adjacency tests passed!" << std::endl;
+}
+
+void testJunctionJoin() {
+    std::cout << "Testing junction tables in SQL..." << std::endl;
+
+    SchemaAnalyzer analyzer;
+    analyzer.addSchema("monster.fbs", JUNCTION_SCHEMA);
+    SchemaAnalysis analysis = analyzer.analyze();
+    auto db = FlatSQLDatabase::fromSchema(JUNCTION_SCHEMA, "junction_join");
+    db.registerFileId("MONS", "Monster");
+    JunctionManager junctions(db);
+    junctions.initialize(analysis);
+
+    std::vector<uint8_t> buf = buildMonsterWithWeapons();
+    for (int i = 0; i < 3; i++) {
+        junctions.insertWithRelations("Monster", buf);
+    }
+    junctions.registerTables();
+    JunctionStats stats = junctions.getJunctionStats("Monster__inventory");
+    assert(stats.rows == 6 && stats.parents == 3);
+
+    // Parent joined to its children, child columns read in place
+    auto joined = db.query(
+        "SELECT m.rowid, m.id, i.vec_index, i.id, i.damage FROM Monster m "
+        "JOIN Monster__inventory i ON i.parent_rowid = m.rowid ORDER BY m.rowid, i.vec_index");
+    assert(joined.rowCount() == 6);
+    for (size_t r = 0; r < joined.rowCount(); r++) {
+        int64_t index = std::get<int64_t>(joined.rows[r][2]);
+        assert(std::get<int64_t>(joined.rows[r][0]) == static_cast<int64_t>(r / 2 + 1));
+        assert(std::get<int64_t>(joined.rows[r][1]) == 7);
+        assert(std::get<int64_t>(joined.rows[r][3]) == 101 + index);
+        assert(std::get<int64_t>(joined.rows[r][4]) == 11 + index);
+    }
+
+    // An IN list is one batched lookup
+    auto batch = db.query("SELECT COUNT(*), SUM(damage) FROM Monster__inventory WHERE parent_rowid IN (3, 1, 3, 99)");
+    assert(std::get<int64_t>(batch.rows[0][0]) == 4 && std::get<int64_t>(batch.rows[0][1]) == 46);
+    auto nested = db.query("SELECT SUM(damage) FROM Monster__inventory "
+                           "WHERE parent_rowid IN (SELECT rowid FROM Monster WHERE rowid > 1)");
+    assert(std::get<int64_t>(nested.rows[0][0]) == 46);
+
+    // Single-table fields and deletes
+    auto weapon = db.query("SELECT id, vec_index FROM Monster__weapon WHERE parent_rowid = 2");
+    assert(weapon.rowCount() == 1 && std::get<int64_t>(weapon.rows[0][0]) == 100);
+    assert(std::holds_alternative<std::monostate>(weapon.rows[0][1]));
+    junctions.deleteWithCascade("Monster", 2);
+    auto remaining = db.query("SELECT COUNT(*) FROM Monster__inventory");
+    assert(std::get<int64_t>(remaining.rows[0][0]) == 4);
+
+    // Compaction renumbers parents: monster 3 becomes rowid 2 and keeps
+    // its children. A parent deleted without the cascade takes its rows.
+    RowIdSlice third = junctions.getChildRowIds("Monster", "inventory", 3);
+    std::vector<uint64_t> thirdChildren(third.begin(), third.end());
+    uint64_t firstChild = junctions.getChildRowIds("Monster", "inventory", 1)[0];
+    db.markDeleted("Monster", 1);
+    db.compact();
+    assert(junctions.getChildData(firstChild, nullptr) == nullptr);
+    assert(junctions.cleanupOrphans("Weapon") == 6);  // Monsters 1 and 2: a weapon and two in inventory
+    RowIdSlice moved = junctions.getChildRowIds("Monster", "inventory", 1);
+    assert(std::vector<uint64_t>(moved.begin(), moved.end()) == thirdChildren);
+    assert(junctions.getChildRowIds("Monster", "inventory", 2).empty());
+    assert(junctions.getChildRowIds("Monster", "inventory", 3).empty());
+    assert(junctions.getChildData(thirdChildren[0], nullptr) != nullptr);
+    auto compacted = db.query(
+        "SELECT m.rowid, i.id FROM Monster m JOIN Monster__inventory i ON i.parent_rowid = m.rowid "
+        "ORDER BY i.vec_index");
+    assert(compacted.rowCount() == 2);
+    assert(std::get<int64_t>(compacted.rows[0][0]) == 1 && std::get<int64_t>(compacted.rows[0][1]) == 101);
+    assert(std::get<int64_t>(compacted.rows[1][1]) == 102);
+    auto weapons = db.query("SELECT parent_rowid, id FROM Monster__weapon");
+    assert(weapons.rowCount() == 1 && std::get<int64_t>(weapons.rows[0][0]) == 1);
+    assert(junctions.getJunctionStats("Monster__weapon").parents == 1);
+
+    std::cout << "Junction table tests passed!" << std::endl;
+}
+
+void testJunctionBatchDelete() {
+    std::cout << "Testing batch cascade delete..." << std::endl;
+
+    SchemaAnalyzer analyzer;
+    analyzer.addSchema("monster.fbs", JUNCTION_SCHEMA);
+    SchemaAnalysis analysis = analyzer.analyze();
+    auto db = FlatSQLDatabase::fromSchema(JUNCTION_SCHEMA, "junction_batch_delete");
+    db.registerFileId("MONS", "Monster");
+    JunctionManager junctions(db);
+    junctions.initialize(analysis);
+
+    std::vector<uint8_t> buf = buildMonsterWithWeapons();
+    for (int i = 0; i < 4; i++) {
+        junctions.insertWithRelations("Monster", buf);
+    }
+    uint64_t released = junctions.getChildRowIds("Monster", "inventory", 3)[0];
+
+    // Duplicates and 0 are ignored; each parent had a weapon and two in its inventory
+    assert(junctions.deleteWithCascade("Monster", std::vector<uint64_t>{3, 1, 3, 0}) == 6);
+    assert(db.getDeletedCount("Monster") == 2);
+    assert(std::get<int64_t>(db.query("SELECT COUNT(*) FROM Monster").rows[0][0]) == 2);
+    assert(junctions.getChildData(released, nullptr) == nullptr);
+    assert(junctions.getChildRowIds("Monster", "inventory", 1).empty());
+    assert(junctions.getChildRowIds("Monster", "inventory", 2).size == 2);
+    assert(junctions.getJunctionStats("Monster__inventory").rows == 4);
+
+    assert(junctions.deleteWithCascade("Monster", std::vector<uint64_t>{1}) == 0);
+    assert(junctions.cleanupOrphans("Weapon") == 6);
+    assert(junctions.cleanupOrphans("Weapon") == 0);
+
+    std::cout << "Batch cascade delete tests passed!" << std::endl;
+}
+
+void testReserveIngest() {
+    std::cout << "Testing in-place streaming ingest..." << std::endl;
+
+    // A stream of small and chunk-sized records, fed in chunks that split
+    // records at every position
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 40; i++) {
+        std::vector<uint8_t> record(i % 9 == 4 ? 120 : 12 + i % 5, static_cast<uint8_t>(i));
+        std::memcpy(record.data() + 4, i % 2 ? "USER" : "POST", 4);
+        uint32_t size = static_cast<uint32_t>(record.size());
+        stream.insert(stream.end(), reinterpret_cast<uint8_t*>(&size), reinterpret_cast<uint8_t*>(&size) + 4);
+        stream.insert(stream.end(), record.begin(), record.end());
+    }
+    const size_t chunks[] = {5, 37, 1, 90, 300, 3, 64};
+
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;
+    segmented.segmentSize = 64;
+    StreamingFlatBufferStore contiguous;
+    StreamingFlatBufferStore chunked(segmented);
+    for (StreamingFlatBufferStore* store : {&contiguous, &chunked}) {
+        size_t records = 0;
+        for (size_t pos = 0, i = 0; pos < stream.size(); i++) {
+            size_t n = std::min(chunks[i % 7], stream.size() - pos);
+            std::memcpy(store->reserveIngest(n), stream.data() + pos, n);
+            records += store->commitIngest(n, nullptr);
+            pos += n;
+        }
+        assert(records == 40);
+        assert(store->getPendingIngestBytes() == 0);
+        assert(store->getRecordCountByFileId("USER") == 20);
+
+        size_t walked = 0;
+        store->iterateRecords([&](const StoredRecord&) { walked++; return true; });
+        assert(walked == 40);
+        assert(store->exportData() == stream);
+    }
+
+    // A pending partial record blocks the copying ingest calls
+    std::memcpy(contiguous.reserveIngest(6), stream.data(), 6);
+    assert(contiguous.commitIngest(6, nullptr) == 0);
+    bool threw = false;
+    try {
+        contiguous.ingest(stream.data(), stream.size(), nullptr);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        contiguous.reserveIngest(4);
+        contiguous.commitIngest(5, nullptr);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Through the database, records are indexed and queryable as committed
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "reserve"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    std::vector<uint8_t> items;
+    for (int32_t id = 1; id <= 100; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        items.insert(items.end(), record, record + sizeof(record));
+    }
+    size_t committed = 0;
+    for (size_t pos = 0; pos < items.size(); pos += 100) {
+        size_t n = std::min<size_t>(100, items.size() - pos);
+        std::memcpy(db.reserveIngest(n), items.data() + pos, n);
+        committed += db.commitIngest(n);
+    }
+    assert(committed == 100);
+    QueryResult result = db.query("SELECT COUNT(*), SUM(id) FROM items WHERE id > 50");
+    assert(std::get<int64_t>(result.rows[0][0]) == 50);
+    assert(std::get<int64_t>(result.rows[0][1]) == 3775);
+
+    std::cout << "In-place streaming ingest tests passed!" << std::endl;
+}
+
+void testCompiledSchema() {
+    std::cout << "Testing compiled schemas and lazy tables..." << std::endl;
+
+    std::string idl = std::string(ITEMS_SCHEMA) + R"(
+        table tags {
+            label: string (key);
+            weight: float = 0.5;
+            hidden: bool = true;
+        }
+    )";
+    DatabaseSchema parsed = SchemaParser::parse(idl, "compiled");
+    std::vector<uint8_t> compiled = SchemaParser::compile(parsed);
+    DatabaseSchema loaded = SchemaParser::load(compiled.data(), compiled.size());
+
+    assert(loaded.name == "compiled");
+    assert(loaded.tables.size() == parsed.tables.size());
+    for (size_t t = 0; t < parsed.tables.size(); t++) {
+        const TableDef& a = parsed.tables[t];
+        const TableDef& b = loaded.tables[t];
+        assert(a.name == b.name && a.primaryKeyColumns == b.primaryKeyColumns);
+        assert(a.columns.size() == b.columns.size());
+        for (size_t c = 0; c < a.columns.size(); c++) {
+            const ColumnDef& x = a.columns[c];
+            const ColumnDef& y = b.columns[c];
+            assert(x.name == y.name && x.type == y.type && x.fieldId == y.fieldId);
+            assert(x.indexed == y.indexed && x.primaryKey == y.primaryKey && x.nullable == y.nullable);
+            assert(x.layoutKnown == y.layoutKnown && x.defaultValue == y.defaultValue);
+        }
+    }
+    assert(loaded.getTable("tags")->columns[1].defaultValue == Value(0.5f));
+
+    bool threw = false;
+    try {
+        SchemaParser::load(compiled.data(), compiled.size() - 1);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Neither the virtual tables nor the index tables exist until used
+    auto db = FlatSQLDatabase::fromCompiledSchema(compiled.data(), compiled.size());
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    QueryResult schemaRows = db.query("SELECT COUNT(*) FROM sqlite_master");
+    assert(std::get<int64_t>(schemaRows.rows[0][0]) == 0);
+    assert(db.query("SELECT COUNT(*) FROM items").rowCount() == 1);
+
+    ingestItems(db, 1, 50);
+    schemaRows = db.query("SELECT name FROM sqlite_master WHERE type = 'table'");
+    assert(schemaRows.rowCount() == 1);
+    assert(std::get<std::string>(schemaRows.rows[0][0]) == "_idx_items_id");
+    QueryResult result = db.query("SELECT score FROM items WHERE id = 42");
+    assert(result.rowCount() == 1 && std::get<double>(result.rows[0][0]) == 10.5);
+
+    std::cout << "Compiled schema tests passed!" << std::endl;
+}
+
+void testChunkedExport() {
+    std::cout << "Testing chunked and incremental export..." << std::endl;
+
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;
+    segmented.segmentSize = 256;
+    StreamingFlatBufferStore contiguous;
+    StreamingFlatBufferStore chunked(segmented);
+
+    // Compressible records, some larger than a chunk
+    std::vector<std::vector<uint8_t>> records;
+    for (int i = 0; i < 60; i++) {
+        std::vector<uint8_t> record(i % 13 == 5 ? 600 : 40, static_cast<uint8_t>(i % 3));
+        std::memcpy(record.data() + 4, "ITEM", 4);
+        records.push_back(record);
+        contiguous.ingestFlatBuffer(record.data(), record.size(), nullptr);
+        chunked.ingestFlatBuffer(record.data(), record.size(), nullptr);
+    }
+    chunked.compressColdSegments(1);
+    const std::vector<uint8_t> full = contiguous.exportData();
+
+    for (StreamingFlatBufferStore* store : {&contiguous, &chunked}) {
+        std::vector<uint8_t> joined;
+        size_t spans = 0;
+        uint64_t watermark = store->exportChunks([&](const uint8_t* data, size_t length) {
+            joined.insert(joined.end(), data, data + length);
+            spans++;
+            return true;
+        });
+        assert(watermark == 60);
+        assert(joined == full);
+        assert(store == &contiguous ? spans == 1 : spans > 1);
+
+        // After a watermark only the newer records come out
+        size_t prefix = 0;
+        for (int i = 0; i < 45; i++) prefix += SIZE_PREFIX_LENGTH + records[i].size();
+        assert(store->exportSince(45) == std::vector<uint8_t>(full.begin() + prefix, full.end()));
+        assert(store->exportSince(60).empty());
+        assert(store->exportChunks([](const uint8_t*, size_t) { return true; }, 60) == 60);
+
+        // Stopping early reports the last span handed out
+        uint64_t partial = store->exportChunks([](const uint8_t*, size_t) { return false; });
+        assert(partial == 0);
+    }
+
+    std::cout << "Chunked export tests passed!" << std::endl;
+}
+
+void testReplication() {
+    std::cout << "Testing leader/follower replication..." << std::endl;
+
+    FlatSQLDatabase leader(SchemaParser::parse(ITEMS_SCHEMA, "leader"));
+    FlatSQLDatabase follower(SchemaParser::parse(ITEMS_SCHEMA, "follower"));
+    for (FlatSQLDatabase* db : {&leader, &follower}) {
+        db->registerFileId("ITEM", "items");
+        db->setFieldExtractor("items", itemsExtractor);
+    }
+    auto summary = [](FlatSQLDatabase& db) {
+        auto r = db.query("SELECT COUNT(*), SUM(id) FROM items");
+        return std::make_pair(std::get<int64_t>(r.rows[0][0]), std::get<int64_t>(r.rows[0][1]));
+    };
+    // Pull and apply frames of about 30 records until the follower is current
+    auto catchUp = [&](size_t maxBytes) {
+        size_t frames = 0;
+        while (follower.getReplicaPosition() != leader.getReplicationHead()) {
+            std::vector<uint8_t> frame = leader.pullReplication(follower.getReplicaPosition(), maxBytes);
+            follower.applyReplication(frame.data(), frame.size());
+            frames++;
+        }
+        return frames;
+    };
+
+    // Tombstones from before the log reach a new follower with its snapshot
+    ingestItems(leader, 1, 100);
+    leader.markDeleted("items", std::vector<uint64_t>{3, 4});
+    leader.enableReplicationLog();
+    leader.markDeleted("items", 50);
+    assert(catchUp(16 * 30) == 4);
+    assert(follower.getDeletedCount("items") == 3);
+    assert(summary(follower) == summary(leader));
+
+    // Then records and deletes in order, a delete waiting for its record
+    ingestItems(leader, 101, 160);
+    leader.markDeleted("items", 150);
+    leader.markDeleted("items", 7);
+    std::vector<uint8_t> first = leader.pullReplication(follower.getReplicaPosition(), 16 * 30);
+    follower.applyReplication(first.data(), first.size());
+    assert(follower.getReplicaPosition().sequence == 130);
+    assert(follower.getDeletedCount("items") == 3);
+    catchUp(16 * 30);
+    assert(follower.getDeletedCount("items") == 5);
+    assert(summary(follower) == summary(leader));
+    assert(follower.query("SELECT id FROM items WHERE id = 150").rows.empty());
+
+    // A frame applies once, in order
+    bool threw = false;
+    try {
+        follower.applyReplication(first.data(), first.size());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Deletes every follower applied can go; compaction starts a new epoch
+    leader.trimReplicationLog(follower.getReplicaPosition());
+    leader.compact();
+    threw = false;
+    try {
+        leader.pullReplication(follower.getReplicaPosition());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    FlatSQLDatabase fresh(SchemaParser::parse(ITEMS_SCHEMA, "fresh"));
+    fresh.registerFileId("ITEM", "items");
+    fresh.setFieldExtractor("items", itemsExtractor);
+    std::vector<uint8_t> snapshot = leader.pullReplication(ReplicationPosition());
+    fresh.applyReplication(snapshot.data(), snapshot.size());
+    assert(fresh.getReplicaPosition() == leader.getReplicationHead());
+    assert(summary(fresh) == summary(leader));
+
+    std::cout << "Replication tests passed!" << std::endl;
+}
+
+void testShardedDatabase() {
+    std::cout << "Testing sharded database..." << std::endl;
+
+    ShardedDatabase sharded(SchemaParser::parse(ITEMS_SCHEMA, "sharded"), 4);
+    FlatSQLDatabase single(SchemaParser::parse(ITEMS_SCHEMA, "single"));
+    sharded.registerFileId("ITEM", "items");
+    sharded.setFieldExtractor("items", itemsExtractor);
+    sharded.setPartitionKey("items", "id");
+    sharded.setThreads(4);
+    single.registerFileId("ITEM", "items");
+    single.setFieldExtractor("items", itemsExtractor);
+
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 1000; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'I', 'T', 'E', 'M'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    size_t records = 0;
+    assert(sharded.ingest(stream.data(), stream.size() - 3, &records) == stream.size() - 16);
+    assert(records == 999);
+    assert(sharded.ingest(stream.data() + stream.size() - 16, 16) == 16);
+    single.ingest(stream.data(), stream.size());
+
+    // Every shard holds some, each key on the shard it hashes to
+    for (size_t i = 0; i < sharded.shardCount(); i++) {
+        auto count = sharded.shard(i).query("SELECT COUNT(*) FROM items");
+        assert(std::get<int64_t>(count.rows[0][0]) > 150);
+    }
+    assert(sharded.shardFor(int32_t(42)) == sharded.shardFor(42.0));
+    auto own = sharded.shard(sharded.shardFor(int64_t(42))).query("SELECT id FROM items WHERE id = 42");
+    assert(own.rows.size() == 1);
+
+    // Point queries go to one shard
+    auto point = sharded.queryShard(int64_t(42), "SELECT score FROM items WHERE id = ?", {int64_t(42)});
+    assert(point.rows.size() == 1 && std::get<double>(point.rows[0][0]) == 10.5);
+    assert(sharded.findByIndex("items", "id", int32_t(777)).size() == 1);
+
+    // Fan-out: all rows, then sorted rows merged in order under one limit
+    assert(sharded.query("SELECT id FROM items WHERE id > 900").rows.size() == 100);
+    auto top = sharded.query("SELECT id, score FROM items ORDER BY id DESC LIMIT 5", {},
+                             {{"id", true}}, 5);
+    assert(top.rows.size() == 5);
+    for (size_t i = 0; i < 5; i++) {
+        assert(std::get<int64_t>(top.rows[i][0]) == int64_t(1000 - i));
+    }
+
+    // Partial aggregates merge to the single database's result
+    std::vector<AggregateSpec> specs = {{AggregateSpec::Op::Count, ""},
+                                        {AggregateSpec::Op::Sum, "id"},
+                                        {AggregateSpec::Op::Avg, "score"},
+                                        {AggregateSpec::Op::Max, "id"}};
+    for (const std::string groupBy : {"", "qty"}) {
+        auto merged = sharded.aggregate("items", specs, groupBy);
+        auto expected = single.aggregate("items", specs, groupBy);
+        assert(merged.columns == expected.columns);
+        assert(merged.rows.size() == expected.rows.size());
+        for (size_t r = 0; r < merged.rows.size(); r++) {
+            for (size_t c = 0; c < merged.rows[r].size(); c++) {
+                assert(compareValues(merged.rows[r][c], expected.rows[r][c]) == 0);
+            }
+        }
+    }
+
+    std::cout << "Sharded database tests passed!" << std::endl;
+}
+
+void testRetention() {
+    std::cout << "Testing retention..." << std::endl;
+
+    // 16-byte records, so a 256-byte chunk holds ids 16k+1 .. 16k+16
+    StorageOptions options;
+    options.mode = StorageMode::Segmented;
+    options.segmentSize = 256;
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "retention"), options);
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 1000);
+    assert(db.applyRetention(1000) == 0);  // No policy yet
+
+    // By age: ids below 900 expire, but only whole chunks (through 896) go
+    RetentionPolicy byAge;
+    byAge.timestampColumn = "id";
+    byAge.maxAge = 100;
+    db.setRetentionPolicy("items", byAge);
+    assert(db.applyRetention(1000) == 56 * 256);
+    assert(db.getStorage().getEvictedSequence() == 896);
+    assert(!db.getStorage().hasRecord(896) && db.getStorage().hasRecord(897));
+    auto count = db.query("SELECT COUNT(*), MIN(id), MIN(rowid) FROM items");
+    assert(std::get<int64_t>(count.rows[0][0]) == 104);
+    assert(std::get<int64_t>(count.rows[0][1]) == 897);
+    assert(std::get<int64_t>(count.rows[0][2]) == 897);
+    assert(db.query("SELECT id FROM items WHERE id = 5").rows.empty());
+    assert(db.query("SELECT id FROM items WHERE id = 950").rows.size() == 1);
+    assert(db.findByIndex("items", "id", int32_t(100)).empty());
+    assert(db.findByIndex("items", "id", int32_t(900)).size() == 1);
+    assert(db.getDeletedCount("items") == 0);
+    assert(db.applyRetention(1000) == 0);  // The chunk holding 897 .. 899 stays
+
+    // Evicted records stay gone when tombstones are cleared
+    db.markDeleted("items", 900);
+    db.clearTombstones("items");
+    count = db.query("SELECT COUNT(*) FROM items");
+    assert(std::get<int64_t>(count.rows[0][0]) == 104);
+
+    // By size: keep the newest 800 bytes, so 897 .. 950 expire and the
+    // chunks through 944 go
+    RetentionPolicy bySize;
+    bySize.maxBytes = 50 * 16;
+    db.setRetentionPolicy("items", bySize);
+    assert(db.applyRetention() == 3 * 256);
+    count = db.query("SELECT COUNT(*), MIN(id) FROM items");
+    assert(std::get<int64_t>(count.rows[0][0]) == 56);
+    assert(std::get<int64_t>(count.rows[0][1]) == 945);
+
+    // New records keep the ring going; compaction then drops the evicted rows
+    ingestItems(db, 1001, 1064);
+    assert(db.applyRetention() == 4 * 256);
+    db.compact();
+    count = db.query("SELECT COUNT(*), MIN(id), MIN(rowid) FROM items");
+    assert(std::get<int64_t>(count.rows[0][0]) == 56);
+    assert(std::get<int64_t>(count.rows[0][1]) == 1009);
+    assert(std::get<int64_t>(count.rows[0][2]) == 1);
+    assert(db.findByIndex("items", "id", int32_t(1010)).size() == 1);
+
+    // Only segmented storage evicts
+    FlatSQLDatabase contiguous(SchemaParser::parse(ITEMS_SCHEMA, "retention_flat"));
+    contiguous.registerFileId("ITEM", "items");
+    contiguous.setRetentionPolicy("items", bySize);
+    bool threw = false;
+    try {
+        contiguous.applyRetention();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Retention tests passed!" << std::endl;
+}
+
+void testSketchAggregates() {
+    std::cout << "Testing sketch aggregates..." << std::endl;
+
+    // HyperLogLog: ~1.6% error, SQL-equal values count once, halves merge
+    // into exactly the whole
+    HyperLogLog all, low, high;
+    for (int64_t i = 0; i < 100000; i++) {
+        all.add(i);
+        (i < 50000 ? low : high).add(i);
+    }
+    assert(std::abs(static_cast<double>(all.estimate()) - 100000) < 5000);
+    low.merge(high);
+    assert(low.serialize() == all.serialize());
+    std::vector<uint8_t> bytes = all.serialize();
+    assert(HyperLogLog::deserialize(bytes.data(), bytes.size()).estimate() == all.estimate());
+    HyperLogLog seven;
+    seven.add(int32_t(7));
+    seven.add(7.0);
+    seven.add(int8_t(7));
+    seven.add(std::string("7"));
+    assert(seven.estimate() == 2);
+    assert(HyperLogLog().estimate() == 0);
+
+    // t-digest: bounded centroids, accurate tails, mergeable in any order
+    TDigest digest;
+    std::vector<TDigest> parts(4);
+    for (int i = 1; i <= 100000; i++) {
+        digest.add(i);
+        parts[(i * 7) % 4].add(i);
+    }
+    assert(std::abs(digest.quantile(0.5) - 50000) < 500);
+    assert(std::abs(digest.quantile(0.99) - 99000) < 100);
+    assert(digest.quantile(0) == 1 && digest.quantile(1) == 100000);
+    TDigest merged;
+    for (const TDigest& part : parts) merged.merge(part);
+    assert(merged.count() == 100000);
+    assert(std::abs(merged.quantile(0.9) - 90000) < 500);
+    bytes = digest.serialize();
+    assert(bytes.size() < 5000);
+    assert(TDigest::deserialize(bytes.data(), bytes.size()).quantile(0.25) == digest.quantile(0.25));
+    assert(std::isnan(TDigest().quantile(0.5)));
+
+    // SQL aggregates
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "sketch"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 1000);
+    auto result = db.query("SELECT approx_count_distinct(id), approx_count_distinct(qty), "
+                           "approx_percentile(score, 0.5), approx_percentile(name, 0.5) FROM items");
+    int64_t ids = std::get<int64_t>(result.rows[0][0]);
+    assert(ids > 980 && ids < 1020);
+    assert(std::get<int64_t>(result.rows[0][1]) == 7);
+    assert(std::abs(std::get<double>(result.rows[0][2]) - 125.125) < 1);
+    assert(std::holds_alternative<std::monostate>(result.rows[0][3]));  // Not numeric
+    auto grouped = db.query("SELECT qty, approx_count_distinct(id) FROM items GROUP BY qty ORDER BY qty");
+    assert(grouped.rows.size() == 8);
+    bool threw = false;
+    try {
+        db.query("SELECT approx_percentile(score, 2) FROM items");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // aggregate(): partial sketches of scan partitions and of shards merge
+    std::vector<AggregateSpec> specs = {{AggregateSpec::Op::ApproxCountDistinct, "qty"},
+                                        {AggregateSpec::Op::ApproxPercentile, "score", 0.9}};
+    assert(specs[1].label() == "APPROX_PERCENTILE(score, 0.9)");
+    db.setScanThreads(4);
+    auto scanned = db.aggregate("items", specs);
+    assert(std::get<int64_t>(scanned.rows[0][0]) == 7);
+    assert(std::abs(std::get<double>(scanned.rows[0][1]) - 225.125) < 1);
+
+    ShardedDatabase sharded(SchemaParser::parse(ITEMS_SCHEMA, "sketch_shards"), 3);
+    sharded.registerFileId("ITEM", "items");
+    sharded.setFieldExtractor("items", itemsExtractor);
+    std::vector<uint8_t> stream = db.exportData();
+    sharded.ingest(stream.data(), stream.size());
+    specs[0].column = "id";
+    auto fanned = sharded.aggregate("items", specs, "");
+    ids = std::get<int64_t>(fanned.rows[0][0]);
+    assert(ids > 980 && ids < 1020);
+    assert(std::abs(std::get<double>(fanned.rows[0][1]) - 225.125) < 1);
+
+    // Sketches cannot follow deletes
+    MaterializedAggregateDef def;
+    def.aggregates = {specs[0]};
+    threw = false;
+    try {
+        db.createMaterializedAggregate("items_sketch", "items", def);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Sketch aggregate tests passed!" << std::endl;
+}
+
+void testBatchRowDecode() {
+    std::cout << "Testing whole-row decoding for wide projections..." << std::endl;
+
+    static size_t batchCalls = 0;
+    BatchExtractor batch = [](const uint8_t* data, size_t length, std::vector<Value>& row) {
+        batchCalls++;
+        for (const char* field : {"id", "score", "qty", "name"}) {
+            row.push_back(itemsExtractor(data, length, field));
+        }
+    };
+
+    FlatSQLDatabase plain(SchemaParser::parse(ITEMS_SCHEMA, "batch_plain"));
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "batch"));
+    db.setBatchExtractor("items", batch);  // Before the table is registered with SQLite
+    for (FlatSQLDatabase* d : {&plain, &db}) {
+        d->registerFileId("ITEM", "items");
+        d->setFieldExtractor("items", itemsExtractor);
+        ingestItems(*d, 1, 100);
+    }
+    db.setQueryStatsEnabled(true);
+
+    // Every column read: one decode per row, nothing extracted per column
+    const std::string wide = "SELECT id, score, qty, name FROM items WHERE score >= 5 ORDER BY id";
+    batchCalls = 0;
+    QueryResult decoded = db.query(wide);
+    QueryStats stats = db.getLastQueryStats();
+    assert(batchCalls == 100 && stats.batchExtractorCalls == 100 && stats.slowExtractorCalls == 0);
+    QueryResult expected = plain.query(wide);
+    assert(decoded.rowCount() == 81 && decoded.rowCount() == expected.rowCount());
+    for (size_t i = 0; i < decoded.rowCount(); i++) {
+        for (size_t c = 0; c < 4; c++) {
+            assert(compareValues(decoded.rows[i][c], expected.rows[i][c]) == 0);
+        }
+    }
+    assert(std::holds_alternative<std::monostate>(decoded.rows[0][2]));  // id 20 has no qty
+
+    // A narrow projection keeps extracting just its column
+    batchCalls = 0;
+    assert(db.query("SELECT name FROM items WHERE name <> 'x'").rowCount() == 100);
+    stats = db.getLastQueryStats();
+    assert(batchCalls == 0 && stats.batchExtractorCalls == 0 && stats.slowExtractorCalls == 100);
+
+    std::cout << "  Whole-row decoding tests passed!" << std::endl;
+}
+
+void testProjectionScans() {
+    std::cout << "Testing projection-aware scans..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "projection"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+    db.enableColumnCache("items", "score");
+    db.setQueryStatsEnabled(true);
+
+    // Rowids and offsets come from the record infos: no record is touched
+    QueryResult keys = db.query("SELECT _rowid, _offset FROM items");
+    QueryStats stats = db.getLastQueryStats();
+    assert(keys.rowCount() == 100 && stats.rowsScanned == 100 && stats.bytesTouched == 0);
+    QueryResult full = db.query("SELECT _rowid, _offset, length(_data) FROM items");
+    assert(db.getLastQueryStats().bytesTouched == 100 * 12);
+    for (size_t i = 0; i < keys.rowCount(); i++) {
+        assert(std::get<int64_t>(keys.rows[i][0]) == static_cast<int64_t>(i + 1));
+        assert(compareValues(keys.rows[i][1], full.rows[i][1]) == 0);
+    }
+
+    // Counting over a materialized column reads the array alone
+    QueryResult counted = db.query("SELECT COUNT(*) FROM items WHERE score > 10");
+    stats = db.getLastQueryStats();
+    assert(std::get<int64_t>(counted.rows[0][0]) == 60);
+    assert(stats.bytesTouched == 0 && stats.slowExtractorCalls == 0 && stats.columnCacheReads > 0);
+
+    // Any other column needs the record again
+    itemsExtractorCalls = 0;
+    QueryResult mixed = db.query("SELECT SUM(score), COUNT(qty) FROM items");
+    stats = db.getLastQueryStats();
+    assert(std::get<double>(mixed.rows[0][0]) == 5050 / 4.0 && std::get<int64_t>(mixed.rows[0][1]) == 90);
+    assert(stats.bytesTouched == 100 * 12 && itemsExtractorCalls > 0);
+
+    std::cout << "  Projection-aware scan tests passed!" << std::endl;
+}
+
+void testClusteredCompaction() {
+    std::cout << "Testing clustered compaction..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "clustered"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+
+    // Unrouted records ahead of the table's keep their place
+    std::vector<uint8_t> other;
+    for (int32_t id = 1; id <= 20; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'O', 'T', 'H', 'R'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        other.insert(other.end(), record, record + sizeof(record));
+    }
+    db.ingest(other.data(), other.size());
+    ingestItems(db, 1, 60);
+    db.markDeleted("items", 25);  // id 5
+
+    bool threw = false;
+    try {
+        db.setClusterKey("items", "missing");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    db.setClusterKey("items", "qty");
+
+    // Records ingested and deleted between steps are clustered too
+    assert(!db.compactStep(64));
+    threw = false;
+    try {
+        db.setClusterKey("items", "");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    ingestItems(db, 61, 100);
+    db.markDeleted("items", 100);  // id 80
+    db.compact();
+    assert(db.getStorage().getRecordCount() == 118);
+
+    // Rowid order is qty order now (NULLs first, ties by id), after the
+    // unrouted records
+    QueryResult rows = db.query("SELECT _rowid, _offset, qty, id FROM items");
+    assert(rows.rowCount() == 98);
+    for (size_t i = 0; i < rows.rowCount(); i++) {
+        assert(std::get<int64_t>(rows.rows[i][0]) == static_cast<int64_t>(i + 21));
+        if (i == 0) continue;
+        const auto& prev = rows.rows[i - 1];
+        const auto& row = rows.rows[i];
+        assert(std::get<int64_t>(row[1]) > std::get<int64_t>(prev[1]));
+        int c = compareValues(prev[2], row[2]);
+        assert(c < 0 || (c == 0 && std::get<int64_t>(prev[3]) < std::get<int64_t>(row[3])));
+    }
+    assert(std::holds_alternative<std::monostate>(rows.rows[0][2]) && std::get<int64_t>(rows.rows[0][3]) == 10);
+
+    // Indexes follow the new sequences
+    QueryResult found = db.query("SELECT qty FROM items WHERE id = 50");
+    assert(found.rowCount() == 1 && std::holds_alternative<std::monostate>(found.rows[0][0]));
+    assert(db.query("SELECT qty FROM items WHERE id = 80").rowCount() == 0);
+    assert(std::get<int64_t>(db.query("SELECT qty FROM items WHERE id = 47").rows[0][0]) == 5);
+    assert(db.query("SELECT id FROM items WHERE id BETWEEN 11 AND 20").rowCount() == 10);
+
+    std::cout << "  Clustered compaction tests passed!" << std::endl;
+}
+
+void testRecordViews() {
+    std::cout << "Testing zero-copy record views..." << std::endl;
+
+    StorageOptions options;
+    options.mode = StorageMode::Segmented;
+    options.segmentSize = 256;
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "views"), options);
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+    assert(db.compressColdSegments() > 0);
+
+    auto idOf = [](const StreamingFlatBufferStore::RecordRef& ref) {
+        int32_t id;
+        std::memcpy(&id, ref.data + 8, sizeof(id));
+        return id;
+    };
+
+    // Scans read cold chunks through the iterator's own pin
+    RecordRange all = db.viewAll("items");
+    assert(all.size() == 100);
+    int32_t expected = 1;
+    for (const auto& ref : all) {
+        assert(ref.length == 12 && ref.sequence == static_cast<uint64_t>(expected));
+        assert(idOf(ref) == expected++);
+    }
+
+    RecordRange one = db.viewByIndex("items", "id", Value(int32_t(42)));
+    assert(one.size() == 1 && idOf(*one.begin()) == 42);
+    RecordRange range = db.viewByRange("items", "id", Value(int32_t(10)), Value(int32_t(19)));
+    assert(range.size() == 10);
+    expected = 10;
+    for (const auto& ref : range) assert(idOf(ref) == expected++);
+
+    // Unindexed columns are matched by a scan
+    RecordRange threes = db.viewByIndex("items", "qty", Value(int32_t(3)));
+    assert(threes.size() == 12);
+    for (const auto& ref : threes) assert(idOf(ref) % 7 == 3 && idOf(ref) % 10 != 0);
+
+    RecordRange missing = db.viewAll("missing");
+    assert(missing.empty() && missing.begin() == missing.end());
+
+    std::cout << "  Record view tests passed!" << std::endl;
+}
+
+static std::atomic<size_t> itemsViewCalls{0};
+
+static ValueView itemsViewExtractor(const uint8_t* data, size_t length, const std::string& field) {
+    itemsViewCalls++;
+    if (length < 12) return std::monostate{};
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    if (field == "id") return id;
+    if (field == "score") return id / 4.0;
+    if (field == "qty") return id % 10 == 0 ? ValueView(std::monostate{}) : ValueView(int32_t(id % 7));
+    if (field == "name") return std::string_view("item");
+    return std::monostate{};
+}
+
+void testValueViews() {
+    std::cout << "Testing non-owning value views..." << std::endl;
+
+    // Views compare exactly as the values they view
+    std::vector<Value> values = {
+        std::monostate{}, true, int8_t(-3), int32_t(7), int64_t(7), uint64_t(1) << 63, 7.0, 2.5f,
+        std::string("abc"), std::string("abd"), std::string("ab"),
+        std::vector<uint8_t>{1, 2}, std::vector<uint8_t>{1, 2, 0}, std::vector<uint8_t>{0, 9},
+    };
+    for (const auto& a : values) {
+        assert(toValue(viewOf(a)) == a);
+        for (const auto& b : values) {
+            assert(compareValueViews(viewOf(a), viewOf(b)) == compareValues(a, b));
+        }
+    }
+
+    // assignValue keeps the string already in the target
+    Value scratch = std::string(64, 'x');
+    const char* storage = std::get<std::string>(scratch).data();
+    assignValue(scratch, std::string_view("short"));
+    assert(scratch == Value(std::string("short")) && std::get<std::string>(scratch).data() == storage);
+    assignValue(scratch, int32_t(5));
+    assert(scratch == Value(int32_t(5)));
+
+    // Schema extractor views point into the record
+    DatabaseSchema parsed = SchemaParser::parseIDL(R"(
+        table gadgets {
+            id: int (id);
+            name: string (key);
+            weight: double = 1.5;
+            color: byte;
+            payload_type: ubyte;
+            payload: [ubyte];
+            tags: [ubyte];
+        }
+    )");
+    SchemaExtractor extractor(parsed.tables[0]);
+    double heavy = 9.25;
+    auto record = buildGadget(5, "fifth", &heavy, 2, {4, 5, 6});
+    const uint8_t* begin = record.data() + 4;
+    const uint8_t* end = record.data() + record.size();
+    ValueView name = extractor.extractView(begin, record.size() - 4, "name");
+    const auto& text = std::get<std::string_view>(name);
+    assert(text == "fifth");
+    assert(reinterpret_cast<const uint8_t*>(text.data()) > begin && reinterpret_cast<const uint8_t*>(text.data()) < end);
+    BytesView tags = std::get<BytesView>(extractor.extractView(begin, record.size() - 4, 6));
+    assert(tags.size == 3 && tags.data[0] == 4 && tags.data > begin && tags.data < end);
+    assert(extractor.extract(begin, record.size() - 4, "weight") == Value(9.25));
+
+    // Unindexed lookups match through the view extractor alone
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "views"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    db.setFieldViewExtractor("items", itemsViewExtractor);
+    ingestItems(db, 1, 100);
+    size_t calls = itemsExtractorCalls;
+    size_t viewCalls = itemsViewCalls;
+    auto threes = db.findByIndex("items", "qty", Value(int32_t(3)));
+    assert(threes.size() == 12);
+    RecordRange named = db.viewByRange("items", "name", Value(std::string("item")), Value(std::string("itemz")));
+    assert(named.size() == 100);
+    assert(itemsExtractorCalls == calls && itemsViewCalls > viewCalls);
+
+    bool threw = false;
+    try {
+        db.setFieldViewExtractor("missing", itemsViewExtractor);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "  Value view tests passed!" << std::endl;
+}
+
+void testArenaResults() {
+    std::cout << "Testing arena-backed query results..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "arena"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 2000);
+    db.setQueryStatsEnabled(true);
+
+    // Same rows as query(), with text copied into a few arena blocks
+    const std::string sql = "SELECT id, score, qty, name || id, x'0102' FROM items WHERE id > ?";
+    ArenaQueryResult arena;
+    db.query(sql, {Value(int64_t(0))}, arena);
+    QueryResult owned = db.query(sql, {Value(int64_t(0))});
+    assert(arena.rowCount() == 2000 && arena.columnCount() == 5 && arena.columns == owned.columns);
+    for (size_t r = 0; r < arena.rowCount(); r++) {
+        for (size_t c = 0; c < arena.columnCount(); c++) {
+            assert(arena.value(r, c) == owned.rows[r][c]);
+        }
+    }
+    assert(std::get<std::string_view>(arena[41][3]) == "item42");
+    assert(std::holds_alternative<std::monostate>(arena.at(9, 2)));
+    BytesView blob = std::get<BytesView>(arena[0][4]);
+    assert(blob.size == 2 && blob.data[1] == 2);
+    assert(arena.toQueryResult().rows == owned.rows);
+    assert(db.getLastQueryStats().rowsReturned == 2000);
+    size_t grown = arena.arenaBytes();
+    assert(grown > 0 && grown < 64 * 1024);
+
+    // Reusing the result keeps its largest block
+    db.query(sql, {Value(int64_t(1990))}, arena);
+    assert(arena.rowCount() == 10 && std::get<int64_t>(arena[0][0]) == 1991);
+    assert(arena.arenaBytes() <= grown);
+
+    // Fast-path lookups and result cache hits are copied in
+    db.query("SELECT * FROM items WHERE id = ?", {Value(int64_t(5))}, arena);
+    assert(db.getLastQueryStats().fastPath);
+    QueryResult point = db.query("SELECT * FROM items WHERE id = ?", {Value(int64_t(5))});
+    assert(arena.rowCount() == 1 && arena.columns == point.columns && arena.toQueryResult().rows == point.rows);
+    db.setResultCacheSize(1 << 20);
+    db.query("SELECT name FROM items WHERE id < 4");
+    db.query("SELECT name FROM items WHERE id < 4", {}, arena);
+    assert(db.getLastQueryStats().resultCacheHit);
+    assert(arena.rowCount() == 3 && std::get<std::string_view>(arena[2][0]) == "item");
+
+    bool threw = false;
+    try {
+        db.query("SELECT nothing FROM items", {}, arena);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "  Arena result tests passed!" << std::endl;
+}
+
+static const char* DOCS_TEXTS[] = {
+    "The quick brown fox jumps over the lazy dog",
+    "A lazy afternoon; no fox, no dog.",
+    "Fox and FOX and fox again",
+    "Brown bread and butter",
+    "Quickly, quietly: the d\xC3\xA9j\xC3\xA0 vu of foxes",
+};
+
+static Value docsExtractor(const uint8_t* data, size_t length, const std::string& field) {
+    if (length < 12) return std::monostate{};
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    if (field == "id") return id;
+    if (field == "body" || field == "title") return std::string(DOCS_TEXTS[id % 5]);
+    return std::monostate{};
+}
+
+void testFullTextIndex() {
+    std::cout << "Testing full-text indexes..." << std::endl;
+
+    auto terms = FullTextIndex::tokenize("Quick-brown FOX, d\xC3\xA9j\xC3\xA0!");
+    assert((terms == std::vector<std::string>{"quick", "brown", "fox", "d\xC3\xA9j\xC3\xA0"}));
+    assert(FullTextIndex::matches("fox -bread", DOCS_TEXTS[0]));
+    assert(!FullTextIndex::matches("fox NOT lazy", DOCS_TEXTS[1]));
+    assert(FullTextIndex::matches("bread OR cake butter", DOCS_TEXTS[3]));
+    assert(FullTextIndex::matches("quiet*", DOCS_TEXTS[4]) && !FullTextIndex::matches("-fox", DOCS_TEXTS[3]));
+
+    const char* schema = R"(
+        table docs {
+            id: int (id);
+            body: string (fulltext);
+            title: string;
+        }
+    )";
+    DatabaseSchema parsed = SchemaParser::parse(schema, "fts");
+    assert(parsed.tables[0].columns[1].fullText && parsed.tables[0].columns[1].indexed);
+    assert(SchemaParser::load(SchemaParser::compile(parsed).data(), SchemaParser::compile(parsed).size())
+               .tables[0].columns[1].fullText);
+
+    FlatSQLDatabase db(parsed);
+    db.registerFileId("DOCS", "docs");
+    db.setFieldExtractor("docs", docsExtractor);
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 50; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'D', 'O', 'C', 'S'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    db.ingest(stream.data(), stream.size());
+    db.setQueryStatsEnabled(true);
+
+    // MATCH is answered by the index alone, in rowid order
+    auto ids = [&db](const std::string& sql) {
+        std::vector<int64_t> out;
+        for (const auto& row : db.query(sql).rows) out.push_back(std::get<int64_t>(row[0]));
+        return out;
+    };
+    auto foxes = ids("SELECT id FROM docs WHERE body MATCH 'fox'");
+    assert(foxes.size() == 30 && foxes[0] == 1 && foxes[1] == 2 && foxes[2] == 5 && foxes[3] == 6);
+    QueryStats stats = db.getLastQueryStats();
+    assert(stats.indexProbes == 1 && stats.rowsScanned == 30);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'lazy dog -afternoon'").size() == 10);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'bread OR afternoon'").size() == 20);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'fox*'").size() == 40);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'D\xC3\xA9J\xC3\xA0'").size() == 10);
+    assert(ids("SELECT id FROM docs WHERE body MATCH '-fox'").empty());
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'fox' AND id < 10") ==
+           (std::vector<int64_t>{1, 2, 5, 6, 7}));
+
+    // _rank is BM25: three foxes in a short text beat one in a long text
+    QueryResult ranked = db.query(
+        "SELECT id, _rank FROM docs WHERE body MATCH 'fox' ORDER BY _rank DESC, id LIMIT 3");
+    assert(ranked.rowCount() == 3 && std::get<int64_t>(ranked.rows[0][0]) == 2);
+    assert(std::get<double>(ranked.rows[0][1]) > 0.0);
+    double first = std::get<double>(db.query("SELECT _rank FROM docs WHERE body MATCH 'fox' AND id = 1")
+                                        .rows[0][0]);
+    assert(std::get<double>(ranked.rows[0][1]) > first);
+    assert(std::holds_alternative<std::monostate>(db.query("SELECT _rank FROM docs WHERE id = 1").rows[0][0]));
+
+    // Other comparisons on the column, and MATCH without the index, scan
+    assert(ids("SELECT id FROM docs WHERE body = 'Brown bread and butter'").size() == 10);
+    assert(ids("SELECT id FROM docs WHERE title MATCH 'fox'").size() == 30);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'bread' OR id = 1").size() == 11);
+    assert(db.viewByIndex("docs", "body", Value(std::string("butter"))).size() == 10);
+
+    // Deletes drop out, and compaction and retention rebuild the postings
+    db.markDeleted("docs", 2);
+    assert(ids("SELECT id FROM docs WHERE body MATCH 'fox'").size() == 29);
+    db.compact();
+    foxes = ids("SELECT id FROM docs WHERE body MATCH 'again'");
+    assert(foxes.size() == 9 && foxes[0] == 7);
+    ranked = db.query("SELECT id FROM docs WHERE body MATCH 'fox' ORDER BY _rank DESC LIMIT 1");
+    assert(std::get<int64_t>(ranked.rows[0][0]) == 7);
+
+    assert(db.getIndexStats("docs", "body").entries == 49);
+
+    // Postings only: the text is not kept, and all() gives back the terms
+    FullTextIndex standalone("docs", "body");
+    standalone.insert(Value(std::string(DOCS_TEXTS[2])), 0, 12, 1);
+    standalone.insert(Value(std::string(DOCS_TEXTS[3])), 16, 12, 2);
+    assert(standalone.getTermCount() == 6 && standalone.estimateMatches("and fox") == 1);
+    auto entries = standalone.all();
+    assert(entries.size() == 2 && entries[1].key == Value(std::string("and bread brown butter")));
+    assert(standalone.search(Value(std::string("and"))).size() == 2);
+    assert(standalone.range(Value(std::string("a")), Value(std::string("z"))).empty());
+
+    std::cout << "  Full-text index tests passed!" << std::endl;
+}
+
+static const char* SATELLITE_NAMES[] = {
+    "STARLINK-1007", "STARLINK-1008", "STARLINK-2017", "ONEWEB-0012",
+    "IRIDIUM 33", "COSMOS 2251", "ISS (ZARYA)", "STARLNK-1007",
+};
+
+static Value satsExtractor(const uint8_t* data, size_t length, const std::string& field) {
+    if (length < 12) return std::monostate{};
+    int32_t id;
+    std::memcpy(&id, data + 8, sizeof(id));
+    if (field == "id") return id;
+    if (field == "name" || field == "alias") return std::string(SATELLITE_NAMES[id % 8]);
+    return std::monostate{};
+}
+
+void testTrigramIndex() {
+    std::cout << "Testing trigram indexes..." << std::endl;
+
+    std::string_view target;
+    uint32_t distance = 0;
+    TrigramIndex::parsePattern("a~b~3", target, distance);
+    assert(target == "a~b" && distance == 3);
+    TrigramIndex::parsePattern("x~", target, distance);
+    assert(target == "x~" && distance == TrigramIndex::DEFAULT_DISTANCE);
+    assert(TrigramIndex::within("kitten", "sitting~3") && !TrigramIndex::within("kitten", "sitting~2"));
+
+    const char* schema = R"(
+        table sats {
+            id: int (id);
+            name: string (trigram);
+            alias: string;
+        }
+    )";
+    DatabaseSchema parsed = SchemaParser::parse(schema, "trgm");
+    assert(parsed.tables[0].columns[1].trigram && parsed.tables[0].columns[1].indexed);
+    assert(SchemaParser::load(SchemaParser::compile(parsed).data(), SchemaParser::compile(parsed).size())
+               .tables[0].columns[1].trigram);
+
+    FlatSQLDatabase db(parsed);
+    db.registerFileId("SATS", "sats");
+    db.setFieldExtractor("sats", satsExtractor);
+    std::vector<uint8_t> stream;
+    for (int32_t id = 1; id <= 80; id++) {
+        uint8_t record[16] = {12, 0, 0, 0, 0x08, 0x00, 0x00, 0x00, 'S', 'A', 'T', 'S'};
+        std::memcpy(record + 12, &id, sizeof(id));
+        stream.insert(stream.end(), record, record + sizeof(record));
+    }
+    db.ingest(stream.data(), stream.size());
+    db.setQueryStatsEnabled(true);
+
+    auto ids = [&db](const std::string& sql) {
+        std::vector<int64_t> out;
+        for (const auto& row : db.query(sql).rows) out.push_back(std::get<int64_t>(row[0]));
+        return out;
+    };
+
+    // Only the trigram candidates are fetched, and the answer is the
+    // edit-distance scan's
+    auto near = ids("SELECT id FROM sats WHERE fuzzy_within(name, 'STARLINK-1007~1')");
+    QueryStats stats = db.getLastQueryStats();
+    assert(near.size() == 30 && near[0] == 1 && near[1] == 7 && near[2] == 8);
+    assert(stats.indexProbes == 1 && stats.rowsScanned == 30);
+    assert(near == ids("SELECT id FROM sats WHERE levenshtein(name, 'STARLINK-1007') <= 1"));
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(name, 'STARLINK-1007')") ==
+           ids("SELECT id FROM sats WHERE levenshtein(name, 'STARLINK-1007') <= 2"));
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(name, 'ISS~4')").empty());
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(name, 'ISS (ZARYA)~0') AND id < 20") ==
+           (std::vector<int64_t>{6, 14}));
+
+    // Other kernels only run on the shortlist
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(name, 'STARLNK-1007~1') "
+               "AND jaro_winkler(name, 'STARLNK-1007') > 0.99").size() == 10);
+
+    // Equality still goes through the wrapped index; other columns scan
+    assert(ids("SELECT id FROM sats WHERE name = 'ONEWEB-0012'").size() == 10);
+    assert(db.getIndexStats("sats", "name").entries == 80);
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(alias, 'STARLINK-1007~1')") == near);
+    assert(db.query("SELECT fuzzy_within('IRIDIUM 33', 'IRIDIUM 34~1')").rows[0][0] == Value(int64_t(1)));
+
+    // Deletes drop out, and compaction rebuilds the postings
+    db.markDeleted("sats", 7);
+    assert(ids("SELECT id FROM sats WHERE fuzzy_within(name, 'STARLINK-1007~1')").size() == 29);
+    db.compact();
+    near = ids("SELECT id FROM sats WHERE fuzzy_within(name, 'STARLINK-1007~1')");
+    assert(near.size() == 29 && near[1] == 8);
+
+    // Candidates are a superset of the matches, bounded by the estimate
+    TrigramIndex standalone("sats", "name", std::make_unique<BTreeIndex>("sats", "name", ValueType::String));
+    for (uint64_t i = 0; i < 8; i++) {
+        standalone.insert(Value(std::string(SATELLITE_NAMES[i])), i * 16, 12, i + 1);
+    }
+    auto candidates = standalone.candidates("STARLINK-1007", 1);
+    assert(candidates.size() == 3 && candidates[0].sequence == 1 && candidates[2].sequence == 8);
+    assert(standalone.estimateCandidates("STARLINK-1007", 1) >= candidates.size());
+    assert(standalone.estimateCandidates("ISS", 4) == 8 && standalone.candidates("ISS", 4).empty());
+    assert(standalone.search(Value(std::string("COSMOS 2251"))).size() == 1);
+    assert(standalone.all().size() == 8 && standalone.getTrigramCount() > 0);
+
+    std::cout << "  Trigram index tests passed!" << std::endl;
+}
+
+void testQueryCancellation() {
+    std::cout << "Testing time-sliced and cancelled queries..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "cancel_test"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 2000);
+
+    // A spent budget returns after a row; a large one runs to the end,
+    // and point lookups can run in between
+    auto sliced = db.openCursor("SELECT id FROM items");
+    QueryResult slice;
+    assert(sliced->fetchFor(10000, std::chrono::microseconds(0), slice) == 1 && !sliced->done());
+    assert(db.query("SELECT name FROM items WHERE id = 7").rowCount() == 1);
+    slice.rows.clear();
+    assert(sliced->fetchFor(10000, std::chrono::seconds(60), slice) == 1999 && sliced->done());
+    assert(slice.rows.back()[0] == Value(int64_t(2000)));
+
+    // Cancelling from another thread interrupts a step that would never end
+    auto endless = db.openCursor(
+        "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n) SELECT count(*) FROM n");
+    std::thread canceller([&endless] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        endless->cancel();
+    });
+    std::string error;
+    try {
+        endless->step();
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    canceller.join();
+    assert(error == "Query cancelled" && endless->cancelled() && endless->done());
+
+    // Later steps fail too, and other statements are unaffected
+    bool threw = false;
+    try {
+        endless->step();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    auto early = db.openCursor("SELECT id FROM items");
+    early->cancel();
+    threw = false;
+    try {
+        early->step();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(db.query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(2000)));
+
+    std::cout << "  Query cancellation tests passed!" << std::endl;
+}
+
+void testIndexAdvisor() {
+    std::cout << "Testing the index advisor..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "advisor"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 1000);
+    db.setQueryStatsEnabled(true);
+    db.setIndexAdvisorEnabled(true, 2500);
+
+    auto expected = [](int32_t last, int32_t qty) {
+        int64_t count = 0;
+        for (int32_t id = 1; id <= last; id++) {
+            if (id % 10 != 0 && id % 7 == qty) count++;
+        }
+        return count;
+    };
+    auto count = [&db](const std::string& sql) { return std::get<int64_t>(db.query(sql).rows[0][0]); };
+
+    // Full scans filtering on qty are charged to it; indexed columns are not
+    const std::string byQty = "SELECT COUNT(*) FROM items WHERE qty = 3";
+    assert(count(byQty) == expected(1000, 3));
+    assert(count(byQty) == expected(1000, 3));
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 5") == 1);
+    auto recommendations = db.getIndexRecommendations();
+    assert(recommendations.size() == 1);
+    assert(recommendations[0].table == "items" && recommendations[0].column == "qty");
+    assert(recommendations[0].scans == 2 && recommendations[0].rowsScanned == 2000 && !recommendations[0].built);
+    assert(db.buildAdvisedIndexes() == 0);  // Under the threshold
+
+    assert(count("SELECT COUNT(*) FROM items WHERE qty > 4") == expected(1000, 5) + expected(1000, 6));
+    assert(db.getLastQueryStats().indexProbes == 0);
+    assert(db.buildAdvisedIndexes() == 1);
+    assert(db.getIndexRecommendations()[0].built && db.buildAdvisedIndexes() == 0);
+
+    // Same answers, now from the index, which keeps up with ingest
+    assert(count(byQty) == expected(1000, 3));
+    QueryStats stats = db.getLastQueryStats();
+    assert(stats.indexProbes == 1 && stats.rowsScanned < 200);
+    ingestItems(db, 1001, 1100);
+    assert(count(byQty) == expected(1100, 3));
+    assert(db.getLastQueryStats().indexProbes == 1);
+    assert(count("SELECT COUNT(*) FROM items WHERE qty > 4") == expected(1100, 5) + expected(1100, 6));
+    assert(db.getIndexRecommendations()[0].scans == 3);
+
+    std::cout << "Index advisor tests passed!" << std::endl;
+}
+
+void testTracing() {
+    std::cout << "Testing tracepoints..." << std::endl;
+
+    traceClear();
+    traceRecord("quoted \"scope\"", 1000, 2500);
+    assert(traceEventCount() == 1);
+    std::string json = traceExportChromeJson();
+    assert(json.rfind("{\"traceEvents\":[", 0) == 0);
+    assert(json.find("{\"name\":\"quoted \\\"scope\\\"\",\"cat\":\"flatsql\",\"ph\":\"X\","
+                     "\"ts\":1.000,\"dur\":2.500,") != std::string::npos);
+
+    // Each thread has its own ring, kept after the thread ends
+    std::thread([] { traceRecord("worker", 0, 1); }).join();
+    assert(traceEventCount() == 2);
+
+    // A full ring overwrites its oldest events
+    for (size_t i = 0; i < TRACE_RING_EVENTS + 10; i++) traceRecord("filler", i, 1);
+    assert(traceEventCount() == TRACE_RING_EVENTS + 1);
+    json = traceExportChromeJson();
+    assert(json.find("quoted") == std::string::npos && json.find("\"worker\"") != std::string::npos);
+    traceClear();
+    assert(traceEventCount() == 0 && traceExportChromeJson().find("\"name\"") == std::string::npos);
+
+    // The library's scopes record only when compiled in
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "traced"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+    assert(std::get<int64_t>(db.query("SELECT COUNT(*) FROM items WHERE qty = 2").rows[0][0]) == 13);
+    json = traceExportChromeJson();
+    if (TRACING_COMPILED_IN) {
+        assert(json.find("\"TableStore::onIngest\"") != std::string::npos);
+        assert(json.find("\"FlatBufferVTab::xFilter\"") != std::string::npos);
+    } else {
+        assert(traceEventCount() == 0);
+    }
+    traceClear();
+
+    std::cout << "Tracing tests passed!" << std::endl;
+}
+
+void testMemoryAccounting() {
+    std::cout << "Testing memory accounting and limits..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "memory"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 5000);
+
+    auto itemsUsage = [&db]() {
+        for (const TableMemory& table : db.getMemoryUsage().tables) {
+            if (table.tableName == "items") return table;
+        }
+        assert(false);
+        return TableMemory();
+    };
+    MemoryUsage usage = db.getMemoryUsage();
+    assert(usage.storage.streamBytes >= 5000 * 16);
+    assert(usage.storage.sequenceMapBytes >= 5000 * sizeof(uint64_t));
+    assert(usage.storage.recordListBytes >= 5000 * sizeof(StreamingFlatBufferStore::FileRecordInfo));
+    TableMemory items = itemsUsage();
+    assert(items.recordInfoBytes >= 5000 * sizeof(StreamingFlatBufferStore::FileRecordInfo));
+    assert(items.indexPageBytes > 0 && items.tombstoneBytes == 0);
+    assert(usage.engine.pageCacheBytes >= items.indexPageBytes);
+    assert(usage.total() > usage.storage.total());
+    assert(db.getStats()[0].memoryBytes == items.total());
+
+    for (uint64_t sequence = 1; sequence <= 4000; sequence += 100) {
+        db.markDeleted("items", sequence);
+    }
+    assert(itemsUsage().tombstoneBytes > 0);
+
+    // Over the soft limit the result cache goes first
+    db.setResultCacheSize(1 << 20);
+    const std::string sql = "SELECT COUNT(*) FROM items WHERE qty = 3";
+    db.query(sql);
+    db.query(sql);
+    assert(db.getResultCacheStats().hits == 1 && db.getMemoryUsage().engine.resultCacheBytes > 0);
+    MemoryLimits limits;
+    limits.softBytes = 1;
+    db.setMemoryLimits(limits);
+    ingestItems(db, 5001, 5010);
+    assert(db.getMemoryLimitStats().reliefs == 1 && db.getMemoryLimitStats().compactions == 0);
+    assert(db.getResultCacheStats().entries == 0 && db.getDeletedCount("items") == 40);
+    ingestItems(db, 5011, 5020);
+    assert(db.getMemoryLimitStats().reliefs == 1);  // Measured again after MEMORY_CHECK_BYTES
+
+    // ... then deleted records, when allowed
+    limits.compactOverSoft = true;
+    db.setMemoryLimits(limits);
+    ingestItems(db, 5021, 5030);
+    assert(db.getMemoryLimitStats().compactions == 1 && db.getDeletedCount("items") == 0);
+    assert(std::get<int64_t>(db.query("SELECT COUNT(*) FROM items").rows[0][0]) == 5030 - 40);
+
+    // Over the hard limit ingest is refused before storing anything
+    limits = MemoryLimits();
+    limits.hardBytes = db.getMemoryLimitStats().footprint + 64;
+    db.setMemoryLimits(limits);
+    uint64_t records = db.getStats()[0].recordCount;
+    bool refused = false;
+    try {
+        ingestItems(db, 5031, 5130);
+    } catch (const std::runtime_error& e) {
+        refused = std::string(e.what()).find("Memory limit exceeded") != std::string::npos;
+    }
+    assert(refused && db.getStats()[0].recordCount == records);
+    assert(db.getMemoryLimitStats().rejections == 1);
+    limits.hardBytes = 0;
+    db.setMemoryLimits(limits);
+    ingestItems(db, 5031, 5130);
+    assert(db.getStats()[0].recordCount == records + 100);
+
+    std::cout << "Memory accounting tests passed!" << std::endl;
+}
+
+void testUpsert() {
+    std::cout << "Testing upsert ingest by primary key..." << std::endl;
+
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "upsert"));
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    ingestItems(db, 1, 100);
+    ingestItems(db, 1, 10);  // Sequences 101-110 repeat ids 1-10
+
+    try {
+        db.setUpsertMode("missing", true);
+        assert(false);
+    } catch (const std::runtime_error&) {}
+
+    // Enabling resolves the records already stored
+    db.setUpsertMode("items", true, true);
+    auto count = [&db](const std::string& sql) {
+        return std::get<int64_t>(db.query(sql).rows[0][0]);
+    };
+    assert(count("SELECT COUNT(*) FROM items") == 100);
+    assert(db.getDeletedCount("items") == 10);
+
+    ingestItems(db, 5, 5);  // Sequence 111
+    assert(count("SELECT COUNT(*) FROM items") == 100);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 5") == 1);
+    assert(count("SELECT rowid FROM items WHERE id = 5") == 111);
+    assert(count("SELECT rowid FROM items WHERE id = 7") == 107);
+    assert(count("SELECT rowid FROM items WHERE id = 50") == 50);
+    assert(db.getDeletedCount("items") == 11);
+
+    StoredRecord record;
+    assert(db.findOneByIndex("items", "id", Value(int64_t(5)), record));
+    assert(record.header.sequence == 111);
+    uint32_t length = 0;
+    uint64_t sequence = 0;
+    assert(db.findRawByIndex("items", "id", Value(int64_t(5)), &length, &sequence));
+    assert(length > 0 && sequence == 111);
+    assert((db.getVersions("items", Value(int64_t(5))) == std::vector<uint64_t>{111, 105, 5}));
+    assert((db.getVersions("items", Value(int32_t(50))) == std::vector<uint64_t>{50}));
+    assert(db.getVersions("items", Value(int64_t(500))).empty());
+
+    // Compaction keeps the current versions and ends the history
+    db.compact();
+    assert(db.getDeletedCount("items") == 0);
+    assert(count("SELECT COUNT(*) FROM items") == 100);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 5") == 1);
+    assert(db.getVersions("items", Value(int64_t(5))).size() == 1);
+    ingestItems(db, 5, 5);
+    assert(count("SELECT COUNT(*) FROM items") == 100);
+    assert(db.getDeletedCount("items") == 1);
+    assert(db.getVersions("items", Value(int64_t(5))).size() == 2);
+
+    // Off again, a repeated key is just another record
+    db.setUpsertMode("items", false);
+    ingestItems(db, 5, 5);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 5") == 2);
+
+    std::cout << "Upsert ingest tests passed!" << std::endl;
+}
+
+void testAsOfQueries() {
+    std::cout << "Testing AS-OF queries..." << std::endl;
+
+    StorageOptions segmented;
+    segmented.mode = StorageMode::Segmented;
+    FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "asof"), segmented);
+    db.registerFileId("ITEM", "items");
+    db.setFieldExtractor("items", itemsExtractor);
+    db.setResultCacheSize(1 << 20);
+    ingestItems(db, 1, 100);
+    auto count = [&db](const std::string& sql) {
+        return std::get<int64_t>(db.query(sql).rows[0][0]);
+    };
+    assert(count("SELECT COUNT(*) FROM items") == 100);  // Cached at the latest
+
+    uint64_t watermark = db.getVisibleSequence();
+    assert(watermark == 100);
+    auto session = db.openReadSession();
+    session->setAsOfSequence(watermark);
+    ingestItems(db, 101, 150);
+
+    // Scans, index lookups, rowid lookups and aggregate() stop at the watermark
+    db.setAsOfSequence(watermark);
+    assert(db.getAsOfSequence() == watermark);
+    assert(count("SELECT COUNT(*) FROM items") == 100);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 120") == 0);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 50") == 1);
+    assert(count("SELECT COUNT(*) FROM items WHERE id > 90") == 10);
+    assert(count("SELECT COUNT(*) FROM items WHERE rowid = 120") == 0);
+    assert(count("SELECT MAX(id) FROM items") == 100);
+    assert(db.query("SELECT id FROM items WHERE id = ?", {Value(int64_t(120))}).rows.empty());
+    auto total = db.aggregate("items", {{AggregateSpec::Op::Count, ""}});
+    assert(total.rows[0][0] == Value(int64_t(100)));
+    PreparedLookup byId = db.prepareLookup("items", "id");
+    const uint8_t* data = nullptr;
+    uint32_t length = 0;
+    assert(byId.find(int32_t(60), &data, &length));
+    assert(!byId.find(int32_t(120), &data, &length));
+
+    // Sessions keep their own watermark
+    assert(session->query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(100)));
+    session->setAsOfSequence(0);
+    assert(session->query("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(150)));
+
+    db.setAsOfSequence(0);
+    assert(count("SELECT COUNT(*) FROM items") == 150);
+    assert(count("SELECT COUNT(*) FROM items WHERE id = 120") == 1);
+    assert(byId.find(int32_t(120), &data, &length));
+
+    std::cout << "AS-OF query tests passed!" << std::endl;
+}
+
+void testCompositeIndex() {
+    std::cout << "Testing composite indexes..." << std::endl;
+
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(ITEMS_SCHEMA, "composite"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 2000);
+        db.addCompositeIndex("items", "by_qty_id", {"qty", "id"}, {"score"});
+        ingestItems(db, 2001, 2100);  // Maintained after the backfill
+        db.markDeleted("items", 108);  // qty 3
+
+        // Equality on qty and a range on id is one key range
+        auto strategyOf = [&db](const char* sql) {
+            auto plan = db.query(std::string("EXPLAIN QUERY PLAN ") + sql);
+            const std::string& detail = std::get<std::string>(plan.rows[0][3]);
+            size_t at = detail.find("INDEX ");
+            return at == std::string::npos ? -1 : std::stoi(detail.substr(at + 6)) & 0x0F;
+        };
+        assert(strategyOf("SELECT id FROM items WHERE qty = 3 AND id BETWEEN 100 AND 300") == 9);
+        assert(strategyOf("SELECT id, score FROM items WHERE qty = 3 AND id < 500") == 9);
+
+        const char* queries[][2] = {
+            {"SELECT id FROM items WHERE qty = 3 AND id BETWEEN 100 AND 300",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 BETWEEN 100 AND 300"},
+            {"SELECT id FROM items WHERE qty = 3 AND id > 2050",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 > 2050"},
+            {"SELECT id FROM items WHERE qty = 5 AND id > 10.5 AND id < 90 AND name = 'item'",
+             "SELECT id FROM items WHERE qty + 0 = 5 AND id + 0 > 10.5 AND id + 0 < 90 AND name = 'item'"},
+            {"SELECT id FROM items WHERE qty = 3 AND id < 0",
+             "SELECT id FROM items WHERE qty + 0 = 3 AND id + 0 < 0"},
+            {"SELECT id FROM items WHERE qty IS NULL AND id <= 100",
+             "SELECT id FROM items WHERE qty + 0 IS NULL AND id + 0 <= 100"},
+        };
+        for (const auto& query : queries) {
+            auto actual = db.query(std::string(query[0]) + " ORDER BY id");
+            auto expected = db.query(std::string(query[1]) + " ORDER BY id");
+            assert(actual.rows.size() == expected.rows.size());
+            for (size_t r = 0; r < actual.rows.size(); r++) {
+                assert(compareValues(actual.rows[r][0], expected.rows[r][0]) == 0);
+            }
+        }
+
+        // Reading only indexed columns decodes them from the keys
+        db.setQueryStatsEnabled(true);
+        auto covered = db.query("SELECT id, score FROM items WHERE qty = 3 AND id < 500 ORDER BY id DESC");
+        QueryStats stats = db.getLastQueryStats();
+        db.setQueryStatsEnabled(false);
+        assert(stats.coveredReads > 0 && stats.bytesTouched == 0);
+        auto expected = db.query("SELECT id, score FROM items WHERE qty + 0 = 3 AND id + 0 < 500 ORDER BY id DESC");
+        assert(!expected.rows.empty() && covered.rows.size() == expected.rows.size());
+        for (size_t r = 0; r < covered.rows.size(); r++) {
+            assert(compareValues(covered.rows[r][0], expected.rows[r][0]) == 0);
+            assert(compareValues(covered.rows[r][1], expected.rows[r][1]) == 0);
+        }
+
+        bool threw = false;
+        try { db.addCompositeIndex("items", "by_qty_id", {"qty", "score"}); } catch (const std::runtime_error&) { threw = true; }
+        assert(threw);
+        threw = false;
+        try { db.addCompositeIndex("items", "bad", {"qty", "missing"}); } catch (const std::runtime_error&) { threw = true; }
+        assert(threw);
+    }
+
+    std::cout << "Composite index tests passed!" << std::endl;
+}
+
+void testAggregatePushdown() {
+    std::cout << "Testing aggregate pushdown..." << std::endl;
+
+    const char* schema = R"(
+        table items {
+            id: int (id);
+            score: double;
+            qty: int (key);
+            name: string;
+        }
+    )";
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db(SchemaParser::parse(schema, "pushdown"), StorageOptions(), engine);
+        db.registerFileId("ITEM", "items");
+        db.setFieldExtractor("items", itemsExtractor);
+        ingestItems(db, 1, 500);
+        db.markDeleted("items", 1);    // The lowest id
+        db.markDeleted("items", 500);  // The highest
+        db.markDeleted("items", 103);  // qty 5
+
+        db.setQueryStatsEnabled(true);
+        auto pushed = [&db](const std::string& sql, const std::vector<Value>& params = {}) {
+            auto result = db.query(sql, params);
+            assert(db.getLastQueryStats().fastPath && db.getLastQueryStats().rowsScanned == 0);
+            return result;
+        };
+        auto sameAs = [&db](const QueryResult& actual, const std::string& sql, const std::vector<Value>& params = {}) {
+            auto expected = db.query(sql, params);
+            assert(!db.getLastQueryStats().fastPath);
+            assert(actual.rows.size() == 1 && expected.rows.size() == 1);
+            assert(actual.rows[0][0] == expected.rows[0][0]);
+        };
+
+        auto total = pushed("SELECT COUNT(*) FROM items");
+        assert(total.columns[0] == "COUNT(*)" && total.rows[0][0] == Value(int64_t(497)));
+        sameAs(total, "SELECT COUNT(*) FROM items WHERE 1");
+        sameAs(pushed("select count(*) from ITEMS where id between ? and ?", {Value(int64_t(1)), Value(int64_t(50))}),
+               "SELECT COUNT(*) FROM items WHERE id + 0 BETWEEN 1 AND 50");
+        sameAs(pushed("SELECT COUNT(*) FROM items WHERE id BETWEEN ? AND ?", {Value(10.5), Value(int64_t(20))}),
+               "SELECT COUNT(*) FROM items WHERE id + 0 BETWEEN 10.5 AND 20");
+        sameAs(pushed("SELECT COUNT(*) FROM items WHERE qty = ?", {Value(int64_t(5))}),
+               "SELECT COUNT(*) FROM items WHERE qty + 0 = 5");
+        assert(pushed("SELECT COUNT(*) FROM items WHERE qty = ?", {Value()}).rows[0][0] == Value(int64_t(0)));
+        auto lowest = pushed("SELECT MIN(id) FROM items");
+        assert(lowest.columns[0] == "MIN(id)" && lowest.rows[0][0] == Value(int64_t(2)));
+        sameAs(lowest, "SELECT MIN(id + 0) FROM items");
+        sameAs(pushed("SELECT MAX(id) FROM items;"), "SELECT MAX(id + 0) FROM items");
+        sameAs(pushed("SELECT MAX(qty) FROM items"), "SELECT MAX(qty + 0) FROM items");
+
+        // Unindexed columns, other parameter types and other forms run in SQLite
+        sameAs(db.query("SELECT MAX(score) FROM items"), "SELECT MAX(score + 0) FROM items");
+        sameAs(db.query("SELECT COUNT(*) FROM items WHERE id BETWEEN ? AND ?", {Value(std::string("1")), Value(int64_t(9))}),
+               "SELECT COUNT(*) FROM items WHERE id BETWEEN 1 AND 9");
+        sameAs(db.query("SELECT COUNT(*) FROM items WHERE id > ?", {Value(int64_t(400))}),
+               "SELECT COUNT(*) FROM items WHERE id + 0 > 400");
+
+        // Counts and extents follow the AS-OF watermark
+        db.setAsOfSequence(100);
+        assert(pushed("SELECT COUNT(*) FROM items").rows[0][0] == Value(int64_t(99)));
+        assert(pushed("SELECT MAX(id) FROM items").rows[0][0] == Value(int64_t(100)));
+        db.setAsOfSequence(0);
+        db.setQueryStatsEnabled(false);
+    }
+
+    std::cout << "Aggregate pushdown tests passed!" << std::endl;
+}
+
+void testVerificationModes() {
+    std::cout << "Testing record verification modes..." << std::endl;
+
+    const char* schema = R"(
+        enum Color : byte { Red, Green, Blue }
+        union Payload { Gadget }
+        table gadgets {
+            id: int (id);
+            name: string (key);
+            weight: double = 1.5;
+            color: Color;
+            payload: Payload;
+            tags: [ubyte];
+            rank: short = 7;
+        }
+    )";
+    double heavy = 9.25;
+    auto streamOf = [&heavy](int32_t first, int32_t last, int32_t corrupt) {
+        std::vector<uint8_t> stream;
+        for (int32_t id = first; id <= last; id++) {
+            std::string name = "gadget" + std::to_string(id);
+            auto record = buildGadget(id, name.c_str(), &heavy, int8_t(id % 3), {1, 2});
+            if (id == corrupt) {
+                uint32_t past = 1 << 20;  // name offset past the buffer
+                std::memcpy(record.data() + 4 + 28 + 16, &past, 4);
+            }
+            stream.insert(stream.end(), record.begin(), record.end());
+        }
+        return stream;
+    };
+    auto throws = [](const std::function<void()>& fn, const char* text) {
+        try {
+            fn();
+        } catch (const std::runtime_error& e) {
+            return std::string(e.what()).find(text) != std::string::npos;
+        }
+        return false;
+    };
+
+    // The layout check itself
+    SchemaExtractor layout(SchemaParser::parseIDL(schema).tables[0]);
+    auto good = buildGadget(7, "seven", &heavy, 1, {3});
+    assert(layout.verify(good.data() + 4, good.size() - 4));
+    assert(!layout.verify(good.data() + 4, 30));
+    assert(!layout.verify(good.data() + 4, 6));
+    auto bad = streamOf(1, 1, 1);
+    assert(!layout.verify(bad.data() + 4, bad.size() - 4));
+
+    // Strict: the whole call is refused before anything is stored
+    {
+        FlatSQLDatabase db = FlatSQLDatabase::fromSchema(schema, "strict");
+        db.registerFileId("GDGT", "gadgets");
+        db.setIngestThreads(4);
+        db.setVerificationMode(VerificationMode::Strict);
+        assert(db.getVerificationMode("gadgets") == VerificationMode::Strict);
+        auto stream = streamOf(1, 600, 403);
+        assert(throws([&] { db.ingest(stream.data(), stream.size()); }, "failed for record 402"));
+        assert(db.query("SELECT COUNT(*) FROM gadgets").rows[0][0] == Value(int64_t(0)));
+        assert(db.getVerificationFailures("gadgets") == 1);
+        auto one = streamOf(2, 2, 2);
+        assert(throws([&] { db.ingestOne(one.data() + 4, one.size() - 4); }, "failed for record 0"));
+        assert(throws([&] { db.reserveIngest(64); }, "Strict verification"));
+
+        auto clean = streamOf(1, 600, 0);
+        db.ingest(clean.data(), clean.size());
+        assert(db.query("SELECT COUNT(*) FROM gadgets").rows[0][0] == Value(int64_t(600)));
+        assert(db.getVerificationFailures("gadgets") == 2);
+    }
+
+    // Lazy: stored unchecked, then the first statement reading it fails
+    {
+        FlatSQLDatabase db = FlatSQLDatabase::fromSchema(schema, "lazy");
+        db.registerFileId("GDGT", "gadgets");
+        db.setVerificationMode("gadgets", VerificationMode::Lazy);
+        auto stream = streamOf(1, 100, 40);
+        db.ingest(stream.data(), stream.size());
+        assert(db.query("SELECT COUNT(*) FROM gadgets").rows[0][0] == Value(int64_t(100)));
+        assert(db.getVerificationFailures("gadgets") == 0);
+
+        auto row = db.query("SELECT name FROM gadgets WHERE id = 39");
+        assert(row.rowCount() == 1 && row.rows[0][0] == Value(std::string("gadget39")));
+        assert(throws([&] { db.query("SELECT * FROM gadgets WHERE id = 40"); }, "failed for record 40"));
+        assert(throws([&] { db.query("SELECT SUM(color) FROM gadgets"); }, "failed for record 40"));
+        assert(db.getVerificationFailures("gadgets") == 1);  // Kept, not checked again
+        auto rest = db.query("SELECT COUNT(name) FROM gadgets WHERE id >= 90");  // Never reaches it
+        assert(rest.rows[0][0] == Value(int64_t(11)));
+        assert(db.getMemoryUsage().tables[0].verificationBytes > 0);
+
+        // Trusted again: the malformed field reads as NULL
+        db.setVerificationMode("gadgets", VerificationMode::Trusted);
+        auto trusted = db.query("SELECT name FROM gadgets WHERE id = 40");
+        assert(std::holds_alternative<std::monostate>(trusted.rows[0][0]));
+        assert(throws([&] { db.setVerificationMode("nope", VerificationMode::Lazy); }, "Table not found"));
+    }
+
+    std::cout << "Verification mode tests passed!" << std::endl;
+}
+
+void testSchemaEvolution() {
+    std::cout << "Testing schema evolution without re-ingest..." << std::endl;
+
+    const std::string v1 = R"(
+        enum Color : byte { Red, Green, Blue }
+        table gadgets {
+            id: int (id);
+            name: string (key);
+            weight: double = 1.5;
+            color: Color;
+        }
+    )";
+    // Adds the fields the records already carry, indexes one of them and
+    // an old column, and adds a table
+    const std::string v2 = R"(
+        enum Color : byte { Red, Green, Blue }
+        union Payload { Gadget }
+        table gadgets {
+            id: int (id);
+            name: string (key);
+            weight: double = 1.5;
+            color: Color (key);
+            payload: Payload;
+            tags: [ubyte];
+            rank: short = 7 (key);
+        }
+        table widgets {
+            id: int (id);
+        }
+    )";
+    auto contains = [](const std::function<void()>& fn, const char* text) {
+        try {
+            fn();
+        } catch (const std::runtime_error& e) {
+            return std::string(e.what()).find(text) != std::string::npos;
+        }
+        return false;
+    };
+    auto ingestGadgets = [](FlatSQLDatabase& db, int32_t first, int32_t last) {
+        double heavy = 9.25;
+        std::vector<uint8_t> stream;
+        for (int32_t id = first; id <= last; id++) {
+            std::string name = "gadget" + std::to_string(id);
+            auto record = buildGadget(id, name.c_str(), &heavy, int8_t(id % 3), {uint8_t(id % 7), 1});
+            stream.insert(stream.end(), record.begin(), record.end());
+        }
+        db.ingest(stream.data(), stream.size());
+    };
+
+    for (IndexEngine engine : {IndexEngine::Sqlite, IndexEngine::BTree}) {
+        FlatSQLDatabase db = FlatSQLDatabase::fromSchema(v1, "evolving", StorageOptions(), engine);
+        db.registerFileId("GDGT", "gadgets");
+        ingestGadgets(db, 1, 300);
+        assert(db.query("SELECT COUNT(*) FROM gadgets").rows[0][0] == Value(int64_t(300)));
+        assert(contains([&] { db.query("SELECT tags FROM gadgets"); }, "no such column"));
+        assert(db.getSchemaVersion() == 1 && db.evolveSchema(v1) == 1);
+
+        // Incompatible versions are refused before anything changes
+        assert(contains([&] { db.evolveSchema("table gadgets { id: int (id); name: string (key); }"); },
+                        "cannot be removed"));
+        assert(contains([&] {
+            db.evolveSchema("table gadgets { id: long (id); name: string (key); weight: double; color: byte; }");
+        }, "cannot change"));
+        assert(db.getSchemaVersion() == 1);
+
+        assert(db.evolveSchema(v2) == 2);
+        assert(db.getSchema().getTable("widgets") && db.getSchema().getTable("gadgets")->columns.size() == 7);
+        auto row = db.query("SELECT id, tags, rank FROM gadgets WHERE id = 12");
+        assert(row.rowCount() == 1);
+        assert(row.rows[0][1] == Value(std::vector<uint8_t>{5, 1}));
+        assert(row.rows[0][2] == Value(int64_t(7)));  // Absent from every record: the default
+
+        // Records ingested from now on go straight into the new indexes,
+        // the stored ones are backfilled in steps
+        ingestGadgets(db, 301, 350);
+        assert(contains([&] { db.getIndexStats("gadgets", "color"); }, ""));
+        auto greens = db.query("SELECT COUNT(*) FROM gadgets WHERE color = 1");
+        assert(greens.rows[0][0] == Value(int64_t(117)));
+        size_t steps = 1;
+        while (!db.backfillStep(128)) steps++;
+        assert(steps == 5);  // 300 records for each of two indexes
+        assert(db.getIndexStats("gadgets", "color").entries == 350);
+        assert(db.getIndexStats("gadgets", "rank").entries == 350);
+
+        db.setQueryStatsEnabled(true);
+        auto indexed = db.query("SELECT id FROM gadgets WHERE color = 2 AND id > 340 ORDER BY id");
+        assert(indexed.rowCount() == 4 && indexed.rows[0][0] == Value(int64_t(341)));
+        assert(db.query("SELECT COUNT(*) FROM gadgets WHERE color = 1").rows[0][0] == Value(int64_t(117)));
+        assert(db.getLastQueryStats().indexProbes == 1 && db.getLastQueryStats().rowsScanned == 117);
+        assert(db.backfillStep());
+    }
+
+    std::cout << "Schema evolution tests passed!" << std::endl;
+}
+
 int main() {
     std::cout << "=== FlatSQL Test Suite ===" << std::endl;
     std::cout << std::endl;
@@ -724,8 +5691,74 @@ int main() {
         testSchemaParser();
         testSQLiteEngine();
         testSqliteIndex();
+        testBTreeIndex();
         testStorage();
+        testSegmentedStorage();
+        testMappedStorage();
         testDatabase();
+        testParallelIngest();
+        testConcurrentReaders();
+        testColumnCache();
+        testKeyExtractor();
+        testPreparedLookup();
+        testBatchedLookup();
+        testIndexStatistics();
+        testIndexIntersection();
+        testIndexRangeCursor();
+        testOrderLimitPushdown();
+        testScanPredicatePushdown();
+        testCompaction();
+        testUnifiedVTab();
+        testParallelAggregate();
+        testGeoIndex();
+        testGeoBatchScan();
+        testZoneMaps();
+        testBloomFilters();
+        testColdSegments();
+        testDictionaryIndex();
+        testFileIdRouting();
+        testFieldCipher();
+        testVerifiedIngest();
+        testStreamIngestor();
+        testIngestServer();
+        testSubscriptions();
+        testMaterializedAggregates();
+        testResultCache();
+        testEngineCacheLimits();
+        testQueryStats();
+        testJunctionChildViews();
+        testJunctionAdjacency();
+        testJunctionJoin();
+        testJunctionBatchDelete();
+        testReserveIngest();
+        testCompiledSchema();
+        testChunkedExport();
+        testReplication();
+        testShardedDatabase();
+        testRetention();
+        testSketchAggregates();
+        testBatchRowDecode();
+        testProjectionScans();
+        testClusteredCompaction();
+        testRecordViews();
+        testValueViews();
+        testArenaResults();
+        testFullTextIndex();
+        testTrigramIndex();
+        testQueryCancellation();
+        testIndexAdvisor();
+        testTracing();
+        testMemoryAccounting();
+        testUpsert();
+        testAsOfQueries();
+        testCompositeIndex();
+        testAggregatePushdown();
+        testVerificationModes();
+        testSchemaEvolution();
+        testEncryptedColumns();
+        testResultBuffer();
+        testQueryCursor();
+        testSchemaExtractor();
         testSchemaAnalyzer();
         testCycleDetection();
         testJunctionManager();
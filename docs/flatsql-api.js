@@ -7,6 +7,18 @@ let api = null;
 export async function initFlatSQL(moduleFactory) {
     Module = await moduleFactory();
 
+    // C API v2 keeps result and error state per database handle; older
+    // builds keep it global, so the handle argument is dropped for them
+    const perHandleState = typeof Module._flatsql_api_version === 'function' &&
+        Module._flatsql_api_version() >= 2;
+    const cwrapScoped = (name, returnType, argTypes) => {
+        if (perHandleState) {
+            return Module.cwrap(name, returnType, ['number', ...argTypes]);
+        }
+        const fn = Module.cwrap(name, returnType, argTypes);
+        return (handle, ...args) => fn(...args);
+    };
+
     // Wrap C functions using cwrap
     api = {
         // Database lifecycle
@@ -25,25 +37,25 @@ export async function initFlatSQL(moduleFactory) {
         ingestWithSource: Module.cwrap('flatsql_ingest_with_source', 'number', ['number', 'number', 'number', 'string']),
         ingestOneWithSource: Module.cwrap('flatsql_ingest_one_with_source', 'number', ['number', 'number', 'number', 'string']),
         getSourcesCount: Module.cwrap('flatsql_get_sources_count', 'number', ['number']),
-        getSourceName: Module.cwrap('flatsql_get_source_name', 'string', ['number']),
+        getSourceName: cwrapScoped('flatsql_get_source_name', 'string', ['number']),
 
         // Query execution
         query: Module.cwrap('flatsql_query', 'number', ['number', 'string']),
-        getError: Module.cwrap('flatsql_get_error', 'string', []),
+        getError: cwrapScoped('flatsql_get_error', 'string', []),
 
         // Result access
-        resultColumnCount: Module.cwrap('flatsql_result_column_count', 'number', []),
-        resultRowCount: Module.cwrap('flatsql_result_row_count', 'number', []),
-        resultColumnName: Module.cwrap('flatsql_result_column_name', 'string', ['number']),
-        resultCellType: Module.cwrap('flatsql_result_cell_type', 'number', ['number', 'number']),
-        resultCellNumber: Module.cwrap('flatsql_result_cell_number', 'number', ['number', 'number']),
-        resultCellString: Module.cwrap('flatsql_result_cell_string', 'string', ['number', 'number']),
-        resultCellBlob: Module.cwrap('flatsql_result_cell_blob', 'number', ['number', 'number']),
-        resultCellBlobSize: Module.cwrap('flatsql_result_cell_blob_size', 'number', ['number', 'number']),
+        resultColumnCount: cwrapScoped('flatsql_result_column_count', 'number', []),
+        resultRowCount: cwrapScoped('flatsql_result_row_count', 'number', []),
+        resultColumnName: cwrapScoped('flatsql_result_column_name', 'string', ['number']),
+        resultCellType: cwrapScoped('flatsql_result_cell_type', 'number', ['number', 'number']),
+        resultCellNumber: cwrapScoped('flatsql_result_cell_number', 'number', ['number', 'number']),
+        resultCellString: cwrapScoped('flatsql_result_cell_string', 'string', ['number', 'number']),
+        resultCellBlob: cwrapScoped('flatsql_result_cell_blob', 'number', ['number', 'number']),
+        resultCellBlobSize: cwrapScoped('flatsql_result_cell_blob_size', 'number', ['number', 'number']),
 
         // Export/Import
         exportData: Module.cwrap('flatsql_export_data', 'number', ['number']),
-        exportSize: Module.cwrap('flatsql_export_size', 'number', []),
+        exportSize: cwrapScoped('flatsql_export_size', 'number', []),
         loadAndRebuild: Module.cwrap('flatsql_load_and_rebuild', null, ['number', 'number', 'number']),
 
         // Test helpers
@@ -53,9 +65,9 @@ export async function initFlatSQL(moduleFactory) {
 
         // Stats
         getStatsCount: Module.cwrap('flatsql_get_stats_count', 'number', ['number']),
-        getStatTableName: Module.cwrap('flatsql_get_stat_table_name', 'string', ['number']),
-        getStatFileId: Module.cwrap('flatsql_get_stat_file_id', 'string', ['number']),
-        getStatRecordCount: Module.cwrap('flatsql_get_stat_record_count', 'number', ['number']),
+        getStatTableName: cwrapScoped('flatsql_get_stat_table_name', 'string', ['number']),
+        getStatFileId: cwrapScoped('flatsql_get_stat_file_id', 'string', ['number']),
+        getStatRecordCount: cwrapScoped('flatsql_get_stat_record_count', 'number', ['number']),
 
         // Delete support
         markDeleted: Module.cwrap('flatsql_mark_deleted', null, ['number', 'string', 'number']),
@@ -65,8 +77,8 @@ export async function initFlatSQL(moduleFactory) {
         // Raw FlatBuffer access
         getFlatBufferById: Module.cwrap('flatsql_get_flatbuffer_by_id', 'number', ['number', 'string', 'number']),
         getFlatBufferByEmail: Module.cwrap('flatsql_get_flatbuffer_by_email', 'number', ['number', 'string', 'string']),
-        getRawFlatBufferSize: Module.cwrap('flatsql_get_raw_flatbuffer_size', 'number', []),
-        getRawFlatBufferSequence: Module.cwrap('flatsql_get_raw_flatbuffer_sequence', 'number', []),
+        getRawFlatBufferSize: cwrapScoped('flatsql_get_raw_flatbuffer_size', 'number', []),
+        getRawFlatBufferSequence: cwrapScoped('flatsql_get_raw_flatbuffer_sequence', 'number', []),
         getStorageBuffer: Module.cwrap('flatsql_get_storage_buffer', 'number', ['number']),
         getStorageSize: Module.cwrap('flatsql_get_storage_size', 'number', ['number']),
     };
@@ -78,6 +90,9 @@ export async function initFlatSQL(moduleFactory) {
 export class FlatSQL {
     createDatabase(schema, dbName = 'default') {
         const handle = api.createDb(schema, dbName);
+        if (!handle) {
+            throw new Error(api.getError(0));
+        }
         return new FlatSQLDatabase(handle);
     }
 
@@ -160,7 +175,7 @@ export class FlatSQLDatabase {
         const count = api.getSourcesCount(this._handle);
         const sources = [];
         for (let i = 0; i < count; i++) {
-            sources.push(api.getSourceName(i));
+            sources.push(api.getSourceName(this._handle, i));
         }
         return sources;
     }
@@ -168,41 +183,41 @@ export class FlatSQLDatabase {
     query(sql) {
         const success = api.query(this._handle, sql);
         if (!success) {
-            throw new Error(api.getError());
+            throw new Error(api.getError(this._handle));
         }
 
         // Read results
-        const colCount = api.resultColumnCount();
-        const rowCount = api.resultRowCount();
+        const colCount = api.resultColumnCount(this._handle);
+        const rowCount = api.resultRowCount(this._handle);
 
         const columns = [];
         for (let i = 0; i < colCount; i++) {
-            columns.push(api.resultColumnName(i));
+            columns.push(api.resultColumnName(this._handle, i));
         }
 
         const rows = [];
         for (let r = 0; r < rowCount; r++) {
             const row = [];
             for (let c = 0; c < colCount; c++) {
-                const type = api.resultCellType(r, c);
+                const type = api.resultCellType(this._handle, r, c);
                 switch (type) {
                     case 0: // null
                         row.push(null);
                         break;
                     case 1: // bool
-                        row.push(api.resultCellNumber(r, c) !== 0);
+                        row.push(api.resultCellNumber(this._handle, r, c) !== 0);
                         break;
                     case 2: // int32
                     case 3: // int64
                     case 4: // double
-                        row.push(api.resultCellNumber(r, c));
+                        row.push(api.resultCellNumber(this._handle, r, c));
                         break;
                     case 5: // string
-                        row.push(api.resultCellString(r, c));
+                        row.push(api.resultCellString(this._handle, r, c));
                         break;
                     case 6: // blob
-                        const blobPtr = api.resultCellBlob(r, c);
-                        const blobSize = api.resultCellBlobSize(r, c);
+                        const blobPtr = api.resultCellBlob(this._handle, r, c);
+                        const blobSize = api.resultCellBlobSize(this._handle, r, c);
                         if (blobPtr && blobSize > 0) {
                             row.push(Array.from(new Uint8Array(Module.HEAPU8.buffer, blobPtr, blobSize)));
                         } else {
@@ -221,7 +236,7 @@ export class FlatSQLDatabase {
 
     exportData() {
         const ptr = api.exportData(this._handle);
-        const size = api.exportSize();
+        const size = api.exportSize(this._handle);
         return new Uint8Array(Module.HEAPU8.buffer, ptr, size).slice();
     }
 
@@ -237,9 +252,9 @@ export class FlatSQLDatabase {
         const stats = [];
         for (let i = 0; i < count; i++) {
             stats.push({
-                tableName: api.getStatTableName(i),
-                fileId: api.getStatFileId(i),
-                recordCount: api.getStatRecordCount(i)
+                tableName: api.getStatTableName(this._handle, i),
+                fileId: api.getStatFileId(this._handle, i),
+                recordCount: api.getStatRecordCount(this._handle, i)
             });
         }
         return stats;
@@ -269,8 +284,8 @@ export class FlatSQLDatabase {
         if (!ptr) return null;
         return {
             ptr: ptr,
-            size: api.getRawFlatBufferSize(),
-            sequence: api.getRawFlatBufferSequence()
+            size: api.getRawFlatBufferSize(this._handle),
+            sequence: api.getRawFlatBufferSequence(this._handle)
         };
     }
 
@@ -283,8 +298,8 @@ export class FlatSQLDatabase {
         if (!ptr) return null;
         return {
             ptr: ptr,
-            size: api.getRawFlatBufferSize(),
-            sequence: api.getRawFlatBufferSequence()
+            size: api.getRawFlatBufferSize(this._handle),
+            sequence: api.getRawFlatBufferSequence(this._handle)
         };
     }
 
@@ -42,6 +42,13 @@ cp build-wasm/flatsql.js build-wasm/flatsql.wasm "$PROJECT_ROOT/wasm/"
 if [ -f build-wasm/flatsql-wasi.wasm ]; then
     cp build-wasm/flatsql-wasi.wasm "$PROJECT_ROOT/wasm/"
 fi
+# Multithreaded build (older Emscripten versions emit a separate pthread worker script)
+if [ -f build-wasm/flatsql-mt.wasm ]; then
+    cp build-wasm/flatsql-mt.js build-wasm/flatsql-mt.wasm "$PROJECT_ROOT/wasm/"
+    if [ -f build-wasm/flatsql-mt.worker.js ]; then
+        cp build-wasm/flatsql-mt.worker.js "$PROJECT_ROOT/wasm/"
+    fi
+fi
 
 # Generate integrity hash for WASM file (SHA-384, base64 encoded)
 echo "Generating integrity hash..."
@@ -49,15 +56,34 @@ WASM_FILE="$PROJECT_ROOT/wasm/flatsql.wasm"
 WASM_SIZE=$(wc -c < "$WASM_FILE" | tr -d ' ')
 
 # Generate SHA-384 hash (compatible with SRI)
-if command -v shasum &> /dev/null; then
-    WASM_HASH=$(shasum -a 384 "$WASM_FILE" | cut -d' ' -f1 | xxd -r -p | base64)
-elif command -v sha384sum &> /dev/null; then
-    WASM_HASH=$(sha384sum "$WASM_FILE" | cut -d' ' -f1 | xxd -r -p | base64)
+sha384_base64() {
+    if command -v shasum &> /dev/null; then
+        shasum -a 384 "$1" | cut -d' ' -f1 | xxd -r -p | base64
+    elif command -v sha384sum &> /dev/null; then
+        sha384sum "$1" | cut -d' ' -f1 | xxd -r -p | base64
+    fi
+}
+if command -v shasum &> /dev/null || command -v sha384sum &> /dev/null; then
+    WASM_HASH=$(sha384_base64 "$WASM_FILE")
 else
     echo "Warning: No sha384 command found, skipping integrity hash generation"
     WASM_HASH=""
 fi
 
+# The multithreaded build's hash goes under "threads"
+THREADS_ENTRY=""
+MT_FILE="$PROJECT_ROOT/wasm/flatsql-mt.wasm"
+if [ -n "$WASM_HASH" ] && [ -f "$MT_FILE" ]; then
+    MT_HASH=$(sha384_base64 "$MT_FILE")
+    MT_SIZE=$(wc -c < "$MT_FILE" | tr -d ' ')
+    THREADS_ENTRY=",
+  \"threads\": {
+    \"hash\": \"$MT_HASH\",
+    \"sri\": \"sha384-$MT_HASH\",
+    \"size\": $MT_SIZE
+  }"
+fi
+
 # Write integrity file
 if [ -n "$WASM_HASH" ]; then
     cat > "$PROJECT_ROOT/wasm/integrity.json" << EOH
@@ -66,7 +92,7 @@ if [ -n "$WASM_HASH" ]; then
   "hash": "$WASM_HASH",
   "sri": "sha384-$WASM_HASH",
   "size": $WASM_SIZE,
-  "generatedAt": "$(date -u +"%Y-%m-%dT%H:%M:%SZ")"
+  "generatedAt": "$(date -u +"%Y-%m-%dT%H:%M:%SZ")"$THREADS_ENTRY
 }
 EOH
     echo "Integrity hash written to wasm/integrity.json"
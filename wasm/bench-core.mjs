@@ -0,0 +1,496 @@
+// Benchmark scenarios for the FlatSQL WASM build, shared by the Node
+// runner (bench.mjs) and the browser runner (bench.html).
+//
+// Mirrors the native suite (cpp/test/bench_suite.cpp): the same records,
+// scenario names and JSON result format, so WASM and native results can
+// be read side by side and either can gate against a baseline. On top of
+// those it measures what only exists on the JS side:
+//
+//   read_query, read_cursor, read_columnar
+//       The same result read cell-by-cell (query), row-by-row (prepare /
+//       step / row) and as one buffer (queryColumnar). ns_per_cell and
+//       ns_per_row are the time over running the query without returning
+//       it (SELECT COUNT(*) over it), i.e. the cost of crossing the
+//       JS/WASM boundary. Scenarios the build lacks exports for are skipped.
+//   worker_ingest, worker_point_lookup
+//       Ingest of transferred ArrayBuffers and point lookups through
+//       postMessage to databases in workers (threads = workers).
+//
+// Every result also carries heap_bytes (WASM memory after the scenario)
+// and heap_growth_bytes (how much it grew during it).
+
+export const SCHEMA = `
+    table readings {
+        id: int (id);
+        sensor: int (key);
+        value: double;
+        label: string;
+    }
+    table sensors {
+        id: int (id);
+        name: string;
+    }
+`;
+
+export const SCENARIOS = ['ingest', 'point_lookup', 'range', 'full_scan', 'aggregate', 'unified_view', 'join',
+                          'read_query', 'read_cursor', 'read_columnar', 'worker_ingest', 'worker_point_lookup'];
+
+const SENSORS = 100;
+const RANGE_WIDTH = 100;
+const READ_ROWS = 10000;  // Rows per read_* result
+const CHUNK_BYTES = 1000 * 72;  // About 1000 records per ingest call
+
+const encoder = new TextEncoder();
+
+// Size-prefixed readings (or sensors) record, laid out as the native
+// suite's appendRecord: vtable, a table of id, sensor, label offset and
+// value, then the label string
+function appendRecord(out, at, fileId, id, sensor, value, label) {
+    const text = encoder.encode(label);
+    const size = (52 + text.length + 1 + 3) & ~3;
+    const view = new DataView(out.buffer, out.byteOffset + at);
+    view.setUint32(0, size, true);
+    const buf = new DataView(out.buffer, out.byteOffset + at + 4, size);
+    const vtable = 8, table = 24;
+    buf.setUint32(0, table, true);
+    for (let i = 0; i < 4; i++) buf.setUint8(4 + i, fileId.charCodeAt(i));
+    if (fileId === 'SENS') {
+        buf.setUint16(vtable, 8, true);   // id, name
+        buf.setUint16(vtable + 2, 16, true);
+        buf.setUint16(vtable + 4, 4, true);
+        buf.setUint16(vtable + 6, 12, true);
+    } else {
+        buf.setUint16(vtable, 12, true);  // id, sensor, value, label
+        buf.setUint16(vtable + 2, 24, true);
+        buf.setUint16(vtable + 4, 4, true);
+        buf.setUint16(vtable + 6, 8, true);
+        buf.setUint16(vtable + 8, 16, true);
+        buf.setUint16(vtable + 10, 12, true);
+        buf.setInt32(table + 8, sensor, true);
+        buf.setFloat64(table + 16, value, true);
+    }
+    buf.setInt32(table, table - vtable, true);
+    buf.setInt32(table + 4, id, true);
+    buf.setUint32(table + 12, 48 - (table + 12), true);
+    buf.setUint32(48, text.length, true);
+    new Uint8Array(out.buffer, out.byteOffset + at + 4 + 52, text.length).set(text);
+    return at + 4 + size;
+}
+
+function recordSize(label) {
+    return 4 + ((52 + encoder.encode(label).length + 1 + 3) & ~3);
+}
+
+function buildStream(count, fileId, fields) {
+    let total = 0;
+    for (let i = 0; i < count; i++) total += recordSize(fields(i).label);
+    const out = new Uint8Array(new ArrayBuffer(total));
+    let at = 0;
+    for (let i = 0; i < count; i++) {
+        const f = fields(i);
+        at = appendRecord(out, at, fileId, f.id, f.sensor, f.value, f.label);
+    }
+    return out;
+}
+
+// Readings firstId..firstId+count-1 as one ArrayBuffer-backed stream
+export function buildReadings(count, firstId = 1) {
+    return buildStream(count, 'READ', (i) => {
+        const id = firstId + i;
+        return { id, sensor: id % SENSORS, value: id * 0.25, label: `reading-${id}` };
+    });
+}
+
+export function buildSensors() {
+    return buildStream(SENSORS, 'SENS', (id) => ({ id, sensor: 0, value: 0, label: `sensor-${id}` }));
+}
+
+export function openDatabase(flatsql, name) {
+    const db = flatsql.createDatabase(SCHEMA, name);
+    db.registerFileId('READ', 'readings');
+    db.registerFileId('SENS', 'sensors');
+    return db;
+}
+
+// Ingest stream in chunks of about chunkBytes; latency of each chunk in us
+export function ingestChunks(db, stream, chunkBytes = CHUNK_BYTES, source = null) {
+    const latencies = [];
+    let offset = 0;
+    while (offset < stream.length) {
+        const start = performance.now();
+        const consumed = db.ingest(stream.subarray(offset, Math.min(offset + chunkBytes, stream.length)), source);
+        latencies.push((performance.now() - start) * 1000);
+        if (consumed === 0) break;
+        offset += consumed;
+    }
+    return latencies;
+}
+
+/**
+ * Throws when this flatsql.wasm cannot read the benchmark records: builds
+ * from before flatsql_create_db used the schema-generated extractors
+ * count them but fail on every field.
+ */
+export function checkBuild(flatsql) {
+    const db = openDatabase(flatsql, 'bench_check');
+    try {
+        db.ingest(buildReadings(1));
+        db.query('SELECT id, label FROM readings');
+    } catch (e) {
+        throw new Error(`flatsql.wasm cannot read schema fields (${e.message}); rebuild it with npm run build:wasm`);
+    } finally {
+        db.destroy();
+    }
+}
+
+// Deterministic generator so runs see the same ids
+function rng(seed) {
+    let s = seed >>> 0;
+    return () => {
+        s = (s * 1664525 + 1013904223) >>> 0;
+        return s;
+    };
+}
+
+function percentile(sorted, p) {
+    if (sorted.length === 0) return 0;
+    return sorted[Math.min(Math.round(p * (sorted.length - 1)), sorted.length - 1)];
+}
+
+// Summarize per-operation latencies (microseconds) over wall time totalMs
+function summarize(scenario, records, threads, latencies, totalMs, rows) {
+    const sorted = latencies.slice().sort((a, b) => a - b);
+    const sum = sorted.reduce((s, us) => s + us, 0);
+    return {
+        scenario, records, threads,
+        operations: sorted.length,
+        rows,
+        total_ms: totalMs,
+        ops_per_sec: totalMs > 0 ? sorted.length * 1000 / totalMs : 0,
+        mean_us: sorted.length ? sum / sorted.length : 0,
+        p50_us: percentile(sorted, 0.50),
+        p99_us: percentile(sorted, 0.99),
+    };
+}
+
+// Time iterations calls of operation (returning rows), after a warm-up
+function runQueries(scenario, records, iterations, operation) {
+    const warm = rng(1000);
+    for (let i = 0; i < Math.max(Math.floor(iterations / 10), 1); i++) operation(warm);
+
+    const next = rng(42);
+    const latencies = [];
+    let rows = 0;
+    const start = performance.now();
+    for (let i = 0; i < iterations; i++) {
+        const opStart = performance.now();
+        rows += operation(next);
+        latencies.push((performance.now() - opStart) * 1000);
+    }
+    return summarize(scenario, records, 1, latencies, performance.now() - start, rows);
+}
+
+function benchIngest(flatsql, records) {
+    const stream = buildReadings(records);
+    const db = openDatabase(flatsql, 'bench_ingest');
+    const start = performance.now();
+    const latencies = ingestChunks(db, stream);
+    const totalMs = performance.now() - start;
+    const rows = Number(db.query('SELECT COUNT(*) FROM readings').rows[0][0]);
+    db.destroy();
+    const result = summarize('ingest', records, 1, latencies, totalMs, rows);
+    result.ops_per_sec = totalMs > 0 ? records * 1000 / totalMs : 0;  // Records/s
+    return result;
+}
+
+// Read the same rows each way; crossing cost is the time over COUNT(*)
+// of the query, which runs it in WASM but returns one cell
+function benchRead(db, scenario, records, iterations) {
+    const limit = Math.min(records, READ_ROWS);
+    const sql = `SELECT id, sensor, value, label FROM readings WHERE id <= ${limit}`;
+    const readers = {
+        read_query: () => db.query(sql).rows.length,
+        read_cursor: () => {
+            const cursor = db.prepare(sql);
+            let rows = 0;
+            try {
+                while (cursor.step()) {
+                    cursor.row();
+                    rows++;
+                }
+            } finally {
+                cursor.finalize();
+            }
+            return rows;
+        },
+        read_columnar: () => db.queryColumnar(sql).rowCount,
+    };
+    const inWasm = runQueries('count', records, iterations,
+        () => Number(db.query(`SELECT COUNT(*) FROM (${sql})`).rows[0][0]));
+    const result = runQueries(scenario, records, iterations, readers[scenario]);
+    const rowsPerRead = result.rows / Math.max(result.operations, 1);
+    const crossingNs = Math.max(result.mean_us - inWasm.mean_us, 0) * 1000;
+    result.ns_per_row = rowsPerRead ? crossingNs / rowsPerRead : 0;
+    result.ns_per_cell = rowsPerRead ? crossingNs / (rowsPerRead * 4) : 0;
+    return result;
+}
+
+// Requests and replies to one bench-worker.mjs; spawn() is the runner's
+// { post(message, transfer), onMessage(handler), terminate() }
+class WorkerConnection {
+    constructor(worker) {
+        this.worker = worker;
+        this.pending = new Map();
+        this.nextId = 1;
+        worker.onMessage((reply) => {
+            const pending = this.pending.get(reply.id);
+            if (!pending) return;
+            this.pending.delete(reply.id);
+            if (reply.error) pending.reject(new Error(reply.error));
+            else pending.resolve(reply.result);
+        });
+    }
+
+    request(op, params = {}, transfer = []) {
+        const id = this.nextId++;
+        return new Promise((resolve, reject) => {
+            this.pending.set(id, { resolve, reject });
+            this.worker.post({ id, op, ...params }, transfer);
+        });
+    }
+}
+
+async function benchWorkers(spawn, wants, records, workers, iterations) {
+    const results = [];
+    const connections = [];
+    for (let w = 0; w < workers; w++) {
+        const connection = new WorkerConnection(await spawn());
+        await connection.request('open');
+        connections.push(connection);
+    }
+    try {
+        // Each chunk is copied out of the stream and transferred, as an
+        // app receiving records from the network would hand them over
+        const stream = buildReadings(records);
+        const latencies = [];
+        const start = performance.now();
+        await Promise.all(connections.map(async (connection) => {
+            let offset = 0;
+            while (offset < stream.length) {
+                const chunk = stream.slice(offset, Math.min(offset + CHUNK_BYTES, stream.length));
+                const chunkStart = performance.now();
+                const consumed = await connection.request('ingest', { data: chunk.buffer }, [chunk.buffer]);
+                latencies.push((performance.now() - chunkStart) * 1000);
+                if (consumed === 0) break;
+                offset += consumed;
+            }
+        }));
+        const totalMs = performance.now() - start;
+        if (wants('worker_ingest')) {
+            const rows = await connections[0].request('query', { sql: 'SELECT COUNT(*) FROM readings' });
+            const result = summarize('worker_ingest', records, workers, latencies, totalMs,
+                                     Number(rows[0][0]));
+            result.ops_per_sec = totalMs > 0 ? records * workers * 1000 / totalMs : 0;  // Records/s
+            result.heap_bytes = await connections[0].request('heap');
+            results.push(result);
+        }
+
+        if (wants('worker_point_lookup')) {
+            // One request in flight per worker
+            const lookups = [];
+            let rows = 0;
+            const lookupStart = performance.now();
+            await Promise.all(connections.map(async (connection, w) => {
+                const next = rng(42 + w);
+                const share = Math.floor(iterations / workers) + (w < iterations % workers ? 1 : 0);
+                for (let i = 0; i < share; i++) {
+                    const id = (next() % records) + 1;
+                    const opStart = performance.now();
+                    rows += (await connection.request('query', { sql: `SELECT * FROM readings WHERE id = ${id}` })).length;
+                    lookups.push((performance.now() - opStart) * 1000);
+                }
+            }));
+            const result = summarize('worker_point_lookup', records, workers, lookups,
+                                     performance.now() - lookupStart, rows);
+            result.heap_bytes = await connections[0].request('heap');
+            results.push(result);
+        }
+    } finally {
+        for (const connection of connections) connection.worker.terminate();
+    }
+    return results;
+}
+
+/**
+ * Run the chosen scenarios at one record count and return their results.
+ * flatsql comes from initFlatSQL(); spawnWorker (optional) starts a
+ * bench-worker.mjs for the worker_* scenarios, which are skipped without it.
+ * onResult is called as each result is ready.
+ */
+export async function runScenarios(flatsql, options, records, onResult = () => {}) {
+    const wants = (name) => options.scenarios.includes(name);
+    const iterations = options.iterations;
+    // Scans touch every record, so run fewer of them
+    const scans = Math.max(Math.floor(iterations / 100), 5);
+    const results = [];
+    const measure = (run) => {
+        const heapBefore = flatsql.heapSize();
+        const result = run();
+        if (!result) return;
+        result.heap_bytes = flatsql.heapSize();
+        result.heap_growth_bytes = result.heap_bytes - heapBefore;
+        results.push(result);
+        onResult(result);
+    };
+
+    if (wants('ingest')) {
+        measure(() => benchIngest(flatsql, records));
+    }
+
+    const queries = ['point_lookup', 'range', 'full_scan', 'aggregate', 'join',
+                     'read_query', 'read_cursor', 'read_columnar'].some(wants);
+    if (queries) {
+        const db = openDatabase(flatsql, 'bench_query');
+        db.ingest(buildReadings(records));
+        db.ingest(buildSensors());
+
+        if (wants('point_lookup')) {
+            measure(() => runQueries('point_lookup', records, iterations, (next) =>
+                db.query(`SELECT * FROM readings WHERE id = ${(next() % records) + 1}`).rows.length));
+        }
+        if (wants('range')) {
+            measure(() => runQueries('range', records, iterations, (next) => {
+                const from = (next() % records) + 1;
+                return db.query(`SELECT id, value FROM readings WHERE id BETWEEN ${from} AND ${from + RANGE_WIDTH - 1}`)
+                    .rows.length;
+            }));
+        }
+        if (wants('full_scan')) {
+            // Reads label from every record, returns a tenth of them
+            measure(() => runQueries('full_scan', records, scans, () =>
+                db.query("SELECT id, label FROM readings WHERE label LIKE 'reading-%9'").rows.length));
+        }
+        if (wants('aggregate')) {
+            measure(() => runQueries('aggregate', records, scans, () =>
+                db.query('SELECT sensor, COUNT(*), SUM(value), MAX(id) FROM readings GROUP BY sensor').rows.length));
+        }
+        if (wants('join')) {
+            measure(() => runQueries('join', records, scans, (next) =>
+                db.query('SELECT s.name, r.value FROM sensors s JOIN readings r ON r.sensor = s.id ' +
+                         `WHERE s.id = ${next() % SENSORS}`).rows.length));
+        }
+        const readScans = Math.max(Math.floor(iterations / 20), 5);
+        if (wants('read_query')) {
+            measure(() => benchRead(db, 'read_query', records, readScans));
+        }
+        if (wants('read_cursor')) {
+            measure(() => {
+                try {
+                    return benchRead(db, 'read_cursor', records, readScans);
+                } catch (e) {
+                    return null;  // Build without flatsql_prepare
+                }
+            });
+        }
+        if (wants('read_columnar')) {
+            measure(() => {
+                try {
+                    return benchRead(db, 'read_columnar', records, readScans);
+                } catch (e) {
+                    return null;  // Build without flatsql_query_buffer
+                }
+            });
+        }
+        db.destroy();
+    }
+
+    if (wants('unified_view')) {
+        measure(() => {
+            const db = openDatabase(flatsql, 'bench_unified');
+            const sources = ['east', 'west', 'north', 'south'];
+            for (const source of sources) db.registerSource(source);
+            const perSource = Math.floor(records / 4);
+            sources.forEach((source, s) => {
+                ingestChunks(db, buildReadings(perSource, s * perSource + 1), CHUNK_BYTES, source);
+            });
+            db.createUnifiedViews();
+            const result = runQueries('unified_view', records, iterations, (next) => {
+                const from = (next() % (perSource * 4)) + 1;
+                return db.query(`SELECT _source, id FROM readings WHERE id BETWEEN ${from} AND ${from + RANGE_WIDTH - 1} ` +
+                                'ORDER BY id').rows.length;
+            });
+            db.destroy();
+            return result;
+        });
+    }
+
+    if (options.spawnWorker && (wants('worker_ingest') || wants('worker_point_lookup'))) {
+        for (const workers of options.workers) {
+            for (const result of await benchWorkers(options.spawnWorker, wants, records, workers, iterations)) {
+                results.push(result);
+                onResult(result);
+            }
+        }
+    }
+    return results;
+}
+
+// Results of the suite as the native suite's JSON
+export function toJson(results) {
+    return JSON.stringify({ version: 1, results }, null, 2) + '\n';
+}
+
+/**
+ * Results that regress against baseline (either suite's JSON): throughput
+ * down, or p99 latency up, by more than tolerance against the baseline
+ * result with the same scenario, records and threads.
+ */
+export function checkBaseline(results, baseline, tolerance) {
+    const regressions = [];
+    for (const r of results) {
+        for (const b of baseline.results || []) {
+            if (b.scenario !== r.scenario || b.records !== r.records || b.threads !== r.threads) continue;
+            const slower = b.ops_per_sec > 0 && r.ops_per_sec < b.ops_per_sec * (1 - tolerance);
+            const laggier = !r.scenario.endsWith('ingest') && b.p99_us > 0 && r.p99_us > b.p99_us * (1 + tolerance);
+            if (slower || laggier) regressions.push({ result: r, baseline: b });
+        }
+    }
+    return regressions;
+}
+
+export function formatResult(r) {
+    let line = r.scenario.padEnd(20) + String(r.records).padStart(10) + String(r.threads).padStart(8) +
+        r.ops_per_sec.toFixed(1).padStart(14) + r.p50_us.toFixed(1).padStart(11) + r.p99_us.toFixed(1).padStart(11) +
+        (r.heap_bytes / (1024 * 1024)).toFixed(1).padStart(10);
+    if (r.ns_per_cell !== undefined) {
+        line += `  ${r.ns_per_cell.toFixed(1)} ns/cell, ${r.ns_per_row.toFixed(1)} ns/row`;
+    }
+    return line;
+}
+
+export const HEADER = 'Scenario'.padEnd(20) + 'Records'.padStart(10) + 'Threads'.padStart(8) +
+    'Ops/s'.padStart(14) + 'p50 us'.padStart(11) + 'p99 us'.padStart(11) + 'Heap MB'.padStart(10);
+
+/**
+ * Serve a bench-worker.mjs: one database per worker, driven by messages
+ * { id, op, ... } with replies { id, result } or { id, error }.
+ */
+export function serveWorker(flatsql, post) {
+    let db = null;
+    const ops = {
+        open: () => {
+            db = openDatabase(flatsql, 'bench_worker');
+            return true;
+        },
+        ingest: ({ data }) => db.ingest(new Uint8Array(data)),
+        query: ({ sql }) => db.query(sql).rows,
+        heap: () => flatsql.heapSize(),
+    };
+    return (message) => {
+        try {
+            post({ id: message.id, result: ops[message.op](message) });
+        } catch (e) {
+            post({ id: message.id, error: e.message });
+        }
+    };
+}
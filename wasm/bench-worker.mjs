@@ -0,0 +1,17 @@
+// Worker side of the worker_* benchmark scenarios (see bench-core.mjs).
+// Runs as a Node worker_threads worker or a browser module worker.
+
+import { initFlatSQL } from './index.js';
+import { serveWorker } from './bench-core.mjs';
+
+const flatsql = await initFlatSQL({ skipIntegrityCheck: true });
+
+if (typeof process !== 'undefined' && process.versions && process.versions.node) {
+    const { parentPort } = await import('worker_threads');
+    parentPort.on('message', serveWorker(flatsql, (reply) => parentPort.postMessage(reply)));
+    parentPort.postMessage({ type: 'ready' });
+} else {
+    const handle = serveWorker(flatsql, (reply) => self.postMessage(reply));
+    self.onmessage = (e) => handle(e.data);
+    self.postMessage({ type: 'ready' });
+}
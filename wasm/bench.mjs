@@ -0,0 +1,98 @@
+// Node runner for the WASM benchmark scenarios (bench-core.mjs)
+//
+// Like the native flatsql_bench this does NOT run as part of CI. It takes
+// the same options, and writes and gates on the same JSON:
+//
+//   node wasm/bench.mjs [--records=10000,100000] [--workers=1,2]
+//                       [--iterations=2000] [--scenarios=ingest,read_query,...]
+//                       [--json=out.json] [--baseline=base.json] [--tolerance=0.15]
+//
+// --workers is the worker counts for the worker_* scenarios. For the
+// browser build open bench.html (see the comment at its top) instead.
+
+import { readFileSync, writeFileSync } from 'fs';
+import { Worker } from 'worker_threads';
+import { initFlatSQL } from './index.js';
+import { SCENARIOS, HEADER, checkBuild, runScenarios, toJson, checkBaseline, formatResult } from './bench-core.mjs';
+
+const options = {
+    records: [10000, 100000],
+    workers: [1, 2],
+    iterations: 2000,
+    scenarios: SCENARIOS,
+    json: null,
+    baseline: null,
+    tolerance: 0.15,
+};
+
+const sizes = (list) => list.split(',').filter(Boolean).map(Number);
+for (const arg of process.argv.slice(2)) {
+    const [name, value = ''] = arg.split('=');
+    switch (name) {
+        case '--records': options.records = sizes(value); break;
+        case '--workers': options.workers = sizes(value); break;
+        case '--iterations': options.iterations = Number(value); break;
+        case '--scenarios': options.scenarios = value.split(',').filter(Boolean); break;
+        case '--json': options.json = value; break;
+        case '--baseline': options.baseline = value; break;
+        case '--tolerance': options.tolerance = Number(value); break;
+        default:
+            console.error(`Unknown option: ${arg}`);
+            process.exit(2);
+    }
+}
+
+// Start a bench-worker.mjs and wait until its module is loaded
+options.spawnWorker = () => new Promise((resolve, reject) => {
+    const worker = new Worker(new URL('./bench-worker.mjs', import.meta.url));
+    worker.once('error', reject);
+    worker.once('message', () => resolve({
+        post: (message, transfer) => worker.postMessage(message, transfer),
+        onMessage: (handler) => worker.on('message', handler),
+        terminate: () => worker.terminate(),
+    }));
+});
+
+const flatsql = await initFlatSQL({ skipIntegrityCheck: true });
+try {
+    checkBuild(flatsql);
+} catch (e) {
+    console.error(e.message);
+    process.exit(2);
+}
+
+console.log('FlatSQL WASM Benchmark Suite (Node ' + process.versions.node + ')');
+console.log('='.repeat(HEADER.length));
+console.log(HEADER);
+console.log('-'.repeat(HEADER.length));
+
+const results = [];
+for (const records of options.records) {
+    results.push(...await runScenarios(flatsql, options, records, (r) => {
+        console.log(formatResult(r));
+        if (r.rows === 0) console.log(`  warning: ${r.scenario} returned no rows`);
+    }));
+}
+
+if (options.json) {
+    writeFileSync(options.json, toJson(results));
+    console.log(`\nWrote ${options.json}`);
+}
+
+if (options.baseline) {
+    let baseline;
+    try {
+        baseline = JSON.parse(readFileSync(options.baseline, 'utf8'));
+    } catch (e) {
+        console.error(`Cannot read baseline ${options.baseline}: ${e.message}`);
+        process.exit(2);
+    }
+    const regressions = checkBaseline(results, baseline, options.tolerance);
+    for (const { result: r, baseline: b } of regressions) {
+        console.log(`REGRESSION ${r.scenario} records=${r.records} threads=${r.threads}: ` +
+                    `${r.ops_per_sec.toFixed(1)} ops/s (baseline ${b.ops_per_sec.toFixed(1)}), ` +
+                    `p99 ${r.p99_us.toFixed(1)} us (baseline ${b.p99_us.toFixed(1)})`);
+    }
+    console.log(`\n${regressions.length} regression(s) against ${options.baseline}`);
+    process.exit(regressions.length ? 1 : 0);
+}
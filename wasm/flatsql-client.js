@@ -12,6 +12,12 @@
  *   const db = await client.createDatabase(schema, 'mydb');
  *   await db.registerFileId('USER', 'User');
  *   const result = await db.query('SELECT * FROM User');
+ *
+ * Where threadsAvailable() (cross-origin isolated pages, Node.js, Deno) the
+ * worker runs the multithreaded build, flatsql-mt.js: its memory is a
+ * SharedArrayBuffer that a pool of Web Workers scans and ingests into in
+ * place, so aggregate() and ingest use every core (client.threads). Pass
+ * { threads: false } to keep the single-threaded build.
  */
 
 // Environment detection
@@ -19,6 +25,18 @@ const isBrowser = typeof window !== 'undefined' || (typeof self !== 'undefined'
 const isNode = typeof process !== 'undefined' && process.versions && process.versions.node;
 const isDeno = typeof Deno !== 'undefined';
 
+/**
+ * Whether the multithreaded build can run here. It needs SharedArrayBuffer,
+ * which browsers only provide when the page is cross-origin isolated
+ * (Cross-Origin-Opener-Policy: same-origin and
+ * Cross-Origin-Embedder-Policy: require-corp).
+ */
+export function threadsAvailable() {
+    if (typeof SharedArrayBuffer === 'undefined' || typeof Atomics === 'undefined') return false;
+    if (typeof globalThis.crossOriginIsolated === 'boolean') return globalThis.crossOriginIsolated;
+    return true;  // Node.js and Deno do not gate SharedArrayBuffer
+}
+
 /**
  * Create a worker based on the environment
  */
@@ -53,8 +71,15 @@ function setupWorkerHandlers(worker, handlers) {
  * Manages communication with the FlatSQL worker.
  */
 export class FlatSQLClient {
-    constructor(workerPath = './flatsql.worker.js') {
+    /**
+     * @param {string} [workerPath]
+     * @param {{threads?: boolean}} [options] - threads: use the multithreaded
+     *     build (default: threadsAvailable())
+     */
+    constructor(workerPath = './flatsql.worker.js', options = {}) {
         this.workerPath = workerPath;
+        this.useThreads = options.threads ?? threadsAvailable();
+        this.threads = 1;  // Threads per pool once initialized
         this.worker = null;
         this.pending = new Map();
         this.nextId = 1;
@@ -112,8 +137,9 @@ export class FlatSQLClient {
 
         await this.readyPromise;
 
-        // Initialize WASM in worker
-        await this.call('init');
+        // Initialize WASM in worker; it falls back to the single-threaded build
+        const info = await this.call('init', { threads: this.useThreads });
+        this.threads = info.threads || 1;
 
         return this;
     }
@@ -205,10 +231,20 @@ export class FlatSQLWorkerDatabase {
     }
 
     /**
-     * Execute a SQL query
+     * Execute a SQL query. With sliceMs the worker runs it in slices of
+     * about that long, handling other calls in between, and a queryId
+     * lets cancel() stop it.
+     */
+    async query(sql, { sliceMs, queryId } = {}) {
+        return await this._client.call('query', { dbId: this._dbId, sql, sliceMs, queryId });
+    }
+
+    /**
+     * Cancel a time-sliced query started with this queryId; its query()
+     * call rejects with "Query cancelled"
      */
-    async query(sql) {
-        return await this._client.call('query', { dbId: this._dbId, sql });
+    async cancel(queryId) {
+        return await this._client.call('cancel', { queryId });
     }
 
     /**
@@ -217,7 +253,7 @@ export class FlatSQLWorkerDatabase {
     async ingest(data) {
         const result = await this._client.call('ingest', {
             dbId: this._dbId,
-            data: Array.from(data)
+            data: Uint8Array.from(data)
         });
         return result.bytesConsumed;
     }
@@ -228,7 +264,7 @@ export class FlatSQLWorkerDatabase {
     async ingestOne(data) {
         const result = await this._client.call('ingestOne', {
             dbId: this._dbId,
-            data: Array.from(data)
+            data: Uint8Array.from(data)
         });
         return result.rowId;
     }
@@ -239,11 +275,32 @@ export class FlatSQLWorkerDatabase {
     async ingestStream(buffers) {
         const result = await this._client.call('ingestStream', {
             dbId: this._dbId,
-            buffers: buffers.map(b => Array.from(b))
+            buffers: buffers.map(b => Uint8Array.from(b))
         });
         return result;
     }
 
+    /**
+     * Threads for aggregate() scans and for ingest, including the worker's
+     * own (0 = client.threads); returns the threads each now uses
+     */
+    async setThreads({ scan, ingest } = {}) {
+        return await this._client.call('setThreads', { dbId: this._dbId, scan, ingest });
+    }
+
+    /**
+     * Aggregates such as 'COUNT(*)' or 'AVG(age)' over a table or unified
+     * view, computed on the worker's scan pool outside SQLite
+     */
+    async aggregate(tableName, aggregates, groupBy = '') {
+        return await this._client.call('aggregate', {
+            dbId: this._dbId,
+            tableName,
+            aggregates,
+            groupBy
+        });
+    }
+
     /**
      * Export database as binary blob
      */
@@ -17,35 +17,60 @@ const isDeno = typeof Deno !== 'undefined';
 let postMessage, onMessage;
 
 if (isBrowser) {
-    postMessage = (msg) => self.postMessage(msg);
+    postMessage = (msg, transfer = []) => self.postMessage(msg, transfer);
     onMessage = (handler) => { self.onmessage = (e) => handler(e.data); };
 } else if (isNode) {
     const { parentPort } = await import('worker_threads');
-    postMessage = (msg) => parentPort.postMessage(msg);
+    postMessage = (msg, transfer = []) => parentPort.postMessage(msg, transfer);
     onMessage = (handler) => parentPort.on('message', handler);
 } else if (isDeno) {
-    postMessage = (msg) => self.postMessage(msg);
+    postMessage = (msg, transfer = []) => self.postMessage(msg, transfer);
     onMessage = (handler) => { self.onmessage = (e) => handler(e.data); };
 }
 
-// WASM module loading
+// WASM module loading (the cwrap API of index.js)
 let flatsql = null;
+let resultBufferRows = null;
+let threads = 1;
 let databases = new Map();
 
-async function loadModule() {
+// Time-sliced queries by queryId: { dbId, cursor, finished }
+const runningQueries = new Map();
+
+// Rows read per slice at most (a slice also ends when its time is up)
+const SLICE_ROWS = 1024;
+
+// Let queued messages run before the next slice
+const yieldToEvents = typeof setImmediate === 'function'
+    ? () => new Promise((resolve) => setImmediate(resolve))
+    : () => new Promise((resolve) => setTimeout(resolve, 0));
+
+// With useThreads, the multithreaded build when it loads (it needs
+// SharedArrayBuffer), otherwise the single-threaded one
+async function loadModule(useThreads = false) {
     if (flatsql) return flatsql;
 
-    // Dynamic import of the WASM module
-    const FlatSQLModule = (await import('./flatsql.js')).default;
-    flatsql = await FlatSQLModule();
+    const index = await import('./index.js');
+    const { initFlatSQL } = index;
+    resultBufferRows = index.resultBufferRows;
+    if (useThreads) {
+        try {
+            flatsql = await initFlatSQL({ threads: true });
+        } catch (e) {
+            flatsql = null;
+        }
+    }
+    if (!flatsql) {
+        flatsql = await initFlatSQL();
+    }
+    threads = flatsql.maxThreads();
     return flatsql;
 }
 
-// Helper: Convert Uint8Array to C++ vector
-function toVec(arr) {
-    const vec = new flatsql.VectorUint8();
-    for (const byte of arr) vec.push_back(byte);
-    return vec;
+function database(dbId) {
+    const entry = databases.get(dbId);
+    if (!entry) throw new Error(`Database not found: ${dbId}`);
+    return entry;
 }
 
 // Helper: Build size-prefixed stream from buffers
@@ -66,111 +91,127 @@ function buildStream(buffers) {
     return result;
 }
 
-// API Methods
+// API Methods. Byte arguments may be Uint8Arrays or plain arrays; byte
+// results are Uint8Arrays, transferred to the caller.
 const methods = {
-    async init() {
-        await loadModule();
-        return { success: true, version: '1.0.0' };
+    async init({ threads: useThreads = false } = {}) {
+        await loadModule(useThreads);
+        return { success: true, version: '1.0.0', threads };
     },
 
     async createDatabase({ id, schema, name = 'default' }) {
         await loadModule();
-        const db = new flatsql.FlatSQLDatabase(schema, name);
+        const db = flatsql.createDatabase(schema, name);
+        if (threads > 1) {
+            db.setScanThreads(threads);
+            db.setIngestThreads(threads);
+        }
         databases.set(id, { db, schema, name });
         return { success: true, id };
     },
 
     async registerFileId({ dbId, fileId, tableName }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-        entry.db.registerFileId(fileId, tableName);
+        database(dbId).db.registerFileId(fileId, tableName);
         return { success: true };
     },
 
     async enableDemoExtractors({ dbId }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-        entry.db.enableDemoExtractors();
+        database(dbId).db.enableDemoExtractors();
         return { success: true };
     },
 
     async setFieldExtractor({ dbId, tableName, extractorName }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
+        database(dbId);
         // Note: Custom extractors need to be compiled into WASM
         // This is a placeholder for built-in extractors
         return { success: true };
     },
 
-    async query({ dbId, sql }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-
-        const result = entry.db.query(sql);
-        const response = {
-            columns: result.getColumns(),
-            rows: result.getRows(),
-            rowCount: result.getRowCount()
+    async setThreads({ dbId, scan, ingest }) {
+        const { db } = database(dbId);
+        return {
+            scan: scan === undefined ? undefined : db.setScanThreads(scan),
+            ingest: ingest === undefined ? undefined : db.setIngestThreads(ingest),
         };
-        result.delete();
-        return response;
     },
 
-    async ingest({ dbId, data }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
+    // With sliceMs, the query runs on a cursor in slices of about sliceMs,
+    // and messages that arrive meanwhile (ingest, point lookups, cancel)
+    // are handled between slices. cancel({ queryId }) stops it.
+    async query({ dbId, sql, queryId, sliceMs }) {
+        const { db } = database(dbId);
+        if (!sliceMs) {
+            const { columns, rows } = db.query(sql);
+            return { columns, rows, rowCount: rows.length };
+        }
 
-        const vec = toVec(new Uint8Array(data));
-        const result = entry.db.ingest(vec);
-        vec.delete();
+        const cursor = db.prepare(sql);
+        let finish;
+        const entry = { dbId, cursor, finished: new Promise((resolve) => { finish = resolve; }) };
+        const key = queryId !== undefined ? queryId : Symbol('query');
+        runningQueries.set(key, entry);
+        try {
+            const rows = [];
+            for (;;) {
+                for (const row of resultBufferRows(cursor.nextSlice(sliceMs, SLICE_ROWS)).rows) {
+                    rows.push(row);
+                }
+                if (cursor.done) break;
+                await yieldToEvents();
+            }
+            return { columns: cursor.columns, rows, rowCount: rows.length };
+        } finally {
+            runningQueries.delete(key);
+            cursor.finalize();
+            finish();
+        }
+    },
+
+    async cancel({ queryId }) {
+        const entry = runningQueries.get(queryId);
+        if (entry) entry.cursor.cancel();
+        return { cancelled: entry !== undefined };
+    },
+
+    async aggregate({ dbId, tableName, aggregates, groupBy = '' }) {
+        const { columns, rows } = database(dbId).db.aggregate(tableName, aggregates, groupBy);
+        return { columns, rows, rowCount: rows.length };
+    },
+
+    async ingest({ dbId, data }) {
+        const result = database(dbId).db.ingest(new Uint8Array(data));
         return { bytesConsumed: result };
     },
 
     async ingestOne({ dbId, data }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-
-        const vec = toVec(new Uint8Array(data));
-        const rowId = entry.db.ingestOne(vec);
-        vec.delete();
+        const rowId = database(dbId).db.ingestOne(new Uint8Array(data));
         return { rowId };
     },
 
     async ingestStream({ dbId, buffers }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-
-        const stream = buildStream(buffers);
-        const vec = toVec(stream);
-        const result = entry.db.ingest(vec);
-        vec.delete();
+        const result = database(dbId).db.ingest(buildStream(buffers));
         return { bytesConsumed: result, recordCount: buffers.length };
     },
 
     async exportData({ dbId }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-
-        const data = entry.db.exportData();
-        return { data: Array.from(data) };
+        return { data: database(dbId).db.exportData() };
     },
 
     async listTables({ dbId }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-        return { tables: entry.db.listTables() };
+        return { tables: database(dbId).db.getStats().map((stat) => stat.tableName) };
     },
 
     async getStats({ dbId }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-        return { stats: entry.db.getStats() };
+        return { stats: database(dbId).db.getStats() };
     },
 
     async deleteDatabase({ dbId }) {
-        const entry = databases.get(dbId);
-        if (!entry) throw new Error(`Database not found: ${dbId}`);
-        entry.db.delete();
+        const { db } = database(dbId);
+        // Cursors must not outlive their database
+        const running = [...runningQueries.values()].filter((entry) => entry.dbId === dbId);
+        for (const entry of running) entry.cursor.cancel();
+        await Promise.all(running.map((entry) => entry.finished));
+        db.destroy();
         databases.delete(dbId);
         return { success: true };
     },
@@ -178,14 +219,12 @@ const methods = {
     // Test helpers (for demo purposes)
     async createTestUser({ id, name, email, age }) {
         await loadModule();
-        const fb = flatsql.createTestUser(id, name, email, age);
-        return { data: Array.from(fb) };
+        return { data: flatsql.createTestUser(id, name, email, age) };
     },
 
     async createTestPost({ id, userId, title }) {
         await loadModule();
-        const fb = flatsql.createTestPost(id, userId, title);
-        return { data: Array.from(fb) };
+        return { data: flatsql.createTestPost(id, userId, title) };
     }
 };
 
@@ -199,7 +238,8 @@ onMessage(async (message) => {
         }
 
         const result = await methods[method](params);
-        postMessage({ id, success: true, result });
+        const transfer = result && result.data instanceof Uint8Array ? [result.data.buffer] : [];
+        postMessage({ id, success: true, result }, transfer);
     } catch (error) {
         postMessage({ id, success: false, error: error.message, stack: error.stack });
     }
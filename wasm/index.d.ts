@@ -8,10 +8,95 @@ export interface QueryResult {
   rows: any[][];
 }
 
+export interface ColumnarQueryResult {
+  columns: string[];
+  rowCount: number;
+  types: number[];
+  values: Array<BigInt64Array | Float64Array | Uint8Array | any[]>;
+  validity: Array<Uint8Array | null>;
+}
+
+export interface FlatSQLCursor {
+  readonly columns: string[];
+  /** Advance to the next row; false when the result is exhausted */
+  step(): boolean;
+  /** Current row */
+  row(): any[];
+  /** Up to maxRows further rows; fewer than maxRows means done */
+  nextBatch(maxRows?: number): ColumnarQueryResult;
+  /**
+   * Up to maxRows further rows, returning early once budgetMs has elapsed;
+   * check done to tell the end of the result from a spent budget
+   */
+  nextSlice(budgetMs: number, maxRows?: number): ColumnarQueryResult;
+  /** Whether the result is exhausted */
+  readonly done: boolean;
+  /** Stop the query: the next step throws "Query cancelled" */
+  cancel(): void;
+  finalize(): void;
+}
+
 export interface TableStats {
   tableName: string;
   fileId: string;
   recordCount: number;
+  /** Bytes held for the table, SQLite index pages aside */
+  memoryBytes: number;
+}
+
+/** Byte counts of FlatSQLDatabase.getMemoryUsage() */
+export interface MemoryUsage {
+  total: number;
+  /** Raw stream in memory */
+  stream: number;
+  /** Mapped stream file (MappedFile storage; not in total) */
+  mapped: number;
+  /** Compressed cold chunks and their decompressed cache */
+  cold: number;
+  coldCache: number;
+  /** Sequence -> offset table */
+  sequenceMap: number;
+  chunkTable: number;
+  /** Per-file-ID record lists */
+  recordLists: number;
+  /** Per-table record lists, indexes, caches and tombstones */
+  recordInfos: number;
+  indexes: number;
+  /** SQLite pages of the index tables (also in pageCache) */
+  indexPages: number;
+  columnCaches: number;
+  zoneMaps: number;
+  tombstones: number;
+  /** Lazy verification outcomes */
+  verification: number;
+  /** SQLite connection and result cache */
+  pageCache: number;
+  statements: number;
+  schema: number;
+  resultCache: number;
+}
+
+export interface MemoryLimits {
+  /** Past this after an ingest, caches are dropped (0 = none) */
+  softBytes?: number;
+  /** Past this, ingest throws instead of storing (0 = none) */
+  hardBytes?: number;
+  /** Also compact deleted records when dropping caches was not enough */
+  compactOverSoft?: boolean;
+}
+
+export interface MemoryLimitStats {
+  footprint: number;
+  reliefs: number;
+  compactions: number;
+  rejections: number;
+}
+
+export interface ReplicationPosition {
+  epoch: number;
+  sequence: number;
+  deletes: number;
+  snapshot: boolean;
 }
 
 export interface FlatSQLDatabase {
@@ -40,16 +125,121 @@ export interface FlatSQLDatabase {
    */
   ingestOne(data: Uint8Array, source?: string | null): number;
 
+  /**
+   * Space for the next `bytes` of a size-prefixed stream at the end of
+   * storage, as a view into the WASM heap. Write into it, then call
+   * commitIngest() with the bytes written. The view is valid until the
+   * next call on the database.
+   */
+  reserveIngest(bytes: number): Uint8Array;
+
+  /**
+   * Index the records completed by bytes written into reserveIngest()'s
+   * view. A trailing partial record waits for the next chunk.
+   * @returns Records committed
+   */
+  commitIngest(bytes: number): number;
+
+  /**
+   * Ingest one chunk of a size-prefixed stream, such as a WebSocket
+   * message. Chunks may split records.
+   * @returns Records committed
+   */
+  ingestChunk(chunk: Uint8Array | ArrayBuffer): number;
+
   /**
    * Execute a SQL query
    */
   query(sql: string): QueryResult;
 
+  /**
+   * Execute a SQL query and return the result as typed column vectors
+   * (integers as BigInt64Array, reals as Float64Array, bools as Uint8Array;
+   * other columns as arrays). validity[c] is a bitmap of non-null rows, or
+   * null when the column has no nulls.
+   */
+  queryColumnar(sql: string): ColumnarQueryResult;
+
+  /**
+   * Prepare a query for row-at-a-time reading. Memory use is bounded by one
+   * row or batch regardless of result size. finalize() the cursor when done.
+   */
+  prepare(sql: string): FlatSQLCursor;
+
+  /**
+   * Iterate over result rows, fetching batchSize rows per call into WASM
+   */
+  iterate(sql: string, batchSize?: number): IterableIterator<any[]>;
+
+  /**
+   * Threads for aggregate() scans, including the caller (0 = maxThreads()).
+   * Returns the threads used.
+   */
+  setScanThreads(threads?: number): number;
+
+  /**
+   * Threads extracting index keys during ingest, including the caller
+   * (0 = maxThreads()). Returns the threads used.
+   */
+  setIngestThreads(threads?: number): number;
+
+  /**
+   * Aggregates such as 'COUNT(*)', 'AVG(age)' or 'APPROX_PERCENTILE(age, 0.9)'
+   * over every live record of a table or unified view, computed on the scan
+   * pool outside SQLite
+   */
+  aggregate(tableName: string, aggregates: string[] | string, groupBy?: string): QueryResult;
+
   /**
    * Export all data as a stream of size-prefixed FlatBuffers
    */
   exportData(): Uint8Array;
 
+  /**
+   * Export in chunks of whole records without copying the stream. Each
+   * view is only valid during the callback; return false to stop.
+   * @param afterSequence Only export records after this sequence
+   * @returns The last sequence exported (the next watermark)
+   */
+  exportChunks(onChunk: (chunk: Uint8Array) => boolean | void, afterSequence?: number): number;
+
+  /**
+   * Records after a sequence watermark, with the new watermark
+   */
+  exportSince(sequence: number): { data: Uint8Array; watermark: number };
+
+  /**
+   * Make this database a replication leader: deletes are logged from now on
+   */
+  enableReplicationLog(): void;
+
+  /**
+   * The next replication frame for a follower at position ({} for a new
+   * follower, which starts with a snapshot)
+   */
+  pullReplication(position?: Partial<ReplicationPosition>, maxBytes?: number): Uint8Array;
+
+  /**
+   * Apply a leader's frame in order as a follower
+   * @returns The follower's new position
+   */
+  applyReplication(frame: Uint8Array): ReplicationPosition;
+
+  /**
+   * Where this follower is in its leader's stream
+   */
+  replicaPosition(): ReplicationPosition;
+
+  /**
+   * The leader's current end
+   */
+  replicationHead(): ReplicationPosition;
+
+  /**
+   * Drop logged deletes every follower has applied
+   */
+  trimReplicationLog(position: ReplicationPosition): void;
+
   /**
    * Load exported data and rebuild indexes
    */
@@ -60,6 +250,22 @@ export interface FlatSQLDatabase {
    */
   getStats(): TableStats[];
 
+  /**
+   * Bytes held by the stream, the tables and the query engine; with a
+   * table name, the table figures and total are that table's
+   */
+  getMemoryUsage(tableName?: string | null): MemoryUsage;
+
+  /**
+   * Bound the footprint; ingest throws while past hardBytes
+   */
+  setMemoryLimits(limits: MemoryLimits): void;
+
+  /**
+   * Last measured footprint and what the limits have done since set
+   */
+  getMemoryLimitStats(): MemoryLimitStats;
+
   // ==================== Multi-Source API ====================
 
   /**
@@ -112,6 +318,52 @@ export interface FlatSQLDatabase {
    */
   clearTombstones(tableName: string): void;
 
+  /**
+   * Point-in-time queries: read only records up to sequence (0 = latest)
+   */
+  setAsOf(sequence: number): void;
+
+  /**
+   * Latest published sequence (rowid), the watermark for setAsOf
+   */
+  getVisibleSequence(): number;
+
+  /**
+   * Latest-wins ingest by the table's primary key: re-ingesting a key
+   * replaces its row and tombstones the older version
+   */
+  setUpsertMode(tableName: string, options?: { enabled?: boolean; keepHistory?: boolean }): void;
+
+  /**
+   * Index several columns together, carrying include columns in the
+   * entries; queries reading only these columns skip the records
+   */
+  addCompositeIndex(tableName: string, name: string, columns: { keys: string[]; include?: string[] }): void;
+
+  /**
+   * Check records against the schema: 'strict' rejects an ingest call
+   * holding a malformed record, 'lazy' checks each record on its first read
+   * and fails that query, 'trusted' (the default) never checks. Every table
+   * when tableName is omitted.
+   */
+  setVerificationMode(mode: 'trusted' | 'strict' | 'lazy', tableName?: string | null): void;
+
+  /** Malformed records of a table found so far */
+  getVerificationFailures(tableName: string): number;
+
+  /**
+   * Move to a newer version of the schema without re-ingesting: tables and
+   * fields may be added and columns indexed; nothing may be removed or
+   * retyped. Returns the schema version.
+   */
+  evolveSchema(schemaSource: string): number;
+
+  /**
+   * Index up to maxRecords stored records into indexes added by
+   * evolveSchema(); true once every index is complete
+   */
+  backfillStep(maxRecords?: number): boolean;
+
   // ==================== Raw FlatBuffer Access ====================
 
   /**
@@ -209,9 +461,15 @@ export interface FlatSQLDatabase {
 
 export interface FlatSQL {
   /**
-   * Create a new database with the given schema
+   * Create a new database with the given schema: IDL or JSON Schema text,
+   * or a compileSchema() artifact, which opens without parsing
+   */
+  createDatabase(schema: string | Uint8Array, name?: string): FlatSQLDatabase;
+
+  /**
+   * Parse a schema into a compiled artifact for createDatabase()
    */
-  createDatabase(schema: string, name: string): FlatSQLDatabase;
+  compileSchema(schema: string, name?: string): Uint8Array;
 
   /**
    * Create a test User FlatBuffer (for demos)
@@ -227,6 +485,33 @@ export interface FlatSQL {
    * Check if WASM was loaded with integrity verification
    */
   wasIntegrityVerified(): boolean;
+
+  /**
+   * Bytes of WASM linear memory (it grows but never shrinks)
+   */
+  heapSize(): number;
+
+  /**
+   * Threads a database's scan or ingest pool can use, including the caller
+   * (1 unless this is the multithreaded build)
+   */
+  maxThreads(): number;
+
+  /**
+   * Whether this build records tracepoints (CMake option FLATSQL_ENABLE_TRACING)
+   */
+  tracingEnabled(): boolean;
+
+  /**
+   * Recorded tracepoints as Chrome trace JSON, for chrome://tracing or
+   * ui.perfetto.dev (no events unless tracingEnabled())
+   */
+  exportTrace(): string;
+
+  /**
+   * Drop the recorded tracepoints
+   */
+  clearTrace(): void;
 }
 
 /**
@@ -262,6 +547,13 @@ export interface InitOptions {
    * Default: built-in FlatSQLModule
    */
   moduleFactory?: () => Promise<any>;
+
+  /**
+   * Load the multithreaded build (flatsql-mt.js). It needs SharedArrayBuffer,
+   * which browsers only provide to cross-origin isolated pages.
+   * Default: false
+   */
+  threads?: boolean;
 }
 
 /**
@@ -294,4 +586,9 @@ export function initFlatSQL(options?: InitOptions | (() => Promise<any>)): Promi
  */
 export function wasIntegrityVerified(): boolean;
 
+/**
+ * Row arrays of a columnar result (nextBatch, nextSlice, queryColumnar)
+ */
+export function resultBufferRows(result: ColumnarQueryResult): QueryResult;
+
 export default initFlatSQL;
@@ -84,6 +84,9 @@ async function loadIntegrityFile(basePath = '') {
  * @property {boolean} [skipIntegrityCheck] - Skip integrity verification (not recommended for production)
  * @property {boolean} [requireIntegrity] - Fail if integrity cannot be verified (default: false)
  * @property {function} [moduleFactory] - Custom Emscripten module factory
+ * @property {boolean} [threads] - Load the multithreaded build (flatsql-mt.js), whose
+ *     scan and ingest pools run on Web Workers; needs SharedArrayBuffer, which browsers
+ *     only offer to cross-origin isolated pages (see threadsAvailable in flatsql-client.js)
  */
 
 /**
@@ -105,7 +108,122 @@ async function loadIntegrityFile(basePath = '') {
  * @example
  * // Skip integrity check (development only)
  * const flatsql = await initFlatSQL({ skipIntegrityCheck: true });
+ *
+ * @example
+ * // Multithreaded build: aggregate() and ingest use every core
+ * const flatsql = await initFlatSQL({ threads: true });
+ */
+// ==================== Result buffer decoding ====================
+// Layout documented in cpp/include/flatsql/result_buffer.h
+
+const RESULT_BUFFER_MAGIC = 0x52515346; // "FSQR"
+const textDecoder = new TextDecoder();
+
+// TextDecoder refuses views of shared memory (the multithreaded build's)
+const decodeText = (bytes) =>
+    textDecoder.decode(bytes.buffer instanceof ArrayBuffer ? bytes : bytes.slice());
+
+/**
+ * Decode a result buffer into typed column vectors. Numeric columns are
+ * copied out of WASM memory with one slice each; the returned arrays stay
+ * valid after the next query.
+ * @param {Uint8Array} heap - Module.HEAPU8
+ * @param {number} ptr - Buffer address from flatsql_query_buffer
+ * @returns {{columns: string[], rowCount: number, types: number[], values: Array, validity: Array}}
  */
+function decodeResultBuffer(heap, ptr) {
+    const view = new DataView(heap.buffer, heap.byteOffset + ptr);
+    if (view.getUint32(0, true) !== RESULT_BUFFER_MAGIC) {
+        throw new Error('Invalid result buffer');
+    }
+    const columnCount = view.getUint32(8, true);
+    const rowCount = view.getUint32(12, true);
+
+    const columns = [];
+    const types = [];
+    const values = [];
+    const validity = [];
+    const bytesAt = (offset, length) => heap.subarray(ptr + offset, ptr + offset + length);
+
+    for (let c = 0; c < columnCount; c++) {
+        const entry = 16 + c * 32;
+        const nameOffset = view.getUint32(entry, true);
+        const nameLength = view.getUint32(entry + 4, true);
+        const type = view.getUint32(entry + 8, true);
+        const nullCount = view.getUint32(entry + 12, true);
+        const validityOffset = view.getUint32(entry + 16, true);
+        const valuesOffset = view.getUint32(entry + 20, true);
+        const offsetsOffset = view.getUint32(entry + 24, true);
+        const dataOffset = view.getUint32(entry + 28, true);
+
+        columns.push(decodeText(bytesAt(nameOffset, nameLength)));
+        types.push(type);
+        validity.push(nullCount > 0 && validityOffset ? bytesAt(validityOffset, (rowCount + 7) >> 3).slice() : null);
+
+        const absolute = heap.byteOffset + ptr;
+        switch (type) {
+            case 1: // bool
+                values.push(bytesAt(valuesOffset, rowCount).slice());
+                break;
+            case 3: // int64
+                values.push(new BigInt64Array(heap.buffer.slice(absolute + valuesOffset, absolute + valuesOffset + rowCount * 8)));
+                break;
+            case 4: // double
+                values.push(new Float64Array(heap.buffer.slice(absolute + valuesOffset, absolute + valuesOffset + rowCount * 8)));
+                break;
+            case 5: // string
+            case 6: // blob
+            case 7: { // mixed
+                const cells = new Array(rowCount);
+                for (let r = 0; r < rowCount; r++) {
+                    const start = view.getUint32(offsetsOffset + r * 4, true);
+                    const end = view.getUint32(offsetsOffset + r * 4 + 4, true);
+                    const cellType = type === 7 ? view.getUint8(valuesOffset + r) : type;
+                    const at = dataOffset + start;
+                    switch (cellType) {
+                        case 1: cells[r] = view.getBigInt64(at, true) !== 0n; break;
+                        case 3: cells[r] = Number(view.getBigInt64(at, true)); break;
+                        case 4: cells[r] = view.getFloat64(at, true); break;
+                        case 5: cells[r] = decodeText(bytesAt(at, end - start)); break;
+                        case 6: cells[r] = Array.from(bytesAt(at, end - start)); break;
+                        default: cells[r] = null;
+                    }
+                }
+                values.push(cells);
+                break;
+            }
+            default: // all null
+                values.push(new Array(rowCount).fill(null));
+        }
+    }
+
+    return { columns, rowCount, types, values, validity };
+}
+
+// Row-oriented view of a decoded result, matching the cell-by-cell API
+export function resultBufferRows(decoded) {
+    const { columns, rowCount, types, values, validity } = decoded;
+    const rows = new Array(rowCount);
+    for (let r = 0; r < rowCount; r++) {
+        const row = new Array(columns.length);
+        for (let c = 0; c < columns.length; c++) {
+            const valid = validity[c];
+            if (valid && !(valid[r >> 3] & (1 << (r & 7)))) {
+                row[c] = null;
+                continue;
+            }
+            const v = values[c][r];
+            switch (types[c]) {
+                case 1: row[c] = v !== 0; break;
+                case 3: row[c] = Number(v); break;
+                default: row[c] = v;
+            }
+        }
+        rows[r] = row;
+    }
+    return { columns, rows };
+}
+
 export async function initFlatSQL(moduleFactoryOrOptions) {
     let moduleFactory = FlatSQLModule;
     let options = {};
@@ -124,6 +242,18 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
         }
     }
 
+    const threads = options.threads === true;
+    if (threads && typeof SharedArrayBuffer === 'undefined') {
+        throw new Error(
+            'The multithreaded FlatSQL build needs SharedArrayBuffer; browsers only ' +
+            'provide it to cross-origin isolated pages (COOP/COEP headers).'
+        );
+    }
+    if (threads && !options.moduleFactory) {
+        moduleFactory = (await import('./flatsql-mt.js')).default;
+    }
+    const wasmName = threads ? 'flatsql-mt.wasm' : 'flatsql.wasm';
+
     // Determine expected integrity hash
     let expectedIntegrity = options.integrity || null;
 
@@ -131,7 +261,7 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
     if (!expectedIntegrity && !options.skipIntegrityCheck) {
         const integrityData = await loadIntegrityFile(options.wasmPath);
         if (integrityData) {
-            expectedIntegrity = integrityData.hash;
+            expectedIntegrity = threads ? integrityData.threads?.hash || null : integrityData.hash;
         }
     }
 
@@ -153,9 +283,9 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
                 // Determine WASM path
                 let wasmUrl;
                 if (options.wasmPath) {
-                    wasmUrl = `${options.wasmPath}/flatsql.wasm`;
+                    wasmUrl = `${options.wasmPath}/${wasmName}`;
                 } else {
-                    wasmUrl = new URL('./flatsql.wasm', import.meta.url).href;
+                    wasmUrl = new URL(`./${wasmName}`, import.meta.url).href;
                 }
 
                 // Fetch WASM binary
@@ -172,7 +302,7 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
                     const path = await import('path');
                     const url = await import('url');
                     const __dirname = path.dirname(url.fileURLToPath(import.meta.url));
-                    const wasmPath = path.join(__dirname, 'flatsql.wasm');
+                    const wasmPath = path.join(__dirname, wasmName);
                     wasmBinary = fs.readFileSync(wasmPath).buffer;
                 }
 
@@ -188,9 +318,9 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
                 // Mark as verified
                 integrityVerified = true;
 
-                // Instantiate verified WASM
+                // Instantiate verified WASM (pthread workers instantiate the module too)
                 const result = await WebAssembly.instantiate(wasmBinary, imports);
-                successCallback(result.instance);
+                successCallback(result.instance, result.module);
                 return result.instance.exports;
             } catch (error) {
                 throw new Error(`WASM integrity verification failed: ${error.message}`);
@@ -201,10 +331,31 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
     // Initialize module
     Module = await moduleFactory(moduleConfig);
 
+    // C API v2 keeps result and error state per database handle; older
+    // builds keep it global, so the handle argument is dropped for them
+    const perHandleState = typeof Module._flatsql_api_version === 'function' &&
+        Module._flatsql_api_version() >= 2;
+    const cwrapScoped = (name, returnType, argTypes) => {
+        if (perHandleState) {
+            return Module.cwrap(name, returnType, ['number', ...argTypes]);
+        }
+        const fn = Module.cwrap(name, returnType, argTypes);
+        return (handle, ...args) => fn(...args);
+    };
+
     // Wrap C functions using cwrap
     api = {
         // Database lifecycle
         createDb: Module.cwrap('flatsql_create_db', 'number', ['string', 'string']),
+        createDbCompiled: Module._flatsql_create_db_compiled
+            ? Module.cwrap('flatsql_create_db_compiled', 'number', ['number', 'number'])
+            : null,
+        compileSchema: Module._flatsql_compile_schema
+            ? Module.cwrap('flatsql_compile_schema', 'number', ['string', 'string'])
+            : null,
+        compiledSchemaSize: Module._flatsql_compiled_schema_size
+            ? Module.cwrap('flatsql_compiled_schema_size', 'number', [])
+            : null,
         destroyDb: Module.cwrap('flatsql_destroy_db', null, ['number']),
         registerFileId: Module.cwrap('flatsql_register_file_id', null, ['number', 'string', 'string']),
         enableDemoExtractors: Module.cwrap('flatsql_enable_demo_extractors', null, ['number']),
@@ -212,6 +363,12 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
         // Data ingestion
         ingest: Module.cwrap('flatsql_ingest', 'number', ['number', 'number', 'number']),
         ingestOne: Module.cwrap('flatsql_ingest_one', 'number', ['number', 'number', 'number']),
+        reserveIngest: Module._flatsql_reserve_ingest
+            ? Module.cwrap('flatsql_reserve_ingest', 'number', ['number', 'number'])
+            : null,
+        commitIngest: Module._flatsql_commit_ingest
+            ? Module.cwrap('flatsql_commit_ingest', 'number', ['number', 'number'])
+            : null,
 
         // Source-aware ingestion
         registerSource: Module.cwrap('flatsql_register_source', null, ['number', 'string']),
@@ -219,25 +376,85 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
         ingestWithSource: Module.cwrap('flatsql_ingest_with_source', 'number', ['number', 'number', 'number', 'string']),
         ingestOneWithSource: Module.cwrap('flatsql_ingest_one_with_source', 'number', ['number', 'number', 'number', 'string']),
         getSourcesCount: Module.cwrap('flatsql_get_sources_count', 'number', ['number']),
-        getSourceName: Module.cwrap('flatsql_get_source_name', 'string', ['number']),
+        getSourceName: cwrapScoped('flatsql_get_source_name', 'string', ['number']),
 
         // Query execution
         query: Module.cwrap('flatsql_query', 'number', ['number', 'string']),
-        getError: Module.cwrap('flatsql_get_error', 'string', []),
+        getError: cwrapScoped('flatsql_get_error', 'string', []),
 
         // Result access
-        resultColumnCount: Module.cwrap('flatsql_result_column_count', 'number', []),
-        resultRowCount: Module.cwrap('flatsql_result_row_count', 'number', []),
-        resultColumnName: Module.cwrap('flatsql_result_column_name', 'string', ['number']),
-        resultCellType: Module.cwrap('flatsql_result_cell_type', 'number', ['number', 'number']),
-        resultCellNumber: Module.cwrap('flatsql_result_cell_number', 'number', ['number', 'number']),
-        resultCellString: Module.cwrap('flatsql_result_cell_string', 'string', ['number', 'number']),
-        resultCellBlob: Module.cwrap('flatsql_result_cell_blob', 'number', ['number', 'number']),
-        resultCellBlobSize: Module.cwrap('flatsql_result_cell_blob_size', 'number', ['number', 'number']),
+        resultColumnCount: cwrapScoped('flatsql_result_column_count', 'number', []),
+        resultRowCount: cwrapScoped('flatsql_result_row_count', 'number', []),
+        resultColumnName: cwrapScoped('flatsql_result_column_name', 'string', ['number']),
+        resultCellType: cwrapScoped('flatsql_result_cell_type', 'number', ['number', 'number']),
+        resultCellNumber: cwrapScoped('flatsql_result_cell_number', 'number', ['number', 'number']),
+        resultCellString: cwrapScoped('flatsql_result_cell_string', 'string', ['number', 'number']),
+        resultCellBlob: cwrapScoped('flatsql_result_cell_blob', 'number', ['number', 'number']),
+        resultCellBlobSize: cwrapScoped('flatsql_result_cell_blob_size', 'number', ['number', 'number']),
+
+        // Whole-result buffer (absent from older builds)
+        queryBuffer: Module._flatsql_query_buffer
+            ? Module.cwrap('flatsql_query_buffer', 'number', ['number', 'string'])
+            : null,
+
+        // Cursors (absent from older builds)
+        prepare: Module._flatsql_prepare
+            ? Module.cwrap('flatsql_prepare', 'number', ['number', 'string'])
+            : null,
+        step: Module.cwrap('flatsql_step', 'number', ['number']),
+        stepBuffer: Module.cwrap('flatsql_step_buffer', 'number', ['number', 'number']),
+        // Time-sliced steps and cancellation (absent from older builds)
+        stepBufferFor: Module._flatsql_step_buffer_for
+            ? Module.cwrap('flatsql_step_buffer_for', 'number', ['number', 'number', 'number'])
+            : null,
+        cursorDone: Module._flatsql_cursor_done
+            ? Module.cwrap('flatsql_cursor_done', 'number', ['number'])
+            : null,
+        cancel: Module._flatsql_cancel
+            ? Module.cwrap('flatsql_cancel', null, ['number'])
+            : null,
+        columnCount: Module.cwrap('flatsql_column_count', 'number', ['number']),
+        columnName: Module.cwrap('flatsql_column_name', 'string', ['number', 'number']),
+        columnType: Module.cwrap('flatsql_column_type', 'number', ['number', 'number']),
+        columnNumber: Module.cwrap('flatsql_column_number', 'number', ['number', 'number']),
+        columnString: Module.cwrap('flatsql_column_string', 'string', ['number', 'number']),
+        columnBlob: Module.cwrap('flatsql_column_blob', 'number', ['number', 'number']),
+        columnBytes: Module.cwrap('flatsql_column_bytes', 'number', ['number', 'number']),
+        finalize: Module.cwrap('flatsql_finalize', null, ['number']),
 
         // Export/Import
         exportData: Module.cwrap('flatsql_export_data', 'number', ['number']),
-        exportSize: Module.cwrap('flatsql_export_size', 'number', []),
+        exportSize: cwrapScoped('flatsql_export_size', 'number', []),
+        exportBegin: Module._flatsql_export_begin
+            ? Module.cwrap('flatsql_export_begin', null, ['number', 'number'])
+            : null,
+        exportNext: Module._flatsql_export_next
+            ? Module.cwrap('flatsql_export_next', 'number', ['number'])
+            : null,
+        exportWatermark: Module._flatsql_export_watermark
+            ? Module.cwrap('flatsql_export_watermark', 'number', ['number'])
+            : null,
+
+        // Replication
+        enableReplicationLog: Module._flatsql_enable_replication_log
+            ? Module.cwrap('flatsql_enable_replication_log', null, ['number'])
+            : null,
+        replicationPull: Module._flatsql_replication_pull
+            ? Module.cwrap('flatsql_replication_pull', 'number',
+                           ['number', 'number', 'number', 'number', 'number', 'number'])
+            : null,
+        replicationApply: Module._flatsql_replication_apply
+            ? Module.cwrap('flatsql_replication_apply', 'number', ['number', 'number', 'number'])
+            : null,
+        replicaPosition: Module._flatsql_replica_position
+            ? Module.cwrap('flatsql_replica_position', 'number', ['number', 'number'])
+            : null,
+        replicationHead: Module._flatsql_replication_head
+            ? Module.cwrap('flatsql_replication_head', 'number', ['number', 'number'])
+            : null,
+        trimReplicationLog: Module._flatsql_trim_replication_log
+            ? Module.cwrap('flatsql_trim_replication_log', null, ['number', 'number', 'number'])
+            : null,
         loadAndRebuild: Module.cwrap('flatsql_load_and_rebuild', null, ['number', 'number', 'number']),
 
         // Test helpers
@@ -247,14 +464,53 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
 
         // Stats
         getStatsCount: Module.cwrap('flatsql_get_stats_count', 'number', ['number']),
-        getStatTableName: Module.cwrap('flatsql_get_stat_table_name', 'string', ['number']),
-        getStatFileId: Module.cwrap('flatsql_get_stat_file_id', 'string', ['number']),
-        getStatRecordCount: Module.cwrap('flatsql_get_stat_record_count', 'number', ['number']),
+        getStatTableName: cwrapScoped('flatsql_get_stat_table_name', 'string', ['number']),
+        getStatFileId: cwrapScoped('flatsql_get_stat_file_id', 'string', ['number']),
+        getStatRecordCount: cwrapScoped('flatsql_get_stat_record_count', 'number', ['number']),
+        getStatMemoryBytes: Module._flatsql_get_stat_memory_bytes
+            ? cwrapScoped('flatsql_get_stat_memory_bytes', 'number', ['number'])
+            : () => 0,
+
+        // Memory accounting and limits (absent from older builds)
+        memoryUsage: Module._flatsql_memory_usage
+            ? Module.cwrap('flatsql_memory_usage', 'number', ['number', 'string', 'string'])
+            : null,
+        setMemoryLimits: Module._flatsql_set_memory_limits
+            ? Module.cwrap('flatsql_set_memory_limits', 'number', ['number', 'number', 'number', 'number'])
+            : null,
+        memoryLimitStat: Module._flatsql_memory_limit_stat
+            ? Module.cwrap('flatsql_memory_limit_stat', 'number', ['number', 'string'])
+            : null,
 
         // Delete support
         markDeleted: Module.cwrap('flatsql_mark_deleted', null, ['number', 'string', 'number']),
         getDeletedCount: Module.cwrap('flatsql_get_deleted_count', 'number', ['number', 'string']),
         clearTombstones: Module.cwrap('flatsql_clear_tombstones', null, ['number', 'string']),
+        compactStep: Module.cwrap('flatsql_compact_step', 'number', ['number', 'number']),
+        setAsOf: Module._flatsql_set_as_of
+            ? Module.cwrap('flatsql_set_as_of', null, ['number', 'number'])
+            : null,
+        visibleSequence: Module._flatsql_visible_sequence
+            ? Module.cwrap('flatsql_visible_sequence', 'number', ['number'])
+            : null,
+        setUpsertMode: Module._flatsql_set_upsert_mode
+            ? Module.cwrap('flatsql_set_upsert_mode', 'number', ['number', 'string', 'number', 'number'])
+            : null,
+        addCompositeIndex: Module._flatsql_add_composite_index
+            ? Module.cwrap('flatsql_add_composite_index', 'number', ['number', 'string', 'string', 'string', 'string'])
+            : null,
+        setVerificationMode: Module._flatsql_set_verification_mode
+            ? Module.cwrap('flatsql_set_verification_mode', 'number', ['number', 'string', 'number'])
+            : null,
+        verificationFailures: Module._flatsql_verification_failures
+            ? Module.cwrap('flatsql_verification_failures', 'number', ['number', 'string'])
+            : null,
+        evolveSchema: Module._flatsql_evolve_schema
+            ? Module.cwrap('flatsql_evolve_schema', 'number', ['number', 'string'])
+            : null,
+        backfillStep: Module._flatsql_backfill_step
+            ? Module.cwrap('flatsql_backfill_step', 'number', ['number', 'number'])
+            : null,
 
         // Encryption
         setEncryptionKey: Module.cwrap('flatsql_set_encryption_key', 'number', ['number', 'number', 'number']),
@@ -267,6 +523,34 @@ export async function initFlatSQL(moduleFactoryOrOptions) {
         isHMACEnabled: Module.cwrap('flatsql_is_hmac_enabled', 'number', ['number']),
         computeHMAC: Module.cwrap('flatsql_compute_hmac', 'number', ['number', 'number', 'number', 'number']),
         verifyHMAC: Module.cwrap('flatsql_verify_hmac', 'number', ['number', 'number', 'number', 'number']),
+
+        // Parallel scan and ingest (absent from older builds)
+        maxThreads: Module._flatsql_max_threads
+            ? Module.cwrap('flatsql_max_threads', 'number', [])
+            : () => 1,
+        setScanThreads: Module._flatsql_set_scan_threads
+            ? Module.cwrap('flatsql_set_scan_threads', 'number', ['number', 'number'])
+            : () => 1,
+        setIngestThreads: Module._flatsql_set_ingest_threads
+            ? Module.cwrap('flatsql_set_ingest_threads', 'number', ['number', 'number'])
+            : () => 1,
+        aggregate: Module._flatsql_aggregate
+            ? Module.cwrap('flatsql_aggregate', 'number', ['number', 'string', 'string', 'string'])
+            : null,
+
+        // Tracepoints (absent from older builds)
+        traceCompiled: Module._flatsql_trace_compiled
+            ? Module.cwrap('flatsql_trace_compiled', 'number', [])
+            : () => 0,
+        traceExport: Module._flatsql_trace_export
+            ? Module.cwrap('flatsql_trace_export', 'number', [])
+            : null,
+        traceExportSize: Module._flatsql_trace_export_size
+            ? Module.cwrap('flatsql_trace_export_size', 'number', [])
+            : null,
+        traceClear: Module._flatsql_trace_clear
+            ? Module.cwrap('flatsql_trace_clear', null, [])
+            : () => {},
     };
 
     return new FlatSQL();
@@ -282,11 +566,40 @@ export function wasIntegrityVerified() {
 
 // High-level FlatSQL API class
 export class FlatSQL {
+    // schema is IDL or JSON Schema text, or a compileSchema() artifact
+    // (Uint8Array), which opens without parsing; dbName is then ignored
     createDatabase(schema, dbName = 'default') {
-        const handle = api.createDb(schema, dbName);
+        let handle;
+        if (schema instanceof Uint8Array) {
+            if (!api.createDbCompiled) throw new Error('Compiled schemas need a newer flatsql.wasm');
+            const ptr = Module._malloc(schema.length);
+            Module.HEAPU8.set(schema, ptr);
+            handle = api.createDbCompiled(ptr, schema.length);
+            Module._free(ptr);
+        } else {
+            handle = api.createDb(schema, dbName);
+        }
+        if (!handle) {
+            throw new Error(api.getError(0));
+        }
         return new FlatSQLDatabase(handle);
     }
 
+    /**
+     * Parse a schema once into a compiled artifact to ship with the app
+     * (or cache, e.g. in IndexedDB) and pass to createDatabase() on later
+     * page loads, skipping the schema parser.
+     * @returns {Uint8Array}
+     */
+    compileSchema(schema, dbName = 'default') {
+        if (!api.compileSchema) throw new Error('Compiled schemas need a newer flatsql.wasm');
+        const ptr = api.compileSchema(schema, dbName);
+        if (!ptr) {
+            throw new Error(api.getError(0));
+        }
+        return new Uint8Array(Module.HEAPU8.buffer, ptr, api.compiledSchemaSize()).slice();
+    }
+
     // Create test FlatBuffers
     createTestUser(id, name, email, age) {
         const ptr = api.createTestUser(id, name, email, age);
@@ -307,9 +620,150 @@ export class FlatSQL {
     wasIntegrityVerified() {
         return integrityVerified;
     }
+
+    /**
+     * Bytes of WASM linear memory; it grows but never shrinks
+     * @returns {number}
+     */
+    heapSize() {
+        return Module.HEAPU8.length;
+    }
+
+    /**
+     * Threads a database's scan or ingest pool can use, including the
+     * caller: 1 unless this is the multithreaded build
+     * @returns {number}
+     */
+    maxThreads() {
+        return api.maxThreads();
+    }
+
+    /**
+     * Whether this build records tracepoints (built with the CMake
+     * option FLATSQL_ENABLE_TRACING)
+     * @returns {boolean}
+     */
+    tracingEnabled() {
+        return api.traceCompiled() !== 0;
+    }
+
+    /**
+     * Recorded tracepoints as Chrome trace JSON, for chrome://tracing or
+     * ui.perfetto.dev (no events unless tracingEnabled())
+     * @returns {string}
+     */
+    exportTrace() {
+        if (!api.traceExport) return '{"traceEvents":[]}';
+        const ptr = api.traceExport();
+        return decodeText(new Uint8Array(Module.HEAPU8.buffer, ptr, api.traceExportSize()));
+    }
+
+    // Drop the recorded tracepoints
+    clearTrace() {
+        api.traceClear();
+    }
 }
 
 // Database wrapper class
+/**
+ * Row-at-a-time query over a FlatSQLDatabase (see FlatSQLDatabase.prepare).
+ * Call finalize() when done; a cursor must not outlive its database.
+ */
+export class FlatSQLCursor {
+    constructor(ptr, dbHandle) {
+        this._ptr = ptr;
+        this._handle = dbHandle;
+        this.columns = [];
+        const count = api.columnCount(ptr);
+        for (let i = 0; i < count; i++) {
+            this.columns.push(api.columnName(ptr, i));
+        }
+    }
+
+    // Advance to the next row; false when the result is exhausted
+    step() {
+        const rc = api.step(this._ptr);
+        if (rc < 0) {
+            throw new Error(api.getError(this._handle));
+        }
+        return rc === 1;
+    }
+
+    // Current row as an array
+    row() {
+        const row = [];
+        for (let c = 0; c < this.columns.length; c++) {
+            switch (api.columnType(this._ptr, c)) {
+                case 3: // int64
+                case 4: // double
+                    row.push(api.columnNumber(this._ptr, c));
+                    break;
+                case 5: // string
+                    row.push(api.columnString(this._ptr, c));
+                    break;
+                case 6: { // blob
+                    const ptr = api.columnBlob(this._ptr, c);
+                    const size = api.columnBytes(this._ptr, c);
+                    row.push(ptr && size > 0 ? Array.from(new Uint8Array(Module.HEAPU8.buffer, ptr, size)) : []);
+                    break;
+                }
+                default:
+                    row.push(null);
+            }
+        }
+        return row;
+    }
+
+    /**
+     * Read up to maxRows further rows as typed column vectors (same shape as
+     * FlatSQLDatabase.queryColumnar). Fewer than maxRows rows means done.
+     */
+    nextBatch(maxRows = 1024) {
+        const ptr = api.stepBuffer(this._ptr, maxRows);
+        if (!ptr) {
+            throw new Error(api.getError(this._handle));
+        }
+        return decodeResultBuffer(Module.HEAPU8, ptr);
+    }
+
+    /**
+     * nextBatch() that also returns once budgetMs has elapsed, so a worker
+     * can handle other messages between slices of a long query. Check
+     * done to tell the end of the result from a spent budget.
+     */
+    nextSlice(budgetMs, maxRows = 1024) {
+        if (!api.stepBufferFor) {
+            const batch = this.nextBatch(maxRows);
+            this._exhausted = batch.rowCount < maxRows;
+            return batch;
+        }
+        const ptr = api.stepBufferFor(this._ptr, maxRows, budgetMs);
+        if (!ptr) {
+            throw new Error(api.getError(this._handle));
+        }
+        return decodeResultBuffer(Module.HEAPU8, ptr);
+    }
+
+    // Whether the result is exhausted (or the query failed or was cancelled)
+    get done() {
+        return api.cursorDone ? api.cursorDone(this._ptr) === 1 : this._exhausted === true;
+    }
+
+    // Stop the query: the next step throws "Query cancelled"
+    cancel() {
+        if (this._ptr && api.cancel) {
+            api.cancel(this._ptr);
+        }
+    }
+
+    finalize() {
+        if (this._ptr) {
+            api.finalize(this._ptr);
+            this._ptr = 0;
+        }
+    }
+}
+
 export class FlatSQLDatabase {
     constructor(handle) {
         this._handle = handle;
@@ -341,6 +795,7 @@ export class FlatSQLDatabase {
             count = api.ingest(this._handle, ptr, data.length);
         }
         Module._free(ptr);
+        if (count < 0) throw new Error(api.getError(this._handle));
         return count;
     }
 
@@ -354,9 +809,41 @@ export class FlatSQLDatabase {
             count = api.ingestOne(this._handle, ptr, data.length);
         }
         Module._free(ptr);
+        if (count < 0) throw new Error(api.getError(this._handle));
+        return count;
+    }
+
+    /**
+     * Space for the next bytes of a size-prefixed stream at the end of the
+     * database's own storage, as a view into the WASM heap: write a network
+     * chunk into it and commitIngest() the bytes written. No staging
+     * malloc and no second copy. The view is only valid until the next
+     * call on the database (memory growth detaches it).
+     */
+    reserveIngest(bytes) {
+        if (!api.reserveIngest) throw new Error('reserveIngest needs a newer flatsql.wasm');
+        const ptr = api.reserveIngest(this._handle, bytes);
+        if (!ptr) throw new Error(api.getError(this._handle));
+        return new Uint8Array(Module.HEAPU8.buffer, ptr, bytes);
+    }
+
+    // Index the records completed by bytes written into reserveIngest()'s
+    // view; a trailing partial record waits for the next chunk. Returns
+    // the records committed.
+    commitIngest(bytes) {
+        const count = api.commitIngest(this._handle, bytes);
+        if (count < 0) throw new Error(api.getError(this._handle));
         return count;
     }
 
+    // One chunk of a size-prefixed stream (e.g. a WebSocket message), which
+    // may end or start mid-record: reserve, copy in, commit
+    ingestChunk(chunk) {
+        const bytes = chunk instanceof ArrayBuffer ? new Uint8Array(chunk) : chunk;
+        this.reserveIngest(bytes.length).set(bytes);
+        return this.commitIngest(bytes.length);
+    }
+
     // Register a named data source for source-aware ingestion
     // Creates source-specific tables: User@siteA, Post@siteA, etc.
     registerSource(sourceName) {
@@ -374,49 +861,104 @@ export class FlatSQLDatabase {
         const count = api.getSourcesCount(this._handle);
         const sources = [];
         for (let i = 0; i < count; i++) {
-            sources.push(api.getSourceName(i));
+            sources.push(api.getSourceName(this._handle, i));
         }
         return sources;
     }
 
+    /**
+     * Execute a query and return typed column vectors:
+     * { columns, rowCount, types, values, validity }. Integer columns are
+     * BigInt64Array, real columns Float64Array, bool columns Uint8Array;
+     * validity[c] is a bitmap of non-null rows or null when there are none.
+     */
+    queryColumnar(sql) {
+        if (!api.queryBuffer) {
+            throw new Error('queryColumnar requires a FlatSQL build with flatsql_query_buffer');
+        }
+        const ptr = api.queryBuffer(this._handle, sql);
+        if (!ptr) {
+            throw new Error(api.getError(this._handle));
+        }
+        return decodeResultBuffer(Module.HEAPU8, ptr);
+    }
+
+    /**
+     * Prepare a query for row-at-a-time reading; WASM memory use stays
+     * bounded by one row or batch however large the result is.
+     * @returns {FlatSQLCursor}
+     */
+    prepare(sql) {
+        if (!api.prepare) {
+            throw new Error('prepare requires a FlatSQL build with flatsql_prepare');
+        }
+        const ptr = api.prepare(this._handle, sql);
+        if (!ptr) {
+            throw new Error(api.getError(this._handle));
+        }
+        return new FlatSQLCursor(ptr, this._handle);
+    }
+
+    // Iterate over result rows, fetching batchSize rows per WASM call
+    *iterate(sql, batchSize = 1024) {
+        const cursor = this.prepare(sql);
+        try {
+            for (;;) {
+                const batch = resultBufferRows(cursor.nextBatch(batchSize));
+                yield* batch.rows;
+                if (batch.rows.length < batchSize) break;
+            }
+        } finally {
+            cursor.finalize();
+        }
+    }
+
     query(sql) {
+        // One buffer per result instead of one call per cell
+        if (api.queryBuffer) {
+            return resultBufferRows(this.queryColumnar(sql));
+        }
+
         const success = api.query(this._handle, sql);
         if (!success) {
-            throw new Error(api.getError());
+            throw new Error(api.getError(this._handle));
         }
+        return this._readResult();
+    }
 
-        // Read results
-        const colCount = api.resultColumnCount();
-        const rowCount = api.resultRowCount();
+    // Rows of the last flatsql_query or flatsql_aggregate, one call per cell
+    _readResult() {
+        const colCount = api.resultColumnCount(this._handle);
+        const rowCount = api.resultRowCount(this._handle);
 
         const columns = [];
         for (let i = 0; i < colCount; i++) {
-            columns.push(api.resultColumnName(i));
+            columns.push(api.resultColumnName(this._handle, i));
         }
 
         const rows = [];
         for (let r = 0; r < rowCount; r++) {
             const row = [];
             for (let c = 0; c < colCount; c++) {
-                const type = api.resultCellType(r, c);
+                const type = api.resultCellType(this._handle, r, c);
                 switch (type) {
                     case 0: // null
                         row.push(null);
                         break;
                     case 1: // bool
-                        row.push(api.resultCellNumber(r, c) !== 0);
+                        row.push(api.resultCellNumber(this._handle, r, c) !== 0);
                         break;
                     case 2: // int32
                     case 3: // int64
                     case 4: // double
-                        row.push(api.resultCellNumber(r, c));
+                        row.push(api.resultCellNumber(this._handle, r, c));
                         break;
                     case 5: // string
-                        row.push(api.resultCellString(r, c));
+                        row.push(api.resultCellString(this._handle, r, c));
                         break;
                     case 6: // blob
-                        const blobPtr = api.resultCellBlob(r, c);
-                        const blobSize = api.resultCellBlobSize(r, c);
+                        const blobPtr = api.resultCellBlob(this._handle, r, c);
+                        const blobSize = api.resultCellBlobSize(this._handle, r, c);
                         if (blobPtr && blobSize > 0) {
                             row.push(Array.from(new Uint8Array(Module.HEAPU8.buffer, blobPtr, blobSize)));
                         } else {
@@ -433,12 +975,143 @@ export class FlatSQLDatabase {
         return { columns, rows };
     }
 
+    /**
+     * Threads for aggregate() scans, including the caller (0 = maxThreads()).
+     * @returns {number} threads used
+     */
+    setScanThreads(threads = 0) {
+        return api.setScanThreads(this._handle, threads);
+    }
+
+    /**
+     * Threads extracting index keys during ingest, including the caller
+     * (0 = maxThreads()). Sequences and offsets are unchanged.
+     * @returns {number} threads used
+     */
+    setIngestThreads(threads = 0) {
+        return api.setIngestThreads(this._handle, threads);
+    }
+
+    /**
+     * Aggregates over every live record of a table or unified view on the
+     * scan pool, outside SQLite, e.g. aggregate('User', ['COUNT(*)', 'AVG(age)'], 'name').
+     * @param {string} tableName
+     * @param {string[]|string} aggregates - COUNT, SUM, MIN, MAX, AVG or APPROX_COUNT_DISTINCT of a
+     *     column (COUNT(*)), or APPROX_PERCENTILE(column, fraction)
+     * @param {string} [groupBy] - Column to group by
+     * @returns {{columns: string[], rows: Array[]}}
+     */
+    aggregate(tableName, aggregates, groupBy = '') {
+        if (!api.aggregate) {
+            throw new Error('aggregate requires a FlatSQL build with flatsql_aggregate');
+        }
+        const list = Array.isArray(aggregates) ? aggregates.join(',') : aggregates;
+        if (!api.aggregate(this._handle, tableName, list, groupBy)) {
+            throw new Error(api.getError(this._handle));
+        }
+        return this._readResult();
+    }
+
     exportData() {
         const ptr = api.exportData(this._handle);
-        const size = api.exportSize();
+        const size = api.exportSize(this._handle);
         return new Uint8Array(Module.HEAPU8.buffer, ptr, size).slice();
     }
 
+    /**
+     * Export in chunks of whole records without an intermediate copy of
+     * the stream. onChunk(view) gets a view into the WASM heap that is only
+     * valid during the call (copy or send it before returning; return
+     * false to stop). afterSequence exports only newer records, for delta
+     * sync and incremental backups. Returns the last sequence exported,
+     * the watermark to pass next time.
+     */
+    exportChunks(onChunk, afterSequence = 0) {
+        if (!api.exportBegin) throw new Error('exportChunks needs a newer flatsql.wasm');
+        api.exportBegin(this._handle, afterSequence);
+        let watermark = afterSequence;
+        for (let ptr; (ptr = api.exportNext(this._handle));) {
+            const size = api.exportSize(this._handle);
+            if (onChunk(new Uint8Array(Module.HEAPU8.buffer, ptr, size)) === false) break;
+            watermark = api.exportWatermark(this._handle);
+        }
+        return watermark;
+    }
+
+    // Records after a sequence watermark as one stream, with the new
+    // watermark: { data, watermark }
+    exportSince(sequence) {
+        const chunks = [];
+        let size = 0;
+        const watermark = this.exportChunks((view) => {
+            chunks.push(view.slice());
+            size += view.length;
+        }, sequence);
+        const data = new Uint8Array(size);
+        let offset = 0;
+        for (const chunk of chunks) {
+            data.set(chunk, offset);
+            offset += chunk.length;
+        }
+        return { data, watermark };
+    }
+
+    /**
+     * Replication leader: log deletes from now on so followers can tail
+     * this database with pullReplication(position), which returns the next
+     * frame (a Uint8Array to ship to the follower). A follower applies
+     * frames in order with applyReplication(frame) and pulls the next from
+     * replicaPosition(); a new follower starts from {} with a snapshot.
+     * Positions are { epoch, sequence, deletes, snapshot }.
+     */
+    enableReplicationLog() {
+        if (!api.enableReplicationLog) throw new Error('Replication needs a newer flatsql.wasm');
+        api.enableReplicationLog(this._handle);
+    }
+
+    pullReplication(position = {}, maxBytes = 4 * 1024 * 1024) {
+        if (!api.replicationPull) throw new Error('Replication needs a newer flatsql.wasm');
+        const { epoch = 0, sequence = 0, deletes = 0, snapshot = false } = position;
+        const ptr = api.replicationPull(this._handle, epoch, sequence, deletes, snapshot ? 1 : 0, maxBytes);
+        if (!ptr) throw new Error(api.getError(this._handle));
+        return Module.HEAPU8.slice(ptr, ptr + api.exportSize(this._handle));
+    }
+
+    // Returns the follower's new position
+    applyReplication(frame) {
+        if (!api.replicationApply) throw new Error('Replication needs a newer flatsql.wasm');
+        const ptr = Module._malloc(frame.length);
+        Module.HEAPU8.set(frame, ptr);
+        const rc = api.replicationApply(this._handle, ptr, frame.length);
+        Module._free(ptr);
+        if (rc < 0) throw new Error(api.getError(this._handle));
+        return this.replicaPosition();
+    }
+
+    replicaPosition() {
+        return this._position(api.replicaPosition);
+    }
+
+    // The leader's current end, where an up-to-date follower is
+    replicationHead() {
+        return this._position(api.replicationHead);
+    }
+
+    // Drop logged deletes up to a position every follower has reached
+    trimReplicationLog(position) {
+        api.trimReplicationLog(this._handle, position.epoch, position.deletes);
+    }
+
+    _position(field) {
+        if (!field) throw new Error('Replication needs a newer flatsql.wasm');
+        return {
+            epoch: field(this._handle, 0),
+            sequence: field(this._handle, 1),
+            deletes: field(this._handle, 2),
+            snapshot: field(this._handle, 3) !== 0,
+        };
+    }
+
     loadAndRebuild(data) {
         const ptr = Module._malloc(data.length);
         Module.HEAPU8.set(data, ptr);
@@ -451,14 +1124,62 @@ export class FlatSQLDatabase {
         const stats = [];
         for (let i = 0; i < count; i++) {
             stats.push({
-                tableName: api.getStatTableName(i),
-                fileId: api.getStatFileId(i),
-                recordCount: api.getStatRecordCount(i)
+                tableName: api.getStatTableName(this._handle, i),
+                fileId: api.getStatFileId(this._handle, i),
+                recordCount: api.getStatRecordCount(this._handle, i),
+                memoryBytes: api.getStatMemoryBytes(this._handle, i)
             });
         }
         return stats;
     }
 
+    /**
+     * Bytes held by the stream, the tables and the query engine. With a
+     * table name, the table figures and total are that table's.
+     * @param {string|null} [tableName]
+     * @returns {Object} byte counts by name (see MemoryUsage in index.d.ts)
+     */
+    getMemoryUsage(tableName = null) {
+        if (!api.memoryUsage) throw new Error('getMemoryUsage needs a newer flatsql.wasm');
+        const names = {
+            total: 'total', stream: 'stream', mapped: 'mapped', cold: 'cold', coldCache: 'cold_cache',
+            sequenceMap: 'sequence_map', chunkTable: 'chunk_table', recordLists: 'record_lists',
+            recordInfos: 'record_infos', indexes: 'indexes', indexPages: 'index_pages',
+            columnCaches: 'column_caches', zoneMaps: 'zone_maps', tombstones: 'tombstones',
+            verification: 'verification',
+            pageCache: 'page_cache', statements: 'statements', schema: 'schema', resultCache: 'result_cache'
+        };
+        const usage = {};
+        for (const [key, name] of Object.entries(names)) {
+            const bytes = api.memoryUsage(this._handle, tableName || '', name);
+            if (bytes < 0) throw new Error(`Unknown table: ${tableName}`);
+            usage[key] = bytes;
+        }
+        return usage;
+    }
+
+    /**
+     * Bound the footprint: past softBytes after an ingest, caches are
+     * dropped (and deleted records compacted with compactOverSoft); past
+     * hardBytes, ingest throws instead of storing. 0 disables a limit.
+     */
+    setMemoryLimits({ softBytes = 0, hardBytes = 0, compactOverSoft = false } = {}) {
+        if (!api.setMemoryLimits) throw new Error('setMemoryLimits needs a newer flatsql.wasm');
+        api.setMemoryLimits(this._handle, softBytes, hardBytes, compactOverSoft ? 1 : 0);
+    }
+
+    // Last measured footprint and what the limits have done since set
+    getMemoryLimitStats() {
+        if (!api.memoryLimitStat) throw new Error('getMemoryLimitStats needs a newer flatsql.wasm');
+        const stat = (name) => api.memoryLimitStat(this._handle, name);
+        return {
+            footprint: stat('footprint'),
+            reliefs: stat('reliefs'),
+            compactions: stat('compactions'),
+            rejections: stat('rejections')
+        };
+    }
+
     markDeleted(tableName, sequence) {
         api.markDeleted(this._handle, tableName, sequence);
     }
@@ -471,6 +1192,120 @@ export class FlatSQLDatabase {
         api.clearTombstones(this._handle, tableName);
     }
 
+    /**
+     * Point-in-time queries: only records up to sequence are read until
+     * reset with 0. Take the watermark from getVisibleSequence().
+     * @param {number} sequence
+     */
+    setAsOf(sequence) {
+        if (!api.setAsOf) throw new Error('setAsOf needs a newer flatsql.wasm');
+        api.setAsOf(this._handle, sequence);
+    }
+
+    // Latest published sequence (rowid), the watermark of an AS-OF query now
+    getVisibleSequence() {
+        if (!api.visibleSequence) throw new Error('getVisibleSequence needs a newer flatsql.wasm');
+        return api.visibleSequence(this._handle);
+    }
+
+    /**
+     * Latest-wins ingest by the table's primary key: re-ingesting a key
+     * replaces its row and tombstones the older version.
+     * @param {string} tableName
+     * @param {{enabled?: boolean, keepHistory?: boolean}} [options]
+     */
+    setUpsertMode(tableName, { enabled = true, keepHistory = false } = {}) {
+        if (!api.setUpsertMode) throw new Error('setUpsertMode needs a newer flatsql.wasm');
+        if (!api.setUpsertMode(this._handle, tableName, enabled ? 1 : 0, keepHistory ? 1 : 0)) {
+            throw new Error(api.getError(this._handle));
+        }
+    }
+
+    /**
+     * Index several columns together, carrying more in the index entries:
+     * equalities on leading keys plus a range on the next scan one key
+     * range, and queries reading only these columns skip the records.
+     * @param {string} tableName
+     * @param {string} name
+     * @param {{keys: string[], include?: string[]}} columns
+     */
+    addCompositeIndex(tableName, name, { keys, include = [] }) {
+        if (!api.addCompositeIndex) throw new Error('addCompositeIndex needs a newer flatsql.wasm');
+        if (!api.addCompositeIndex(this._handle, tableName, name, keys.join(','), include.join(','))) {
+            throw new Error(api.getError(this._handle));
+        }
+    }
+
+    /**
+     * Check records against the schema: 'strict' rejects an ingest call
+     * holding a malformed record, 'lazy' checks each record on its first
+     * read and fails that query, 'trusted' (the default) never checks.
+     * @param {'trusted'|'strict'|'lazy'} mode
+     * @param {string|null} [tableName] Every table when omitted
+     */
+    setVerificationMode(mode, tableName = null) {
+        if (!api.setVerificationMode) throw new Error('setVerificationMode needs a newer flatsql.wasm');
+        const modes = { trusted: 0, strict: 1, lazy: 2 };
+        if (!(mode in modes)) throw new Error(`Unknown verification mode: ${mode}`);
+        if (!api.setVerificationMode(this._handle, tableName, modes[mode])) {
+            throw new Error(api.getError(this._handle));
+        }
+    }
+
+    /**
+     * Malformed records of a table found so far
+     * @param {string} tableName
+     * @returns {number}
+     */
+    getVerificationFailures(tableName) {
+        if (!api.verificationFailures) throw new Error('getVerificationFailures needs a newer flatsql.wasm');
+        const failures = api.verificationFailures(this._handle, tableName);
+        if (failures < 0) throw new Error(api.getError(this._handle));
+        return failures;
+    }
+
+    /**
+     * Move to a newer version of the schema without re-ingesting: tables and
+     * fields may be added and columns indexed; nothing may be removed or
+     * retyped. Stored records read new fields as their defaults until
+     * rewritten. Indexes on stored records are filled by backfillStep().
+     * @param {string} schemaSource Complete new version of the schema
+     * @returns {number} The schema version (1 for the original schema)
+     */
+    evolveSchema(schemaSource) {
+        if (!api.evolveSchema) throw new Error('evolveSchema needs a newer flatsql.wasm');
+        const version = api.evolveSchema(this._handle, schemaSource);
+        if (!version) throw new Error(api.getError(this._handle));
+        return version;
+    }
+
+    /**
+     * Index up to maxRecords stored records into indexes added by
+     * evolveSchema(). Queries scan until an index is complete.
+     * @param {number} [maxRecords]
+     * @returns {boolean} Whether every index is complete
+     */
+    backfillStep(maxRecords = 64 * 1024) {
+        if (!api.backfillStep) throw new Error('backfillStep needs a newer flatsql.wasm');
+        const result = api.backfillStep(this._handle, maxRecords);
+        if (result < 0) throw new Error(api.getError(this._handle));
+        return result === 1;
+    }
+
+    /**
+     * Rewrite storage without deleted records, maxBytes of records per call.
+     * Rowids are renumbered when compaction finishes.
+     * @param {number} [maxBytes] - Record bytes to copy in this step
+     * @returns {boolean} true when compaction finished
+     */
+    compactStep(maxBytes = 4 * 1024 * 1024) {
+        const rc = api.compactStep(this._handle, maxBytes);
+        if (rc < 0) {
+            throw new Error(api.getError(this._handle));
+        }
+        return rc === 1;
+    }
+
     // ==================== Encryption API ====================
 
     /**
@@ -482,7 +1317,7 @@ export class FlatSQLDatabase {
         Module.HEAPU8.set(key, ptr);
         const result = api.setEncryptionKey(this._handle, ptr, key.length);
         Module._free(ptr);
-        if (!result) throw new Error(api.getError());
+        if (!result) throw new Error(api.getError(this._handle));
     }
 
     /**
@@ -508,7 +1343,7 @@ export class FlatSQLDatabase {
         const encrypted = new Uint8Array(Module.HEAPU8.buffer, bufPtr, buffer.length).slice();
         Module._free(bufPtr);
         Module._free(schemaPtr);
-        if (!result) throw new Error(api.getError());
+        if (!result) throw new Error(api.getError(this._handle));
         return encrypted;
     }
 
@@ -527,7 +1362,7 @@ export class FlatSQLDatabase {
         const decrypted = new Uint8Array(Module.HEAPU8.buffer, bufPtr, buffer.length).slice();
         Module._free(bufPtr);
         Module._free(schemaPtr);
-        if (!result) throw new Error(api.getError());
+        if (!result) throw new Error(api.getError(this._handle));
         return decrypted;
     }
 
@@ -540,7 +1375,7 @@ export class FlatSQLDatabase {
      */
     setHMACVerification(enabled) {
         const result = api.setHMACVerification(this._handle, enabled ? 1 : 0);
-        if (!result) throw new Error(api.getError());
+        if (!result) throw new Error(api.getError(this._handle));
     }
 
     /**